@@ -1,5 +1,7 @@
 #include <stdint.h>
 
+#include "../../libretro/texture_hash.h"
+
 uint32_t Hash_CalculatePalette(void *buffer, uint32_t count)
 {
    unsigned int i;
@@ -19,16 +21,5 @@ uint32_t Hash_CalculatePalette(void *buffer, uint32_t count)
 
 uint32_t Hash_Calculate(uint32_t hash, void *buffer, uint32_t count)
 {
-   unsigned int i;
-   uint32_t *data = (uint32_t *) buffer;
-   count /= 4;
-   for(i = 0; i < count; ++i) {
-      hash += data[i];
-      hash += (hash << 10);
-      hash ^= (hash >> 6);
-   }
-   hash += (hash << 3);
-   hash ^= (hash >> 11);
-   hash += (hash << 15);
-   return hash;
+   return texture_hash(hash, buffer, count);
 }
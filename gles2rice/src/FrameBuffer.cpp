@@ -31,6 +31,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "Render.h"
 
 #include "../../Graphics/RSP/RSP_state.h"
+#include "../../libretro/texture_hash.h"
 
 extern TMEMLoadMapInfo g_tmemLoadAddrMap[0x200];    // Totally 4KB TMEM;
 
@@ -585,6 +586,18 @@ uint32_t CalculateRDRAMCRC(void *pPhysicalAddress, uint32_t left, uint32_t top,
             pStart += pitch;
         }
     }
+    else if (!options.bLoadHiResTextures && !options.bDumpTexturesToFiles)
+    {
+        // Only used as a cache key here, hi-res packs need the exact CRC below
+        uint8_t *pStart = (uint8_t*)(pPhysicalAddress);
+        pStart += (top * pitchInBytes) + (((left<<size)+1)>>1);
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            dwAsmCRC = texture_hash(dwAsmCRC, pStart, dwAsmdwBytesPerLine);
+            pStart += pitchInBytes;
+        }
+    }
     else
     {
        dwAsmdwBytesPerLine = ((width<<size)+1)/2;
@@ -695,7 +708,14 @@ void FrameBufferManager::FrameBufferWriteByCPU(uint32_t addr, uint32_t size)
 
     //WARNING(TRACE2("Frame Buffer Write, address=%08X, CI Address=%08X", addr, g_CI.dwAddr));
     status.frameWriteByCPU = true;
-    frameWriteRecord.push_back(addr&(g_dwRamSize-1));
+
+    // size may cover a burst of consecutive words, record each of them
+    uint32_t end = addr + size;
+    do
+    {
+        frameWriteRecord.push_back(addr&(g_dwRamSize-1));
+        addr += 4;
+    } while (addr < end);
 }
 
 extern M64P_RECT frameWriteByCPURect;
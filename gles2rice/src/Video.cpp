@@ -608,7 +608,8 @@ void riceFBRead(uint32_t addr)
 
   input:    addr        rdram address
             val         val
-            size        1 = uint8_t, 2 = uint16_t, 4 = uint32_t
+            size        1 = uint8_t, 2 = uint16_t, 4 = uint32_t,
+                        or the length of a burst of consecutive words
   output:   none
 *******************************************************************/ 
 
@@ -48,11 +48,11 @@
 #include "CRC.h"
 
 #include <clamping.h>
-#include <encodings/crc32.h>
 
 #include "../../../Graphics/GBI.h"
 #include "../../../Graphics/RDP/gDP_state.h"
 #include "../../../Graphics/image_convert.h"
+#include "../../../libretro/texture_hash.h"
 
 int GetTexAddrUMA(int tmu, int texsize);
 static void LoadTex (int id, int tmu);
@@ -141,7 +141,7 @@ static uint32_t textureCRC(uint32_t crc, uint8_t *addr, int width, int height, i
 
    while (height--)
    {
-      crc = encoding_crc32(crc, addr, len);
+      crc = texture_hash(crc, addr, len);
       addr += len + line;
    }
 
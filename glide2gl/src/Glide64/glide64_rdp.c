@@ -1511,12 +1511,13 @@ Purpose:  This function is called to notify the dll that the
 frame buffer has been modified by CPU at the given address.
 input:    addr          rdram address
 val                     val
-size            1 = uint8_t, 2 = uint16_t, 4 = uint32_t
+size            1 = uint8_t, 2 = uint16_t, 4 = uint32_t,
+                or the length of a burst of consecutive words
 output:   none
 *******************************************************************/
 void glide64FBWrite(uint32_t addr, uint32_t size)
 {
-  uint32_t a, shift_l, shift_r;
+  uint32_t a, end, shift_l, shift_r;
 
   if (cpu_fb_ignore)
     return;
@@ -1530,18 +1531,22 @@ void glide64FBWrite(uint32_t addr, uint32_t size)
 
   cpu_fb_write_called = true;
   a                   = RSP_SegmentToPhysical(addr);
+  end                 = a + size;
 
-  if (a < gDP.colorImage.address || a > rdp.ci_end)
-    return;
+  for (; a < end; a += 4)
+  {
+    if (a < gDP.colorImage.address || a > rdp.ci_end)
+      continue;
 
-  cpu_fb_write = true;
-  shift_l      = (a - gDP.colorImage.address) >> 1;
-  shift_r      = shift_l+2;
+    cpu_fb_write = true;
+    shift_l      = (a - gDP.colorImage.address) >> 1;
+    shift_r      = shift_l+2;
 
-  part_framebuf.d_ul_x       = MIN(part_framebuf.d_ul_x, shift_l % gDP.colorImage.width);
-  part_framebuf.d_ul_y       = MIN(part_framebuf.d_ul_y, shift_l / gDP.colorImage.width);
-  part_framebuf.d_lr_x       = MAX(part_framebuf.d_lr_x, shift_r % gDP.colorImage.width);
-  part_framebuf.d_lr_y       = MAX(part_framebuf.d_lr_y, shift_r / gDP.colorImage.width);
+    part_framebuf.d_ul_x       = MIN(part_framebuf.d_ul_x, shift_l % gDP.colorImage.width);
+    part_framebuf.d_ul_y       = MIN(part_framebuf.d_ul_y, shift_l / gDP.colorImage.width);
+    part_framebuf.d_lr_x       = MAX(part_framebuf.d_lr_x, shift_r % gDP.colorImage.width);
+    part_framebuf.d_lr_y       = MAX(part_framebuf.d_lr_y, shift_r / gDP.colorImage.width);
+  }
 }
 
 
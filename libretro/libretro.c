@@ -17,6 +17,7 @@
 #include "r4300/r4300.h"
 #include "memory/memory.h"
 #include "main/main.h"
+#include "main/rom.h"
 #include "main/cheat.h"
 #include "main/version.h"
 #include "main/savestates.h"
@@ -24,9 +25,15 @@
 #include "pi/pi_controller.h"
 #include "si/pif.h"
 #include "libretro_memory.h"
+#include "texture_hash.h"
 
 /* Cxd4 RSP */
 #include "../mupen64plus-rsp-cxd4/config.h"
+/* HLE RSP */
+#include "../mupen64plus-rsp-hle/src/hle_task_cache.h"
+#ifdef NEW_DYNAREC
+#include "r4300/new_dynarec/new_dynarec.h"
+#endif
 #include "plugin/audio_libretro/audio_plugin.h"
 #include "../Graphics/plugin.h"
 
@@ -82,6 +89,7 @@ int first_time = 1;
 bool flip_only;
 
 static uint8_t* game_data = NULL;
+static char*    game_path = NULL;
 static uint32_t game_size = 0;
 
 static bool     emu_initialized     = false;
@@ -95,6 +103,13 @@ static bool     pushed_frame        = false;
 
 unsigned frame_dupe = false;
 
+enum
+{
+   INCREMENTAL_SAVESTATES_AUTO,
+   INCREMENTAL_SAVESTATES_DISABLED
+};
+static unsigned incremental_savestates = INCREMENTAL_SAVESTATES_AUTO;
+
 uint32_t *blitter_buf;
 uint32_t *blitter_buf_lock   = NULL;
 
@@ -283,9 +298,20 @@ static void setup_variables(void)
 #endif
 #else
          "CPU Core; cached_interpreter|pure_interpreter" },
+#endif
+#ifdef NEW_DYNAREC
+      /* only the x86-64 backend reserves more than 32MB */
+      { NAME_PREFIX "-dynarec-cache",
+#if NEW_DYNAREC == NEW_DYNAREC_AMD64
+         "(Dynarec) Translation Cache Size (restart); 32MB|16MB|64MB|128MB" },
+#else
+         "(Dynarec) Translation Cache Size (restart); 32MB|16MB" },
+#endif
 #endif
       {NAME_PREFIX "-audio-buffer-size",
          "Audio Buffer Size (restart); 2048|1024"},
+      {NAME_PREFIX "-audio-resampler",
+         "Audio Resampler; sinc|fast"},
       {NAME_PREFIX "-astick-deadzone",
         "Analog Deadzone (percent); 15|20|25|30|0|5|10"},
       {NAME_PREFIX "-pak1",
@@ -298,6 +324,8 @@ static void setup_variables(void)
         "Player 4 Pak; none|memory|rumble"},
       { NAME_PREFIX "-disable_expmem",
          "Enable Expansion Pak RAM; enabled|disabled" },
+      { NAME_PREFIX "-texture-hash",
+         "Texture Hash; crc32c|xxh64" },
       { NAME_PREFIX "-gfxplugin-accuracy",
 #if defined(HAVE_PARALLEL_ONLY)
          "GFX Accuracy; veryhigh" },
@@ -309,6 +337,10 @@ static void setup_variables(void)
 #ifdef HAVE_PARALLEL
       { NAME_PREFIX "-parallel-rdp-synchronous",
          "ParaLLEl Synchronous RDP; enabled|disabled" },
+#endif
+#ifdef HAVE_PARALLEL_RSP
+      { NAME_PREFIX "-parallel-rsp-jit-cache",
+         "ParaLLEl RSP JIT Cache; disabled|enabled" },
 #endif
       { NAME_PREFIX "-gfxplugin",
 #ifdef HAVE_PARALLEL_ONLY
@@ -322,6 +354,10 @@ static void setup_variables(void)
 #else
          "RSP Plugin; auto|hle|parallel|cxd4" },
 #endif
+      { NAME_PREFIX "-rsp-hle-task-cache",
+         "(HLE RSP) Task Cache; disabled|4MB|16MB|64MB" },
+      { NAME_PREFIX "-rsp-hle-async-audio",
+         "(HLE RSP) Threaded MusyX/MP3 Audio; disabled|enabled" },
 #ifndef HAVE_PARALLEL_ONLY
       { NAME_PREFIX "-screensize",
          "Resolution (restart); 640x480|960x720|1280x960|1600x1200|1920x1440|2240x1680|320x240" },
@@ -338,8 +374,16 @@ static void setup_variables(void)
       { NAME_PREFIX "-angrylion-vioverlay",
        "(Angrylion) VI Overlay; disabled|enabled"
       },
+      { NAME_PREFIX "-angrylion-threads",
+       "(Angrylion) Rendering Threads; 1|auto|2|3|4|6|8"
+      },
+      { NAME_PREFIX "-angrylion-async",
+       "(Angrylion) Asynchronous RDP; disabled|enabled"
+      },
       { NAME_PREFIX "-virefresh",
          "VI Refresh (Overclock); 1500|2200" },
+      { NAME_PREFIX "-framebuffer-readback",
+         "CPU Framebuffer Readback (disable for speed); enabled|disabled" },
 #endif
       { NAME_PREFIX "-bufferswap",
          "Buffer Swap; disabled|enabled"
@@ -350,6 +394,8 @@ static void setup_variables(void)
       { NAME_PREFIX "-vcache-vbo",
          "(Glide64) Vertex cache VBO (restart); disabled|enabled" },
 #endif
+      { NAME_PREFIX "-incremental-savestates",
+         "Incremental Savestates; auto|disabled" },
       { NAME_PREFIX "-boot-device",
          "Boot Device; Default|64DD IPL" },
       { NAME_PREFIX "-64dd-hardware",
@@ -390,20 +436,36 @@ static bool emu_step_load_data()
    if(CoreStartup(FRONTEND_API_VERSION, ".", ".", "Core", n64DebugCallback, 0, 0) && log_cb)
        log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to initialize core\n");
 
-   if (game_data != NULL && *((uint32_t *)game_data) != 0x16D348E8 && *((uint32_t *)game_data) != 0x56EE6322)
+   if (game_path != NULL || (game_data != NULL && *((uint32_t *)game_data) != 0x16D348E8 && *((uint32_t *)game_data) != 0x56EE6322))
    {
       /* Regular N64 ROM */
-      log_cb(RETRO_LOG_INFO, "EmuThread: M64CMD_ROM_OPEN\n");
+      if (game_path != NULL)
+      {
+         log_cb(RETRO_LOG_INFO, "EmuThread: M64CMD_ROM_OPEN_FILE\n");
 
-      if(CoreDoCommand(M64CMD_ROM_OPEN, game_size, (void*)game_data))
+         if(CoreDoCommand(M64CMD_ROM_OPEN_FILE, 0, (void*)game_path))
+         {
+            if (log_cb)
+               log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to map ROM\n");
+            goto load_fail;
+         }
+      }
+      else
       {
-         if (log_cb)
-            log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to load ROM\n");
-         goto load_fail;
+         log_cb(RETRO_LOG_INFO, "EmuThread: M64CMD_ROM_OPEN\n");
+
+         if(CoreDoCommand(M64CMD_ROM_OPEN, game_size, (void*)game_data))
+         {
+            if (log_cb)
+               log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to load ROM\n");
+            goto load_fail;
+         }
       }
 
       free(game_data);
       game_data = NULL;
+      free(game_path);
+      game_path = NULL;
 
       log_cb(RETRO_LOG_INFO, "EmuThread: M64CMD_ROM_GET_HEADER\n");
 
@@ -506,6 +568,8 @@ static bool emu_step_load_data()
 load_fail:
    free(game_data);
    game_data = NULL;
+   free(game_path);
+   game_path = NULL;
    stop = 1;
 
    return false;
@@ -696,6 +760,8 @@ void retro_get_system_info(struct retro_system_info *info)
 #endif
    info->library_version = "2.0-rc2" GIT_VERSION;
    info->valid_extensions = "n64|v64|z64|bin|u1|ndd";
+   /* the frontend loads the content, so soft-patching keeps working; the
+    * ROM file may still be mapped instead, see retro_load_game */
    info->need_fullpath = false;
    info->block_extract = false;
 }
@@ -809,7 +875,16 @@ void retro_deinit(void)
 extern void glide_set_filtering(unsigned value);
 #endif
 extern void angrylion_set_filtering(unsigned value);
+extern void angrylion_set_threads(unsigned count);
+extern void angrylion_set_async(unsigned enable);
+extern void set_framebuffer_readback(int enable);
+extern void hle_set_task_cache_size(size_t bytes);
+extern void hle_set_async_tasks(unsigned enable);
+extern void hle_get_task_cache_stats(struct hle_task_cache_stats_t* stats);
 extern void ChangeSize();
+#ifdef HAVE_PARALLEL_RSP
+extern void parallel_rsp_set_jit_cache_directory(const char *path);
+#endif
 
 void update_variables(bool startup)
 {
@@ -832,6 +907,20 @@ void update_variables(bool startup)
    parallel_set_synchronous_rdp(rdp_sync);
 #endif
 
+#ifdef HAVE_PARALLEL_RSP
+   var.key = NAME_PREFIX "-parallel-rsp-jit-cache";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value && !strcmp(var.value, "enabled"))
+   {
+      char jit_cache_dir[256];
+      snprintf(jit_cache_dir, sizeof(jit_cache_dir), "%s/parallel-rsp", retro_get_system_directory());
+      parallel_rsp_set_jit_cache_directory(jit_cache_dir);
+   }
+   else
+      parallel_rsp_set_jit_cache_directory(NULL);
+#endif
+
    var.key = NAME_PREFIX "-screensize";
    var.value = NULL;
 
@@ -908,6 +997,47 @@ void update_variables(bool startup)
    else
       overlay = 1;
 
+   var.key = NAME_PREFIX "-angrylion-threads";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (!strcmp(var.value, "auto"))
+         angrylion_set_threads(0);
+      else
+         angrylion_set_threads(atoi(var.value));
+   }
+
+   var.key = NAME_PREFIX "-angrylion-async";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      angrylion_set_async(!strcmp(var.value, "enabled"));
+
+#ifdef NEW_DYNAREC
+   var.key = NAME_PREFIX "-dynarec-cache";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      new_dynarec_set_cache_size(atoi(var.value));
+   else
+      new_dynarec_set_cache_size(0);
+
+#endif
+   var.key = NAME_PREFIX "-rsp-hle-task-cache";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value && strcmp(var.value, "disabled"))
+      hle_set_task_cache_size((size_t)atoi(var.value) << 20);
+   else
+      hle_set_task_cache_size(0);
+
+   var.key = NAME_PREFIX "-rsp-hle-async-audio";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      hle_set_async_tasks(!strcmp(var.value, "enabled"));
+
    CFG_HLE_GFX = (gfx_plugin != GFX_ANGRYLION) && (gfx_plugin != GFX_PARALLEL) ? 1 : 0;
    CFG_HLE_AUD = 0; /* There is no HLE audio code in libretro audio plugin. */
 
@@ -1019,6 +1149,46 @@ void update_variables(bool startup)
          BUFFERSWAP = false;
    }
 
+   var.key = NAME_PREFIX "-texture-hash";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (!strcmp(var.value, "xxh64"))
+         texture_hash_set_mode(TEXTURE_HASH_FAST64);
+      else
+         texture_hash_set_mode(TEXTURE_HASH_CRC32C);
+   }
+
+   var.key = NAME_PREFIX "-audio-resampler";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      if (!strcmp(var.value, "fast"))
+         set_audio_resampler_libretro(AUDIO_RESAMPLER_FAST);
+      else
+         set_audio_resampler_libretro(AUDIO_RESAMPLER_SINC);
+   }
+
+   var.key = NAME_PREFIX "-framebuffer-readback";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+      set_framebuffer_readback(!strcmp(var.value, "enabled"));
+
+   var.key = NAME_PREFIX "-incremental-savestates";
+   var.value = NULL;
+
+   if (environ_cb(RETRO_ENVIRONMENT_GET_VARIABLE, &var) && var.value)
+   {
+      /* "enabled" from older configs means auto as well */
+      if (!strcmp(var.value, "disabled"))
+         incremental_savestates = INCREMENTAL_SAVESTATES_DISABLED;
+      else
+         incremental_savestates = INCREMENTAL_SAVESTATES_AUTO;
+   }
+
    var.key = NAME_PREFIX "-framerate";
    var.value = NULL;
 
@@ -1205,6 +1375,113 @@ static bool retro_load_game_gl(const struct retro_game_info *game)
    return true;
 }
 
+static const uint8_t rom_signatures[3][4] = {
+   { 0x80, 0x37, 0x12, 0x40 },
+   { 0x37, 0x80, 0x40, 0x12 },
+   { 0x40, 0x12, 0x37, 0x80 }
+};
+
+static bool is_rom_signature(const uint8_t *data)
+{
+   int i;
+
+   for (i = 0; i < 3; ++i)
+      if (memcmp(data, rom_signatures[i], 4) == 0)
+         return true;
+
+   return false;
+}
+
+/* Reads the whole content file when the frontend only gave its path */
+static bool read_game_file(const char *path)
+{
+   FILE *file = fopen(path, "rb");
+   long size;
+
+   if (file == NULL)
+      return false;
+
+   if (fseek(file, 0L, SEEK_END) != 0 || (size = ftell(file)) <= 0)
+   {
+      fclose(file);
+      return false;
+   }
+
+   fseek(file, 0L, SEEK_SET);
+   game_data = malloc(size);
+
+   if (game_data == NULL || fread(game_data, 1, size, file) != (size_t)size)
+   {
+      free(game_data);
+      game_data = NULL;
+      fclose(file);
+      return false;
+   }
+
+   fclose(file);
+   game_size = size;
+   return true;
+}
+
+#ifdef ROM_FILE_MAPPING
+/* Returns true if the content file is a ROM image which can be mapped */
+static bool game_file_is_rom(const char *path)
+{
+   uint8_t header[4];
+   FILE *file = fopen(path, "rb");
+   bool is_rom;
+
+   if (file == NULL)
+      return false;
+
+   is_rom = fread(header, 1, sizeof(header), file) == sizeof(header)
+         && is_rom_signature(header);
+
+   fclose(file);
+   return is_rom;
+}
+
+/* The ROM can be mapped from its file instead of copied only if the file
+ * holds exactly what the frontend loaded: not an archive member, and no
+ * soft-patch applied. The whole file is compared, a patch may change any
+ * byte of it. */
+static bool game_file_matches(const struct retro_game_info *game)
+{
+   uint8_t buffer[16384];
+   const uint8_t *data = (const uint8_t*)game->data;
+   bool matches = false;
+   size_t offset, length;
+   FILE *file;
+
+   if (game->path == NULL || data == NULL || game->size < 4096
+    || !is_rom_signature(data))
+      return false;
+
+   file = fopen(game->path, "rb");
+   if (file == NULL)
+      return false;
+
+   if (fseek(file, 0L, SEEK_END) == 0 && ftell(file) == (long)game->size
+    && fseek(file, 0L, SEEK_SET) == 0)
+   {
+      matches = true;
+
+      for (offset = 0; matches && offset < game->size; offset += length)
+      {
+         length = game->size - offset;
+         if (length > sizeof(buffer))
+            length = sizeof(buffer);
+
+         matches = fread(buffer, 1, length, file) == length
+                && memcmp(buffer, data + offset, length) == 0;
+      }
+   }
+
+   fclose(file);
+   return matches;
+}
+#endif
+
 bool retro_load_game(const struct retro_game_info *game)
 {
    format_saved_memory();
@@ -1232,9 +1509,32 @@ bool retro_load_game(const struct retro_game_info *game)
          break;
    }
 
-   game_data = malloc(game->size);
-   game_size = game->size;
-   memcpy(game_data, game->data, game->size);
+   if (game->data == NULL)
+   {
+      /* content given by path only: map ROM files, read anything else
+       * (64DD disks) */
+#ifdef ROM_FILE_MAPPING
+      if (game_file_is_rom(game->path))
+         game_path = strdup(game->path);
+      else
+#endif
+      if (!read_game_file(game->path))
+      {
+         if (log_cb)
+            log_cb(RETRO_LOG_ERROR, "mupen64plus: Failed to read %s\n", game->path);
+         return false;
+      }
+   }
+#ifdef ROM_FILE_MAPPING
+   else if (game_file_matches(game))
+      game_path = strdup(game->path);
+#endif
+   else
+   {
+      game_data = malloc(game->size);
+      memcpy(game_data, game->data, game->size);
+      game_size = game->size;
+   }
 
    stop      = false;
    /* Finish ROM load before doing anything funny,
@@ -1252,6 +1552,31 @@ bool retro_load_game(const struct retro_game_info *game)
 
 void retro_unload_game(void)
 {
+    struct hle_task_cache_stats_t stats;
+
+    hle_get_task_cache_stats(&stats);
+    if (stats.hits + stats.misses)
+       log_cb(RETRO_LOG_INFO, "HLE task cache: %llu hits, %llu misses, %llu evictions\n",
+             (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+             (unsigned long long)stats.evictions);
+
+#ifdef NEW_DYNAREC
+    {
+       struct new_dynarec_stats dstats;
+
+       new_dynarec_get_stats(&dstats);
+       if (dstats.blocks_compiled)
+          log_cb(RETRO_LOG_INFO, "Dynarec: %llu blocks compiled, %llu bytes emitted, %llu segment evictions, %llu flushes\n",
+                (unsigned long long)dstats.blocks_compiled, (unsigned long long)dstats.bytes_emitted,
+                (unsigned long long)dstats.evictions, (unsigned long long)dstats.flushes);
+       if (dstats.lookups)
+          log_cb(RETRO_LOG_INFO, "Dynarec lookups: %llu hash misses (%llu L2 hits, %llu list hits), %llu inline caches, %llu inline cache misses\n",
+                (unsigned long long)dstats.lookups, (unsigned long long)dstats.l2_hits,
+                (unsigned long long)dstats.list_hits, (unsigned long long)dstats.jr_ic_sites,
+                (unsigned long long)dstats.jr_ic_misses);
+    }
+#endif
+
     stop = 1;
     first_time = 1;
 
@@ -1429,6 +1754,8 @@ void retro_run (void)
             break;
       }
    } while (emu_step_render());
+
+   process_audio_libretro();
 }
 
 void retro_reset (void)
@@ -1458,12 +1785,36 @@ size_t retro_serialize_size (void)
     return 16788288 + 1024; /* < 16MB and some change... ouch */
 }
 
+static bool serialize_incremental(void)
+{
+    int context = RETRO_SAVESTATE_CONTEXT_NORMAL;
+
+    if (incremental_savestates == INCREMENTAL_SAVESTATES_DISABLED)
+       return false;
+
+    /* a delta is only valid against this instance's base history, so only
+     * when the frontend says the state stays within this instance; states
+     * which may end up on disk or in another instance are always full */
+    if (!environ_cb(RETRO_ENVIRONMENT_GET_SAVESTATE_CONTEXT, &context))
+       return false;
+    return context == RETRO_SAVESTATE_CONTEXT_RUNAHEAD_SAME_INSTANCE;
+}
+
 bool retro_serialize(void *data, size_t size)
 {
     if (initializing)
        return false;
 
-    if (savestates_save_m64p(data, size))
+    /* the RDP thread may still be writing RDRAM */
+    if (gfx_plugin == GFX_ANGRYLION)
+       rdp_wait_idle();
+
+    if (serialize_incremental())
+    {
+       if (savestates_save_m64p_incremental(data, size))
+          return true;
+    }
+    else if (savestates_save_m64p(data, size))
         return true;
 
     return false;
@@ -1474,6 +1825,9 @@ bool retro_unserialize(const void * data, size_t size)
     if (initializing)
        return false;
 
+    if (gfx_plugin == GFX_ANGRYLION)
+       rdp_wait_idle();
+
     if (savestates_load_m64p(data, size))
         return true;
 
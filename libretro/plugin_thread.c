@@ -0,0 +1,212 @@
+#include <stdlib.h>
+
+#include "plugin_thread.h"
+
+#ifdef PLUGIN_THREADS
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+struct plugin_thread
+{
+#ifdef _WIN32
+   HANDLE handle;
+   DWORD id;
+#else
+   pthread_t handle;
+#endif
+   void (*entry)(void *);
+   void *data;
+};
+
+struct plugin_mutex
+{
+#ifdef _WIN32
+   CRITICAL_SECTION cs;
+#else
+   pthread_mutex_t mutex;
+#endif
+};
+
+struct plugin_cond
+{
+#ifdef _WIN32
+   CONDITION_VARIABLE cv;
+#else
+   pthread_cond_t cond;
+#endif
+};
+
+#ifdef _WIN32
+static DWORD WINAPI thread_wrapper(void *data)
+#else
+static void *thread_wrapper(void *data)
+#endif
+{
+   plugin_thread_t *thread = (plugin_thread_t*)data;
+   thread->entry(thread->data);
+   return 0;
+}
+
+plugin_thread_t *plugin_thread_create(void (*entry)(void *), void *data)
+{
+   plugin_thread_t *thread = (plugin_thread_t*)calloc(1, sizeof(*thread));
+
+   if (!thread)
+      return NULL;
+
+   thread->entry = entry;
+   thread->data  = data;
+
+#ifdef _WIN32
+   thread->handle = CreateThread(NULL, 0, thread_wrapper, thread, 0, &thread->id);
+   if (!thread->handle)
+#else
+   if (pthread_create(&thread->handle, NULL, thread_wrapper, thread) != 0)
+#endif
+   {
+      free(thread);
+      return NULL;
+   }
+
+   return thread;
+}
+
+void plugin_thread_join(plugin_thread_t *thread)
+{
+   if (!thread)
+      return;
+
+#ifdef _WIN32
+   WaitForSingleObject(thread->handle, INFINITE);
+   CloseHandle(thread->handle);
+#else
+   pthread_join(thread->handle, NULL);
+#endif
+   free(thread);
+}
+
+int plugin_thread_is_current(const plugin_thread_t *thread)
+{
+   if (!thread)
+      return 0;
+
+#ifdef _WIN32
+   return GetCurrentThreadId() == thread->id;
+#else
+   return pthread_equal(pthread_self(), thread->handle);
+#endif
+}
+
+plugin_mutex_t *plugin_mutex_new(void)
+{
+   plugin_mutex_t *mutex = (plugin_mutex_t*)calloc(1, sizeof(*mutex));
+
+   if (!mutex)
+      return NULL;
+
+#ifdef _WIN32
+   InitializeCriticalSection(&mutex->cs);
+#else
+   if (pthread_mutex_init(&mutex->mutex, NULL) != 0)
+   {
+      free(mutex);
+      return NULL;
+   }
+#endif
+   return mutex;
+}
+
+void plugin_mutex_free(plugin_mutex_t *mutex)
+{
+   if (!mutex)
+      return;
+
+#ifdef _WIN32
+   DeleteCriticalSection(&mutex->cs);
+#else
+   pthread_mutex_destroy(&mutex->mutex);
+#endif
+   free(mutex);
+}
+
+void plugin_mutex_lock(plugin_mutex_t *mutex)
+{
+#ifdef _WIN32
+   EnterCriticalSection(&mutex->cs);
+#else
+   pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+void plugin_mutex_unlock(plugin_mutex_t *mutex)
+{
+#ifdef _WIN32
+   LeaveCriticalSection(&mutex->cs);
+#else
+   pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+plugin_cond_t *plugin_cond_new(void)
+{
+   plugin_cond_t *cond = (plugin_cond_t*)calloc(1, sizeof(*cond));
+
+   if (!cond)
+      return NULL;
+
+#ifdef _WIN32
+   InitializeConditionVariable(&cond->cv);
+#else
+   if (pthread_cond_init(&cond->cond, NULL) != 0)
+   {
+      free(cond);
+      return NULL;
+   }
+#endif
+   return cond;
+}
+
+void plugin_cond_free(plugin_cond_t *cond)
+{
+   if (!cond)
+      return;
+
+#ifndef _WIN32
+   pthread_cond_destroy(&cond->cond);
+#endif
+   free(cond);
+}
+
+void plugin_cond_wait(plugin_cond_t *cond, plugin_mutex_t *mutex)
+{
+#ifdef _WIN32
+   SleepConditionVariableCS(&cond->cv, &mutex->cs, INFINITE);
+#else
+   pthread_cond_wait(&cond->cond, &mutex->mutex);
+#endif
+}
+
+void plugin_cond_signal(plugin_cond_t *cond)
+{
+#ifdef _WIN32
+   WakeConditionVariable(&cond->cv);
+#else
+   pthread_cond_signal(&cond->cond);
+#endif
+}
+
+void plugin_cond_broadcast(plugin_cond_t *cond)
+{
+#ifdef _WIN32
+   WakeAllConditionVariable(&cond->cv);
+#else
+   pthread_cond_broadcast(&cond->cond);
+#endif
+}
+
+#endif
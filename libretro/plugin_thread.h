@@ -0,0 +1,59 @@
+#ifndef _LIBRETRO_PLUGIN_THREAD_H
+#define _LIBRETRO_PLUGIN_THREAD_H
+
+/* Minimal threading primitives shared by the plugins (angrylion's RDP
+ * threads, the rsp-hle task worker).
+ *
+ * Joinable threads, a mutex and a condition variable: pthreads everywhere
+ * except Windows, which uses the native Vista+ condition variables. Builds
+ * without thread support (HAVE_THREADS unset on non-Windows targets) get
+ * no PLUGIN_THREADS, and the plugins then run everything on the caller. */
+
+#if defined(HAVE_THREADS) || defined(_WIN32)
+#define PLUGIN_THREADS
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef PLUGIN_THREADS
+
+#if defined(_MSC_VER)
+#define PLUGIN_TLS __declspec(thread)
+#else
+#define PLUGIN_TLS __thread
+#endif
+
+typedef struct plugin_thread plugin_thread_t;
+typedef struct plugin_mutex plugin_mutex_t;
+typedef struct plugin_cond plugin_cond_t;
+
+plugin_thread_t *plugin_thread_create(void (*entry)(void *), void *data);
+void plugin_thread_join(plugin_thread_t *thread);
+
+/* non-zero when called from thread */
+int plugin_thread_is_current(const plugin_thread_t *thread);
+
+plugin_mutex_t *plugin_mutex_new(void);
+void plugin_mutex_free(plugin_mutex_t *mutex);
+void plugin_mutex_lock(plugin_mutex_t *mutex);
+void plugin_mutex_unlock(plugin_mutex_t *mutex);
+
+plugin_cond_t *plugin_cond_new(void);
+void plugin_cond_free(plugin_cond_t *cond);
+void plugin_cond_wait(plugin_cond_t *cond, plugin_mutex_t *mutex);
+void plugin_cond_signal(plugin_cond_t *cond);
+void plugin_cond_broadcast(plugin_cond_t *cond);
+
+#else
+
+#define PLUGIN_TLS
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
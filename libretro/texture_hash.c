@@ -0,0 +1,278 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <retro_inline.h>
+#include <boolean.h>
+
+#include "libretro_private.h"
+#include "texture_hash.h"
+
+#if !defined(MSB_FIRST) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+#define TEXTURE_HASH_SSE42
+#include <nmmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define SSE42_TARGET __attribute__((target("sse4.2")))
+#else
+#define SSE42_TARGET
+#endif
+#endif
+
+#if !defined(MSB_FIRST) && defined(__ARM_FEATURE_CRC32)
+#define TEXTURE_HASH_ARM_CRC
+#include <arm_acle.h>
+#endif
+
+#define CRC32_POLYNOMIAL  0xEDB88320
+#define CRC32C_POLYNOMIAL 0x82F63B78
+
+static uint32_t crc32_table[8][256];
+static uint32_t crc32c_table[8][256];
+static bool texture_hash_ready = false;
+static bool texture_hash_sse42 = false;
+static enum texture_hash_mode texture_hash_current_mode = TEXTURE_HASH_CRC32C;
+
+static void build_table(uint32_t table[8][256], uint32_t polynomial)
+{
+   int i, j;
+
+   for (i = 0; i < 256; i++)
+   {
+      uint32_t crc = i;
+      for (j = 0; j < 8; j++)
+         crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+      table[0][i] = crc;
+   }
+
+   for (j = 1; j < 8; j++)
+      for (i = 0; i < 256; i++)
+         table[j][i] = (table[j - 1][i] >> 8) ^ table[0][table[j - 1][i] & 0xFF];
+}
+
+static void texture_hash_init(void)
+{
+   uint64_t cpu = 0;
+
+   build_table(crc32_table, CRC32_POLYNOMIAL);
+   build_table(crc32c_table, CRC32C_POLYNOMIAL);
+
+   if (perf_get_cpu_features_cb)
+      cpu = perf_get_cpu_features_cb();
+   texture_hash_sse42 = (cpu & RETRO_SIMD_SSE42) != 0;
+
+   texture_hash_ready = true;
+}
+
+/* Endian independent loads, compilers turn these into plain loads. */
+static INLINE uint32_t read32le(const uint8_t *p)
+{
+   return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static INLINE uint64_t read64le(const uint8_t *p)
+{
+   return (uint64_t)read32le(p) | ((uint64_t)read32le(p + 4) << 32);
+}
+
+/* Slicing-by-8 */
+static uint32_t crc_slice8(uint32_t table[8][256], uint32_t crc, const uint8_t *p, size_t len)
+{
+   while (len >= 8)
+   {
+      uint32_t one = read32le(p) ^ crc;
+      uint32_t two = read32le(p + 4);
+      crc = table[7][ one        & 0xFF] ^
+            table[6][(one >>  8) & 0xFF] ^
+            table[5][(one >> 16) & 0xFF] ^
+            table[4][ one >> 24        ] ^
+            table[3][ two        & 0xFF] ^
+            table[2][(two >>  8) & 0xFF] ^
+            table[1][(two >> 16) & 0xFF] ^
+            table[0][ two >> 24        ];
+      p   += 8;
+      len -= 8;
+   }
+
+   while (len--)
+      crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xFF];
+
+   return crc;
+}
+
+#ifdef TEXTURE_HASH_SSE42
+SSE42_TARGET static uint32_t crc32c_sse42(uint32_t crc, const uint8_t *p, size_t len)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+   uint64_t crc64 = crc;
+   while (len >= 8)
+   {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      crc64 = _mm_crc32_u64(crc64, v);
+      p   += 8;
+      len -= 8;
+   }
+   crc = (uint32_t)crc64;
+#endif
+   while (len >= 4)
+   {
+      uint32_t v;
+      memcpy(&v, p, sizeof(v));
+      crc  = _mm_crc32_u32(crc, v);
+      p   += 4;
+      len -= 4;
+   }
+   while (len--)
+      crc = _mm_crc32_u8(crc, *p++);
+   return crc;
+}
+#endif
+
+#ifdef TEXTURE_HASH_ARM_CRC
+static uint32_t crc32_arm(uint32_t crc, const uint8_t *p, size_t len, bool castagnoli)
+{
+   while (len >= 8)
+   {
+      uint64_t v;
+      memcpy(&v, p, sizeof(v));
+      crc  = castagnoli ? __crc32cd(crc, v) : __crc32d(crc, v);
+      p   += 8;
+      len -= 8;
+   }
+   while (len--)
+   {
+      crc = castagnoli ? __crc32cb(crc, *p) : __crc32b(crc, *p);
+      p++;
+   }
+   return crc;
+}
+#endif
+
+uint32_t texture_hash_crc32(uint32_t crc, const void *data, size_t len)
+{
+   if (!texture_hash_ready)
+      texture_hash_init();
+
+#ifdef TEXTURE_HASH_ARM_CRC
+   return crc32_arm(crc, (const uint8_t*)data, len, false);
+#else
+   return crc_slice8(crc32_table, crc, (const uint8_t*)data, len);
+#endif
+}
+
+uint32_t texture_hash_crc32c(uint32_t crc, const void *data, size_t len)
+{
+   if (!texture_hash_ready)
+      texture_hash_init();
+
+#if defined(TEXTURE_HASH_ARM_CRC)
+   return crc32_arm(crc, (const uint8_t*)data, len, true);
+#else
+#if defined(TEXTURE_HASH_SSE42)
+   if (texture_hash_sse42)
+      return crc32c_sse42(crc, (const uint8_t*)data, len);
+#endif
+   return crc_slice8(crc32c_table, crc, (const uint8_t*)data, len);
+#endif
+}
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static INLINE uint64_t rotl64(uint64_t x, int r)
+{
+   return (x << r) | (x >> (64 - r));
+}
+
+static INLINE uint64_t xxh64_round(uint64_t acc, uint64_t input)
+{
+   acc += input * XXH_PRIME64_2;
+   acc  = rotl64(acc, 31);
+   return acc * XXH_PRIME64_1;
+}
+
+static INLINE uint64_t xxh64_merge(uint64_t acc, uint64_t val)
+{
+   acc ^= xxh64_round(0, val);
+   return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t texture_hash_64(uint64_t seed, const void *data, size_t len)
+{
+   const uint8_t *p   = (const uint8_t*)data;
+   const uint8_t *end = p + len;
+   uint64_t h;
+
+   if (len >= 32)
+   {
+      uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+      uint64_t v2 = seed + XXH_PRIME64_2;
+      uint64_t v3 = seed;
+      uint64_t v4 = seed - XXH_PRIME64_1;
+
+      do
+      {
+         v1 = xxh64_round(v1, read64le(p));
+         v2 = xxh64_round(v2, read64le(p + 8));
+         v3 = xxh64_round(v3, read64le(p + 16));
+         v4 = xxh64_round(v4, read64le(p + 24));
+         p += 32;
+      } while (p + 32 <= end);
+
+      h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+      h = xxh64_merge(h, v1);
+      h = xxh64_merge(h, v2);
+      h = xxh64_merge(h, v3);
+      h = xxh64_merge(h, v4);
+   }
+   else
+      h = seed + XXH_PRIME64_5;
+
+   h += (uint64_t)len;
+
+   while (p + 8 <= end)
+   {
+      h ^= xxh64_round(0, read64le(p));
+      h  = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+      p += 8;
+   }
+
+   if (p + 4 <= end)
+   {
+      h ^= (uint64_t)read32le(p) * XXH_PRIME64_1;
+      h  = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+      p += 4;
+   }
+
+   while (p < end)
+   {
+      h ^= (*p++) * XXH_PRIME64_5;
+      h  = rotl64(h, 11) * XXH_PRIME64_1;
+   }
+
+   h ^= h >> 33;
+   h *= XXH_PRIME64_2;
+   h ^= h >> 29;
+   h *= XXH_PRIME64_3;
+   h ^= h >> 32;
+   return h;
+}
+
+void texture_hash_set_mode(enum texture_hash_mode mode)
+{
+   texture_hash_current_mode = mode;
+}
+
+uint32_t texture_hash(uint32_t seed, const void *data, size_t len)
+{
+   if (texture_hash_current_mode == TEXTURE_HASH_FAST64)
+   {
+      uint64_t h = texture_hash_64(seed, data, len);
+      return (uint32_t)(h ^ (h >> 32));
+   }
+
+   return texture_hash_crc32c(seed, data, len);
+}
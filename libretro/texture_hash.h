@@ -0,0 +1,45 @@
+#ifndef _LIBRETRO_TEXTURE_HASH_H
+#define _LIBRETRO_TEXTURE_HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Texture hashing shared by the GL video plugins.
+ *
+ * The CRC functions update a raw (non-inverted) reflected CRC state, the
+ * same way the table loops in the plugins always did, so callers that
+ * depend on the exact value (microcode detection, hi-res texture packs)
+ * can use texture_hash_crc32 without changing results.
+ *
+ * texture_hash is only meant for cache keys: its value depends on the
+ * selected mode and may change between versions. */
+
+enum texture_hash_mode
+{
+   TEXTURE_HASH_CRC32C = 0, /* SSE4.2 / ARMv8 CRC32C, slicing-by-8 otherwise */
+   TEXTURE_HASH_FAST64      /* 64-bit XXH64, folded to 32 bits */
+};
+
+void texture_hash_set_mode(enum texture_hash_mode mode);
+
+/* CRC-32 (IEEE 802.3, zlib polynomial) */
+uint32_t texture_hash_crc32(uint32_t crc, const void *data, size_t len);
+
+/* CRC-32C (Castagnoli) */
+uint32_t texture_hash_crc32c(uint32_t crc, const void *data, size_t len);
+
+/* XXH64 */
+uint64_t texture_hash_64(uint64_t seed, const void *data, size_t len);
+
+/* Cache key hash, chained through seed. */
+uint32_t texture_hash(uint32_t seed, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -215,6 +215,11 @@ EXPORT void CALL FBWrite(uint32_t addr, uint32_t size);
 EXPORT void CALL FBGetFrameBufferInfo(void *p);
 #endif
 
+/* RDRAM write map extension, optional for video and RSP plugins.
+ * The plugin stores 1 into map[address >> 12] for every RDRAM page it
+ * writes, so the core doesn't need to scan RDRAM for its changes */
+typedef void (*ptr_SetRdramWriteMap)(unsigned char *map);
+
 /* audio plugin function pointers */
 typedef void (*ptr_AiDacrateChanged)(int SystemType);
 typedef void (*ptr_AiLenChanged)(void);
@@ -256,6 +261,9 @@ EXPORT void CALL ReadController(int Control, uint8_t *Command);
 /* RSP plugin function pointers */
 typedef uint32_t (*ptr_DoRspCycles)(uint32_t Cycles);
 typedef void (*ptr_InitiateRSP)(RSP_INFO Rsp_Info, uint32_t *CycleCount);
+/* optional, for plugins finishing tasks on another thread */
+typedef void (*ptr_SyncTask)(void);
+typedef uint32_t (*ptr_AsyncTaskCycles)(void);
 #if defined(M64P_PLUGIN_PROTOTYPES)
 EXPORT uint32_t CALL DoRspCycles(uint32_t Cycles);
 EXPORT void CALL InitiateRSP(RSP_INFO Rsp_Info, uint32_t *CycleCount);
@@ -295,6 +295,7 @@ uint32 read_memory_32(uint32 addr){
     case M64P_MEM_RSPMEM:
       return g_sp.mem[rsp_mem_address(addr)];
     case M64P_MEM_ROM:
+      touch_rom(rom_address(addr), 4);
       return *((uint32 *)(g_rom + rom_address(addr)));
     case M64P_MEM_RDRAMREG:
       offset = RDRAM_REG(addr);
@@ -374,6 +375,7 @@ void write_memory_32(uint32 addr, uint32 value){
     {
     case M64P_MEM_RDRAM:
        g_rdram[(addr & 0xFFFFFF) >> 2] = value;
+       mark_rdram_dirty(&g_ri.rdram, addr, 4, RDRAM_DIRTY_WRITES);
       CHECK_MEM(addr)
       break;
     }
@@ -27,6 +27,7 @@
 #include "api/config.h"
 
 #include "memory/memory.h"
+#include "ri/ri_controller.h"
 #include "cheat.h"
 #include "main.h"
 #include "rom.h"
@@ -76,11 +77,13 @@ static uint8_t read_address_8bit(unsigned int address)
 static void update_address_16bit(unsigned int address, unsigned short new_value)
 {
     *(uint16_t *)(((uint8_t*)g_rdram + ((address & 0xFFFFFF)^S16))) = new_value;
+    mark_rdram_dirty(&g_ri.rdram, address, 2, RDRAM_DIRTY_WRITES);
 }
 
 static void update_address_8bit(unsigned int address, unsigned char new_value)
 {
      *(uint8_t *)(((uint8_t*)g_rdram + ((address & 0xFFFFFF)^S8))) = new_value;
+     mark_rdram_dirty(&g_ri.rdram, address, 1, RDRAM_DIRTY_WRITES);
 }
 
 static int address_equal_to_8bit(unsigned int address, unsigned char value)
@@ -264,6 +264,8 @@ void mupen_main_exit(void)
    if (input.romClosed) input.romClosed();
    if (gfx.romClosed) gfx.romClosed();
 
+   savestates_clear_incremental();
+
    // clean up
    g_EmulatorRunning = 0;
    StateChanged(M64CORE_EMU_STATE, M64EMU_STOPPED);
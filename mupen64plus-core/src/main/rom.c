@@ -41,6 +41,16 @@
 
 #include "../r4300/r4300.h"
 
+#ifdef ROM_FILE_MAPPING
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
 #define DEFAULT 16
 
 /* Global loaded rom memory space. */
@@ -127,19 +137,25 @@ static int is_valid_rom(const unsigned char *buffer)
       return 0;
 }
 
-/* If rom is a .v64 or .n64 image, byteswap or wordswap loadlength amount of
- * rom data to native .z64 before forwarding. Makes sure that data extraction
- * and MD5ing routines always deal with a .z64 image.
- */
-static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int loadlength)
+static unsigned char rom_image_type(const unsigned char* localrom)
+{
+   if(localrom[0]==0x37)
+      return V64IMAGE;
+   else if(localrom[0]==0x40)
+      return N64IMAGE;
+   else
+      return Z64IMAGE;
+}
+
+/* Byteswap or wordswap loadlength amount of imagetype rom data to .z64 */
+static void swap_rom_data(unsigned char* localrom, unsigned char imagetype, int loadlength)
 {
    unsigned char temp;
    int i;
 
    /* Btyeswap if .v64 image. */
-   if(localrom[0]==0x37)
+   if(imagetype == V64IMAGE)
    {
-      *imagetype = V64IMAGE;
       for (i = 0; i < loadlength; i+=2)
       {
          temp=localrom[i];
@@ -148,9 +164,8 @@ static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int load
       }
    }
    /* Wordswap if .n64 image. */
-   else if(localrom[0]==0x40)
+   else if(imagetype == N64IMAGE)
    {
-      *imagetype = N64IMAGE;
       for (i = 0; i < loadlength; i+=4)
       {
          temp=localrom[i];
@@ -161,54 +176,108 @@ static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int load
          localrom[i+2]=temp;
       }
    }
-   else
-      *imagetype = Z64IMAGE;
 }
 
-m64p_error open_rom(const unsigned char* romimage, unsigned int size)
+/* If rom is a .v64 or .n64 image, byteswap or wordswap loadlength amount of
+ * rom data to native .z64 before forwarding. Makes sure that data extraction
+ * and MD5ing routines always deal with a .z64 image.
+ */
+static void swap_rom(unsigned char* localrom, unsigned char* imagetype, int loadlength)
 {
-#include "rom_luts.c"
-   md5_state_t state;
-   md5_byte_t digest[16];
-   char buffer[256];
-   unsigned char imagetype;
-   int i;
-   uint64_t lut_id;
-   int patch_applied = 0;
+   *imagetype = rom_image_type(localrom);
+   swap_rom_data(localrom, *imagetype, loadlength);
+}
 
-   /* check input requirements */
-   if (g_rom != NULL)
+#ifdef ROM_FILE_MAPPING
+/* Memory-mapped ROM files
+ *
+ * Instead of being copied, a ROM file is mapped read-only. The emulator
+ * wants the ROM as .z64 with each 32-bit word byte-reversed (see the
+ * swap_buffer done in main.c), which is exactly the .n64 layout: such files
+ * are used in place on little-endian hosts, the only ones this was checked
+ * on. Other layouts, and every layout on big-endian hosts, are swapped (or
+ * just copied) one 4KB page at a time into an anonymous mapping, the first
+ * time something touches the page.
+ */
+enum { ROM_SWAP_NONE, ROM_SWAP_WORDS, ROM_SWAP_HALFWORDS };
+
+static struct
+{
+   unsigned char* file;
+   size_t file_size;
+   /* anonymous mapping holding swapped pages, NULL if file is used in place */
+   unsigned char* pages;
+   size_t pages_size;
+   unsigned char* loaded;
+   size_t loaded_count;
+   int swap;
+} l_rom_map;
+#endif
+
+/* Non-NULL while some ROM pages are still to be loaded, see touch_rom */
+unsigned char* g_rom_pages_loaded = NULL;
+
+#ifdef ROM_FILE_MAPPING
+static void load_rom_page(size_t page)
+{
+   size_t offset = page << ROM_PAGE_SHIFT;
+   size_t length = l_rom_map.file_size - offset;
+   uint32_t* words = (uint32_t*)(l_rom_map.pages + offset);
+   size_t i;
+
+   if (length > ((size_t)1 << ROM_PAGE_SHIFT))
+      length = (size_t)1 << ROM_PAGE_SHIFT;
+
+   memcpy(words, l_rom_map.file + offset, length);
+
+   if (l_rom_map.swap == ROM_SWAP_WORDS)
+      swap_buffer(words, 4, length / 4);
+   else if (l_rom_map.swap == ROM_SWAP_HALFWORDS)
    {
-      DebugMessage(M64MSG_ERROR, "open_rom(): previous ROM image was not freed");
-      return M64ERR_INTERNAL;
+      for (i = 0; i < length / 4; ++i)
+         words[i] = (words[i] << 16) | (words[i] >> 16);
    }
-   if (romimage == NULL || !is_valid_rom(romimage))
+
+   g_rom_pages_loaded[page] = 1;
+
+   /* once everything is there, get out of the way of touch_rom */
+   if (++l_rom_map.loaded_count == l_rom_map.pages_size >> ROM_PAGE_SHIFT)
    {
-      DebugMessage(M64MSG_ERROR, "open_rom(): not a valid ROM image");
-      return M64ERR_INPUT_INVALID;
+      free(g_rom_pages_loaded);
+      g_rom_pages_loaded = NULL;
    }
+}
+#endif
 
-   /* Clear Byte-swapped flag, since ROM is now deleted. */
-   g_MemHasBeenBSwapped = 0;
-   /* allocate new buffer for ROM and copy into this buffer */
-   g_rom_size = size;
-   g_rom = (unsigned char *) malloc(size);
-   alternate_vi_timing = 0;
-   if (g_rom == NULL)
-      return M64ERR_NO_MEMORY;
-   memcpy(g_rom, romimage, size);
-   swap_rom(g_rom, &imagetype, g_rom_size);
+void load_rom_pages(uint32_t offset, size_t length)
+{
+#ifdef ROM_FILE_MAPPING
+   size_t page, last;
 
-   memcpy(&ROM_HEADER, g_rom, sizeof(m64p_rom_header));
+   if (g_rom_pages_loaded == NULL || offset >= (uint32_t)g_rom_size || length == 0)
+      return;
 
-   /* Calculate MD5 hash  */
-   md5_init(&state);
-   md5_append(&state, (const md5_byte_t*)g_rom, g_rom_size);
-   md5_finish(&state, digest);
-   for ( i = 0; i < 16; ++i )
-      sprintf(buffer+i*2, "%02X", digest[i]);
-   buffer[32] = '\0';
-   strcpy(ROM_SETTINGS.MD5, buffer);
+   if (length > g_rom_size - offset)
+      length = g_rom_size - offset;
+
+   last = (offset + length - 1) >> ROM_PAGE_SHIFT;
+
+   for (page = offset >> ROM_PAGE_SHIFT; page <= last && g_rom_pages_loaded != NULL; ++page)
+   {
+      if (!g_rom_pages_loaded[page])
+         load_rom_page(page);
+   }
+#endif
+}
+
+/* Fills ROM_PARAMS and ROM_SETTINGS once ROM_HEADER and the MD5 are known */
+static void setup_rom_settings(unsigned char imagetype)
+{
+#include "rom_luts.c"
+   char buffer[256];
+   int i;
+   uint64_t lut_id;
+   int patch_applied = 0;
 
    /* add some useful properties to ROM_PARAMS */
    ROM_PARAMS.systemtype = rom_country_code_to_system_type(ROM_HEADER.destination_code);
@@ -345,8 +414,178 @@ m64p_error open_rom(const unsigned char* romimage, unsigned int size)
    isGoldeneyeRom = 0;
    if(strcmp(ROM_PARAMS.headername, "GOLDENEYE") == 0)
       isGoldeneyeRom = 1;
+}
+
+m64p_error open_rom(const unsigned char* romimage, unsigned int size)
+{
+   md5_state_t state;
+   md5_byte_t digest[16];
+   char buffer[256];
+   unsigned char imagetype;
+   int i;
+
+   /* check input requirements */
+   if (g_rom != NULL)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom(): previous ROM image was not freed");
+      return M64ERR_INTERNAL;
+   }
+   if (romimage == NULL || !is_valid_rom(romimage))
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom(): not a valid ROM image");
+      return M64ERR_INPUT_INVALID;
+   }
+
+   /* Clear Byte-swapped flag, since ROM is now deleted. */
+   g_MemHasBeenBSwapped = 0;
+   /* allocate new buffer for ROM and copy into this buffer */
+   g_rom_size = size;
+   g_rom = (unsigned char *) malloc(size);
+   alternate_vi_timing = 0;
+   if (g_rom == NULL)
+      return M64ERR_NO_MEMORY;
+   memcpy(g_rom, romimage, size);
+   swap_rom(g_rom, &imagetype, g_rom_size);
+
+   memcpy(&ROM_HEADER, g_rom, sizeof(m64p_rom_header));
+
+   /* Calculate MD5 hash  */
+   md5_init(&state);
+   md5_append(&state, (const md5_byte_t*)g_rom, g_rom_size);
+   md5_finish(&state, digest);
+   for ( i = 0; i < 16; ++i )
+      sprintf(buffer+i*2, "%02X", digest[i]);
+   buffer[32] = '\0';
+   strcpy(ROM_SETTINGS.MD5, buffer);
+
+   setup_rom_settings(imagetype);
+
+   return M64ERR_SUCCESS;
+}
+
+m64p_error open_rom_file(const char* path)
+{
+#ifdef ROM_FILE_MAPPING
+   md5_state_t state;
+   md5_byte_t digest[16];
+   unsigned char chunk[1 << ROM_PAGE_SHIFT];
+   char buffer[256];
+   unsigned char imagetype;
+   unsigned char* file;
+   struct stat st;
+   size_t offset, size;
+   int fd, i;
+
+   /* check input requirements */
+   if (g_rom != NULL)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): previous ROM image was not freed");
+      return M64ERR_INTERNAL;
+   }
+
+   fd = open(path, O_RDONLY);
+   if (fd < 0)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): couldn't open %s", path);
+      return M64ERR_FILES;
+   }
+
+   if (fstat(fd, &st) != 0 || st.st_size < 4096)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): not a valid ROM image");
+      close(fd);
+      return M64ERR_INPUT_INVALID;
+   }
+
+   size = st.st_size;
+   file = (unsigned char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+
+   if (file == MAP_FAILED)
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): couldn't map %s", path);
+      return M64ERR_FILES;
+   }
+
+   if (!is_valid_rom(file))
+   {
+      DebugMessage(M64MSG_ERROR, "open_rom_file(): not a valid ROM image");
+      munmap(file, size);
+      return M64ERR_INPUT_INVALID;
+   }
+
+   imagetype = rom_image_type(file);
+   l_rom_map.file = file;
+   l_rom_map.file_size = size;
+
+#ifndef MSB_FIRST
+   if (imagetype == N64IMAGE)
+      g_rom = file;
+   else
+#endif
+   {
+      l_rom_map.pages_size = (size + (1 << ROM_PAGE_SHIFT) - 1) & ~(size_t)((1 << ROM_PAGE_SHIFT) - 1);
+      l_rom_map.pages = (unsigned char*)mmap(NULL, l_rom_map.pages_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      l_rom_map.loaded_count = 0;
+      if (imagetype == Z64IMAGE)
+         l_rom_map.swap = ROM_SWAP_WORDS;
+      else if (imagetype == V64IMAGE)
+         l_rom_map.swap = ROM_SWAP_HALFWORDS;
+      else
+         l_rom_map.swap = ROM_SWAP_NONE;
+      g_rom_pages_loaded = (unsigned char*)calloc(l_rom_map.pages_size >> ROM_PAGE_SHIFT, 1);
+
+      if (l_rom_map.pages == MAP_FAILED || g_rom_pages_loaded == NULL)
+      {
+         if (l_rom_map.pages != MAP_FAILED)
+            munmap(l_rom_map.pages, l_rom_map.pages_size);
+         free(g_rom_pages_loaded);
+         g_rom_pages_loaded = NULL;
+         munmap(file, size);
+         memset(&l_rom_map, 0, sizeof(l_rom_map));
+         return M64ERR_NO_MEMORY;
+      }
+
+      g_rom = l_rom_map.pages;
+   }
+
+   g_rom_size = size;
+   alternate_vi_timing = 0;
+   /* pages are produced already swapped, main.c must not swap them again */
+   g_MemHasBeenBSwapped = 1;
+
+   /* header and boot code are read through g_rom directly */
+   load_rom_pages(0, 0x1000);
+
+   /* Calculate MD5 hash over the .z64 image without keeping a copy of it */
+   md5_init(&state);
+   for (offset = 0; offset < size; offset += sizeof(chunk))
+   {
+      size_t length = size - offset;
+      if (length > sizeof(chunk))
+         length = sizeof(chunk);
+
+      memcpy(chunk, file + offset, length);
+      swap_rom_data(chunk, imagetype, length);
+
+      if (offset == 0)
+         memcpy(&ROM_HEADER, chunk, sizeof(m64p_rom_header));
+
+      md5_append(&state, (const md5_byte_t*)chunk, length);
+   }
+   md5_finish(&state, digest);
+   for ( i = 0; i < 16; ++i )
+      sprintf(buffer+i*2, "%02X", digest[i]);
+   buffer[32] = '\0';
+   strcpy(ROM_SETTINGS.MD5, buffer);
+
+   setup_rom_settings(imagetype);
 
    return M64ERR_SUCCESS;
+#else
+   return M64ERR_UNSUPPORTED;
+#endif
 }
 
 m64p_error close_rom(void)
@@ -354,7 +593,19 @@ m64p_error close_rom(void)
    if (g_rom == NULL)
       return M64ERR_INVALID_STATE;
 
-   free(g_rom);
+#ifdef ROM_FILE_MAPPING
+   if (l_rom_map.file != NULL)
+   {
+      if (l_rom_map.pages != NULL)
+         munmap(l_rom_map.pages, l_rom_map.pages_size);
+      munmap(l_rom_map.file, l_rom_map.file_size);
+      free(g_rom_pages_loaded);
+      g_rom_pages_loaded = NULL;
+      memset(&l_rom_map, 0, sizeof(l_rom_map));
+   }
+   else
+#endif
+      free(g_rom);
    g_rom = NULL;
 
    /* Clear Byte-swapped flag, since ROM is now deleted. */
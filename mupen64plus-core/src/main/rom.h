@@ -23,17 +23,43 @@
 #ifndef __ROM_H__
 #define __ROM_H__
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <retro_inline.h>
+
 #include "api/m64p_types.h"
 #include "md5.h"
 
+/* ROM files can be memory-mapped, see open_rom_file */
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(EMSCRIPTEN)
+#define ROM_FILE_MAPPING
+#endif
+
 /* ROM Loading and Saving functions */
 
 m64p_error open_rom(const unsigned char* romimage, unsigned int size);
+m64p_error open_rom_file(const char* path);
 m64p_error close_rom(void);
 
 extern unsigned char* g_rom;
 extern int g_rom_size;
 
+/* A ROM opened with open_rom_file may have its pages loaded into g_rom on
+ * first use only. Code accessing g_rom directly has to touch_rom the bytes
+ * it reads first. */
+#define ROM_PAGE_SHIFT 12
+
+extern unsigned char* g_rom_pages_loaded;
+
+void load_rom_pages(uint32_t offset, size_t length);
+
+static INLINE void touch_rom(uint32_t offset, size_t length)
+{
+   if (g_rom_pages_loaded != NULL)
+      load_rom_pages(offset, length);
+}
+
 extern unsigned char isGoldeneyeRom;
 
 typedef struct _rom_params
@@ -42,7 +42,9 @@
 #include "../pi/pi_controller.h"
 #include "../plugin/plugin.h"
 #include "../r4300/r4300_core.h"
+#include "../r4300/tlb.h"
 #include "../rdp/rdp_core.h"
+#include "../ri/rdram.h"
 #include "../ri/ri_controller.h"
 #include "../rsp/rsp_core.h"
 #include "../si/si_controller.h"
@@ -50,6 +52,7 @@
 #include "osal/preproc.h"
 
 static const char* savestate_magic = "M64+SAVE";
+static const char* savestate_delta_magic = "M64+DLTA";
 static const int savestate_latest_version = 0x00010000;  /* 1.0 */
 
 #define GETARRAY(buff, type, count) \
@@ -68,6 +71,506 @@ static const int savestate_latest_version = 0x00010000;  /* 1.0 */
 #define PUTDATA(buff, type, value) \
     do { type x = value; PUTARRAY(&x, buff, type, 1); } while(0)
 
+/* Incremental savestates
+ *
+ * A full savestate copies the whole RDRAM and both TLB lookup tables
+ * (~16MB) each time. When states are only ever reloaded by the running
+ * instance (run-ahead, in-session rewind), these big arrays are instead
+ * stored as the list of 4KB pages which differ from a base snapshot kept
+ * in core memory.
+ *
+ * RDRAM pages written since the previous state are taken from the RDRAM
+ * dirty map (RDRAM_DIRTY_SAVESTATE, and plugin_written for the plugins
+ * reporting their writes). Pages are only compared against the base when
+ * some writer may have bypassed the map, see delta_writes_tracked.
+ *
+ * The base is refreshed once too many pages drifted away from it. The
+ * base pages it overwrites go to a history ring, so that incremental
+ * states taken against one of the previous bases can still be loaded
+ * until the ring wraps over that base.
+ */
+#define DELTA_PAGE_WORDS    (0x1000 / 4)
+#define DELTA_REBASE_RATIO  4    /* rebase once 1/4 of the pages differ */
+#define DELTA_HISTORY_PAGES 4096 /* 16MB of older base pages */
+
+enum { DELTA_RDRAM, DELTA_TLB_LUT_R, DELTA_TLB_LUT_W, DELTA_REGIONS_COUNT };
+
+struct delta_region
+{
+    uint32_t* data;
+    size_t pages;
+    uint32_t* base;
+    /* 1 if page may differ from base, valid as of the last delta_prepare */
+    unsigned char* changed;
+    size_t changed_count;
+    /* regions only modified through code which bumps this counter
+     * can skip page comparison when it didn't move. NULL otherwise */
+    const unsigned int* generation;
+    unsigned int last_generation;
+    /* RDRAM dirty map of the region, NULL if not RDRAM */
+    struct rdram* dirty_map;
+};
+
+/* a base page as it was before being refreshed by the rebase
+ * which made base_id + 1 the current base */
+struct delta_history_entry
+{
+    uint32_t base_id;
+    uint32_t region;
+    uint32_t page;
+};
+
+static struct
+{
+    struct delta_region regions[DELTA_REGIONS_COUNT];
+    uint32_t base_id;
+    /* incremental states against [oldest_base_id, base_id] can be loaded */
+    uint32_t oldest_base_id;
+    int initialized;
+
+    struct delta_history_entry* history;
+    uint32_t* history_data;
+    size_t history_next;
+    size_t history_count;
+} l_delta;
+
+/* Re-arms write tracking and returns 1 if every RDRAM write since the
+ * previous call was reported in the RDRAM dirty map */
+static int delta_writes_tracked(void)
+{
+    int tracked = track_r4300_rdram_writes();
+
+    return tracked
+        && gfx.setRdramWriteMap != NULL
+        && rsp.setRdramWriteMap != NULL;
+}
+
+/* clears the write reports of a page, returns 1 if there were any */
+static int delta_page_written(struct delta_region* r, size_t p)
+{
+    int written;
+
+    if (r->dirty_map == NULL)
+        return 0;
+
+    written = test_and_clear_rdram_dirty(r->dirty_map, (uint32_t)(p*DELTA_PAGE_WORDS*4), RDRAM_DIRTY_SAVESTATE);
+    written |= r->dirty_map->plugin_written[p];
+    r->dirty_map->plugin_written[p] = 0;
+
+    return written;
+}
+
+static void delta_history_push(size_t region, size_t page)
+{
+    struct delta_history_entry* e;
+
+    if (l_delta.history == NULL)
+    {
+        l_delta.history = (struct delta_history_entry*)malloc(DELTA_HISTORY_PAGES*sizeof(*l_delta.history));
+        l_delta.history_data = (uint32_t*)malloc(DELTA_HISTORY_PAGES*DELTA_PAGE_WORDS*4);
+
+        if (l_delta.history == NULL || l_delta.history_data == NULL)
+        {
+            free(l_delta.history);
+            free(l_delta.history_data);
+            l_delta.history = NULL;
+            l_delta.history_data = NULL;
+            /* only the base about to be made current will be available */
+            l_delta.oldest_base_id = l_delta.base_id + 1;
+            return;
+        }
+    }
+
+    e = &l_delta.history[l_delta.history_next];
+
+    /* the page being dropped is needed to rebuild its base and the older ones */
+    if (l_delta.history_count == DELTA_HISTORY_PAGES)
+        l_delta.oldest_base_id = e->base_id + 1;
+    else
+        ++l_delta.history_count;
+
+    e->base_id = l_delta.base_id;
+    e->region = (uint32_t)region;
+    e->page = (uint32_t)page;
+    memcpy(l_delta.history_data + l_delta.history_next*DELTA_PAGE_WORDS,
+           l_delta.regions[region].base + page*DELTA_PAGE_WORDS, DELTA_PAGE_WORDS*4);
+
+    l_delta.history_next = (l_delta.history_next + 1) % DELTA_HISTORY_PAGES;
+}
+
+static void delta_rebase(int keep_history)
+{
+    size_t i, p;
+
+    for (i = 0; i < DELTA_REGIONS_COUNT; ++i)
+    {
+        struct delta_region* r = &l_delta.regions[i];
+
+        for (p = 0; p < r->pages; ++p)
+        {
+            if (!r->changed[p])
+                continue;
+
+            if (keep_history)
+                delta_history_push(i, p);
+            memcpy(r->base + p*DELTA_PAGE_WORDS, r->data + p*DELTA_PAGE_WORDS, DELTA_PAGE_WORDS*4);
+        }
+
+        memset(r->changed, 0, r->pages);
+        r->changed_count = 0;
+        if (r->generation != NULL)
+            r->last_generation = *r->generation;
+    }
+
+    ++l_delta.base_id;
+    if (!keep_history)
+        l_delta.oldest_base_id = l_delta.base_id;
+}
+
+static int delta_init_region(struct delta_region* r, uint32_t* data, size_t size,
+                             const unsigned int* generation, struct rdram* dirty_map)
+{
+    r->data = data;
+    r->dirty_map = dirty_map;
+    r->pages = size / (DELTA_PAGE_WORDS*4);
+    r->base = (uint32_t*)malloc(size);
+    r->changed = (unsigned char*)malloc(r->pages);
+    r->generation = generation;
+
+    if (r->base == NULL || r->changed == NULL)
+        return 0;
+
+    /* start with everything changed so that the first rebase copies it all */
+    memset(r->changed, 1, r->pages);
+    r->changed_count = r->pages;
+
+    if (dirty_map != NULL)
+    {
+        size_t p;
+
+        for (p = 0; p < r->pages; ++p)
+            delta_page_written(r, p);
+    }
+
+    return 1;
+}
+
+static int delta_init(void)
+{
+    if (l_delta.initialized)
+        return 1;
+
+    if (!delta_init_region(&l_delta.regions[DELTA_RDRAM], g_rdram, RDRAM_MAX_SIZE, NULL, &g_ri.rdram)
+     || !delta_init_region(&l_delta.regions[DELTA_TLB_LUT_R], tlb_LUT_r, sizeof(tlb_LUT_r), &tlb_LUT_generation, NULL)
+     || !delta_init_region(&l_delta.regions[DELTA_TLB_LUT_W], tlb_LUT_w, sizeof(tlb_LUT_w), &tlb_LUT_generation, NULL))
+    {
+        DebugMessage(M64MSG_ERROR, "Failed to allocate incremental savestate base");
+        savestates_clear_incremental();
+        return 0;
+    }
+
+    l_delta.initialized = 1;
+    delta_writes_tracked();
+    delta_rebase(0);
+    return 1;
+}
+
+/* find out which pages differ from base, rebasing if there are too many */
+static int delta_prepare(void)
+{
+    size_t i, p;
+    size_t total_pages = 0, total_changed = 0;
+    int tracked;
+
+    if (!delta_init())
+        return 0;
+
+    tracked = delta_writes_tracked();
+
+    for (i = 0; i < DELTA_REGIONS_COUNT; ++i)
+    {
+        struct delta_region* r = &l_delta.regions[i];
+
+        if (r->dirty_map != NULL)
+        {
+            /* pages stay changed until the next rebase */
+            for (p = 0; p < r->pages; ++p)
+            {
+                if (delta_page_written(r, p))
+                    r->changed[p] = 1;
+                else if (!tracked && !r->changed[p])
+                    r->changed[p] = (memcmp(r->base + p*DELTA_PAGE_WORDS,
+                                            r->data + p*DELTA_PAGE_WORDS,
+                                            DELTA_PAGE_WORDS*4) != 0);
+            }
+        }
+        else if (*r->generation != r->last_generation)
+        {
+            for (p = 0; p < r->pages; ++p)
+                r->changed[p] = (memcmp(r->base + p*DELTA_PAGE_WORDS,
+                                        r->data + p*DELTA_PAGE_WORDS,
+                                        DELTA_PAGE_WORDS*4) != 0);
+            r->last_generation = *r->generation;
+        }
+
+        r->changed_count = 0;
+        for (p = 0; p < r->pages; ++p)
+            r->changed_count += r->changed[p];
+
+        total_pages += r->pages;
+        total_changed += r->changed_count;
+    }
+
+    if (total_changed * DELTA_REBASE_RATIO > total_pages)
+        delta_rebase(1);
+
+    return 1;
+}
+
+static unsigned char* put_delta_region(unsigned char* curr, const struct delta_region* r)
+{
+    uint32_t p;
+
+    PUTDATA(curr, uint32_t, (uint32_t)r->changed_count);
+
+    for (p = 0; p < r->pages; ++p)
+    {
+        if (!r->changed[p])
+            continue;
+
+        PUTDATA(curr, uint32_t, p);
+        PUTARRAY(r->data + p*DELTA_PAGE_WORDS, curr, uint32_t, DELTA_PAGE_WORDS);
+    }
+
+    return curr;
+}
+
+/* Brings a region back to the content of an incremental state against
+ * base_id. The state must have been checked by check_delta_region */
+static unsigned char* get_delta_region(unsigned char* curr, size_t region,
+                                       uint32_t base_id, int tracked)
+{
+    struct delta_region* r = &l_delta.regions[region];
+    uint32_t n, count;
+    size_t p, h;
+    int untouched;
+
+    /* 1: page may differ from the current base, 2: shipped with the
+     * state, 3: taken from the history of an older base */
+    if (r->dirty_map != NULL)
+    {
+        untouched = tracked;
+        for (p = 0; p < r->pages; ++p)
+        {
+            if (delta_page_written(r, p) || !tracked)
+                r->changed[p] = 1;
+        }
+    }
+    else
+    {
+        untouched = (*r->generation == r->last_generation);
+        if (!untouched)
+            memset(r->changed, 1, r->pages);
+    }
+
+    count = GETDATA(curr, uint32_t);
+
+    for (n = 0; n < count; ++n)
+    {
+        uint32_t page = GETDATA(curr, uint32_t);
+
+        COPYARRAY(r->data + page*DELTA_PAGE_WORDS, curr, uint32_t, DELTA_PAGE_WORDS);
+        r->changed[page] = 2;
+    }
+
+    /* newest first, so that the oldest copy of a page is the one kept */
+    for (n = 0, h = l_delta.history_next; n < l_delta.history_count; ++n)
+    {
+        const struct delta_history_entry* e;
+
+        h = (h + DELTA_HISTORY_PAGES - 1) % DELTA_HISTORY_PAGES;
+        e = &l_delta.history[h];
+
+        if (e->base_id < base_id)
+            break;
+        if (e->region != region || r->changed[e->page] == 2)
+            continue;
+
+        memcpy(r->data + e->page*DELTA_PAGE_WORDS,
+               l_delta.history_data + h*DELTA_PAGE_WORDS, DELTA_PAGE_WORDS*4);
+        r->changed[e->page] = 3;
+    }
+
+    r->changed_count = 0;
+
+    for (p = 0; p < r->pages; ++p)
+    {
+        if (r->changed[p] >= 2)
+        {
+            r->changed[p] = 1;
+            ++r->changed_count;
+        }
+        else if (r->changed[p])
+        {
+            uint32_t* page = r->data + p*DELTA_PAGE_WORDS;
+            const uint32_t* base = r->base + p*DELTA_PAGE_WORDS;
+
+            if (untouched || memcmp(page, base, DELTA_PAGE_WORDS*4) != 0)
+                memcpy(page, base, DELTA_PAGE_WORDS*4);
+            r->changed[p] = 0;
+        }
+    }
+
+    if (r->generation != NULL)
+        r->last_generation = *r->generation;
+
+    return curr;
+}
+
+/* compares a fully loaded region against base, so that changed is exact */
+static void delta_reload_region(struct delta_region* r)
+{
+    size_t p;
+
+    r->changed_count = 0;
+
+    for (p = 0; p < r->pages; ++p)
+    {
+        delta_page_written(r, p);
+        r->changed[p] = (memcmp(r->base + p*DELTA_PAGE_WORDS,
+                                r->data + p*DELTA_PAGE_WORDS,
+                                DELTA_PAGE_WORDS*4) != 0);
+        r->changed_count += r->changed[p];
+    }
+}
+
+void savestates_clear_incremental(void)
+{
+    size_t i;
+
+    for (i = 0; i < DELTA_REGIONS_COUNT; ++i)
+    {
+        free(l_delta.regions[i].base);
+        free(l_delta.regions[i].changed);
+        l_delta.regions[i].base = NULL;
+        l_delta.regions[i].changed = NULL;
+    }
+
+    free(l_delta.history);
+    free(l_delta.history_data);
+    l_delta.history = NULL;
+    l_delta.history_data = NULL;
+    l_delta.history_next = 0;
+    l_delta.history_count = 0;
+
+    l_delta.initialized = 0;
+}
+
+/* Savestate validation
+ *
+ * A savestate is checked as a whole before anything gets loaded, so
+ * that a bad one leaves the running machine untouched. Savestates are
+ * little endian whatever the host, these helpers read them in place.
+ */
+enum
+{
+    SAVESTATE_HEADER_SIZE = 8 + 4 + 32,
+    /* registers from RDRAM regs to DPS regs */
+    SAVESTATE_REGS_SIZE   = 400,
+    /* SP mem, PIF ram and flashram state */
+    SAVESTATE_MEMS_SIZE   = SP_MEM_SIZE + PIF_RAM_SIZE + 24,
+    /* CPU, FPU, TLB entries, pc and VI counters, before the event queue */
+    SAVESTATE_CPU_SIZE    = 4 + 32*8 + 32*4 + 2*8 + 32*8 + 2*4 + 32*52 + 4*4,
+    SAVESTATE_QUEUE_SIZE  = 1024
+};
+
+static uint32_t peek_u32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* returns the size of a delta region at curr, 0 if it's invalid */
+static size_t check_delta_region(const unsigned char* curr, size_t avail, const struct delta_region* r)
+{
+    uint32_t n, count;
+    size_t size = 4;
+
+    if (avail < size)
+        return 0;
+
+    count = peek_u32(curr);
+    if (count > r->pages || (avail - size) / (4 + DELTA_PAGE_WORDS*4) < count)
+        return 0;
+
+    for (n = 0; n < count; ++n)
+    {
+        if (peek_u32(curr + size) >= r->pages)
+            return 0;
+        size += 4 + DELTA_PAGE_WORDS*4;
+    }
+
+    return size;
+}
+
+static int check_savestate(const unsigned char* data, size_t size, int incremental, uint32_t base_id)
+{
+    size_t pos = SAVESTATE_HEADER_SIZE + (incremental ? 4 : 0);
+    size_t region_size, queue;
+    int i;
+
+    if (incremental && (!l_delta.initialized
+                        || base_id < l_delta.oldest_base_id
+                        || base_id > l_delta.base_id))
+    {
+        DebugMessage(M64MSG_WARNING, "Incremental savestate base is no longer available");
+        return 0;
+    }
+
+    pos += SAVESTATE_REGS_SIZE;
+    if (pos > size)
+        return 0;
+
+    for (i = 0; i < DELTA_REGIONS_COUNT; ++i)
+    {
+        if (incremental)
+        {
+            region_size = check_delta_region(data + pos, size - pos, &l_delta.regions[i]);
+            if (region_size == 0)
+            {
+                DebugMessage(M64MSG_ERROR, "Invalid incremental savestate");
+                return 0;
+            }
+        }
+        else
+            region_size = (i == DELTA_RDRAM) ? RDRAM_MAX_SIZE : 0x100000*4;
+
+        if (size - pos < region_size)
+            return 0;
+        pos += region_size;
+
+        if (i == DELTA_RDRAM)
+        {
+            pos += SAVESTATE_MEMS_SIZE;
+            if (pos > size)
+                return 0;
+        }
+    }
+
+    pos += SAVESTATE_CPU_SIZE;
+    if (pos > size)
+        return 0;
+
+    /* the event queue must be terminated within its 1KB */
+    for (queue = 0; queue + 4 <= SAVESTATE_QUEUE_SIZE && pos + queue + 4 <= size; queue += 8)
+    {
+        if (peek_u32(data + pos + queue) == 0xFFFFFFFF)
+            return 1;
+    }
+
+    DebugMessage(M64MSG_ERROR, "Invalid savestate event queue");
+    return 0;
+}
+
 int savestates_load_m64p(const unsigned char *data, size_t size)
 {
    char queue[1024];
@@ -76,9 +579,22 @@ int savestates_load_m64p(const unsigned char *data, size_t size)
    uint32_t FCR31;
    uint32_t* cp0_regs = r4300_cp0_regs();
    unsigned char *curr = (unsigned char*)data; // < HACK
+   int incremental;
+   uint32_t base_id = 0;
+   int tracked = 0;
+   size_t queue_size;
+
+   /* the pending RSP task must not write over the loaded RDRAM */
+   wait_SP_task(&g_sp);
+   /* nor the gfx plugin get late notice of CPU framebuffer writes */
+   flush_framebuffer_writes(&g_dp.fb);
 
    /* Read and check Mupen64Plus magic number. */
-   if(strncmp((char *)curr, savestate_magic, 8)!=0)
+   if(strncmp((char *)curr, savestate_magic, 8)==0)
+      incremental = 0;
+   else if(strncmp((char *)curr, savestate_delta_magic, 8)==0)
+      incremental = 1;
+   else
       return 0;
 
    curr += 8;
@@ -96,6 +612,15 @@ int savestates_load_m64p(const unsigned char *data, size_t size)
 
    curr += 32;
 
+   if (incremental)
+      base_id = GETDATA(curr, uint32_t);
+
+   if (!check_savestate(data, size, incremental, base_id))
+      return 0;
+
+   if (l_delta.initialized)
+      tracked = delta_writes_tracked();
+
    /* Parse savestate */
    g_ri.rdram.regs[RDRAM_CONFIG_REG] = GETDATA(curr, uint32_t);
    g_ri.rdram.regs[RDRAM_DEVICE_ID_REG] = GETDATA(curr, uint32_t);
@@ -213,7 +738,14 @@ int savestates_load_m64p(const unsigned char *data, size_t size)
    g_dp.dps_regs[DPS_BUFTEST_ADDR_REG] = GETDATA(curr, uint32_t);
    g_dp.dps_regs[DPS_BUFTEST_DATA_REG] = GETDATA(curr, uint32_t);
 
-   COPYARRAY(g_rdram, curr, uint32_t, RDRAM_MAX_SIZE/4);
+   if (incremental)
+      curr = get_delta_region(curr, DELTA_RDRAM, base_id, tracked);
+   else
+   {
+      COPYARRAY(g_rdram, curr, uint32_t, RDRAM_MAX_SIZE/4);
+      if (l_delta.initialized)
+         delta_reload_region(&l_delta.regions[DELTA_RDRAM]);
+   }
    COPYARRAY(g_sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
    COPYARRAY(g_si.pif.ram, curr, uint8_t, PIF_RAM_SIZE);
 
@@ -223,8 +755,17 @@ int savestates_load_m64p(const unsigned char *data, size_t size)
    g_pi.flashram.erase_offset = GETDATA(curr, unsigned int);
    g_pi.flashram.write_pointer = GETDATA(curr, unsigned int);
 
-   COPYARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
-   COPYARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+   if (incremental)
+   {
+      curr = get_delta_region(curr, DELTA_TLB_LUT_R, base_id, tracked);
+      curr = get_delta_region(curr, DELTA_TLB_LUT_W, base_id, tracked);
+   }
+   else
+   {
+      COPYARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
+      COPYARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+      ++tlb_LUT_generation;
+   }
 
    *r4300_llbit() = GETDATA(curr, unsigned int);
    COPYARRAY(r4300_regs(), curr, int64_t, 32);
@@ -279,7 +820,12 @@ int savestates_load_m64p(const unsigned char *data, size_t size)
    g_vi.next_vi  = GETDATA(curr, unsigned int);
    g_vi.field    = GETDATA(curr, unsigned int);
 
-   memcpy(queue, curr, sizeof(queue));
+   /* the queue may be shorter than 1KB, it was checked to be terminated */
+   queue_size = size - (size_t)(curr - data);
+   if (queue_size > sizeof(queue))
+      queue_size = sizeof(queue);
+   memset(queue, 0xFF, sizeof(queue));
+   memcpy(queue, curr, queue_size);
    to_little_endian_buffer(queue, 4, 256);
    load_eventqueue_infos(queue);
 
@@ -292,7 +838,7 @@ int savestates_load_m64p(const unsigned char *data, size_t size)
    return 1;
 }
 
-int savestates_save_m64p(unsigned char *data, size_t size)
+static int save_m64p(unsigned char *data, size_t size, int incremental)
 {
    unsigned char outbuf[4];
    int i, queuelength;
@@ -303,10 +849,19 @@ int savestates_save_m64p(unsigned char *data, size_t size)
    if (!curr)
       return 0;
 
+   /* save the results of the pending RSP task too */
+   wait_SP_task(&g_sp);
+   flush_framebuffer_writes(&g_dp.fb);
+
    queuelength = save_eventqueue_infos(queue);
+   if (queuelength < 0)
+      return 0;
+
+   if (incremental && !delta_prepare())
+      return 0;
 
    // Write the save state data to memory
-   PUTARRAY(savestate_magic, curr, unsigned char, 8);
+   PUTARRAY(incremental ? savestate_delta_magic : savestate_magic, curr, unsigned char, 8);
 
    outbuf[0] = (savestate_latest_version >> 24) & 0xff;
    outbuf[1] = (savestate_latest_version >> 16) & 0xff;
@@ -316,6 +871,9 @@ int savestates_save_m64p(unsigned char *data, size_t size)
 
    PUTARRAY(ROM_SETTINGS.MD5, curr, char, 32);
 
+   if (incremental)
+      PUTDATA(curr, uint32_t, l_delta.base_id);
+
    PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_CONFIG_REG]);
    PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_DEVICE_ID_REG]);
    PUTDATA(curr, uint32_t, g_ri.rdram.regs[RDRAM_DELAY_REG]);
@@ -456,7 +1014,12 @@ int savestates_save_m64p(unsigned char *data, size_t size)
    PUTDATA(curr, uint32_t, g_dp.dps_regs[DPS_BUFTEST_ADDR_REG]);
    PUTDATA(curr, uint32_t, g_dp.dps_regs[DPS_BUFTEST_DATA_REG]);
 
-   PUTARRAY(g_rdram, curr, uint32_t, RDRAM_MAX_SIZE/4);
+   if (incremental)
+      curr = put_delta_region(curr, &l_delta.regions[DELTA_RDRAM]);
+   else
+   {
+      PUTARRAY(g_rdram, curr, uint32_t, RDRAM_MAX_SIZE/4);
+   }
    PUTARRAY(g_sp.mem, curr, uint32_t, SP_MEM_SIZE/4);
    PUTARRAY(g_si.pif.ram, curr, uint8_t, PIF_RAM_SIZE);
 
@@ -466,8 +1029,16 @@ int savestates_save_m64p(unsigned char *data, size_t size)
    PUTDATA(curr, unsigned int, g_pi.flashram.erase_offset);
    PUTDATA(curr, unsigned int, g_pi.flashram.write_pointer);
 
-   PUTARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
-   PUTARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+   if (incremental)
+   {
+      curr = put_delta_region(curr, &l_delta.regions[DELTA_TLB_LUT_R]);
+      curr = put_delta_region(curr, &l_delta.regions[DELTA_TLB_LUT_W]);
+   }
+   else
+   {
+      PUTARRAY(tlb_LUT_r, curr, unsigned int, 0x100000);
+      PUTARRAY(tlb_LUT_w, curr, unsigned int, 0x100000);
+   }
 
    PUTDATA(curr, unsigned int, *r4300_llbit());
    PUTARRAY(r4300_regs(), curr, int64_t, 32);
@@ -525,3 +1096,13 @@ int savestates_save_m64p(unsigned char *data, size_t size)
 
    return 1;
 }
+
+int savestates_save_m64p(unsigned char *data, size_t size)
+{
+   return save_m64p(data, size, 0);
+}
+
+int savestates_save_m64p_incremental(unsigned char *data, size_t size)
+{
+   return save_m64p(data, size, 1);
+}
@@ -35,6 +35,12 @@ typedef enum _savestates_job
 int savestates_load_m64p(const unsigned char *data, size_t size);
 int savestates_save_m64p(unsigned char *data, size_t size);
 
+/* Same as savestates_save_m64p, but RDRAM and TLB lookup tables are only
+ * stored as the pages which differ from a base snapshot kept in memory.
+ * The resulting state can only be loaded back by the running instance. */
+int savestates_save_m64p_incremental(unsigned char *data, size_t size);
+void savestates_clear_incremental(void);
+
 
 #endif /* __SAVESTAVES_H__ */
 
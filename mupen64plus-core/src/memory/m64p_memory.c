@@ -1484,7 +1484,11 @@ uint32_t *fast_mem_access(uint32_t address)
    if (address < RDRAM_MAX_SIZE)
       return (uint32_t*)((uint8_t*)g_rdram + address);
    else if (address >= UINT32_C(0x10000000))
+   {
+      /* callers read at most up to the end of the 4KB page */
+      touch_rom(address - UINT32_C(0x10000000), 4);
       return (uint32_t*)((uint8_t*)g_rom + address - UINT32_C(0x10000000));
+   }
    else if ((address & UINT32_C(0xffffe000)) == UINT32_C(0x04000000))
       return (uint32_t*)((uint8_t*)g_sp.mem + (address & UINT32_C(0x1ffc)));
    return NULL;
@@ -22,6 +22,8 @@
 #include "cart_rom.h"
 #include "pi_controller.h"
 
+#include "../main/rom.h"
+
 void connect_cart_rom(struct cart_rom* cart_rom,
                       uint8_t* rom, size_t rom_size)
 {
@@ -47,6 +49,7 @@ int read_cart_rom(void* opaque, uint32_t address, uint32_t* value)
     }
     else
     {
+        touch_rom(addr, 4);
         *value = *(uint32_t*)(pi->cart_rom.rom + addr);
     }
 
@@ -152,6 +152,7 @@ void dma_read_flashram(struct pi_controller *pi)
       case FLASHRAM_MODE_STATUS:
          dram[pi->regs[PI_DRAM_ADDR_REG]/4]   = (uint32_t)(flashram->status >> 32);
          dram[pi->regs[PI_DRAM_ADDR_REG]/4+1] = (uint32_t)(flashram->status);
+         mark_rdram_dirty(&pi->ri->rdram, pi->regs[PI_DRAM_ADDR_REG], 8, RDRAM_DIRTY_WRITES);
          break;
       case FLASHRAM_MODE_READ:
          length = (pi->regs[PI_WR_LEN_REG] & 0xffffff) + 1;
@@ -160,6 +161,7 @@ void dma_read_flashram(struct pi_controller *pi)
 
          for (i = 0; i < length; ++i)
             ((uint8_t*)dram)[(dram_addr+i)^S8] = mem[(cart_addr+i)^S8];
+         mark_rdram_dirty(&pi->ri->rdram, dram_addr, length, RDRAM_DIRTY_WRITES);
          break;
       default:
          DebugMessage(M64MSG_WARNING, "unknown dma_read_flashram: %x", flashram->mode);
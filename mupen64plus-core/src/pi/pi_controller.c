@@ -25,6 +25,7 @@
 #include "../api/callbacks.h"
 #include "../api/m64p_types.h"
 #include "../main/main.h"
+#include "../main/rom.h"
 #include "../memory/memory.h"
 #include "../r4300/cp0.h"
 #include "../r4300/cp0_private.h"
@@ -160,8 +161,8 @@ static void dma_pi_write(struct pi_controller *pi)
          for (i = 0; i < length; ++i)
             dram[(dram_address + i) ^ S8] = rom[(rom_address + i) ^ S8];
 
-         invalidate_r4300_cached_code(0x80000000 + dram_address, length);
-         invalidate_r4300_cached_code(0xa0000000 + dram_address, length);
+         mark_rdram_dirty(&pi->ri->rdram, dram_address, length, RDRAM_DIRTY_WRITES);
+         invalidate_r4300_dirty_code(&pi->ri->rdram, dram_address, length);
       }
       else
       {
@@ -237,13 +238,14 @@ static void dma_pi_write(struct pi_controller *pi)
       rom_address = (pi->regs[PI_CART_ADDR_REG] - 0x10000000) & 0x3ffffff;
       dram = (uint8_t*)pi->ri->rdram.dram;
       rom = pi->cart_rom.rom;
+      touch_rom(rom_address, length + 4);
    }
 
    for (i = 0; i < length; ++i)
       dram[(dram_address + i) ^ S8] = rom[(rom_address + i) ^ S8];
 
-   invalidate_r4300_cached_code(0x80000000 + dram_address, length);
-   invalidate_r4300_cached_code(0xa0000000 + dram_address, length);
+   mark_rdram_dirty(&pi->ri->rdram, dram_address, length, RDRAM_DIRTY_WRITES);
+   invalidate_r4300_dirty_code(&pi->ri->rdram, dram_address, length);
 
    /* HACK: monitor PI DMA to trigger RDRAM size detection
     * hack just before initial cart ROM loading. */
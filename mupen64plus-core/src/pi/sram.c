@@ -68,4 +68,6 @@ void dma_read_sram(struct pi_controller* pi)
 
    for(i = 0; i < length; ++i)
       dram[(dram_addr+i)^S8] = sram[(cart_addr+i)^S8];
+
+   mark_rdram_dirty(&pi->ri->rdram, dram_addr, length, RDRAM_DIRTY_WRITES);
 }
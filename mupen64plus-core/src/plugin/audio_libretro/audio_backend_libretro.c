@@ -25,6 +25,7 @@
 #include "main/main.h"
 #include "main/rom.h"
 #include "plugin/plugin.h"
+#include "plugin/audio_libretro/audio_plugin.h"
 #include "ri/ri_controller.h"
 
 #include <stdio.h>
@@ -34,6 +35,13 @@
 #include <string.h>
 #include <stdarg.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_NEON
+#endif
+
 #include <audio/conversion/float_to_s16.h>
 #include <audio/conversion/s16_to_float.h>
 #include <audio/audio_resampler.h>
@@ -52,8 +60,21 @@ static unsigned CountsPerByte;
 
 bool no_audio;
 
+static enum audio_resampler_type audio_resampler = AUDIO_RESAMPLER_SINC;
+
+/* Linear interpolation between consecutive input frames, in 32.32 fixed
+ * point so that the step rounding doesn't drift the output rate. Cheap
+ * enough for the usual 32/44.1/48 kHz game rates on low-end devices where
+ * the sinc resampler shows up. */
+static struct
+{
+   uint64_t pos;     /* next output position, 0 being prev */
+   int16_t prev[2];  /* last input frame of the previous batch */
+} fast_resampler;
+
 static const retro_resampler_t *resampler;
 static void *resampler_audio_data;
+static int16_t *audio_in_buffer_s16;
 static float *audio_in_buffer_float;
 static float *audio_out_buffer_float;
 static int16_t *audio_out_buffer_s16;
@@ -63,6 +84,34 @@ void (*audio_convert_s16_to_float_arm)(float *out,
 void (*audio_convert_float_to_s16_arm)(int16_t *out,
       const float *in, size_t samples);
 
+/* Audio frames queued by AI DMA, until retro_run outputs them at the end
+ * of the frame. AI DMA only copies the guest frames, conversion and
+ * resampling are done in batches when the queue is drained. Both run on
+ * the emulation thread (emulation is a coroutine of retro_run).
+ *
+ * Each push records the game rate it was played at, so that a rate
+ * change within a frame only applies to the frames pushed after it.
+ * Indices run freely and are masked on access. */
+#define AUDIO_RING_FRAMES  (1 << 14)
+#define AUDIO_RING_MASK    (AUDIO_RING_FRAMES - 1)
+#define AUDIO_RING_PUSHES  64
+#define AUDIO_PUSHES_MASK  (AUDIO_RING_PUSHES - 1)
+
+static struct
+{
+   uint32_t frames[AUDIO_RING_FRAMES];
+   unsigned head;
+   unsigned tail;
+
+   struct
+   {
+      unsigned end;  /* head once the push was queued */
+      int freq;      /* GameFreq at the time of the push */
+   } pushes[AUDIO_RING_PUSHES];
+   unsigned push_head;
+   unsigned push_tail;
+} audio_ring;
+
 void deinit_audio_libretro(void)
 {
    if (resampler && resampler_audio_data)
@@ -70,10 +119,14 @@ void deinit_audio_libretro(void)
       resampler->free(resampler_audio_data);
       resampler = NULL;
       resampler_audio_data = NULL;
+      free(audio_in_buffer_s16);
       free(audio_in_buffer_float);
       free(audio_out_buffer_float);
       free(audio_out_buffer_s16);
    }
+
+   audio_ring.head = audio_ring.tail = 0;
+   audio_ring.push_head = audio_ring.push_tail = 0;
 }
 
 void init_audio_libretro(unsigned max_audio_frames)
@@ -82,12 +135,17 @@ void init_audio_libretro(unsigned max_audio_frames)
 
    MAX_AUDIO_FRAMES = max_audio_frames;
 
+   audio_in_buffer_s16    = malloc(2 * MAX_AUDIO_FRAMES * sizeof(int16_t));
    audio_in_buffer_float  = malloc(2 * MAX_AUDIO_FRAMES * sizeof(float));
    audio_out_buffer_float = malloc(2 * MAX_AUDIO_FRAMES * sizeof(float));
    audio_out_buffer_s16   = malloc(2 * MAX_AUDIO_FRAMES * sizeof(int16_t));
 
    convert_s16_to_float_init_simd();
    convert_float_to_s16_init_simd();
+
+   audio_ring.head = audio_ring.tail = 0;
+   audio_ring.push_head = audio_ring.push_tail = 0;
+   memset(&fast_resampler, 0, sizeof(fast_resampler));
 }
 
 /* A fully compliant implementation is not really possible with just the zilmar spec.
@@ -114,59 +172,123 @@ void set_audio_format_via_libretro(void* user_data,
    g_ai.regs[AI_DACRATE_REG] = saved_ai_dacrate;
 }
 
-/* Abuse core & audio plugin implementation details to obtain the desired effect. */
-void push_audio_samples_via_libretro(void* user_data, const void* buffer, size_t size)
+/* Guest frames are words in host order, with the right channel first */
+static void swap_audio_channels(int16_t *out, const uint32_t *in, size_t frames)
 {
-   int16_t *out;
-   size_t max_frames, remain_frames;
-   uint32_t i;
-   double ratio;
-   struct resampler_data data = {0};
-   int16_t *raw_data = (int16_t*)buffer;
-   size_t frames     = size / 4;
-   uint8_t *p        = (uint8_t*)buffer;
+   const int16_t *samples = (const int16_t*)in;
+   size_t i = 0;
 
-   /* save registers values */
-   uint32_t saved_ai_length = g_ai.regs[AI_LEN_REG];
-   uint32_t saved_ai_dram = g_ai.regs[AI_DRAM_ADDR_REG];
+#if defined(__SSE2__)
+   for (; i + 4 <= frames; i += 4)
+   {
+      __m128i x = _mm_loadu_si128((const __m128i*)(samples + 2 * i));
+      x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+      x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+      _mm_storeu_si128((__m128i*)(out + 2 * i), x);
+   }
+#elif defined(AUDIO_NEON)
+   for (; i + 4 <= frames; i += 4)
+      vst1q_s16(out + 2 * i, vrev32q_s16(vld1q_s16(samples + 2 * i)));
+#endif
 
-   /* notify plugin of new samples to play.
-    * Exploit the fact that buffer points in g_rdram to retreive dram_addr_reg value */
-   g_ai.regs[AI_DRAM_ADDR_REG] = (uint8_t*)buffer - (uint8_t*)g_rdram;
-   g_ai.regs[AI_LEN_REG] = size;
+   for (; i < frames; i++)
+   {
+      out[2 * i    ] = samples[2 * i + 1];
+      out[2 * i + 1] = samples[2 * i    ];
+   }
+}
+
+/* Same as swap_audio_channels, converting to float in the same pass */
+static void swap_audio_channels_to_float(float *out, const uint32_t *in, size_t frames)
+{
+   const int16_t *samples = (const int16_t*)in;
+   const float gain = 1.0f / 0x8000;
+   size_t i = 0;
+
+#if defined(__SSE2__)
+   const __m128 factor = _mm_set1_ps(gain);
 
-   for (i = 0; i < size; i += 4)
+   for (; i + 4 <= frames; i += 4)
    {
-      p[i ] ^= p[i + 2];
-      p[i + 2] ^= p[i ];
-      p[i ] ^= p[i + 2];
-      p[i + 1] ^= p[i + 3];
-      p[i + 3] ^= p[i + 1];
-      p[i + 1] ^= p[i + 3];
+      __m128i x = _mm_loadu_si128((const __m128i*)(samples + 2 * i));
+      x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+      x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+      _mm_storeu_ps(out + 2 * i, _mm_mul_ps(factor,
+               _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16))));
+      _mm_storeu_ps(out + 2 * i + 4, _mm_mul_ps(factor,
+               _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16))));
    }
+#elif defined(AUDIO_NEON)
+   for (; i + 4 <= frames; i += 4)
+   {
+      int16x8_t x = vrev32q_s16(vld1q_s16(samples + 2 * i));
+      vst1q_f32(out + 2 * i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), gain));
+      vst1q_f32(out + 2 * i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), gain));
+   }
+#endif
 
-audio_batch:
-   out               = NULL;
-   ratio             = 44100.0 / GameFreq;
-   max_frames        = (GameFreq > 44100) ? MAX_AUDIO_FRAMES : (size_t)(MAX_AUDIO_FRAMES / ratio - 1);
-   remain_frames     = 0;
-   if (no_audio)
-      return;
+   for (; i < frames; i++)
+   {
+      out[2 * i    ] = (float)samples[2 * i + 1] * gain;
+      out[2 * i + 1] = (float)samples[2 * i    ] * gain;
+   }
+}
 
-   if (frames > max_frames)
+static size_t resample_fast(int16_t *out, const int16_t *in, size_t frames, double ratio)
+{
+   uint64_t step = (uint64_t)(4294967296.0 / ratio + 0.5);
+   uint64_t pos  = fast_resampler.pos;
+   uint64_t end  = (uint64_t)frames << 32;
+   size_t output_frames = 0;
+
+   for (; pos < end; pos += step, out += 2, output_frames++)
    {
-      remain_frames = frames - max_frames;
-      frames = max_frames;
+      size_t i         = (size_t)(pos >> 32);
+      int32_t frac     = (int32_t)((pos >> 17) & 0x7fff);
+      const int16_t *a = (i == 0) ? fast_resampler.prev : in + 2 * (i - 1);
+      const int16_t *b = in + 2 * i;
+
+      out[0] = a[0] + (((b[0] - a[0]) * frac) >> 15);
+      out[1] = a[1] + (((b[1] - a[1]) * frac) >> 15);
    }
 
-   data.data_in      = audio_in_buffer_float;
-   data.data_out     = audio_out_buffer_float;
-   data.input_frames = frames;
-   data.ratio        = ratio;
+   fast_resampler.pos     = pos - end;
+   fast_resampler.prev[0] = in[2 * (frames - 1)    ];
+   fast_resampler.prev[1] = in[2 * (frames - 1) + 1];
+
+   return output_frames;
+}
+
+void set_audio_resampler_libretro(enum audio_resampler_type type)
+{
+   if (type == audio_resampler)
+      return;
+
+   audio_resampler = type;
+   memset(&fast_resampler, 0, sizeof(fast_resampler));
+}
 
-   convert_s16_to_float(audio_in_buffer_float, raw_data, frames * 2, 1.0f);
-   resampler->process(resampler_audio_data, &data);
-   convert_float_to_s16(audio_out_buffer_s16, audio_out_buffer_float, data.output_frames * 2);
+static void audio_batch(const uint32_t *raw_data, size_t frames, double ratio)
+{
+   int16_t *out;
+   struct resampler_data data = {0};
+
+   if (audio_resampler == AUDIO_RESAMPLER_FAST)
+   {
+      swap_audio_channels(audio_in_buffer_s16, raw_data, frames);
+      data.output_frames = resample_fast(audio_out_buffer_s16, audio_in_buffer_s16, frames, ratio);
+   }
+   else
+   {
+      data.data_in      = audio_in_buffer_float;
+      data.data_out     = audio_out_buffer_float;
+      data.input_frames = frames;
+      data.ratio        = ratio;
+
+      swap_audio_channels_to_float(audio_in_buffer_float, raw_data, frames);
+      resampler->process(resampler_audio_data, &data);
+      convert_float_to_s16(audio_out_buffer_s16, audio_out_buffer_float, data.output_frames * 2);
+   }
 
    out                    = audio_out_buffer_s16;
 
@@ -176,14 +298,78 @@ audio_batch:
       data.output_frames -= ret;
       out                += ret * 2;
    }
-   if (remain_frames)
+}
+
+/* Converts, resamples and outputs everything queued so far */
+void process_audio_libretro(void)
+{
+   unsigned tail = audio_ring.tail;
+
+   for (; audio_ring.push_tail != audio_ring.push_head; ++audio_ring.push_tail)
    {
-      raw_data = raw_data + frames * 2;
-      frames   = remain_frames;
-      goto audio_batch;
+      unsigned end      = audio_ring.pushes[audio_ring.push_tail & AUDIO_PUSHES_MASK].end;
+      int freq          = audio_ring.pushes[audio_ring.push_tail & AUDIO_PUSHES_MASK].freq;
+      double ratio      = 44100.0 / freq;
+      size_t max_frames = (freq > 44100) ? MAX_AUDIO_FRAMES : (size_t)(MAX_AUDIO_FRAMES / ratio - 1);
+
+      while (tail != end)
+      {
+         size_t frames = end - tail;
+         size_t until_wrap = AUDIO_RING_FRAMES - (tail & AUDIO_RING_MASK);
+
+         if (frames > until_wrap)
+            frames = until_wrap;
+         if (frames > max_frames)
+            frames = max_frames;
+
+         audio_batch(&audio_ring.frames[tail & AUDIO_RING_MASK], frames, ratio);
+
+         tail += frames;
+      }
    }
 
-   /* restore original registers vlaues */
-   g_ai.regs[AI_LEN_REG]       = saved_ai_length;
-   g_ai.regs[AI_DRAM_ADDR_REG] = saved_ai_dram;
+   audio_ring.tail = tail;
+}
+
+/* Called on AI DMA. Guest memory is left untouched. */
+void push_audio_samples_via_libretro(void* user_data, const void* buffer, size_t size)
+{
+   const uint32_t *in = (const uint32_t*)buffer;
+   size_t frames      = size / 4;
+
+   if (no_audio)
+      return;
+
+   while (frames)
+   {
+      unsigned head = audio_ring.head;
+      size_t space  = AUDIO_RING_FRAMES - (head - audio_ring.tail);
+      size_t until_wrap, count;
+
+      if (space == 0 || audio_ring.push_head - audio_ring.push_tail == AUDIO_RING_PUSHES)
+      {
+         /* drain early when a frame overflows the queue */
+         process_audio_libretro();
+         continue;
+      }
+
+      count      = (frames < space) ? frames : space;
+      until_wrap = AUDIO_RING_FRAMES - (head & AUDIO_RING_MASK);
+
+      if (count <= until_wrap)
+         memcpy(&audio_ring.frames[head & AUDIO_RING_MASK], in, count * 4);
+      else
+      {
+         memcpy(&audio_ring.frames[head & AUDIO_RING_MASK], in, until_wrap * 4);
+         memcpy(&audio_ring.frames[0], in + until_wrap, (count - until_wrap) * 4);
+      }
+
+      audio_ring.head = head + count;
+      audio_ring.pushes[audio_ring.push_head & AUDIO_PUSHES_MASK].end  = audio_ring.head;
+      audio_ring.pushes[audio_ring.push_head & AUDIO_PUSHES_MASK].freq = GameFreq;
+      ++audio_ring.push_head;
+
+      in     += count;
+      frames -= count;
+   }
 }
@@ -24,7 +24,15 @@
 
 #include <stddef.h>
 
+enum audio_resampler_type
+{
+   AUDIO_RESAMPLER_SINC,
+   AUDIO_RESAMPLER_FAST
+};
+
 void init_audio_libretro(unsigned max_frames);
 void deinit_audio_libretro(void);
+void process_audio_libretro(void);
+void set_audio_resampler_libretro(enum audio_resampler_type type);
 
 #endif
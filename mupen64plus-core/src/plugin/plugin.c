@@ -27,6 +27,7 @@
 
 #include "r4300/r4300_core.h"
 #include "../rdp/rdp_core.h"
+#include "../ri/ri_controller.h"
 #include "../rsp/rsp_core.h"
 
 #include "../vi/vi_controller.h"
@@ -95,6 +96,7 @@ static m64p_error EmptyGetVersionFunc(m64p_plugin_type *PluginType, int *PluginV
     }
 
 DEFINE_GFX(angrylion);
+EXPORT void CALL angrylionSetRdramWriteMap(unsigned char *map);
 DEFINE_GFX(rice);
 DEFINE_GFX(gln64);
 DEFINE_GFX(glide64);
@@ -216,6 +218,10 @@ static m64p_error plugin_start_input(void)
 
 DEFINE_RSP(hle);
 DEFINE_RSP(cxd4);
+EXPORT void CALL hleSyncTask(void);
+EXPORT unsigned int CALL hleAsyncTaskCycles(void);
+EXPORT void CALL hleSetRdramWriteMap(unsigned char *map);
+EXPORT void CALL cxd4SetRdramWriteMap(unsigned char *map);
 #ifdef HAVE_PARALLEL_RSP
 DEFINE_RSP(parallelRSP);
 #endif
@@ -266,6 +272,7 @@ void plugin_connect_all(enum gfx_plugin_type gfx_plugin, enum rsp_plugin_type rs
    {
       case GFX_ANGRYLION:
          gfx = gfx_angrylion;
+         gfx.setRdramWriteMap = angrylionSetRdramWriteMap;
          break;
       case GFX_PARALLEL:
 #ifdef HAVE_PARALLEL
@@ -287,6 +294,7 @@ void plugin_connect_all(enum gfx_plugin_type gfx_plugin, enum rsp_plugin_type rs
          gfx = gfx_glide64;
 #else
          gfx = gfx_angrylion;
+         gfx.setRdramWriteMap = angrylionSetRdramWriteMap;
 #endif
          break;
    }
@@ -295,6 +303,7 @@ void plugin_connect_all(enum gfx_plugin_type gfx_plugin, enum rsp_plugin_type rs
    {
       case RSP_CXD4:
          rsp = rsp_cxd4;
+         rsp.setRdramWriteMap = cxd4SetRdramWriteMap;
          break;
 #ifdef HAVE_PARALLEL_RSP
       case RSP_PARALLEL:
@@ -303,10 +312,18 @@ void plugin_connect_all(enum gfx_plugin_type gfx_plugin, enum rsp_plugin_type rs
 #endif
       default:
          rsp = rsp_hle;
+         rsp.syncTask        = hleSyncTask;
+         rsp.asyncTaskCycles = hleAsyncTaskCycles;
+         rsp.setRdramWriteMap = hleSetRdramWriteMap;
          break;
    }
 
    plugin_start_gfx();
    plugin_start_input();
    plugin_start_rsp();
+
+   if (gfx.setRdramWriteMap != NULL)
+      gfx.setRdramWriteMap(g_ri.rdram.plugin_written);
+   if (rsp.setRdramWriteMap != NULL)
+      rsp.setRdramWriteMap(g_ri.rdram.plugin_written);
 }
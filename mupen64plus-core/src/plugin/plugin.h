@@ -61,6 +61,9 @@ typedef struct _gfx_plugin_functions
 	ptr_FBRead          fBRead;
 	ptr_FBWrite         fBWrite;
 	ptr_FBGetFrameBufferInfo fBGetFrameBufferInfo;
+
+	/* RDRAM write map extension, NULL if not supported */
+	ptr_SetRdramWriteMap setRdramWriteMap;
 } gfx_plugin_functions;
 
 extern gfx_plugin_functions gfx;
@@ -86,6 +89,13 @@ typedef struct _rsp_plugin_functions
 	ptr_DoRspCycles         doRspCycles;
 	ptr_InitiateRSP         initiateRSP;
 	ptr_RomClosed           romClosed;
+
+	/* asynchronous task extension, NULL if not supported */
+	ptr_SyncTask            syncTask;
+	ptr_AsyncTaskCycles     asyncTaskCycles;
+
+	/* RDRAM write map extension, NULL if not supported */
+	ptr_SetRdramWriteMap    setRdramWriteMap;
 } rsp_plugin_functions;
 
 extern rsp_plugin_functions rsp;
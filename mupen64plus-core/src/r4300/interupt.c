@@ -25,6 +25,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ai/ai_controller.h"
@@ -58,110 +59,282 @@ struct interrupt_event
 {
     int type;
     unsigned int count;
+    /* position on the 64-bit scheduler timeline, fixed at insertion */
+    uint64_t key;
+    /* tie breaker: events due at the same time fire in insertion order,
+     * except CHECK_INT which is always pushed in front */
+    int64_t seq;
 };
 
 
 /***************************************************************************
- * Pool of Single Linked List Nodes
+ * Interrupt Queue
+ *
+ * Events are kept in a binary min-heap ordered on (key, seq).
+ * CP0 Count is only 32 bits wide and wraps around, so each event is given
+ * a key on a 64-bit timeline when it is inserted : key = now + distance,
+ * distance being how many cycles are left before Count reaches the event.
+ * Ordering is thus fixed once an event is queued and stays valid while
+ * Count moves forward, which lets insertion and removal run in O(log n).
+ * Events whose Count is already behind are overdue and keyed at now.
+ *
+ * Event types are single bits, the heap position of an event of each
+ * type is tracked so that lookup and removal by type don't scan the heap.
  **************************************************************************/
-#define POOL_CAPACITY 16
+#define QUEUE_INITIAL_CAPACITY 16
 
-struct node
-{
-    struct interrupt_event data;
-    struct node *next;
-};
+/* one slot per event type bit, plus one shared by unknown types */
+#define EVENT_TYPE_SLOTS 13
 
-struct pool
+struct interrupt_queue
 {
-    struct node nodes[POOL_CAPACITY];
-    struct node* stack[POOL_CAPACITY];
-    size_t index;
+    struct interrupt_event* events;
+    struct interrupt_event* sorted;
+    size_t size;
+    size_t capacity;
+
+    uint64_t now;
+    uint32_t last_count;
+    int64_t seq_front;
+    int64_t seq_back;
+
+    /* heap index of an event of each type, valid while type_count > 0 */
+    size_t type_pos[EVENT_TYPE_SLOTS];
+    unsigned int type_count[EVENT_TYPE_SLOTS];
 };
 
-static struct node* alloc_node(struct pool* p);
-static void free_node(struct pool* p, struct node* node);
-static void clear_pool(struct pool* p);
+static struct interrupt_queue q;
 
 
-/* node allocation/deallocation on a given pool */
-static struct node* alloc_node(struct pool* p)
+static int type_slot(int type)
 {
-    /* return NULL if pool is too small */
-    if (p->index >= POOL_CAPACITY)
-        return NULL;
+    int slot = 0;
+
+    if (type <= 0 || type > CART_INT || (type & (type - 1)))
+        return EVENT_TYPE_SLOTS - 1;
 
-    return p->stack[p->index++];
+    while (!(type & 1))
+    {
+        type >>= 1;
+        ++slot;
+    }
+
+    return slot;
 }
 
-static void free_node(struct pool* p, struct node* node)
+static void place_event(size_t i, const struct interrupt_event* e)
 {
-    if (p->index == 0 || node == NULL)
-        return;
+    q.events[i] = *e;
+    q.type_pos[type_slot(e->type)] = i;
+}
 
-    p->stack[--p->index] = node;
+
+static void clear_queue(void)
+{
+    q.size = 0;
+    q.now = 0;
+    q.last_count = g_cp0_regs[CP0_COUNT_REG];
+    q.seq_front = 0;
+    q.seq_back = 0;
+    memset(q.type_count, 0, sizeof(q.type_count));
 }
 
-/* release all nodes */
-static void clear_pool(struct pool* p)
+static int reserve_queue(size_t capacity)
 {
-    size_t i;
+    struct interrupt_event* events;
+    struct interrupt_event* sorted;
+
+    if (capacity <= q.capacity)
+        return 1;
 
-    for(i = 0; i < POOL_CAPACITY; ++i)
-        p->stack[i] = &p->nodes[i];
+    if (capacity < 2 * q.capacity)
+        capacity = 2 * q.capacity;
+    if (capacity < QUEUE_INITIAL_CAPACITY)
+        capacity = QUEUE_INITIAL_CAPACITY;
 
-    p->index = 0;
+    events = (struct interrupt_event*)realloc(q.events, capacity * sizeof(*events));
+    if (events == NULL)
+        return 0;
+    q.events = events;
+
+    /* scratch space used to serialize events in firing order */
+    sorted = (struct interrupt_event*)realloc(q.sorted, capacity * sizeof(*sorted));
+    if (sorted == NULL)
+        return 0;
+    q.sorted = sorted;
+
+    q.capacity = capacity;
+    return 1;
 }
 
-/***************************************************************************
- * Interrupt Queue
- **************************************************************************/
+static int event_before(const struct interrupt_event* e1, const struct interrupt_event* e2)
+{
+    if (e1->key != e2->key)
+        return e1->key < e2->key;
 
-struct interrupt_queue
+    return e1->seq < e2->seq;
+}
+
+static void sift_up(size_t i)
 {
-    struct pool pool;
-    struct node* first;
-};
+    struct interrupt_event e = q.events[i];
 
-static struct interrupt_queue q;
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
 
+        if (!event_before(&e, &q.events[parent]))
+            break;
 
-static void clear_queue(void)
-{
-    q.first = NULL;
-    clear_pool(&q.pool);
+        place_event(i, &q.events[parent]);
+        i = parent;
+    }
+
+    place_event(i, &e);
 }
 
+static void sift_down(size_t i)
+{
+    struct interrupt_event e = q.events[i];
+
+    for (;;)
+    {
+        size_t child = 2 * i + 1;
+
+        if (child >= q.size)
+            break;
 
-static int SPECIAL_done = 0;
+        if (child + 1 < q.size && event_before(&q.events[child + 1], &q.events[child]))
+            ++child;
+
+        if (!event_before(&q.events[child], &e))
+            break;
 
-static int before_event(unsigned int evt1, unsigned int evt2, int type2)
+        place_event(i, &q.events[child]);
+        i = child;
+    }
+
+    place_event(i, &e);
+}
+
+/* only needed when several events share a slot (CHECK_INT, unknown types) */
+static void rescan_type_slot(int slot)
 {
-    if(evt1 - g_cp0_regs[CP0_COUNT_REG] < UINT32_C(0x80000000))
+    size_t i;
+
+    for (i = 0; i < q.size; ++i)
     {
-        if(evt2 - g_cp0_regs[CP0_COUNT_REG] < UINT32_C(0x80000000))
+        if (type_slot(q.events[i].type) == slot)
         {
-            if((evt1 - g_cp0_regs[CP0_COUNT_REG]) < (evt2 - g_cp0_regs[CP0_COUNT_REG])) return 1;
-            else return 0;
+            q.type_pos[slot] = i;
+            return;
         }
+    }
+}
+
+static void delete_event_at(size_t i)
+{
+    struct interrupt_event last;
+    int slot = type_slot(q.events[i].type);
+    int stale = (q.type_pos[slot] == i);
+
+    --q.type_count[slot];
+
+    last = q.events[--q.size];
+    if (i != q.size)
+    {
+        place_event(i, &last);
+
+        if (i > 0 && event_before(&q.events[i], &q.events[(i - 1) / 2]))
+            sift_up(i);
         else
-        {
-            if((g_cp0_regs[CP0_COUNT_REG] - evt2) < UINT32_C(0x10000000))
-            {
-                switch(type2)
-                {
-                    case SPECIAL_INT:
-                        if(SPECIAL_done) return 1;
-                        else return 0;
-                        break;
-                    default:
-                        return 0;
-                }
-            }
-            else return 1;
-        }
+            sift_down(i);
+    }
+
+    if (stale && q.type_count[slot] > 0
+     && (q.type_pos[slot] >= q.size || type_slot(q.events[q.type_pos[slot]].type) != slot))
+        rescan_type_slot(slot);
+}
+
+static size_t find_event(int type)
+{
+    int slot = type_slot(type);
+    size_t i;
+
+    if (q.type_count[slot] == 0)
+        return q.size;
+
+    i = q.type_pos[slot];
+    if (q.events[i].type == type)
+        return i;
+
+    /* unknown types share a slot */
+    for (i = 0; i < q.size; ++i)
+    {
+        if (q.events[i].type == type)
+            break;
+    }
+
+    return i;
+}
+
+/* advance the 64-bit timeline up to the given Count value.
+ * Count is allowed to move backward a little (see compare_int_handler). */
+static void update_queue_time(uint32_t count)
+{
+    q.now += (int64_t)(int32_t)(count - q.last_count);
+    q.last_count = count;
+}
+
+static uint64_t event_key(int type, unsigned int count)
+{
+    uint64_t distance = (uint32_t)(count - q.last_count);
+
+    /* SPECIAL_INT marks the next Count wraparound, so when it is
+     * rescheduled right after firing it goes a full lap later. */
+    if (type == SPECIAL_INT)
+        return q.now + ((distance == 0) ? (UINT64_C(1) << 32) : distance);
+
+    /* Count is already past the event (e.g. reloaded from a savestate),
+     * it is due now rather than a full lap later */
+    if (distance >= UINT32_C(0x80000000))
+        return q.now;
+
+    return q.now + distance;
+}
+
+static void push_event(int type, unsigned int count, uint64_t key, int64_t seq)
+{
+    struct interrupt_event* e;
+
+    if (!reserve_queue(q.size + 1))
+    {
+        DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
+        return;
     }
-    else return 0;
+
+    e = &q.events[q.size++];
+    e->type = type;
+    e->count = count;
+    e->key = key;
+    e->seq = seq;
+    ++q.type_count[type_slot(type)];
+
+    sift_up(q.size - 1);
+}
+
+static void push_event_back(int type, unsigned int count)
+{
+    push_event(type, count, event_key(type, count), ++q.seq_back);
+}
+
+static unsigned int next_event_count(void)
+{
+    return (q.size > 0
+         && (q.events[0].count > g_cp0_regs[CP0_COUNT_REG]
+         || (g_cp0_regs[CP0_COUNT_REG] - q.events[0].count) < UINT32_C(0x80000000)))
+        ? q.events[0].count
+        : 0;
 }
 
 void add_interupt_event(int type, unsigned int delay)
@@ -171,14 +344,6 @@ void add_interupt_event(int type, unsigned int delay)
 
 void add_interupt_event_count(int type, unsigned int count)
 {
-    struct node* event;
-    struct node* e;
-    int special;
-
-    special = (type == SPECIAL_INT);
-   
-    if(g_cp0_regs[CP0_COUNT_REG] > UINT32_C(0x80000000)) SPECIAL_done = 0;
-   
     if (get_event(type)) {
         DebugMessage(M64MSG_WARNING, "two events of type 0x%x in interrupt queue", type);
         /* FIXME: hack-fix for freezing in Perfect Dark
@@ -188,142 +353,100 @@ void add_interupt_event_count(int type, unsigned int count)
         return;
     }
 
-    event = alloc_node(&q.pool);
-    if (event == NULL)
-    {
-        DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
-        return;
-    }
-
-    event->data.count = count;
-    event->data.type = type;
+    update_queue_time(g_cp0_regs[CP0_COUNT_REG]);
+    push_event_back(type, count);
 
-    if (q.first == NULL)
-    {
-        q.first = event;
-        event->next = NULL;
-        next_interupt = q.first->data.count;
-    }
-    else if (before_event(count, q.first->data.count, q.first->data.type) && !special)
-    {
-        event->next = q.first;
-        q.first = event;
-        next_interupt = q.first->data.count;
-    }
-    else
-    {
-        for(e = q.first;
-            e->next != NULL &&
-            (!before_event(count, e->next->data.count, e->next->data.type) || special);
-            e = e->next);
-
-        if (e->next == NULL)
-        {
-            e->next = event;
-            event->next = NULL;
-        }
-        else
-        {
-            if (!special)
-                for(; e->next != NULL && e->next->data.count == count; e = e->next);
-
-            event->next = e->next;
-            e->next = event;
-        }
-    }
+    if (q.events[0].type == type && q.events[0].count == count)
+        next_interupt = count;
 }
 
 static void remove_interupt_event(void)
 {
-    struct node* e;
-
-    e = q.first;
-    q.first = e->next;
-    free_node(&q.pool, e);
+    delete_event_at(0);
 
-    next_interupt = (q.first != NULL
-         && (q.first->data.count > g_cp0_regs[CP0_COUNT_REG]
-         || (g_cp0_regs[CP0_COUNT_REG] - q.first->data.count) < UINT32_C(0x80000000)))
-        ? q.first->data.count
-        : 0;
+    next_interupt = next_event_count();
 }
 
 unsigned int get_event(int type)
 {
-    struct node* e = q.first;
-
-    if (e == NULL)
-        return 0;
+    size_t i = find_event(type);
 
-    if (e->data.type == type)
-        return e->data.count;
-
-    for(; e->next != NULL && e->next->data.type != type; e = e->next);
-
-    return (e->next != NULL)
-        ? e->next->data.count
+    return (i < q.size)
+        ? q.events[i].count
         : 0;
 }
 
 int get_next_event_type(void)
 {
-    return (q.first == NULL)
+    return (q.size == 0)
         ? 0
-        : q.first->data.type;
+        : q.events[0].type;
 }
 
 void remove_event(int type)
 {
-    struct node* to_del;
-    struct node* e = q.first;
-
-    if (e == NULL)
-        return;
+    size_t i = find_event(type);
 
-    if (e->data.type == type)
-    {
-        q.first = e->next;
-        free_node(&q.pool, e);
-    }
-    else
-    {
-        for(; e->next != NULL && e->next->data.type != type; e = e->next);
-
-        if (e->next != NULL)
-        {
-            to_del = e->next;
-            e->next = to_del->next;
-            free_node(&q.pool, to_del);
-        }
-    }
+    if (i < q.size)
+        delete_event_at(i);
 }
 
 void translate_event_queue(unsigned int base)
 {
-    struct node* e;
+    size_t i;
 
     remove_event(COMPARE_INT);
     remove_event(SPECIAL_INT);
 
-    for(e = q.first; e != NULL; e = e->next)
+    /* rebase the timeline on the new Count value; relative order is
+     * unchanged so the heap property still holds */
+    update_queue_time(g_cp0_regs[CP0_COUNT_REG]);
+    q.last_count = base;
+
+    for (i = 0; i < q.size; ++i)
     {
-        e->data.count = (e->data.count - g_cp0_regs[CP0_COUNT_REG]) + base;
+        q.events[i].count = (q.events[i].count - g_cp0_regs[CP0_COUNT_REG]) + base;
     }
-    add_interupt_event_count(COMPARE_INT, g_cp0_regs[CP0_COMPARE_REG]);
-    add_interupt_event_count(SPECIAL_INT, 0);
+
+    push_event_back(COMPARE_INT, g_cp0_regs[CP0_COMPARE_REG]);
+    push_event_back(SPECIAL_INT, 0);
+}
+
+static int compare_events(const void* a, const void* b)
+{
+    const struct interrupt_event* e1 = (const struct interrupt_event*)a;
+    const struct interrupt_event* e2 = (const struct interrupt_event*)b;
+
+    if (event_before(e1, e2)) return -1;
+    if (event_before(e2, e1)) return 1;
+    return 0;
 }
 
 int save_eventqueue_infos(char *buf)
 {
     int len;
-    struct node* e;
+    size_t i;
+    size_t count = q.size;
+
+    /* a truncated queue would silently lose interrupts on load */
+    if (count > EVENTQUEUE_MAX_SAVED_EVENTS)
+    {
+        DebugMessage(M64MSG_ERROR, "Interrupt queue too long to be saved (%u events)",
+                (unsigned int)count);
+        return -1;
+    }
+
+    /* events are saved in firing order, so that reloading them
+     * with add_interupt_event_count rebuilds the same schedule */
+    memcpy(q.sorted, q.events, q.size * sizeof(q.sorted[0]));
+    qsort(q.sorted, q.size, sizeof(q.sorted[0]), compare_events);
 
     len = 0;
 
-    for(e = q.first; e != NULL; e = e->next)
+    for(i = 0; i < count; ++i)
     {
-        memcpy(buf + len    , &e->data.type , 4);
-        memcpy(buf + len + 4, &e->data.count, 4);
+        memcpy(buf + len    , &q.sorted[i].type , 4);
+        memcpy(buf + len + 4, &q.sorted[i].count, 4);
         len += 8;
     }
 
@@ -342,12 +465,12 @@ void load_eventqueue_infos(char *buf)
         add_interupt_event_count(type, count);
         len += 8;
     }
+
+    next_interupt = next_event_count();
 }
 
 void init_interupt(void)
 {
-    SPECIAL_done = 1;
-
     g_vi.delay = g_vi.next_vi = 5000;
 
     clear_queue();
@@ -357,8 +480,6 @@ void init_interupt(void)
 
 void check_interupt(void)
 {
-    struct node* event;
-
     if (g_r4300.mi.regs[MI_INTR_REG] & g_r4300.mi.regs[MI_INTR_MASK_REG])
         g_cp0_regs[CP0_CAUSE_REG] = (g_cp0_regs[CP0_CAUSE_REG] | UINT32_C(0x400)) & UINT32_C(0xFFFFFF83);
     else
@@ -366,28 +487,10 @@ void check_interupt(void)
     if ((g_cp0_regs[CP0_STATUS_REG] & UINT32_C(7)) != 1) return;
     if (g_cp0_regs[CP0_STATUS_REG] & g_cp0_regs[CP0_CAUSE_REG] & UINT32_C(0xFF00))
     {
-        event = alloc_node(&q.pool);
-
-        if (event == NULL)
-        {
-            DebugMessage(M64MSG_ERROR, "Failed to allocate node for new interrupt event");
-            return;
-        }
-
-        event->data.count = next_interupt = g_cp0_regs[CP0_COUNT_REG];
-        event->data.type = CHECK_INT;
-
-        if (q.first == NULL)
-        {
-            q.first = event;
-            event->next = NULL;
-        }
-        else
-        {
-            event->next = q.first;
-            q.first = event;
+        next_interupt = g_cp0_regs[CP0_COUNT_REG];
 
-        }
+        update_queue_time(g_cp0_regs[CP0_COUNT_REG]);
+        push_event(CHECK_INT, next_interupt, q.now, --q.seq_front);
     }
 }
 
@@ -426,8 +529,6 @@ static void special_int_handler(void)
     if (g_cp0_regs[CP0_COUNT_REG] > UINT32_C(0x10000000))
         return;
 
-
-    SPECIAL_done = 1;
     remove_interupt_event();
     add_interupt_event_count(SPECIAL_INT, 0);
 }
@@ -513,17 +614,14 @@ void gen_interupt(void)
         uint32_t dest = skip_jump;
         skip_jump = 0;
 
-        next_interupt = (q.first->data.count > g_cp0_regs[CP0_COUNT_REG]
-                || (g_cp0_regs[CP0_COUNT_REG] - q.first->data.count) < UINT32_C(0x80000000))
-            ? q.first->data.count
-            : 0;
+        next_interupt = next_event_count();
 
         last_addr = dest;
         generic_jump_to(dest);
         return;
     } 
 
-    switch(q.first->data.type)
+    switch(q.events[0].type)
     {
         case SPECIAL_INT:
             special_int_handler();
@@ -592,7 +690,7 @@ void gen_interupt(void)
             break;
 
         default:
-            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", q.first->data.type);
+            DebugMessage(M64MSG_ERROR, "Unknown interrupt queue event type %.8X.", q.events[0].type);
             remove_interupt_event();
             wrapped_exception_general();
             break;
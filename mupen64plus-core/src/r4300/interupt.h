@@ -42,6 +42,10 @@ void add_interupt_event(int type, unsigned int delay);
 unsigned int get_event(int type);
 int get_next_event_type(void);
 
+/* savestates reserve 1024 bytes for the event queue:
+ * (type, count) pairs followed by a 0xFFFFFFFF terminator */
+#define EVENTQUEUE_MAX_SAVED_EVENTS ((1024 - 4) / 8)
+
 int save_eventqueue_infos(char *buf);
 void load_eventqueue_infos(char *buf);
 
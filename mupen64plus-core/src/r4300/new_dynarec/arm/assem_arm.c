@@ -33,7 +33,7 @@ extern int ram_offset;
 extern uint64_t readmem_dword;
 extern precomp_instr fake_pc;
 extern void *dynarec_local;
-extern u_int memory_map[1048576];
+extern uintptr_t memory_map[1048576];
 extern u_int mini_ht[32][2];
 extern u_int rounding_modes[4];
 
@@ -337,6 +337,7 @@ void *dynamic_linker(void * src, u_int vaddr)
       assert((*(int*)((u_int)ptr2+20)&0x0ff00000)==0x01a00000); //mov
 #endif
       add_link(vaddr, ptr2);
+      tc_touch(head->addr);
       *ptr=(*ptr&0xFF000000)|((((u_int)head->addr-(u_int)ptr-8)<<6)>>8);
       __clear_cache((void*)ptr, (void*)((u_int)ptr+4));
       return head->addr;
@@ -344,7 +345,7 @@ void *dynamic_linker(void * src, u_int vaddr)
     head=head->next;
   }
 
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
   if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
 
@@ -353,7 +354,7 @@ void *dynamic_linker(void * src, u_int vaddr)
     if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
       //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(!tc_expiring((uintptr_t)head->addr)) {
         if(verify_dirty(head->addr)) {
           //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
           invalid_code[vaddr>>12]=0;
@@ -366,7 +367,7 @@ void *dynamic_linker(void * src, u_int vaddr)
             restore_candidate[vpage>>3]|=1<<(vpage&7);
           }
           else restore_candidate[page>>3]|=1<<(page&7);
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==vaddr) {
             ht_bin[1]=(int)head->addr; // Replace existing entry
           }
@@ -427,6 +428,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
       assert((*(int*)((u_int)ptr2+20)&0x0ff00000)==0x01a00000); //mov
 #endif
       add_link(vaddr, ptr2);
+      tc_touch(head->addr);
       *ptr=(*ptr&0xFF000000)|((((u_int)head->addr-(u_int)ptr-8)<<6)>>8);
       __clear_cache((void*)ptr, (void*)((u_int)ptr+4));
       return head->addr;
@@ -434,7 +436,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
     head=head->next;
   }
 
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
   if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
 
@@ -443,7 +445,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
     if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
       //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(!tc_expiring((uintptr_t)head->addr)) {
         if(verify_dirty(head->addr)) {
           //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
           invalid_code[vaddr>>12]=0;
@@ -456,7 +458,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
             restore_candidate[vpage>>3]|=1<<(vpage&7);
           }
           else restore_candidate[page>>3]|=1<<(page&7);
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==vaddr) {
             ht_bin[1]=(int)head->addr; // Replace existing entry
           }
@@ -617,7 +619,7 @@ static int isclean(int addr)
   return 1;
 }
 
-static void get_bounds(int addr,u_int *start,u_int *end)
+static void get_bounds(int addr,uintptr_t *start,uintptr_t *end)
 {
   u_int *ptr=(u_int *)addr;
   #ifdef ARMv5_ONLY
@@ -2136,6 +2138,11 @@ static void emit_readword(int addr, int rt)
   assem_debug("ldr %s,fp+%d",regname[rt],offset);
   output_w32(0xe5900000|rd_rn_rm(rt,FP,0)|offset);
 }
+// Pointers are 32 bits on this host
+static void emit_readptr(int addr, int rt)
+{
+  emit_readword(addr,rt);
+}
 static void emit_movsbl(int addr, int rt)
 {
   u_int offset = addr-(u_int)&dynarec_local;
@@ -3307,7 +3314,7 @@ static int do_tlb_r(int s,int ar,int map,int cache,int x,int a,int shift,int c,u
   }
   return map;
 }
-static int do_tlb_r_branch(int map, int c, u_int addr, int *jaddr)
+static int do_tlb_r_branch(int map, int c, u_int addr, intptr_t *jaddr)
 {
   if(!c||(signed int)addr>=(signed int)0xC0000000) {
     emit_test(map,map);
@@ -3349,7 +3356,7 @@ static int do_tlb_w(int s,int ar,int map,int cache,int x,int c,u_int addr)
   }
   return map;
 }
-static void do_tlb_w_branch(int map, int c, u_int addr, int *jaddr)
+static void do_tlb_w_branch(int map, int c, u_int addr, intptr_t *jaddr)
 {
   if(!c||addr<0x80800000||addr>=0xC0000000) {
     emit_testimm(map,0x40000000);
@@ -3496,7 +3503,7 @@ static void loadlr_assemble_arm(int i,struct regstat *i_regs)
 {
   int s,th,tl,temp,temp2,addr,map=-1,cache=-1;
   int offset;
-  int jaddr=0;
+  intptr_t jaddr=0;
   int memtarget,c=0;
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,rt1[i]|64);
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "../../../../main/main.h"
 #include "../../../../main/rom.h"
 #include "../../../../memory/memory.h"
@@ -18,7 +20,7 @@
 extern "C" {
 #endif
 
-extern u_int memory_map[1048576];
+extern uintptr_t memory_map[1048576];
 
 #ifdef __cplusplus
 }
@@ -47,10 +49,12 @@ void tlb_hacks(void)
             addr=0;
             break;
       }
-      u_int rom_addr=(u_int)g_rom;
+      uintptr_t rom_addr=(uintptr_t)g_rom;
+      // memory_map points straight into the ROM, load all of it
+      touch_rom(0, g_rom_size);
 #ifdef ROM_COPY
-      // Since memory_map is 32-bit, on 64-bit systems the rom needs to be
-      // in the lower 4G of memory to use this hack.  Copy it if necessary.
+      // memory_map entries are pointer sized, so this is only needed when
+      // the rom has to stay in the lower 4G of memory anyway.
       if((void *)g_rom>(void *)0xffffffff) {
          munmap(ROM_COPY, 67108864);
          if(mmap(ROM_COPY, 12582912,
@@ -58,12 +62,12 @@ void tlb_hacks(void)
                   MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
                   -1, 0) <= 0) {DebugMessage(M64MSG_ERROR, "mmap() failed");}
          memcpy(ROM_COPY,g_rom,12582912);
-         rom_addr=(u_int)ROM_COPY;
+         rom_addr=(uintptr_t)ROM_COPY;
       }
 #endif
       if(addr) {
          for(n=0x7F000;n<0x80000;n++) {
-            memory_map[n]=(((u_int)(rom_addr+addr-0x7F000000))>>2)|0x40000000;
+            memory_map[n]=((rom_addr+addr-0x7F000000)>>2)|WRITE_PROTECT;
          }
       }
    }
@@ -49,6 +49,7 @@ extern "C" {
 #endif
 #include "../../main/main.h"
 #include "../../memory/memory.h"
+#include "../../ri/ri_controller.h"
 #include "../../rsp/rsp_core.h"
 #include "../cached_interp.h"
 #include "../cp0_private.h"
@@ -72,6 +73,8 @@ extern "C" {
 
 #if NEW_DYNAREC == NEW_DYNAREC_X86
 #include "x86/assem_x86.h"
+#elif NEW_DYNAREC == NEW_DYNAREC_AMD64
+#include "x64/assem_x64.h"
 #elif NEW_DYNAREC == NEW_DYNAREC_ARM
 #include "arm/arm_cpu_features.h"
 #include "arm/assem_arm.h"
@@ -116,13 +119,14 @@ struct ll_entry
 extern "C" {
 #endif
 extern u_char restore_candidate[512];
+extern u_int tc_used[8]; // TC_SEGMENTS, also set by generated code
 extern int cycle_count;
 extern int last_count;
 extern int branch_target;
 extern uint64_t readmem_dword;
 extern struct ll_entry *jump_in[4096];
 extern struct ll_entry *jump_dirty[4096];
-extern ALIGN(16, u_int hash_table[65536][4]);
+extern ALIGN(16, uintptr_t hash_table[65536][4]);
 #ifdef __cplusplus
 }
 #endif
@@ -170,10 +174,10 @@ static u_int wont_dirty[MAXBLOCK];
 static u_int will_dirty[MAXBLOCK];
 static int ccadj[MAXBLOCK];
 static int slen;
-static u_int instr_addr[MAXBLOCK];
-static u_int link_addr[MAXBLOCK][3];
+static uintptr_t instr_addr[MAXBLOCK];
+static uintptr_t link_addr[MAXBLOCK][3];
 static int linkcount;
-static u_int stubs[MAXBLOCK*3][8];
+static intptr_t stubs[MAXBLOCK*3][8];
 static int stubcount;
 static int literalcount;
 static int is_delayslot;
@@ -182,11 +186,43 @@ u_char *out;
 struct ll_entry *jump_in[4096];
 static struct ll_entry *jump_out[4096];
 struct ll_entry *jump_dirty[4096];
-ALIGN(16, u_int hash_table[65536][4]);
+ALIGN(16, uintptr_t hash_table[65536][4]);
+// Second level of the block lookup, searched by get_addr before the
+// jump_in lists.  Four ways of vaddr,addr per set, most recent first.
+#define L2_SETS 4096
+ALIGN(16, static uintptr_t lookup_l2[L2_SETS][8]);
+#ifdef USE_JR_IC
+// Inline caches for JR/JALR through registers other than $ra.  Each
+// call site gets a vaddr,addr slot (see do_jr_ic_jump), which is
+// refilled by jump_vaddr_ic when the target changes.
+#define JR_IC_SLOTS 1024
+ALIGN(16, uintptr_t jr_ic[JR_IC_SLOTS][2]);
+uint64_t jr_ic_misses; // Counted by jump_vaddr_ic
+static int jr_ic_next;
+#endif
 ALIGN(16, static char shadow[2097152]);
 static char *copy;
-static int expirep;
+// The translation cache is split into TC_SEGMENTS segments.  Blocks are
+// written into one segment at a time (tc_seg) while the segment which
+// will be filled next (tc_next) is expired incrementally.  tc_next is
+// chosen by a clock over the segments, skipping those which were used
+// since the hand last passed them.  A segment is marked used (tc_used)
+// by lookups from C, when a link to it is made, and by the cycle count
+// stubs of its blocks, so code which keeps running fully linked is
+// sampled at every interrupt check.
+#define TC_SEGMENTS 8
+#define TC_MIN_SIZE_2 24 // 16 megabytes
+#define TC_EXPIRE_DONE 8192 // Four passes over 2048 bins
+static int tc_size_2; // Log2 of the part of the cache in use
+static u_int tc_request; // Size requested by the frontend (MB), 0 = default
+static int tc_seg;
+static int tc_next;
+static int tc_hand;
+static u_int tc_filled; // Segments which have held code
+static int expirep; // Expiry progress through tc_next
+static struct new_dynarec_stats tc_stats;
 u_int using_tlb;
+static int rdram_writes_trapped;
 static u_int stop_after_jal;
 
   /* registers that may be allocated */
@@ -291,6 +327,8 @@ void jump_eret();
 #ifdef __cplusplus
 }
 #endif
+static void *l2_lookup(u_int vaddr);
+static void l2_insert(u_int vaddr,void *addr);
 static void remove_hash(int vaddr);
 #if NEW_DYNAREC == NEW_DYNAREC_ARM
 static void invalidate_addr(u_int addr);
@@ -314,7 +352,7 @@ void write_rdram_new(void);
 void write_rdramb_new(void);
 void write_rdramh_new(void);
 void write_rdramd_new(void);
-extern u_int memory_map[1048576];
+extern uintptr_t memory_map[1048576];
 #ifdef __cplusplus
 }
 #endif
@@ -328,8 +366,8 @@ static void load_needed_regs(signed char i_regmap[],signed char next_regmap[]);
 static void load_regs_entry(int t);
 static void load_all_consts(signed char regmap[],int is32,u_int dirty,int i);
 
-static void add_stub(int type,int addr,int retaddr,int a,int b,int c,int d,int e);
-static void add_to_linker(int addr,int target,int ext);
+static void add_stub(int type,intptr_t addr,intptr_t retaddr,intptr_t a,intptr_t b,intptr_t c,intptr_t d,intptr_t e);
+static void add_to_linker(intptr_t addr,intptr_t target,int ext);
 static int verify_dirty(void *addr);
 
 //static int tracedebug=0;
@@ -366,6 +404,60 @@ static void nullf() {}
 
 #define log_message(...) DebugMessage(M64MSG_VERBOSE, __VA_ARGS__)
 
+// Segment of the translation cache containing addr
+static uintptr_t tc_segment(uintptr_t addr)
+{
+  return (addr-(uintptr_t)base_addr)>>(tc_size_2-3);
+}
+
+static u_char *tc_segment_base(int seg)
+{
+  return (u_char *)base_addr+((uintptr_t)seg<<(tc_size_2-3));
+}
+
+// Mark the segment containing a block as recently used
+static void tc_touch(void *addr)
+{
+  tc_used[tc_segment((uintptr_t)addr)]=1;
+}
+
+// Check if a block is in the segment which is being expired,
+// such blocks must not be linked to or restored
+static int tc_expiring(uintptr_t addr)
+{
+  uintptr_t seg=tc_segment(addr);
+  return seg==(uintptr_t)tc_next||(seg==(uintptr_t)tc_seg&&addr>=(uintptr_t)out);
+}
+
+// Advance the clock hand to the next segment which has not been
+// used since the last pass, never picking the one being filled
+static int tc_victim(void)
+{
+  int seg;
+  for(;;) {
+    seg=tc_hand;
+    tc_hand=(tc_hand+1)%TC_SEGMENTS;
+    if(seg==tc_seg) continue;
+    if(tc_used[seg]) {
+      tc_used[seg]=0;
+      continue;
+    }
+    return seg;
+  }
+}
+
+#ifdef USE_JR_IC
+// Slots are handed out round robin, once the table wraps
+// two call sites may share a slot, which only costs misses
+static uintptr_t *jr_ic_alloc(void)
+{
+  uintptr_t *slot=jr_ic[jr_ic_next];
+  jr_ic_next=(jr_ic_next+1)%JR_IC_SLOTS;
+  tc_stats.jr_ic_sites++;
+  return slot;
+}
+#endif
+
 // Get address from virtual address
 // This is called from the recompiled JR/JALR instructions
 void *get_addr(u_int vaddr)
@@ -377,16 +469,32 @@ void *get_addr(u_int vaddr)
   if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
   if(vpage>2048) vpage=2048+(vpage&2047);
   struct ll_entry *head;
+  void *addr;
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr %x,page %d)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,page);
+  tc_stats.lookups++;
+  addr=l2_lookup(vaddr);
+  if(addr) {
+    uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+    ht_bin[3]=ht_bin[1];
+    ht_bin[2]=ht_bin[0];
+    ht_bin[1]=(intptr_t)addr;
+    ht_bin[0]=vaddr;
+    tc_touch(addr);
+    tc_stats.l2_hits++;
+    return addr;
+  }
   head=jump_in[page];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&head->reg_sv_flags ==0) {
-  //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
-      u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
+      uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
       ht_bin[3]=ht_bin[1];
       ht_bin[2]=ht_bin[0];
-      ht_bin[1]=(int)head->addr;
+      ht_bin[1]=(intptr_t)head->addr;
       ht_bin[0]=vaddr;
+      if(!tc_expiring((uintptr_t)head->addr)) l2_insert(vaddr,head->addr);
+      tc_touch(head->addr);
+      tc_stats.list_hits++;
       return head->addr;
     }
     head=head->next;
@@ -394,32 +502,34 @@ void *get_addr(u_int vaddr)
   head=jump_dirty[vpage];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&head->reg_sv_flags ==0) {
-      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(!tc_expiring((uintptr_t)head->addr)) {
         if(verify_dirty(head->addr)) {
           //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
           invalid_code[vaddr>>12]=0;
-          memory_map[vaddr>>12]|=0x40000000;
+          memory_map[vaddr>>12]|=WRITE_PROTECT;
           if(vpage<2048) {
             if(tlb_LUT_r[vaddr>>12]) {
               invalid_code[tlb_LUT_r[vaddr>>12]>>12]=0;
-              memory_map[tlb_LUT_r[vaddr>>12]>>12]|=0x40000000;
+              memory_map[tlb_LUT_r[vaddr>>12]>>12]|=WRITE_PROTECT;
             }
             restore_candidate[vpage>>3]|=1<<(vpage&7);
           }
           else restore_candidate[page>>3]|=1<<(page&7);
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==vaddr) {
-            ht_bin[1]=(int)head->addr; // Replace existing entry
+            ht_bin[1]=(intptr_t)head->addr; // Replace existing entry
           }
           else
           {
             ht_bin[3]=ht_bin[1];
             ht_bin[2]=ht_bin[0];
-            ht_bin[1]=(int)head->addr;
+            ht_bin[1]=(intptr_t)head->addr;
             ht_bin[0]=vaddr;
           }
+          tc_touch(head->addr);
+          tc_stats.list_hits++;
           return head->addr;
         }
       }
@@ -442,18 +552,18 @@ void *get_addr(u_int vaddr)
 void *get_addr_ht(u_int vaddr)
 {
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_ht %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr);
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-  if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
-  if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  if(ht_bin[0]==vaddr) {tc_touch((void *)ht_bin[1]);return (void *)ht_bin[1];}
+  if(ht_bin[2]==vaddr) {tc_touch((void *)ht_bin[3]);return (void *)ht_bin[3];}
   return get_addr(vaddr);
 }
 
 void *get_addr_32(u_int vaddr,u_int flags)
 {
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 %x,flags %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,flags);
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
-  if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
-  if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  if(ht_bin[0]==vaddr) {tc_touch((void *)ht_bin[1]);return (void *)ht_bin[1];}
+  if(ht_bin[2]==vaddr) {tc_touch((void *)ht_bin[3]);return (void *)ht_bin[3];}
   u_int page=(vaddr^0x80000000)>>12;
   u_int vpage=page;
   if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
@@ -461,24 +571,37 @@ void *get_addr_32(u_int vaddr,u_int flags)
   if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
   if(vpage>2048) vpage=2048+(vpage&2047);
   struct ll_entry *head;
+  void *addr;
+  // Blocks in the second level table have no register flags,
+  // so they are valid for any caller
+  tc_stats.lookups++;
+  addr=l2_lookup(vaddr);
+  if(addr) {
+    tc_touch(addr);
+    tc_stats.l2_hits++;
+    return addr;
+  }
   head=jump_in[page];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&(head->reg_sv_flags &flags)==0) {
-      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
       if(head->reg_sv_flags ==0) {
-        u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+        uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
         if(ht_bin[0]==-1) {
-          ht_bin[1]=(int)head->addr;
+          ht_bin[1]=(intptr_t)head->addr;
           ht_bin[0]=vaddr;
         }else if(ht_bin[2]==-1) {
-          ht_bin[3]=(int)head->addr;
+          ht_bin[3]=(intptr_t)head->addr;
           ht_bin[2]=vaddr;
         }
         //ht_bin[3]=ht_bin[1];
         //ht_bin[2]=ht_bin[0];
-        //ht_bin[1]=(int)head->addr;
+        //ht_bin[1]=(intptr_t)head->addr;
         //ht_bin[0]=vaddr;
+        if(!tc_expiring((uintptr_t)head->addr)) l2_insert(vaddr,head->addr);
       }
+      tc_touch(head->addr);
+      tc_stats.list_hits++;
       return head->addr;
     }
     head=head->next;
@@ -486,35 +609,37 @@ void *get_addr_32(u_int vaddr,u_int flags)
   head=jump_dirty[vpage];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&(head->reg_sv_flags &flags)==0) {
-      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr_32 match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(intptr_t)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(!tc_expiring((uintptr_t)head->addr)) {
         if(verify_dirty(head->addr)) {
           //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
           invalid_code[vaddr>>12]=0;
-          memory_map[vaddr>>12]|=0x40000000;
+          memory_map[vaddr>>12]|=WRITE_PROTECT;
           if(vpage<2048) {
             if(tlb_LUT_r[vaddr>>12]) {
               invalid_code[tlb_LUT_r[vaddr>>12]>>12]=0;
-              memory_map[tlb_LUT_r[vaddr>>12]>>12]|=0x40000000;
+              memory_map[tlb_LUT_r[vaddr>>12]>>12]|=WRITE_PROTECT;
             }
             restore_candidate[vpage>>3]|=1<<(vpage&7);
           }
           else restore_candidate[page>>3]|=1<<(page&7);
           if(head->reg_sv_flags ==0) {
-            u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+            uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
             if(ht_bin[0]==-1) {
-              ht_bin[1]=(int)head->addr;
+              ht_bin[1]=(intptr_t)head->addr;
               ht_bin[0]=vaddr;
             }else if(ht_bin[2]==-1) {
-              ht_bin[3]=(int)head->addr;
+              ht_bin[3]=(intptr_t)head->addr;
               ht_bin[2]=vaddr;
             }
             //ht_bin[3]=ht_bin[1];
             //ht_bin[2]=ht_bin[0];
-            //ht_bin[1]=(int)head->addr;
+            //ht_bin[1]=(intptr_t)head->addr;
             //ht_bin[0]=vaddr;
           }
+          tc_touch(head->addr);
+          tc_stats.list_hits++;
           return head->addr;
         }
       }
@@ -985,6 +1110,8 @@ static uint64_t ldr_merge(uint64_t original,uint64_t loaded,u_int bits)
 
 #if NEW_DYNAREC == NEW_DYNAREC_X86
 #include "x86/assem_x86.c"
+#elif NEW_DYNAREC == NEW_DYNAREC_AMD64
+#include "x64/assem_x64.c"
 #elif NEW_DYNAREC == NEW_DYNAREC_ARM
 #include "arm/assem_arm.c"
 #else
@@ -1021,13 +1148,13 @@ static void ll_add_32(struct ll_entry **head,int vaddr,u_int reg32,void *addr)
 // but don't return addresses which are about to expire from the cache
 static void *check_addr(u_int vaddr)
 {
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) {
-    if(((ht_bin[1]-MAX_OUTPUT_BLOCK_SIZE-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+    if(!tc_expiring(ht_bin[1]))
       if(isclean(ht_bin[1])) return (void *)ht_bin[1];
   }
   if(ht_bin[2]==vaddr) {
-    if(((ht_bin[3]-MAX_OUTPUT_BLOCK_SIZE-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2)))
+    if(!tc_expiring(ht_bin[3]))
       if(isclean(ht_bin[3])) return (void *)ht_bin[3];
   }
   u_int page=(vaddr^0x80000000)>>12;
@@ -1037,24 +1164,24 @@ static void *check_addr(u_int vaddr)
   head=jump_in[page];
   while(head!=NULL) {
     if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(!tc_expiring((uintptr_t)head->addr)) {
         // Update existing entry with current address
         if(ht_bin[0]==vaddr) {
-          ht_bin[1]=(int)head->addr;
+          ht_bin[1]=(intptr_t)head->addr;
           return head->addr;
         }
         if(ht_bin[2]==vaddr) {
-          ht_bin[3]=(int)head->addr;
+          ht_bin[3]=(intptr_t)head->addr;
           return head->addr;
         }
         // Insert into hash table with low priority.
         // Don't evict existing entries, as they are probably
         // addresses that are being accessed frequently.
         if(ht_bin[0]==-1) {
-          ht_bin[1]=(int)head->addr;
+          ht_bin[1]=(intptr_t)head->addr;
           ht_bin[0]=vaddr;
         }else if(ht_bin[2]==-1) {
-          ht_bin[3]=(int)head->addr;
+          ht_bin[3]=(intptr_t)head->addr;
           ht_bin[2]=vaddr;
         }
         return head->addr;
@@ -1065,10 +1192,69 @@ static void *check_addr(u_int vaddr)
   return 0;
 }
 
+static uintptr_t *l2_set(u_int vaddr)
+{
+  return lookup_l2[((vaddr>>2)^(vaddr>>14))&(L2_SETS-1)];
+}
+
+// Look up a clean block in the second level table,
+// moving it to the front of its set
+static void *l2_lookup(u_int vaddr)
+{
+  uintptr_t *set=l2_set(vaddr);
+  uintptr_t addr;
+  int i;
+  for(i=0;i<8;i+=2) {
+    if(set[i]==vaddr) {
+      addr=set[i+1];
+      for(;i>0;i-=2) {
+        set[i]=set[i-2];
+        set[i+1]=set[i-1];
+      }
+      set[0]=vaddr;
+      set[1]=addr;
+      return (void *)addr;
+    }
+  }
+  return NULL;
+}
+
+// Only entries which are also in jump_in are added, so that
+// remove_hash keeps the two in step
+static void l2_insert(u_int vaddr,void *addr)
+{
+  uintptr_t *set=l2_set(vaddr);
+  int i;
+  for(i=0;i<6;i+=2)
+    if(set[i]==vaddr) break;
+  for(;i>0;i-=2) {
+    set[i]=set[i-2];
+    set[i+1]=set[i-1];
+  }
+  set[0]=vaddr;
+  set[1]=(uintptr_t)addr;
+}
+
+static void l2_remove(u_int vaddr)
+{
+  uintptr_t *set=l2_set(vaddr);
+  int i;
+  for(i=0;i<8;i+=2) {
+    if(set[i]==vaddr) {
+      for(;i<6;i+=2) {
+        set[i]=set[i+2];
+        set[i+1]=set[i+3];
+      }
+      set[6]=set[7]=-1;
+      return;
+    }
+  }
+}
+
 static void remove_hash(int vaddr)
 {
   //DebugMessage(M64MSG_VERBOSE, "remove hash: %x",vaddr);
-  u_int *ht_bin=hash_table[(((vaddr)>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[(((vaddr)>>16)^vaddr)&0xFFFF];
   if(ht_bin[2]==vaddr) {
     ht_bin[2]=ht_bin[3]=-1;
   }
@@ -1077,16 +1263,16 @@ static void remove_hash(int vaddr)
     ht_bin[1]=ht_bin[3];
     ht_bin[2]=ht_bin[3]=-1;
   }
+  l2_remove(vaddr);
 }
 
-static void ll_remove_matching_addrs(struct ll_entry **head,int addr,int shift)
+static void ll_remove_matching_addrs(struct ll_entry **head,int seg)
 {
   struct ll_entry *next;
   while(*head) {
-    if((((u_int)((*head)->addr)-(u_int)base_addr)>>shift)==((addr-(u_int)base_addr)>>shift) ||
-       (((u_int)((*head)->addr)-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(u_int)base_addr)>>shift))
+    if(tc_segment((uintptr_t)(*head)->addr)==(uintptr_t)seg)
     {
-      inv_debug("EXP: Remove pointer to %x (%x)\n",(int)(*head)->addr,(*head)->vaddr);
+      inv_debug("EXP: Remove pointer to %x (%x)\n",(int)(intptr_t)(*head)->addr,(*head)->vaddr);
       remove_hash((*head)->vaddr);
       next=(*head)->next;
       free(*head);
@@ -1115,18 +1301,17 @@ static void ll_clear(struct ll_entry **head)
 }
 
 // Dereference the pointers and remove if it matches
-static void ll_kill_pointers(struct ll_entry *head,int addr,int shift)
+static void ll_kill_pointers(struct ll_entry *head,int seg)
 {
   while(head) {
-    u_int ptr=get_pointer(head->addr);
-    inv_debug("EXP: Lookup pointer to %x at %x (%x)\n",(int)ptr,(int)head->addr,head->vaddr);
-    if((((ptr-(u_int)base_addr)>>shift)==((addr-(u_int)base_addr)>>shift)) ||
-       (((ptr-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((addr-(u_int)base_addr)>>shift)))
+    uintptr_t ptr=(uintptr_t)get_pointer(head->addr);
+    inv_debug("EXP: Lookup pointer to %x at %x (%x)\n",(int)ptr,(intptr_t)head->addr,head->vaddr);
+    if(tc_segment(ptr)==(uintptr_t)seg)
     {
-      inv_debug("EXP: Kill pointer at %x (%x)\n",(int)head->addr,head->vaddr);
-      u_int host_addr=(int)kill_pointer(head->addr);
+      inv_debug("EXP: Kill pointer at %x (%x)\n",(intptr_t)head->addr,head->vaddr);
+      uintptr_t host_addr=(uintptr_t)kill_pointer(head->addr);
       #if NEW_DYNAREC == NEW_DYNAREC_ARM
-        needs_clear_cache[(host_addr-(u_int)base_addr)>>17]|=1<<(((host_addr-(u_int)base_addr)>>12)&31);
+        needs_clear_cache[(host_addr-(uintptr_t)base_addr)>>17]|=1<<(((host_addr-(uintptr_t)base_addr)>>12)&31);
       #else
         /* avoid unused variable warning */
         (void)host_addr;
@@ -1153,10 +1338,10 @@ static void invalidate_page(u_int page)
   head=jump_out[page];
   jump_out[page]=0;
   while(head!=NULL) {
-    inv_debug("INVALIDATE: kill pointer to %x (%x)\n",head->vaddr,(int)head->addr);
-      u_int host_addr=(int)kill_pointer(head->addr);
+    inv_debug("INVALIDATE: kill pointer to %x (%x)\n",head->vaddr,(intptr_t)head->addr);
+      uintptr_t host_addr=(uintptr_t)kill_pointer(head->addr);
     #if NEW_DYNAREC == NEW_DYNAREC_ARM
-      needs_clear_cache[(host_addr-(u_int)base_addr)>>17]|=1<<(((host_addr-(u_int)base_addr)>>12)&31);
+      needs_clear_cache[(host_addr-(uintptr_t)base_addr)>>17]|=1<<(((host_addr-(uintptr_t)base_addr)>>12)&31);
     #else
       /* avoid unused variable warning */
       (void)host_addr;
@@ -1166,7 +1351,7 @@ static void invalidate_page(u_int page)
     head=next;
   }
 }
-void invalidate_block(u_int block)
+static void invalidate_code_block(u_int block)
 {
   u_int page,vpage;
   page=vpage=block^0x80000;
@@ -1182,20 +1367,20 @@ void invalidate_block(u_int block)
   head=jump_dirty[vpage];
   //DebugMessage(M64MSG_VERBOSE, "page=%d vpage=%d",page,vpage);
   while(head!=NULL) {
-    u_int start,end;
+    uintptr_t start,end;
     if(vpage>2047||(head->vaddr>>12)==block) { // Ignore vaddr hash collision
-      get_bounds((int)head->addr,&start,&end);
+      get_bounds((intptr_t)head->addr,&start,&end);
       //DebugMessage(M64MSG_VERBOSE, "start: %x end: %x",start,end);
       if(page<2048&&start>=0x80000000&&end<0x80800000) {
-        if(((start-(u_int)g_rdram)>>12)<=page&&((end-1-(u_int)g_rdram)>>12)>=page) {
-          if((((start-(u_int)g_rdram)>>12)&2047)<first) first=((start-(u_int)g_rdram)>>12)&2047;
-          if((((end-1-(u_int)g_rdram)>>12)&2047)>last) last=((end-1-(u_int)g_rdram)>>12)&2047;
+        if(((start-(uintptr_t)g_rdram)>>12)<=page&&((end-1-(uintptr_t)g_rdram)>>12)>=page) {
+          if((((start-(uintptr_t)g_rdram)>>12)&2047)<first) first=((start-(uintptr_t)g_rdram)>>12)&2047;
+          if((((end-1-(uintptr_t)g_rdram)>>12)&2047)>last) last=((end-1-(uintptr_t)g_rdram)>>12)&2047;
         }
       }
-      if(page<2048&&(signed int)start>=(signed int)0xC0000000&&(signed int)end>=(signed int)0xC0000000) {
-        if(((start+memory_map[start>>12]-(u_int)g_rdram)>>12)<=page&&((end-1+memory_map[(end-1)>>12]-(u_int)g_rdram)>>12)>=page) {
-          if((((start+memory_map[start>>12]-(u_int)g_rdram)>>12)&2047)<first) first=((start+memory_map[start>>12]-(u_int)g_rdram)>>12)&2047;
-          if((((end-1+memory_map[(end-1)>>12]-(u_int)g_rdram)>>12)&2047)>last) last=((end-1+memory_map[(end-1)>>12]-(u_int)g_rdram)>>12)&2047;
+      if(page<2048&&(signed int)start>=(signed int)0xC0000000&&(signed int)end>=(signed int)0xC0000000&&((end-1)>>12)<1048576) {
+        if(((start+memory_map[start>>12]-(uintptr_t)g_rdram)>>12)<=page&&((end-1+memory_map[(end-1)>>12]-(uintptr_t)g_rdram)>>12)>=page) {
+          if((((start+memory_map[start>>12]-(uintptr_t)g_rdram)>>12)&2047)<first) first=((start+memory_map[start>>12]-(uintptr_t)g_rdram)>>12)&2047;
+          if((((end-1+memory_map[(end-1)>>12]-(uintptr_t)g_rdram)>>12)&2047)>last) last=((end-1+memory_map[(end-1)>>12]-(uintptr_t)g_rdram)>>12)&2047;
         }
       }
     }
@@ -1223,15 +1408,51 @@ void invalidate_block(u_int block)
   if(tlb_LUT_w[block]) {
     assert(tlb_LUT_r[block]==tlb_LUT_w[block]);
     // CHECK: Is this right?
-    memory_map[block]=((tlb_LUT_w[block]&0xFFFFF000)-(block<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+    memory_map[block]=((uintptr_t)(tlb_LUT_w[block]&0xFFFFF000)-((uintptr_t)block<<12)+(uintptr_t)g_rdram-0x80000000)>>2;
     u_int real_block=tlb_LUT_w[block]>>12;
     invalid_code[real_block]=1;
-    if(real_block>=0x80000&&real_block<0x80800) memory_map[real_block]=((u_int)g_rdram-0x80000000)>>2;
+    if(real_block>=0x80000&&real_block<0x80800) memory_map[real_block]=((uintptr_t)g_rdram-0x80000000)>>2;
   }
-  else if(block>=0x80000&&block<0x80800) memory_map[block]=((u_int)g_rdram-0x80000000)>>2;
+  else if(block>=0x80000&&block<0x80800) memory_map[block]=((uintptr_t)g_rdram-0x80000000)>>2;
   #ifdef USE_MINI_HT
   memset(mini_ht,-1,sizeof(mini_ht));
   #endif
+  #ifdef USE_JR_IC
+  memset(jr_ic,-1,sizeof(jr_ic));
+  #endif
+}
+
+// Called by compiled code when writing to a page with invalid_code[page]!=1
+void invalidate_block(u_int block)
+{
+  if((block>=0x80000&&block<0x80800)||(block>=0xA0000&&block<0xA0800)) {
+    u_int page=block^0x80000;
+    if(page>2048) page=2048+(page&2047);
+    mark_rdram_dirty(&g_ri.rdram,block<<12,1,RDRAM_DIRTY_SAVESTATE);
+    // Only trapped for new_dynarec_trap_rdram_writes, no code to invalidate
+    if(!jump_in[page]&&!jump_out[page]&&!jump_dirty[page]) {
+      invalid_code[block]=1;
+      if(block<0x80800) memory_map[block]=((uintptr_t)g_rdram-0x80000000)>>2;
+      return;
+    }
+  }
+  invalidate_code_block(block);
+}
+
+// Compiled code only calls invalidate_block for pages with code on them.
+// To know every RDRAM page the CPU writes, all of them are trapped once
+// more here; returns 1 if no write could bypass the traps since the
+// previous call.
+int new_dynarec_trap_rdram_writes(void)
+{
+  int trapped=rdram_writes_trapped&&!using_tlb;
+  u_int n;
+  for(n=0;n<2048;n++) {
+    invalid_code[0x80000+n]=0;
+    invalid_code[0xA0000+n]=0;
+  }
+  rdram_writes_trapped=1;
+  return trapped;
 }
 
 void invalidate_cached_code_new_dynarec(uint32_t address, size_t size)
@@ -1252,7 +1473,7 @@ void invalidate_cached_code_new_dynarec(uint32_t address, size_t size)
     }
 
     for(i = begin; i <= end; ++i)
-        invalidate_block(i);
+        invalidate_code_block(i);
 }
 
 #if NEW_DYNAREC == NEW_DYNAREC_ARM
@@ -1267,6 +1488,7 @@ static void invalidate_addr(u_int addr)
 void invalidate_all_pages(void)
 {
   u_int page;
+  tc_stats.flushes++;
   for(page=0;page<4096;page++)
     invalidate_page(page);
   for(page=0;page<1048576;page++)
@@ -1283,12 +1505,15 @@ void invalidate_all_pages(void)
   #ifdef USE_MINI_HT
   memset(mini_ht,-1,sizeof(mini_ht));
   #endif
+  #ifdef USE_JR_IC
+  memset(jr_ic,-1,sizeof(jr_ic));
+  #endif
   // TLB
   for(page=0;page<0x100000;page++) {
     if(tlb_LUT_r[page]) {
-      memory_map[page]=((tlb_LUT_r[page]&0xFFFFF000)-(page<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+      memory_map[page]=((uintptr_t)(tlb_LUT_r[page]&0xFFFFF000)-((uintptr_t)page<<12)+(uintptr_t)g_rdram-0x80000000)>>2;
       if(!tlb_LUT_w[page]||!invalid_code[page])
-        memory_map[page]|=0x40000000; // Write protect
+        memory_map[page]|=WRITE_PROTECT; // Write protect
     }
     else memory_map[page]=-1;
     if(page==0x80000) page=0xC0000;
@@ -1302,7 +1527,7 @@ void add_link(u_int vaddr,void *src)
   u_int page=(vaddr^0x80000000)>>12;
   if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
   if(page>4095) page=2048+(page&2047);
-  inv_debug("add_link: %x -> %x (%d)\n",(int)src,vaddr,page);
+  inv_debug("add_link: %x -> %x (%d)\n",(int)(intptr_t)src,vaddr,page);
   ll_add(jump_out+page,vaddr,src);
   //int ptr=get_pointer(src);
   //inv_debug("add_link: Pointer is to %x\n",(int)ptr);
@@ -1320,20 +1545,20 @@ void clean_blocks(u_int page)
   while(head!=NULL) {
     if(!invalid_code[head->vaddr>>12]) {
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
-        u_int start,end;
+      if(!tc_expiring((uintptr_t)head->addr)) {
+        uintptr_t start,end;
         if(verify_dirty(head->addr)) {
-          //DebugMessage(M64MSG_VERBOSE, "Possibly Restore %x (%x)",head->vaddr, (int)head->addr);
+          //DebugMessage(M64MSG_VERBOSE, "Possibly Restore %x (%x)",head->vaddr, (intptr_t)head->addr);
           u_int i;
           u_int inv=0;
-          get_bounds((int)head->addr,&start,&end);
-          if(start-(u_int)g_rdram<0x800000) {
-            for(i=(start-(u_int)g_rdram+0x80000000)>>12;i<=(end-1-(u_int)g_rdram+0x80000000)>>12;i++) {
+          get_bounds((intptr_t)head->addr,&start,&end);
+          if(start-(uintptr_t)g_rdram<0x800000) {
+            for(i=(start-(uintptr_t)g_rdram+0x80000000)>>12;i<=(end-1-(uintptr_t)g_rdram+0x80000000)>>12;i++) {
               inv|=invalid_code[i];
             }
           }
           if((signed int)head->vaddr>=(signed int)0xC0000000) {
-            u_int addr = (head->vaddr+(memory_map[head->vaddr>>12]<<2));
+            uintptr_t addr = (head->vaddr+(memory_map[head->vaddr>>12]<<2));
             //DebugMessage(M64MSG_VERBOSE, "addr=%x start=%x end=%x",addr,start,end);
             if(addr<start||addr>=end) inv=1;
           }
@@ -1341,21 +1566,21 @@ void clean_blocks(u_int page)
             inv=1;
           }
           if(!inv) {
-            void * clean_addr=(void *)get_clean_addr((int)head->addr);
-            if((((u_int)clean_addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+            void * clean_addr=(void *)get_clean_addr((intptr_t)head->addr);
+            if(!tc_expiring((uintptr_t)clean_addr)) {
               u_int ppage=page;
               if(page<2048&&tlb_LUT_r[head->vaddr>>12]) ppage=(tlb_LUT_r[head->vaddr>>12]^0x80000000)>>12;
-              inv_debug("INV: Restored %x (%x/%x)\n",head->vaddr, (int)head->addr, (int)clean_addr);
+              inv_debug("INV: Restored %x (%x/%x)\n",head->vaddr, (intptr_t)head->addr, (intptr_t)clean_addr);
               //DebugMessage(M64MSG_VERBOSE, "page=%x, addr=%x",page,head->vaddr);
               //assert(head->vaddr>>12==(page|0x80000));
               ll_add_32(jump_in+ppage,head->vaddr,head->reg_sv_flags,clean_addr);
-              u_int *ht_bin=hash_table[((head->vaddr>>16)^head->vaddr)&0xFFFF];
+              uintptr_t *ht_bin=hash_table[((head->vaddr>>16)^head->vaddr)&0xFFFF];
               if(!head->reg_sv_flags) {
                 if(ht_bin[0]==head->vaddr) {
-                  ht_bin[1]=(int)clean_addr; // Replace existing entry
+                  ht_bin[1]=(intptr_t)clean_addr; // Replace existing entry
                 }
                 if(ht_bin[2]==head->vaddr) {
-                  ht_bin[3]=(int)clean_addr; // Replace existing entry
+                  ht_bin[3]=(intptr_t)clean_addr; // Replace existing entry
                 }
               }
             }
@@ -2022,7 +2247,7 @@ static void pagespan_alloc(struct regstat *current,int i)
   //else ...
 }
 
-static void add_stub(int type,int addr,int retaddr,int a,int b,int c,int d,int e)
+static void add_stub(int type,intptr_t addr,intptr_t retaddr,intptr_t a,intptr_t b,intptr_t c,intptr_t d,intptr_t e)
 {
   stubs[stubcount][0]=type;
   stubs[stubcount][1]=addr;
@@ -2807,7 +3032,7 @@ static void load_assemble(int i,struct regstat *i_regs)
 {
   int s,th,tl,addr,map=-1,cache=-1;
   int offset;
-  int jaddr=0;
+  intptr_t jaddr=0;
   int memtarget,c=0;
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,rt1[i]|64);
@@ -2844,7 +3069,7 @@ static void load_assemble(int i,struct regstat *i_regs)
       #endif
       {
         emit_cmpimm(addr,0x800000);
-        jaddr=(int)out;
+        jaddr=(intptr_t)out;
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
         // Hint to branch predictor that the branch is unlikely to be taken
         if(rs1[i]>=28)
@@ -2877,7 +3102,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         {
           //emit_xorimm(addr,3,tl);
           //gen_tlb_addr_r(tl,map);
-          //emit_movsbl_indexed((int)g_rdram-0x80000000,tl,tl);
+          //emit_movsbl_indexed((intptr_t)g_rdram-0x80000000,tl,tl);
           int x=0;
           if(!c) emit_xorimm(addr,3,tl);
           else x=((constmap[i][s]+offset)^3)-(constmap[i][s]+offset);
@@ -2885,7 +3110,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         }
       }
       if(jaddr)
-        add_stub(LOADB_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADB_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADB_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2912,13 +3137,13 @@ static void load_assemble(int i,struct regstat *i_regs)
             #ifdef RAM_OFFSET
             emit_movswl_indexed(x,tl,tl);
             #else
-            emit_movswl_indexed((int)g_rdram-0x80000000+x,tl,tl);
+            emit_movswl_indexed((intptr_t)g_rdram-0x80000000+x,tl,tl);
             #endif
           }
         }
       }
       if(jaddr)
-        add_stub(LOADH_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADH_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADH_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2926,7 +3151,7 @@ static void load_assemble(int i,struct regstat *i_regs)
   if (opcode[i]==0x23) { // LW
     if(!c||memtarget) {
       if(!dummy) {
-        //emit_readword_indexed((int)g_rdram-0x80000000,addr,tl);
+        //emit_readword_indexed((intptr_t)g_rdram-0x80000000,addr,tl);
         #ifdef HOST_IMM_ADDR32
         if(c)
           emit_readword_tlb(constmap[i][s]+offset,map,tl);
@@ -2935,7 +3160,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         emit_readword_indexed_tlb(0,addr,map,tl);
       }
       if(jaddr)
-        add_stub(LOADW_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADW_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADW_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2951,7 +3176,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         {
           //emit_xorimm(addr,3,tl);
           //gen_tlb_addr_r(tl,map);
-          //emit_movzbl_indexed((int)g_rdram-0x80000000,tl,tl);
+          //emit_movzbl_indexed((intptr_t)g_rdram-0x80000000,tl,tl);
           int x=0;
           if(!c) emit_xorimm(addr,3,tl);
           else x=((constmap[i][s]+offset)^3)-(constmap[i][s]+offset);
@@ -2959,7 +3184,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         }
       }
       if(jaddr)
-        add_stub(LOADBU_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADBU_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADBU_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -2986,13 +3211,13 @@ static void load_assemble(int i,struct regstat *i_regs)
             #ifdef RAM_OFFSET
             emit_movzwl_indexed(x,tl,tl);
             #else
-            emit_movzwl_indexed((int)g_rdram-0x80000000+x,tl,tl);
+            emit_movzwl_indexed((intptr_t)g_rdram-0x80000000+x,tl,tl);
             #endif
           }
         }
       }
       if(jaddr)
-        add_stub(LOADHU_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADHU_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADHU_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -3001,7 +3226,7 @@ static void load_assemble(int i,struct regstat *i_regs)
     assert(th>=0);
     if(!c||memtarget) {
       if(!dummy) {
-        //emit_readword_indexed((int)g_rdram-0x80000000,addr,tl);
+        //emit_readword_indexed((intptr_t)g_rdram-0x80000000,addr,tl);
         #ifdef HOST_IMM_ADDR32
         if(c)
           emit_readword_tlb(constmap[i][s]+offset,map,tl);
@@ -3010,7 +3235,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         emit_readword_indexed_tlb(0,addr,map,tl);
       }
       if(jaddr)
-        add_stub(LOADW_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADW_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else {
       inline_readstub(LOADW_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -3021,8 +3246,8 @@ static void load_assemble(int i,struct regstat *i_regs)
     if(!c||memtarget) {
       if(!dummy) {
         //gen_tlb_addr_r(tl,map);
-        //if(th>=0) emit_readword_indexed((int)g_rdram-0x80000000,addr,th);
-        //emit_readword_indexed((int)g_rdram-0x7FFFFFFC,addr,tl);
+        //if(th>=0) emit_readword_indexed((intptr_t)g_rdram-0x80000000,addr,th);
+        //emit_readword_indexed((intptr_t)g_rdram-0x7FFFFFFC,addr,tl);
         #ifdef HOST_IMM_ADDR32
         if(c)
           emit_readdword_tlb(constmap[i][s]+offset,map,th,tl);
@@ -3031,7 +3256,7 @@ static void load_assemble(int i,struct regstat *i_regs)
         emit_readdword_indexed_tlb(0,addr,map,th,tl);
       }
       if(jaddr)
-        add_stub(LOADD_STUB,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+        add_stub(LOADD_STUB,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
     }
     else
       inline_readstub(LOADD_STUB,i,constmap[i][s]+offset,i_regs->regmap,rt1[i],ccadj[i],reglist);
@@ -3044,13 +3269,13 @@ static void load_assemble(int i,struct regstat *i_regs)
   {
     //emit_pusha();
     save_regs(0x100f);
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         #if NEW_DYNAREC == NEW_DYNAREC_X86
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
         #if NEW_DYNAREC == NEW_DYNAREC_ARM
         if(get_reg(i_regs->regmap,CCREG)<0)
@@ -3059,9 +3284,9 @@ static void load_assemble(int i,struct regstat *i_regs)
           emit_mov(HOST_CCREG,0);
         emit_add(0,ECX,0);
         emit_addimm(0,2*ccadj[i],0);
-        emit_writeword(0,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(0,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
-    emit_call((int)memdebug);
+    emit_call((intptr_t)memdebug);
     //emit_popa();
     restore_regs(0x100f);
   }*/
@@ -3080,7 +3305,8 @@ static void store_assemble(int i,struct regstat *i_regs)
   int s,th,tl,map=-1,cache=-1;
   int addr,temp;
   int offset;
-  int jaddr=0,jaddr2,type;
+  intptr_t jaddr=0,jaddr2;
+  int type;
   int memtarget,c=0;
   int agr=AGEN1+(i&1);
   u_int hr,reglist=0;
@@ -3122,7 +3348,7 @@ static void store_assemble(int i,struct regstat *i_regs)
       if(rs1[i]!=29||start<0x80001000||start>=0x80800000)
       #endif
       {
-        jaddr=(int)out;
+        jaddr=(intptr_t)out;
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
         // Hint to branch predictor that the branch is unlikely to be taken
         if(rs1[i]>=28)
@@ -3150,7 +3376,7 @@ static void store_assemble(int i,struct regstat *i_regs)
       if(!c) emit_xorimm(addr,3,temp);
       else x=((constmap[i][s]+offset)^3)-(constmap[i][s]+offset);
       //gen_tlb_addr_w(temp,map);
-      //emit_writebyte_indexed(tl,(int)g_rdram-0x80000000,temp);
+      //emit_writebyte_indexed(tl,(intptr_t)g_rdram-0x80000000,temp);
       emit_writebyte_indexed_tlb(tl,x,temp,map,temp);
     }
     type=STOREB_STUB;
@@ -3167,13 +3393,13 @@ static void store_assemble(int i,struct regstat *i_regs)
         gen_tlb_addr_w(temp,map);
         emit_writehword_indexed(tl,x,temp);
       }else
-        emit_writehword_indexed(tl,(int)g_rdram-0x80000000+x,temp);
+        emit_writehword_indexed(tl,(intptr_t)g_rdram-0x80000000+x,temp);
     }
     type=STOREH_STUB;
   }
   if (opcode[i]==0x2B) { // SW
     if(!c||memtarget)
-      //emit_writeword_indexed(tl,(int)g_rdram-0x80000000,addr);
+      //emit_writeword_indexed(tl,(intptr_t)g_rdram-0x80000000,addr);
       emit_writeword_indexed_tlb(tl,0,addr,map,temp);
     type=STOREW_STUB;
   }
@@ -3181,13 +3407,13 @@ static void store_assemble(int i,struct regstat *i_regs)
     if(!c||memtarget) {
       if(rs2[i]) {
         assert(th>=0);
-        //emit_writeword_indexed(th,(int)g_rdram-0x80000000,addr);
-        //emit_writeword_indexed(tl,(int)g_rdram-0x7FFFFFFC,addr);
+        //emit_writeword_indexed(th,(intptr_t)g_rdram-0x80000000,addr);
+        //emit_writeword_indexed(tl,(intptr_t)g_rdram-0x7FFFFFFC,addr);
         emit_writedword_indexed_tlb(th,tl,0,addr,map,temp);
       }else{
         // Store zero
-        //emit_writeword_indexed(tl,(int)g_rdram-0x80000000,temp);
-        //emit_writeword_indexed(tl,(int)g_rdram-0x7FFFFFFC,temp);
+        //emit_writeword_indexed(tl,(intptr_t)g_rdram-0x80000000,temp);
+        //emit_writeword_indexed(tl,(intptr_t)g_rdram-0x7FFFFFFC,temp);
         emit_writedword_indexed_tlb(tl,tl,0,addr,map,temp);
       }
     }
@@ -3205,19 +3431,19 @@ static void store_assemble(int i,struct regstat *i_regs)
       assert(ir>=0);
       emit_cmpmem_indexedsr12_reg(ir,addr,1);
       #else
-      emit_cmpmem_indexedsr12_imm((int)invalid_code,addr,1);
+      emit_cmpmem_indexedsr12_imm((intptr_t)invalid_code,addr,1);
       #endif
       #if defined(HAVE_CONDITIONAL_CALL) && !defined(DESTRUCTIVE_SHIFT)
       emit_callne(invalidate_addr_reg[addr]);
       #else
-      jaddr2=(int)out;
+      jaddr2=(intptr_t)out;
       emit_jne(0);
-      add_stub(INVCODE_STUB,jaddr2,(int)out,reglist|(1<<HOST_CCREG),addr,0,0,0);
+      add_stub(INVCODE_STUB,jaddr2,(intptr_t)out,reglist|(1<<HOST_CCREG),addr,0,0,0);
       #endif
     }
   }
   if(jaddr) {
-    add_stub(type,jaddr,(int)out,i,addr,(int)i_regs,ccadj[i],reglist);
+    add_stub(type,jaddr,(intptr_t)out,i,addr,(intptr_t)i_regs,ccadj[i],reglist);
   } else if(c&&!memtarget) {
     inline_writestub(type,i,constmap[i][s]+offset,i_regs->regmap,rs2[i],ccadj[i],reglist);
   }
@@ -3236,13 +3462,13 @@ static void store_assemble(int i,struct regstat *i_regs)
     #if NEW_DYNAREC == NEW_DYNAREC_ARM
     save_regs(0x100f);
     #endif
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         #if NEW_DYNAREC == NEW_DYNAREC_X86
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
         #if NEW_DYNAREC == NEW_DYNAREC_ARM
         if(get_reg(i_regs->regmap,CCREG)<0)
@@ -3251,9 +3477,9 @@ static void store_assemble(int i,struct regstat *i_regs)
           emit_mov(HOST_CCREG,0);
         emit_add(0,ECX,0);
         emit_addimm(0,2*ccadj[i],0);
-        emit_writeword(0,(int)&g_cp0_regs[CP0_COUNT_REG]);
+        emit_writeword(0,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
         #endif
-    emit_call((int)memdebug);
+    emit_call((intptr_t)memdebug);
     #if NEW_DYNAREC == NEW_DYNAREC_X86
     emit_popa();
     #endif
@@ -3270,9 +3496,9 @@ static void storelr_assemble(int i,struct regstat *i_regs)
   int temp;
   int temp2;
   int offset;
-  int jaddr=0,jaddr2;
-  int case1,case2,case3;
-  int done0,done1,done2;
+  intptr_t jaddr=0,jaddr2;
+  intptr_t case1,case2,case3;
+  intptr_t done0,done1,done2;
   int memtarget,c=0;
   int agr=AGEN1+(i&1);
   u_int hr,reglist=0;
@@ -3296,13 +3522,13 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     if(!c) {
       emit_cmpimm(s<0||offset?temp:s,0x800000);
       if(!offset&&s!=temp) emit_mov(s,temp);
-      jaddr=(int)out;
+      jaddr=(intptr_t)out;
       emit_jno(0);
     }
     else
     {
       if(!memtarget||!rs1[i]) {
-        jaddr=(int)out;
+        jaddr=(intptr_t)out;
         emit_jmp(0);
       }
     }
@@ -3310,9 +3536,11 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     int map=get_reg(i_regs->regmap,ROREG);
     if(map<0) emit_loadreg(ROREG,map=HOST_TEMPREG);
     gen_tlb_addr_w(temp,map);
+    #elif defined(HOST_RAM_REG)
+    gen_tlb_addr_w(temp,HOST_RAM_REG);
     #else
-    if((u_int)g_rdram!=0x80000000)
-      emit_addimm_no_flags((u_int)g_rdram-(u_int)0x80000000,temp);
+    if((uintptr_t)g_rdram!=0x80000000)
+      emit_addimm_no_flags((uintptr_t)g_rdram-(u_int)0x80000000,temp);
     #endif
   }else{ // using tlb
     int map=get_reg(i_regs->regmap,TLREG);
@@ -3323,7 +3551,7 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     if(!c&&!offset&&s>=0) emit_mov(s,temp);
     do_tlb_w_branch(map,c,constmap[i][s]+offset,&jaddr);
     if(!jaddr&&!memtarget) {
-      jaddr=(int)out;
+      jaddr=(intptr_t)out;
       emit_jmp(0);
     }
     gen_tlb_addr_w(temp,map);
@@ -3335,10 +3563,10 @@ static void storelr_assemble(int i,struct regstat *i_regs)
   }
 
   emit_testimm(temp,2);
-  case2=(int)out;
+  case2=(intptr_t)out;
   emit_jne(0);
   emit_testimm(temp,1);
-  case1=(int)out;
+  case1=(intptr_t)out;
   emit_jne(0);
   // 0
   if (opcode[i]==0x2A) { // SWL
@@ -3355,10 +3583,10 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     emit_writebyte_indexed(tl,3,temp);
     if(rs2[i]) emit_shldimm(th,tl,24,temp2);
   }
-  done0=(int)out;
+  done0=(intptr_t)out;
   emit_jmp(0);
   // 1
-  set_jump_target(case1,(int)out);
+  set_jump_target(case1,(intptr_t)out);
   if (opcode[i]==0x2A) { // SWL
     // Write 3 msb into three least significant bytes
     if(rs2[i]) emit_rorimm(tl,8,tl);
@@ -3385,12 +3613,12 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     // Write two lsb into two most significant bytes
     emit_writehword_indexed(tl,1,temp);
   }
-  done1=(int)out;
+  done1=(intptr_t)out;
   emit_jmp(0);
   // 2
-  set_jump_target(case2,(int)out);
+  set_jump_target(case2,(intptr_t)out);
   emit_testimm(temp,1);
-  case3=(int)out;
+  case3=(intptr_t)out;
   emit_jne(0);
   if (opcode[i]==0x2A) { // SWL
     // Write two msb into two least significant bytes
@@ -3420,10 +3648,10 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     emit_writehword_indexed(tl,0,temp);
     if(rs2[i]) emit_rorimm(tl,24,tl);
   }
-  done2=(int)out;
+  done2=(intptr_t)out;
   emit_jmp(0);
   // 3
-  set_jump_target(case3,(int)out);
+  set_jump_target(case3,(intptr_t)out);
   if (opcode[i]==0x2A) { // SWL
     // Write msb into least significant byte
     if(rs2[i]) emit_rorimm(tl,24,tl);
@@ -3446,60 +3674,62 @@ static void storelr_assemble(int i,struct regstat *i_regs)
     // Write entire word
     emit_writeword_indexed(tl,-3,temp);
   }
-  set_jump_target(done0,(int)out);
-  set_jump_target(done1,(int)out);
-  set_jump_target(done2,(int)out);
+  set_jump_target(done0,(intptr_t)out);
+  set_jump_target(done1,(intptr_t)out);
+  set_jump_target(done2,(intptr_t)out);
   if (opcode[i]==0x2C) { // SDL
     emit_testimm(temp,4);
-    done0=(int)out;
+    done0=(intptr_t)out;
     emit_jne(0);
     emit_andimm(temp,~3,temp);
     emit_writeword_indexed(temp2,4,temp);
-    set_jump_target(done0,(int)out);
+    set_jump_target(done0,(intptr_t)out);
   }
   if (opcode[i]==0x2D) { // SDR
     emit_testimm(temp,4);
-    done0=(int)out;
+    done0=(intptr_t)out;
     emit_jeq(0);
     emit_andimm(temp,~3,temp);
     emit_writeword_indexed(temp2,-4,temp);
-    set_jump_target(done0,(int)out);
+    set_jump_target(done0,(intptr_t)out);
   }
   if(!c||!memtarget)
-    add_stub(STORELR_STUB,jaddr,(int)out,0,(int)i_regs,rs2[i],ccadj[i],reglist);
+    add_stub(STORELR_STUB,jaddr,(intptr_t)out,0,(intptr_t)i_regs,rs2[i],ccadj[i],reglist);
   if(!using_tlb) {
     #ifdef RAM_OFFSET
     int map=get_reg(i_regs->regmap,ROREG);
     if(map<0) map=HOST_TEMPREG;
     gen_orig_addr_w(temp,map);
+    #elif defined(HOST_RAM_REG)
+    gen_orig_addr_w(temp,HOST_RAM_REG);
     #else
-    emit_addimm_no_flags((u_int)0x80000000-(u_int)g_rdram,temp);
+    emit_addimm_no_flags((u_int)0x80000000-(uintptr_t)g_rdram,temp);
     #endif
     #if defined(HOST_IMM8)
     int ir=get_reg(i_regs->regmap,INVCP);
     assert(ir>=0);
     emit_cmpmem_indexedsr12_reg(ir,temp,1);
     #else
-    emit_cmpmem_indexedsr12_imm((int)invalid_code,temp,1);
+    emit_cmpmem_indexedsr12_imm((intptr_t)invalid_code,temp,1);
     #endif
     #if defined(HAVE_CONDITIONAL_CALL) && !defined(DESTRUCTIVE_SHIFT)
     emit_callne(invalidate_addr_reg[temp]);
     #else
-    jaddr2=(int)out;
+    jaddr2=(intptr_t)out;
     emit_jne(0);
-    add_stub(INVCODE_STUB,jaddr2,(int)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
+    add_stub(INVCODE_STUB,jaddr2,(intptr_t)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
     #endif
   }
   /*
     emit_pusha();
     //save_regs(0x100f);
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
-    emit_call((int)memdebug);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+    emit_call((intptr_t)memdebug);
     emit_popa();
     //restore_regs(0x100f);
   */
@@ -3512,7 +3742,8 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
   int map=-1;
   int offset;
   int c=0;
-  int jaddr,jaddr2=0,jaddr3,type;
+  intptr_t jaddr,jaddr2=0,jaddr3;
+  int type;
   int agr=AGEN1+(i&1);
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,FTEMP|64);
@@ -3545,16 +3776,16 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     signed char rs=get_reg(i_regs->regmap,CSREG);
     assert(rs>=0);
     emit_testimm(rs,0x20000000);
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jeq(0);
-    add_stub(FP_STUB,jaddr,(int)out,i,rs,(int)i_regs,is_delayslot,0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,rs,(intptr_t)i_regs,is_delayslot,0);
     cop1_usable=1;
   }
   if (opcode[i]==0x39) { // SWC1 (get float address)
-    emit_readword((int)&reg_cop1_simple[(source[i]>>16)&0x1f],tl);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],tl);
   }
   if (opcode[i]==0x3D) { // SDC1 (get double address)
-    emit_readword((int)&reg_cop1_double[(source[i]>>16)&0x1f],tl);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],tl);
   }
   // Generate address + offset
   if(!using_tlb) {
@@ -3589,18 +3820,18 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     emit_readword_indexed(0,tl,tl);
   }
   if (opcode[i]==0x31) { // LWC1 (get target address)
-    emit_readword((int)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
   }
   if (opcode[i]==0x35) { // LDC1 (get target address)
-    emit_readword((int)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
   }
   if(!using_tlb) {
     if(!c) {
-      jaddr2=(int)out;
+      jaddr2=(intptr_t)out;
       emit_jno(0);
     }
     else if(((signed int)(constmap[i][s]+offset))>=(signed int)0x80800000) {
-      jaddr2=(int)out;
+      jaddr2=(intptr_t)out;
       emit_jmp(0); // inline_readstub/inline_writestub?  Very rare case
     }
     #ifdef DESTRUCTIVE_SHIFT
@@ -3619,7 +3850,7 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
   if (opcode[i]==0x31) { // LWC1
     //if(s>=0&&!c&&!offset) emit_mov(s,tl);
     //gen_tlb_addr_r(ar,map);
-    //emit_readword_indexed((int)g_rdram-0x80000000,tl,tl);
+    //emit_readword_indexed((intptr_t)g_rdram-0x80000000,tl,tl);
     #ifdef HOST_IMM_ADDR32
     if(c) emit_readword_tlb(constmap[i][s]+offset,map,tl);
     else
@@ -3631,8 +3862,8 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     assert(th>=0);
     //if(s>=0&&!c&&!offset) emit_mov(s,tl);
     //gen_tlb_addr_r(ar,map);
-    //emit_readword_indexed((int)g_rdram-0x80000000,tl,th);
-    //emit_readword_indexed((int)g_rdram-0x7FFFFFFC,tl,tl);
+    //emit_readword_indexed((intptr_t)g_rdram-0x80000000,tl,th);
+    //emit_readword_indexed((intptr_t)g_rdram-0x7FFFFFFC,tl,tl);
     #ifdef HOST_IMM_ADDR32
     if(c) emit_readdword_tlb(constmap[i][s]+offset,map,th,tl);
     else
@@ -3641,14 +3872,14 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
     type=LOADD_STUB;
   }
   if (opcode[i]==0x39) { // SWC1
-    //emit_writeword_indexed(tl,(int)g_rdram-0x80000000,temp);
+    //emit_writeword_indexed(tl,(intptr_t)g_rdram-0x80000000,temp);
     emit_writeword_indexed_tlb(tl,0,offset||c||s<0?temp:s,map,temp);
     type=STOREW_STUB;
   }
   if (opcode[i]==0x3D) { // SDC1
     assert(th>=0);
-    //emit_writeword_indexed(th,(int)g_rdram-0x80000000,temp);
-    //emit_writeword_indexed(tl,(int)g_rdram-0x7FFFFFFC,temp);
+    //emit_writeword_indexed(th,(intptr_t)g_rdram-0x80000000,temp);
+    //emit_writeword_indexed(tl,(intptr_t)g_rdram-0x7FFFFFFC,temp);
     emit_writedword_indexed_tlb(th,tl,0,offset||c||s<0?temp:s,map,temp);
     type=STORED_STUB;
   }
@@ -3662,18 +3893,18 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
       assert(ir>=0);
       emit_cmpmem_indexedsr12_reg(ir,temp,1);
       #else
-      emit_cmpmem_indexedsr12_imm((int)invalid_code,temp,1);
+      emit_cmpmem_indexedsr12_imm((intptr_t)invalid_code,temp,1);
       #endif
       #if defined(HAVE_CONDITIONAL_CALL) && !defined(DESTRUCTIVE_SHIFT)
       emit_callne(invalidate_addr_reg[temp]);
       #else
-      jaddr3=(int)out;
+      jaddr3=(intptr_t)out;
       emit_jne(0);
-      add_stub(INVCODE_STUB,jaddr3,(int)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
+      add_stub(INVCODE_STUB,jaddr3,(intptr_t)out,reglist|(1<<HOST_CCREG),temp,0,0,0);
       #endif
     }
   }
-  if(jaddr2) add_stub(type,jaddr2,(int)out,i,offset||c||s<0?ar:s,(int)i_regs,ccadj[i],reglist);
+  if(jaddr2) add_stub(type,jaddr2,(intptr_t)out,i,offset||c||s<0?ar:s,(intptr_t)i_regs,ccadj[i],reglist);
   if (opcode[i]==0x31) { // LWC1 (write float)
     emit_writeword_indexed(tl,0,temp);
   }
@@ -3685,13 +3916,13 @@ static void c1ls_assemble(int i,struct regstat *i_regs)
   /*if(opcode[i]==0x39||opcode[i]==0x31)
   {
     emit_pusha();
-        emit_readword((int)&last_count,ECX);
+        emit_readword((intptr_t)&last_count,ECX);
         if(get_reg(i_regs->regmap,CCREG)<0)
           emit_loadreg(CCREG,HOST_CCREG);
         emit_add(HOST_CCREG,ECX,HOST_CCREG);
         emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
-        emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
-    emit_call((int)memdebug);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+    emit_call((intptr_t)memdebug);
     emit_popa();
   }*/
 }
@@ -3749,7 +3980,7 @@ static void syscall_assemble(int i,struct regstat *i_regs)
   assert(!is_delayslot);
   emit_movimm(start+i*4,EAX); // Get PC
   emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG); // CHECK: is this right?  There should probably be an extra cycle...
-  emit_jmp((int)jump_syscall);
+  emit_jmp((intptr_t)jump_syscall);
 }
 
 static void ds_assemble(int i,struct regstat *i_regs)
@@ -4020,14 +4251,14 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
             if (opcode[i]==0x22||opcode[i]==0x26) { // LWL/LWR
               #ifdef RAM_OFFSET
               if((signed int)constmap[i][rs]+offset<(signed int)0x80800000)
-                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFFC)+(int)g_rdram-0x80000000,ra);
+                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFFC)+(intptr_t)g_rdram-0x80000000,ra);
               else
               #endif
               emit_movimm((constmap[i][rs]+offset)&0xFFFFFFFC,ra);
             }else if (opcode[i]==0x1a||opcode[i]==0x1b) { // LDL/LDR
               #ifdef RAM_OFFSET
               if((signed int)constmap[i][rs]+offset<(signed int)0x80800000)
-                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFF8)+(int)g_rdram-0x80000000,ra);
+                emit_movimm(((constmap[i][rs]+offset)&0xFFFFFFF8)+(intptr_t)g_rdram-0x80000000,ra);
               else
               #endif
               emit_movimm((constmap[i][rs]+offset)&0xFFFFFFF8,ra);
@@ -4038,7 +4269,7 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
               #endif
               #ifdef RAM_OFFSET
               if((itype[i]==LOAD||opcode[i]==0x31||opcode[i]==0x35)&&(signed int)constmap[i][rs]+offset<(signed int)0x80800000)
-                emit_movimm(constmap[i][rs]+offset+(int)g_rdram-0x80000000,ra);
+                emit_movimm(constmap[i][rs]+offset+(intptr_t)g_rdram-0x80000000,ra);
               else
               #endif
               emit_movimm(constmap[i][rs]+offset,ra);
@@ -4094,14 +4325,14 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
         if (opcode[i+1]==0x22||opcode[i+1]==0x26) { // LWL/LWR
           #ifdef RAM_OFFSET
           if((signed int)constmap[i+1][rs]+offset<(signed int)0x80800000)
-            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFFC)+(int)g_rdram-0x80000000,ra);
+            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFFC)+(intptr_t)g_rdram-0x80000000,ra);
           else
           #endif
           emit_movimm((constmap[i+1][rs]+offset)&0xFFFFFFFC,ra);
         }else if (opcode[i+1]==0x1a||opcode[i+1]==0x1b) { // LDL/LDR
           #ifdef RAM_OFFSET
           if((signed int)constmap[i+1][rs]+offset<(signed int)0x80800000)
-            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFF8)+(int)g_rdram-0x80000000,ra);
+            emit_movimm(((constmap[i+1][rs]+offset)&0xFFFFFFF8)+(intptr_t)g_rdram-0x80000000,ra);
           else
           #endif
           emit_movimm((constmap[i+1][rs]+offset)&0xFFFFFFF8,ra);
@@ -4112,7 +4343,7 @@ static void address_generation(int i,struct regstat *i_regs,signed char entry[])
           #endif
           #ifdef RAM_OFFSET
           if((itype[i+1]==LOAD||opcode[i+1]==0x31||opcode[i+1]==0x35)&&(signed int)constmap[i+1][rs]+offset<(signed int)0x80800000)
-            emit_movimm(constmap[i+1][rs]+offset+(int)g_rdram-0x80000000,ra);
+            emit_movimm(constmap[i+1][rs]+offset+(intptr_t)g_rdram-0x80000000,ra);
           else
           #endif
           emit_movimm(constmap[i+1][rs]+offset,ra);
@@ -4156,7 +4387,7 @@ static int get_final_value(int hr, int i, int *value)
           #endif
           #ifdef RAM_OFFSET
           if((signed int)constmap[i][hr]+imm[i+2]<(signed int)0x80800000)
-            *value=constmap[i][hr]+imm[i+2]+(int)g_rdram-0x80000000;
+            *value=constmap[i][hr]+imm[i+2]+(intptr_t)g_rdram-0x80000000;
           else
           #endif
           // Precompute load address
@@ -4171,7 +4402,7 @@ static int get_final_value(int hr, int i, int *value)
         #endif
         #ifdef RAM_OFFSET
         if((signed int)constmap[i][hr]+imm[i+1]<(signed int)0x80800000)
-          *value=constmap[i][hr]+imm[i+1]+(int)g_rdram-0x80000000;
+          *value=constmap[i][hr]+imm[i+1]+(intptr_t)g_rdram-0x80000000;
         else
         #endif
         // Precompute load address
@@ -4630,7 +4861,7 @@ static int match_bt(signed char i_regmap[],uint64_t i_is32,uint64_t i_dirty,int
 static void ds_assemble_entry(int i)
 {
   int t=(ba[i]-start)>>2;
-  if(!instr_addr[t]) instr_addr[t]=(u_int)out;
+  if(!instr_addr[t]) instr_addr[t]=(uintptr_t)out;
   assem_debug("Assemble delay slot at %x",ba[i]);
   assem_debug("<->");
   if(regs[t].regmap_entry[HOST_CCREG]==CCREG&&regs[t].regmap[HOST_CCREG]!=CCREG)
@@ -4692,15 +4923,15 @@ static void ds_assemble_entry(int i)
   else
     assem_debug("branch: external");
   assert(internal_branch(regs[t].is32,ba[i]+4));
-  add_to_linker((int)out,ba[i]+4,internal_branch(regs[t].is32,ba[i]+4));
+  add_to_linker((intptr_t)out,ba[i]+4,internal_branch(regs[t].is32,ba[i]+4));
   emit_jmp(0);
 }
 
 static void do_cc(int i,signed char i_regmap[],int *adj,int addr,int taken,int invert)
 {
   int count;
-  int jaddr;
-  int idle=0;
+  intptr_t jaddr;
+  intptr_t idle=0;
   if(itype[i]==RJUMP)
   {
     *adj=0;
@@ -4720,31 +4951,31 @@ static void do_cc(int i,signed char i_regmap[],int *adj,int addr,int taken,int i
   if(taken==TAKEN && i==(ba[i]-start)>>2 && source[i+1]==0) {
     // Idle loop
     if(count&1) emit_addimm_and_set_flags(2*(count+2),HOST_CCREG);
-    idle=(int)out;
+    idle=(intptr_t)out;
     //emit_subfrommem(&idlecount,HOST_CCREG); // Count idle cycles
     emit_andimm(HOST_CCREG,3,HOST_CCREG);
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jmp(0);
   }
   else if(*adj==0||invert) {
     emit_addimm_and_set_flags(CLOCK_DIVIDER*(count+2),HOST_CCREG);
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jns(0);
   }
   else
   {
     emit_cmpimm(HOST_CCREG,-(int)CLOCK_DIVIDER*(count+2));
-    jaddr=(int)out;
+    jaddr=(intptr_t)out;
     emit_jns(0);
   }
-  add_stub(CC_STUB,jaddr,idle?idle:(int)out,(*adj==0||invert||idle)?0:(count+2),i,addr,taken,0);
+  add_stub(CC_STUB,jaddr,idle?idle:(intptr_t)out,(*adj==0||invert||idle)?0:(count+2),i,addr,taken,0);
 }
 
 static void do_ccstub(int n)
 {
   literal_pool(256);
   assem_debug("do_ccstub %x",start+stubs[n][4]*4);
-  set_jump_target(stubs[n][1],(int)out);
+  set_jump_target(stubs[n][1],(intptr_t)out);
   int i=stubs[n][4];
   if(stubs[n][6]==NULLDS) {
     // Delay slot instruction is nullified ("likely" branch)
@@ -4761,7 +4992,7 @@ static void do_ccstub(int n)
   {
     // Save PC as return address
     emit_movimm(stubs[n][5],EAX);
-    emit_writeword(EAX,(int)&pcaddr);
+    emit_writeword(EAX,(intptr_t)&pcaddr);
   }
   else
   {
@@ -4942,7 +5173,7 @@ static void do_ccstub(int n)
           emit_cmovne_reg(alt,addr);
         }
       }
-      emit_writeword(addr,(int)&pcaddr);
+      emit_writeword(addr,(intptr_t)&pcaddr);
     }
     else
     if(itype[i]==RJUMP)
@@ -4951,21 +5182,24 @@ static void do_ccstub(int n)
       if((rs1[i]==rt1[i+1]||rs1[i]==rt2[i+1])&&(rs1[i]!=0)) {
         r=get_reg(branch_regs[i].regmap,RTEMP);
       }
-      emit_writeword(r,(int)&pcaddr);
+      emit_writeword(r,(intptr_t)&pcaddr);
     }
     else {DebugMessage(M64MSG_ERROR, "Unknown branch type in do_ccstub");exit(1);}
   }
   // Update cycle count
   assert(branch_regs[i].regmap[HOST_CCREG]==CCREG||branch_regs[i].regmap[HOST_CCREG]==-1);
   if(stubs[n][3]) emit_addimm(HOST_CCREG,CLOCK_DIVIDER*stubs[n][3],HOST_CCREG);
-  emit_call((int)cc_interrupt);
+  // Mark this block's segment as used, EAX is clobbered by the call anyway
+  emit_movimm(1,EAX);
+  emit_writeword(EAX,(intptr_t)&tc_used[tc_seg]);
+  emit_call((intptr_t)cc_interrupt);
   if(stubs[n][3]) emit_addimm(HOST_CCREG,-(int)CLOCK_DIVIDER*stubs[n][3],HOST_CCREG);
   if(stubs[n][6]==TAKEN) {
     if(internal_branch(branch_regs[i].is32,ba[i]))
       load_needed_regs(branch_regs[i].regmap,regs[(ba[i]-start)>>2].regmap_entry);
     else if(itype[i]==RJUMP) {
       if(get_reg(branch_regs[i].regmap,RTEMP)>=0)
-        emit_readword((int)&pcaddr,get_reg(branch_regs[i].regmap,RTEMP));
+        emit_readword((intptr_t)&pcaddr,get_reg(branch_regs[i].regmap,RTEMP));
       else
         emit_loadreg(rs1[i],get_reg(branch_regs[i].regmap,rs1[i]));
     }
@@ -4982,35 +5216,35 @@ static void do_ccstub(int n)
   emit_jmp(stubs[n][2]); // return address
 
   /* This works but uses a lot of memory...
-  emit_readword((int)&last_count,ECX);
+  emit_readword((intptr_t)&last_count,ECX);
   emit_add(HOST_CCREG,ECX,EAX);
-  emit_writeword(EAX,(int)&g_cp0_regs[CP0_COUNT_REG]);
-  emit_call((int)gen_interupt);
-  emit_readword((int)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
-  emit_readword((int)&next_interupt,EAX);
-  emit_readword((int)&pending_exception,EBX);
-  emit_writeword(EAX,(int)&last_count);
+  emit_writeword(EAX,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_call((intptr_t)gen_interupt);
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,EAX);
+  emit_readword((intptr_t)&pending_exception,EBX);
+  emit_writeword(EAX,(intptr_t)&last_count);
   emit_sub(HOST_CCREG,EAX,HOST_CCREG);
   emit_test(EBX,EBX);
-  int jne_instr=(int)out;
+  int jne_instr=(intptr_t)out;
   emit_jne(0);
   if(stubs[n][3]) emit_addimm(HOST_CCREG,-2*stubs[n][3],HOST_CCREG);
   load_all_regs(branch_regs[i].regmap);
   emit_jmp(stubs[n][2]); // return address
-  set_jump_target(jne_instr,(int)out);
-  emit_readword((int)&pcaddr,EAX);
+  set_jump_target(jne_instr,(intptr_t)out);
+  emit_readword((intptr_t)&pcaddr,EAX);
   // Call get_addr_ht instead of doing the hash table here.
   // This code is executed infrequently and takes up a lot of space
   // so smaller is better.
   emit_storereg(CCREG,HOST_CCREG);
   emit_pushreg(EAX);
-  emit_call((int)get_addr_ht);
+  emit_call((intptr_t)get_addr_ht);
   emit_loadreg(CCREG,HOST_CCREG);
   emit_addimm(ESP,4,ESP);
   emit_jmpreg(EAX);*/
 }
 
-static void add_to_linker(int addr,int target,int ext)
+static void add_to_linker(intptr_t addr,intptr_t target,int ext)
 {
   link_addr[linkcount][0]=addr;
   link_addr[linkcount][1]=target;
@@ -5031,7 +5265,7 @@ static void ujump_assemble(int i,struct regstat *i_regs)
   {
     int return_address=start+i*4+8;
     if(get_reg(branch_regs[i].regmap,31)>0)
-    if(i_regmap[temp]==PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+    if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
   }
   #endif
   ds_assemble(i+1,i_regs);
@@ -5072,7 +5306,7 @@ static void ujump_assemble(int i,struct regstat *i_regs)
         #ifdef REG_PREFETCH
         if(temp>=0)
         {
-          if(i_regmap[temp]!=PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+          if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
         }
         #endif
         emit_movimm(return_address,rt); // PC into link register
@@ -5100,7 +5334,7 @@ static void ujump_assemble(int i,struct regstat *i_regs)
     ds_assemble_entry(i);
   }
   else {
-    add_to_linker((int)out,ba[i],internal_branch(branch_regs[i].is32,ba[i]));
+    add_to_linker((intptr_t)out,ba[i],internal_branch(branch_regs[i].is32,ba[i]));
     emit_jmp(0);
   }
 }
@@ -5128,7 +5362,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   {
     if((temp=get_reg(branch_regs[i].regmap,PTEMP))>=0) {
       int return_address=start+i*4+8;
-      if(i_regmap[temp]==PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+      if(i_regmap[temp]==PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
     }
   }
   #endif
@@ -5158,7 +5392,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
     #ifdef REG_PREFETCH
     if(temp>=0)
     {
-      if(i_regmap[temp]!=PTEMP) emit_movimm((int)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
+      if(i_regmap[temp]!=PTEMP) emit_movimm((intptr_t)hash_table[((return_address>>16)^return_address)&0xFFFF],temp);
     }
     #endif
     emit_movimm(return_address,rt); // PC into link register
@@ -5197,9 +5431,15 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   //if(adj) emit_addimm(cc,2*(ccadj[i]+2-adj),cc); // ??? - Shouldn't happen
   //assert(adj==0);
   emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-  add_stub(CC_STUB,(int)out,jump_vaddr_reg[rs],0,i,-1,TAKEN,0);
+  add_stub(CC_STUB,(intptr_t)out,jump_vaddr_reg[rs],0,i,-1,TAKEN,0);
   emit_jns(0);
   //load_regs_bt(branch_regs[i].regmap,branch_regs[i].is32,branch_regs[i].dirty,-1);
+  #ifdef USE_JR_IC
+  if(rs1[i]!=31) {
+    do_jr_ic_jump(rs,jr_ic_alloc());
+  }
+  else
+  #endif
   #ifdef USE_MINI_HT
   if(rs1[i]==31) {
     do_miniht_jump(rs,rh,ht);
@@ -5208,7 +5448,7 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   #endif
   {
     //if(rs!=EAX) emit_mov(rs,EAX);
-    //emit_jmp((int)jump_vaddr_eax);
+    //emit_jmp((intptr_t)jump_vaddr_eax);
     emit_jmp(jump_vaddr_reg[rs]);
   }
   /* Check hash table
@@ -5218,32 +5458,32 @@ static void rjump_assemble(int i,struct regstat *i_regs)
   emit_xor(temp,rs,rs);
   emit_movzwl_reg(rs,rs);
   emit_shlimm(rs,4,rs);
-  emit_cmpmem_indexed((int)hash_table,rs,temp);
-  emit_jne((int)out+14);
-  emit_readword_indexed((int)hash_table+4,rs,rs);
+  emit_cmpmem_indexed((intptr_t)hash_table,rs,temp);
+  emit_jne((intptr_t)out+14);
+  emit_readword_indexed((intptr_t)hash_table+4,rs,rs);
   emit_jmpreg(rs);
-  emit_cmpmem_indexed((int)hash_table+8,rs,temp);
+  emit_cmpmem_indexed((intptr_t)hash_table+8,rs,temp);
   emit_addimm_no_flags(8,rs);
-  emit_jeq((int)out-17);
+  emit_jeq((intptr_t)out-17);
   // No hit on hash table, call compiler
   emit_pushreg(temp);
 //DEBUG >
 #ifdef DEBUG_CYCLE_COUNT
-  emit_readword((int)&last_count,ECX);
+  emit_readword((intptr_t)&last_count,ECX);
   emit_add(HOST_CCREG,ECX,HOST_CCREG);
-  emit_readword((int)&next_interupt,ECX);
-  emit_writeword(HOST_CCREG,(int)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
   emit_sub(HOST_CCREG,ECX,HOST_CCREG);
-  emit_writeword(ECX,(int)&last_count);
+  emit_writeword(ECX,(intptr_t)&last_count);
 #endif
 //DEBUG <
   emit_storereg(CCREG,HOST_CCREG);
-  emit_call((int)get_addr);
+  emit_call((intptr_t)get_addr);
   emit_loadreg(CCREG,HOST_CCREG);
   emit_addimm(ESP,4,ESP);
   emit_jmpreg(EAX);*/
   #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
-  if(rt1[i]!=31&&i<slen-2&&(((u_int)out)&7)) emit_mov(13,13);
+  if(rt1[i]!=31&&i<slen-2&&(((uintptr_t)out)&7)) emit_mov(13,13);
   #endif
 }
 
@@ -5337,22 +5577,22 @@ static void cjump_assemble(int i,struct regstat *i_regs)
           ds_assemble_entry(i);
         }
         else {
-          add_to_linker((int)out,ba[i],branch_internal);
+          add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_jmp(0);
         }
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
-        if(((u_int)out)&7) emit_addnop(0);
+        if(((uintptr_t)out)&7) emit_addnop(0);
         #endif
       }
     }
     else if(nop) {
       emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-      int jaddr=(int)out;
+      intptr_t jaddr=(intptr_t)out;
       emit_jns(0);
-      add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+      add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
     }
     else {
-      int taken=0,nottaken=0,nottaken1=0;
+      intptr_t taken=0,nottaken=0,nottaken1=0;
       do_cc(i,branch_regs[i].regmap,&adj,-1,0,invert);
       if(adj&&!invert) emit_addimm(cc,CLOCK_DIVIDER*(ccadj[i]+2-adj),cc);
       if(!only32)
@@ -5362,33 +5602,33 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(1);
         }
         if(opcode[i]==5) // BNE
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          if(invert) taken=(int)out;
-          else add_to_linker((int)out,ba[i],branch_internal);
+          if(invert) taken=(intptr_t)out;
+          else add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_jne(0);
         }
         if(opcode[i]==6) // BLEZ
         {
           emit_test(s1h,s1h);
-          if(invert) taken=(int)out;
-          else add_to_linker((int)out,ba[i],branch_internal);
+          if(invert) taken=(intptr_t)out;
+          else add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_js(0);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(1);
         }
         if(opcode[i]==7) // BGTZ
         {
           emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_js(1);
-          if(invert) taken=(int)out;
-          else add_to_linker((int)out,ba[i],branch_internal);
+          if(invert) taken=(intptr_t)out;
+          else add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_jne(0);
         }
       } // if(!only32)
@@ -5400,10 +5640,10 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jne(1);
         }else{
-          add_to_linker((int)out,ba[i],branch_internal);
+          add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_jeq(0);
         }
       }
@@ -5412,10 +5652,10 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jeq(1);
         }else{
-          add_to_linker((int)out,ba[i],branch_internal);
+          add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_jne(0);
         }
       }
@@ -5423,11 +5663,11 @@ static void cjump_assemble(int i,struct regstat *i_regs)
       {
         emit_cmpimm(s1l,1);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           if(only32) emit_jge(1);
           else emit_jae(1);
         }else{
-          add_to_linker((int)out,ba[i],branch_internal);
+          add_to_linker((intptr_t)out,ba[i],branch_internal);
           if(only32) emit_jl(0);
           else emit_jb(0);
         }
@@ -5436,25 +5676,25 @@ static void cjump_assemble(int i,struct regstat *i_regs)
       {
         emit_cmpimm(s1l,1);
         if(invert){
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           if(only32) emit_jl(1);
           else emit_jb(1);
         }else{
-          add_to_linker((int)out,ba[i],branch_internal);
+          add_to_linker((intptr_t)out,ba[i],branch_internal);
           if(only32) emit_jge(0);
           else emit_jae(0);
         }
       }
       if(invert) {
-        if(taken) set_jump_target(taken,(int)out);
+        if(taken) set_jump_target(taken,(intptr_t)out);
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
         if(match&&(!branch_internal||!is_ds[(ba[i]-start)>>2])) {
           if(adj) {
             emit_addimm(cc,-CLOCK_DIVIDER*adj,cc);
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
           }else{
             emit_addnop(13);
-            add_to_linker((int)out,ba[i],branch_internal*2);
+            add_to_linker((intptr_t)out,ba[i],branch_internal*2);
           }
           emit_jmp(0);
         }else
@@ -5471,14 +5711,14 @@ static void cjump_assemble(int i,struct regstat *i_regs)
             ds_assemble_entry(i);
           }
           else {
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_jmp(0);
           }
         }
-        set_jump_target(nottaken,(int)out);
+        set_jump_target(nottaken,(intptr_t)out);
       }
 
-      if(nottaken1) set_jump_target(nottaken1,(int)out);
+      if(nottaken1) set_jump_target(nottaken1,(intptr_t)out);
       if(adj) {
         if(!invert) emit_addimm(cc,CLOCK_DIVIDER*adj,cc);
       }
@@ -5490,7 +5730,7 @@ static void cjump_assemble(int i,struct regstat *i_regs)
     //if(likely[i]) DebugMessage(M64MSG_VERBOSE, "IOL");
     //else
     //DebugMessage(M64MSG_VERBOSE, "IOE");
-    int taken=0,nottaken=0,nottaken1=0;
+    intptr_t taken=0,nottaken=0,nottaken1=0;
     if(!unconditional&&!nop) {
       if(!only32)
       {
@@ -5499,30 +5739,30 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(2);
         }
         if((opcode[i]&0x2f)==5) // BNE
         {
           if(s2h>=0) emit_cmp(s1h,s2h);
           else emit_test(s1h,s1h);
-          taken=(int)out;
+          taken=(intptr_t)out;
           emit_jne(1);
         }
         if((opcode[i]&0x2f)==6) // BLEZ
         {
           emit_test(s1h,s1h);
-          taken=(int)out;
+          taken=(intptr_t)out;
           emit_js(1);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_jne(2);
         }
         if((opcode[i]&0x2f)==7) // BGTZ
         {
           emit_test(s1h,s1h);
-          nottaken1=(int)out;
+          nottaken1=(intptr_t)out;
           emit_js(2);
-          taken=(int)out;
+          taken=(intptr_t)out;
           emit_jne(1);
         }
       } // if(!only32)
@@ -5533,27 +5773,27 @@ static void cjump_assemble(int i,struct regstat *i_regs)
       {
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         emit_jne(2);
       }
       if((opcode[i]&0x2f)==5) // BNE
       {
         if(s2l>=0) emit_cmp(s1l,s2l);
         else emit_test(s1l,s1l);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         emit_jeq(2);
       }
       if((opcode[i]&0x2f)==6) // BLEZ
       {
         emit_cmpimm(s1l,1);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         if(only32) emit_jge(2);
         else emit_jae(2);
       }
       if((opcode[i]&0x2f)==7) // BGTZ
       {
         emit_cmpimm(s1l,1);
-        nottaken=(int)out;
+        nottaken=(intptr_t)out;
         if(only32) emit_jl(2);
         else emit_jb(2);
       }
@@ -5568,7 +5808,7 @@ static void cjump_assemble(int i,struct regstat *i_regs)
     ds_unneeded_upper|=1;
     // branch taken
     if(!nop) {
-      if(taken) set_jump_target(taken,(int)out);
+      if(taken) set_jump_target(taken,(intptr_t)out);
       assem_debug("1:");
       wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
                     ds_unneeded,ds_unneeded_upper);
@@ -5596,15 +5836,15 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         ds_assemble_entry(i);
       }
       else {
-        add_to_linker((int)out,ba[i],branch_internal);
+        add_to_linker((intptr_t)out,ba[i],branch_internal);
         emit_jmp(0);
       }
     }
     // branch not taken
     cop1_usable=prev_cop1_usable;
     if(!unconditional) {
-      if(nottaken1) set_jump_target(nottaken1,(int)out);
-      set_jump_target(nottaken,(int)out);
+      if(nottaken1) set_jump_target(nottaken1,(intptr_t)out);
+      set_jump_target(nottaken,(intptr_t)out);
       assem_debug("2:");
       if(!likely[i]) {
         wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
@@ -5619,18 +5859,18 @@ static void cjump_assemble(int i,struct regstat *i_regs)
         // Cycle count isn't in a register, temporarily load it then write it out
         emit_loadreg(CCREG,HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
         emit_storereg(CCREG,HOST_CCREG);
       }
       else{
         cc=get_reg(i_regmap,CCREG);
         assert(cc==HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
       }
     }
   }
@@ -5730,22 +5970,22 @@ static void sjump_assemble(int i,struct regstat *i_regs)
           ds_assemble_entry(i);
         }
         else {
-          add_to_linker((int)out,ba[i],branch_internal);
+          add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_jmp(0);
         }
         #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
-        if(((u_int)out)&7) emit_addnop(0);
+        if(((uintptr_t)out)&7) emit_addnop(0);
         #endif
       }
     }
     else if(nevertaken) {
       emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-      int jaddr=(int)out;
+      intptr_t jaddr=(intptr_t)out;
       emit_jns(0);
-      add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+      add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
     }
     else {
-      int nottaken=0;
+      intptr_t nottaken=0;
       do_cc(i,branch_regs[i].regmap,&adj,-1,0,invert);
       if(adj&&!invert) emit_addimm(cc,CLOCK_DIVIDER*(ccadj[i]+2-adj),cc);
       if(!only32)
@@ -5755,10 +5995,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1h,s1h);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jns(1);
           }else{
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_js(0);
           }
         }
@@ -5766,10 +6006,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1h,s1h);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_js(1);
           }else{
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_jns(0);
           }
         }
@@ -5781,10 +6021,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1l,s1l);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jns(1);
           }else{
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_js(0);
           }
         }
@@ -5792,10 +6032,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         {
           emit_test(s1l,s1l);
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_js(1);
           }else{
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_jns(0);
           }
         }
@@ -5806,10 +6046,10 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         if(match&&(!branch_internal||!is_ds[(ba[i]-start)>>2])) {
           if(adj) {
             emit_addimm(cc,-CLOCK_DIVIDER*adj,cc);
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
           }else{
             emit_addnop(13);
-            add_to_linker((int)out,ba[i],branch_internal*2);
+            add_to_linker((intptr_t)out,ba[i],branch_internal*2);
           }
           emit_jmp(0);
         }else
@@ -5826,11 +6066,11 @@ static void sjump_assemble(int i,struct regstat *i_regs)
             ds_assemble_entry(i);
           }
           else {
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_jmp(0);
           }
         }
-        set_jump_target(nottaken,(int)out);
+        set_jump_target(nottaken,(intptr_t)out);
       }
 
       if(adj) {
@@ -5842,7 +6082,7 @@ static void sjump_assemble(int i,struct regstat *i_regs)
   {
     // In-order execution (branch first)
     //DebugMessage(M64MSG_VERBOSE, "IOE");
-    int nottaken=0;
+    intptr_t nottaken=0;
     if(!unconditional) {
       //DebugMessage(M64MSG_VERBOSE, "branch(%d): eax=%d ecx=%d edx=%d ebx=%d ebp=%d esi=%d edi=%d",i,branch_regs[i].regmap[0],branch_regs[i].regmap[1],branch_regs[i].regmap[2],branch_regs[i].regmap[3],branch_regs[i].regmap[5],branch_regs[i].regmap[6],branch_regs[i].regmap[7]);
       if(!only32)
@@ -5851,13 +6091,13 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         if((opcode2[i]&0x1d)==0) // BLTZ/BLTZL
         {
           emit_test(s1h,s1h);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jns(1);
         }
         if((opcode2[i]&0x1d)==1) // BGEZ/BGEZL
         {
           emit_test(s1h,s1h);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_js(1);
         }
       } // if(!only32)
@@ -5867,13 +6107,13 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         if((opcode2[i]&0x1d)==0) // BLTZ/BLTZL
         {
           emit_test(s1l,s1l);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jns(1);
         }
         if((opcode2[i]&0x1d)==1) // BGEZ/BGEZL
         {
           emit_test(s1l,s1l);
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_js(1);
         }
       }
@@ -5915,14 +6155,14 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         ds_assemble_entry(i);
       }
       else {
-        add_to_linker((int)out,ba[i],branch_internal);
+        add_to_linker((intptr_t)out,ba[i],branch_internal);
         emit_jmp(0);
       }
     }
     // branch not taken
     cop1_usable=prev_cop1_usable;
     if(!unconditional) {
-      set_jump_target(nottaken,(int)out);
+      set_jump_target(nottaken,(intptr_t)out);
       assem_debug("1:");
       if(!likely[i]) {
         wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
@@ -5937,18 +6177,18 @@ static void sjump_assemble(int i,struct regstat *i_regs)
         // Cycle count isn't in a register, temporarily load it then write it out
         emit_loadreg(CCREG,HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
         emit_storereg(CCREG,HOST_CCREG);
       }
       else{
         cc=get_reg(i_regmap,CCREG);
         assert(cc==HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
       }
     }
   }
@@ -5962,7 +6202,7 @@ static void fjump_assemble(int i,struct regstat *i_regs)
   match=match_bt(branch_regs[i].regmap,branch_regs[i].is32,branch_regs[i].dirty,ba[i]);
   assem_debug("fmatch=%d",match);
   int fs,cs;
-  int eaddr;
+  intptr_t eaddr;
   int invert=0;
   int branch_internal=internal_branch(branch_regs[i].is32,ba[i]);
   if(i==(ba[i]-start)>>2) assem_debug("idle loop");
@@ -5984,9 +6224,9 @@ static void fjump_assemble(int i,struct regstat *i_regs)
     cs=get_reg(i_regmap,CSREG);
     assert(cs>=0);
     emit_testimm(cs,0x20000000);
-    eaddr=(int)out;
+    eaddr=(intptr_t)out;
     emit_jeq(0);
-    add_stub(FP_STUB,eaddr,(int)out,i,cs,(int)i_regs,0,0);
+    add_stub(FP_STUB,eaddr,(intptr_t)out,i,cs,(intptr_t)i_regs,0,0);
     cop1_usable=1;
   }
 
@@ -6010,7 +6250,7 @@ static void fjump_assemble(int i,struct regstat *i_regs)
     do_cc(i,branch_regs[i].regmap,&adj,-1,0,invert);
     assem_debug("cycle count (adj)");
     if(1) {
-      int nottaken=0;
+      intptr_t nottaken=0;
       if(adj&&!invert) emit_addimm(cc,CLOCK_DIVIDER*(ccadj[i]+2-adj),cc);
       if(1) {
         assert(fs>=0);
@@ -6018,19 +6258,19 @@ static void fjump_assemble(int i,struct regstat *i_regs)
         if(source[i]&0x10000) // BC1T
         {
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jeq(1);
           }else{
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_jne(0);
           }
         }
         else // BC1F
           if(invert){
-            nottaken=(int)out;
+            nottaken=(intptr_t)out;
             emit_jne(1);
           }else{
-            add_to_linker((int)out,ba[i],branch_internal);
+            add_to_linker((intptr_t)out,ba[i],branch_internal);
             emit_jeq(0);
           }
         {
@@ -6052,10 +6292,10 @@ static void fjump_assemble(int i,struct regstat *i_regs)
           ds_assemble_entry(i);
         }
         else {
-          add_to_linker((int)out,ba[i],branch_internal);
+          add_to_linker((intptr_t)out,ba[i],branch_internal);
           emit_jmp(0);
         }
-        set_jump_target(nottaken,(int)out);
+        set_jump_target(nottaken,(intptr_t)out);
       }
 
       if(adj) {
@@ -6067,7 +6307,7 @@ static void fjump_assemble(int i,struct regstat *i_regs)
   {
     // In-order execution (branch first)
     //DebugMessage(M64MSG_VERBOSE, "IOE");
-    int nottaken=0;
+    intptr_t nottaken=0;
     if(1) {
       //DebugMessage(M64MSG_VERBOSE, "branch(%d): eax=%d ecx=%d edx=%d ebx=%d ebp=%d esi=%d edi=%d",i,branch_regs[i].regmap[0],branch_regs[i].regmap[1],branch_regs[i].regmap[2],branch_regs[i].regmap[3],branch_regs[i].regmap[5],branch_regs[i].regmap[6],branch_regs[i].regmap[7]);
       if(1) {
@@ -6075,12 +6315,12 @@ static void fjump_assemble(int i,struct regstat *i_regs)
         emit_testimm(fs,0x800000);
         if(source[i]&0x10000) // BC1T
         {
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jeq(1);
         }
         else // BC1F
         {
-          nottaken=(int)out;
+          nottaken=(intptr_t)out;
           emit_jne(1);
         }
       }
@@ -6121,13 +6361,13 @@ static void fjump_assemble(int i,struct regstat *i_regs)
       ds_assemble_entry(i);
     }
     else {
-      add_to_linker((int)out,ba[i],branch_internal);
+      add_to_linker((intptr_t)out,ba[i],branch_internal);
       emit_jmp(0);
     }
 
     // branch not taken
     if(1) { // <- FIXME (don't need this)
-      set_jump_target(nottaken,(int)out);
+      set_jump_target(nottaken,(intptr_t)out);
       assem_debug("1:");
       if(!likely[i]) {
         wb_invalidate(regs[i].regmap,branch_regs[i].regmap,regs[i].dirty,regs[i].is32,
@@ -6142,18 +6382,18 @@ static void fjump_assemble(int i,struct regstat *i_regs)
         // Cycle count isn't in a register, temporarily load it then write it out
         emit_loadreg(CCREG,HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),HOST_CCREG);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,NOTTAKEN,0);
         emit_storereg(CCREG,HOST_CCREG);
       }
       else{
         cc=get_reg(i_regmap,CCREG);
         assert(cc==HOST_CCREG);
         emit_addimm_and_set_flags(CLOCK_DIVIDER*(ccadj[i]+2),cc);
-        int jaddr=(int)out;
+        intptr_t jaddr=(intptr_t)out;
         emit_jns(0);
-        add_stub(CC_STUB,jaddr,(int)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
+        add_stub(CC_STUB,jaddr,(intptr_t)out,0,i,start+i*4+8,likely[i]?NULLDS:NOTTAKEN,0);
       }
     }
   }
@@ -6165,8 +6405,8 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
   int s1h=get_reg(i_regs->regmap,rs1[i]|64);
   int s2l=get_reg(i_regs->regmap,rs2[i]);
   int s2h=get_reg(i_regs->regmap,rs2[i]|64);
-  int taken=0;
-  int nottaken=0;
+  intptr_t taken=0;
+  intptr_t nottaken=0;
   int unconditional=0;
   if(rs1[i]==0)
   {
@@ -6299,13 +6539,13 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
     if(s1h>=0) {
       if(s2h>=0) emit_cmp(s1h,s2h);
       else emit_test(s1h,s1h);
-      nottaken=(int)out;
+      nottaken=(intptr_t)out;
       emit_jne(0);
     }
     if(s2l>=0) emit_cmp(s1l,s2l);
     else emit_test(s1l,s1l);
-    if(nottaken) set_jump_target(nottaken,(int)out);
-    nottaken=(int)out;
+    if(nottaken) set_jump_target(nottaken,(intptr_t)out);
+    nottaken=(intptr_t)out;
     emit_jne(0);
   }
   if((opcode[i]&0x3f)==0x15) // BNEL
@@ -6313,14 +6553,14 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
     if(s1h>=0) {
       if(s2h>=0) emit_cmp(s1h,s2h);
       else emit_test(s1h,s1h);
-      taken=(int)out;
+      taken=(intptr_t)out;
       emit_jne(0);
     }
     if(s2l>=0) emit_cmp(s1l,s2l);
     else emit_test(s1l,s1l);
-    nottaken=(int)out;
+    nottaken=(intptr_t)out;
     emit_jeq(0);
-    if(taken) set_jump_target(taken,(int)out);
+    if(taken) set_jump_target(taken,(intptr_t)out);
   }
   if((opcode[i]&0x3f)==6) // BLEZ
   {
@@ -6373,13 +6613,13 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
     if((source[i]&0x30000)==0x20000) // BC1FL
     {
       emit_testimm(s1l,0x800000);
-      nottaken=(int)out;
+      nottaken=(intptr_t)out;
       emit_jne(0);
     }
     if((source[i]&0x30000)==0x30000) // BC1TL
     {
       emit_testimm(s1l,0x800000);
-      nottaken=(int)out;
+      nottaken=(intptr_t)out;
       emit_jeq(0);
     }
   }
@@ -6399,27 +6639,27 @@ static void pagespan_assemble(int i,struct regstat *i_regs)
   int target_addr=start+i*4+5;
   void *stub=out;
   void *compiled_target_addr=check_addr(target_addr);
-  emit_extjump_ds((int)branch_addr,target_addr);
+  emit_extjump_ds((intptr_t)branch_addr,target_addr);
   if(compiled_target_addr) {
-    set_jump_target((int)branch_addr,(int)compiled_target_addr);
+    set_jump_target((intptr_t)branch_addr,(intptr_t)compiled_target_addr);
     add_link(target_addr,stub);
   }
-  else set_jump_target((int)branch_addr,(int)stub);
+  else set_jump_target((intptr_t)branch_addr,(intptr_t)stub);
   if(likely[i]) {
     // Not-taken path
-    set_jump_target((int)nottaken,(int)out);
+    set_jump_target((intptr_t)nottaken,(intptr_t)out);
     wb_dirtys(regs[i].regmap,regs[i].is32,regs[i].dirty);
     void *branch_addr=out;
     emit_jmp(0);
     int target_addr=start+i*4+8;
     void *stub=out;
     void *compiled_target_addr=check_addr(target_addr);
-    emit_extjump_ds((int)branch_addr,target_addr);
+    emit_extjump_ds((intptr_t)branch_addr,target_addr);
     if(compiled_target_addr) {
-      set_jump_target((int)branch_addr,(int)compiled_target_addr);
+      set_jump_target((intptr_t)branch_addr,(intptr_t)compiled_target_addr);
       add_link(target_addr,stub);
     }
-    else set_jump_target((int)branch_addr,(int)stub);
+    else set_jump_target((intptr_t)branch_addr,(intptr_t)stub);
   }
 }
 
@@ -6441,7 +6681,7 @@ static void pagespan_ds()
   if(regs[0].regmap[HOST_CCREG]!=CCREG)
     wb_register(CCREG,regs[0].regmap_entry,regs[0].wasdirty,regs[0].was32);
   if(regs[0].regmap[HOST_BTREG]!=BTREG)
-    emit_writeword(HOST_BTREG,(int)&branch_target);
+    emit_writeword(HOST_BTREG,(intptr_t)&branch_target);
   load_regs(regs[0].regmap_entry,regs[0].regmap,regs[0].was32,rs1[0],rs2[0]);
   address_generation(0,&regs[0],regs[0].regmap_entry);
   if(itype[0]==LOAD||itype[0]==LOADLR||itype[0]==STORE||itype[0]==STORELR||itype[0]==C1LS)
@@ -6495,7 +6735,7 @@ static void pagespan_ds()
   int btaddr=get_reg(regs[0].regmap,BTREG);
   if(btaddr<0) {
     btaddr=get_reg(regs[0].regmap,-1);
-    emit_readword((int)&branch_target,btaddr);
+    emit_readword((intptr_t)&branch_target,btaddr);
   }
   assert(btaddr!=HOST_CCREG);
   if(regs[0].regmap[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
@@ -6505,11 +6745,11 @@ static void pagespan_ds()
 #else
   emit_cmpimm(btaddr,start+4);
 #endif
-  int branch=(int)out;
+  intptr_t branch=(intptr_t)out;
   emit_jeq(0);
   store_regs_bt(regs[0].regmap,regs[0].is32,regs[0].dirty,-1);
   emit_jmp(jump_vaddr_reg[btaddr]);
-  set_jump_target(branch,(int)out);
+  set_jump_target(branch,(intptr_t)out);
   store_regs_bt(regs[0].regmap,regs[0].is32,regs[0].dirty,start+4);
   load_regs_bt(regs[0].regmap,regs[0].is32,regs[0].dirty,start+4);
 }
@@ -7620,21 +7860,45 @@ static void disassemble_inst(int i)
 }
 #endif
 
+// Set the size of the translation cache, in megabytes, used by the
+// next new_dynarec_init.  It is rounded up to a power of two and
+// clamped to what the backend can address.  0 selects the default.
+void new_dynarec_set_cache_size(unsigned int size_mb)
+{
+  tc_request=size_mb;
+}
+
+void new_dynarec_get_stats(struct new_dynarec_stats *stats)
+{
+  *stats=tc_stats;
+  #ifdef USE_JR_IC
+  stats->jr_ic_misses=jr_ic_misses;
+  #endif
+}
+
 void new_dynarec_init(void)
 {
   DebugMessage(M64MSG_INFO, "Init new dynarec");
 
-#if defined(VITA)
-  sceBlock = getVMBlock();//sceKernelAllocMemBlockForVM("code", 1 << TARGET_SIZE_2);
-  if (sceBlock < 0)
-    printf("sceKernelAllocMemBlockForVM failed\n");
-  int ret = sceKernelGetMemBlockBase(sceBlock, (void **)&base_addr);
-  if (ret < 0)
-    printf("sceKernelGetMemBlockBase failed\n");
-
-  sceKernelOpenVMDomain();
-  printf("translation_cache = 0x%08X \n ", base_addr);
-#elif NEW_DYNAREC == NEW_DYNAREC_ARM
+  tc_size_2=25;
+  if(tc_request) {
+    tc_size_2=TC_MIN_SIZE_2;
+    while(tc_size_2<TARGET_SIZE_2&&(1u<<(tc_size_2-20))<tc_request) tc_size_2++;
+  }
+  if(tc_size_2>TARGET_SIZE_2) tc_size_2=TARGET_SIZE_2;
+  DebugMessage(M64MSG_INFO, "Translation cache: %d MB", 1<<(tc_size_2-20));
+
+#if defined(VITA)
+  sceBlock = getVMBlock();//sceKernelAllocMemBlockForVM("code", 1 << TARGET_SIZE_2);
+  if (sceBlock < 0)
+    printf("sceKernelAllocMemBlockForVM failed\n");
+  int ret = sceKernelGetMemBlockBase(sceBlock, (void **)&base_addr);
+  if (ret < 0)
+    printf("sceKernelGetMemBlockBase failed\n");
+
+  sceKernelOpenVMDomain();
+  printf("translation_cache = 0x%08X \n ", base_addr);
+#elif NEW_DYNAREC == NEW_DYNAREC_ARM || NEW_DYNAREC == NEW_DYNAREC_AMD64
   if ((base_addr = mmap ((u_char *)BASE_ADDR, 1<<TARGET_SIZE_2,
             PROT_READ | PROT_WRITE | PROT_EXEC,
             MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS,
@@ -7651,18 +7915,30 @@ void new_dynarec_init(void)
   out=(u_char *)base_addr;
 
   rdword=&readmem_dword;
-  fake_pc.f.r.rs=(long long int *)&readmem_dword;
-  fake_pc.f.r.rt=(long long int *)&readmem_dword;
-  fake_pc.f.r.rd=(long long int *)&readmem_dword;
+  fake_pc.f.r.rs=(int64_t *)&readmem_dword;
+  fake_pc.f.r.rt=(int64_t *)&readmem_dword;
+  fake_pc.f.r.rd=(int64_t *)&readmem_dword;
   int n;
   for(n=0x80000;n<0x80800;n++)
     invalid_code[n]=1;
   for(n=0;n<65536;n++)
     hash_table[n][0]=hash_table[n][2]=-1;
   memset(mini_ht,-1,sizeof(mini_ht));
+  memset(lookup_l2,-1,sizeof(lookup_l2));
+  #ifdef USE_JR_IC
+  memset(jr_ic,-1,sizeof(jr_ic));
+  jr_ic_next=0;
+  jr_ic_misses=0;
+  #endif
   memset(restore_candidate,0,sizeof(restore_candidate));
   copy=shadow;
-  expirep=16384; // Expiry pointer, +2 blocks
+  tc_seg=0;
+  tc_hand=1;
+  memset(tc_used,0,sizeof(tc_used));
+  tc_filled=0;
+  tc_next=tc_victim();
+  expirep=0;
+  memset(&tc_stats,0,sizeof(tc_stats));
   pending_exception=0;
   literalcount=0;
 #ifdef HOST_IMM8
@@ -7670,12 +7946,13 @@ void new_dynarec_init(void)
   invc_ptr=invalid_code;
 #endif
   stop_after_jal=0;
+  rdram_writes_trapped=0;
   // TLB
   using_tlb=0;
   for(n=0;n<524288;n++) // 0 .. 0x7FFFFFFF
     memory_map[n]=-1;
   for(n=524288;n<526336;n++) // 0x80000000 .. 0x807FFFFF
-    memory_map[n]=((u_int)g_rdram-0x80000000)>>2;
+    memory_map[n]=((uintptr_t)g_rdram-0x80000000)>>2;
   for(n=526336;n<1048576;n++) // 0x80800000 .. 0xFFFFFFFF
     memory_map[n]=-1;
   for(n=0;n<0x8000;n++) { // 0 .. 0x7FFFFFFF
@@ -7786,6 +8063,84 @@ static void end_block(void *start)
   end_tcache_write(start, out);
 }
 
+// Last position at which a block may be started in seg, so that
+// no block straddles two segments
+static u_char *tc_segment_limit(int seg)
+{
+  u_char *end=tc_segment_base(seg+1);
+  if(end>(u_char *)base_addr+(1<<TARGET_SIZE_2)-JUMP_TABLE_SIZE)
+    end=(u_char *)base_addr+(1<<TARGET_SIZE_2)-JUMP_TABLE_SIZE;
+  return end-MAX_OUTPUT_BLOCK_SIZE;
+}
+
+// Expire the blocks in tc_next, up to the given progress (0-8192).
+// Each of the four phases walks the 2048 bins of the block lists.
+static void tc_expire(int end)
+{
+  int i;
+  if(end>TC_EXPIRE_DONE) end=TC_EXPIRE_DONE;
+  while(expirep<end)
+  {
+    int seg=tc_next;
+    inv_debug("EXP: Phase %d\n",expirep);
+    switch((expirep>>11)&3)
+    {
+      case 0:
+        // Clear jump_in and jump_dirty
+        ll_remove_matching_addrs(jump_in+(expirep&2047),seg);
+        ll_remove_matching_addrs(jump_dirty+(expirep&2047),seg);
+        ll_remove_matching_addrs(jump_in+2048+(expirep&2047),seg);
+        ll_remove_matching_addrs(jump_dirty+2048+(expirep&2047),seg);
+        break;
+      case 1:
+        // Clear pointers
+        ll_kill_pointers(jump_out[expirep&2047],seg);
+        ll_kill_pointers(jump_out[(expirep&2047)+2048],seg);
+        break;
+      case 2:
+        // Clear hash table
+        for(i=0;i<32;i++) {
+          uintptr_t *ht_bin=hash_table[((expirep&2047)<<5)+i];
+          if(tc_segment(ht_bin[3])==(uintptr_t)seg) {
+            inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[2],ht_bin[3]);
+            ht_bin[2]=ht_bin[3]=-1;
+          }
+          if(tc_segment(ht_bin[1])==(uintptr_t)seg) {
+            inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[0],ht_bin[1]);
+            ht_bin[0]=ht_bin[2];
+            ht_bin[1]=ht_bin[3];
+            ht_bin[2]=ht_bin[3]=-1;
+          }
+        }
+        break;
+      case 3:
+        // Clear jump_out
+        #if NEW_DYNAREC == NEW_DYNAREC_ARM
+        if((expirep&2047)==0)
+          do_clear_cache();
+        #endif
+        if((expirep&2047)==0) {
+          // Nothing new can point into seg by now, drop the
+          // predictors which still do
+          #ifdef USE_MINI_HT
+          for(i=0;i<32;i++)
+            if(tc_segment(mini_ht[i][1])==(uintptr_t)seg)
+              mini_ht[i][0]=mini_ht[i][1]=-1;
+          #endif
+          #ifdef USE_JR_IC
+          for(i=0;i<JR_IC_SLOTS;i++)
+            if(tc_segment(jr_ic[i][1])==(uintptr_t)seg)
+              jr_ic[i][0]=jr_ic[i][1]=-1;
+          #endif
+        }
+        ll_remove_matching_addrs(jump_out+(expirep&2047),seg);
+        ll_remove_matching_addrs(jump_out+2048+(expirep&2047),seg);
+        break;
+    }
+    expirep++;
+  }
+}
+
 int new_recompile_block(int addr)
 {
 /*
@@ -7797,12 +8152,12 @@ int new_recompile_block(int addr)
   }
 */
   //if(g_cp0_regs[CP0_COUNT_REG]==365117028) tracedebug=1;
-  assem_debug("NOTCOMPILED: addr = %x -> %x", (int)addr, (int)out);
+  assem_debug("NOTCOMPILED: addr = %x -> %x", (int)addr, (intptr_t)out);
 #if defined (COUNT_NOTCOMPILEDS )
   notcompiledCount++;
   DebugMessage(M64MSG_VERBOSE, "notcompiledCount=%i", notcompiledCount );
 #endif
-  //DebugMessage(M64MSG_VERBOSE, "NOTCOMPILED: addr = %x -> %x", (int)addr, (int)out);
+  //DebugMessage(M64MSG_VERBOSE, "NOTCOMPILED: addr = %x -> %x", (int)addr, (intptr_t)out);
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (compile %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,addr);
   //if(debug)
   //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (checksum %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,mchecksum());
@@ -7814,25 +8169,25 @@ int new_recompile_block(int addr)
   start = (u_int)addr&~3;
   //assert(((u_int)addr&1)==0);
   if ((int)addr >= 0xa4000000 && (int)addr < 0xa4001000) {
-    source = (u_int *)((u_int)g_sp.mem+start-0xa4000000);
+    source = (u_int *)((uintptr_t)g_sp.mem+start-0xa4000000);
     pagelimit = 0xa4001000;
   }
   else if ((int)addr >= 0x80000000 && (int)addr < 0x80800000) {
-    source = (u_int *)((u_int)g_rdram+start-0x80000000);
+    source = (u_int *)((uintptr_t)g_rdram+start-0x80000000);
     pagelimit = 0x80800000;
   }
   else if ((signed int)addr >= (signed int)0xC0000000) {
     //DebugMessage(M64MSG_VERBOSE, "addr=%x mm=%x",(u_int)addr,(memory_map[start>>12]<<2));
     //if(tlb_LUT_r[start>>12])
-      //source = (u_int *)(((int)g_rdram)+(tlb_LUT_r[start>>12]&0xFFFFF000)+(((int)addr)&0xFFF)-0x80000000);
-    if((signed int)memory_map[start>>12]>=0) {
-      source = (u_int *)((u_int)(start+(memory_map[start>>12]<<2)));
+      //source = (u_int *)(((intptr_t)g_rdram)+(tlb_LUT_r[start>>12]&0xFFFFF000)+(((int)addr)&0xFFF)-0x80000000);
+    if((intptr_t)memory_map[start>>12]>=0) {
+      source = (u_int *)((uintptr_t)start+(memory_map[start>>12]<<2));
       pagelimit=(start+4096)&0xFFFFF000;
-      int map=memory_map[start>>12];
+      uintptr_t map=memory_map[start>>12];
       int i;
       for(i=0;i<5;i++) {
         //DebugMessage(M64MSG_VERBOSE, "start: %x next: %x",map,memory_map[pagelimit>>12]);
-        if((map&0xBFFFFFFF)==(memory_map[pagelimit>>12]&0xBFFFFFFF)) pagelimit+=4096;
+        if((map&~WRITE_PROTECT)==(memory_map[pagelimit>>12]&~WRITE_PROTECT)) pagelimit+=4096;
       }
       assem_debug("pagelimit=%x",pagelimit);
       assem_debug("mapping=%x (%x)",memory_map[start>>12],(memory_map[start>>12]<<2)+start);
@@ -10745,7 +11100,7 @@ int new_recompile_block(int addr)
         loop_preload(regmap_pre[i],regs[i].regmap_entry);
       }
       // branch target entry point
-      instr_addr[i]=(u_int)out;
+      instr_addr[i]=(uintptr_t)out;
       assem_debug("<->");
       // load regs
       if(regs[i].regmap_entry[HOST_CCREG]==CCREG&&regs[i].regmap[HOST_CCREG]!=CCREG)
@@ -10859,7 +11214,7 @@ int new_recompile_block(int addr)
         store_regs_bt(regs[i-2].regmap,regs[i-2].is32,regs[i-2].dirty,start+i*4);
         assert(regs[i-2].regmap[HOST_CCREG]==CCREG);
       }
-      add_to_linker((int)out,start+i*4,0);
+      add_to_linker((intptr_t)out,start+i*4,0);
       emit_jmp(0);
     }
   }
@@ -10871,7 +11226,7 @@ int new_recompile_block(int addr)
     if(regs[i-1].regmap[HOST_CCREG]!=CCREG)
       emit_loadreg(CCREG,HOST_CCREG);
     emit_addimm(HOST_CCREG,CLOCK_DIVIDER*(ccadj[i-1]+1),HOST_CCREG);
-    add_to_linker((int)out,start+i*4,0);
+    add_to_linker((intptr_t)out,start+i*4,0);
     emit_jmp(0);
   }
 
@@ -10915,10 +11270,11 @@ int new_recompile_block(int addr)
       void *addr=check_addr(link_addr[i][1]);
       emit_extjump(link_addr[i][0],link_addr[i][1]);
       if(addr) {
-        set_jump_target(link_addr[i][0],(int)addr);
+        set_jump_target(link_addr[i][0],(intptr_t)addr);
         add_link(link_addr[i][1],stub);
+        tc_touch(addr);
       }
-      else set_jump_target(link_addr[i][0],(int)stub);
+      else set_jump_target(link_addr[i][0],(intptr_t)stub);
     }
     else
     {
@@ -10955,13 +11311,13 @@ int new_recompile_block(int addr)
           assem_debug("%8x (%d) <- %8x",instr_addr[i],i,start+i*4);
           assem_debug("jump_in: %x",start+i*4);
           ll_add(jump_dirty+vpage,vaddr,(void *)out);
-          int entry_point=do_dirty_stub(i);
+          intptr_t entry_point=do_dirty_stub(i);
           ll_add(jump_in+page,vaddr,(void *)entry_point);
           // If there was an existing entry in the hash table,
           // replace it with the new address.
           // Don't add new entries.  We'll insert the
           // ones that actually get used in check_addr().
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==vaddr) {
             ht_bin[1]=entry_point;
           }
@@ -10974,16 +11330,16 @@ int new_recompile_block(int addr)
           u_int r=requires_32bit[i]|!!(requires_32bit[i]>>32);
           assem_debug("%8x (%d) <- %8x",instr_addr[i],i,start+i*4);
           assem_debug("jump_in: %x (restricted - %x)",start+i*4,r);
-          //int entry_point=(int)out;
+          //int entry_point=(intptr_t)out;
           ////assem_debug("entry_point: %x",entry_point);
           //load_regs_entry(i);
-          //if(entry_point==(int)out)
+          //if(entry_point==(intptr_t)out)
           //  entry_point=instr_addr[i];
           //else
           //  emit_jmp(instr_addr[i]);
           //ll_add_32(jump_in+page,vaddr,r,(void *)entry_point);
           ll_add_32(jump_dirty+vpage,vaddr,r,(void *)out);
-          int entry_point=do_dirty_stub(i);
+          intptr_t entry_point=do_dirty_stub(i);
           ll_add_32(jump_in+page,vaddr,r,(void *)entry_point);
         }
       }
@@ -10993,85 +11349,49 @@ int new_recompile_block(int addr)
   literal_pool(0);
   #ifdef CORTEX_A8_BRANCH_PREDICTION_HACK
   // Align code
-  if(((u_int)out)&7) emit_addnop(13);
+  if(((uintptr_t)out)&7) emit_addnop(13);
   #endif
-  assert((u_int)out-(u_int)beginning<MAX_OUTPUT_BLOCK_SIZE);
-  //DebugMessage(M64MSG_VERBOSE, "shadow buffer: %x-%x",(int)copy,(int)copy+slen*4);
+  assert((uintptr_t)out-(uintptr_t)beginning<MAX_OUTPUT_BLOCK_SIZE);
+  //DebugMessage(M64MSG_VERBOSE, "shadow buffer: %x-%x",(intptr_t)copy,(intptr_t)copy+slen*4);
   memcpy(copy,(char*)source,slen*4);
   copy+=slen*4;
 
   end_block(beginning);
 
-  // If we're within 256K of the end of the buffer,
-  // start over from the beginning. (Is 256K enough?)
-  if((u_int)out > (u_char *)((u_char *)base_addr+(1<<TARGET_SIZE_2)-MAX_OUTPUT_BLOCK_SIZE-JUMP_TABLE_SIZE))
-    out=(u_char *)base_addr;
+  tc_stats.blocks_compiled++;
+  tc_stats.bytes_emitted+=out-(u_char *)beginning;
+
+  // If the current segment is full, finish expiring the next one
+  // and continue there, then pick a new segment to expire.
+  if(out>tc_segment_limit(tc_seg))
+  {
+    tc_expire(TC_EXPIRE_DONE);
+    tc_filled|=1<<tc_seg;
+    tc_seg=tc_next;
+    out=tc_segment_base(tc_seg);
+    tc_next=tc_victim();
+    if(tc_filled&(1<<tc_next)) tc_stats.evictions++;
+    expirep=0;
+  }
 
   // Trap writes to any of the pages we compiled
   for(i=start>>12;i<=(int)((start+slen*4)>>12);i++) {
     invalid_code[i]=0;
-    memory_map[i]|=0x40000000;
+    memory_map[i]|=WRITE_PROTECT;
     if((signed int)start>=(signed int)0xC0000000) {
       assert(using_tlb);
-      j=(((u_int)i<<12)+(memory_map[i]<<2)-(u_int)g_rdram+(u_int)0x80000000)>>12;
+      j=(((u_int)i<<12)+(memory_map[i]<<2)-(uintptr_t)g_rdram+(u_int)0x80000000)>>12;
       invalid_code[j]=0;
-      memory_map[j]|=0x40000000;
+      memory_map[j]|=WRITE_PROTECT;
       //DebugMessage(M64MSG_VERBOSE, "write protect physical page: %x (virtual %x)",j<<12,start);
     }
   }
 
-  /* Pass 10 - Free memory by expiring oldest blocks */
+  /* Pass 10 - Free memory by expiring the next segment, in step
+     with the progress through the current one */
 
-  int end=((((intptr_t)out-(intptr_t)base_addr)>>(TARGET_SIZE_2-16))+16384)&65535;
-  while(expirep!=end)
-  {
-    int shift=TARGET_SIZE_2-3; // Divide into 8 blocks
-    int base=(int)base_addr+((expirep>>13)<<shift); // Base address of this block
-    inv_debug("EXP: Phase %d\n",expirep);
-    switch((expirep>>11)&3)
-    {
-      case 0:
-        // Clear jump_in and jump_dirty
-        ll_remove_matching_addrs(jump_in+(expirep&2047),base,shift);
-        ll_remove_matching_addrs(jump_dirty+(expirep&2047),base,shift);
-        ll_remove_matching_addrs(jump_in+2048+(expirep&2047),base,shift);
-        ll_remove_matching_addrs(jump_dirty+2048+(expirep&2047),base,shift);
-        break;
-      case 1:
-        // Clear pointers
-        ll_kill_pointers(jump_out[expirep&2047],base,shift);
-        ll_kill_pointers(jump_out[(expirep&2047)+2048],base,shift);
-        break;
-      case 2:
-        // Clear hash table
-        for(i=0;i<32;i++) {
-          u_int *ht_bin=hash_table[((expirep&2047)<<5)+i];
-          if(((ht_bin[3]-(u_int)base_addr)>>shift)==((base-(u_int)base_addr)>>shift) ||
-             ((ht_bin[3]-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(u_int)base_addr)>>shift)) {
-            inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[2],ht_bin[3]);
-            ht_bin[2]=ht_bin[3]=-1;
-          }
-          if(((ht_bin[1]-(u_int)base_addr)>>shift)==((base-(u_int)base_addr)>>shift) ||
-             ((ht_bin[1]-(u_int)base_addr-MAX_OUTPUT_BLOCK_SIZE)>>shift)==((base-(u_int)base_addr)>>shift)) {
-            inv_debug("EXP: Remove hash %x -> %x\n",ht_bin[0],ht_bin[1]);
-            ht_bin[0]=ht_bin[2];
-            ht_bin[1]=ht_bin[3];
-            ht_bin[2]=ht_bin[3]=-1;
-          }
-        }
-        break;
-      case 3:
-        // Clear jump_out
-        #if NEW_DYNAREC == NEW_DYNAREC_ARM
-        if((expirep&2047)==0)
-          do_clear_cache();
-        #endif
-        ll_remove_matching_addrs(jump_out+(expirep&2047),base,shift);
-        ll_remove_matching_addrs(jump_out+2048+(expirep&2047),base,shift);
-        break;
-    }
-    expirep=(expirep+1)&65535;
-  }
+  u_char *seg_base=tc_segment_base(tc_seg);
+  tc_expire((int)(((uint64_t)(out-seg_base)*TC_EXPIRE_DONE)/(tc_segment_limit(tc_seg)-seg_base)));
   return 0;
 }
 
@@ -11111,10 +11431,10 @@ void TLBWI_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((uintptr_t)(tlb_LUT_r[i]&0xFFFFF000)-((uintptr_t)i<<12)+(uintptr_t)g_rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
           assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
         }
@@ -11132,10 +11452,10 @@ void TLBWI_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((uintptr_t)(tlb_LUT_r[i]&0xFFFFF000)-((uintptr_t)i<<12)+(uintptr_t)g_rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
           assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
         }
@@ -11183,10 +11503,10 @@ void TLBWR_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((uintptr_t)(tlb_LUT_r[i]&0xFFFFF000)-((uintptr_t)i<<12)+(uintptr_t)g_rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
           assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
         }
@@ -11204,10 +11524,10 @@ void TLBWR_new(void)
     if(i<0x80000||i>0xBFFFF)
     {
       if(tlb_LUT_r[i]) {
-        memory_map[i]=((tlb_LUT_r[i]&0xFFFFF000)-(i<<12)+(unsigned int)g_rdram-0x80000000)>>2;
+        memory_map[i]=((uintptr_t)(tlb_LUT_r[i]&0xFFFFF000)-((uintptr_t)i<<12)+(uintptr_t)g_rdram-0x80000000)>>2;
         // FIXME: should make sure the physical page is invalid too
         if(!tlb_LUT_w[i]||!invalid_code[i]) {
-          memory_map[i]|=0x40000000; // Write protect
+          memory_map[i]|=WRITE_PROTECT; // Write protect
         }else{
           assert(tlb_LUT_r[i]==tlb_LUT_w[i]);
         }
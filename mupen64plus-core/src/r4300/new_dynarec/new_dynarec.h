@@ -29,6 +29,24 @@
 #define NEW_DYNAREC_AMD64 2
 #define NEW_DYNAREC_ARM 3
 
+/* memory_map holds (host-virtual)>>2 for each 4K page, the top two bits
+ * mark unmapped (sign bit) and write protected pages */
+#define WRITE_PROTECT ((uintptr_t)1<<(8*sizeof(uintptr_t)-2))
+
+/* per-session translation cache counters, reset by new_dynarec_init */
+struct new_dynarec_stats
+{
+   uint64_t flushes;         /* invalidate_all_pages calls */
+   uint64_t evictions;       /* cache segments reclaimed for new code */
+   uint64_t bytes_emitted;
+   uint64_t blocks_compiled;
+   uint64_t lookups;         /* get_addr calls, i.e. hash table misses */
+   uint64_t l2_hits;         /* ... found in the second level table */
+   uint64_t list_hits;       /* ... found by walking the block lists */
+   uint64_t jr_ic_sites;     /* indirect jumps given an inline cache */
+   uint64_t jr_ic_misses;    /* inline cache target mismatches */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,8 +59,11 @@ extern int pending_exception;
 void invalidate_all_pages(void);
 void invalidate_block(unsigned int block);
 void invalidate_cached_code_new_dynarec(uint32_t address, size_t size);
+int new_dynarec_trap_rdram_writes(void);
 void new_dynarec_init(void);
 void new_dyna_start(void);
 void new_dynarec_cleanup(void);
+void new_dynarec_set_cache_size(unsigned int size_mb);
+void new_dynarec_get_stats(struct new_dynarec_stats *stats);
 
 #endif /* M64P_R4300_NEW_DYNAREC_H */
@@ -0,0 +1,4103 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus - assem_x64.c                                             *
+ *   Copyright (C) 2009-2011 Ari64                                         *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include "main/main.h"
+
+int cycle_count;
+int last_count;
+int pcaddr;
+int pending_exception;
+int branch_target;
+uint64_t readmem_dword;
+static precomp_instr fake_pc;
+uintptr_t memory_map[1048576];
+ALIGN(16, static uintptr_t mini_ht[32][2]);
+ALIGN(4, u_char restore_candidate[512]);
+u_int tc_used[8];
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void do_interrupt();
+void jump_vaddr_eax();
+void jump_vaddr_ecx();
+void jump_vaddr_edx();
+void jump_vaddr_ebx();
+void jump_vaddr_ebp();
+void jump_vaddr_esi();
+void jump_vaddr_edi();
+void jump_vaddr_r8();
+void jump_vaddr_r9();
+void jump_vaddr_r10();
+void jump_vaddr_r11();
+void jump_vaddr_r12();
+void jump_vaddr_ic();
+#ifdef __cplusplus
+}
+#endif
+
+static const intptr_t jump_vaddr_reg[16] = {
+  (intptr_t)jump_vaddr_eax,
+  (intptr_t)jump_vaddr_ecx,
+  (intptr_t)jump_vaddr_edx,
+  (intptr_t)jump_vaddr_ebx,
+  0,
+  (intptr_t)jump_vaddr_ebp,
+  (intptr_t)jump_vaddr_esi,
+  (intptr_t)jump_vaddr_edi,
+  (intptr_t)jump_vaddr_r8,
+  (intptr_t)jump_vaddr_r9,
+  (intptr_t)jump_vaddr_r10,
+  (intptr_t)jump_vaddr_r11,
+  (intptr_t)jump_vaddr_r12,
+  0,
+  0,
+  0 };
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void invalidate_block_eax();
+void invalidate_block_ecx();
+void invalidate_block_edx();
+void invalidate_block_ebx();
+void invalidate_block_ebp();
+void invalidate_block_esi();
+void invalidate_block_edi();
+void invalidate_block_r8();
+void invalidate_block_r9();
+void invalidate_block_r10();
+void invalidate_block_r11();
+void invalidate_block_r12();
+void invalidate_block_r13();
+#ifdef __cplusplus
+}
+#endif
+
+static const intptr_t invalidate_block_reg[16] = {
+  (intptr_t)invalidate_block_eax,
+  (intptr_t)invalidate_block_ecx,
+  (intptr_t)invalidate_block_edx,
+  (intptr_t)invalidate_block_ebx,
+  0,
+  (intptr_t)invalidate_block_ebp,
+  (intptr_t)invalidate_block_esi,
+  (intptr_t)invalidate_block_edi,
+  (intptr_t)invalidate_block_r8,
+  (intptr_t)invalidate_block_r9,
+  (intptr_t)invalidate_block_r10,
+  (intptr_t)invalidate_block_r11,
+  (intptr_t)invalidate_block_r12,
+  (intptr_t)invalidate_block_r13,
+  0,
+  0 };
+
+static const u_short rounding_modes[4] = {
+  0x33F, // round
+  0xF3F, // trunc
+  0xB3F, // ceil
+  0x73F};// floor
+
+#include "../../fpu.h"
+
+// We need these for cmovcc instructions on x86
+static const u_int const_zero=0;
+static const u_int const_one=1;
+
+// Scratch register for addresses that don't fit in 32 bits, never allocated
+#define HOST_SCRATCH 14
+// Pseudo base register for RIP-relative operands (see output_mem)
+#define RIP -2
+
+/* Linker */
+
+static void set_jump_target(intptr_t addr,intptr_t target)
+{
+  u_char *ptr=(u_char *)addr;
+  if(*ptr==0x0f)
+  {
+    assert(ptr[1]>=0x80&&ptr[1]<=0x8f);
+    int *ptr2=(int *)(ptr+2);
+    *ptr2=target-(intptr_t)ptr2-4;
+  }
+  else if(*ptr==0xe8||*ptr==0xe9) {
+    int *ptr2=(int *)(ptr+1);
+    *ptr2=target-(intptr_t)ptr2-4;
+  }
+  else
+  {
+    assert(ptr[0]==0x4c&&ptr[1]==0x8d&&ptr[2]==0x35); /* lea (return address) */
+    int *ptr2=(int *)(ptr+3);
+    *ptr2=target-(intptr_t)ptr2-4;
+  }
+}
+
+void *dynamic_linker(void * src, u_int vaddr)
+{
+  u_int page=(vaddr^0x80000000)>>12;
+  u_int vpage=page;
+  if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
+  if(page>2048) page=2048+(page&2047);
+  if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
+  if(vpage>2048) vpage=2048+(vpage&2047);
+  struct ll_entry *head;
+  head=jump_in[page];
+
+  while(head!=NULL) {
+    if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
+      int *ptr=(int*)src;
+      u_char *ptr2=(u_char*)ptr+*ptr+4;
+      assert(ptr2[0]==0xBE);                                   //mov
+      assert(ptr2[5]==0x48&&ptr2[6]==0x8D&&ptr2[7]==0x3D);     //lea
+      assert(ptr2[12]==0xE8);                                  //call
+      add_link(vaddr, ptr2);
+      tc_touch(head->addr);
+      *ptr=(intptr_t)head->addr-(intptr_t)ptr-4;
+      return head->addr;
+    }
+    head=head->next;
+  }
+
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
+  if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
+
+  head=jump_dirty[vpage];
+  while(head!=NULL) {
+    if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      // Don't restore blocks which are about to expire from the cache
+      if(!tc_expiring((uintptr_t)head->addr)) {
+        if(verify_dirty(head->addr)) {
+          //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
+          invalid_code[vaddr>>12]=0;
+          memory_map[vaddr>>12]|=WRITE_PROTECT;
+          if(vpage<2048) {
+            if(tlb_LUT_r[vaddr>>12]) {
+              invalid_code[tlb_LUT_r[vaddr>>12]>>12]=0;
+              memory_map[tlb_LUT_r[vaddr>>12]>>12]|=WRITE_PROTECT;
+            }
+            restore_candidate[vpage>>3]|=1<<(vpage&7);
+          }
+          else restore_candidate[page>>3]|=1<<(page&7);
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          if(ht_bin[0]==vaddr) {
+            ht_bin[1]=(uintptr_t)head->addr; // Replace existing entry
+          }
+          else
+          {
+            ht_bin[3]=ht_bin[1];
+            ht_bin[2]=ht_bin[0];
+            ht_bin[1]=(uintptr_t)head->addr;
+            ht_bin[0]=vaddr;
+          }
+          return head->addr;
+        }
+      }
+    }
+    head=head->next;
+  }
+
+  int r=new_recompile_block(vaddr);
+  if(r==0) return dynamic_linker(src, vaddr);
+  // Execute in unmapped page, generate pagefault exception
+  g_cp0_regs[CP0_STATUS_REG]|=2;
+  g_cp0_regs[CP0_CAUSE_REG]=0x8;
+  g_cp0_regs[CP0_EPC_REG]=vaddr;
+  g_cp0_regs[CP0_BADVADDR_REG]=vaddr;
+  g_cp0_regs[CP0_CONTEXT_REG]=(g_cp0_regs[CP0_CONTEXT_REG]&0xFF80000F)|((g_cp0_regs[CP0_BADVADDR_REG]>>9)&0x007FFFF0);
+  g_cp0_regs[CP0_ENTRYHI_REG]=g_cp0_regs[CP0_BADVADDR_REG]&0xFFFFE000;
+  return get_addr_ht(0x80000000);
+}
+
+void *dynamic_linker_ds(void * src, u_int vaddr)
+{
+  u_int page=(vaddr^0x80000000)>>12;
+  u_int vpage=page;
+  if(page>262143&&tlb_LUT_r[vaddr>>12]) page=(tlb_LUT_r[vaddr>>12]^0x80000000)>>12;
+  if(page>2048) page=2048+(page&2047);
+  if(vpage>262143&&tlb_LUT_r[vaddr>>12]) vpage&=2047; // jump_dirty uses a hash of the virtual address instead
+  if(vpage>2048) vpage=2048+(vpage&2047);
+  struct ll_entry *head;
+  head=jump_in[page];
+
+  while(head!=NULL) {
+    if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
+      int *ptr=(int*)src;
+      u_char *ptr2=(u_char*)ptr+*ptr+4;
+      assert(ptr2[0]==0xBE);                                   //mov
+      assert(ptr2[5]==0x48&&ptr2[6]==0x8D&&ptr2[7]==0x3D);     //lea
+      assert(ptr2[12]==0xE8);                                  //call
+      add_link(vaddr, ptr2);
+      tc_touch(head->addr);
+      *ptr=(intptr_t)head->addr-(intptr_t)ptr-4;
+      return head->addr;
+    }
+    head=head->next;
+  }
+
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
+  if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
+
+  head=jump_dirty[vpage];
+  while(head!=NULL) {
+    if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
+      //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
+      // Don't restore blocks which are about to expire from the cache
+      if(!tc_expiring((uintptr_t)head->addr)) {
+        if(verify_dirty(head->addr)) {
+          //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
+          invalid_code[vaddr>>12]=0;
+          memory_map[vaddr>>12]|=WRITE_PROTECT;
+          if(vpage<2048) {
+            if(tlb_LUT_r[vaddr>>12]) {
+              invalid_code[tlb_LUT_r[vaddr>>12]>>12]=0;
+              memory_map[tlb_LUT_r[vaddr>>12]>>12]|=WRITE_PROTECT;
+            }
+            restore_candidate[vpage>>3]|=1<<(vpage&7);
+          }
+          else restore_candidate[page>>3]|=1<<(page&7);
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          if(ht_bin[0]==vaddr) {
+            ht_bin[1]=(uintptr_t)head->addr; // Replace existing entry
+          }
+          else
+          {
+            ht_bin[3]=ht_bin[1];
+            ht_bin[2]=ht_bin[0];
+            ht_bin[1]=(uintptr_t)head->addr;
+            ht_bin[0]=vaddr;
+          }
+          return head->addr;
+        }
+      }
+    }
+    head=head->next;
+  }
+
+  int r=new_recompile_block((vaddr&0xFFFFFFF8)+1);
+  if(r==0) return dynamic_linker_ds(src, vaddr);
+  // Execute in unmapped page, generate pagefault exception
+  g_cp0_regs[CP0_STATUS_REG]|=2;
+  g_cp0_regs[CP0_CAUSE_REG]=0x80000008;
+  g_cp0_regs[CP0_EPC_REG]=(vaddr&0xFFFFFFF8)-4;
+  g_cp0_regs[CP0_BADVADDR_REG]=vaddr&0xFFFFFFF8;
+  g_cp0_regs[CP0_CONTEXT_REG]=(g_cp0_regs[CP0_CONTEXT_REG]&0xFF80000F)|((g_cp0_regs[CP0_BADVADDR_REG]>>9)&0x007FFFF0);
+  g_cp0_regs[CP0_ENTRYHI_REG]=g_cp0_regs[CP0_BADVADDR_REG]&0xFFFFE000;
+  return get_addr_ht(0x80000000);
+}
+
+
+// The external jump stub loads the address of the branch
+// displacement with lea rdi,[rip+disp] (see emit_extjump2)
+static void *kill_pointer(void *stub)
+{
+  int *i_ptr=(int *)((intptr_t)stub+12+*(int *)((intptr_t)stub+8));
+  *i_ptr=(intptr_t)stub-(intptr_t)i_ptr-4;
+  return i_ptr;
+}
+static intptr_t get_pointer(void *stub)
+{
+  int *i_ptr=(int *)((intptr_t)stub+12+*(int *)((intptr_t)stub+8));
+  return *i_ptr+(intptr_t)i_ptr+4;
+}
+
+// Find the "clean" entry point from a "dirty" entry point
+// by skipping past the call to verify_code
+static uintptr_t get_clean_addr(intptr_t addr)
+{
+  u_char *ptr=(u_char *)addr;
+  assert(ptr[30]==0xE8); // call instruction
+  if(ptr[35]==0xE9) return *(int *)(ptr+36)+addr+40; // follow jmp
+  else return(addr+35);
+}
+
+static int verify_dirty(void *addr)
+{
+  u_char *ptr=(u_char *)addr;
+  assert(ptr[5]==0x48&&ptr[6]==0xB8);
+  uintptr_t source=*(uintptr_t *)(ptr+7);
+  uintptr_t copy=*(uintptr_t *)(ptr+17);
+  u_int len=*(u_int *)(ptr+26);
+  assert(ptr[30]==0xE8); // call instruction
+  uintptr_t verifier=*(int *)(ptr+31)+(uintptr_t)ptr+35;
+  if(verifier==(uintptr_t)verify_code_vm||verifier==(uintptr_t)verify_code_ds) {
+    unsigned int page=(u_int)source>>12;
+    uintptr_t map_value=memory_map[page];
+    if((intptr_t)map_value<0) return 0;
+    while(page<(((u_int)source+len-1)>>12)) {
+      if((memory_map[++page]<<2)!=(map_value<<2)) return 0;
+    }
+    source = source+(map_value<<2);
+  }
+  //DebugMessage(M64MSG_VERBOSE, "verify_dirty: %x %x %x",source,copy,len);
+  return !memcmp((void *)source,(void *)copy,len);
+}
+
+// This doesn't necessarily find all clean entry points, just
+// guarantees that it's not dirty
+static int isclean(intptr_t addr)
+{
+  u_char *ptr=(u_char *)addr;
+  if(ptr[0]!=0xBF) return 1; // mov imm,%edi
+  if(ptr[5]!=0x48||ptr[6]!=0xB8) return 1; // mov imm64,%rax
+  if(ptr[15]!=0x48||ptr[16]!=0xBB) return 1; // mov imm64,%rbx
+  if(ptr[25]!=0xB9) return 1; // mov imm,%ecx
+  if(ptr[30]!=0xE8) return 1; // call instruction
+  return 0;
+}
+
+static void get_bounds(intptr_t addr,uintptr_t *start,uintptr_t *end)
+{
+  u_char *ptr=(u_char *)addr;
+  assert(ptr[5]==0x48&&ptr[6]==0xB8);
+  uintptr_t source=*(uintptr_t *)(ptr+7);
+  //uintptr_t copy=*(uintptr_t *)(ptr+17);
+  u_int len=*(u_int *)(ptr+26);
+  assert(ptr[30]==0xE8); // call instruction
+  uintptr_t verifier=*(int *)(ptr+31)+(uintptr_t)ptr+35;
+  if(verifier==(uintptr_t)verify_code_vm||verifier==(uintptr_t)verify_code_ds) {
+    if((intptr_t)memory_map[source>>12]<0) source = 0;
+    else source = source+(memory_map[source>>12]<<2);
+  }
+  if(start) *start=source;
+  if(end) *end=source+len;
+}
+
+/* Register allocation */
+
+// Note: registers are allocated clean (unmodified state)
+// if you intend to modify the register, you must call dirty_reg().
+static void alloc_reg(struct regstat *cur,int i,signed char reg)
+{
+  int r,hr;
+  int preferred_reg = (reg>28)?8+(reg&3):(reg&7);
+  if(reg==CCREG) preferred_reg=HOST_CCREG;
+  if(preferred_reg==EXCLUDE_REG) preferred_reg=HOST_BTREG;
+  
+  // Don't allocate unused registers
+  if((cur->u>>reg)&1) return;
+  
+  // see if it's already allocated
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    if(cur->regmap[hr]==reg) return;
+  }
+  
+  // Keep the same mapping if the register was already allocated in a loop
+  preferred_reg = loop_reg(i,reg,preferred_reg);
+  
+  // Try to allocate the preferred register
+  if(cur->regmap[preferred_reg]==-1) {
+    cur->regmap[preferred_reg]=reg;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  r=cur->regmap[preferred_reg];
+  if(r<64&&((cur->u>>r)&1)) {
+    cur->regmap[preferred_reg]=reg;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  if(r>=64&&((cur->uu>>(r&63))&1)) {
+    cur->regmap[preferred_reg]=reg;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  
+  // Clear any unneeded registers
+  // We try to keep the mapping consistent, if possible, because it
+  // makes branches easier (especially loops).  So we try to allocate
+  // first (see above) before removing old mappings.  If this is not
+  // possible then go ahead and clear out the registers that are no
+  // longer needed.
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    r=cur->regmap[hr];
+    if(r>=0) {
+      if(r<64) {
+        if((cur->u>>r)&1)
+          if(i==0||(unneeded_reg[i-1]>>r)&1) {cur->regmap[hr]=-1;break;}
+      }
+      else
+      {
+        if((cur->uu>>(r&63))&1)
+          if(i==0||(unneeded_reg_upper[i-1]>>(r&63))&1) {cur->regmap[hr]=-1;break;}
+      }
+    }
+  }
+  // Try to allocate any available register, but prefer
+  // registers that have not been used recently.
+  if(i>0) {
+    for(hr=0;hr<HOST_REGS;hr++) {
+      if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+        if(regs[i-1].regmap[hr]!=rs1[i-1]&&regs[i-1].regmap[hr]!=rs2[i-1]&&regs[i-1].regmap[hr]!=rt1[i-1]&&regs[i-1].regmap[hr]!=rt2[i-1]) {
+          cur->regmap[hr]=reg;
+          cur->dirty&=~(1<<hr);
+          cur->isconst&=~(1<<hr);
+          return;
+        }
+      }
+    }
+  }
+  // Try to allocate any available register
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+      cur->regmap[hr]=reg;
+      cur->dirty&=~(1<<hr);
+      cur->isconst&=~(1<<hr);
+      return;
+    }
+  }
+  
+  // Ok, now we have to evict someone
+  // Pick a register we hopefully won't need soon
+  u_char hsn[MAXREG+1];
+  memset(hsn,10,sizeof(hsn));
+  int j;
+  lsn(hsn,i,&preferred_reg);
+  //DebugMessage(M64MSG_VERBOSE, "hsn(%x): %d %d %d %d %d %d %d",start+i*4,hsn[cur->regmap[0]&63],hsn[cur->regmap[1]&63],hsn[cur->regmap[2]&63],hsn[cur->regmap[3]&63],hsn[cur->regmap[5]&63],hsn[cur->regmap[6]&63],hsn[cur->regmap[7]&63]);
+  if(i>0) {
+    // Don't evict the cycle count at entry points, otherwise the entry
+    // stub will have to write it.
+    if(bt[i]&&hsn[CCREG]>2) hsn[CCREG]=2;
+    if(i>1&&hsn[CCREG]>2&&(itype[i-2]==RJUMP||itype[i-2]==UJUMP||itype[i-2]==CJUMP||itype[i-2]==SJUMP||itype[i-2]==FJUMP)) hsn[CCREG]=2;
+    for(j=10;j>=3;j--)
+    {
+      // Alloc preferred register if available
+      if(hsn[r=cur->regmap[preferred_reg]&63]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          // Evict both parts of a 64-bit register
+          if((cur->regmap[hr]&63)==r) {
+            cur->regmap[hr]=-1;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+          }
+        }
+        cur->regmap[preferred_reg]=reg;
+        return;
+      }
+      for(r=1;r<=MAXREG;r++)
+      {
+        if(hsn[r]==j&&r!=rs1[i-1]&&r!=rs2[i-1]&&r!=rt1[i-1]&&r!=rt2[i-1]) {
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r+64) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  for(j=10;j>=0;j--)
+  {
+    for(r=1;r<=MAXREG;r++)
+    {
+      if(hsn[r]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r+64) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+  DebugMessage(M64MSG_ERROR, "This shouldn't happen (alloc_reg)");exit(1);
+}
+
+static void alloc_reg64(struct regstat *cur,int i,signed char reg)
+{
+  int preferred_reg = 8+(reg&3);
+  int r,hr;
+  
+  // allocate the lower 32 bits
+  alloc_reg(cur,i,reg);
+  
+  // Don't allocate unused registers
+  if((cur->uu>>reg)&1) return;
+  
+  // see if the upper half is already allocated
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    if(cur->regmap[hr]==reg+64) return;
+  }
+  
+  // Keep the same mapping if the register was already allocated in a loop
+  preferred_reg = loop_reg(i,reg,preferred_reg);
+  
+  // Try to allocate the preferred register
+  if(cur->regmap[preferred_reg]==-1) {
+    cur->regmap[preferred_reg]=reg|64;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  r=cur->regmap[preferred_reg];
+  if(r<64&&((cur->u>>r)&1)) {
+    cur->regmap[preferred_reg]=reg|64;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  if(r>=64&&((cur->uu>>(r&63))&1)) {
+    cur->regmap[preferred_reg]=reg|64;
+    cur->dirty&=~(1<<preferred_reg);
+    cur->isconst&=~(1<<preferred_reg);
+    return;
+  }
+  
+  // Try to allocate R8-R11
+  for(hr=8;hr<12;hr++) {
+    if(cur->regmap[hr]==-1) {
+      cur->regmap[hr]=reg|64;
+      cur->dirty&=~(1<<hr);
+      cur->isconst&=~(1<<hr);
+      return;
+    }
+  }
+  
+  // Clear any unneeded registers
+  // We try to keep the mapping consistent, if possible, because it
+  // makes branches easier (especially loops).  So we try to allocate
+  // first (see above) before removing old mappings.  If this is not
+  // possible then go ahead and clear out the registers that are no
+  // longer needed.
+  for(hr=HOST_REGS-1;hr>=0;hr--)
+  {
+    r=cur->regmap[hr];
+    if(r>=0) {
+      if(r<64) {
+        if((cur->u>>r)&1) {cur->regmap[hr]=-1;break;}
+      }
+      else
+      {
+        if((cur->uu>>(r&63))&1) {cur->regmap[hr]=-1;break;}
+      }
+    }
+  }
+  // Try to allocate any available register, but prefer
+  // registers that have not been used recently.
+  if(i>0) {
+    for(hr=0;hr<HOST_REGS;hr++) {
+      if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+        if(regs[i-1].regmap[hr]!=rs1[i-1]&&regs[i-1].regmap[hr]!=rs2[i-1]&&regs[i-1].regmap[hr]!=rt1[i-1]&&regs[i-1].regmap[hr]!=rt2[i-1]) {
+          cur->regmap[hr]=reg|64;
+          cur->dirty&=~(1<<hr);
+          cur->isconst&=~(1<<hr);
+          return;
+        }
+      }
+    }
+  }
+  // Try to allocate any available register
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+      cur->regmap[hr]=reg|64;
+      cur->dirty&=~(1<<hr);
+      cur->isconst&=~(1<<hr);
+      return;
+    }
+  }
+  
+  // Ok, now we have to evict someone
+  // Pick a register we hopefully won't need soon
+  u_char hsn[MAXREG+1];
+  memset(hsn,10,sizeof(hsn));
+  int j;
+  lsn(hsn,i,&preferred_reg);
+  //DebugMessage(M64MSG_VERBOSE, "hsn(%x): %d %d %d %d %d %d %d",start+i*4,hsn[cur->regmap[0]&63],hsn[cur->regmap[1]&63],hsn[cur->regmap[2]&63],hsn[cur->regmap[3]&63],hsn[cur->regmap[5]&63],hsn[cur->regmap[6]&63],hsn[cur->regmap[7]&63]);
+  if(i>0) {
+    // Don't evict the cycle count at entry points, otherwise the entry
+    // stub will have to write it.
+    if(bt[i]&&hsn[CCREG]>2) hsn[CCREG]=2;
+    if(i>1&&hsn[CCREG]>2&&(itype[i-2]==RJUMP||itype[i-2]==UJUMP||itype[i-2]==CJUMP||itype[i-2]==SJUMP||itype[i-2]==FJUMP)) hsn[CCREG]=2;
+    for(j=10;j>=3;j--)
+    {
+      // Alloc preferred register if available
+      if(hsn[r=cur->regmap[preferred_reg]&63]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          // Evict both parts of a 64-bit register
+          if((cur->regmap[hr]&63)==r) {
+            cur->regmap[hr]=-1;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+          }
+        }
+        cur->regmap[preferred_reg]=reg|64;
+        return;
+      }
+      for(r=1;r<=MAXREG;r++)
+      {
+        if(hsn[r]==j&&r!=rs1[i-1]&&r!=rs2[i-1]&&r!=rt1[i-1]&&r!=rt2[i-1]) {
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r+64) {
+                cur->regmap[hr]=reg|64;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||j<hsn[CCREG]) {
+              if(cur->regmap[hr]==r) {
+                cur->regmap[hr]=reg|64;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  for(j=10;j>=0;j--)
+  {
+    for(r=1;r<=MAXREG;r++)
+    {
+      if(hsn[r]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r+64) {
+            cur->regmap[hr]=reg|64;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r) {
+            cur->regmap[hr]=reg|64;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+  DebugMessage(M64MSG_ERROR, "This shouldn't happen");exit(1);
+}
+
+// Allocate a temporary register.  This is done without regard to
+// dirty status or whether the register we request is on the unneeded list
+// Note: This will only allocate one register, even if called multiple times
+static void alloc_reg_temp(struct regstat *cur,int i,signed char reg)
+{
+  int r,hr;
+  int preferred_reg = -1;
+  
+  // see if it's already allocated
+  for(hr=0;hr<HOST_REGS;hr++)
+  {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==reg) return;
+  }
+  
+  // Try to allocate any available register, starting with R13, R12, R11...
+  for(hr=HOST_REGS-1;hr>=0;hr--) {
+    if(hr!=EXCLUDE_REG&&cur->regmap[hr]==-1) {
+      cur->regmap[hr]=reg;
+      cur->dirty&=~(1<<hr);
+      cur->isconst&=~(1<<hr);
+      return;
+    }
+  }
+  
+  // Find an unneeded register
+  for(hr=HOST_REGS-1;hr>=0;hr--)
+  {
+    r=cur->regmap[hr];
+    if(r>=0) {
+      if(r<64) {
+        if((cur->u>>r)&1) {
+          if(i==0||((unneeded_reg[i-1]>>r)&1)) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+      else
+      {
+        if((cur->uu>>(r&63))&1) {
+          if(i==0||((unneeded_reg_upper[i-1]>>(r&63))&1)) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+  
+  // Ok, now we have to evict someone
+  // Pick a register we hopefully won't need soon
+  // TODO: we might want to follow unconditional jumps here
+  // TODO: get rid of dupe code and make this into a function
+  u_char hsn[MAXREG+1];
+  memset(hsn,10,sizeof(hsn));
+  int j;
+  lsn(hsn,i,&preferred_reg);
+  //DebugMessage(M64MSG_VERBOSE, "hsn: %d %d %d %d %d %d %d",hsn[cur->regmap[0]&63],hsn[cur->regmap[1]&63],hsn[cur->regmap[2]&63],hsn[cur->regmap[3]&63],hsn[cur->regmap[5]&63],hsn[cur->regmap[6]&63],hsn[cur->regmap[7]&63]);
+  if(i>0) {
+    // Don't evict the cycle count at entry points, otherwise the entry
+    // stub will have to write it.
+    if(bt[i]&&hsn[CCREG]>2) hsn[CCREG]=2;
+    if(i>1&&hsn[CCREG]>2&&(itype[i-2]==RJUMP||itype[i-2]==UJUMP||itype[i-2]==CJUMP||itype[i-2]==SJUMP||itype[i-2]==FJUMP)) hsn[CCREG]=2;
+    for(j=10;j>=3;j--)
+    {
+      for(r=1;r<=MAXREG;r++)
+      {
+        if(hsn[r]==j&&r!=rs1[i-1]&&r!=rs2[i-1]&&r!=rt1[i-1]&&r!=rt2[i-1]) {
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||hsn[CCREG]>2) {
+              if(cur->regmap[hr]==r+64) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+          for(hr=0;hr<HOST_REGS;hr++) {
+            if(hr!=HOST_CCREG||hsn[CCREG]>2) {
+              if(cur->regmap[hr]==r) {
+                cur->regmap[hr]=reg;
+                cur->dirty&=~(1<<hr);
+                cur->isconst&=~(1<<hr);
+                return;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  for(j=10;j>=0;j--)
+  {
+    for(r=1;r<=MAXREG;r++)
+    {
+      if(hsn[r]==j) {
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r+64) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+        for(hr=0;hr<HOST_REGS;hr++) {
+          if(cur->regmap[hr]==r) {
+            cur->regmap[hr]=reg;
+            cur->dirty&=~(1<<hr);
+            cur->isconst&=~(1<<hr);
+            return;
+          }
+        }
+      }
+    }
+  }
+  DebugMessage(M64MSG_ERROR, "This shouldn't happen");exit(1);
+}
+// Allocate a specific x86 register.
+static void alloc_x86_reg(struct regstat *cur,int i,signed char reg,int hr)
+{
+  int n;
+  int dirty=0;
+  
+  // see if it's already allocated (and dealloc it)
+  for(n=0;n<HOST_REGS;n++)
+  {
+    if(n!=ESP&&cur->regmap[n]==reg) {
+      dirty=(cur->dirty>>n)&1;
+      cur->regmap[n]=-1;
+    }
+  }
+  
+  cur->regmap[hr]=reg;
+  cur->dirty&=~(1<<hr);
+  cur->dirty|=dirty<<hr;
+  cur->isconst&=~(1<<hr);
+}
+
+// Alloc cycle count into dedicated register
+static void alloc_cc(struct regstat *cur,int i)
+{
+  alloc_x86_reg(cur,i,CCREG,HOST_CCREG);
+}
+
+/* Special alloc */
+
+static void multdiv_alloc_x64(struct regstat *current,int i)
+{
+  //  case 0x18: MULT
+  //  case 0x19: MULTU
+  //  case 0x1A: DIV
+  //  case 0x1B: DIVU
+  //  case 0x1C: DMULT
+  //  case 0x1D: DMULTU
+  //  case 0x1E: DDIV
+  //  case 0x1F: DDIVU
+  clear_const(current,rs1[i]);
+  clear_const(current,rs2[i]);
+  if(rs1[i]&&rs2[i])
+  {
+    if((opcode2[i]&4)==0) // 32-bit
+    {
+      current->u&=~(1LL<<HIREG);
+      current->u&=~(1LL<<LOREG);
+      alloc_x86_reg(current,i,HIREG,EDX);
+      alloc_x86_reg(current,i,LOREG,EAX);
+      alloc_reg(current,i,rs1[i]);
+      alloc_reg(current,i,rs2[i]);
+      current->is32|=1LL<<HIREG;
+      current->is32|=1LL<<LOREG;
+      dirty_reg(current,HIREG);
+      dirty_reg(current,LOREG);
+    }
+    else // 64-bit
+    {
+      current->u&=~(1LL<<HIREG);
+      current->u&=~(1LL<<LOREG);
+      current->uu&=~(1LL<<HIREG);
+      current->uu&=~(1LL<<LOREG);
+      alloc_x86_reg(current,i,HIREG|64,EDX);
+      alloc_x86_reg(current,i,HIREG,EAX);
+      alloc_reg64(current,i,rs1[i]);
+      alloc_reg64(current,i,rs2[i]);
+      alloc_all(current,i);
+      current->is32&=~(1LL<<HIREG);
+      current->is32&=~(1LL<<LOREG);
+      dirty_reg(current,HIREG);
+      dirty_reg(current,LOREG);
+      minimum_free_regs[i]=HOST_REGS;
+    }
+  }
+  else
+  {
+    // Multiply by zero is zero.
+    // MIPS does not have a divide by zero exception.
+    // The result is undefined, we return zero.
+    alloc_reg(current,i,HIREG);
+    alloc_reg(current,i,LOREG);
+    current->is32|=1LL<<HIREG;
+    current->is32|=1LL<<LOREG;
+    dirty_reg(current,HIREG);
+    dirty_reg(current,LOREG);
+  }
+}
+#define multdiv_alloc multdiv_alloc_x64
+
+/* Assembler */
+
+static const char regname[16][5] = {
+ "eax",
+ "ecx",
+ "edx",
+ "ebx",
+ "esp",
+ "ebp",
+ "esi",
+ "edi",
+ "r8d",
+ "r9d",
+ "r10d",
+ "r11d",
+ "r12d",
+ "r13d",
+ "r14d",
+ "r15d"};
+
+static void output_byte(u_char byte)
+{
+  *(out++)=byte;
+}
+// The REX prefix is omitted when it would be 0x40, unless force is set
+// (needed to address %spl/%bpl/%sil/%dil as byte registers)
+static void output_rex(u_char w,u_char r,u_char x,u_char b,int force)
+{
+  u_char byte=0x40|(w<<3)|((r&8)>>1)|((x&8)>>2)|((b&8)>>3);
+  if(byte!=0x40||force) *(out++)=byte;
+}
+static void output_modrm(u_char mod,u_char rm,u_char ext)
+{
+  assert(mod<4);
+  assert(rm<16);
+  assert(ext<16);
+  u_char byte=(mod<<6)|((ext&7)<<3)|(rm&7);
+  *(out++)=byte;
+}
+static void output_sib(u_char scale,u_char index,u_char base)
+{
+  assert(scale<4);
+  assert(index<16);
+  assert(base<16);
+  u_char byte=(scale<<6)|((index&7)<<3)|(base&7);
+  *(out++)=byte;
+}
+static void output_w32(u_int word)
+{
+  *((u_int *)out)=word;
+  out+=4;
+}
+static void output_w64(uint64_t dword)
+{
+  *((uint64_t *)out)=dword;
+  out+=8;
+}
+
+// ModRM, SIB and displacement for disp(base,index,1<<scale).
+// base==RIP makes disp an absolute address, addressed relative to the
+// end of the instruction, which has tail more bytes of immediate data.
+// base<0 means no base register.
+static void output_mem(int r,int base,int index,int scale,intptr_t disp,int tail)
+{
+  int mod;
+  if(base==RIP) {
+    assert(index<0);
+    disp-=(intptr_t)out+4+tail;
+    assert(disp==(int)disp);
+    output_modrm(0,5,r);
+    output_w32(disp);
+    return;
+  }
+  assert(index!=ESP);
+  assert(disp==(int)disp);
+  if(base<0) {
+    output_modrm(0,4,r);
+    output_sib(scale,index<0?4:index,5);
+    output_w32(disp);
+    return;
+  }
+  if(disp==0&&(base&7)!=5) mod=0;
+  else if(disp<128&&disp>=-128) mod=1;
+  else mod=2;
+  if(index>=0||(base&7)==4) {
+    output_modrm(mod,4,r);
+    output_sib(scale,index<0?4:index,base);
+  }
+  else
+    output_modrm(mod,base,r);
+  if(mod==1) output_byte(disp);
+  if(mod==2) output_w32(disp);
+}
+// Prefix, REX, opcode (one byte, or two bytes with 0x0F first) and operand
+static void output_mem_op(u_char prefix,int w,int op,int r,int base,int index,int scale,intptr_t disp,int tail,int force)
+{
+  if(prefix) output_byte(prefix);
+  output_rex(w,r,index<0?0:index,base<0?0:base,force);
+  if(op>0xFF) output_byte(op>>8);
+  output_byte(op);
+  output_mem(r,base,index,scale,disp,tail);
+}
+// Register to register form
+static void output_rr(int w,int op,int rm,int r)
+{
+  output_rex(w,r,0,rm,0);
+  if(op>0xFF) output_byte(op>>8);
+  output_byte(op);
+  output_modrm(3,rm,r);
+}
+// Group 1 arithmetic with an immediate (add/or/adc/sbb/and/sub/xor/cmp)
+static void output_imm_op(int w,int ext,int rm,int imm)
+{
+  output_rex(w,0,0,rm,0);
+  if(imm<128&&imm>=-128) {
+    output_byte(0x83);
+    output_modrm(3,rm,ext);
+    output_byte(imm);
+  }
+  else
+  {
+    output_byte(0x81);
+    output_modrm(3,rm,ext);
+    output_w32(imm);
+  }
+}
+// Shift group with an immediate count
+static void output_shift_op(int w,int ext,int rm,u_int imm)
+{
+  assert(imm>0);
+  output_rex(w,0,0,rm,0);
+  if(imm==1) output_byte(0xD1);
+  else output_byte(0xC1);
+  output_modrm(3,rm,ext);
+  if(imm>1) output_byte(imm);
+}
+
+static void emit_movimm64(uint64_t imm,u_int rt)
+{
+  assem_debug("movabs $%llx,%%%s",(unsigned long long)imm,regname[rt]);
+  output_rex(1,0,0,rt,0);
+  output_byte(0xB8+(rt&7));
+  output_w64(imm);
+}
+
+// Operand at a fixed host address.  Everything the code generator
+// touches normally lies within reach of the translation cache, but if
+// it doesn't, the address goes through the scratch register.
+static void output_abs_op(u_char prefix,int w,int op,int r,intptr_t addr,int tail,int force)
+{
+  intptr_t rel=addr-(intptr_t)out;
+  if(rel<0x7FFFFF00&&rel>-0x7FFFFF00)
+    output_mem_op(prefix,w,op,r,RIP,-1,0,addr,tail,force);
+  else
+  {
+    emit_movimm64(addr,HOST_SCRATCH);
+    output_mem_op(prefix,w,op,r,HOST_SCRATCH,-1,0,0,tail,force);
+  }
+}
+// Operand at addr+rs, with addr possibly a full 64-bit host address.
+// Addresses relative to RDRAM are reached through HOST_RAM_REG.
+static void output_indexed_op(u_char prefix,int w,int op,int r,intptr_t addr,int rs,int tail,int force)
+{
+  intptr_t ram=addr-((intptr_t)g_rdram-0x80000000);
+  if(addr==(int)addr)
+    output_mem_op(prefix,w,op,r,rs,-1,0,addr,tail,force);
+  else if(ram==(int)ram)
+    output_mem_op(prefix,w,op,r,HOST_RAM_REG,rs,0,ram,tail,force);
+  else
+  {
+    emit_movimm64(addr,HOST_SCRATCH);
+    output_mem_op(prefix,w,op,r,HOST_SCRATCH,rs,0,0,tail,force);
+  }
+}
+// Operand at a constant guest address, through the TLB when map>=0
+static void output_tlb_op(u_char prefix,int op,int r,int addr,int map,int force)
+{
+  if(map<0) output_abs_op(prefix,0,op,r,(intptr_t)g_rdram+(u_int)(addr-0x80000000),0,force);
+  else
+  {
+    output_rex(0,0,0,HOST_SCRATCH,0);
+    output_byte(0xB8+(HOST_SCRATCH&7));
+    output_w32(addr);
+    output_mem_op(prefix,0,op,r,HOST_SCRATCH,map,2,0,0,force);
+  }
+}
+// Operand at addr+rs, through the TLB when map>=0
+static void output_indexed_tlb_op(u_char prefix,int op,int r,int addr,int rs,int map,int scale,int force)
+{
+  if(map<0) output_mem_op(prefix,0,op,r,HOST_RAM_REG,rs,0,addr,0,force);
+  else output_mem_op(prefix,0,op,r,rs,map,scale,addr,0,force);
+}
+
+static void emit_mov(int rs,int rt)
+{
+  assem_debug("mov %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x89,rt,rs);
+}
+
+static void emit_mov64(int rs,int rt)
+{
+  assem_debug("mov %%%s,%%%s (64)",regname[rs],regname[rt]);
+  output_rr(1,0x89,rt,rs);
+}
+
+static void emit_add(int rs1,int rs2,int rt)
+{
+  if(rs1==rt) {
+    assem_debug("add %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rr(0,0x01,rs1,rs2);
+  }else if(rs2==rt) {
+    assem_debug("add %%%s,%%%s",regname[rs1],regname[rs2]);
+    output_rr(0,0x01,rs2,rs1);
+  }else {
+    emit_mov(rs1,rt);
+    assem_debug("add %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rr(0,0x01,rt,rs2);
+  }
+}
+
+static void emit_adc(int rs1,int rs2,int rt)
+{
+  if(rs1==rt) {
+    assem_debug("adc %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rr(0,0x11,rs1,rs2);
+  }else if(rs2==rt) {
+    assem_debug("adc %%%s,%%%s",regname[rs1],regname[rs2]);
+    output_rr(0,0x11,rs2,rs1);
+  }else {
+    emit_mov(rs1,rt);
+    assem_debug("adc %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rr(0,0x11,rt,rs2);
+  }
+}
+
+static void emit_adds(int rs1,int rs2,int rt)
+{
+  emit_add(rs1,rs2,rt);
+}
+
+static void emit_lea8(int rs1,int rt)
+{
+  assem_debug("lea 0(%%%s,8),%%%s",regname[rs1],regname[rt]);
+  output_mem_op(0,0,0x8D,rt,-1,rs1,3,0,0,0);
+}
+
+static void emit_neg(int rs, int rt)
+{
+  if(rs!=rt) emit_mov(rs,rt);
+  assem_debug("neg %%%s",regname[rt]);
+  output_rex(0,0,0,rt,0);
+  output_byte(0xF7);
+  output_modrm(3,rt,3);
+}
+
+static void emit_negs(int rs, int rt)
+{
+  emit_neg(rs,rt);
+}
+
+static void emit_sub(int rs1,int rs2,int rt)
+{
+  if(rs1==rt) {
+    assem_debug("sub %%%s,%%%s",regname[rs2],regname[rs1]);
+    output_rr(0,0x29,rs1,rs2);
+  } else if(rs2==rt) {
+    emit_neg(rs2,rs2);
+    emit_add(rs2,rs1,rs2);
+  } else {
+    emit_mov(rs1,rt);
+    emit_sub(rt,rs2,rt);
+  }
+}
+
+static void emit_subs(int rs1,int rs2,int rt)
+{
+  emit_sub(rs1,rs2,rt);
+}
+
+static void emit_zeroreg(int rt)
+{
+  assem_debug("xor %%%s,%%%s",regname[rt],regname[rt]);
+  output_rr(0,0x31,rt,rt);
+}
+
+static void emit_loadreg(int r, int hr)
+{
+  if((r&63)==0)
+    emit_zeroreg(hr);
+  else {
+    intptr_t addr=((intptr_t)reg)+((r&63)<<3)+((r&64)>>4);
+    if((r&63)==HIREG) addr=(intptr_t)&hi+((r&64)>>4);
+    if((r&63)==LOREG) addr=(intptr_t)&lo+((r&64)>>4);
+    if(r==CCREG) addr=(intptr_t)&cycle_count;
+    if(r==CSREG) addr=(intptr_t)&g_cp0_regs[CP0_STATUS_REG];
+    if(r==FSREG) addr=(intptr_t)&FCR31;
+    assem_debug("mov %llx+%d,%%%s",(long long)addr,r,regname[hr]);
+    output_abs_op(0,0,0x8B,hr,addr,0,0);
+  }
+}
+static void emit_storereg(int r, int hr)
+{
+  intptr_t addr=((intptr_t)reg)+((r&63)<<3)+((r&64)>>4);
+  if((r&63)==HIREG) addr=(intptr_t)&hi+((r&64)>>4);
+  if((r&63)==LOREG) addr=(intptr_t)&lo+((r&64)>>4);
+  if(r==CCREG) addr=(intptr_t)&cycle_count;
+  if(r==FSREG) addr=(intptr_t)&FCR31;
+  assem_debug("mov %%%s,%llx+%d",regname[hr],(long long)addr,r);
+  output_abs_op(0,0,0x89,hr,addr,0,0);
+}
+
+static void emit_test(int rs, int rt)
+{
+  assem_debug("test %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x85,rs,rt);
+}
+
+static void emit_test64(int rs, int rt)
+{
+  assem_debug("test %%%s,%%%s (64)",regname[rs],regname[rt]);
+  output_rr(1,0x85,rs,rt);
+}
+
+static void emit_testimm(int rs,int imm)
+{
+  assem_debug("test $0x%x,%%%s",imm,regname[rs]);
+  if(imm<128&&imm>=-128&&rs<4) {
+    output_byte(0xF6);
+    output_modrm(3,rs,0);
+    output_byte(imm);
+  }
+  else
+  {
+    output_rex(0,0,0,rs,0);
+    output_byte(0xF7);
+    output_modrm(3,rs,0);
+    output_w32(imm);
+  }
+}
+
+static void emit_not(int rs,int rt)
+{
+  if(rs!=rt) emit_mov(rs,rt);
+  assem_debug("not %%%s",regname[rt]);
+  output_rex(0,0,0,rt,0);
+  output_byte(0xF7);
+  output_modrm(3,rt,2);
+}
+
+static void emit_and(u_int rs1,u_int rs2,u_int rt)
+{
+  assert(rs1<16);
+  assert(rs2<16);
+  assert(rt<16);
+  if(rs1==rt) {
+    assem_debug("and %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rr(0,0x21,rs1,rs2);
+  }
+  else
+  if(rs2==rt) {
+    assem_debug("and %%%s,%%%s",regname[rs1],regname[rt]);
+    output_rr(0,0x21,rs2,rs1);
+  }
+  else {
+    emit_mov(rs1,rt);
+    emit_and(rt,rs2,rt);
+  }
+}
+
+static void emit_or(u_int rs1,u_int rs2,u_int rt)
+{
+  assert(rs1<16);
+  assert(rs2<16);
+  assert(rt<16);
+  if(rs1==rt) {
+    assem_debug("or %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rr(0,0x09,rs1,rs2);
+  }
+  else
+  if(rs2==rt) {
+    assem_debug("or %%%s,%%%s",regname[rs1],regname[rt]);
+    output_rr(0,0x09,rs2,rs1);
+  }
+  else {
+    emit_mov(rs1,rt);
+    emit_or(rt,rs2,rt);
+  }
+}
+static void emit_or_and_set_flags(int rs1,int rs2,int rt)
+{
+  emit_or(rs1,rs2,rt);
+}
+
+static void emit_xor(u_int rs1,u_int rs2,u_int rt)
+{
+  assert(rs1<16);
+  assert(rs2<16);
+  assert(rt<16);
+  if(rs1==rt) {
+    assem_debug("xor %%%s,%%%s",regname[rs2],regname[rt]);
+    output_rr(0,0x31,rs1,rs2);
+  }
+  else
+  if(rs2==rt) {
+    assem_debug("xor %%%s,%%%s",regname[rs1],regname[rt]);
+    output_rr(0,0x31,rs2,rs1);
+  }
+  else {
+    emit_mov(rs1,rt);
+    emit_xor(rt,rs2,rt);
+  }
+}
+
+// Writing a 32-bit register clears the upper half, so guest values
+// are always kept zero-extended in the host registers
+static void emit_movimm(int imm,u_int rt)
+{
+  assem_debug("mov $%d,%%%s",imm,regname[rt]);
+  assert(rt<16);
+  output_rex(0,0,0,rt,0);
+  output_byte(0xB8+(rt&7));
+  output_w32(imm);
+}
+
+// Load the address of a host variable
+static void emit_loadaddr(intptr_t addr,int rt)
+{
+  intptr_t rel=addr-(intptr_t)out;
+  if(rel<0x7FFFFF00&&rel>-0x7FFFFF00) {
+    assem_debug("lea %llx(%%rip),%%%s",(long long)addr,regname[rt]);
+    output_mem_op(0,1,0x8D,rt,RIP,-1,0,addr,0,0);
+  }
+  else
+    emit_movimm64(addr,rt);
+}
+
+static void emit_addimm(int rs,int imm,int rt)
+{
+  if(rs==rt) {
+    if(imm!=0) {
+      assem_debug("add $%d,%%%s",imm,regname[rt]);
+      output_imm_op(0,0,rt,imm);
+    }
+  }
+  else {
+    if(imm!=0) {
+      assem_debug("lea %d(%%%s),%%%s",imm,regname[rs],regname[rt]);
+      output_mem_op(0,0,0x8D,rt,rs,-1,0,imm,0,0);
+    }else{
+      emit_mov(rs,rt);
+    }
+  }
+}
+
+// 64-bit add, for %rsp and host addresses
+static void emit_addimm64(int rs,int imm,int rt)
+{
+  if(rs==rt) {
+    if(imm!=0) {
+      assem_debug("add $%d,%%%s (64)",imm,regname[rt]);
+      output_imm_op(1,0,rt,imm);
+    }
+  }
+  else {
+    assem_debug("lea %d(%%%s),%%%s (64)",imm,regname[rs],regname[rt]);
+    output_mem_op(0,1,0x8D,rt,rs,-1,0,imm,0,0);
+  }
+}
+
+static void emit_addimm_and_set_flags(int imm,int rt)
+{
+  assem_debug("add $%d,%%%s",imm,regname[rt]);
+  output_imm_op(0,0,rt,imm);
+}
+static void emit_addimm_no_flags(int imm,int rt)
+{
+  if(imm!=0) {
+    assem_debug("lea %d(%%%s),%%%s",imm,regname[rt],regname[rt]);
+    output_mem_op(0,0,0x8D,rt,rt,-1,0,imm,0,0);
+  }
+}
+
+static void emit_adcimm(int imm,u_int rt)
+{
+  assem_debug("adc $%d,%%%s",imm,regname[rt]);
+  assert(rt<16);
+  output_imm_op(0,2,rt,imm);
+}
+static void emit_sbbimm(int imm,u_int rt)
+{
+  assem_debug("sbb $%d,%%%s",imm,regname[rt]);
+  assert(rt<16);
+  output_imm_op(0,3,rt,imm);
+}
+
+static void emit_addimm64_32(int rsh,int rsl,int imm,int rth,int rtl)
+{
+  if(rsh==rth&&rsl==rtl) {
+    assem_debug("add $%d,%%%s",imm,regname[rtl]);
+    output_imm_op(0,0,rtl,imm);
+    assem_debug("adc $%d,%%%s",imm>>31,regname[rth]);
+    output_imm_op(0,2,rth,imm>>31);
+  }
+  else {
+    emit_mov(rsh,rth);
+    emit_mov(rsl,rtl);
+    emit_addimm64_32(rth,rtl,imm,rth,rtl);
+  }
+}
+
+static void emit_sub64_32(int rs1l,int rs1h,int rs2l,int rs2h,int rtl,int rth)
+{
+  if((rs1l==rtl)&&(rs1h==rth)) {
+    assem_debug("sub %%%s,%%%s",regname[rs2l],regname[rs1l]);
+    output_rr(0,0x29,rs1l,rs2l);
+    assem_debug("sbb %%%s,%%%s",regname[rs2h],regname[rs1h]);
+    output_rr(0,0x19,rs1h,rs2h);
+  } else if((rs2l==rtl)&&(rs2h==rth)) {
+    emit_neg(rs2l,rs2l);
+    emit_adcimm(-1,rs2h);
+    assem_debug("add %%%s,%%%s",regname[rs1l],regname[rs2l]);
+    output_rr(0,0x01,rs2l,rs1l);
+    emit_not(rs2h,rs2h);
+    assem_debug("adc %%%s,%%%s",regname[rs1h],regname[rs2h]);
+    output_rr(0,0x11,rs2h,rs1h);
+  } else {
+    emit_mov(rs1l,rtl);
+    assem_debug("sub %%%s,%%%s",regname[rs2l],regname[rtl]);
+    output_rr(0,0x29,rtl,rs2l);
+    emit_mov(rs1h,rth);
+    assem_debug("sbb %%%s,%%%s",regname[rs2h],regname[rth]);
+    output_rr(0,0x19,rth,rs2h);
+  }
+}
+
+static void emit_sbb(int rs1,int rs2)
+{
+  assem_debug("sbb %%%s,%%%s",regname[rs1],regname[rs2]);
+  output_rr(0,0x19,rs2,rs1);
+}
+
+// A negative mask is applied to all 64 bits, so that it also
+// works on host addresses (see storelr_assemble)
+static void emit_andimm(int rs,int imm,int rt)
+{
+  if(imm==0) {
+    emit_zeroreg(rt);
+  }
+  else if(rs==rt) {
+    assem_debug("and $%d,%%%s",imm,regname[rt]);
+    output_imm_op(imm<0,4,rt,imm);
+  }
+  else {
+    if(imm<0) emit_mov64(rs,rt);
+    else emit_mov(rs,rt);
+    emit_andimm(rt,imm,rt);
+  }
+}
+
+static void emit_orimm(int rs,int imm,int rt)
+{
+  if(rs==rt) {
+    if(imm!=0) {
+      assem_debug("or $%d,%%%s",imm,regname[rt]);
+      output_imm_op(0,1,rt,imm);
+    }
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_orimm(rt,imm,rt);
+  }
+}
+
+static void emit_xorimm(int rs,int imm,int rt)
+{
+  if(rs==rt) {
+    if(imm!=0) {
+      assem_debug("xor $%d,%%%s",imm,regname[rt]);
+      output_imm_op(0,6,rt,imm);
+    }
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_xorimm(rt,imm,rt);
+  }
+}
+
+static void emit_shlimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shl %%%s,%d",regname[rt],imm);
+    output_shift_op(0,4,rt,imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shlimm(rt,imm,rt);
+  }
+}
+
+static void emit_shrimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shr %%%s,%d",regname[rt],imm);
+    output_shift_op(0,5,rt,imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shrimm(rt,imm,rt);
+  }
+}
+
+static void emit_sarimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("sar %%%s,%d",regname[rt],imm);
+    output_shift_op(0,7,rt,imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_sarimm(rt,imm,rt);
+  }
+}
+
+static void emit_rorimm(int rs,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("ror %%%s,%d",regname[rt],imm);
+    output_shift_op(0,1,rt,imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_rorimm(rt,imm,rt);
+  }
+}
+
+static void emit_shldimm(int rs,int rs2,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shld %%%s,%%%s,%d",regname[rt],regname[rs2],imm);
+    assert(imm>0);
+    output_rr(0,0x0FA4,rt,rs2);
+    output_byte(imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shldimm(rt,rs2,imm,rt);
+  }
+}
+
+static void emit_shrdimm(int rs,int rs2,u_int imm,int rt)
+{
+  if(rs==rt) {
+    assem_debug("shrd %%%s,%%%s,%d",regname[rt],regname[rs2],imm);
+    assert(imm>0);
+    output_rr(0,0x0FAC,rt,rs2);
+    output_byte(imm);
+  }
+  else {
+    emit_mov(rs,rt);
+    emit_shrdimm(rt,rs2,imm,rt);
+  }
+}
+
+static void emit_shlcl(int r)
+{
+  assem_debug("shl %%%s,%%cl",regname[r]);
+  output_rex(0,0,0,r,0);
+  output_byte(0xD3);
+  output_modrm(3,r,4);
+}
+static void emit_shrcl(int r)
+{
+  assem_debug("shr %%%s,%%cl",regname[r]);
+  output_rex(0,0,0,r,0);
+  output_byte(0xD3);
+  output_modrm(3,r,5);
+}
+static void emit_sarcl(int r)
+{
+  assem_debug("sar %%%s,%%cl",regname[r]);
+  output_rex(0,0,0,r,0);
+  output_byte(0xD3);
+  output_modrm(3,r,7);
+}
+
+static void emit_shldcl(int r1,int r2)
+{
+  assem_debug("shld %%%s,%%%s,%%cl",regname[r1],regname[r2]);
+  output_rr(0,0x0FA5,r1,r2);
+}
+static void emit_shrdcl(int r1,int r2)
+{
+  assem_debug("shrd %%%s,%%%s,%%cl",regname[r1],regname[r2]);
+  output_rr(0,0x0FAD,r1,r2);
+}
+
+static void emit_cmpimm(int rs,int imm)
+{
+  assem_debug("cmp $%d,%%%s",imm,regname[rs]);
+  output_imm_op(0,7,rs,imm);
+}
+
+static void emit_cmovne(const u_int *addr,int rt)
+{
+  assem_debug("cmovne %llx,%%%s",(long long)(intptr_t)addr,regname[rt]);
+  if(addr==&const_zero) assem_debug(" [zero]");
+  else if(addr==&const_one) assem_debug(" [one]");
+  else assem_debug("");
+  output_abs_op(0,0,0x0F45,rt,(intptr_t)addr,0,0);
+}
+static void emit_cmovl(const u_int *addr,int rt)
+{
+  assem_debug("cmovl %llx,%%%s",(long long)(intptr_t)addr,regname[rt]);
+  if(addr==&const_zero) assem_debug(" [zero]");
+  else if(addr==&const_one) assem_debug(" [one]");
+  else assem_debug("");
+  output_abs_op(0,0,0x0F4C,rt,(intptr_t)addr,0,0);
+}
+static void emit_cmovs(const u_int *addr,int rt)
+{
+  assem_debug("cmovs %llx,%%%s",(long long)(intptr_t)addr,regname[rt]);
+  if(addr==&const_zero) assem_debug(" [zero]");
+  else if(addr==&const_one) assem_debug(" [one]");
+  else assem_debug("");
+  output_abs_op(0,0,0x0F48,rt,(intptr_t)addr,0,0);
+}
+static void emit_cmovne_reg(int rs,int rt)
+{
+  assem_debug("cmovne %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x0F45,rs,rt);
+}
+static void emit_cmovl_reg(int rs,int rt)
+{
+  assem_debug("cmovl %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x0F4C,rs,rt);
+}
+static void emit_cmovs_reg(int rs,int rt)
+{
+  assem_debug("cmovs %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x0F48,rs,rt);
+}
+static void emit_cmovnc_reg(int rs,int rt)
+{
+  assem_debug("cmovae %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x0F43,rs,rt);
+}
+static void emit_cmova_reg(int rs,int rt)
+{
+  assem_debug("cmova %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x0F47,rs,rt);
+}
+static void emit_cmovp_reg(int rs,int rt)
+{
+  assem_debug("cmovp %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x0F4A,rs,rt);
+}
+static void emit_cmovnp_reg(int rs,int rt)
+{
+  assem_debug("cmovnp %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x0F4B,rs,rt);
+}
+static void emit_setl(int rt)
+{
+  assem_debug("setl %%%s",regname[rt]);
+  output_rex(0,0,0,rt,rt>=4);
+  output_byte(0x0F);
+  output_byte(0x9C);
+  output_modrm(3,rt,2);
+}
+static void emit_movzbl_reg(int rs, int rt)
+{
+  assem_debug("movzbl %%%s,%%%s",regname[rs]+1,regname[rt]);
+  output_rex(0,rt,0,rs,rs>=4);
+  output_byte(0x0F);
+  output_byte(0xB6);
+  output_modrm(3,rs,rt);
+}
+
+// Every register has a byte form with REX, so setl can always be used
+static void emit_slti32(int rs,int imm,int rt)
+{
+  if(rs!=rt) emit_zeroreg(rt);
+  emit_cmpimm(rs,imm);
+  emit_setl(rt);
+  if(rs==rt) emit_movzbl_reg(rt,rt);
+}
+static void emit_sltiu32(int rs,int imm,int rt)
+{
+  if(rs!=rt) emit_zeroreg(rt);
+  emit_cmpimm(rs,imm);
+  if(rs==rt) emit_movimm(0,rt);
+  emit_adcimm(0,rt);
+}
+static void emit_slti64_32(int rsh,int rsl,int imm,int rt)
+{
+  assert(rsh!=rt);
+  emit_slti32(rsl,imm,rt);
+  if(imm>=0)
+  {
+    emit_test(rsh,rsh);
+    emit_cmovne(&const_zero,rt);
+    emit_cmovs(&const_one,rt);
+  }
+  else
+  {
+    emit_cmpimm(rsh,-1);
+    emit_cmovne(&const_zero,rt);
+    emit_cmovl(&const_one,rt);
+  }
+}
+static void emit_sltiu64_32(int rsh,int rsl,int imm,int rt)
+{
+  assert(rsh!=rt);
+  emit_sltiu32(rsl,imm,rt);
+  if(imm>=0)
+  {
+    emit_test(rsh,rsh);
+    emit_cmovne(&const_zero,rt);
+  }
+  else
+  {
+    emit_cmpimm(rsh,-1);
+    emit_cmovne(&const_one,rt);
+  }
+}
+
+static void emit_cmp(int rs,int rt)
+{
+  assem_debug("cmp %%%s,%%%s",regname[rt],regname[rs]);
+  output_rr(0,0x39,rs,rt);
+}
+static void emit_set_gz32(int rs, int rt)
+{
+  //assem_debug("set_gz32");
+  emit_cmpimm(rs,1);
+  emit_movimm(1,rt);
+  emit_cmovl(&const_zero,rt);
+}
+static void emit_set_nz32(int rs, int rt)
+{
+  //assem_debug("set_nz32");
+  emit_cmpimm(rs,1);
+  emit_movimm(1,rt);
+  emit_sbbimm(0,rt);
+}
+static void emit_set_gz64_32(int rsh, int rsl, int rt)
+{
+  //assem_debug("set_gz64");
+  emit_set_gz32(rsl,rt);
+  emit_test(rsh,rsh);
+  emit_cmovne(&const_one,rt);
+  emit_cmovs(&const_zero,rt);
+}
+static void emit_set_nz64_32(int rsh, int rsl, int rt)
+{
+  //assem_debug("set_nz64");
+  emit_or_and_set_flags(rsh,rsl,rt);
+  emit_cmovne(&const_one,rt);
+}
+static void emit_set_if_less32(int rs1, int rs2, int rt)
+{
+  //assem_debug("set if less (%%%s,%%%s),%%%s",regname[rs1],regname[rs2],regname[rt]);
+  if(rs1!=rt&&rs2!=rt) emit_zeroreg(rt);
+  emit_cmp(rs1,rs2);
+  if(rs1==rt||rs2==rt) emit_movimm(0,rt);
+  emit_cmovl(&const_one,rt);
+}
+static void emit_set_if_carry32(int rs1, int rs2, int rt)
+{
+  //assem_debug("set if carry (%%%s,%%%s),%%%s",regname[rs1],regname[rs2],regname[rt]);
+  if(rs1!=rt&&rs2!=rt) emit_zeroreg(rt);
+  emit_cmp(rs1,rs2);
+  if(rs1==rt||rs2==rt) emit_movimm(0,rt);
+  emit_adcimm(0,rt);
+}
+static void emit_set_if_less64_32(int u1, int l1, int u2, int l2, int rt)
+{
+  //assem_debug("set if less64 (%%%s,%%%s,%%%s,%%%s),%%%s",regname[u1],regname[l1],regname[u2],regname[l2],regname[rt]);
+  assert(u1!=rt);
+  assert(u2!=rt);
+  emit_cmp(l1,l2);
+  emit_mov(u1,rt);
+  emit_sbb(u2,rt);
+  emit_movimm(0,rt);
+  emit_cmovl(&const_one,rt);
+}
+static void emit_set_if_carry64_32(int u1, int l1, int u2, int l2, int rt)
+{
+  //assem_debug("set if carry64 (%%%s,%%%s,%%%s,%%%s),%%%s",regname[u1],regname[l1],regname[u2],regname[l2],regname[rt]);
+  assert(u1!=rt);
+  assert(u2!=rt);
+  emit_cmp(l1,l2);
+  emit_mov(u1,rt);
+  emit_sbb(u2,rt);
+  emit_movimm(0,rt);
+  emit_adcimm(0,rt);
+}
+
+static void emit_callreg(u_int r)
+{
+  assem_debug("call *%%%s",regname[r]);
+  assert(r<16);
+  output_rex(0,0,0,r,0);
+  output_byte(0xFF);
+  output_modrm(3,r,2);
+}
+static void emit_jmpreg(u_int r)
+{
+  assem_debug("jmp *%%%s",regname[r]);
+  assert(r<16);
+  output_rex(0,0,0,r,0);
+  output_byte(0xFF);
+  output_modrm(3,r,4);
+}
+
+// Direct calls reach anything within 2GB of the translation cache,
+// other C functions are called through the scratch register
+static void emit_call(intptr_t a)
+{
+  intptr_t rel=a-(intptr_t)out-5;
+  assem_debug("call %llx (%llx+%llx)",(long long)a,(long long)(intptr_t)out+5,(long long)rel);
+  if(rel==(int)rel) {
+    output_byte(0xe8);
+    output_w32(rel);
+  }
+  else
+  {
+    emit_movimm64(a,HOST_SCRATCH);
+    emit_callreg(HOST_SCRATCH);
+  }
+}
+static void emit_jmp(intptr_t a)
+{
+  assem_debug("jmp %llx (%llx+%llx)",(long long)a,(long long)(intptr_t)out+5,(long long)(a-(intptr_t)out-5));
+  output_byte(0xe9);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jne(intptr_t a)
+{
+  assem_debug("jne %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x85);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jeq(intptr_t a)
+{
+  assem_debug("jeq %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x84);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_js(intptr_t a)
+{
+  assem_debug("js %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x88);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jns(intptr_t a)
+{
+  assem_debug("jns %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x89);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jl(intptr_t a)
+{
+  assem_debug("jl %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x8c);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jge(intptr_t a)
+{
+  assem_debug("jge %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x8d);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jno(intptr_t a)
+{
+  assem_debug("jno %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x81);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jc(intptr_t a)
+{
+  assem_debug("jc %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x82);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jae(intptr_t a)
+{
+  assem_debug("jae %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x83);
+  output_w32(a-(intptr_t)out-4);
+}
+static void emit_jb(intptr_t a)
+{
+  assem_debug("jb %llx",(long long)a);
+  output_byte(0x0f);
+  output_byte(0x82);
+  output_w32(a-(intptr_t)out-4);
+}
+
+static void emit_pushreg(u_int r)
+{
+  assem_debug("push %%%s",regname[r]);
+  assert(r<16);
+  output_rex(0,0,0,r,0);
+  output_byte(0x50+(r&7));
+}
+static void emit_popreg(u_int r)
+{
+  assem_debug("pop %%%s",regname[r]);
+  assert(r<16);
+  output_rex(0,0,0,r,0);
+  output_byte(0x58+(r&7));
+}
+// There is no pusha in long mode.  Save every allocatable register,
+// with 8 bytes of padding so the stack stays 16-byte aligned for C
+// calls.  The pagefault address slot ends up at 112(%rsp).
+static void emit_pusha()
+{
+  int r;
+  assem_debug("pusha");
+  emit_addimm64(ESP,-8,ESP);
+  for(r=0;r<HOST_REGS;r++)
+    if(r!=ESP) emit_pushreg(r);
+}
+static void emit_popa()
+{
+  int r;
+  assem_debug("popa");
+  for(r=HOST_REGS-1;r>=0;r--)
+    if(r!=ESP) emit_popreg(r);
+  emit_addimm64(ESP,8,ESP);
+}
+
+static void emit_readword(intptr_t addr, int rt)
+{
+  assem_debug("mov %llx,%%%s",(long long)addr,regname[rt]);
+  output_abs_op(0,0,0x8B,rt,addr,0,0);
+}
+static void emit_readptr(intptr_t addr, int rt)
+{
+  assem_debug("mov %llx,%%%s (64)",(long long)addr,regname[rt]);
+  output_abs_op(0,1,0x8B,rt,addr,0,0);
+}
+// Load a pointer from a table of pointers (memory_map, readmem etc.)
+static void emit_readptr_indexedx8(intptr_t addr, int rs, int rt)
+{
+  assem_debug("mov %llx(,%%%s,8),%%%s (64)",(long long)addr,regname[rs],regname[rt]);
+  emit_loadaddr(addr,HOST_SCRATCH);
+  output_mem_op(0,1,0x8B,rt,HOST_SCRATCH,rs,3,0,0,0);
+}
+static void emit_readword_indexed(intptr_t addr, int rs, int rt)
+{
+  assem_debug("mov %llx+%%%s,%%%s",(long long)addr,regname[rs],regname[rt]);
+  output_indexed_op(0,0,0x8B,rt,addr,rs,0,0);
+}
+static void emit_readword_tlb(int addr, int map, int rt)
+{
+  assem_debug("mov (%x,%%%s,4),%%%s",addr,map<0?"":regname[map],regname[rt]);
+  output_tlb_op(0,0x8B,rt,addr,map,0);
+}
+static void emit_readword_indexed_tlb(int addr, int rs, int map, int rt)
+{
+  assem_debug("mov %x(%%%s,%%%s,4),%%%s",addr,regname[rs],map<0?"":regname[map],regname[rt]);
+  output_indexed_tlb_op(0,0x8B,rt,addr,rs,map,2,0);
+}
+static void emit_readdword_tlb(int addr, int map, int rh, int rl)
+{
+  if(rh>=0) emit_readword_tlb(addr, map, rh);
+  emit_readword_tlb(addr+4, map, rl);
+}
+static void emit_readdword_indexed_tlb(int addr, int rs, int map, int rh, int rl)
+{
+  assert(rh!=rs);
+  if(rh>=0) emit_readword_indexed_tlb(addr, rs, map, rh);
+  emit_readword_indexed_tlb(addr+4, rs, map, rl);
+}
+static void emit_movsbl(intptr_t addr, int rt)
+{
+  assem_debug("movsbl %llx,%%%s",(long long)addr,regname[rt]);
+  output_abs_op(0,0,0x0FBE,rt,addr,0,0);
+}
+static void emit_movsbl_indexed(intptr_t addr, int rs, int rt)
+{
+  assem_debug("movsbl %llx+%%%s,%%%s",(long long)addr,regname[rs],regname[rt]);
+  output_indexed_op(0,0,0x0FBE,rt,addr,rs,0,0);
+}
+static void emit_movsbl_tlb(int addr, int map, int rt)
+{
+  assem_debug("movsbl (%x,%%%s,4),%%%s",addr,map<0?"":regname[map],regname[rt]);
+  output_tlb_op(0,0x0FBE,rt,addr,map,0);
+}
+static void emit_movsbl_indexed_tlb(int addr, int rs, int map, int rt)
+{
+  assem_debug("movsbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],map<0?"":regname[map],regname[rt]);
+  output_indexed_tlb_op(0,0x0FBE,rt,addr,rs,map,2,0);
+}
+static void emit_movswl(intptr_t addr, int rt)
+{
+  assem_debug("movswl %llx,%%%s",(long long)addr,regname[rt]);
+  output_abs_op(0,0,0x0FBF,rt,addr,0,0);
+}
+static void emit_movswl_indexed(intptr_t addr, int rs, int rt)
+{
+  assem_debug("movswl %llx+%%%s,%%%s",(long long)addr,regname[rs],regname[rt]);
+  output_indexed_op(0,0,0x0FBF,rt,addr,rs,0,0);
+}
+static void emit_movswl_tlb(int addr, int map, int rt)
+{
+  assem_debug("movswl (%x,%%%s,4),%%%s",addr,map<0?"":regname[map],regname[rt]);
+  output_tlb_op(0,0x0FBF,rt,addr,map,0);
+}
+static void emit_movzbl(intptr_t addr, int rt)
+{
+  assem_debug("movzbl %llx,%%%s",(long long)addr,regname[rt]);
+  output_abs_op(0,0,0x0FB6,rt,addr,0,0);
+}
+static void emit_movzbl_indexed(intptr_t addr, int rs, int rt)
+{
+  assem_debug("movzbl %llx+%%%s,%%%s",(long long)addr,regname[rs],regname[rt]);
+  output_indexed_op(0,0,0x0FB6,rt,addr,rs,0,0);
+}
+static void emit_movzbl_tlb(int addr, int map, int rt)
+{
+  assem_debug("movzbl (%x,%%%s,4),%%%s",addr,map<0?"":regname[map],regname[rt]);
+  output_tlb_op(0,0x0FB6,rt,addr,map,0);
+}
+static void emit_movzbl_indexed_tlb(int addr, int rs, int map, int rt)
+{
+  assem_debug("movzbl %x(%%%s,%%%s,4),%%%s",addr,regname[rs],map<0?"":regname[map],regname[rt]);
+  output_indexed_tlb_op(0,0x0FB6,rt,addr,rs,map,2,0);
+}
+static void emit_movzwl(intptr_t addr, int rt)
+{
+  assem_debug("movzwl %llx,%%%s",(long long)addr,regname[rt]);
+  output_abs_op(0,0,0x0FB7,rt,addr,0,0);
+}
+static void emit_movzwl_indexed(intptr_t addr, int rs, int rt)
+{
+  assem_debug("movzwl %llx+%%%s,%%%s",(long long)addr,regname[rs],regname[rt]);
+  output_indexed_op(0,0,0x0FB7,rt,addr,rs,0,0);
+}
+static void emit_movzwl_tlb(int addr, int map, int rt)
+{
+  assem_debug("movzwl (%x,%%%s,4),%%%s",addr,map<0?"":regname[map],regname[rt]);
+  output_tlb_op(0,0x0FB7,rt,addr,map,0);
+}
+
+static void emit_xchg(int rs, int rt)
+{
+  assem_debug("xchg %%%s,%%%s",regname[rs],regname[rt]);
+  output_rr(0,0x87,rs,rt);
+}
+static void emit_writeword(int rt, intptr_t addr)
+{
+  assem_debug("movl %%%s,%llx",regname[rt],(long long)addr);
+  output_abs_op(0,0,0x89,rt,addr,0,0);
+}
+static void emit_writeptr(int rt, intptr_t addr)
+{
+  assem_debug("movq %%%s,%llx",regname[rt],(long long)addr);
+  output_abs_op(0,1,0x89,rt,addr,0,0);
+}
+static void emit_writeword_indexed(int rt, intptr_t addr, int rs)
+{
+  assem_debug("mov %%%s,%llx+%%%s",regname[rt],(long long)addr,regname[rs]);
+  output_indexed_op(0,0,0x89,rt,addr,rs,0,0);
+}
+static void emit_writeword_indexed_tlb(int rt, int addr, int rs, int map, int temp)
+{
+  assem_debug("mov %%%s,%x(%%%s,%%%s,1)",regname[rt],addr,regname[rs],map<0?"":regname[map]);
+  output_indexed_tlb_op(0,0x89,rt,addr,rs,map,0,0);
+}
+static void emit_writedword_indexed_tlb(int rh, int rl, int addr, int rs, int map, int temp)
+{
+  assert(rh>=0);
+  emit_writeword_indexed_tlb(rh, addr, rs, map, temp);
+  emit_writeword_indexed_tlb(rl, addr+4, rs, map, temp);
+}
+static void emit_writehword(int rt, intptr_t addr)
+{
+  assem_debug("movw %%%s,%llx",regname[rt]+1,(long long)addr);
+  output_abs_op(0x66,0,0x89,rt,addr,0,0);
+}
+static void emit_writehword_indexed(int rt, intptr_t addr, int rs)
+{
+  assem_debug("movw %%%s,%llx+%%%s",regname[rt]+1,(long long)addr,regname[rs]);
+  output_indexed_op(0x66,0,0x89,rt,addr,rs,0,0);
+}
+// Byte stores can use any register, with REX to get %sil etc.
+static void emit_writebyte(int rt, intptr_t addr)
+{
+  assem_debug("movb %%%s,%llx",regname[rt],(long long)addr);
+  output_abs_op(0,0,0x88,rt,addr,0,rt>=4);
+}
+static void emit_writebyte_indexed(int rt, intptr_t addr, int rs)
+{
+  assem_debug("movb %%%s,%llx+%%%s",regname[rt],(long long)addr,regname[rs]);
+  output_indexed_op(0,0,0x88,rt,addr,rs,0,rt>=4);
+}
+static void emit_writebyte_indexed_tlb(int rt, int addr, int rs, int map, int temp)
+{
+  assem_debug("movb %%%s,%x(%%%s,%%%s,1)",regname[rt],addr,regname[rs],map<0?"":regname[map]);
+  output_indexed_tlb_op(0,0x88,rt,addr,rs,map,0,rt>=4);
+}
+static void emit_writeword_imm(int imm, intptr_t addr)
+{
+  assem_debug("movl $%x,%llx",imm,(long long)addr);
+  output_abs_op(0,0,0xC7,0,addr,4,0);
+  output_w32(imm);
+}
+static void emit_writeword_imm_esp(int imm, int addr)
+{
+  assem_debug("mov $%x,%x(%%rsp)",imm,addr);
+  assert(addr>=-128&&addr<128);
+  output_mem_op(0,0,0xC7,0,ESP,-1,0,addr,4,0);
+  output_w32(imm);
+}
+static void emit_writebyte_imm(int imm, intptr_t addr)
+{
+  assem_debug("movb $%x,%llx",imm,(long long)addr);
+  assert(imm>=-128&&imm<128);
+  output_abs_op(0,0,0xC6,0,addr,1,0);
+  output_byte(imm);
+}
+
+static void emit_mul(int rs)
+{
+  assem_debug("mul %%%s",regname[rs]);
+  output_rex(0,0,0,rs,0);
+  output_byte(0xF7);
+  output_modrm(3,rs,4);
+}
+static void emit_imul(int rs)
+{
+  assem_debug("imul %%%s",regname[rs]);
+  output_rex(0,0,0,rs,0);
+  output_byte(0xF7);
+  output_modrm(3,rs,5);
+}
+static void emit_div(int rs)
+{
+  assem_debug("div %%%s",regname[rs]);
+  output_rex(0,0,0,rs,0);
+  output_byte(0xF7);
+  output_modrm(3,rs,6);
+}
+static void emit_idiv(int rs)
+{
+  assem_debug("idiv %%%s",regname[rs]);
+  output_rex(0,0,0,rs,0);
+  output_byte(0xF7);
+  output_modrm(3,rs,7);
+}
+static void emit_cdq()
+{
+  assem_debug("cdq");
+  output_byte(0x99);
+}
+
+// Load 2 immediates optimizing for small code size
+static void emit_mov2imm_compact(int imm1,u_int rt1,int imm2,u_int rt2)
+{
+  emit_movimm(imm1,rt1);
+  if(imm2-imm1<128&&imm2-imm1>=-128) emit_addimm(rt1,imm2-imm1,rt2);
+  else emit_movimm(imm2,rt2);
+}
+
+// special case for checking pending_exception
+static void emit_cmpmem_imm_byte(intptr_t addr,int imm)
+{
+  assert(imm<128&&imm>=-127);
+  assem_debug("cmpb $%d,%llx",imm,(long long)addr);
+  output_abs_op(0,0,0x80,7,addr,1,0);
+  output_byte(imm);
+}
+
+// special case for checking invalid_code
+static void emit_cmpmem_indexedsr12_imm(intptr_t addr,int r,int imm)
+{
+  assert(imm<128&&imm>=-127);
+  assert(r>=0&&r<16);
+  emit_shrimm(r,12,r);
+  assem_debug("cmp $%d,%llx+%%%s",imm,(long long)addr,regname[r]);
+  output_indexed_op(0,0,0x80,7,addr,r,1,0);
+  output_byte(imm);
+}
+
+// Used to preload hash table entries
+#ifdef IMM_PREFETCH
+static void emit_prefetch(void *addr)
+{
+  assem_debug("prefetch %llx",(long long)(intptr_t)addr);
+  output_abs_op(0,0,0x0F18,1,(intptr_t)addr,0,0);
+}
+#endif
+
+// x87 loads and stores take a pointer in a host register
+static void emit_flds(int r)
+{
+  assem_debug("flds (%%%s)",regname[r]);
+  output_mem_op(0,0,0xd9,0,r,-1,0,0,0,0);
+}
+static void emit_fldl(int r)
+{
+  assem_debug("fldl (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdd,0,r,-1,0,0,0,0);
+}
+static void emit_fucomip(u_int r)
+{
+  assem_debug("fucomip %d",r);
+  assert(r<8);
+  output_byte(0xdf);
+  output_byte(0xe8+r);
+}
+static void emit_fchs()
+{
+  assem_debug("fchs");
+  output_byte(0xd9);
+  output_byte(0xe0);
+}
+static void emit_fabs()
+{
+  assem_debug("fabs");
+  output_byte(0xd9);
+  output_byte(0xe1);
+}
+static void emit_fsqrt()
+{
+  assem_debug("fsqrt");
+  output_byte(0xd9);
+  output_byte(0xfa);
+}
+static void emit_fadds(int r)
+{
+  assem_debug("fadds (%%%s)",regname[r]);
+  output_mem_op(0,0,0xd8,0,r,-1,0,0,0,0);
+}
+static void emit_faddl(int r)
+{
+  assem_debug("faddl (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdc,0,r,-1,0,0,0,0);
+}
+static void emit_fadd(int r)
+{
+  assem_debug("fadd st%d",r);
+  output_byte(0xd8);
+  output_byte(0xc0+r);
+}
+static void emit_fsubs(int r)
+{
+  assem_debug("fsubs (%%%s)",regname[r]);
+  output_mem_op(0,0,0xd8,4,r,-1,0,0,0,0);
+}
+static void emit_fsubl(int r)
+{
+  assem_debug("fsubl (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdc,4,r,-1,0,0,0,0);
+}
+static void emit_fsub(int r)
+{
+  assem_debug("fsub st%d",r);
+  output_byte(0xd8);
+  output_byte(0xe0+r);
+}
+static void emit_fmuls(int r)
+{
+  assem_debug("fmuls (%%%s)",regname[r]);
+  output_mem_op(0,0,0xd8,1,r,-1,0,0,0,0);
+}
+static void emit_fmull(int r)
+{
+  assem_debug("fmull (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdc,1,r,-1,0,0,0,0);
+}
+static void emit_fmul(int r)
+{
+  assem_debug("fmul st%d",r);
+  output_byte(0xd8);
+  output_byte(0xc8+r);
+}
+static void emit_fdivs(int r)
+{
+  assem_debug("fdivs (%%%s)",regname[r]);
+  output_mem_op(0,0,0xd8,6,r,-1,0,0,0,0);
+}
+static void emit_fdivl(int r)
+{
+  assem_debug("fdivl (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdc,6,r,-1,0,0,0,0);
+}
+static void emit_fdiv(int r)
+{
+  assem_debug("fdiv st%d",r);
+  output_byte(0xd8);
+  output_byte(0xf0+r);
+}
+static void emit_fpop()
+{
+  // fstp st(0)
+  assem_debug("fpop");
+  output_byte(0xdd);
+  output_byte(0xd8);
+}
+static void emit_fildl(int r)
+{
+  assem_debug("fildl (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdb,0,r,-1,0,0,0,0);
+}
+static void emit_fildll(int r)
+{
+  assem_debug("fildll (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdf,5,r,-1,0,0,0,0);
+}
+static void emit_fistpl(int r)
+{
+  assem_debug("fistpl (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdb,3,r,-1,0,0,0,0);
+}
+static void emit_fistpll(int r)
+{
+  assem_debug("fistpll (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdf,7,r,-1,0,0,0,0);
+}
+static void emit_fstps(int r)
+{
+  assem_debug("fstps (%%%s)",regname[r]);
+  output_mem_op(0,0,0xd9,3,r,-1,0,0,0,0);
+}
+static void emit_fstpl(int r)
+{
+  assem_debug("fstpl (%%%s)",regname[r]);
+  output_mem_op(0,0,0xdd,3,r,-1,0,0,0,0);
+}
+static void emit_fnstcw_stack()
+{
+  assem_debug("fnstcw (%%rsp)");
+  output_mem_op(0,0,0xd9,7,ESP,-1,0,0,0,0);
+}
+static void emit_fldcw_stack()
+{
+  assem_debug("fldcw (%%rsp)");
+  output_mem_op(0,0,0xd9,5,ESP,-1,0,0,0,0);
+}
+static void emit_fldcw_indexed(intptr_t addr,int r)
+{
+  assem_debug("fldcw %llx(%%%s,2)",(long long)addr,regname[r]);
+  emit_loadaddr(addr,HOST_SCRATCH);
+  output_mem_op(0,0,0xd9,5,HOST_SCRATCH,r,1,0,0,0);
+}
+static void emit_fldcw(intptr_t addr)
+{
+  assem_debug("fldcw %llx",(long long)addr);
+  output_abs_op(0,0,0xd9,5,addr,0,0);
+}
+#ifdef __SSE__
+static void emit_movss_load(u_int addr,u_int ssereg)
+{
+  assem_debug("movss (%%%s),xmm%d",regname[addr],ssereg);
+  assert(ssereg<8);
+  output_mem_op(0xf3,0,0x0f10,ssereg,addr,-1,0,0,0,0);
+}
+static void emit_movsd_load(u_int addr,u_int ssereg)
+{
+  assem_debug("movsd (%%%s),xmm%d",regname[addr],ssereg);
+  assert(ssereg<8);
+  output_mem_op(0xf2,0,0x0f10,ssereg,addr,-1,0,0,0,0);
+}
+static void emit_movd_store(u_int ssereg,u_int addr)
+{
+  assem_debug("movd xmm%d,(%%%s)",ssereg,regname[addr]);
+  assert(ssereg<8);
+  output_mem_op(0x66,0,0x0f7e,ssereg,addr,-1,0,0,0,0);
+}
+static void emit_cvttps2dq(u_int ssereg1,u_int ssereg2)
+{
+  assem_debug("cvttps2dq xmm%d,xmm%d",ssereg1,ssereg2);
+  assert(ssereg1<8);
+  assert(ssereg2<8);
+  output_byte(0xf3);
+  output_byte(0x0f);
+  output_byte(0x5b);
+  output_modrm(3,ssereg1,ssereg2);
+}
+static void emit_cvttpd2dq(u_int ssereg1,u_int ssereg2)
+{
+  assem_debug("cvttpd2dq xmm%d,xmm%d",ssereg1,ssereg2);
+  assert(ssereg1<8);
+  assert(ssereg2<8);
+  output_byte(0x66);
+  output_byte(0x0f);
+  output_byte(0xe6);
+  output_modrm(3,ssereg1,ssereg2);
+}
+#endif
+
+/* Stubs/epilogue */
+
+// mov $target,%esi; lea disp(%rip),%rdi; call linker; jmp *%rax
+// The lea points %rdi at the displacement of the branch to be patched,
+// see dynamic_linker and kill_pointer.
+static void emit_extjump2(intptr_t addr, int target, intptr_t linker)
+{
+  u_char *ptr=(u_char *)addr;
+  if(*ptr==0x0f)
+  {
+    assert(ptr[1]>=0x80&&ptr[1]<=0x8f);
+    addr+=2;
+  }
+  else
+  {
+    assert(*ptr==0xe8||*ptr==0xe9);
+    addr++;
+  }
+  emit_movimm(target,ESI);
+  assem_debug("lea %llx(%%rip),%%rdi",(long long)addr);
+  output_byte(0x48);
+  output_byte(0x8D);
+  output_byte(0x3D);
+  output_w32(addr-(intptr_t)out-4);
+  //assert(addr>=0x7000000&&addr<0x7FFFFFF);
+  //assert((target>=0x80000000&&target<0x80800000)||(target>0xA4000000&&target<0xA4001000));
+  emit_call(linker);
+  emit_jmpreg(EAX);
+}
+
+static void emit_extjump(intptr_t addr, int target)
+{
+  emit_extjump2(addr, target, (intptr_t)dynamic_linker);
+}
+static void emit_extjump_ds(intptr_t addr, int target)
+{
+  emit_extjump2(addr, target, (intptr_t)dynamic_linker_ds);
+}
+
+static void do_readstub(int n)
+{
+  assem_debug("do_readstub %x",start+stubs[n][3]*4);
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  int type=stubs[n][0];
+  int i=stubs[n][3];
+  int rs=stubs[n][4];
+  struct regstat *i_regs=(struct regstat *)stubs[n][5];
+  signed char *i_regmap=i_regs->regmap;
+  int addr=get_reg(i_regmap,AGEN1+(i&1));
+  int rth,rt;
+  int ds;
+  if(itype[i]==C1LS||itype[i]==LOADLR) {
+    rth=get_reg(i_regmap,FTEMP|64);
+    rt=get_reg(i_regmap,FTEMP);
+  }else{
+    rth=get_reg(i_regmap,rt1[i]|64);
+    rt=get_reg(i_regmap,rt1[i]);
+  }
+  assert(rs>=0);
+  if(addr<0) addr=rt;
+  if(addr<0&&itype[i]!=C1LS&&itype[i]!=LOADLR) addr=get_reg(i_regmap,-1);
+  assert(addr>=0);
+  intptr_t ftable=0;
+  if(type==LOADB_STUB||type==LOADBU_STUB)
+    ftable=(intptr_t)readmemb;
+  if(type==LOADH_STUB||type==LOADHU_STUB)
+    ftable=(intptr_t)readmemh;
+  if(type==LOADW_STUB)
+    ftable=(intptr_t)readmem;
+  if(type==LOADD_STUB)
+    ftable=(intptr_t)readmemd;
+  emit_writeword(rs,(intptr_t)&address);
+  emit_shrimm(rs,16,addr);
+  emit_readptr_indexedx8(ftable,addr,addr);
+  emit_pusha();
+  ds=i_regs!=&regs[i];
+  int real_rs=(itype[i]==LOADLR)?-1:get_reg(i_regmap,rs1[i]);
+  if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)),i);
+  wb_dirtys(i_regs->regmap_entry,i_regs->was32,i_regs->wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)));
+
+  int temp;
+  int cc=get_reg(i_regmap,CCREG);
+  if(cc<0) {
+    if(addr==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!addr;
+    }
+  }
+  else
+  {
+    temp=!addr;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(stubs[n][6]+1),cc);
+  emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,112);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_callreg(addr);
+  // We really shouldn't need to update the count here,
+  // but not doing so causes random crashes...
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-(int)CLOCK_DIVIDER*(stubs[n][6]+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(i_regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+  if(rt>=0) {
+    if(type==LOADB_STUB)
+      emit_movsbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADBU_STUB)
+      emit_movzbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADH_STUB)
+      emit_movswl((intptr_t)&readmem_dword,rt);
+    if(type==LOADHU_STUB)
+      emit_movzwl((intptr_t)&readmem_dword,rt);
+    if(type==LOADW_STUB)
+      emit_readword((intptr_t)&readmem_dword,rt);
+    if(type==LOADD_STUB) {
+      emit_readword((intptr_t)&readmem_dword,rt);
+      if(rth>=0) emit_readword(((intptr_t)&readmem_dword)+4,rth);
+    }
+  }
+  emit_jmp(stubs[n][2]); // return address
+}
+
+static void inline_readstub(int type, int i, u_int addr, signed char regmap[], int target, int adj, u_int reglist)
+{
+  assem_debug("inline_readstub");
+  int rs=get_reg(regmap,target);
+  int rth=get_reg(regmap,target|64);
+  int rt=get_reg(regmap,target);
+  if(rs<0) rs=get_reg(regmap,-1);
+  assert(rs>=0);
+  intptr_t ftable=0;
+  if(type==LOADB_STUB||type==LOADBU_STUB)
+    ftable=(intptr_t)readmemb;
+  if(type==LOADH_STUB||type==LOADHU_STUB)
+    ftable=(intptr_t)readmemh;
+  if(type==LOADW_STUB)
+    ftable=(intptr_t)readmem;
+  if(type==LOADD_STUB)
+    ftable=(intptr_t)readmemd;
+  #ifdef HOST_IMM_ADDR32
+  emit_writeword_imm(addr,(intptr_t)&address);
+  #else
+  emit_writeword(rs,(intptr_t)&address);
+  #endif
+  emit_pusha();
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Theoretically we can have a pagefault here, if the TLB has never
+    // been enabled and the address is outside the range 80000000..BFFFFFFF
+    // Write out the registers so the pagefault can be handled.  This is
+    // a very rare case and likely represents a bug.
+    int ds=regmap!=regs[i].regmap;
+    if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty,i);
+    if(!ds) wb_dirtys(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty);
+    else wb_dirtys(branch_regs[i-1].regmap_entry,branch_regs[i-1].was32,branch_regs[i-1].wasdirty);
+  }
+  int cc=get_reg(regmap,CCREG);
+  int temp;
+  if(cc<0) {
+    if(rs==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!rs;
+    }
+  }
+  else
+  {
+    temp=!rs;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(adj+1),cc);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Pagefault address
+    int ds=regmap!=regs[i].regmap;
+    emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,112);
+  }
+  emit_call(((intptr_t *)ftable)[addr>>16]);
+  // We really shouldn't need to update the count here,
+  // but not doing so causes random crashes...
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-(int)CLOCK_DIVIDER*(adj+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+  if(rt>=0) {
+    if(type==LOADB_STUB)
+      emit_movsbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADBU_STUB)
+      emit_movzbl((intptr_t)&readmem_dword,rt);
+    if(type==LOADH_STUB)
+      emit_movswl((intptr_t)&readmem_dword,rt);
+    if(type==LOADHU_STUB)
+      emit_movzwl((intptr_t)&readmem_dword,rt);
+    if(type==LOADW_STUB)
+      emit_readword((intptr_t)&readmem_dword,rt);
+    if(type==LOADD_STUB) {
+      emit_readword((intptr_t)&readmem_dword,rt);
+      if(rth>=0) emit_readword(((intptr_t)&readmem_dword)+4,rth);
+    }
+  }
+}
+
+static void do_writestub(int n)
+{
+  assem_debug("do_writestub %x",start+stubs[n][3]*4);
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  int type=stubs[n][0];
+  int i=stubs[n][3];
+  int rs=stubs[n][4];
+  struct regstat *i_regs=(struct regstat *)stubs[n][5];
+  signed char *i_regmap=i_regs->regmap;
+  int addr=get_reg(i_regmap,AGEN1+(i&1));
+  int rth,rt,r;
+  int ds;
+  if(itype[i]==C1LS) {
+    rth=get_reg(i_regmap,FTEMP|64);
+    rt=get_reg(i_regmap,r=FTEMP);
+  }else{
+    rth=get_reg(i_regmap,rs2[i]|64);
+    rt=get_reg(i_regmap,r=rs2[i]);
+  }
+  assert(rs>=0);
+  assert(rt>=0);
+  if(addr<0) addr=get_reg(i_regmap,-1);
+  assert(addr>=0);
+  intptr_t ftable=0;
+  if(type==STOREB_STUB)
+    ftable=(intptr_t)writememb;
+  if(type==STOREH_STUB)
+    ftable=(intptr_t)writememh;
+  if(type==STOREW_STUB)
+    ftable=(intptr_t)writemem;
+  if(type==STORED_STUB)
+    ftable=(intptr_t)writememd;
+  emit_writeword(rs,(intptr_t)&address);
+  emit_shrimm(rs,16,addr);
+  emit_readptr_indexedx8(ftable,addr,addr);
+  if(type==STOREB_STUB)
+    emit_writebyte(rt,(intptr_t)&cpu_byte);
+  if(type==STOREH_STUB)
+    emit_writehword(rt,(intptr_t)&cpu_hword);
+  if(type==STOREW_STUB)
+    emit_writeword(rt,(intptr_t)&cpu_word);
+  if(type==STORED_STUB) {
+    emit_writeword(rt,(intptr_t)&cpu_dword);
+    emit_writeword(r?rth:rt,(intptr_t)&cpu_dword+4);
+  }
+  emit_pusha();
+  ds=i_regs!=&regs[i];
+  int real_rs=get_reg(i_regmap,rs1[i]);
+  if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)),i);
+  wb_dirtys(i_regs->regmap_entry,i_regs->was32,i_regs->wasdirty&~(1<<addr)&(real_rs<0?-1:~(1<<real_rs)));
+
+  int temp;
+  int cc=get_reg(i_regmap,CCREG);
+  if(cc<0) {
+    if(addr==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!addr;
+    }
+  }
+  else
+  {
+    temp=!addr;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(stubs[n][6]+1),cc);
+  emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,112);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  emit_callreg(addr);
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-(int)CLOCK_DIVIDER*(stubs[n][6]+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(i_regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+  emit_jmp(stubs[n][2]); // return address
+}
+
+static void inline_writestub(int type, int i, u_int addr, signed char regmap[], int target, int adj, u_int reglist)
+{
+  assem_debug("inline_writestub");
+  int rs=get_reg(regmap,-1);
+  int rth=get_reg(regmap,target|64);
+  int rt=get_reg(regmap,target);
+  assert(rs>=0);
+  assert(rt>=0);
+  intptr_t ftable=0;
+  if(type==STOREB_STUB)
+    ftable=(intptr_t)writememb;
+  if(type==STOREH_STUB)
+    ftable=(intptr_t)writememh;
+  if(type==STOREW_STUB)
+    ftable=(intptr_t)writemem;
+  if(type==STORED_STUB)
+    ftable=(intptr_t)writememd;
+  emit_writeword(rs,(intptr_t)&address);
+  if(type==STOREB_STUB)
+    emit_writebyte(rt,(intptr_t)&cpu_byte);
+  if(type==STOREH_STUB)
+    emit_writehword(rt,(intptr_t)&cpu_hword);
+  if(type==STOREW_STUB)
+    emit_writeword(rt,(intptr_t)&cpu_word);
+  if(type==STORED_STUB) {
+    emit_writeword(rt,(intptr_t)&cpu_dword);
+    emit_writeword(target?rth:rt,(intptr_t)&cpu_dword+4);
+  }
+  emit_pusha();
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Theoretically we can have a pagefault here, if the TLB has never
+    // been enabled and the address is outside the range 80000000..BFFFFFFF
+    // Write out the registers so the pagefault can be handled.  This is
+    // a very rare case and likely represents a bug.
+    int ds=regmap!=regs[i].regmap;
+    if(!ds) load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty,i);
+    if(!ds) wb_dirtys(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty);
+    else wb_dirtys(branch_regs[i-1].regmap_entry,branch_regs[i-1].was32,branch_regs[i-1].wasdirty);
+  }
+  int cc=get_reg(regmap,CCREG);
+  int temp;
+  if(cc<0) {
+    if(rs==HOST_CCREG)
+    {
+      cc=0;temp=1;
+      assert(cc!=HOST_CCREG);
+      assert(temp!=HOST_CCREG);
+      emit_loadreg(CCREG,cc);
+    }
+    else
+    {
+      cc=HOST_CCREG;
+      emit_loadreg(CCREG,cc);
+      temp=!rs;
+    }
+  }
+  else
+  {
+    temp=!rs;
+  }
+  emit_readword((intptr_t)&last_count,temp);
+  emit_addimm(cc,CLOCK_DIVIDER*(adj+1),cc);
+  emit_add(cc,temp,cc);
+  emit_writeword(cc,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+  if((signed int)addr>=(signed int)0xC0000000) {
+    // Pagefault address
+    int ds=regmap!=regs[i].regmap;
+    emit_writeword_imm_esp(start+i*4+(((regs[i].was32>>rs1[i])&1)<<1)+ds,112);
+  }
+  emit_call(((intptr_t *)ftable)[addr>>16]);
+  emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+  emit_readword((intptr_t)&next_interupt,ECX);
+  emit_addimm(HOST_CCREG,-(int)CLOCK_DIVIDER*(adj+1),HOST_CCREG);
+  emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+  emit_writeword(ECX,(intptr_t)&last_count);
+  emit_storereg(CCREG,HOST_CCREG);
+  emit_popa();
+  if((cc=get_reg(regmap,CCREG))>=0) {
+    emit_loadreg(CCREG,cc);
+  }
+}
+
+static void do_unalignedwritestub(int n)
+{
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  output_byte(0xCC);
+  emit_jmp(stubs[n][2]); // return address
+}
+
+static void do_invstub(int n)
+{
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  emit_call(invalidate_block_reg[stubs[n][4]]);
+  emit_jmp(stubs[n][2]); // return address
+}
+
+// mov $vaddr,%edi; movabs $source,%rax; movabs $copy,%rbx; mov $len,%ecx;
+// call verify_code.  The layout is decoded by verify_dirty, get_bounds etc.
+static intptr_t do_dirty_stub(int i)
+{
+  assem_debug("do_dirty_stub %x",start+i*4);
+  emit_movimm(start+i*4,EDI);
+  emit_movimm64((int)start<(int)0xC0000000?(uintptr_t)source:(uintptr_t)start,EAX);
+  emit_movimm64((uintptr_t)copy,EBX);
+  emit_movimm(slen*4,ECX);
+  emit_call((int)start<(int)0xC0000000?(intptr_t)&verify_code:(intptr_t)&verify_code_vm);
+  intptr_t entry=(intptr_t)out;
+  load_regs_entry(i);
+  if(entry==(intptr_t)out) entry=instr_addr[i];
+  emit_jmp(instr_addr[i]);
+  return entry;
+}
+
+static void do_dirty_stub_ds()
+{
+  emit_movimm(start+1,EDI);
+  emit_movimm64((int)start<(int)0xC0000000?(uintptr_t)source:(uintptr_t)start,EAX);
+  emit_movimm64((uintptr_t)copy,EBX);
+  emit_movimm(slen*4,ECX);
+  emit_call((intptr_t)&verify_code_ds);
+}
+
+static void do_cop1stub(int n)
+{
+  assem_debug("do_cop1stub %x",start+stubs[n][3]*4);
+  set_jump_target(stubs[n][1],(intptr_t)out);
+  int i=stubs[n][3];
+  struct regstat *i_regs=(struct regstat *)stubs[n][5];
+  int ds=stubs[n][6];
+  if(!ds) {
+    load_all_consts(regs[i].regmap_entry,regs[i].was32,regs[i].wasdirty,i);
+    //if(i_regs!=&regs[i]) DebugMessage(M64MSG_VERBOSE, "oops: regs[i]=%x i_regs=%x",(int)&regs[i],(int)i_regs);
+  }
+  //else {DebugMessage(M64MSG_VERBOSE, "fp exception in delay slot");}
+  wb_dirtys(i_regs->regmap_entry,i_regs->was32,i_regs->wasdirty);
+  if(regs[i].regmap_entry[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
+  emit_movimm(start+(i-ds)*4,EAX); // Get PC
+  emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG); // CHECK: is this right?  There should probably be an extra cycle...
+  emit_jmp(ds?(intptr_t)fp_exception_ds:(intptr_t)fp_exception);
+}
+
+/* TLB */
+
+// memory_map entries are 64 bits, (host-vaddr)>>2 with the sign bit
+// set for unmapped pages and WRITE_PROTECT in bit 62
+static int do_tlb_r(int s,int ar,int map,int cache,int x,int a,int shift,int c,u_int addr)
+{
+  if(c) {
+    if((signed int)addr>=(signed int)0xC0000000) {
+      emit_readptr((intptr_t)(memory_map+(addr>>12)),map);
+    }
+    else
+      return -1; // No mapping
+  }
+  else {
+    if(s!=map) emit_mov(s,map);
+    emit_shrimm(map,12,map);
+    // Schedule this while we wait on the load
+    //if(x) emit_xorimm(addr,x,addr);
+    if(shift>=0) emit_lea8(s,shift);
+    if(~a) emit_andimm(s,a,ar);
+    emit_readptr_indexedx8((intptr_t)memory_map,map,map);
+  }
+  return map;
+}
+static int do_tlb_r_branch(int map, int c, u_int addr, intptr_t *jaddr)
+{
+  if(!c||(signed int)addr>=(signed int)0xC0000000) {
+    emit_test64(map,map);
+    *jaddr=(intptr_t)out;
+    emit_js(0);
+  }
+  return map;
+}
+
+static void gen_tlb_addr_r(int ar, int map) {
+  if(map>=0) {
+    assem_debug("lea (%%%s,%%%s,4),%%%s (64)",regname[ar],regname[map],regname[ar]);
+    output_mem_op(0,1,0x8D,ar,ar,map,2,0,0,0);
+  }
+}
+
+static int do_tlb_w(int s,int ar,int map,int cache,int x,int c,u_int addr)
+{
+  if(c) {
+    if(addr<0x80800000||addr>=0xC0000000) {
+      emit_readptr((intptr_t)(memory_map+(addr>>12)),map);
+    }
+    else
+      return -1; // No mapping
+  }
+  else {
+    if(s!=map) emit_mov(s,map);
+    //if(s!=ar) emit_mov(s,ar);
+    emit_shrimm(map,12,map);
+    // Schedule this while we wait on the load
+    //if(x) emit_xorimm(s,x,addr);
+    emit_readptr_indexedx8((intptr_t)memory_map,map,map);
+  }
+  // Shifts WRITE_PROTECT into the carry flag
+  assem_debug("shl %%%s,2 (64)",regname[map]);
+  output_shift_op(1,4,map,2);
+  return map;
+}
+static void do_tlb_w_branch(int map, int c, u_int addr, intptr_t *jaddr)
+{
+  if(!c||addr<0x80800000||addr>=0xC0000000) {
+    *jaddr=(intptr_t)out;
+    emit_jc(0);
+  }
+}
+
+static void gen_tlb_addr_w(int ar, int map) {
+  if(map>=0) {
+    assem_debug("lea (%%%s,%%%s,1),%%%s (64)",regname[ar],regname[map],regname[ar]);
+    output_mem_op(0,1,0x8D,ar,ar,map,0,0,0,0);
+  }
+}
+
+static void gen_orig_addr_w(int ar, int map) {
+  if(map>=0) {
+    assem_debug("sub %%%s,%%%s (64)",regname[map],regname[ar]);
+    output_rr(1,0x29,ar,map);
+  }
+}
+
+// We don't need this for x86
+static void generate_map_const(u_int addr,int reg) {
+  // void *mapaddr=memory_map+(addr>>12);
+}
+/* Special assem */
+
+// Offset of a register saved by emit_pusha, relative to %rsp
+static int pusha_offset(int r)
+{
+  assert(r!=ESP&&r<HOST_REGS);
+  return (HOST_REGS-2-(r<ESP?r:r-1))*8;
+}
+static void emit_readword_stack(int disp,int rt)
+{
+  assem_debug("mov %d(%%rsp),%%%s",disp,regname[rt]);
+  output_mem_op(0,0,0x8B,rt,ESP,-1,0,disp,0,0);
+}
+static void emit_writeword_stack(int rt,int disp)
+{
+  assem_debug("mov %%%s,%d(%%rsp)",regname[rt],disp);
+  output_mem_op(0,0,0x89,rt,ESP,-1,0,disp,0,0);
+}
+// Load a 64-bit C argument from a register pair saved by emit_pusha
+static void emit_loaddword_pusha(int rh,int rl,int rt)
+{
+  emit_readword_stack(pusha_offset(rh),rt);
+  assem_debug("shl %%%s,32 (64)",regname[rt]);
+  output_shift_op(1,4,rt,32);
+  emit_readword_stack(pusha_offset(rl),HOST_SCRATCH);
+  assem_debug("or %%r14,%%%s (64)",regname[rt]);
+  output_rr(1,0x09,rt,HOST_SCRATCH);
+}
+// Replace a register pair saved by emit_pusha with the 64-bit C return value
+static void emit_storedword_pusha(int rh,int rl)
+{
+  emit_writeword_stack(EAX,pusha_offset(rl));
+  assem_debug("shr %%rax,32 (64)");
+  output_shift_op(1,5,EAX,32);
+  emit_writeword_stack(EAX,pusha_offset(rh));
+}
+
+static void shift_assemble_x64(int i,struct regstat *i_regs)
+{
+  if(rt1[i]) {
+    if(opcode2[i]<=0x07) // SLLV/SRLV/SRAV
+    {
+      char s,t,shift;
+      t=get_reg(i_regs->regmap,rt1[i]);
+      s=get_reg(i_regs->regmap,rs1[i]);
+      shift=get_reg(i_regs->regmap,rs2[i]);
+      if(t>=0){
+        if(rs1[i]==0)
+        {
+          emit_zeroreg(t);
+        }
+        else if(rs2[i]==0)
+        {
+          assert(s>=0);
+          if(s!=t) emit_mov(s,t);
+        }
+        else
+        {
+          char temp=get_reg(i_regs->regmap,-1);
+          assert(s>=0);
+          if(t==ECX&&s!=ECX) {
+            if(shift!=ECX) emit_mov(shift,ECX);
+            if(rt1[i]==rs2[i]) {shift=temp;}
+            if(s!=shift) emit_mov(s,shift);
+          }
+          else
+          {
+            if(rt1[i]==rs2[i]) {emit_mov(shift,temp);shift=temp;}
+            if(s!=t) emit_mov(s,t);
+            if(shift!=ECX) {
+              if(i_regs->regmap[ECX]<0)
+                emit_mov(shift,ECX);
+              else
+                emit_xchg(shift,ECX);
+            }
+          }
+          if(opcode2[i]==4) // SLLV
+          {
+            emit_shlcl(t==ECX?shift:t);
+          }
+          if(opcode2[i]==6) // SRLV
+          {
+            emit_shrcl(t==ECX?shift:t);
+          }
+          if(opcode2[i]==7) // SRAV
+          {
+            emit_sarcl(t==ECX?shift:t);
+          }
+          if(shift!=ECX&&i_regs->regmap[ECX]>=0) emit_xchg(shift,ECX);
+        }
+      }
+    } else { // DSLLV/DSRLV/DSRAV
+      char sh,sl,th,tl,shift;
+      th=get_reg(i_regs->regmap,rt1[i]|64);
+      tl=get_reg(i_regs->regmap,rt1[i]);
+      sh=get_reg(i_regs->regmap,rs1[i]|64);
+      sl=get_reg(i_regs->regmap,rs1[i]);
+      shift=get_reg(i_regs->regmap,rs2[i]);
+      if(tl>=0){
+        if(rs1[i]==0)
+        {
+          emit_zeroreg(tl);
+          if(th>=0) emit_zeroreg(th);
+        }
+        else if(rs2[i]==0)
+        {
+          assert(sl>=0);
+          if(sl!=tl) emit_mov(sl,tl);
+          if(th>=0&&sh!=th) emit_mov(sh,th);
+        }
+        else
+        {
+          // FIXME: What if shift==tl ?
+          assert(shift!=tl);
+          int temp=get_reg(i_regs->regmap,-1);
+          int real_th=th;
+          if(th<0&&opcode2[i]!=0x14) {th=temp;} // DSLLV doesn't need a temporary register
+          assert(sl>=0);
+          assert(sh>=0);
+          if(tl==ECX&&sl!=ECX) {
+            if(shift!=ECX) emit_mov(shift,ECX);
+            if(sl!=shift) emit_mov(sl,shift);
+            if(th>=0 && sh!=th) emit_mov(sh,th);
+          }
+          else if(th==ECX&&sh!=ECX) {
+            if(shift!=ECX) emit_mov(shift,ECX);
+            if(sh!=shift) emit_mov(sh,shift);
+            if(sl!=tl) emit_mov(sl,tl);
+          }
+          else
+          {
+            if(sl!=tl) emit_mov(sl,tl);
+            if(th>=0 && sh!=th) emit_mov(sh,th);
+            if(shift!=ECX) {
+              if(i_regs->regmap[ECX]<0)
+                emit_mov(shift,ECX);
+              else
+                emit_xchg(shift,ECX);
+            }
+          }
+          if(opcode2[i]==0x14) // DSLLV
+          {
+            if(th>=0) emit_shldcl(th==ECX?shift:th,tl==ECX?shift:tl);
+            emit_shlcl(tl==ECX?shift:tl);
+            emit_testimm(ECX,32);
+            if(th>=0) emit_cmovne_reg(tl==ECX?shift:tl,th==ECX?shift:th);
+            emit_cmovne(&const_zero,tl==ECX?shift:tl);
+          }
+          if(opcode2[i]==0x16) // DSRLV
+          {
+            assert(th>=0);
+            emit_shrdcl(tl==ECX?shift:tl,th==ECX?shift:th);
+            emit_shrcl(th==ECX?shift:th);
+            emit_testimm(ECX,32);
+            emit_cmovne_reg(th==ECX?shift:th,tl==ECX?shift:tl);
+            if(real_th>=0) emit_cmovne(&const_zero,th==ECX?shift:th);
+          }
+          if(opcode2[i]==0x17) // DSRAV
+          {
+            assert(th>=0);
+            emit_shrdcl(tl==ECX?shift:tl,th==ECX?shift:th);
+            if(real_th>=0) {
+              assert(temp>=0);
+              emit_mov(th==ECX?shift:th,temp==ECX?shift:temp);
+            }
+            emit_sarcl(th==ECX?shift:th);
+            if(real_th>=0) emit_sarimm(temp==ECX?shift:temp,31,temp==ECX?shift:temp);
+            emit_testimm(ECX,32);
+            emit_cmovne_reg(th==ECX?shift:th,tl==ECX?shift:tl);
+            if(real_th>=0) emit_cmovne_reg(temp==ECX?shift:temp,th==ECX?shift:th);
+          }
+          if(shift!=ECX&&(i_regs->regmap[ECX]>=0||temp==ECX)) emit_xchg(shift,ECX);
+        }
+      }
+    }
+  }
+}
+#define shift_assemble shift_assemble_x64
+
+static void loadlr_assemble_x64(int i,struct regstat *i_regs)
+{
+  int s,th,tl,temp,temp2,addr,map=-1;
+  int offset;
+  intptr_t jaddr=0;
+  int memtarget,c=0;
+  u_int hr,reglist=0;
+  th=get_reg(i_regs->regmap,rt1[i]|64);
+  tl=get_reg(i_regs->regmap,rt1[i]);
+  s=get_reg(i_regs->regmap,rs1[i]);
+  temp=get_reg(i_regs->regmap,-1);
+  temp2=get_reg(i_regs->regmap,FTEMP);
+  addr=get_reg(i_regs->regmap,AGEN1+(i&1));
+  assert(addr<0);
+  offset=imm[i];
+  for(hr=0;hr<HOST_REGS;hr++) {
+    if(i_regs->regmap[hr]>=0) reglist|=1<<hr;
+  }
+  reglist|=1<<temp;
+  if(offset||s<0||c) addr=temp2;
+  else addr=s;
+  if(s>=0) {
+    c=(i_regs->wasconst>>s)&1;
+    memtarget=((signed int)(constmap[i][s]+offset))<(signed int)0x80800000;
+    if(using_tlb&&((signed int)(constmap[i][s]+offset))>=(signed int)0xC0000000) memtarget=1;
+  }
+  if(!using_tlb) {
+    if(!c) {
+      emit_lea8(addr,temp);
+      if (opcode[i]==0x22||opcode[i]==0x26) {
+        emit_andimm(addr,0xFFFFFFFC,temp2); // LWL/LWR
+      }else{
+        emit_andimm(addr,0xFFFFFFF8,temp2); // LDL/LDR
+      }
+      emit_cmpimm(addr,0x800000);
+      jaddr=(intptr_t)out;
+      emit_jno(0);
+    }
+    else {
+      if (opcode[i]==0x22||opcode[i]==0x26) {
+        emit_movimm(((constmap[i][s]+offset)<<3)&24,temp); // LWL/LWR
+      }else{
+        emit_movimm(((constmap[i][s]+offset)<<3)&56,temp); // LDL/LDR
+      }
+    }
+  }else{ // using tlb
+    int a;
+    if(c) {
+      a=-1;
+    }else if (opcode[i]==0x22||opcode[i]==0x26) {
+      a=0xFFFFFFFC; // LWL/LWR
+    }else{
+      a=0xFFFFFFF8; // LDL/LDR
+    }
+    map=get_reg(i_regs->regmap,TLREG);
+    assert(map>=0);
+    reglist&=~(1<<map);
+    map=do_tlb_r(addr,temp2,map,-1,0,a,c?-1:temp,c,constmap[i][s]+offset);
+    if(c) {
+      if (opcode[i]==0x22||opcode[i]==0x26) {
+        emit_movimm(((constmap[i][s]+offset)<<3)&24,temp); // LWL/LWR
+      }else{
+        emit_movimm(((constmap[i][s]+offset)<<3)&56,temp); // LDL/LDR
+      }
+    }
+    do_tlb_r_branch(map,c,constmap[i][s]+offset,&jaddr);
+  }
+  if (opcode[i]==0x22||opcode[i]==0x26) { // LWL/LWR
+    if(!c||memtarget) {
+      //emit_readword_indexed((intptr_t)g_rdram-0x80000000,temp2,temp2);
+      emit_readword_indexed_tlb(0,temp2,map,temp2);
+      if(jaddr) add_stub(LOADW_STUB,jaddr,(intptr_t)out,i,temp2,(intptr_t)i_regs,ccadj[i],reglist);
+    }
+    else
+      inline_readstub(LOADW_STUB,i,(constmap[i][s]+offset)&0xFFFFFFFC,i_regs->regmap,FTEMP,ccadj[i],reglist);
+    if(rt1[i]) {
+      assert(tl>=0);
+      emit_andimm(temp,24,temp);
+      if (opcode[i]==0x26) emit_xorimm(temp,24,temp); // LWR
+      if(temp==ECX)
+      {
+        int temp3=EDX;
+        if(temp3==temp2) temp3++;
+        emit_pushreg(temp3);
+        emit_movimm(-1,temp3);
+        if (opcode[i]==0x26) {
+          emit_shrcl(temp3);
+          emit_shrcl(temp2);
+        }else{
+          emit_shlcl(temp3);
+          emit_shlcl(temp2);
+        }
+        emit_mov(temp3,ECX);
+        emit_not(ECX,ECX);
+        emit_popreg(temp3);
+      }
+      else
+      {
+        int temp3=EBP;
+        if(temp3==temp) temp3++;
+        if(temp3==temp2) temp3++;
+        if(temp3==temp) temp3++;
+        emit_xchg(ECX,temp);
+        emit_pushreg(temp3);
+        emit_movimm(-1,temp3);
+        if (opcode[i]==0x26) {
+          emit_shrcl(temp3);
+          emit_shrcl(temp2==ECX?temp:temp2);
+        }else{
+          emit_shlcl(temp3);
+          emit_shlcl(temp2==ECX?temp:temp2);
+        }
+        emit_not(temp3,temp3);
+        emit_mov(temp,ECX);
+        emit_mov(temp3,temp);
+        emit_popreg(temp3);
+      }
+      emit_and(temp,tl,tl);
+      emit_or(temp2,tl,tl);
+      //emit_storereg(rt1[i],tl); // DEBUG
+    /*emit_pusha();
+    //save_regs(0x100f);
+        emit_readword((intptr_t)&last_count,ECX);
+        if(get_reg(i_regs->regmap,CCREG)<0)
+          emit_loadreg(CCREG,HOST_CCREG);
+        emit_add(HOST_CCREG,ECX,HOST_CCREG);
+        emit_addimm(HOST_CCREG,2*ccadj[i],HOST_CCREG);
+        emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+    emit_call((intptr_t)memdebug);
+    emit_popa();
+    //restore_regs(0x100f);*/
+    }
+  }
+  if (opcode[i]==0x1A||opcode[i]==0x1B) { // LDL/LDR
+    int temp2h=get_reg(i_regs->regmap,FTEMP|64);
+    if(!c||memtarget) {
+      //if(th>=0) emit_readword_indexed((intptr_t)g_rdram-0x80000000,temp2,temp2h);
+      //emit_readword_indexed((intptr_t)g_rdram-0x7FFFFFFC,temp2,temp2);
+      emit_readdword_indexed_tlb(0,temp2,map,temp2h,temp2);
+      if(jaddr) add_stub(LOADD_STUB,jaddr,(intptr_t)out,i,temp2,(intptr_t)i_regs,ccadj[i],reglist);
+    }
+    else
+      inline_readstub(LOADD_STUB,i,(constmap[i][s]+offset)&0xFFFFFFF8,i_regs->regmap,FTEMP,ccadj[i],reglist);
+    if(rt1[i]) {
+      assert(th>=0);
+      assert(tl>=0);
+      assert(temp2h>=0);
+      emit_andimm(temp,56,temp);
+      // Most registers are caller-saved in this ABI, so save them all
+      // and pass the arguments from the saved copies
+      emit_pusha();
+      emit_loaddword_pusha(th,tl,EDI);
+      emit_loaddword_pusha(temp2h,temp2,ESI);
+      emit_readword_stack(pusha_offset(temp),EDX);
+      if(opcode[i]==0x1A) emit_call((intptr_t)ldl_merge);
+      if(opcode[i]==0x1B) emit_call((intptr_t)ldr_merge);
+      emit_storedword_pusha(th,tl);
+      emit_popa();
+    }
+  }
+}
+#define loadlr_assemble loadlr_assemble_x64
+
+static void cop0_assemble(int i,struct regstat *i_regs)
+{
+  if(opcode2[i]==0) // MFC0
+  {
+    if(rt1[i]) {
+      signed char t=get_reg(i_regs->regmap,rt1[i]);
+      char copr=(source[i]>>11)&0x1f;
+      if(t>=0) {
+        emit_loadaddr((intptr_t)&fake_pc,HOST_SCRATCH);
+        emit_writeptr(HOST_SCRATCH,(intptr_t)&PC);
+        emit_writebyte_imm((source[i]>>11)&0x1f,(intptr_t)&(fake_pc.f.r.nrd));
+        if(copr==9) {
+          emit_readword((intptr_t)&last_count,ECX);
+          emit_loadreg(CCREG,HOST_CCREG); // TODO: do proper reg alloc
+          emit_add(HOST_CCREG,ECX,HOST_CCREG);
+          emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+          emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+        }
+        emit_call((intptr_t)cached_interpreter_table.MFC0);
+        emit_readword((intptr_t)&readmem_dword,t);
+      }
+    }
+  }
+  else if(opcode2[i]==4) // MTC0
+  {
+    signed char s=get_reg(i_regs->regmap,rs1[i]);
+    char copr=(source[i]>>11)&0x1f;
+    assert(s>=0);
+    emit_writeword(s,(intptr_t)&readmem_dword);
+    emit_pusha();
+    emit_loadaddr((intptr_t)&fake_pc,HOST_SCRATCH);
+        emit_writeptr(HOST_SCRATCH,(intptr_t)&PC);
+    emit_writebyte_imm((source[i]>>11)&0x1f,(intptr_t)&(fake_pc.f.r.nrd));
+    if(copr==9||copr==11||copr==12) {
+      if(copr==12&&!is_delayslot) {
+        wb_register(rs1[i],i_regs->regmap,i_regs->dirty,i_regs->is32);
+      }
+      emit_readword((intptr_t)&last_count,ECX);
+      emit_loadreg(CCREG,HOST_CCREG); // TODO: do proper reg alloc
+      emit_add(HOST_CCREG,ECX,HOST_CCREG);
+      emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+      emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+    }
+    // What a mess.  The status register (12) can enable interrupts,
+    // so needs a special case to handle a pending interrupt.
+    // The interrupt must be taken immediately, because a subsequent
+    // instruction might disable interrupts again.
+    if(copr==12&&!is_delayslot) {
+      emit_writeword_imm(start+i*4+4,(intptr_t)&pcaddr);
+      emit_writebyte_imm(0,(intptr_t)&pending_exception);
+    }
+    //else if(copr==12&&is_delayslot) emit_call((intptr_t)MTC0_R12);
+    //else
+    emit_call((intptr_t)cached_interpreter_table.MTC0);
+    if(copr==9||copr==11||copr==12) {
+      emit_readword((intptr_t)&g_cp0_regs[CP0_COUNT_REG],HOST_CCREG);
+      emit_readword((intptr_t)&next_interupt,ECX);
+      emit_addimm(HOST_CCREG,-(int)CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+      emit_sub(HOST_CCREG,ECX,HOST_CCREG);
+      emit_writeword(ECX,(intptr_t)&last_count);
+      emit_storereg(CCREG,HOST_CCREG);
+    }
+    emit_popa();
+    if(copr==12) {
+      assert(!is_delayslot);
+      //if(is_delayslot) output_byte(0xcc);
+      emit_cmpmem_imm_byte((intptr_t)&pending_exception,0);
+      emit_jne((intptr_t)&do_interrupt);
+    }
+    cop1_usable=0;
+  }
+  else
+  {
+    assert(opcode2[i]==0x10);
+    if((source[i]&0x3f)==0x01) // TLBR
+      emit_call((intptr_t)cached_interpreter_table.TLBR);
+    if((source[i]&0x3f)==0x02) // TLBWI
+      emit_call((intptr_t)TLBWI_new);
+    if((source[i]&0x3f)==0x06) { // TLBWR
+      // The TLB entry written by TLBWR is dependent on the count,
+      // so update the cycle count
+      emit_readword((intptr_t)&last_count,ECX);
+      if(i_regs->regmap[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
+      emit_add(HOST_CCREG,ECX,HOST_CCREG);
+      emit_addimm(HOST_CCREG,CLOCK_DIVIDER*ccadj[i],HOST_CCREG);
+      emit_writeword(HOST_CCREG,(intptr_t)&g_cp0_regs[CP0_COUNT_REG]);
+      emit_call((intptr_t)TLBWR_new);
+    }
+    if((source[i]&0x3f)==0x08) // TLBP
+      emit_call((intptr_t)cached_interpreter_table.TLBP);
+    if((source[i]&0x3f)==0x18) // ERET
+    {
+      int count=ccadj[i];
+      if(i_regs->regmap[HOST_CCREG]!=CCREG) emit_loadreg(CCREG,HOST_CCREG);
+      emit_addimm_and_set_flags(CLOCK_DIVIDER*count,HOST_CCREG); // TODO: Should there be an extra cycle here?
+      emit_jmp((intptr_t)jump_eret);
+    }
+  }
+}
+
+static void cop1_assemble(int i,struct regstat *i_regs)
+{
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char rs=get_reg(i_regs->regmap,CSREG);
+    assert(rs>=0);
+    emit_testimm(rs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,rs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+  if (opcode2[i]==0) { // MFC1
+    signed char tl=get_reg(i_regs->regmap,rt1[i]);
+    if(tl>=0) {
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],tl);
+      emit_readword_indexed(0,tl,tl);
+    }
+  }
+  else if (opcode2[i]==1) { // DMFC1
+    signed char tl=get_reg(i_regs->regmap,rt1[i]);
+    signed char th=get_reg(i_regs->regmap,rt1[i]|64);
+    if(tl>=0) {
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],tl);
+      if(th>=0) emit_readword_indexed(4,tl,th);
+      emit_readword_indexed(0,tl,tl);
+    }
+  }
+  else if (opcode2[i]==4) { // MTC1
+    signed char sl=get_reg(i_regs->regmap,rs1[i]);
+    signed char temp=get_reg(i_regs->regmap,-1);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_writeword_indexed(sl,0,temp);
+  }
+  else if (opcode2[i]==5) { // DMTC1
+    signed char sl=get_reg(i_regs->regmap,rs1[i]);
+    signed char sh=rs1[i]>0?get_reg(i_regs->regmap,rs1[i]|64):sl;
+    signed char temp=get_reg(i_regs->regmap,-1);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_writeword_indexed(sh,4,temp);
+    emit_writeword_indexed(sl,0,temp);
+  }
+  else if (opcode2[i]==2) // CFC1
+  {
+    signed char tl=get_reg(i_regs->regmap,rt1[i]);
+    if(tl>=0) {
+      u_int copr=(source[i]>>11)&0x1f;
+      if(copr==0) emit_readword((intptr_t)&FCR0,tl);
+      if(copr==31) emit_readword((intptr_t)&FCR31,tl);
+    }
+  }
+  else if (opcode2[i]==6) // CTC1
+  {
+    signed char sl=get_reg(i_regs->regmap,rs1[i]);
+    u_int copr=(source[i]>>11)&0x1f;
+    assert(sl>=0);
+    if(copr==31)
+    {
+      emit_writeword(sl,(intptr_t)&FCR31);
+      // Set the rounding mode
+      char temp=get_reg(i_regs->regmap,-1);
+      emit_movimm(3,temp);
+      emit_and(sl,temp,temp);
+      emit_fldcw_indexed((intptr_t)&rounding_modes,temp);
+    }
+  }
+}
+
+static void fconv_assemble_x64(int i,struct regstat *i_regs)
+{
+  signed char temp=get_reg(i_regs->regmap,-1);
+  assert(temp>=0);
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char rs=get_reg(i_regs->regmap,CSREG);
+    assert(rs>=0);
+    emit_testimm(rs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,rs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+#ifdef __SSE__
+  if(opcode2[i]==0x10&&(source[i]&0x3f)==0x0d) { // trunc_w_s
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_movss_load(temp,0);
+    emit_cvttps2dq(0,0); // float->int, truncate
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_movd_store(0,temp);
+    return;
+  }
+  if(opcode2[i]==0x11&&(source[i]&0x3f)==0x0d) { // trunc_w_d
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_movsd_load(temp,0);
+    emit_cvttpd2dq(0,0); // double->int, truncate
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_movd_store(0,temp);
+    return;
+  }
+#endif
+  
+  if(opcode2[i]==0x14&&(source[i]&0x3f)==0x20) { // cvt_s_w
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_fildl(temp);
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fstps(temp);
+    return;
+  }
+  if(opcode2[i]==0x14&&(source[i]&0x3f)==0x21) { // cvt_d_w
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_fildl(temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fstpl(temp);
+    return;
+  }
+  if(opcode2[i]==0x15&&(source[i]&0x3f)==0x20) { // cvt_s_l
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fildll(temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fstps(temp);
+    return;
+  }
+  if(opcode2[i]==0x15&&(source[i]&0x3f)==0x21) { // cvt_d_l
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fildll(temp);
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fstpl(temp);
+    return;
+  }
+  
+  if(opcode2[i]==0x10&&(source[i]&0x3f)==0x21) { // cvt_d_s
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_flds(temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fstpl(temp);
+    return;
+  }
+  if(opcode2[i]==0x11&&(source[i]&0x3f)==0x20) { // cvt_s_d
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fldl(temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fstps(temp);
+    return;
+  }
+  
+  if(opcode2[i]==0x10) { // cvt_*_s
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_flds(temp);
+  }
+  if(opcode2[i]==0x11) { // cvt_*_d
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fldl(temp);
+  }
+  if((source[i]&0x3f)<0x10) {
+    emit_fnstcw_stack();
+    if((source[i]&3)==0) emit_fldcw((intptr_t)&rounding_modes[0]); //DebugMessage(M64MSG_VERBOSE, "round");
+    if((source[i]&3)==1) emit_fldcw((intptr_t)&rounding_modes[1]); //DebugMessage(M64MSG_VERBOSE, "trunc");
+    if((source[i]&3)==2) emit_fldcw((intptr_t)&rounding_modes[2]); //DebugMessage(M64MSG_VERBOSE, "ceil");
+    if((source[i]&3)==3) emit_fldcw((intptr_t)&rounding_modes[3]); //DebugMessage(M64MSG_VERBOSE, "floor");
+  }
+  if((source[i]&0x3f)==0x24||(source[i]&0x3c)==0x0c) { // cvt_w_*
+    if(opcode2[i]!=0x10||((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+    emit_fistpl(temp);
+  }
+  if((source[i]&0x3f)==0x25||(source[i]&0x3c)==0x08) { // cvt_l_*
+    if(opcode2[i]!=0x11||((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f))
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+    emit_fistpll(temp);
+  }
+  if((source[i]&0x3f)<0x10) {
+    emit_fldcw_stack();
+  }
+}
+#define fconv_assemble fconv_assemble_x64
+
+static void fcomp_assemble(int i,struct regstat *i_regs)
+{
+  signed char fs=get_reg(i_regs->regmap,FSREG);
+  signed char temp=get_reg(i_regs->regmap,-1);
+  assert(temp>=0);
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char cs=get_reg(i_regs->regmap,CSREG);
+    assert(cs>=0);
+    emit_testimm(cs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,cs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+  
+  if((source[i]&0x3f)==0x30) {
+    emit_andimm(fs,~0x800000,fs);
+    return;
+  }
+  
+  if((source[i]&0x3e)==0x38) {
+    // sf/ngle - these should throw exceptions for NaNs
+    emit_andimm(fs,~0x800000,fs);
+    return;
+  }
+  
+  if(opcode2[i]==0x10) {
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
+    emit_flds(temp);
+    emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+    emit_flds(temp);
+    emit_movimm(0x800000,temp);
+    emit_or(fs,temp,fs);
+    emit_xor(temp,fs,temp);
+    emit_fucomip(1);
+    emit_fpop();
+    if((source[i]&0x3f)==0x31) emit_cmovnp_reg(temp,fs); // c_un_s
+    if((source[i]&0x3f)==0x32) {emit_cmovne_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_eq_s
+    if((source[i]&0x3f)==0x33) emit_cmovne_reg(temp,fs); // c_ueq_s
+    if((source[i]&0x3f)==0x34) {emit_cmovnc_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_olt_s
+    if((source[i]&0x3f)==0x35) emit_cmovnc_reg(temp,fs); // c_ult_s
+    if((source[i]&0x3f)==0x36) {emit_cmova_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_ole_s
+    if((source[i]&0x3f)==0x37) emit_cmova_reg(temp,fs); // c_ule_s
+    if((source[i]&0x3f)==0x3a) emit_cmovne_reg(temp,fs); // c_seq_s
+    if((source[i]&0x3f)==0x3b) emit_cmovne_reg(temp,fs); // c_ngl_s
+    if((source[i]&0x3f)==0x3c) emit_cmovnc_reg(temp,fs); // c_lt_s
+    if((source[i]&0x3f)==0x3d) emit_cmovnc_reg(temp,fs); // c_nge_s
+    if((source[i]&0x3f)==0x3e) emit_cmova_reg(temp,fs); // c_le_s
+    if((source[i]&0x3f)==0x3f) emit_cmova_reg(temp,fs); // c_ngt_s
+    return;
+  }
+  if(opcode2[i]==0x11) {
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
+    emit_fldl(temp);
+    emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+    emit_fldl(temp);
+    emit_movimm(0x800000,temp);
+    emit_or(fs,temp,fs);
+    emit_xor(temp,fs,temp);
+    emit_fucomip(1);
+    emit_fpop();
+    if((source[i]&0x3f)==0x31) emit_cmovnp_reg(temp,fs); // c_un_d
+    if((source[i]&0x3f)==0x32) {emit_cmovne_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_eq_d
+    if((source[i]&0x3f)==0x33) emit_cmovne_reg(temp,fs); // c_ueq_d
+    if((source[i]&0x3f)==0x34) {emit_cmovnc_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_olt_d
+    if((source[i]&0x3f)==0x35) emit_cmovnc_reg(temp,fs); // c_ult_d
+    if((source[i]&0x3f)==0x36) {emit_cmova_reg(temp,fs);emit_cmovp_reg(temp,fs);} // c_ole_d
+    if((source[i]&0x3f)==0x37) emit_cmova_reg(temp,fs); // c_ule_d
+    if((source[i]&0x3f)==0x3a) emit_cmovne_reg(temp,fs); // c_seq_d
+    if((source[i]&0x3f)==0x3b) emit_cmovne_reg(temp,fs); // c_ngl_d
+    if((source[i]&0x3f)==0x3c) emit_cmovnc_reg(temp,fs); // c_lt_d
+    if((source[i]&0x3f)==0x3d) emit_cmovnc_reg(temp,fs); // c_nge_d
+    if((source[i]&0x3f)==0x3e) emit_cmova_reg(temp,fs); // c_le_d
+    if((source[i]&0x3f)==0x3f) emit_cmova_reg(temp,fs); // c_ngt_d
+    return;
+  }
+}
+
+static void float_assemble(int i,struct regstat *i_regs)
+{
+  signed char temp=get_reg(i_regs->regmap,-1);
+  assert(temp>=0);
+  // Check cop1 unusable
+  if(!cop1_usable) {
+    signed char cs=get_reg(i_regs->regmap,CSREG);
+    assert(cs>=0);
+    emit_testimm(cs,0x20000000);
+    intptr_t jaddr=(intptr_t)out;
+    emit_jeq(0);
+    add_stub(FP_STUB,jaddr,(intptr_t)out,i,cs,(intptr_t)i_regs,is_delayslot,0);
+    cop1_usable=1;
+  }
+  
+  if((source[i]&0x3f)==6) // mov
+  {
+    if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f)) {
+      if(opcode2[i]==0x10) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+        emit_flds(temp);
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+        emit_fstps(temp);
+      }
+      if(opcode2[i]==0x11) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+        emit_fldl(temp);
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+        emit_fstpl(temp);
+      }
+    }
+    return;
+  }
+  
+  if((source[i]&0x3f)>3)
+  {
+    if(opcode2[i]==0x10) {
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+      emit_flds(temp);
+      if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+      }
+    }
+    if(opcode2[i]==0x11) {
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+      emit_fldl(temp);
+      if(((source[i]>>11)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+      }
+    }
+    if((source[i]&0x3f)==4) // sqrt
+      emit_fsqrt();
+    if((source[i]&0x3f)==5) // abs
+      emit_fabs();
+    if((source[i]&0x3f)==7) // neg
+      emit_fchs();
+    if(opcode2[i]==0x10) {
+      emit_fstps(temp);
+    }
+    if(opcode2[i]==0x11) {
+      emit_fstpl(temp);
+    }
+    return;
+  }
+  if((source[i]&0x3f)<4)
+  {
+    if(opcode2[i]==0x10) {
+      emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>11)&0x1f],temp);
+      emit_flds(temp);
+    }
+    if(opcode2[i]==0x11) {
+      emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>11)&0x1f],temp);
+      emit_fldl(temp);
+    }
+    if(((source[i]>>11)&0x1f)!=((source[i]>>16)&0x1f)) {
+      if(opcode2[i]==0x10) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>16)&0x1f],temp);
+        if((source[i]&0x3f)==0) emit_fadds(temp);
+        if((source[i]&0x3f)==1) emit_fsubs(temp);
+        if((source[i]&0x3f)==2) emit_fmuls(temp);
+        if((source[i]&0x3f)==3) emit_fdivs(temp);
+      }
+      else if(opcode2[i]==0x11) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>16)&0x1f],temp);
+        if((source[i]&0x3f)==0) emit_faddl(temp);
+        if((source[i]&0x3f)==1) emit_fsubl(temp);
+        if((source[i]&0x3f)==2) emit_fmull(temp);
+        if((source[i]&0x3f)==3) emit_fdivl(temp);
+      }
+    }
+    else {
+      if((source[i]&0x3f)==0) emit_fadd(0);
+      if((source[i]&0x3f)==1) emit_fsub(0);
+      if((source[i]&0x3f)==2) emit_fmul(0);
+      if((source[i]&0x3f)==3) emit_fdiv(0);
+    }
+    if(opcode2[i]==0x10) {
+      if(((source[i]>>16)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_simple[(source[i]>>6)&0x1f],temp);
+      }
+      emit_fstps(temp);
+    }
+    if(opcode2[i]==0x11) {
+      if(((source[i]>>16)&0x1f)!=((source[i]>>6)&0x1f)) {
+        emit_readptr((intptr_t)&reg_cop1_double[(source[i]>>6)&0x1f],temp);
+      }
+      emit_fstpl(temp);
+    }
+    return;
+  }
+}
+
+static void multdiv_assemble_x64(int i,struct regstat *i_regs)
+{
+  //  case 0x18: MULT
+  //  case 0x19: MULTU
+  //  case 0x1A: DIV
+  //  case 0x1B: DIVU
+  //  case 0x1C: DMULT
+  //  case 0x1D: DMULTU
+  //  case 0x1E: DDIV
+  //  case 0x1F: DDIVU
+  if(rs1[i]&&rs2[i])
+  {
+    if((opcode2[i]&4)==0) // 32-bit
+    {
+      if(opcode2[i]==0x18) // MULT
+      {
+        char m1=get_reg(i_regs->regmap,rs1[i]);
+        char m2=get_reg(i_regs->regmap,rs2[i]);
+        assert(m1>=0);
+        assert(m2>=0);
+        emit_mov(m1,EAX);
+        emit_imul(m2);
+      }
+      if(opcode2[i]==0x19) // MULTU
+      {
+        char m1=get_reg(i_regs->regmap,rs1[i]);
+        char m2=get_reg(i_regs->regmap,rs2[i]);
+        assert(m1>=0);
+        assert(m2>=0);
+        emit_mov(m1,EAX);
+        emit_mul(m2);
+      }
+      if(opcode2[i]==0x1A) // DIV
+      {
+        char d1=get_reg(i_regs->regmap,rs1[i]);
+        char d2=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1>=0);
+        assert(d2>=0);
+        emit_mov(d1,EAX);
+        emit_cdq();
+        emit_test(d2,d2);
+        intptr_t jaddr=(intptr_t)out;
+        emit_jeq(0);
+        emit_idiv(d2);
+        set_jump_target(jaddr,(intptr_t)out);
+      }
+      if(opcode2[i]==0x1B) // DIVU
+      {
+        char d1=get_reg(i_regs->regmap,rs1[i]);
+        char d2=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1>=0);
+        assert(d2>=0);
+        emit_mov(d1,EAX);
+        emit_zeroreg(EDX);
+        emit_test(d2,d2);
+        intptr_t jaddr=(intptr_t)out;
+        emit_jeq(0);
+        emit_div(d2);
+        set_jump_target(jaddr,(intptr_t)out);
+      }
+    }
+    else // 64-bit
+    {
+      if(opcode2[i]==0x1C) // DMULT
+      {
+        char m1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char m1l=get_reg(i_regs->regmap,rs1[i]);
+        char m2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char m2l=get_reg(i_regs->regmap,rs2[i]);
+        char temp=get_reg(i_regs->regmap,-1);
+
+        assert((m1h>=0)&&(m1h!=EAX)&&(m1h!=EDX));
+        assert((m2h>=0)&&(m2h!=EAX)&&(m2h!=EDX));
+        assert((m1l>=0)&&(m1l!=EAX)&&(m1l!=EDX));
+        assert((m2l>=0)&&(m2l!=EAX)&&(m2l!=EDX));
+        assert((temp>=0)&&(temp!=EAX)&&(temp!=EDX));
+
+        // Multiply m2l*m1l
+        emit_mov(m1l,EAX);
+        emit_mul(m2l);
+        emit_storereg(LOREG,EAX);
+        emit_mov(EDX,temp);
+
+        // Multiply m2l*m1h
+        emit_mov(m1h,EAX);
+        emit_mul(m2l);
+        emit_add(EAX,temp,temp);
+        emit_adcimm(0,EDX);
+        emit_storereg(HIREG,EDX);
+
+        // Multiply m2h*m1l
+        emit_mov(m1l,EAX);
+        emit_mul(m2h);
+        emit_add(EAX,temp,temp);
+        emit_adcimm(0,EDX);
+        emit_storereg(LOREG|64,temp);
+        emit_mov(EDX,temp);
+
+        // Multiply m2h*m1h
+        emit_mov(m1h,EAX);
+        emit_mul(m2h);
+        emit_add(EAX,temp,EAX);
+        emit_adcimm(0,EDX);
+        emit_loadreg(HIREG,temp);
+        emit_add(EAX,temp,EAX);
+        emit_adcimm(0,EDX);
+
+        // If m1<0 subtract m2 from the high 64bit part
+        intptr_t jaddr;
+        emit_testimm(m1h,0x80000000);
+        jaddr=(intptr_t)out;
+        emit_jeq(0);
+        emit_sub(EAX,m2l,EAX);
+        emit_sbb(m2h,EDX);
+        set_jump_target(jaddr,(intptr_t)out);
+
+        // If m2<0 subtract m1 from the high 64bit part
+        emit_testimm(m2h,0x80000000);
+        jaddr=(intptr_t)out;
+        emit_jeq(0);
+        emit_sub(EAX,m1l,EAX);
+        emit_sbb(m1h,EDX);
+        set_jump_target(jaddr,(intptr_t)out);
+      }
+      if(opcode2[i]==0x1D) // DMULTU
+      {
+        char m1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char m1l=get_reg(i_regs->regmap,rs1[i]);
+        char m2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char m2l=get_reg(i_regs->regmap,rs2[i]);
+        char temp=get_reg(i_regs->regmap,-1);
+
+        assert((m1h>=0)&&(m1h!=EAX)&&(m1h!=EDX));
+        assert((m2h>=0)&&(m2h!=EAX)&&(m2h!=EDX));
+        assert((m1l>=0)&&(m1l!=EAX)&&(m1l!=EDX));
+        assert((m2l>=0)&&(m2l!=EAX)&&(m2l!=EDX));
+        assert((temp>=0)&&(temp!=EAX)&&(temp!=EDX));
+
+        // Multiply m2l*m1l
+        emit_mov(m1l,EAX);
+        emit_mul(m2l);
+        emit_storereg(LOREG,EAX);
+        emit_mov(EDX,temp);
+
+        // Multiply m2l*m1h
+        emit_mov(m1h,EAX);
+        emit_mul(m2l);
+        emit_add(EAX,temp,temp);
+        emit_adcimm(0,EDX);
+        emit_storereg(HIREG,EDX);
+
+        // Multiply m2h*m1l
+        emit_mov(m1l, EAX);
+        emit_mul(m2h);
+        emit_add(EAX,temp,temp);
+        emit_adcimm(0,EDX);
+        emit_storereg(LOREG|64,temp);
+        emit_mov(EDX,temp);
+
+        // Multiply m2h*m1h
+        emit_mov(m1h,EAX);
+        emit_mul(m2h);
+        emit_add(EAX,temp,EAX);
+        emit_adcimm(0, EDX);
+        emit_loadreg(HIREG,temp);
+        emit_add(EAX,temp,EAX);
+        emit_adcimm(0,EDX);
+      }
+      if(opcode2[i]==0x1E) // DDIV
+      {
+        char d1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char d1l=get_reg(i_regs->regmap,rs1[i]);
+        char d2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char d2l=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1h>=0);
+        assert(d2h>=0);
+        assert(d1l>=0);
+        assert(d2l>=0);
+        emit_pusha();
+        emit_loaddword_pusha(d1h,d1l,EDI);
+        emit_loaddword_pusha(d2h,d2l,ESI);
+        emit_call((intptr_t)&div64);
+        emit_popa();
+        char hih=get_reg(i_regs->regmap,HIREG|64);
+        char hil=get_reg(i_regs->regmap,HIREG);
+        char loh=get_reg(i_regs->regmap,LOREG|64);
+        char lol=get_reg(i_regs->regmap,LOREG);
+        if(hih>=0) emit_loadreg(HIREG|64,hih);
+        if(hil>=0) emit_loadreg(HIREG,hil);
+        if(loh>=0) emit_loadreg(LOREG|64,loh);
+        if(lol>=0) emit_loadreg(LOREG,lol);
+      }
+      if(opcode2[i]==0x1F) // DDIVU
+      {
+        char d1h=get_reg(i_regs->regmap,rs1[i]|64);
+        char d1l=get_reg(i_regs->regmap,rs1[i]);
+        char d2h=get_reg(i_regs->regmap,rs2[i]|64);
+        char d2l=get_reg(i_regs->regmap,rs2[i]);
+        assert(d1h>=0);
+        assert(d2h>=0);
+        assert(d1l>=0);
+        assert(d2l>=0);
+        emit_pusha();
+        emit_loaddword_pusha(d1h,d1l,EDI);
+        emit_loaddword_pusha(d2h,d2l,ESI);
+        emit_call((intptr_t)&divu64);
+        emit_popa();
+        char hih=get_reg(i_regs->regmap,HIREG|64);
+        char hil=get_reg(i_regs->regmap,HIREG);
+        char loh=get_reg(i_regs->regmap,LOREG|64);
+        char lol=get_reg(i_regs->regmap,LOREG);
+        if(hih>=0) emit_loadreg(HIREG|64,hih);
+        if(hil>=0) emit_loadreg(HIREG,hil);
+        if(loh>=0) emit_loadreg(LOREG|64,loh);
+        if(lol>=0) emit_loadreg(LOREG,lol);
+      }
+    }
+  }
+  else
+  {
+    // Multiply by zero is zero.
+    // MIPS does not have a divide by zero exception.
+    // The result is undefined, we return zero.
+    char hr=get_reg(i_regs->regmap,HIREG);
+    char lr=get_reg(i_regs->regmap,LOREG);
+    if(hr>=0) emit_zeroreg(hr);
+    if(lr>=0) emit_zeroreg(lr);
+  }
+}
+#define multdiv_assemble multdiv_assemble_x64
+
+static void do_preload_rhash(int r) {
+  emit_movimm(0xf8,r);
+}
+
+static void do_preload_rhtbl(int r) {
+  // Don't need this for x86
+}
+
+static void do_rhash(int rs,int rh) {
+  emit_and(rs,rh,rh);
+}
+
+static void do_miniht_load(int ht,int rh) {
+  // Don't need this for x86.  The load and compare can be combined into
+  // a single instruction (below)
+}
+
+static void do_miniht_jump(int rs,int rh,int ht) {
+  emit_loadaddr((intptr_t)mini_ht,HOST_SCRATCH);
+  assem_debug("cmp (%%r14,%%%s,2),%%%s",regname[rh],regname[rs]);
+  output_mem_op(0,0,0x39,rs,HOST_SCRATCH,rh,1,0,0,0);
+  emit_jne(jump_vaddr_reg[rs]);
+  assem_debug("jmp *8(%%r14,%%%s,2)",regname[rh]);
+  output_mem_op(0,0,0xFF,4,HOST_SCRATCH,rh,1,8,0,0);
+}
+
+// The return address is loaded with lea, which the linker patches
+// (see set_jump_target)
+static void do_miniht_insert(int return_address,int rt,int temp) {
+  emit_movimm(return_address,rt); // PC into link register
+  emit_writeptr(rt,(intptr_t)&mini_ht[(return_address&0xFF)>>3][0]);
+  add_to_linker((intptr_t)out,return_address,1);
+  assem_debug("lea 0(%%rip),%%r14");
+  output_byte(0x4c);
+  output_byte(0x8d);
+  output_byte(0x35);
+  output_w32(0);
+  emit_writeptr(HOST_SCRATCH,(intptr_t)&mini_ht[(return_address&0xFF)>>3][1]);
+}
+
+// Indirect jump through an inline cache slot.  On a hit this jumps
+// straight to the cached block, otherwise jump_vaddr_ic looks up the
+// target and refills the slot (passed in %r14).
+static void do_jr_ic_jump(int rs,uintptr_t *slot) {
+  intptr_t jaddr;
+  assem_debug("cmp %llx,%%%s",(long long)(intptr_t)&slot[0],regname[rs]);
+  output_abs_op(0,0,0x39,rs,(intptr_t)&slot[0],0,0);
+  jaddr=(intptr_t)out;
+  emit_jne(0);
+  assem_debug("jmp *%llx",(long long)(intptr_t)&slot[1]);
+  output_abs_op(0,0,0xFF,4,(intptr_t)&slot[1],0,0);
+  set_jump_target(jaddr,(intptr_t)out);
+  emit_loadaddr((intptr_t)slot,HOST_SCRATCH);
+  if(rs!=EDI) emit_mov(rs,EDI);
+  emit_jmp((intptr_t)jump_vaddr_ic);
+}
+
+// We don't need this for x86
+static void literal_pool(int n) {}
+static void literal_pool_jumpover(int n) {}
+
+// CPU-architecture-specific initialization, not needed for x86
+static void arch_init() {}
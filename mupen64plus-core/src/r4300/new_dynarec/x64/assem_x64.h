@@ -0,0 +1,40 @@
+#ifndef M64P_R4300_ASSEM_X64_H
+#define M64P_R4300_ASSEM_X64_H
+
+#define HOST_REGS 14
+#define HOST_CCREG 13
+#define HOST_BTREG 12
+#define EXCLUDE_REG 4
+#define HOST_RAM_REG 15 // g_rdram-0x80000000, set up by new_dyna_start
+
+//#define IMM_PREFETCH 1
+#define HOST_IMM_ADDR32 1
+#define INVERTED_CARRY 1
+#define DESTRUCTIVE_WRITEBACK 1
+#define DESTRUCTIVE_SHIFT 1
+
+#define USE_MINI_HT 1
+#define USE_JR_IC 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+extern void *base_addr; // Code generator target address
+extern char extra_memory[134217728];
+#ifdef __cplusplus
+}
+#endif
+
+#define TARGET_SIZE_2 27 // 2^27 = 128 megabytes, see new_dynarec_set_cache_size
+#define JUMP_TABLE_SIZE 0 // Not needed, everything is within +/-2G of the cache
+
+// The translation cache lives in .bss so that it is within rel32 range
+// of the emulator's own code and data
+#define BASE_ADDR ((intptr_t)(&extra_memory))
+
+/* x86-64 calling convention (System V):
+   caller-save: %rax %rcx %rdx %rsi %rdi %r8 %r9 %r10 %r11
+   callee-save: %rbx %rbp %r12 %r13 %r14 %r15
+   %r14 is the emitter's scratch register and is never allocated */
+
+#endif /* M64P_R4300_ASSEM_X64_H */
@@ -27,9 +27,10 @@ int pending_exception;
 int branch_target;
 uint64_t readmem_dword;
 static precomp_instr fake_pc;
-u_int memory_map[1048576];
+uintptr_t memory_map[1048576];
 ALIGN(8, static u_int mini_ht[32][2]);
 ALIGN(4, u_char restore_candidate[512]);
+u_int tc_used[8];
 
 #ifdef __cplusplus
 extern "C" {
@@ -133,6 +134,7 @@ void *dynamic_linker(void * src, u_int vaddr)
       assert((*(int*)((u_int)ptr2+5)&0xFF)==0x68);  //push
       assert((*(int*)((u_int)ptr2+10)&0xFF)==0xE8); //call
       add_link(vaddr, ptr2);
+      tc_touch(head->addr);
       u_int offset=(u_int)head->addr-(u_int)ptr-4;
       *ptr=offset;
       return head->addr;
@@ -140,7 +142,7 @@ void *dynamic_linker(void * src, u_int vaddr)
     head=head->next;
   }
 
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
   if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
 
@@ -149,7 +151,7 @@ void *dynamic_linker(void * src, u_int vaddr)
     if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
       //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(!tc_expiring((uintptr_t)head->addr)) {
         if(verify_dirty(head->addr)) {
           //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
           invalid_code[vaddr>>12]=0;
@@ -162,7 +164,7 @@ void *dynamic_linker(void * src, u_int vaddr)
             restore_candidate[vpage>>3]|=1<<(vpage&7);
           }
           else restore_candidate[page>>3]|=1<<(page&7);
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==vaddr) {
             ht_bin[1]=(int)head->addr; // Replace existing entry
           }
@@ -211,6 +213,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
       assert((*(int*)((u_int)ptr2+5)&0xFF)==0x68);  //push
       assert((*(int*)((u_int)ptr2+10)&0xFF)==0xE8); //call
       add_link(vaddr, ptr2);
+      tc_touch(head->addr);
       u_int offset=(u_int)head->addr-(u_int)ptr-4;
       *ptr=offset;
       return head->addr;
@@ -218,7 +221,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
     head=head->next;
   }
 
-  u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+  uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
   if(ht_bin[0]==vaddr) return (void *)ht_bin[1];
   if(ht_bin[2]==vaddr) return (void *)ht_bin[3];
 
@@ -227,7 +230,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
     if(head->vaddr==vaddr&&head->reg_sv_flags==0) {
       //DebugMessage(M64MSG_VERBOSE, "TRACE: count=%d next=%d (get_addr match dirty %x: %x)",g_cp0_regs[CP0_COUNT_REG],next_interupt,vaddr,(int)head->addr);
       // Don't restore blocks which are about to expire from the cache
-      if((((u_int)head->addr-(u_int)out)<<(32-TARGET_SIZE_2))>0x60000000+(MAX_OUTPUT_BLOCK_SIZE<<(32-TARGET_SIZE_2))) {
+      if(!tc_expiring((uintptr_t)head->addr)) {
         if(verify_dirty(head->addr)) {
           //DebugMessage(M64MSG_VERBOSE, "restore candidate: %x (%d) d=%d",vaddr,page,invalid_code[vaddr>>12]);
           invalid_code[vaddr>>12]=0;
@@ -240,7 +243,7 @@ void *dynamic_linker_ds(void * src, u_int vaddr)
             restore_candidate[vpage>>3]|=1<<(vpage&7);
           }
           else restore_candidate[page>>3]|=1<<(page&7);
-          u_int *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
+          uintptr_t *ht_bin=hash_table[((vaddr>>16)^vaddr)&0xFFFF];
           if(ht_bin[0]==vaddr) {
             ht_bin[1]=(int)head->addr; // Replace existing entry
           }
@@ -328,7 +331,7 @@ static int isclean(int addr)
   return 0;
 }
 
-static void get_bounds(int addr,u_int *start,u_int *end)
+static void get_bounds(int addr,uintptr_t *start,uintptr_t *end)
 {
   u_char *ptr=(u_char *)addr;
   assert(ptr[5]==0xB8);
@@ -1970,6 +1973,11 @@ static void emit_readword(int addr, int rt)
   output_modrm(0,5,rt);
   output_w32(addr);
 }
+// Pointers are 32 bits on this host
+static void emit_readptr(int addr, int rt)
+{
+  emit_readword(addr,rt);
+}
 static void emit_readword_indexed(int addr, int rs, int rt)
 {
   assem_debug("mov %x+%%%s,%%%s",addr,regname[rs],regname[rt]);
@@ -3248,7 +3256,7 @@ static int do_tlb_r(int s,int ar,int map,int cache,int x,int a,int shift,int c,u
   }
   return map;
 }
-static int do_tlb_r_branch(int map, int c, u_int addr, int *jaddr)
+static int do_tlb_r_branch(int map, int c, u_int addr, intptr_t *jaddr)
 {
   if(!c||(signed int)addr>=(signed int)0xC0000000) {
     emit_test(map,map);
@@ -3284,7 +3292,7 @@ static int do_tlb_w(int s,int ar,int map,int cache,int x,int c,u_int addr)
   emit_shlimm(map,2,map);
   return map;
 }
-static void do_tlb_w_branch(int map, int c, u_int addr, int *jaddr)
+static void do_tlb_w_branch(int map, int c, u_int addr, intptr_t *jaddr)
 {
   if(!c||addr<0x80800000||addr>=0xC0000000) {
     *jaddr=(int)out;
@@ -3451,7 +3459,7 @@ static void loadlr_assemble_x86(int i,struct regstat *i_regs)
 {
   int s,th,tl,temp,temp2,addr,map=-1;
   int offset;
-  int jaddr=0;
+  intptr_t jaddr=0;
   int memtarget,c=0;
   u_int hr,reglist=0;
   th=get_reg(i_regs->regmap,rt1[i]|64);
@@ -127,6 +127,7 @@ void r4300_reset_hard(void)
         tlb_LUT_r[i] = 0;
         tlb_LUT_w[i] = 0;
     }
+    ++tlb_LUT_generation;
     llbit=0;
     hi=0;
     lo=0;
@@ -27,6 +27,8 @@
 #include "r4300.h"
 #include "recomp.h"
 
+#include "../ri/rdram.h"
+
 void init_r4300(struct r4300_core* r4300)
 {
     init_mi(&r4300->mi);
@@ -89,6 +91,45 @@ void invalidate_r4300_cached_code(uint32_t address, size_t size)
       invalidate_cached_code_hacktarux(address, size);
 }
 
+void invalidate_r4300_dirty_code(struct rdram* rdram, uint32_t address, size_t size)
+{
+   uint32_t end;
+
+   if (size == 0)
+      return;
+
+   address &= 0x7fffff;
+   end = address + size;
+   if (end > 0x800000)
+      end = 0x800000;
+
+   while (address < end)
+   {
+      uint32_t next = (address | ((1 << RDRAM_PAGE_SHIFT) - 1)) + 1;
+      if (next > end)
+         next = end;
+
+      if (test_and_clear_rdram_dirty(rdram, address, RDRAM_DIRTY_CODE))
+      {
+         invalidate_r4300_cached_code(0x80000000 + address, next - address);
+         invalidate_r4300_cached_code(0xa0000000 + address, next - address);
+      }
+
+      address = next;
+   }
+}
+
+int track_r4300_rdram_writes(void)
+{
+#ifdef NEW_DYNAREC
+   if (r4300emu == CORE_DYNAREC)
+      return new_dynarec_trap_rdram_writes();
+#endif
+   /* interpreters go through write_rdram_dram, the old dynarec
+    * stores straight into RDRAM */
+   return r4300emu != CORE_DYNAREC;
+}
+
 /* XXX: not really a good interface but it gets the job done... */
 void savestates_load_set_pc(uint32_t pc)
 {
@@ -57,6 +57,20 @@ unsigned int get_r4300_emumode(void);
  */
 void invalidate_r4300_cached_code(uint32_t address, size_t size);
 
+struct rdram;
+
+/* Invalidate cached code for the pages of the RDRAM range
+ * [address, address+size[ which are flagged RDRAM_DIRTY_CODE,
+ * through both cached and uncached KSEG mirrors.
+ */
+void invalidate_r4300_dirty_code(struct rdram* rdram, uint32_t address, size_t size);
+
+/* Returns 1 if every RDRAM write of the r4300 emulator since the previous
+ * call was flagged RDRAM_DIRTY_SAVESTATE in the RDRAM dirty map, 0 if
+ * some may have bypassed it (e.g. inline stores of recompiled code).
+ */
+int track_r4300_rdram_writes(void);
+
 
 /* Jump to the given address. This works for all r4300 emulator, but is slower.
  * Use this for common code which can be executed from any r4300 emulator. */
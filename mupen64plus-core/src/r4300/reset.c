@@ -26,7 +26,9 @@
 
 #include "cached_interp.h"
 #include "interupt.h"
+#include "main/main.h"
 #include "memory/memory.h"
+#include "rdp/rdp_core.h"
 #include "r4300.h"
 #include "r4300_core.h"
 #include "reset.h"
@@ -35,6 +37,8 @@ int reset_hard_job = 0;
 
 void reset_hard(void)
 {
+    /* report CPU framebuffer writes before the machine state goes away */
+    flush_framebuffer_writes(&g_dp.fb);
     init_memory();
     r4300_reset_hard();
     r4300_reset_soft();
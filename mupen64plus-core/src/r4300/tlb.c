@@ -29,11 +29,14 @@ tlb tlb_e[32];
 
 uint32_t tlb_LUT_r[0x100000];
 uint32_t tlb_LUT_w[0x100000];
+unsigned int tlb_LUT_generation;
 
 void tlb_unmap(tlb *entry)
 {
     unsigned int i;
 
+    ++tlb_LUT_generation;
+
     if (entry->v_even)
     {
         for (i=entry->start_even; i<entry->end_even; i += 0x1000)
@@ -57,6 +60,8 @@ void tlb_map(tlb *entry)
 {
     unsigned int i;
 
+    ++tlb_LUT_generation;
+
     if (entry->v_even)
     {
         if (entry->start_even < entry->end_even &&
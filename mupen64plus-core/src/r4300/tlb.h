@@ -52,6 +52,8 @@ typedef struct _tlb
 extern tlb tlb_e[32];
 extern uint32_t tlb_LUT_r[0x100000];
 extern uint32_t tlb_LUT_w[0x100000];
+/* bumped whenever tlb_LUT_r/tlb_LUT_w are modified */
+extern unsigned int tlb_LUT_generation;
 
 void tlb_unmap(tlb *entry);
 void tlb_map(tlb *entry);
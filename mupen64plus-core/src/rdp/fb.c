@@ -25,10 +25,19 @@
 #include "../memory/memory.h"
 #include "../plugin/plugin.h"
 #include "../r4300/r4300_core.h"
+#include "../ri/rdram.h"
 #include "../ri/ri_controller.h"
 
 extern int fast_memory;
 
+/* CPU reads of framebuffers ask the gfx plugin to copy them back first */
+static int fb_readback = 1;
+
+void set_framebuffer_readback(int enable)
+{
+    fb_readback = enable;
+}
+
 #include <string.h>
 
 void init_fb(struct fb* fb)
@@ -38,51 +47,114 @@ void init_fb(struct fb* fb)
 }
 
 
-static void pre_framebuffer_read(struct fb* fb, uint32_t address)
+static const struct fb_range* find_fb_range(const struct fb* fb, uint32_t address)
 {
     size_t i;
 
+    address &= 0x7FFFFF;
+
+    for(i = 0; i < fb->ranges_count; ++i)
+    {
+        if (address < fb->ranges[i].start)
+            break;
+        if (address <= fb->ranges[i].end)
+            return &fb->ranges[i];
+    }
+
+    return NULL;
+}
+
+/* sort and merge framebuffer extents so that lookups can stop early */
+static void build_fb_ranges(struct fb* fb)
+{
+    size_t i, j;
+
+    fb->ranges_count = 0;
+
     for(i = 0; i < FB_INFOS_COUNT; ++i)
     {
-        if (fb->infos[i].addr)
+        struct fb_range r;
+
+        if (!fb->infos[i].addr
+         || fb->infos[i].width*fb->infos[i].height*fb->infos[i].size == 0)
+            continue;
+
+        r.start = fb->infos[i].addr & 0x7FFFFF;
+        r.end   = r.start + fb->infos[i].width*
+                  fb->infos[i].height*
+                  fb->infos[i].size - 1;
+
+        for(j = fb->ranges_count; j > 0 && fb->ranges[j-1].start > r.start; --j)
+            fb->ranges[j] = fb->ranges[j-1];
+        fb->ranges[j] = r;
+        ++fb->ranges_count;
+    }
+
+    for(i = 1, j = 0; i < fb->ranges_count; ++i)
+    {
+        if (fb->ranges[i].start <= fb->ranges[j].end + 1)
         {
-            unsigned int start = fb->infos[i].addr & 0x7FFFFF;
-            unsigned int end   = start + fb->infos[i].width*
-                               fb->infos[i].height*
-                               fb->infos[i].size - 1;
-
-            if ((address & 0x7FFFFF) >= start && (address & 0x7FFFFF) <= end &&
-                    fb->dirty_page[(address & 0x7FFFFF)>>12])
-            {
-                gfx.fBRead(address);
-                fb->dirty_page[(address & 0x7FFFFF)>>12] = 0;
-            }
+            if (fb->ranges[i].end > fb->ranges[j].end)
+                fb->ranges[j].end = fb->ranges[i].end;
         }
+        else
+            fb->ranges[++j] = fb->ranges[i];
+    }
+
+    if (fb->ranges_count > 0)
+        fb->ranges_count = j + 1;
+}
+
+void flush_framebuffer_writes(struct fb* fb)
+{
+    fb->write_burst = 0;
+
+    if (fb->pending_write_size == 0)
+        return;
+
+    gfx.fBWrite(fb->pending_write_address, fb->pending_write_size);
+    fb->pending_write_size = 0;
+}
+
+static void pre_framebuffer_read(struct fb* fb, struct rdram* rdram, uint32_t address)
+{
+    /* most accesses hit pages which have no pending readback */
+    if (!(rdram_dirty_flags(rdram, address) & RDRAM_DIRTY_FB_READ))
+        return;
+
+    if (find_fb_range(fb, address) != NULL)
+    {
+        /* let the plugin see CPU writes before it copies back */
+        flush_framebuffer_writes(fb);
+        gfx.fBRead(address);
+        clear_rdram_dirty(rdram, address, 1, RDRAM_DIRTY_FB_READ);
     }
 }
 
 static void pre_framebuffer_write(struct fb* fb, uint32_t address)
 {
-    size_t i;
+    if (find_fb_range(fb, address) == NULL)
+        return;
 
-    for(i = 0; i < FB_INFOS_COUNT; ++i)
+    /* extend the current burst, or report it and start a new one */
+    if (fb->write_burst
+     && address == fb->pending_write_address + fb->pending_write_size)
     {
-        if (fb->infos[i].addr)
-        {
-            unsigned int start = fb->infos[i].addr & 0x7FFFFF;
-            unsigned int end   = start + fb->infos[i].width*
-                               fb->infos[i].height*
-                               fb->infos[i].size - 1;
-            if ((address & 0x7FFFFF) >= start && (address & 0x7FFFFF) <= end)
-                gfx.fBWrite(address, 4);
-        }
+        fb->pending_write_size += 4;
+        return;
     }
+
+    flush_framebuffer_writes(fb);
+    gfx.fBWrite(address, 4);
+    fb->write_burst = 1;
+    fb->pending_write_address = address + 4;
+    fb->pending_write_size = 0;
 }
 
 int read_rdram_fb(void* opaque, uint32_t address, uint32_t* value)
 {
     struct rdp_core* dp = (struct rdp_core*)opaque;
-    pre_framebuffer_read(&dp->fb, address);
+    pre_framebuffer_read(&dp->fb, &dp->ri->rdram, address);
     return read_rdram_dram(dp->ri, address, value);
 }
 
@@ -110,48 +182,41 @@ void protect_framebuffers(struct rdp_core* dp)
     if (!gfx.fBRead && gfx.fBWrite)
        return;
 
-    if (fb->infos[0].addr)
+    flush_framebuffer_writes(fb);
+    build_fb_ranges(fb);
+
+    if (fb->ranges_count > 0)
     {
        size_t i;
-       for(i = 0; i < FB_INFOS_COUNT; ++i)
+       for(i = 0; i < fb->ranges_count; ++i)
        {
-          if (fb->infos[i].addr)
+          int j;
+          int start1 = fb->ranges[i].start;
+          int end1   = fb->ranges[i].end;
+          int start  = start1 >> 16;
+          int end    = end1 >> 16;
+
+          for (j = start; j <= end; j++)
           {
-             int j;
-             int start  = fb->infos[i].addr & 0x7FFFFF;
-             int end    = start + fb->infos[i].width*
-                fb->infos[i].height*
-                fb->infos[i].size - 1;
-             int start1 = start;
-             int end1   = end;
-
-             start >>= 16;
-             end   >>= 16;
-
-             for (j = start; j <= end; j++)
-             {
-                map_region(0x8000+j, M64P_MEM_RDRAM, RW(rdramFB));
-                map_region(0xa000+j, M64P_MEM_RDRAM, RW(rdramFB));
-             }
-
-             start <<= 4;
-             end   <<= 4;
-
-             for (j=start; j<=end; j++)
-             {
-                if (j >= start1 && j <= end1)
-                   fb->dirty_page[j] = 1;
-                else
-                   fb->dirty_page[j] = 0;
-             }
-
-             if (fb->once != 0)
-             {
-                fb->once = 0;
-                fast_memory = 0;
-                invalidate_r4300_cached_code(0, 0);
-             }
+             map_region(0x8000+j, M64P_MEM_RDRAM, RW(rdramFB));
+             map_region(0xa000+j, M64P_MEM_RDRAM, RW(rdramFB));
           }
+
+          clear_rdram_dirty(&dp->ri->rdram, start << 16, (end - start + 1) << 16, RDRAM_DIRTY_FB_READ);
+       }
+
+       /* only pages overlapping a framebuffer need a readback within the
+        * remapped 64KB regions. Ranges may share a 64KB region, so this
+        * is done once every region has been cleared */
+       for(i = 0; fb_readback && i < fb->ranges_count; ++i)
+          mark_rdram_dirty(&dp->ri->rdram, fb->ranges[i].start,
+                fb->ranges[i].end - fb->ranges[i].start + 1, RDRAM_DIRTY_FB_READ);
+
+       if (fb->once != 0)
+       {
+          fb->once = 0;
+          fast_memory = 0;
+          invalidate_r4300_cached_code(0, 0);
        }
     }
 }
@@ -165,27 +230,22 @@ void unprotect_framebuffers(struct rdp_core* dp)
     if (!gfx.fBRead && gfx.fBWrite)
        return;
     
-    if (fb->infos[0].addr)
+    flush_framebuffer_writes(fb);
+
+    if (fb->ranges_count > 0)
     {
        size_t i;
 
-       for(i = 0; i < FB_INFOS_COUNT; ++i)
+       for(i = 0; i < fb->ranges_count; ++i)
        {
-          if (fb->infos[i].addr)
+          int j;
+          int start = fb->ranges[i].start >> 16;
+          int end   = fb->ranges[i].end >> 16;
+
+          for (j = start; j <= end; j++)
           {
-             int j;
-             int start = fb->infos[i].addr & 0x7FFFFF;
-             int end   = start + fb->infos[i].width *
-                fb->infos[i].height*
-                fb->infos[i].size - 1;
-             start     = start >> 16;
-             end       = end >> 16;
-
-             for (j = start; j <= end; j++)
-             {
-                map_region(0x8000+j, M64P_MEM_RDRAM, RW(rdram));
-                map_region(0xa000+j, M64P_MEM_RDRAM, RW(rdram));
-             }
+             map_region(0x8000+j, M64P_MEM_RDRAM, RW(rdram));
+             map_region(0xa000+j, M64P_MEM_RDRAM, RW(rdram));
           }
        }
     }
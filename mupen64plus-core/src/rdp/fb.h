@@ -22,6 +22,7 @@
 #ifndef M64P_RDP_FB_H
 #define M64P_RDP_FB_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #include "../api/m64p_plugin.h"
@@ -29,17 +30,38 @@
 struct rdp_core;
 
 enum { FB_INFOS_COUNT = 6 };
-enum { FB_DIRTY_PAGES_COUNT = 0x800 };
 
+/* inclusive range of RDRAM offsets covered by framebuffers */
+struct fb_range
+{
+    uint32_t start;
+    uint32_t end;
+};
+
+/* framebuffer pages pending readback are tracked
+ * with RDRAM_DIRTY_FB_READ in the RDRAM dirty map */
 struct fb
 {
-    unsigned char dirty_page[FB_DIRTY_PAGES_COUNT];
     FrameBufferInfo infos[FB_INFOS_COUNT];
+    /* sorted, non-overlapping ranges built from infos */
+    struct fb_range ranges[FB_INFOS_COUNT];
+    size_t ranges_count;
+    /* contiguous CPU writes not yet reported to the gfx plugin.
+     * The first write of a burst is reported right away, as plugins
+     * rendering asynchronously use fBWrite to wait for the RDP */
+    unsigned int write_burst;
+    uint32_t pending_write_address;
+    uint32_t pending_write_size;
     unsigned int once;
 };
 
 void init_fb(struct fb* fb);
 
+/* Lets CPU reads of a framebuffer trigger gfx.fBRead, off by default */
+void set_framebuffer_readback(int enable);
+
+void flush_framebuffer_writes(struct fb* fb);
+
 int read_rdram_fb(void* opaque, uint32_t address, uint32_t* value);
 int write_rdram_fb(void* opaque, uint32_t address, uint32_t value, uint32_t mask);
 
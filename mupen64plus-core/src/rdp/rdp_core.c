@@ -116,6 +116,9 @@ int write_dpc_regs(void* opaque, uint32_t address, uint32_t value, uint32_t mask
          dp->dpc_regs[DPC_CURRENT_REG] = dp->dpc_regs[DPC_START_REG];
          break;
       case DPC_END_REG:
+         /* CPU framebuffer writes after this open a new burst,
+          * which waits for an asynchronous RDP to be done */
+         flush_framebuffer_writes(&dp->fb);
          gfx.processRDPList();
          signal_rcp_interrupt(dp->r4300, MI_INTR_DP);
          break;
@@ -38,6 +38,8 @@ void init_rdram(struct rdram* rdram)
 {
     memset(rdram->regs, 0, RDRAM_REGS_COUNT*sizeof(uint32_t));
     memset(rdram->dram, 0, rdram->dram_size);
+    memset(rdram->dirty, RDRAM_DIRTY_WRITES, RDRAM_PAGES_COUNT);
+    memset(rdram->plugin_written, 0, RDRAM_PAGES_COUNT);
 }
 
 
@@ -78,6 +80,52 @@ int write_rdram_dram(void* opaque, uint32_t address, uint32_t value, uint32_t ma
     uint32_t addr            = RDRAM_DRAM_ADDR(address);
 
     ri->rdram.dram[addr] = MASKED_WRITE(&ri->rdram.dram[addr], value, mask);
+    ri->rdram.dirty[addr >> (RDRAM_PAGE_SHIFT - 2)] |= RDRAM_DIRTY_WRITES;
 
     return 0;
 }
+
+
+void mark_rdram_dirty(struct rdram* rdram, uint32_t address, size_t length, unsigned int flags)
+{
+    size_t page, last;
+
+    if (length == 0)
+        return;
+
+    address &= 0x7fffff;
+    page = address >> RDRAM_PAGE_SHIFT;
+    last = (address + length - 1) >> RDRAM_PAGE_SHIFT;
+    if (last >= RDRAM_PAGES_COUNT)
+        last = RDRAM_PAGES_COUNT - 1;
+
+    for (; page <= last; ++page)
+        rdram->dirty[page] |= flags;
+}
+
+void clear_rdram_dirty(struct rdram* rdram, uint32_t address, size_t length, unsigned int flags)
+{
+    size_t page, last;
+
+    if (length == 0)
+        return;
+
+    address &= 0x7fffff;
+    page = address >> RDRAM_PAGE_SHIFT;
+    last = (address + length - 1) >> RDRAM_PAGE_SHIFT;
+    if (last >= RDRAM_PAGES_COUNT)
+        last = RDRAM_PAGES_COUNT - 1;
+
+    for (; page <= last; ++page)
+        rdram->dirty[page] &= ~flags;
+}
+
+int test_and_clear_rdram_dirty(struct rdram* rdram, uint32_t address, unsigned int flags)
+{
+    uint8_t* dirty = &rdram->dirty[(address & 0x7fffff) >> RDRAM_PAGE_SHIFT];
+    unsigned int set = *dirty & flags;
+
+    *dirty &= ~flags;
+
+    return set != 0;
+}
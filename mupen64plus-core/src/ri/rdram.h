@@ -25,6 +25,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <retro_inline.h>
+
 #ifndef RDRAM_REG
 #define RDRAM_REG(a)    ((a & 0x3ff) >> 2)
 #endif
@@ -48,11 +50,41 @@ enum rdram_registers
     RDRAM_REGS_COUNT
 };
 
+/* RDRAM write tracking, on 4KB pages.
+ * Each page holds a set of flags, one per consumer, so that every
+ * consumer can clear its own flag without disturbing the others.
+ *
+ * The map is not complete: only writes going through the memory
+ * handlers, the DMA engines and new_dynarec trapped pages raise flags.
+ * Inline dynarec stores and plugins writing RDRAM directly don't, except
+ * for what plugins report in plugin_written. Consumers must not take a
+ * clear page as unmodified unless they know all writers are tracked. */
+enum { RDRAM_PAGE_SHIFT = 12 };
+enum { RDRAM_PAGES_COUNT = 0x800000 >> RDRAM_PAGE_SHIFT };
+
+enum rdram_dirty_flags
+{
+    /* written since the last cached code invalidation */
+    RDRAM_DIRTY_CODE      = 0x01,
+    /* written since the last incremental savestate */
+    RDRAM_DIRTY_SAVESTATE = 0x02,
+    /* gfx plugin may hold newer framebuffer content than RDRAM */
+    RDRAM_DIRTY_FB_READ   = 0x04,
+
+    /* flags raised by regular (CPU, DMA) writes */
+    RDRAM_DIRTY_WRITES    = RDRAM_DIRTY_CODE | RDRAM_DIRTY_SAVESTATE
+};
+
 struct rdram
 {
     uint32_t regs[RDRAM_REGS_COUNT];
     uint32_t* dram;
     size_t dram_size;
+    uint8_t dirty[RDRAM_PAGES_COUNT];
+    /* pages written by plugins which report their RDRAM writes (see
+     * setRdramWriteMap), set to 1 from any thread and read back by the
+     * core once the plugin is idle */
+    uint8_t plugin_written[RDRAM_PAGES_COUNT];
 };
 
 
@@ -68,4 +100,13 @@ int write_rdram_regs(void* opaque, uint32_t address, uint32_t value, uint32_t ma
 int read_rdram_dram(void* opaque, uint32_t address, uint32_t* value);
 int write_rdram_dram(void* opaque, uint32_t address, uint32_t value, uint32_t mask);
 
+void mark_rdram_dirty(struct rdram* rdram, uint32_t address, size_t length, unsigned int flags);
+void clear_rdram_dirty(struct rdram* rdram, uint32_t address, size_t length, unsigned int flags);
+int test_and_clear_rdram_dirty(struct rdram* rdram, uint32_t address, unsigned int flags);
+
+static INLINE unsigned int rdram_dirty_flags(const struct rdram* rdram, uint32_t address)
+{
+    return rdram->dirty[(address & 0x7fffff) >> RDRAM_PAGE_SHIFT];
+}
+
 #endif
@@ -39,4 +39,5 @@ void force_detected_rdram_size_hack(void)
         : 0x3f0;
 
     g_ri.rdram.dram[address/4] = g_ri.rdram.dram_size;
+    mark_rdram_dirty(&g_ri.rdram, address, 4, RDRAM_DIRTY_WRITES);
 }
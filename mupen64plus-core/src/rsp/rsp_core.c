@@ -72,6 +72,10 @@ static void dma_sp_read(struct rsp_core* sp, unsigned length, unsigned count, un
         }
         dramaddr+=skip;
     }
+
+    dramaddr = sp->regs[SP_DRAM_ADDR_REG] & 0xffffff;
+    mark_rdram_dirty(&sp->ri->rdram, dramaddr, count * (length + skip), RDRAM_DIRTY_WRITES);
+    invalidate_r4300_dirty_code(&sp->ri->rdram, dramaddr, count * (length + skip));
 }
 
 static void update_sp_status(struct rsp_core* sp, uint32_t w)
@@ -300,7 +304,14 @@ void do_SP_Task(struct rsp_core* sp)
 
         cp0_update_count();
         if (sp->r4300->mi.regs[MI_INTR_REG] & MI_INTR_SP)
-            add_interupt_event(SP_INT, 4000/*500*/);
+        {
+            /* a task still running on a plugin thread is
+             * waited for when its interrupt is raised */
+            unsigned int cycles = rsp.asyncTaskCycles ? rsp.asyncTaskCycles() : 0;
+            add_interupt_event(SP_INT, cycles ? cycles : 4000/*500*/);
+        }
+        else
+            wait_SP_task(sp);
         sp->r4300->mi.regs[MI_INTR_REG] &= ~MI_INTR_SP;
         sp->regs[SP_STATUS_REG] &= ~0x300; /* task done && yielded */
     }
@@ -332,8 +343,18 @@ void do_SP_Task(struct rsp_core* sp)
     sp->regs[SP_STATUS_REG] &= ~0x00000003; /* Clear BROKE and HALT. */
 }
 
+/* Wait for the task the RSP plugin may still be running on its own
+ * thread, so that all its results are in RDRAM. */
+void wait_SP_task(struct rsp_core* sp)
+{
+    if (rsp.syncTask)
+        rsp.syncTask();
+}
+
 void rsp_interrupt_event(struct rsp_core* sp)
 {
+   wait_SP_task(sp);
+
    sp->regs[SP_STATUS_REG] |= 0x203;
 
    if ((sp->regs[SP_STATUS_REG] & 0x40) != 0)
@@ -90,6 +90,7 @@ int read_rsp_regs2(void* opaque, uint32_t address, uint32_t* value);
 int write_rsp_regs2(void* opaque, uint32_t address, uint32_t value, uint32_t mask);
 
 void do_SP_Task(struct rsp_core* sp);
+void wait_SP_task(struct rsp_core* sp);
 
 void rsp_interrupt_event(struct rsp_core* sp);
 
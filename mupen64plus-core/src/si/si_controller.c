@@ -69,6 +69,7 @@ static void dma_si_read(struct si_controller* si)
 
    for (i = 0; i < PIF_RAM_SIZE; i += 4)
       si->ri->rdram.dram[(si->regs[SI_DRAM_ADDR_REG]+i)/4] = sl(*(uint32_t*)(&si->pif.ram[i]));
+   mark_rdram_dirty(&si->ri->rdram, si->regs[SI_DRAM_ADDR_REG], PIF_RAM_SIZE, RDRAM_DIRTY_WRITES);
    cp0_update_count();
 
    if (g_delay_si)
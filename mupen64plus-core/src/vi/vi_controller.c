@@ -26,6 +26,7 @@
 #include "plugin/plugin.h"
 #include "r4300/r4300_core.h"
 #include "r4300/interupt.h"
+#include "rdp/rdp_core.h"
 
 #include <string.h>
 
@@ -105,6 +106,8 @@ int write_vi_regs(void* opaque, uint32_t address,
 
 void vi_vertical_interrupt_event(struct vi_controller* vi)
 {
+   /* report pending CPU framebuffer writes before presenting */
+   flush_framebuffer_writes(&g_dp.fb);
    gfx.updateScreen();
 
    /* allow main module to do things on VI event */
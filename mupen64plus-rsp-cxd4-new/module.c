@@ -431,6 +431,12 @@ EXPORT void CALL API_PREFIX(InitiateRSP)(RSP_INFO Rsp_Info, pu32 CycleCount)
     return;
 }
 
+EXPORT void CALL API_PREFIX(SetRdramWriteMap)(unsigned char* map)
+{
+    DRAM_written = map;
+    return;
+}
+
 EXPORT void CALL API_PREFIX(RomClosed)(void)
 {
     FILE* stream;
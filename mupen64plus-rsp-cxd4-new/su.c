@@ -28,6 +28,7 @@ typedef VECTOR_OPERATION(*p_vector_func)(v16, v16);
 
 pu8 DRAM;
 pu8 DMEM;
+pu8 DRAM_written;
 pu8 IMEM;
 
 NOINLINE void res_S(void)
@@ -269,6 +270,8 @@ void SP_DMA_WRITE(void)
             offC = (count*length + *CR[0x0] + i) & 0x00001FF8ul;
             offD = (count*skip + *CR[0x1] + i) & 0x00FFFFF8ul;
             *(pi64)(DRAM + offD) = *(pi64)(DMEM + offC);
+            if (DRAM_written != NULL)
+                DRAM_written[(offD >> 12) & 0x7FF] = 1;
             i += 0x000008;
         } while (i < length);
     } while (count);
@@ -123,6 +123,7 @@ typedef enum {
 extern RSP_INFO RSP_INFO_NAME;
 extern pu8 DRAM;
 extern pu8 DMEM;
+extern pu8 DRAM_written; /* 4KB page write map given by the core, or NULL */
 extern pu8 IMEM;
 
 extern u8 conf[32];
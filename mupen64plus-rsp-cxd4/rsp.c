@@ -25,6 +25,9 @@ unsigned char rsp_conf[32];
 #include "Rsp_#1.1.h"
 #include "rsp.h"
 #include "m64p_plugin.h"
+#ifdef HAVE_RSP_DUMP
+#include "rsp_dump.h"
+#endif
 #include "su.h"
 #include "vu/vu.h"
 
@@ -489,6 +492,12 @@ static unsigned int run_task_opcode(uint32_t inst, const int opcode)
    return 0;
 }
 
+#ifdef HAVE_RSP_PROFILE
+/* Executed instruction counts, read by the trace replay tool. */
+unsigned long long rsp_profile_instructions;
+unsigned long long rsp_profile_vu[64];
+#endif
+
 NOINLINE void run_task(void)
 {
     PC = FIT_IMEM(*RSP.SP_PC_REG);
@@ -519,6 +528,8 @@ NOINLINE void run_task(void)
        rsp_dump_block("VCC     ", &VCC, sizeof(VCC));
        uint16_t VCE = get_VCE();
        rsp_dump_block("VCE     ", &VCE, sizeof(VCE));
+
+       rsp_dump_rdram(RSP.RDRAM, MAX_DRAM_ADDR + 1);
     }
 #endif
 
@@ -531,6 +542,10 @@ NOINLINE void run_task(void)
 EX:
 #endif
 
+#ifdef HAVE_RSP_PROFILE
+       rsp_profile_instructions++;
+#endif
+
        if (inst >> 25 == 0x25) /* is a VU instruction */
        {
           const int opcode = inst % 64; /* inst.R.func */
@@ -539,6 +554,10 @@ EX:
           const int vt = (inst >> 16) & 31; /* inst.R.rt */
           const int e  = (inst >> 21) & 0xF; /* rs & 0xF */
 
+#ifdef HAVE_RSP_PROFILE
+          rsp_profile_vu[opcode]++;
+#endif
+
           COP2_C2[opcode](vd, vs, vt, e);
 #ifdef INTENSE_DEBUG
           {
@@ -809,6 +828,11 @@ EXPORT void CALL cxd4InitiateRSP(RSP_INFO Rsp_Info, unsigned int *CycleCount)
 
     return;
 }
+EXPORT void CALL cxd4SetRdramWriteMap(unsigned char *map)
+{
+    RDRAM_written = map;
+}
+
 EXPORT void CALL cxd4RomClosed(void)
 {
     *RSP.SP_PC_REG = 0x00000000;
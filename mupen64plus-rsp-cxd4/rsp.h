@@ -16,6 +16,7 @@
 
 #include "Rsp_#1.1.h"
 RSP_INFO RSP;
+unsigned char* RDRAM_written; /* 4KB page write map given by the core, or NULL */
 
 #ifdef _MSC_VER
 #define NOINLINE    __declspec(noinline)
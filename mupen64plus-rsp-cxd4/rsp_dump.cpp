@@ -3,9 +3,24 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <vector>
 
 static FILE *file;
 static bool in_trace;
+static std::vector<uint8_t> rdram_shadow;
+
+#define RDRAM_PAGE_SIZE 0x1000
+
+static void write_mem_block(const char *tag, unsigned base, const void *data, size_t size)
+{
+   uint32_t size_data = size;
+   uint32_t base_data = base;
+
+   fwrite(tag, 1, 8, file);
+   fwrite(&base_data, sizeof(base_data), 1, file);
+   fwrite(&size_data, sizeof(size_data), 1, file);
+   fwrite(data, size, 1, file);
+}
 
 void rsp_open_trace(const char *path)
 {
@@ -22,6 +37,7 @@ void rsp_close_trace(void)
    }
 
    file = nullptr;
+   rdram_shadow.clear();
 }
 
 void rsp_dump_begin_trace(void)
@@ -72,13 +88,8 @@ void rsp_dump_poke_mem(unsigned base, const void *data, size_t size)
 {
    if (!file)
       return;
-   uint32_t size_data = size;
-   uint32_t base_data = base;
 
-   fwrite("POKE    ", 1, 8, file);
-   fwrite(&base_data, sizeof(base_data), 1, file);
-   fwrite(&size_data, sizeof(size_data), 1, file);
-   fwrite(data, size, 1, file);
+   write_mem_block("POKE    ", base, data, size);
 }
 
 void rsp_dump_end_read_dma(void)
@@ -89,3 +100,30 @@ void rsp_dump_end_read_dma(void)
    fwrite("ENDDMA  ", 1, 8, file);
 }
 
+void rsp_dump_rdram(const void *rdram, size_t size)
+{
+   if (!file)
+      return;
+
+   // The first trace gets every non-zero page, then only what changed in between.
+   if (rdram_shadow.size() != size)
+      rdram_shadow.assign(size, 0);
+
+   const uint8_t *src = static_cast<const uint8_t *>(rdram);
+   for (size_t base = 0; base < size; base += RDRAM_PAGE_SIZE)
+   {
+      if (memcmp(&rdram_shadow[base], src + base, RDRAM_PAGE_SIZE) == 0)
+         continue;
+
+      memcpy(&rdram_shadow[base], src + base, RDRAM_PAGE_SIZE);
+      write_mem_block("RDRAM   ", base, src + base, RDRAM_PAGE_SIZE);
+   }
+}
+
+void rsp_dump_write_dma(unsigned base, const void *data, size_t size)
+{
+   if (!file)
+      return;
+
+   write_mem_block("DMAWRITE", base, data, size);
+}
@@ -19,6 +19,11 @@ void rsp_dump_begin_read_dma(void);
 void rsp_dump_poke_mem(unsigned base, const void *data, size_t size);
 void rsp_dump_end_read_dma(void);
 
+/* Records the RDRAM pages which changed since the previous trace, so the
+ * task can be replayed through backends which read RDRAM directly. */
+void rsp_dump_rdram(const void *rdram, size_t size);
+void rsp_dump_write_dma(unsigned base, const void *data, size_t size);
+
 int rsp_dump_recording_trace(void);
 
 #ifdef __cplusplus
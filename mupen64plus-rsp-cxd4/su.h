@@ -236,6 +236,13 @@ static void MT_DMA_WRITE_LENGTH(int rt)
              offC = (count*length + *RSP.SP_MEM_ADDR_REG + i) & 0x00001FF8;
              offD = (count*skip + *RSP.SP_DRAM_ADDR_REG + i) & 0x00FFFFF8;
              *(int64_t*)(RSP.RDRAM + offD) = *(int64_t*)(RSP.DMEM + offC);
+             if (RDRAM_written != NULL)
+                RDRAM_written[(offD >> 12) & 0x7FF] = 1;
+
+#ifdef HAVE_RSP_DUMP
+             rsp_dump_write_dma(offD, RSP.DMEM + offC, sizeof(uint64_t));
+#endif
+
              i += 0x000008;
           } while (i < length);
        } while (count);
@@ -26,6 +26,7 @@
 #include <string.h>
 
 #include "alist.h"
+#include "alist_kernels.h"
 #include "arithmetics.h"
 #include "audio.h"
 #include "hle_external.h"
@@ -78,6 +79,55 @@ static int16_t ramp_step(struct ramp_t* ramp)
     return (int16_t)(ramp->value >> 16);
 }
 
+/* mix count samples of in with the ramping volumes, 8 samples at a time */
+static void alist_envmix_ramps(struct hle_t* hle, size_t n,
+      int16_t* dl, int16_t* dr, int16_t* wl, int16_t* wr,
+      const int16_t* in, size_t count,
+      struct ramp_t* ramps, int16_t dry, int16_t wet)
+{
+   size_t k, x;
+
+   for (k = 0; k + 8 <= count; k += 8)
+   {
+      int16_t  l_vol[8];
+      int16_t  r_vol[8];
+      int16_t* buffers[4];
+
+      for (x = 0; x < 8; ++x)
+      {
+         l_vol[x^S] = ramp_step(&ramps[0]);
+         r_vol[x^S] = ramp_step(&ramps[1]);
+      }
+
+      buffers[0] = dl + k;
+      buffers[1] = dr + k;
+      buffers[2] = wl + k;
+      buffers[3] = wr + k;
+
+      hle->alist_kernels->envmix8(buffers, n, in + k, l_vol, r_vol, dry, wet);
+   }
+
+   for (; k < count; ++k)
+   {
+      int16_t  gains[4];
+      int16_t* buffers[4];
+      int16_t l_vol = ramp_step(&ramps[0]);
+      int16_t r_vol = ramp_step(&ramps[1]);
+
+      buffers[0] = dl + (k^S);
+      buffers[1] = dr + (k^S);
+      buffers[2] = wl + (k^S);
+      buffers[3] = wr + (k^S);
+
+      gains[0] = clamp_s16((l_vol * dry + 0x4000) >> 15);
+      gains[1] = clamp_s16((r_vol * dry + 0x4000) >> 15);
+      gains[2] = clamp_s16((l_vol * wet + 0x4000) >> 15);
+      gains[3] = clamp_s16((r_vol * wet + 0x4000) >> 15);
+
+      alist_envmix_mix(n, buffers, gains, in[k^S]);
+   }
+}
+
 /* global functions */
 void alist_process(struct hle_t* hle, const acmd_callback_t abi[], unsigned int abi_size)
 {
@@ -143,6 +193,7 @@ void alist_save(struct hle_t* hle, uint16_t dmem, uint32_t address, uint16_t cou
     address &= ~7;
     count = align(count, 8);
     memcpy(hle->dram + address, hle->alist_buffer + dmem, count);
+    dram_written(hle, address, count);
 }
 
 void alist_move(struct hle_t* hle, uint16_t dmemo, uint16_t dmemi, uint16_t count)
@@ -248,7 +299,7 @@ void alist_envmix_exp(
     struct ramp_t ramps[2];
     int32_t exp_seq[2];
     int32_t exp_rates[2];
-    int x, y;
+    int y;
     size_t n                = (aux) ? 4 : 2;
 
     const int16_t* const in = (int16_t*)(hle->alist_buffer + dmemi);
@@ -302,26 +353,9 @@ void alist_envmix_exp(
           ramps[1].step = (exp_seq[1] - ramps[1].value) >> 3;
        }
 
-       for (x = 0; x < 8; ++x)
-       {
-          int16_t  gains[4];
-          int16_t* buffers[4];
-          int16_t l_vol = ramp_step(&ramps[0]);
-          int16_t r_vol = ramp_step(&ramps[1]);
-
-          buffers[0] = dl + (ptr^S);
-          buffers[1] = dr + (ptr^S);
-          buffers[2] = wl + (ptr^S);
-          buffers[3] = wr + (ptr^S);
-
-          gains[0] = clamp_s16((l_vol * dry + 0x4000) >> 15);
-          gains[1] = clamp_s16((r_vol * dry + 0x4000) >> 15);
-          gains[2] = clamp_s16((l_vol * wet + 0x4000) >> 15);
-          gains[3] = clamp_s16((r_vol * wet + 0x4000) >> 15);
-
-          alist_envmix_mix(n, buffers, gains, in[ptr^S]);
-          ++ptr;
-       }
+       alist_envmix_ramps(hle, n, dl + ptr, dr + ptr, wl + ptr, wr + ptr,
+             in + ptr, 8, ramps, dry, wet);
+       ptr += 8;
     }
 
     *(int16_t *)(save_buffer +  0) = wet;                       /* 0-1 */
@@ -334,6 +368,7 @@ void alist_envmix_exp(
     *(int32_t *)(save_buffer + 14) = exp_seq[1];                /* 14-15 */
     *(int32_t *)(save_buffer + 16) = (int32_t)ramps[0].value;   /* 12-13 */
     *(int32_t *)(save_buffer + 18) = (int32_t)ramps[1].value;   /* 14-15 */
+    dram_written(hle, address, 40);
 }
 
 void alist_envmix_ge(
@@ -349,7 +384,6 @@ void alist_envmix_ge(
         const int32_t *rate,
         uint32_t address)
 {
-    unsigned k;
     struct ramp_t ramps[2];
     size_t n                = (aux) ? 4 : 2;
 
@@ -383,26 +417,7 @@ void alist_envmix_ge(
         ramps[1].value  = *(int32_t *)(save_buffer + 18);   /* 14-15 */
     }
 
-    count >>= 1;
-    for (k = 0; k < count; ++k)
-    {
-       int16_t  gains[4];
-       int16_t* buffers[4];
-       int16_t l_vol = ramp_step(&ramps[0]);
-       int16_t r_vol = ramp_step(&ramps[1]);
-
-       buffers[0] = dl + (k^S);
-       buffers[1] = dr + (k^S);
-       buffers[2] = wl + (k^S);
-       buffers[3] = wr + (k^S);
-
-       gains[0] = clamp_s16((l_vol * dry + 0x4000) >> 15);
-       gains[1] = clamp_s16((r_vol * dry + 0x4000) >> 15);
-       gains[2] = clamp_s16((l_vol * wet + 0x4000) >> 15);
-       gains[3] = clamp_s16((r_vol * wet + 0x4000) >> 15);
-
-       alist_envmix_mix(n, buffers, gains, in[k^S]);
-    }
+    alist_envmix_ramps(hle, n, dl, dr, wl, wr, in, count >> 1, ramps, dry, wet);
 
     *(int16_t *)(save_buffer +  0) = wet;                       /* 0-1 */
     *(int16_t *)(save_buffer +  2) = dry;                       /* 2-3 */
@@ -414,6 +429,7 @@ void alist_envmix_ge(
  /* *(int32_t *)(save_buffer + 14); */                          /* 14-15 */
     *(int32_t *)(save_buffer + 16) = (int32_t)ramps[0].value;   /* 12-13 */
     *(int32_t *)(save_buffer + 18) = (int32_t)ramps[1].value;   /* 14-15 */
+    dram_written(hle, address, 40);
 }
 
 void alist_envmix_lin(
@@ -428,7 +444,6 @@ void alist_envmix_lin(
         const int32_t *rate,
         uint32_t address)
 {
-    size_t k;
     struct ramp_t ramps[2];
     short *save_buffer = (short*)((uint8_t*)hle->dram + address);
 
@@ -459,25 +474,7 @@ void alist_envmix_lin(
         ramps[1].value  = *(int32_t *)(save_buffer + 18); /* 16-17 */
     }
 
-    count >>= 1;
-    for(k = 0; k < count; ++k) {
-        int16_t  gains[4];
-        int16_t* buffers[4];
-        int16_t l_vol = ramp_step(&ramps[0]);
-        int16_t r_vol = ramp_step(&ramps[1]);
-
-        buffers[0] = dl + (k^S);
-        buffers[1] = dr + (k^S);
-        buffers[2] = wl + (k^S);
-        buffers[3] = wr + (k^S);
-
-        gains[0] = clamp_s16((l_vol * dry + 0x4000) >> 15);
-        gains[1] = clamp_s16((r_vol * dry + 0x4000) >> 15);
-        gains[2] = clamp_s16((l_vol * wet + 0x4000) >> 15);
-        gains[3] = clamp_s16((r_vol * wet + 0x4000) >> 15);
-
-        alist_envmix_mix(4, buffers, gains, in[k^S]);
-    }
+    alist_envmix_ramps(hle, 4, dl, dr, wl, wr, in, count >> 1, ramps, dry, wet);
 
     *(int16_t *)(save_buffer +  0) = wet;                           /* 0-1 */
     *(int16_t *)(save_buffer +  2) = dry;                           /* 2-3 */
@@ -487,6 +484,7 @@ void alist_envmix_lin(
     *(int32_t *)(save_buffer + 10) = (int32_t)ramps[1].step;        /* 10-11 */
     *(int32_t *)(save_buffer + 16) = (int32_t)ramps[0].value;       /* 16-17 */
     *(int32_t *)(save_buffer + 18) = (int32_t)ramps[1].value;       /* 18-19 */
+    dram_written(hle, address, 40);
 }
 
 void alist_envmix_nead(
@@ -516,20 +514,14 @@ void alist_envmix_nead(
 
     while (count)
     {
-       size_t i;
+       int16_t* buffers[4];
 
-       for(i = 0; i < 8; ++i)
-       {
-          int16_t l  = (((int32_t)in[i^S] * (uint32_t)env_values[0]) >> 16) ^ xors[0];
-          int16_t r  = (((int32_t)in[i^S] * (uint32_t)env_values[1]) >> 16) ^ xors[1];
-          int16_t l2 = (((int32_t)l * (uint32_t)env_values[2]) >> 16) ^ xors[2];
-          int16_t r2 = (((int32_t)r * (uint32_t)env_values[2]) >> 16) ^ xors[3];
-
-          dl[i^S] = clamp_s16(dl[i^S] + l);
-          dr[i^S] = clamp_s16(dr[i^S] + r);
-          wl[i^S] = clamp_s16(wl[i^S] + l2);
-          wr[i^S] = clamp_s16(wr[i^S] + r2);
-       }
+       buffers[0] = dl;
+       buffers[1] = dr;
+       buffers[2] = wl;
+       buffers[3] = wr;
+
+       hle->alist_kernels->envmix_nead8(buffers, in, env_values, xors);
 
        env_values[0] += env_steps[0];
        env_values[1] += env_steps[1];
@@ -550,16 +542,7 @@ void alist_mix(struct hle_t* hle, uint16_t dmemo, uint16_t dmemi, uint16_t count
    int16_t       *dst = (int16_t*)(hle->alist_buffer + dmemo);
    const int16_t *src = (int16_t*)(hle->alist_buffer + dmemi);
 
-   count >>= 1;
-
-   while(count)
-   {
-      *dst = sample_mix(dst, *src, gain);
-
-      ++dst;
-      ++src;
-      --count;
-   }
+   hle->alist_kernels->mix(dst, src, count >> 1, gain);
 }
 
 void alist_multQ44(struct hle_t* hle, uint16_t dmem, uint16_t count, int8_t gain)
@@ -624,6 +607,7 @@ static void alist_resample_save(struct hle_t* hle,
     *dram_u16(hle, address + 6) = *sample(hle, pos + 3);
 
     *dram_u16(hle, address + 8) = pitch_accu;
+    dram_written(hle, address, 10);
 }
 
 void alist_resample(
@@ -652,21 +636,8 @@ void alist_resample(
    else
       alist_resample_load(hle, address, ipos, &pitch_accu);
 
-   while (count)
-   {
-      const int16_t* lut = RESAMPLE_LUT + ((pitch_accu & 0xfc00) >> 8);
-
-      *sample(hle, opos++) = clamp_s16( (
-               (*sample(hle, ipos    ) * lut[0]) +
-               (*sample(hle, ipos + 1) * lut[1]) +
-               (*sample(hle, ipos + 2) * lut[2]) +
-               (*sample(hle, ipos + 3) * lut[3]) ) >> 15);
-
-      pitch_accu += pitch;
-      ipos += (pitch_accu >> 16);
-      pitch_accu &= 0xffff;
-      --count;
-   }
+   hle->alist_kernels->resample((int16_t*)hle->alist_buffer, opos, &ipos,
+         &pitch_accu, pitch, count);
 
    alist_resample_save(hle, address, ipos, pitch_accu);
 }
@@ -771,8 +742,10 @@ void alist_adpcm(
 
       dmemi += predict_frame(hle, frame, dmemi, scale);
 
-      adpcm_compute_residuals(last_frame    , frame    , cb_entry, last_frame + 14, 8);
-      adpcm_compute_residuals(last_frame + 8, frame + 8, cb_entry, last_frame + 6 , 8);
+      hle->alist_kernels->filter8(last_frame    , frame    , 1 << 11,
+            cb_entry, cb_entry + 8, cb_entry + 8, last_frame[14], last_frame[15], 11);
+      hle->alist_kernels->filter8(last_frame + 8, frame + 8, 1 << 11,
+            cb_entry, cb_entry + 8, cb_entry + 8, last_frame[6], last_frame[7], 11);
 
       for(i = 0; i < 16; ++i, dmemo += 2)
          *alist_s16(hle, dmemo) = last_frame[i];
@@ -806,6 +779,8 @@ void alist_filter(
       int32_t v = (lutt5[x] + lutt6[x]) >> 1;
       lutt5[x] = lutt6[x] = v;
    }
+   dram_written(hle, lut_address[0], 16);
+   dram_written(hle, lut_address[1], 16);
 
    for (x = 0; x < count; x += 16)
    {
@@ -897,6 +872,7 @@ void alist_filter(
    }
 
    memcpy(hle->dram + address, in2 - 8, 16);
+   dram_written(hle, address, 16);
    memcpy(hle->alist_buffer + dmem, outbuff, count);
 }
 
@@ -935,16 +911,15 @@ void alist_polef(
    do
    {
       int16_t frame[8];
+      int16_t out[8];
 
       for(i = 0; i < 8; ++i, dmemi += 2)
          frame[i] = *alist_s16(hle, dmemi);
 
+      hle->alist_kernels->filter8(out, frame, gain, h1, h2_before, h2, l1, l2, 14);
+
       for(i = 0; i < 8; ++i)
-      {
-         int32_t accu = frame[i] * gain;
-         accu += h1[i]*l1 + h2_before[i]*l2 + rdot(i, h2, frame + i);
-         dst[i^S] = clamp_s16(accu >> 14);
-      }
+         dst[i^S] = out[i];
 
       l1 = dst[6^S];
       l2 = dst[7^S];
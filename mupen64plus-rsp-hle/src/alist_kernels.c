@@ -0,0 +1,639 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - alist_kernels.c                                 *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "alist_kernels.h"
+#include "arithmetics.h"
+#include "audio.h"
+#include "hle_external.h"
+#include "hle_internal.h"
+#include "memory.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ALIST_KERNELS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ALIST_KERNELS_NEON
+#endif
+
+/* run the scalar kernels alongside the SIMD ones and report mismatches */
+#if 0
+#define CHECK_ALIST_KERNELS
+#endif
+
+#define sample(samples, pos)  ((samples) + ((pos) ^ S))
+
+/* scalar kernels, also the reference for the SIMD ones */
+static void mix_scalar(int16_t* dst, const int16_t* src, size_t count, int16_t gain)
+{
+   while (count)
+   {
+      *dst = clamp_s16(*dst + ((*src * gain) >> 15));
+
+      ++dst;
+      ++src;
+      --count;
+   }
+}
+
+/* samples are visited in the order of the original per sample loops,
+ * which only matters when the buffers partially overlap */
+static void envmix8_scalar(int16_t* const* dst, size_t n, const int16_t* in,
+      const int16_t* l_vol, const int16_t* r_vol, int16_t dry, int16_t wet)
+{
+   size_t i, x;
+
+   for (x = 0; x < 8; ++x)
+   {
+      const size_t j = x ^ S;
+      const int16_t src = in[j];
+      int16_t gains[4];
+
+      gains[0] = clamp_s16((l_vol[j] * dry + 0x4000) >> 15);
+      gains[1] = clamp_s16((r_vol[j] * dry + 0x4000) >> 15);
+      gains[2] = clamp_s16((l_vol[j] * wet + 0x4000) >> 15);
+      gains[3] = clamp_s16((r_vol[j] * wet + 0x4000) >> 15);
+
+      for (i = 0; i < n; ++i)
+         dst[i][j] = clamp_s16(dst[i][j] + ((src * gains[i]) >> 15));
+   }
+}
+
+static void envmix_nead8_scalar(int16_t* const* dst, const int16_t* in,
+      const uint16_t* env_values, const int16_t* xors)
+{
+   size_t x;
+
+   for (x = 0; x < 8; ++x)
+   {
+      const size_t j = x ^ S;
+      int16_t l  = (((int32_t)in[j] * (uint32_t)env_values[0]) >> 16) ^ xors[0];
+      int16_t r  = (((int32_t)in[j] * (uint32_t)env_values[1]) >> 16) ^ xors[1];
+      int16_t l2 = (((int32_t)l * (uint32_t)env_values[2]) >> 16) ^ xors[2];
+      int16_t r2 = (((int32_t)r * (uint32_t)env_values[2]) >> 16) ^ xors[3];
+
+      dst[0][j] = clamp_s16(dst[0][j] + l);
+      dst[1][j] = clamp_s16(dst[1][j] + r);
+      dst[2][j] = clamp_s16(dst[2][j] + l2);
+      dst[3][j] = clamp_s16(dst[3][j] + r2);
+   }
+}
+
+static void filter8_scalar(int16_t* dst, const int16_t* src, uint16_t scale,
+      const int16_t* c1, const int16_t* c2, const int16_t* c3,
+      int16_t l1, int16_t l2, unsigned shift)
+{
+   size_t i;
+
+   for (i = 0; i < 8; ++i)
+   {
+      int32_t accu = src[i] * scale;
+      accu += c1[i]*l1 + c2[i]*l2 + rdot(i, c3, src + i);
+      dst[i] = clamp_s16(accu >> shift);
+   }
+}
+
+static INLINE int16_t resample_tap4(const int16_t* samples, uint16_t ipos, const int16_t* lut)
+{
+   return clamp_s16( (
+            (*sample(samples, ipos    ) * lut[0]) +
+            (*sample(samples, ipos + 1) * lut[1]) +
+            (*sample(samples, ipos + 2) * lut[2]) +
+            (*sample(samples, ipos + 3) * lut[3]) ) >> 15);
+}
+
+static void resample_scalar(int16_t* samples, uint16_t opos, uint16_t* ipos,
+      uint32_t* pitch_accu, uint32_t pitch, unsigned count)
+{
+   uint16_t pos  = *ipos;
+   uint32_t accu = *pitch_accu;
+
+   while (count)
+   {
+      const int16_t* lut = RESAMPLE_LUT + ((accu & 0xfc00) >> 8);
+
+      *sample(samples, opos++) = resample_tap4(samples, pos, lut);
+
+      accu += pitch;
+      pos += (accu >> 16);
+      accu &= 0xffff;
+      --count;
+   }
+
+   *ipos       = pos;
+   *pitch_accu = accu;
+}
+
+#if defined(CHECK_ALIST_KERNELS) || !(defined(ALIST_KERNELS_SSE2) || defined(ALIST_KERNELS_NEON))
+static const struct alist_kernels_t scalar_kernels =
+{
+   "scalar",
+   mix_scalar,
+   envmix8_scalar,
+   envmix_nead8_scalar,
+   filter8_scalar,
+   resample_scalar
+};
+#endif
+
+#if defined(ALIST_KERNELS_SSE2) || defined(ALIST_KERNELS_NEON)
+
+/* SIMD kernels. Blocks are processed one buffer at a time instead of one
+ * sample at a time, which gives the same result unless two buffers
+ * partially overlap; such calls go to the scalar kernel. */
+static int blocks_overlap(const int16_t* const* blocks, size_t n)
+{
+   size_t i, j;
+
+   for (i = 0; i < n; ++i)
+   {
+      for (j = i + 1; j < n; ++j)
+      {
+         const ptrdiff_t d = blocks[i] - blocks[j];
+
+         if (d != 0 && d > -8 && d < 8)
+            return 1;
+      }
+   }
+
+   return 0;
+}
+
+#ifdef ALIST_KERNELS_SSE2
+
+/* clamp_s16(dst + ((src * gain) >> 15)) */
+static INLINE __m128i sample_mix_simd(__m128i dst, __m128i src, __m128i gain)
+{
+   const __m128i lo = _mm_mullo_epi16(src, gain);
+   const __m128i hi = _mm_mulhi_epi16(src, gain);
+
+   return _mm_packs_epi32(
+         _mm_add_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 15),
+                       _mm_srai_epi32(_mm_unpacklo_epi16(dst, dst), 16)),
+         _mm_add_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 15),
+                       _mm_srai_epi32(_mm_unpackhi_epi16(dst, dst), 16)));
+}
+
+/* clamp_s16((vol * x + 0x4000) >> 15) */
+static INLINE __m128i envmix_gain_simd(__m128i vol, int16_t x)
+{
+   const __m128i v     = _mm_set1_epi16(x);
+   const __m128i round = _mm_set1_epi32(0x4000);
+   const __m128i lo    = _mm_mullo_epi16(vol, v);
+   const __m128i hi    = _mm_mulhi_epi16(vol, v);
+
+   return _mm_packs_epi32(
+         _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), round), 15),
+         _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), round), 15));
+}
+
+/* (int16_t)((((int32_t)x * (uint32_t)env) >> 16) ^ xor), the high half
+ * of a signed by unsigned product */
+static INLINE __m128i nead_gain_simd(__m128i x, uint16_t env, int16_t xor)
+{
+   const __m128i e = _mm_set1_epi16((int16_t)env);
+   const __m128i y = _mm_sub_epi16(_mm_mulhi_epu16(x, e),
+         _mm_and_si128(_mm_srai_epi16(x, 15), e));
+
+   return _mm_xor_si128(y, _mm_set1_epi16(xor));
+}
+
+typedef __m128i simd16x8;
+
+#define LOAD8(p)        _mm_loadu_si128((const __m128i*)(p))
+#define STORE8(p, v)    _mm_storeu_si128((__m128i*)(p), (v))
+#define ADDS8(a, b)     _mm_adds_epi16((a), (b))
+#define SPLAT8(x)       _mm_set1_epi16(x)
+
+static void filter8_simd(int16_t* dst, const int16_t* src, uint16_t scale,
+      const int16_t* c1, const int16_t* c2, const int16_t* c3,
+      int16_t l1, int16_t l2, unsigned shift)
+{
+   const __m128i x  = LOAD8(src);
+   const __m128i c  = _mm_unpacklo_epi16(LOAD8(c1), LOAD8(c2));
+   const __m128i cc = _mm_unpackhi_epi16(LOAD8(c1), LOAD8(c2));
+   const __m128i l  = _mm_set1_epi32((int)((uint16_t)l1 | ((uint32_t)(uint16_t)l2 << 16)));
+   const __m128i s  = _mm_set1_epi16((int16_t)scale);
+   const __m128i lo = _mm_mullo_epi16(x, s);
+   __m128i hi       = _mm_mulhi_epi16(x, s);
+   __m128i acc_lo, acc_hi, sh;
+
+   /* scale is unsigned */
+   if (scale & 0x8000)
+      hi = _mm_add_epi16(hi, x);
+
+   acc_lo = _mm_add_epi32(_mm_unpacklo_epi16(lo, hi), _mm_madd_epi16(c, l));
+   acc_hi = _mm_add_epi32(_mm_unpackhi_epi16(lo, hi), _mm_madd_epi16(cc, l));
+
+   /* rdot, two taps at a time: lane i gets c3[k] * x[i-k-1] + c3[k+1] * x[i-k-2] */
+#define FILTER8_TAPS(k, lanes_lo) \
+   do { \
+      const __m128i t  = _mm_set1_epi32((int)((uint16_t)c3[k] | ((uint32_t)(uint16_t)c3[k + 1] << 16))); \
+      const __m128i x1 = _mm_slli_si128(x, 2 * (k + 1)); \
+      const __m128i x2 = _mm_slli_si128(x, 2 * (k + 2)); \
+      if (lanes_lo) \
+         acc_lo = _mm_add_epi32(acc_lo, _mm_madd_epi16(_mm_unpacklo_epi16(x1, x2), t)); \
+      acc_hi = _mm_add_epi32(acc_hi, _mm_madd_epi16(_mm_unpackhi_epi16(x1, x2), t)); \
+   } while (0)
+
+   FILTER8_TAPS(0, 1);
+   FILTER8_TAPS(2, 1);
+   FILTER8_TAPS(4, 0);
+   FILTER8_TAPS(6, 0);
+#undef FILTER8_TAPS
+
+   sh = _mm_cvtsi32_si128((int)shift);
+   STORE8(dst, _mm_packs_epi32(_mm_sra_epi32(acc_lo, sh), _mm_sra_epi32(acc_hi, sh)));
+}
+
+/* two resampler outputs, from s[0..3] and s[4..7] */
+static INLINE void resample_pair(int16_t* out, const int16_t* s,
+      const int16_t* lut0, const int16_t* lut1)
+{
+   const __m128i c = _mm_unpacklo_epi64(
+         _mm_loadl_epi64((const __m128i*)lut0),
+         _mm_loadl_epi64((const __m128i*)lut1));
+   __m128i v = _mm_madd_epi16(LOAD8(s), c);
+
+   v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+   v = _mm_srai_epi32(v, 15);
+   v = _mm_packs_epi32(v, v);
+
+   out[0] = (int16_t)_mm_extract_epi16(v, 0);
+   out[1] = (int16_t)_mm_extract_epi16(v, 2);
+}
+
+#else /* ALIST_KERNELS_NEON */
+
+static INLINE int16x8_t sample_mix_simd(int16x8_t dst, int16x8_t src, int16x8_t gain)
+{
+   const int32x4_t lo = vaddw_s16(
+         vshrq_n_s32(vmull_s16(vget_low_s16(src), vget_low_s16(gain)), 15),
+         vget_low_s16(dst));
+   const int32x4_t hi = vaddw_s16(
+         vshrq_n_s32(vmull_s16(vget_high_s16(src), vget_high_s16(gain)), 15),
+         vget_high_s16(dst));
+
+   return vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi));
+}
+
+static INLINE int16x8_t envmix_gain_simd(int16x8_t vol, int16_t x)
+{
+   const int32x4_t round = vdupq_n_s32(0x4000);
+
+   return vcombine_s16(
+         vqmovn_s32(vshrq_n_s32(vaddq_s32(vmull_n_s16(vget_low_s16(vol), x), round), 15)),
+         vqmovn_s32(vshrq_n_s32(vaddq_s32(vmull_n_s16(vget_high_s16(vol), x), round), 15)));
+}
+
+static INLINE int16x8_t nead_gain_simd(int16x8_t x, uint16_t env, int16_t xor)
+{
+   const int32x4_t e = vdupq_n_s32((int32_t)env);
+   const int16x8_t y = vcombine_s16(
+         vshrn_n_s32(vmulq_s32(vmovl_s16(vget_low_s16(x)), e), 16),
+         vshrn_n_s32(vmulq_s32(vmovl_s16(vget_high_s16(x)), e), 16));
+
+   return veorq_s16(y, vdupq_n_s16(xor));
+}
+
+typedef int16x8_t simd16x8;
+
+#define LOAD8(p)        vld1q_s16(p)
+#define STORE8(p, v)    vst1q_s16((p), (v))
+#define ADDS8(a, b)     vqaddq_s16((a), (b))
+#define SPLAT8(x)       vdupq_n_s16(x)
+
+static void filter8_simd(int16_t* dst, const int16_t* src, uint16_t scale,
+      const int16_t* c1, const int16_t* c2, const int16_t* c3,
+      int16_t l1, int16_t l2, unsigned shift)
+{
+   const int16x8_t x    = vld1q_s16(src);
+   const int16x8_t zero = vdupq_n_s16(0);
+   const int32x4_t sh   = vdupq_n_s32(-(int32_t)shift);
+   int32x4_t acc_lo     = vmulq_n_s32(vmovl_s16(vget_low_s16(x)), scale);
+   int32x4_t acc_hi     = vmulq_n_s32(vmovl_s16(vget_high_s16(x)), scale);
+
+   acc_lo = vmlal_n_s16(acc_lo, vld1_s16(c1), l1);
+   acc_lo = vmlal_n_s16(acc_lo, vld1_s16(c2), l2);
+   acc_hi = vmlal_n_s16(acc_hi, vld1_s16(c1 + 4), l1);
+   acc_hi = vmlal_n_s16(acc_hi, vld1_s16(c2 + 4), l2);
+
+   /* rdot: lane i gets c3[k] * x[i-k-1] */
+#define FILTER8_TAP(k) \
+   do { \
+      const int16x8_t xs = vextq_s16(zero, x, 7 - (k)); \
+      acc_lo = vmlal_n_s16(acc_lo, vget_low_s16(xs), c3[k]); \
+      acc_hi = vmlal_n_s16(acc_hi, vget_high_s16(xs), c3[k]); \
+   } while (0)
+
+   FILTER8_TAP(0);
+   FILTER8_TAP(1);
+   FILTER8_TAP(2);
+   FILTER8_TAP(3);
+   FILTER8_TAP(4);
+   FILTER8_TAP(5);
+   FILTER8_TAP(6);
+#undef FILTER8_TAP
+
+   vst1q_s16(dst, vcombine_s16(
+            vqmovn_s32(vshlq_s32(acc_lo, sh)),
+            vqmovn_s32(vshlq_s32(acc_hi, sh))));
+}
+
+static INLINE void resample_pair(int16_t* out, const int16_t* s,
+      const int16_t* lut0, const int16_t* lut1)
+{
+   const int32x4_t p0 = vmull_s16(vld1_s16(s), vld1_s16(lut0));
+   const int32x4_t p1 = vmull_s16(vld1_s16(s + 4), vld1_s16(lut1));
+   int32x2_t v = vpadd_s32(
+         vpadd_s32(vget_low_s32(p0), vget_high_s32(p0)),
+         vpadd_s32(vget_low_s32(p1), vget_high_s32(p1)));
+   int16x4_t r;
+
+   v = vshr_n_s32(v, 15);
+   r = vqmovn_s32(vcombine_s32(v, v));
+
+   out[0] = vget_lane_s16(r, 0);
+   out[1] = vget_lane_s16(r, 1);
+}
+
+#endif
+
+static void mix_simd(int16_t* dst, const int16_t* src, size_t count, int16_t gain)
+{
+   /* a destination just ahead of the source reads back its own output */
+   if (dst <= src || dst - src >= 8)
+   {
+      for (; count >= 8; count -= 8, dst += 8, src += 8)
+         STORE8(dst, sample_mix_simd(LOAD8(dst), LOAD8(src), SPLAT8(gain)));
+   }
+
+   mix_scalar(dst, src, count, gain);
+}
+
+static void envmix8_simd(int16_t* const* dst, size_t n, const int16_t* in,
+      const int16_t* l_vol, const int16_t* r_vol, int16_t dry, int16_t wet)
+{
+   const int16_t* blocks[5];
+   size_t i;
+
+   blocks[0] = in;
+   for (i = 0; i < n; ++i)
+      blocks[i + 1] = dst[i];
+
+   if (blocks_overlap(blocks, n + 1))
+      envmix8_scalar(dst, n, in, l_vol, r_vol, dry, wet);
+   else
+   {
+      const int16_t vols[4] = { dry, dry, wet, wet };
+      const int16_t* const ramps[4] = { l_vol, r_vol, l_vol, r_vol };
+      const simd16x8 src = LOAD8(in);
+
+      for (i = 0; i < n; ++i)
+         STORE8(dst[i], sample_mix_simd(LOAD8(dst[i]), src,
+                  envmix_gain_simd(LOAD8(ramps[i]), vols[i])));
+   }
+}
+
+static void envmix_nead8_simd(int16_t* const* dst, const int16_t* in,
+      const uint16_t* env_values, const int16_t* xors)
+{
+   const int16_t* const blocks[5] = { in, dst[0], dst[1], dst[2], dst[3] };
+
+   if (blocks_overlap(blocks, 5))
+      envmix_nead8_scalar(dst, in, env_values, xors);
+   else
+   {
+      const simd16x8 src = LOAD8(in);
+      const simd16x8 l   = nead_gain_simd(src, env_values[0], xors[0]);
+      const simd16x8 r   = nead_gain_simd(src, env_values[1], xors[1]);
+
+      STORE8(dst[0], ADDS8(LOAD8(dst[0]), l));
+      STORE8(dst[1], ADDS8(LOAD8(dst[1]), r));
+      STORE8(dst[2], ADDS8(LOAD8(dst[2]), nead_gain_simd(l, env_values[2], xors[2])));
+      STORE8(dst[3], ADDS8(LOAD8(dst[3]), nead_gain_simd(r, env_values[2], xors[3])));
+   }
+}
+
+static void resample_simd(int16_t* samples, uint16_t opos, uint16_t* ipos,
+      uint32_t* pitch_accu, uint32_t pitch, unsigned count)
+{
+   uint16_t pos  = *ipos;
+   uint32_t accu = *pitch_accu;
+
+   while (count)
+   {
+      const int16_t* const lut0 = RESAMPLE_LUT + ((accu & 0xfc00) >> 8);
+      const uint16_t pos0 = pos;
+      const int16_t* lut1;
+      int16_t s[8], out[2];
+      unsigned k;
+
+      accu += pitch;
+      pos += (accu >> 16);
+      accu &= 0xffff;
+
+      /* the first output may be one of the taps of the second */
+      if (count == 1 || (unsigned)(opos - pos) < 4)
+      {
+         *sample(samples, opos++) = resample_tap4(samples, pos0, lut0);
+         --count;
+         continue;
+      }
+
+      lut1 = RESAMPLE_LUT + ((accu & 0xfc00) >> 8);
+      for (k = 0; k < 4; ++k)
+      {
+         s[k]     = *sample(samples, pos0 + k);
+         s[k + 4] = *sample(samples, pos + k);
+      }
+
+      resample_pair(out, s, lut0, lut1);
+      *sample(samples, opos++) = out[0];
+      *sample(samples, opos++) = out[1];
+
+      accu += pitch;
+      pos += (accu >> 16);
+      accu &= 0xffff;
+      count -= 2;
+   }
+
+   *ipos       = pos;
+   *pitch_accu = accu;
+}
+
+static const struct alist_kernels_t simd_kernels =
+{
+#ifdef ALIST_KERNELS_SSE2
+   "sse2",
+#else
+   "neon",
+#endif
+   mix_simd,
+   envmix8_simd,
+   envmix_nead8_simd,
+   filter8_simd,
+   resample_simd
+};
+
+#endif
+
+#if defined(CHECK_ALIST_KERNELS) && (defined(ALIST_KERNELS_SSE2) || defined(ALIST_KERNELS_NEON))
+
+/* Every call first runs the scalar kernel in place, then restores the
+ * buffers and runs the SIMD kernel on them, so overlapping buffers are
+ * checked too. */
+static void* check_user_defined;
+
+static void check_result(const char* kernel, const void* expected, const void* result, size_t size)
+{
+   if (memcmp(expected, result, size) != 0)
+      HleWarnMessage(check_user_defined, "alist kernels: %s mismatch in %s",
+            simd_kernels.name, kernel);
+}
+
+static void mix_checked(int16_t* dst, const int16_t* src, size_t count, int16_t gain)
+{
+   int16_t saved[0x800], expected[0x800];
+
+   if (count > 0x800)
+   {
+      simd_kernels.mix(dst, src, count, gain);
+      return;
+   }
+
+   memcpy(saved, dst, count * sizeof(*dst));
+   scalar_kernels.mix(dst, src, count, gain);
+   memcpy(expected, dst, count * sizeof(*dst));
+   memcpy(dst, saved, count * sizeof(*dst));
+
+   simd_kernels.mix(dst, src, count, gain);
+   check_result("mix", expected, dst, count * sizeof(*dst));
+}
+
+static void envmix8_checked(int16_t* const* dst, size_t n, const int16_t* in,
+      const int16_t* l_vol, const int16_t* r_vol, int16_t dry, int16_t wet)
+{
+   int16_t saved[4][8], expected[4][8];
+   size_t i;
+
+   for (i = 0; i < n; ++i)
+      memcpy(saved[i], dst[i], sizeof(saved[i]));
+   scalar_kernels.envmix8(dst, n, in, l_vol, r_vol, dry, wet);
+   for (i = 0; i < n; ++i)
+      memcpy(expected[i], dst[i], sizeof(expected[i]));
+   for (i = n; i-- != 0;)
+      memcpy(dst[i], saved[i], sizeof(saved[i]));
+
+   simd_kernels.envmix8(dst, n, in, l_vol, r_vol, dry, wet);
+   for (i = 0; i < n; ++i)
+      check_result("envmix8", expected[i], dst[i], sizeof(expected[i]));
+}
+
+static void envmix_nead8_checked(int16_t* const* dst, const int16_t* in,
+      const uint16_t* env_values, const int16_t* xors)
+{
+   int16_t saved[4][8], expected[4][8];
+   size_t i;
+
+   for (i = 0; i < 4; ++i)
+      memcpy(saved[i], dst[i], sizeof(saved[i]));
+   scalar_kernels.envmix_nead8(dst, in, env_values, xors);
+   for (i = 0; i < 4; ++i)
+      memcpy(expected[i], dst[i], sizeof(expected[i]));
+   for (i = 4; i-- != 0;)
+      memcpy(dst[i], saved[i], sizeof(saved[i]));
+
+   simd_kernels.envmix_nead8(dst, in, env_values, xors);
+   for (i = 0; i < 4; ++i)
+      check_result("envmix_nead8", expected[i], dst[i], sizeof(expected[i]));
+}
+
+static void filter8_checked(int16_t* dst, const int16_t* src, uint16_t scale,
+      const int16_t* c1, const int16_t* c2, const int16_t* c3,
+      int16_t l1, int16_t l2, unsigned shift)
+{
+   int16_t expected[8];
+
+   scalar_kernels.filter8(expected, src, scale, c1, c2, c3, l1, l2, shift);
+   simd_kernels.filter8(dst, src, scale, c1, c2, c3, l1, l2, shift);
+   check_result("filter8", expected, dst, sizeof(expected));
+}
+
+static void resample_checked(int16_t* samples, uint16_t opos, uint16_t* ipos,
+      uint32_t* pitch_accu, uint32_t pitch, unsigned count)
+{
+   static int16_t saved[0x8000], expected[0x8000];
+   uint16_t expected_ipos     = *ipos;
+   uint32_t expected_accu     = *pitch_accu;
+   unsigned k;
+
+   if (count > 0x8000)
+   {
+      simd_kernels.resample(samples, opos, ipos, pitch_accu, pitch, count);
+      return;
+   }
+
+   for (k = 0; k < count; ++k)
+      saved[k] = *sample(samples, (uint16_t)(opos + k));
+   scalar_kernels.resample(samples, opos, &expected_ipos, &expected_accu, pitch, count);
+   for (k = 0; k < count; ++k)
+      expected[k] = *sample(samples, (uint16_t)(opos + k));
+   for (k = count; k-- != 0;)
+      *sample(samples, (uint16_t)(opos + k)) = saved[k];
+
+   simd_kernels.resample(samples, opos, ipos, pitch_accu, pitch, count);
+   for (k = 0; k < count; ++k)
+      saved[k] = *sample(samples, (uint16_t)(opos + k));
+   check_result("resample", expected, saved, count * sizeof(*saved));
+   check_result("resample", &expected_ipos, ipos, sizeof(*ipos));
+   check_result("resample", &expected_accu, pitch_accu, sizeof(*pitch_accu));
+}
+
+static const struct alist_kernels_t checked_kernels =
+{
+   "checked",
+   mix_checked,
+   envmix8_checked,
+   envmix_nead8_checked,
+   filter8_checked,
+   resample_checked
+};
+
+#endif
+
+/* called from hle_init */
+const struct alist_kernels_t* alist_select_kernels(struct hle_t* hle)
+{
+#if defined(CHECK_ALIST_KERNELS) && (defined(ALIST_KERNELS_SSE2) || defined(ALIST_KERNELS_NEON))
+   check_user_defined = hle->user_defined;
+   return &checked_kernels;
+#elif defined(ALIST_KERNELS_SSE2) || defined(ALIST_KERNELS_NEON)
+   (void)hle;
+   return &simd_kernels;
+#else
+   (void)hle;
+   return &scalar_kernels;
+#endif
+}
@@ -0,0 +1,65 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - alist_kernels.h                                 *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef ALIST_KERNELS_H
+#define ALIST_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct hle_t;
+
+/* Inner loops of the audio list commands, working on whole blocks of
+ * samples. Every implementation gives bit-exact results with the scalar one.
+ *
+ * Blocks of 8 samples are passed in buffer order: with the ^S sample
+ * swizzle applied to both sides, element j of every buffer (and of the
+ * per-sample volumes) belongs to the same sample. */
+struct alist_kernels_t
+{
+   const char* name;
+
+   /* dst[i] = clamp_s16(dst[i] + ((src[i] * gain) >> 15)), for i < count */
+   void (*mix)(int16_t* dst, const int16_t* src, size_t count, int16_t gain);
+
+   /* envmix_exp/ge/lin: mix 8 samples of in into the first n of
+    * dl, dr, wl, wr, with per sample left/right volumes */
+   void (*envmix8)(int16_t* const* dst, size_t n, const int16_t* in,
+         const int16_t* l_vol, const int16_t* r_vol, int16_t dry, int16_t wet);
+
+   /* envmix_nead: mix 8 samples of in into dl, dr, wl, wr */
+   void (*envmix_nead8)(int16_t* const* dst, const int16_t* in,
+         const uint16_t* env_values, const int16_t* xors);
+
+   /* adpcm residuals and polef, for i < 8:
+    * dst[i] = clamp_s16((src[i] * scale + c1[i] * l1 + c2[i] * l2
+    *                     + rdot(i, c3, src + i)) >> shift) */
+   void (*filter8)(int16_t* dst, const int16_t* src, uint16_t scale,
+         const int16_t* c1, const int16_t* c2, const int16_t* c3,
+         int16_t l1, int16_t l2, unsigned shift);
+
+   /* 4-tap resampler, samples is the alist buffer (addressed with ^S) */
+   void (*resample)(int16_t* samples, uint16_t opos, uint16_t* ipos,
+         uint32_t* pitch_accu, uint32_t pitch, unsigned count);
+};
+
+const struct alist_kernels_t* alist_select_kernels(struct hle_t* hle);
+
+#endif
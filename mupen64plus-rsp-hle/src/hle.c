@@ -22,10 +22,16 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "alist_kernels.h"
+#include "hle.h"
 #include "hle_external.h"
 #include "hle_internal.h"
+#include "hle_worker.h"
 #include "memory.h"
 #include "m64p_plugin.h"
 
@@ -45,6 +51,13 @@
 /* some mips interface interrupt flags */
 #define MI_INTR_SP                  0x1
 
+/* modelled length of a task run by the worker, in CP0 count cycles (~0.7ms).
+ * Fixed, so that interrupt timings do not depend on the host. */
+#define ASYNC_TASK_CYCLES           0x8000
+
+/* size of the DRAM a task running on the worker sees, as in the core */
+#define ASYNC_DRAM_SIZE             0x800000
+
 
 /* helper functions prototypes */
 static unsigned int sum_bytes(const unsigned char *bytes, unsigned int size);
@@ -54,9 +67,34 @@ static bool try_fast_audio_dispatching(struct hle_t* hle);
 static bool try_fast_task_dispatching(struct hle_t* hle);
 static void normal_task_dispatching(struct hle_t* hle);
 static void non_task_dispatching(struct hle_t* hle);
+static void run_long_task(struct hle_t* hle, hle_task_t task);
+static void run_staged_task(struct hle_t* hle);
+static void commit_staged_writes(struct hle_t* hle);
 
 extern RSP_INFO rsp_info;
 
+/* DRAM ranges written by a task running on the worker */
+struct hle_staging_t
+{
+   unsigned char* dram;
+   struct { uint32_t address, size; }* ranges;
+   size_t count;
+   size_t capacity;
+   bool overflow;  /* ranges are lost, the whole copy has to be committed */
+};
+
+/* A task running on the worker gets its own copy of the state, of DMEM and
+ * of DRAM: the CPU is free to load the next task meanwhile, and never sees
+ * the outputs of the task before they are committed by hle_sync. */
+struct hle_async_t
+{
+   struct hle_worker_t* worker;
+   hle_task_t task;
+   struct hle_t hle;
+   struct hle_staging_t staging;
+   unsigned char dmem[0x1000];
+};
+
 /* local variables */
 static const bool FORWARD_AUDIO = false, FORWARD_GFX = true;
 
@@ -107,6 +145,8 @@ void hle_init(struct hle_t* hle,
     hle->dpc_pipebusy = dpc_pipebusy;
     hle->dpc_tmem     = dpc_tmem;
     hle->user_defined = user_defined;
+
+    hle->alist_kernels = alist_select_kernels(hle);
 }
 
 /**
@@ -123,6 +163,10 @@ void hle_init(struct hle_t* hle,
 
 void hle_execute(struct hle_t* hle)
 {
+   /* graphics tasks leave the audio state alone */
+   if (!(is_task(hle) && *dmem_u32(hle, TASK_TYPE) == 1))
+      hle_sync(hle);
+
    if (is_task(hle))
    {
       if (!try_fast_task_dispatching(hle))
@@ -135,6 +179,115 @@ void hle_execute(struct hle_t* hle)
    rsp_break(hle, 0);
 }
 
+void hle_set_async(struct hle_t* hle, bool enable)
+{
+   if (enable && hle->async == NULL)
+   {
+      struct hle_async_t* async = (struct hle_async_t*)calloc(1, sizeof(*async));
+
+      if (async == NULL)
+         return;
+
+      async->staging.dram = (unsigned char*)malloc(ASYNC_DRAM_SIZE);
+      async->worker = (async->staging.dram != NULL) ? hle_worker_new() : NULL;
+      if (async->worker == NULL)
+      {
+         free(async->staging.dram);
+         free(async);
+         return;
+      }
+
+      hle->async = async;
+   }
+   else if (!enable && hle->async != NULL)
+   {
+      hle_sync(hle);
+      hle_worker_free(hle->async->worker);
+      free(hle->async->staging.ranges);
+      free(hle->async->staging.dram);
+      free(hle->async);
+      hle->async = NULL;
+   }
+}
+
+void hle_sync(struct hle_t* hle)
+{
+   struct hle_async_t* async = hle->async;
+
+   if (hle->async_cycles == 0)
+      return;
+
+   hle_worker_wait(async->worker);
+   commit_staged_writes(hle);
+
+   /* keep the state left by the task, as if it had run on hle */
+   async->hle.dram         = hle->dram;
+   async->hle.dmem         = hle->dmem;
+   async->hle.dram_written = hle->dram_written;
+   async->hle.staging      = NULL;
+   async->hle.async_cycles = 0;
+   *hle = async->hle;
+}
+
+unsigned int hle_async_cycles(const struct hle_t* hle)
+{
+   return hle->async_cycles;
+}
+
+bool hle_on_worker(const struct hle_t* hle)
+{
+   return hle->async != NULL && hle_worker_is_current(hle->async->worker);
+}
+
+/* Called through dram_written by a task running on the worker: the range
+ * is committed to the real DRAM by hle_sync. Ranges are widened to whole
+ * words, which is how the byte swapped DRAM is laid out. */
+void hle_stage_dram_write(struct hle_staging_t* staging, uint32_t address, size_t count)
+{
+   uint32_t begin = address & 0xfffffc;
+   uint32_t end   = (uint32_t)((address & 0xffffff) + count + 3) & ~3u;
+
+   if (count == 0 || staging->overflow)
+      return;
+
+   /* tasks mostly write runs of consecutive blocks */
+   if (staging->count > 0)
+   {
+      uint32_t last_begin = staging->ranges[staging->count - 1].address;
+      uint32_t last_end   = last_begin + staging->ranges[staging->count - 1].size;
+
+      if (begin <= last_end && end >= last_begin)
+      {
+         if (begin < last_begin)
+            last_begin = begin;
+         if (end > last_end)
+            last_end = end;
+         staging->ranges[staging->count - 1].address = last_begin;
+         staging->ranges[staging->count - 1].size    = last_end - last_begin;
+         return;
+      }
+   }
+
+   if (staging->count == staging->capacity)
+   {
+      size_t capacity = staging->capacity ? 2 * staging->capacity : 64;
+      void* ranges = realloc(staging->ranges, capacity * sizeof(*staging->ranges));
+
+      if (ranges == NULL)
+      {
+         staging->overflow = true;
+         return;
+      }
+
+      staging->ranges   = ranges;
+      staging->capacity = capacity;
+   }
+
+   staging->ranges[staging->count].address = begin;
+   staging->ranges[staging->count].size    = end - begin;
+   ++staging->count;
+}
+
 /* local functions */
 static unsigned int sum_bytes(const unsigned char *bytes, unsigned int size)
 {
@@ -160,6 +313,77 @@ static void rsp_break(struct hle_t* hle, unsigned int setbits)
    }
 }
 
+/* A task run by the worker works on a copy of DRAM while the CPU keeps
+ * running. The core waits for it (hle_sync) when the task is modelled to be
+ * done, see do_SP_Task, and the ranges it wrote are copied to the real DRAM
+ * then: the guest never sees partial outputs. */
+static void run_long_task(struct hle_t* hle, hle_task_t task)
+{
+   struct hle_async_t* async = hle->async;
+
+   if (async != NULL)
+   {
+      async->task = task;
+      async->hle = *hle;
+      async->hle.dmem = async->dmem;
+      async->hle.dram_written = NULL;
+      async->hle.staging = &async->staging;
+      async->staging.count = 0;
+      async->staging.overflow = false;
+      memcpy(async->dmem, hle->dmem, sizeof(async->dmem));
+
+      if (hle_worker_submit(async->worker, &async->hle, run_staged_task))
+      {
+         hle->async_cycles = ASYNC_TASK_CYCLES;
+         return;
+      }
+   }
+
+   task(hle);
+}
+
+/* On the worker. The inputs of the task are left alone by the guest while
+ * the RSP runs, the rest of the copy only has to be in range. */
+static void run_staged_task(struct hle_t* hle)
+{
+   struct hle_async_t* async = (struct hle_async_t*)
+      ((unsigned char*)hle - offsetof(struct hle_async_t, hle));
+
+   memcpy(async->staging.dram, hle->dram, ASYNC_DRAM_SIZE);
+   hle->dram = async->staging.dram;
+
+   async->task(hle);
+}
+
+/* On the emulation thread, once the worker is done */
+static void commit_staged_writes(struct hle_t* hle)
+{
+   const struct hle_staging_t* staging = &hle->async->staging;
+   size_t i;
+
+   if (staging->overflow)
+   {
+      HleWarnMessage(hle->user_defined, "async task: lost track of its DRAM writes");
+      memcpy(hle->dram, staging->dram, ASYNC_DRAM_SIZE);
+      dram_written(hle, 0, ASYNC_DRAM_SIZE);
+      return;
+   }
+
+   for (i = 0; i < staging->count; ++i)
+   {
+      uint32_t address = staging->ranges[i].address;
+      uint32_t size    = staging->ranges[i].size;
+
+      if (address >= ASYNC_DRAM_SIZE)
+         continue;
+      if (size > ASYNC_DRAM_SIZE - address)
+         size = ASYNC_DRAM_SIZE - address;
+
+      memcpy(hle->dram + address, staging->dram + address, size);
+      dram_written(hle, address, size);
+   }
+}
+
 static void forward_gfx_task(struct hle_t* hle)
 {
    if (rsp_info.ProcessDlistList)
@@ -217,7 +441,7 @@ static bool try_fast_audio_dispatching(struct hle_t* hle)
               case 0x1eac11b8: /* AnimalCrossing */
                  alist_process_nead_ac(hle); return true;
               case 0x00010010: /* MusyX v2 (IndianaJones, BattleForNaboo) */
-                 musyx_v2_task(hle); return true;
+                 run_long_task(hle, musyx_v2_task); return true;
 
               default:
                  HleWarnMessage(hle->user_defined, "ABI2 identification regression: v=%08x", v);
@@ -242,7 +466,7 @@ static bool try_fast_audio_dispatching(struct hle_t* hle)
              Rush 2049
              */
           case 0x00000001:
-             musyx_v1_task(hle);
+             run_long_task(hle, musyx_v1_task);
              return true;
              /* NAUDIO (many games) */
           case 0x0000127c:
@@ -261,7 +485,7 @@ static bool try_fast_audio_dispatching(struct hle_t* hle)
               * Mickey's SpeedWay USA
               * Perfect Dark */
           case 0x1ae8143c:
-             alist_process_naudio_mp3(hle);
+             run_long_task(hle, alist_process_naudio_mp3);
              return true;
           case 0x1ab0140c:
              /* Conker's Bad Fur Day */
@@ -333,18 +557,18 @@ static void normal_task_dispatching(struct hle_t* hle)
 
          /* JPEG: found in Pokemon Stadium J */
       case 0x2c85a:
-         jpeg_decode_PS0(hle);
+         hle_task_cache_execute(hle, jpeg_decode_PS0, jpeg_decode_std_io);
          return;
 
          /* JPEG: found in Zelda Ocarina of Time, Pokemon Stadium 1, Pokemon Stadium 2 */
       case 0x2caa6:
-         jpeg_decode_PS(hle);
+         hle_task_cache_execute(hle, jpeg_decode_PS, jpeg_decode_std_io);
          return;
 
          /* JPEG: found in Ogre Battle, Bottom of the 9th */
       case 0x130de:
       case 0x278b0:
-         jpeg_decode_OB(hle);
+         hle_task_cache_execute(hle, jpeg_decode_OB, jpeg_decode_OB_io);
          return;
    }
 
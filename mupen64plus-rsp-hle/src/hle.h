@@ -22,6 +22,8 @@
 #ifndef HLE_H
 #define HLE_H
 
+#include <stdbool.h>
+
 #include "hle_internal.h"
 
 void hle_init(struct hle_t* hle,
@@ -50,5 +52,14 @@ void hle_init(struct hle_t* hle,
 
 void hle_execute(struct hle_t* hle);
 
+/* Long audio tasks (MusyX, MP3) can run on a worker thread.
+ * hle_sync waits for the pending one, if any. */
+void hle_set_async(struct hle_t* hle, bool enable);
+void hle_sync(struct hle_t* hle);
+unsigned int hle_async_cycles(const struct hle_t* hle);
+
+/* true when called from the task worker */
+bool hle_on_worker(const struct hle_t* hle);
+
 #endif
 
@@ -22,10 +22,16 @@
 #ifndef HLE_INTERNAL_H
 #define HLE_INTERNAL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "hle_task_cache.h"
 #include "ucodes.h"
 
+struct alist_kernels_t;
+struct hle_async_t;
+struct hle_staging_t;
+
 /* rsp hle internal state - internal usage only */
 struct hle_t
 {
@@ -57,9 +63,15 @@ struct hle_t
     /* for user convenience, this will be passed to "external" functions */
     void* user_defined;
 
+    /* one byte per 4KB DRAM page, set to 1 when written. NULL if unused */
+    unsigned char* dram_written;
+
     /* alist.c */
     uint8_t alist_buffer[0x1000];
 
+    /* alist_kernels.c */
+    const struct alist_kernels_t* alist_kernels;
+
     /* alist_audio.c */
     struct alist_audio_t alist_audio;
 
@@ -71,7 +83,20 @@ struct hle_t
 
     /* mp3.c */
     uint8_t  mp3_buffer[0x1000];
+
+    /* hle_task_cache.c */
+    struct hle_task_cache_t task_cache;
+
+    /* hle.c, NULL unless long audio tasks run on a worker thread */
+    struct hle_async_t* async;
+    unsigned int async_cycles;  /* modelled length of the pending task, 0 if none */
+
+    /* hle.c, only set on the state of a task running on the worker: its DRAM
+     * writes are logged there instead of being reported to the core */
+    struct hle_staging_t* staging;
 };
 
+void hle_stage_dram_write(struct hle_staging_t* staging, uint32_t address, size_t count);
+
 #endif
 
@@ -46,6 +46,12 @@ static void (*l_DebugCallback)(void *, int, const char *) = NULL;
 static void *l_DebugCallContext = NULL;
 static int l_PluginInit = 0;
 
+/* warnings of the task worker, written by the worker only while a task is
+ * pending and passed on by the emulation thread once it is waited for */
+#define DEFERRED_MESSAGES 8
+static char l_DeferredMessages[DEFERRED_MESSAGES][256];
+static unsigned int l_DeferredCount = 0;
+
 /* local function */
 static void DebugMessage(int level, const char *message, va_list args)
 {
@@ -54,11 +60,32 @@ static void DebugMessage(int level, const char *message, va_list args)
     if (l_DebugCallback == NULL)
         return;
 
+    /* the frontend log isn't called from the worker: keep its warnings for
+     * later and drop the verbose ones */
+    if (hle_on_worker(&g_hle))
+    {
+        if (level != M64MSG_VERBOSE && l_DeferredCount < DEFERRED_MESSAGES)
+            vsnprintf(l_DeferredMessages[l_DeferredCount++], sizeof(l_DeferredMessages[0]), message, args);
+        return;
+    }
+
     vsprintf(msgbuf, message, args);
 
     (*l_DebugCallback)(l_DebugCallContext, level, msgbuf);
 }
 
+static void SyncTask(void)
+{
+    unsigned int i;
+
+    hle_sync(&g_hle);
+
+    if (l_DebugCallback != NULL)
+        for (i = 0; i < l_DeferredCount; ++i)
+            (*l_DebugCallback)(l_DebugCallContext, M64MSG_WARNING, l_DeferredMessages[i]);
+    l_DeferredCount = 0;
+}
+
 /* Global functions needed by HLE core */
 void HleVerboseMessage(void* UNUSED(user_defined), const char *message, ...)
 {
@@ -135,6 +162,7 @@ EXPORT unsigned int CALL hleDoRspCycles(unsigned int Cycles)
 
 EXPORT void CALL hleInitiateRSP(RSP_INFO Rsp_Info, unsigned int* UNUSED(CycleCount))
 {
+    SyncTask();
     hle_init(&g_hle,
              Rsp_Info.RDRAM,
              Rsp_Info.DMEM,
@@ -168,5 +196,43 @@ EXPORT void CALL hleInitiateRSP(RSP_INFO Rsp_Info, unsigned int* UNUSED(CycleCou
 
 EXPORT void CALL hleRomClosed(void)
 {
-   /* do nothing */
+   SyncTask();
+   hle_task_cache_flush(&g_hle.task_cache);
+}
+
+/* Asynchronous tasks, see hle_set_async. The core waits for the pending
+ * task with hleSyncTask and raises SP_INT after hleAsyncTaskCycles. */
+EXPORT void CALL hleSyncTask(void)
+{
+   SyncTask();
+}
+
+EXPORT unsigned int CALL hleAsyncTaskCycles(void)
+{
+   return hle_async_cycles(&g_hle);
+}
+
+/* RDRAM write map extension, every page a task writes gets flagged in map */
+EXPORT void CALL hleSetRdramWriteMap(unsigned char* map)
+{
+   SyncTask();
+   g_hle.dram_written = map;
+}
+
+void hle_set_async_tasks(unsigned enable)
+{
+   hle_set_async(&g_hle, enable != 0);
+}
+
+/* Task cache controls, for the libretro frontend. The cache is disabled
+ * until a non-zero size is set. */
+void hle_set_task_cache_size(size_t bytes)
+{
+   SyncTask();
+   hle_task_cache_set_budget(&g_hle.task_cache, bytes);
+}
+
+void hle_get_task_cache_stats(struct hle_task_cache_stats_t* stats)
+{
+   hle_task_cache_get_stats(&g_hle.task_cache, stats);
 }
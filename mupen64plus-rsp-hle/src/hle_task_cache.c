@@ -0,0 +1,319 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - hle_task_cache.c                                *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hle_internal.h"
+#include "hle_task_cache.h"
+#include "memory.h"
+
+/* tasks must stay within the largest RDRAM */
+#define DRAM_SIZE        0x800000
+#define TASK_HEADER_SIZE (0x1000 - TASK_TYPE)
+
+struct hle_task_cache_entry_t
+{
+   struct hle_task_cache_entry_t* next;    /* bucket chain */
+   struct hle_task_cache_entry_t* lru_prev;
+   struct hle_task_cache_entry_t* lru_next;
+
+   uint64_t key;
+   hle_task_t task;
+   size_t size;                            /* counted against the budget */
+   struct hle_task_io_t io;
+   unsigned char header[TASK_HEADER_SIZE];
+
+   /* followed by the input bytes, then the output bytes */
+};
+
+#define entry_data(entry) ((unsigned char*)((entry) + 1))
+
+/* local functions */
+static uint64_t hash_bytes(uint64_t hash, const unsigned char* bytes, size_t size)
+{
+   /* FNV-1a style, 8 bytes at a time: only used to pick a bucket,
+    * entries are compared byte for byte */
+   while (size >= 8)
+   {
+      uint64_t word;
+      memcpy(&word, bytes, 8);
+      hash = (hash ^ word) * UINT64_C(0x100000001b3);
+      hash ^= hash >> 29;
+      bytes += 8;
+      size -= 8;
+   }
+
+   while (size)
+   {
+      hash = (hash ^ *bytes++) * UINT64_C(0x100000001b3);
+      --size;
+   }
+
+   return hash;
+}
+
+/* Byte swizzled accesses (see memory.h) stay within aligned words.
+ * Inputs are widened to whole words, outputs have to be made of them
+ * already: replaying bytes the task did not write could undo later
+ * changes to them. */
+static bool check_ranges(struct hle_range_t* ranges, unsigned int count, bool widen, size_t* total)
+{
+   unsigned int i;
+
+   if (count > HLE_TASK_MAX_RANGES)
+      return false;
+
+   *total = 0;
+   for (i = 0; i < count; ++i)
+   {
+      const uint32_t start = ranges[i].address & ~3u;
+      const uint32_t end   = align(ranges[i].address + ranges[i].size, 4);
+
+      if (ranges[i].address >= DRAM_SIZE || ranges[i].size > DRAM_SIZE - ranges[i].address)
+         return false;
+
+      if (start != ranges[i].address || end - start != ranges[i].size)
+      {
+         if (!widen)
+            return false;
+         ranges[i].address = start;
+         ranges[i].size    = end - start;
+      }
+
+      *total += ranges[i].size;
+   }
+
+   return true;
+}
+
+static uint64_t task_key(const struct hle_t* hle, const struct hle_task_io_t* io)
+{
+   uint64_t key = UINT64_C(0xcbf29ce484222325);
+   unsigned int i;
+
+   key = hash_bytes(key, hle->dmem + TASK_TYPE, TASK_HEADER_SIZE);
+   key = hash_bytes(key, (const unsigned char*)io, sizeof(*io));
+   for (i = 0; i < io->input_count; ++i)
+      key = hash_bytes(key, hle->dram + io->inputs[i].address, io->inputs[i].size);
+
+   return key;
+}
+
+static bool entry_matches(const struct hle_task_cache_entry_t* entry, const struct hle_t* hle,
+      hle_task_t task, const struct hle_task_io_t* io)
+{
+   const unsigned char* data = entry_data(entry);
+   unsigned int i;
+
+   if (entry->task != task
+         || memcmp(&entry->io, io, sizeof(*io))
+         || memcmp(entry->header, hle->dmem + TASK_TYPE, TASK_HEADER_SIZE))
+      return false;
+
+   for (i = 0; i < io->input_count; ++i)
+   {
+      if (memcmp(data, hle->dram + io->inputs[i].address, io->inputs[i].size))
+         return false;
+      data += io->inputs[i].size;
+   }
+
+   return true;
+}
+
+static void lru_unlink(struct hle_task_cache_t* cache, struct hle_task_cache_entry_t* entry)
+{
+   if (entry->lru_prev)
+      entry->lru_prev->lru_next = entry->lru_next;
+   else
+      cache->lru_head = entry->lru_next;
+
+   if (entry->lru_next)
+      entry->lru_next->lru_prev = entry->lru_prev;
+   else
+      cache->lru_tail = entry->lru_prev;
+}
+
+static void lru_push_front(struct hle_task_cache_t* cache, struct hle_task_cache_entry_t* entry)
+{
+   entry->lru_prev = NULL;
+   entry->lru_next = cache->lru_head;
+
+   if (cache->lru_head)
+      cache->lru_head->lru_prev = entry;
+   else
+      cache->lru_tail = entry;
+
+   cache->lru_head = entry;
+}
+
+static void remove_entry(struct hle_task_cache_t* cache, struct hle_task_cache_entry_t* entry)
+{
+   struct hle_task_cache_entry_t** link = &cache->buckets[entry->key % HLE_TASK_CACHE_BUCKETS];
+
+   while (*link != entry)
+      link = &(*link)->next;
+   *link = entry->next;
+
+   lru_unlink(cache, entry);
+
+   cache->bytes -= entry->size;
+   --cache->entries;
+   free(entry);
+}
+
+static void evict_to(struct hle_task_cache_t* cache, size_t budget)
+{
+   while (cache->lru_tail && cache->bytes > budget)
+   {
+      remove_entry(cache, cache->lru_tail);
+      ++cache->evictions;
+   }
+}
+
+static void replay_outputs(struct hle_t* hle, const struct hle_task_cache_entry_t* entry)
+{
+   const unsigned char* data = entry_data(entry);
+   unsigned int i;
+
+   for (i = 0; i < entry->io.input_count; ++i)
+      data += entry->io.inputs[i].size;
+
+   for (i = 0; i < entry->io.output_count; ++i)
+   {
+      memcpy(hle->dram + entry->io.outputs[i].address, data, entry->io.outputs[i].size);
+      dram_written(hle, entry->io.outputs[i].address, entry->io.outputs[i].size);
+      data += entry->io.outputs[i].size;
+   }
+}
+
+/* Global functions */
+void hle_task_cache_set_budget(struct hle_task_cache_t* cache, size_t budget)
+{
+   cache->budget = budget;
+   evict_to(cache, budget);
+}
+
+void hle_task_cache_flush(struct hle_task_cache_t* cache)
+{
+   while (cache->lru_tail)
+      remove_entry(cache, cache->lru_tail);
+}
+
+void hle_task_cache_get_stats(const struct hle_task_cache_t* cache,
+      struct hle_task_cache_stats_t* stats)
+{
+   stats->hits      = cache->hits;
+   stats->misses    = cache->misses;
+   stats->evictions = cache->evictions;
+   stats->entries   = cache->entries;
+   stats->bytes     = cache->bytes;
+   stats->budget    = cache->budget;
+}
+
+void hle_task_cache_execute(struct hle_t* hle, hle_task_t task,
+      hle_task_describer_t describe)
+{
+   struct hle_task_cache_t* cache = &hle->task_cache;
+   struct hle_task_cache_entry_t* entry;
+   struct hle_task_io_t io;
+   size_t input_bytes, output_bytes, size;
+   unsigned char* data;
+   unsigned int i;
+   uint64_t key;
+
+   if (cache->budget == 0)
+   {
+      task(hle);
+      return;
+   }
+
+   /* zeroed, as it is hashed and compared as a whole */
+   memset(&io, 0, sizeof(io));
+   if (!describe(hle, &io)
+         || !check_ranges(io.inputs, io.input_count, true, &input_bytes)
+         || !check_ranges(io.outputs, io.output_count, false, &output_bytes))
+   {
+      task(hle);
+      return;
+   }
+
+   key = task_key(hle, &io);
+
+   for (entry = cache->buckets[key % HLE_TASK_CACHE_BUCKETS]; entry; entry = entry->next)
+   {
+      if (entry->key == key && entry_matches(entry, hle, task, &io))
+      {
+         replay_outputs(hle, entry);
+
+         lru_unlink(cache, entry);
+         lru_push_front(cache, entry);
+         ++cache->hits;
+         return;
+      }
+   }
+
+   ++cache->misses;
+
+   size = sizeof(*entry) + input_bytes + output_bytes;
+   entry = (size <= cache->budget)
+      ? (struct hle_task_cache_entry_t*)malloc(size)
+      : NULL;
+
+   if (entry == NULL)
+   {
+      task(hle);
+      return;
+   }
+
+   /* inputs may be overwritten by the task, keep them first */
+   entry->key  = key;
+   entry->task = task;
+   entry->size = size;
+   entry->io   = io;
+   memcpy(entry->header, hle->dmem + TASK_TYPE, TASK_HEADER_SIZE);
+
+   data = entry_data(entry);
+   for (i = 0; i < io.input_count; ++i)
+   {
+      memcpy(data, hle->dram + io.inputs[i].address, io.inputs[i].size);
+      data += io.inputs[i].size;
+   }
+
+   task(hle);
+
+   for (i = 0; i < io.output_count; ++i)
+   {
+      memcpy(data, hle->dram + io.outputs[i].address, io.outputs[i].size);
+      data += io.outputs[i].size;
+   }
+
+   evict_to(cache, cache->budget - size);
+
+   entry->next = cache->buckets[key % HLE_TASK_CACHE_BUCKETS];
+   cache->buckets[key % HLE_TASK_CACHE_BUCKETS] = entry;
+   lru_push_front(cache, entry);
+
+   cache->bytes += size;
+   ++cache->entries;
+}
@@ -0,0 +1,95 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - hle_task_cache.h                                *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HLE_TASK_CACHE_H
+#define HLE_TASK_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct hle_t;
+struct hle_task_cache_entry_t;
+
+#define HLE_TASK_MAX_RANGES     6
+#define HLE_TASK_CACHE_BUCKETS  256
+
+/* DRAM range, address already masked like the dram_* accessors */
+struct hle_range_t
+{
+   uint32_t address;
+   uint32_t size;
+};
+
+/* What a task reads from and writes to DRAM. Its results can only be
+ * replayed if it depends on nothing but the DMEM task header and its inputs,
+ * and changes nothing but its outputs (no state kept in struct hle_t). */
+struct hle_task_io_t
+{
+   unsigned int input_count;
+   unsigned int output_count;
+   struct hle_range_t inputs[HLE_TASK_MAX_RANGES];
+   struct hle_range_t outputs[HLE_TASK_MAX_RANGES];
+};
+
+typedef void (*hle_task_t)(struct hle_t* hle);
+
+/* fill io from the current task, return false if it must not be cached */
+typedef bool (*hle_task_describer_t)(struct hle_t* hle, struct hle_task_io_t* io);
+
+struct hle_task_cache_stats_t
+{
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+   size_t entries;
+   size_t bytes;
+   size_t budget;
+};
+
+/* Results of earlier tasks, keyed by their task header and input bytes.
+ * Entries keep a copy of their inputs, so a hit is always exact. */
+struct hle_task_cache_t
+{
+   size_t budget;    /* in bytes, 0 disables the cache */
+   size_t bytes;
+   size_t entries;
+
+   struct hle_task_cache_entry_t* buckets[HLE_TASK_CACHE_BUCKETS];
+
+   /* most recently used first */
+   struct hle_task_cache_entry_t* lru_head;
+   struct hle_task_cache_entry_t* lru_tail;
+
+   uint64_t hits;
+   uint64_t misses;
+   uint64_t evictions;
+};
+
+void hle_task_cache_set_budget(struct hle_task_cache_t* cache, size_t budget);
+void hle_task_cache_flush(struct hle_task_cache_t* cache);
+void hle_task_cache_get_stats(const struct hle_task_cache_t* cache,
+      struct hle_task_cache_stats_t* stats);
+
+/* run task, or replay its outputs if an identical one was cached */
+void hle_task_cache_execute(struct hle_t* hle, hle_task_t task,
+      hle_task_describer_t describe);
+
+#endif
@@ -0,0 +1,162 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - hle_worker.c                                    *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "hle_worker.h"
+#include "plugin_thread.h"
+
+#ifdef PLUGIN_THREADS
+
+struct hle_worker_t
+{
+   plugin_thread_t* thread;
+   plugin_mutex_t* lock;
+   plugin_cond_t* cond;
+
+   /* protected by lock, task is NULL when idle */
+   struct hle_t* hle;
+   hle_task_t task;
+   bool quit;
+};
+
+/* local functions */
+static void worker_main(void* data)
+{
+   struct hle_worker_t* worker = (struct hle_worker_t*)data;
+
+   plugin_mutex_lock(worker->lock);
+   for (;;)
+   {
+      while (worker->task == NULL && !worker->quit)
+         plugin_cond_wait(worker->cond, worker->lock);
+
+      if (worker->task == NULL)
+         break;
+
+      /* the emulation thread leaves hle alone until hle_worker_wait */
+      plugin_mutex_unlock(worker->lock);
+      worker->task(worker->hle);
+      plugin_mutex_lock(worker->lock);
+
+      worker->task = NULL;
+      plugin_cond_broadcast(worker->cond);
+   }
+   plugin_mutex_unlock(worker->lock);
+}
+
+static void free_sync(struct hle_worker_t* worker)
+{
+   plugin_cond_free(worker->cond);
+   plugin_mutex_free(worker->lock);
+   free(worker);
+}
+
+/* Global functions */
+struct hle_worker_t* hle_worker_new(void)
+{
+   struct hle_worker_t* worker = (struct hle_worker_t*)calloc(1, sizeof(*worker));
+
+   if (worker == NULL)
+      return NULL;
+
+   worker->lock = plugin_mutex_new();
+   worker->cond = plugin_cond_new();
+   if (worker->lock == NULL || worker->cond == NULL)
+   {
+      free_sync(worker);
+      return NULL;
+   }
+
+   worker->thread = plugin_thread_create(worker_main, worker);
+   if (worker->thread == NULL)
+   {
+      free_sync(worker);
+      return NULL;
+   }
+
+   return worker;
+}
+
+void hle_worker_free(struct hle_worker_t* worker)
+{
+   if (worker == NULL)
+      return;
+
+   plugin_mutex_lock(worker->lock);
+   worker->quit = true;
+   plugin_cond_broadcast(worker->cond);
+   plugin_mutex_unlock(worker->lock);
+
+   plugin_thread_join(worker->thread);
+   free_sync(worker);
+}
+
+bool hle_worker_submit(struct hle_worker_t* worker, struct hle_t* hle, hle_task_t task)
+{
+   plugin_mutex_lock(worker->lock);
+   worker->hle  = hle;
+   worker->task = task;
+   plugin_cond_broadcast(worker->cond);
+   plugin_mutex_unlock(worker->lock);
+
+   return true;
+}
+
+void hle_worker_wait(struct hle_worker_t* worker)
+{
+   plugin_mutex_lock(worker->lock);
+   while (worker->task != NULL)
+      plugin_cond_wait(worker->cond, worker->lock);
+   plugin_mutex_unlock(worker->lock);
+}
+
+bool hle_worker_is_current(const struct hle_worker_t* worker)
+{
+   return worker != NULL && plugin_thread_is_current(worker->thread);
+}
+
+#else
+
+struct hle_worker_t* hle_worker_new(void)
+{
+   return NULL;
+}
+
+void hle_worker_free(struct hle_worker_t* worker)
+{
+}
+
+bool hle_worker_submit(struct hle_worker_t* worker, struct hle_t* hle, hle_task_t task)
+{
+   return false;
+}
+
+void hle_worker_wait(struct hle_worker_t* worker)
+{
+}
+
+bool hle_worker_is_current(const struct hle_worker_t* worker)
+{
+   return false;
+}
+
+#endif
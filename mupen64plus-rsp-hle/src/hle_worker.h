@@ -0,0 +1,46 @@
+/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+ *   Mupen64plus-rsp-hle - hle_worker.h                                    *
+ *   Mupen64Plus homepage: http://code.google.com/p/mupen64plus/           *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.          *
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef HLE_WORKER_H
+#define HLE_WORKER_H
+
+#include <stdbool.h>
+
+#include "hle_task_cache.h"
+
+struct hle_t;
+struct hle_worker_t;
+
+/* A thread running one task at a time, off the emulation thread, built on
+ * the plugins' shared thread helpers (libretro/plugin_thread.h).
+ * hle_worker_new returns NULL on builds without thread support. */
+struct hle_worker_t* hle_worker_new(void);
+void hle_worker_free(struct hle_worker_t* worker);
+
+/* start task(hle), the worker must be idle */
+bool hle_worker_submit(struct hle_worker_t* worker, struct hle_t* hle, hle_task_t task);
+
+/* wait until the submitted task has returned */
+void hle_worker_wait(struct hle_worker_t* worker);
+
+/* true when called from the worker thread */
+bool hle_worker_is_current(const struct hle_worker_t* worker);
+
+#endif
@@ -22,6 +22,7 @@
  * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -30,6 +31,31 @@
 #include "hle_internal.h"
 #include "memory.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JPEG_SIMD_SSE2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(MSB_FIRST)
+#include <arm_neon.h>
+#define JPEG_SIMD_NEON
+#endif
+
+#if defined(JPEG_SIMD_SSE2) || defined(JPEG_SIMD_NEON)
+#define JPEG_SIMD
+#endif
+
+/* the RGBA conversion is done in double precision, which 32-bit NEON lacks */
+#if defined(JPEG_SIMD_SSE2) || (defined(JPEG_SIMD_NEON) && defined(__aarch64__))
+#define JPEG_SIMD_RGBA
+#endif
+
+/* The SIMD paths repeat the float/double operations of the scalar code one
+ * for one, so both have to be kept from fusing multiplies and adds. */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
 #define SUBBLOCK_SIZE 64
 
 typedef void (*tile_line_emitter_t)(struct hle_t* hle, const int16_t *y, const int16_t *u, uint32_t address);
@@ -43,13 +69,21 @@ static void jpeg_decode_std(struct hle_t* hle,
                             const tile_line_emitter_t emit_line);
 
 /* helper functions */
+#ifndef JPEG_SIMD
 static uint8_t clamp_u8(int16_t x);
+#endif
 static int16_t clamp_s12(int16_t x);
+#ifndef JPEG_SIMD_RGBA
 static uint16_t clamp_RGBA_component(int16_t x);
+#endif
 
 /* pixel conversion & formatting */
+#ifndef JPEG_SIMD
 static uint32_t GetUYVY(int16_t y1, int16_t y2, int16_t u, int16_t v);
+#endif
+#ifndef JPEG_SIMD_RGBA
 static uint16_t GetRGBA(int16_t y, int16_t u, int16_t v);
+#endif
 
 /* tile line emitters */
 static void EmitYUVTileLine(struct hle_t* hle, const int16_t *y, const int16_t *u, uint32_t address);
@@ -72,7 +106,9 @@ static void ReorderSubBlock(int16_t *dst, const int16_t *src, const unsigned int
 static void MultSubBlocks(int16_t *dst, const int16_t *src1, const int16_t *src2, unsigned int shift);
 static void ScaleSubBlock(int16_t *dst, const int16_t *src, int16_t scale);
 static void RShiftSubBlock(int16_t *dst, const int16_t *src, unsigned int shift);
+#ifndef JPEG_SIMD
 static void InverseDCT1D(const float *const x, float *dst, unsigned int stride);
+#endif
 static void InverseDCTSubBlock(int16_t *dst, const int16_t *src);
 static void RescaleYSubBlock(int16_t *dst, const int16_t *src);
 static void RescaleUVSubBlock(int16_t *dst, const int16_t *src);
@@ -193,6 +229,63 @@ void jpeg_decode_OB(struct hle_t* hle)
 }
 
 
+/***************************************************************************
+ * DRAM ranges of the JPEG tasks, for hle_task_cache_execute. Macroblocks
+ * are decoded in place, so they are both the inputs and the outputs.
+ **************************************************************************/
+bool jpeg_decode_std_io(struct hle_t* hle, struct hle_task_io_t* io)
+{
+    uint32_t data_ptr;
+    uint32_t macroblock_count;
+    uint32_t mode;
+    unsigned int i;
+
+    if (*dmem_u32(hle, TASK_FLAGS) & 0x1)
+        return false;
+
+    data_ptr         = *dmem_u32(hle, TASK_DATA_PTR) & 0xffffff;
+    macroblock_count = *dram_u32(hle, data_ptr + 4);
+    mode             = *dram_u32(hle, data_ptr + 8);
+
+    if ((mode != 0 && mode != 2) || macroblock_count > 0x800000 / 0x400)
+        return false;
+
+    io->inputs[0].address = data_ptr;
+    io->inputs[0].size    = 24;
+
+    for (i = 0; i < 3; ++i) {
+        io->inputs[1 + i].address = *dram_u32(hle, data_ptr + 12 + 4 * i) & 0xffffff;
+        io->inputs[1 + i].size    = 2 * SUBBLOCK_SIZE;
+    }
+
+    io->inputs[4].address = *dram_u32(hle, data_ptr) & 0xffffff;
+    io->inputs[4].size    = macroblock_count * 2 * (mode + 4) * SUBBLOCK_SIZE;
+    io->input_count = 5;
+
+    io->outputs[0] = io->inputs[4];
+    io->output_count = 1;
+
+    return true;
+}
+
+bool jpeg_decode_OB_io(struct hle_t* hle, struct hle_task_io_t* io)
+{
+    const uint32_t macroblock_count = *dmem_u32(hle, TASK_DATA_SIZE);
+
+    if (macroblock_count > 0x800000 / (2 * 6 * SUBBLOCK_SIZE))
+        return false;
+
+    io->inputs[0].address = *dmem_u32(hle, TASK_DATA_PTR) & 0xffffff;
+    io->inputs[0].size    = macroblock_count * 2 * 6 * SUBBLOCK_SIZE;
+    io->input_count = 1;
+
+    io->outputs[0] = io->inputs[0];
+    io->output_count = 1;
+
+    return true;
+}
+
+
 /* local functions */
 static void jpeg_decode_std(struct hle_t* hle,
                             const char *const version,
@@ -265,10 +358,12 @@ static void jpeg_decode_std(struct hle_t* hle,
     }
 }
 
+#ifndef JPEG_SIMD
 static uint8_t clamp_u8(int16_t x)
 {
     return (x & (0xff00)) ? ((-x) >> 15) & 0xff : x;
 }
+#endif
 
 static int16_t clamp_s12(int16_t x)
 {
@@ -279,6 +374,7 @@ static int16_t clamp_s12(int16_t x)
     return x;
 }
 
+#ifndef JPEG_SIMD_RGBA
 static uint16_t clamp_RGBA_component(int16_t x)
 {
     if (x > 0xff0)
@@ -287,7 +383,9 @@ static uint16_t clamp_RGBA_component(int16_t x)
         x = 0;
     return (x & 0xf80);
 }
+#endif
 
+#ifndef JPEG_SIMD
 static uint32_t GetUYVY(int16_t y1, int16_t y2, int16_t u, int16_t v)
 {
     return (uint32_t)clamp_u8(u)  << 24 |
@@ -295,7 +393,9 @@ static uint32_t GetUYVY(int16_t y1, int16_t y2, int16_t u, int16_t v)
            (uint32_t)clamp_u8(v)  << 8 |
            (uint32_t)clamp_u8(y2);
 }
+#endif
 
+#ifndef JPEG_SIMD_RGBA
 static uint16_t GetRGBA(int16_t y, int16_t u, int16_t v)
 {
     const float fY = (float)y + 2048.0f;
@@ -308,6 +408,156 @@ static uint16_t GetRGBA(int16_t y, int16_t u, int16_t v)
 
     return (r << 4) | (g >> 1) | (b >> 6) | 1;
 }
+#endif
+
+#if defined(JPEG_SIMD_SSE2)
+/* clamp_u8 on 8 lanes, including its clamp_u8(-0x8000) == 1 quirk */
+static INLINE __m128i clamp_u8_x8(__m128i x)
+{
+    const __m128i quirk = _mm_and_si128(_mm_cmpeq_epi16(x, _mm_set1_epi16(-0x8000)), _mm_set1_epi16(1));
+    x = _mm_max_epi16(_mm_min_epi16(x, _mm_set1_epi16(0xff)), _mm_setzero_si128());
+    return _mm_or_si128(x, quirk);
+}
+
+/* 4 UYVY words from clamped y[0..7] and interleaved v, u pairs */
+static INLINE __m128i GetUYVY_x4(__m128i y, __m128i vu)
+{
+    /* each word is y2 | v << 8 | y1 << 16 | u << 24 */
+    const __m128i y21 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(y, 0xb1), 0xb1);
+    return _mm_or_si128(y21, _mm_slli_epi16(vu, 8));
+}
+#elif defined(JPEG_SIMD_NEON)
+static INLINE int16x8_t clamp_u8_x8(int16x8_t x)
+{
+    const int16x8_t quirk = vandq_s16(vreinterpretq_s16_u16(vceqq_s16(x, vdupq_n_s16(-0x8000))), vdupq_n_s16(1));
+    x = vmaxq_s16(vminq_s16(x, vdupq_n_s16(0xff)), vdupq_n_s16(0));
+    return vorrq_s16(x, quirk);
+}
+
+static INLINE int16x8_t GetUYVY_x4(int16x8_t y, int16x8_t vu)
+{
+    return vorrq_s16(vrev32q_s16(y), vshlq_n_s16(vu, 8));
+}
+#endif
+
+#ifdef JPEG_SIMD_RGBA
+#if defined(JPEG_SIMD_SSE2)
+/* the 4 pixels of y (32-bit lanes), with the same double precision
+ * operations as GetRGBA, before clamping */
+static INLINE void GetRGB_x4(__m128i y, __m128i u, __m128i v, __m128i *r, __m128i *g, __m128i *b)
+{
+    const __m128d y0 = _mm_cvtepi32_pd(_mm_add_epi32(y, _mm_set1_epi32(2048)));
+    const __m128d y1 = _mm_cvtepi32_pd(_mm_add_epi32(_mm_srli_si128(y, 8), _mm_set1_epi32(2048)));
+    const __m128d u0 = _mm_cvtepi32_pd(u);
+    const __m128d u1 = _mm_cvtepi32_pd(_mm_srli_si128(u, 8));
+    const __m128d v0 = _mm_cvtepi32_pd(v);
+    const __m128d v1 = _mm_cvtepi32_pd(_mm_srli_si128(v, 8));
+    const __m128d kr = _mm_set1_pd(1.4025);
+    const __m128d kgu = _mm_set1_pd(0.3443);
+    const __m128d kgv = _mm_set1_pd(0.7144);
+    const __m128d kb = _mm_set1_pd(1.7729);
+
+    *r = _mm_unpacklo_epi64(
+            _mm_cvttpd_epi32(_mm_add_pd(y0, _mm_mul_pd(kr, v0))),
+            _mm_cvttpd_epi32(_mm_add_pd(y1, _mm_mul_pd(kr, v1))));
+    *g = _mm_unpacklo_epi64(
+            _mm_cvttpd_epi32(_mm_sub_pd(_mm_sub_pd(y0, _mm_mul_pd(kgu, u0)), _mm_mul_pd(kgv, v0))),
+            _mm_cvttpd_epi32(_mm_sub_pd(_mm_sub_pd(y1, _mm_mul_pd(kgu, u1)), _mm_mul_pd(kgv, v1))));
+    *b = _mm_unpacklo_epi64(
+            _mm_cvttpd_epi32(_mm_add_pd(y0, _mm_mul_pd(kb, u0))),
+            _mm_cvttpd_epi32(_mm_add_pd(y1, _mm_mul_pd(kb, u1))));
+}
+
+/* (int16_t) conversion of two int32 vectors, then clamp_RGBA_component */
+static INLINE __m128i clamp_RGBA_component_x8(__m128i lo, __m128i hi)
+{
+    __m128i x = _mm_packs_epi32(
+            _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16),
+            _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16));
+    x = _mm_max_epi16(_mm_min_epi16(x, _mm_set1_epi16(0xff0)), _mm_setzero_si128());
+    return _mm_and_si128(x, _mm_set1_epi16(0xf80));
+}
+
+/* 8 RGBA pixels from y[0..7] and u[0..3], v[0..3] (low lanes) */
+static INLINE __m128i GetRGBA_x8(__m128i y, __m128i u, __m128i v)
+{
+    __m128i r[2], g[2], b[2];
+
+    /* each chroma sample covers two pixels */
+    u = _mm_unpacklo_epi16(u, u);
+    v = _mm_unpacklo_epi16(v, v);
+
+    GetRGB_x4(_mm_srai_epi32(_mm_unpacklo_epi16(y, y), 16),
+              _mm_srai_epi32(_mm_unpacklo_epi16(u, u), 16),
+              _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16),
+              &r[0], &g[0], &b[0]);
+    GetRGB_x4(_mm_srai_epi32(_mm_unpackhi_epi16(y, y), 16),
+              _mm_srai_epi32(_mm_unpackhi_epi16(u, u), 16),
+              _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16),
+              &r[1], &g[1], &b[1]);
+
+    return _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi16(clamp_RGBA_component_x8(r[0], r[1]), 4),
+                         _mm_srli_epi16(clamp_RGBA_component_x8(g[0], g[1]), 1)),
+            _mm_or_si128(_mm_srli_epi16(clamp_RGBA_component_x8(b[0], b[1]), 6),
+                         _mm_set1_epi16(1)));
+}
+#else
+static INLINE int32x2_t cvtt_f64_x2(float64x2_t x)
+{
+    return vmovn_s64(vcvtq_s64_f64(x));
+}
+
+static INLINE void GetRGB_x4(int32x4_t y, int32x4_t u, int32x4_t v, int32x4_t *r, int32x4_t *g, int32x4_t *b)
+{
+    const float64x2_t y0 = vcvtq_f64_s64(vmovl_s32(vget_low_s32(vaddq_s32(y, vdupq_n_s32(2048)))));
+    const float64x2_t y1 = vcvtq_f64_s64(vmovl_s32(vget_high_s32(vaddq_s32(y, vdupq_n_s32(2048)))));
+    const float64x2_t u0 = vcvtq_f64_s64(vmovl_s32(vget_low_s32(u)));
+    const float64x2_t u1 = vcvtq_f64_s64(vmovl_s32(vget_high_s32(u)));
+    const float64x2_t v0 = vcvtq_f64_s64(vmovl_s32(vget_low_s32(v)));
+    const float64x2_t v1 = vcvtq_f64_s64(vmovl_s32(vget_high_s32(v)));
+    const float64x2_t kr = vdupq_n_f64(1.4025);
+    const float64x2_t kgu = vdupq_n_f64(0.3443);
+    const float64x2_t kgv = vdupq_n_f64(0.7144);
+    const float64x2_t kb = vdupq_n_f64(1.7729);
+
+    *r = vcombine_s32(
+            cvtt_f64_x2(vaddq_f64(y0, vmulq_f64(kr, v0))),
+            cvtt_f64_x2(vaddq_f64(y1, vmulq_f64(kr, v1))));
+    *g = vcombine_s32(
+            cvtt_f64_x2(vsubq_f64(vsubq_f64(y0, vmulq_f64(kgu, u0)), vmulq_f64(kgv, v0))),
+            cvtt_f64_x2(vsubq_f64(vsubq_f64(y1, vmulq_f64(kgu, u1)), vmulq_f64(kgv, v1))));
+    *b = vcombine_s32(
+            cvtt_f64_x2(vaddq_f64(y0, vmulq_f64(kb, u0))),
+            cvtt_f64_x2(vaddq_f64(y1, vmulq_f64(kb, u1))));
+}
+
+static INLINE uint16x8_t clamp_RGBA_component_x8(int32x4_t lo, int32x4_t hi)
+{
+    int16x8_t x = vcombine_s16(vmovn_s32(lo), vmovn_s32(hi));
+    x = vmaxq_s16(vminq_s16(x, vdupq_n_s16(0xff0)), vdupq_n_s16(0));
+    return vandq_u16(vreinterpretq_u16_s16(x), vdupq_n_u16(0xf80));
+}
+
+static INLINE uint16x8_t GetRGBA_x8(int16x8_t y, int16x4_t u, int16x4_t v)
+{
+    const int16x4x2_t uu = vzip_s16(u, u);
+    const int16x4x2_t vv = vzip_s16(v, v);
+    int32x4_t r[2], g[2], b[2];
+
+    GetRGB_x4(vmovl_s16(vget_low_s16(y)), vmovl_s16(uu.val[0]), vmovl_s16(vv.val[0]),
+              &r[0], &g[0], &b[0]);
+    GetRGB_x4(vmovl_s16(vget_high_s16(y)), vmovl_s16(uu.val[1]), vmovl_s16(vv.val[1]),
+              &r[1], &g[1], &b[1]);
+
+    return vorrq_u16(
+            vorrq_u16(vshlq_n_u16(clamp_RGBA_component_x8(r[0], r[1]), 4),
+                      vshrq_n_u16(clamp_RGBA_component_x8(g[0], g[1]), 1)),
+            vorrq_u16(vshrq_n_u16(clamp_RGBA_component_x8(b[0], b[1]), 6),
+                      vdupq_n_u16(1)));
+}
+#endif
+#endif
 
 static void EmitYUVTileLine(struct hle_t* hle, const int16_t *y, const int16_t *u, uint32_t address)
 {
@@ -316,6 +566,20 @@ static void EmitYUVTileLine(struct hle_t* hle, const int16_t *y, const int16_t *
     const int16_t *const v  = u + SUBBLOCK_SIZE;
     const int16_t *const y2 = y + SUBBLOCK_SIZE;
 
+#if defined(JPEG_SIMD_SSE2)
+    const __m128i cu = clamp_u8_x8(_mm_loadu_si128((const __m128i *)u));
+    const __m128i cv = clamp_u8_x8(_mm_loadu_si128((const __m128i *)v));
+
+    _mm_storeu_si128((__m128i *)&uyvy[0],
+            GetUYVY_x4(clamp_u8_x8(_mm_loadu_si128((const __m128i *)y)), _mm_unpacklo_epi16(cv, cu)));
+    _mm_storeu_si128((__m128i *)&uyvy[4],
+            GetUYVY_x4(clamp_u8_x8(_mm_loadu_si128((const __m128i *)y2)), _mm_unpackhi_epi16(cv, cu)));
+#elif defined(JPEG_SIMD_NEON)
+    const int16x8x2_t vu = vzipq_s16(clamp_u8_x8(vld1q_s16(v)), clamp_u8_x8(vld1q_s16(u)));
+
+    vst1q_u32(&uyvy[0], vreinterpretq_u32_s16(GetUYVY_x4(clamp_u8_x8(vld1q_s16(y)), vu.val[0])));
+    vst1q_u32(&uyvy[4], vreinterpretq_u32_s16(GetUYVY_x4(clamp_u8_x8(vld1q_s16(y2)), vu.val[1])));
+#else
     uyvy[0] = GetUYVY(y[0],  y[1],  u[0], v[0]);
     uyvy[1] = GetUYVY(y[2],  y[3],  u[1], v[1]);
     uyvy[2] = GetUYVY(y[4],  y[5],  u[2], v[2]);
@@ -324,6 +588,7 @@ static void EmitYUVTileLine(struct hle_t* hle, const int16_t *y, const int16_t *
     uyvy[5] = GetUYVY(y2[2], y2[3], u[5], v[5]);
     uyvy[6] = GetUYVY(y2[4], y2[5], u[6], v[6]);
     uyvy[7] = GetUYVY(y2[6], y2[7], u[7], v[7]);
+#endif
 
     dram_store_u32(hle, uyvy, address, 8);
 }
@@ -335,6 +600,21 @@ static void EmitRGBATileLine(struct hle_t* hle, const int16_t *y, const int16_t
     const int16_t *const v  = u + SUBBLOCK_SIZE;
     const int16_t *const y2 = y + SUBBLOCK_SIZE;
 
+#if defined(JPEG_SIMD_RGBA) && defined(JPEG_SIMD_SSE2)
+    const __m128i vu = _mm_loadu_si128((const __m128i *)u);
+    const __m128i vv = _mm_loadu_si128((const __m128i *)v);
+
+    _mm_storeu_si128((__m128i *)&rgba[0],
+            GetRGBA_x8(_mm_loadu_si128((const __m128i *)y), vu, vv));
+    _mm_storeu_si128((__m128i *)&rgba[8],
+            GetRGBA_x8(_mm_loadu_si128((const __m128i *)y2), _mm_srli_si128(vu, 8), _mm_srli_si128(vv, 8)));
+#elif defined(JPEG_SIMD_RGBA)
+    const int16x8_t vu = vld1q_s16(u);
+    const int16x8_t vv = vld1q_s16(v);
+
+    vst1q_u16(&rgba[0], GetRGBA_x8(vld1q_s16(y),  vget_low_s16(vu),  vget_low_s16(vv)));
+    vst1q_u16(&rgba[8], GetRGBA_x8(vld1q_s16(y2), vget_high_s16(vu), vget_high_s16(vv)));
+#else
     rgba[0]  = GetRGBA(y[0],  u[0], v[0]);
     rgba[1]  = GetRGBA(y[1],  u[0], v[0]);
     rgba[2]  = GetRGBA(y[2],  u[1], v[1]);
@@ -351,6 +631,7 @@ static void EmitRGBATileLine(struct hle_t* hle, const int16_t *y, const int16_t
     rgba[13] = GetRGBA(y2[5], u[6], v[6]);
     rgba[14] = GetRGBA(y2[6], u[7], v[7]);
     rgba[15] = GetRGBA(y2[7], u[7], v[7]);
+#endif
 
     dram_store_u16(hle, rgba, address, 16);
 }
@@ -482,10 +763,36 @@ static void MultSubBlocks(int16_t *dst, const int16_t *src1, const int16_t *src2
 {
     unsigned int i;
 
+#if defined(JPEG_SIMD_SSE2)
+    const __m128i count = _mm_cvtsi32_si128(shift);
+
+    for (i = 0; i < SUBBLOCK_SIZE; i += 8) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)&src1[i]);
+        const __m128i b = _mm_loadu_si128((const __m128i *)&src2[i]);
+        const __m128i lo = _mm_mullo_epi16(a, b);
+        const __m128i hi = _mm_mulhi_epi16(a, b);
+        const __m128i v = _mm_packs_epi32(_mm_unpacklo_epi16(lo, hi), _mm_unpackhi_epi16(lo, hi));
+
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_sll_epi16(v, count));
+    }
+#elif defined(JPEG_SIMD_NEON)
+    const int16x8_t count = vdupq_n_s16(shift);
+
+    for (i = 0; i < SUBBLOCK_SIZE; i += 8) {
+        const int16x8_t a = vld1q_s16(&src1[i]);
+        const int16x8_t b = vld1q_s16(&src2[i]);
+        const int16x8_t v = vcombine_s16(
+                vqmovn_s32(vmull_s16(vget_low_s16(a), vget_low_s16(b))),
+                vqmovn_s32(vmull_s16(vget_high_s16(a), vget_high_s16(b))));
+
+        vst1q_s16(&dst[i], vshlq_s16(v, count));
+    }
+#else
     for (i = 0; i < SUBBLOCK_SIZE; ++i) {
         int32_t v = src1[i] * src2[i];
         dst[i] = clamp_s16(v) << shift;
     }
+#endif
 }
 
 static void ScaleSubBlock(int16_t *dst, const int16_t *src, int16_t scale)
@@ -511,7 +818,11 @@ static void RShiftSubBlock(int16_t *dst, const int16_t *src, unsigned int shift)
  * Computations use single precision floats
  * Implementation based on Wikipedia :
  * http://fr.wikipedia.org/wiki/Transform%C3%A9e_en_cosinus_discr%C3%A8te
+ *
+ * The SIMD versions run 4 rows (or columns) at once, with the same
+ * operations in the same order, so they give the same results.
  **************************************************************************/
+#ifndef JPEG_SIMD
 static void InverseDCT1D(const float *const x, float *dst, unsigned int stride)
 {
     float e[4];
@@ -551,9 +862,140 @@ static void InverseDCT1D(const float *const x, float *dst, unsigned int stride)
     dst += stride;
     *dst = f[0] + f[2] - e[0];
 }
+#else
+#if defined(JPEG_SIMD_SSE2)
+typedef __m128 idct_v;
+#define IDCT_ADD(a, b) _mm_add_ps(a, b)
+#define IDCT_SUB(a, b) _mm_sub_ps(a, b)
+#define IDCT_MUL(k, a) _mm_mul_ps(_mm_set1_ps(k), a)
+#else
+typedef float32x4_t idct_v;
+#define IDCT_ADD(a, b) vaddq_f32(a, b)
+#define IDCT_SUB(a, b) vsubq_f32(a, b)
+#define IDCT_MUL(k, a) vmulq_f32(vdupq_n_f32(k), a)
+#endif
+
+static INLINE void InverseDCT1D_x4(const idct_v *x, idct_v *dst)
+{
+    idct_v e[4];
+    idct_v f[4];
+    idct_v x26, x1357, x15, x37, x17, x35;
+
+    x15   = IDCT_MUL(IDCT_K[2], IDCT_ADD(x[1], x[5]));
+    x37   = IDCT_MUL(IDCT_K[3], IDCT_ADD(x[3], x[7]));
+    x17   = IDCT_MUL(IDCT_K[8], IDCT_ADD(x[1], x[7]));
+    x35   = IDCT_MUL(IDCT_K[9], IDCT_ADD(x[3], x[5]));
+    x1357 = IDCT_MUL(IDCT_C3,   IDCT_ADD(IDCT_ADD(IDCT_ADD(x[1], x[3]), x[5]), x[7]));
+    x26   = IDCT_MUL(IDCT_C6,   IDCT_ADD(x[2], x[6]));
+
+    f[0] = IDCT_ADD(x[0], x[4]);
+    f[1] = IDCT_SUB(x[0], x[4]);
+    f[2] = IDCT_ADD(x26, IDCT_MUL(IDCT_K[0], x[2]));
+    f[3] = IDCT_ADD(x26, IDCT_MUL(IDCT_K[1], x[6]));
+
+    e[0] = IDCT_ADD(IDCT_ADD(IDCT_ADD(x1357, x15), IDCT_MUL(IDCT_K[4], x[1])), x17);
+    e[1] = IDCT_ADD(IDCT_ADD(IDCT_ADD(x1357, x37), IDCT_MUL(IDCT_K[6], x[3])), x35);
+    e[2] = IDCT_ADD(IDCT_ADD(IDCT_ADD(x1357, x15), IDCT_MUL(IDCT_K[5], x[5])), x35);
+    e[3] = IDCT_ADD(IDCT_ADD(IDCT_ADD(x1357, x37), IDCT_MUL(IDCT_K[7], x[7])), x17);
+
+    dst[0] = IDCT_ADD(IDCT_ADD(f[0], f[2]), e[0]);
+    dst[1] = IDCT_ADD(IDCT_ADD(f[1], f[3]), e[1]);
+    dst[2] = IDCT_ADD(IDCT_SUB(f[1], f[3]), e[2]);
+    dst[3] = IDCT_ADD(IDCT_SUB(f[0], f[2]), e[3]);
+    dst[4] = IDCT_SUB(IDCT_SUB(f[0], f[2]), e[3]);
+    dst[5] = IDCT_SUB(IDCT_SUB(f[1], f[3]), e[2]);
+    dst[6] = IDCT_SUB(IDCT_ADD(f[1], f[3]), e[1]);
+    dst[7] = IDCT_SUB(IDCT_ADD(f[0], f[2]), e[0]);
+}
+
+/* x[0..7] = columns of the 4 rows in r[0..7] (two vectors per row) */
+static INLINE void TransposeRows_x4(const idct_v *r, idct_v *x)
+{
+    unsigned int h;
+
+    for (h = 0; h < 2; ++h) {
+#if defined(JPEG_SIMD_SSE2)
+        __m128 r0 = r[h], r1 = r[2 + h], r2 = r[4 + h], r3 = r[6 + h];
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        x[4 * h + 0] = r0;
+        x[4 * h + 1] = r1;
+        x[4 * h + 2] = r2;
+        x[4 * h + 3] = r3;
+#else
+        const float32x4x2_t t01 = vtrnq_f32(r[h], r[2 + h]);
+        const float32x4x2_t t23 = vtrnq_f32(r[4 + h], r[6 + h]);
+
+        x[4 * h + 0] = vcombine_f32(vget_low_f32(t01.val[0]),  vget_low_f32(t23.val[0]));
+        x[4 * h + 1] = vcombine_f32(vget_low_f32(t01.val[1]),  vget_low_f32(t23.val[1]));
+        x[4 * h + 2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+        x[4 * h + 3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+#endif
+    }
+}
+#endif
 
 static void InverseDCTSubBlock(int16_t *dst, const int16_t *src)
 {
+#ifdef JPEG_SIMD
+    idct_v r[8], x[8], y[8];
+    float block[SUBBLOCK_SIZE];
+    unsigned int i, j;
+
+    /* idct 1d on rows (+transposition) */
+    for (i = 0; i < 8; i += 4) {
+        for (j = 0; j < 4; ++j) {
+#if defined(JPEG_SIMD_SSE2)
+            const __m128i row = _mm_loadu_si128((const __m128i *)&src[(i + j) * 8]);
+            const __m128i sign = _mm_srai_epi16(row, 15);
+
+            r[2 * j + 0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(row, sign));
+            r[2 * j + 1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(row, sign));
+#else
+            const int16x8_t row = vld1q_s16(&src[(i + j) * 8]);
+
+            r[2 * j + 0] = vcvtq_f32_s32(vmovl_s16(vget_low_s16(row)));
+            r[2 * j + 1] = vcvtq_f32_s32(vmovl_s16(vget_high_s16(row)));
+#endif
+        }
+
+        TransposeRows_x4(r, x);
+        InverseDCT1D_x4(x, y);
+
+        for (j = 0; j < 8; ++j) {
+#if defined(JPEG_SIMD_SSE2)
+            _mm_storeu_ps(&block[j * 8 + i], y[j]);
+#else
+            vst1q_f32(&block[j * 8 + i], y[j]);
+#endif
+        }
+    }
+
+    /* idct 1d on columns (thanks to previous transposition) */
+    for (i = 0; i < 8; i += 4) {
+        for (j = 0; j < 8; ++j) {
+#if defined(JPEG_SIMD_SSE2)
+            r[j] = _mm_loadu_ps(&block[i * 8 + j * 4]);
+#else
+            r[j] = vld1q_f32(&block[i * 8 + j * 4]);
+#endif
+        }
+
+        TransposeRows_x4(r, x);
+        InverseDCT1D_x4(x, y);
+
+        /* C4 = 1 normalization implies a division by 8 */
+        for (j = 0; j < 8; ++j) {
+#if defined(JPEG_SIMD_SSE2)
+            const __m128i v = _mm_srai_epi32(_mm_slli_epi32(_mm_cvttps_epi32(y[j]), 16), 19);
+            _mm_storel_epi64((__m128i *)&dst[i + j * 8], _mm_packs_epi32(v, v));
+#else
+            const int32x4_t v = vshrq_n_s32(vshlq_n_s32(vcvtq_s32_f32(y[j]), 16), 19);
+            vst1_s16(&dst[i + j * 8], vmovn_s32(v));
+#endif
+        }
+    }
+#else
     float x[8];
     float block[SUBBLOCK_SIZE];
     unsigned int i, j;
@@ -574,6 +1016,7 @@ static void InverseDCTSubBlock(int16_t *dst, const int16_t *src)
         for (j = 0; j < 8; ++j)
             dst[i + j * 8] = (int16_t)x[j] >> 3;
     }
+#endif
 }
 
 static void RescaleYSubBlock(int16_t *dst, const int16_t *src)
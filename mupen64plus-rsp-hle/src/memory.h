@@ -98,9 +98,36 @@ void store_u32(unsigned char* buffer, unsigned address, const uint32_t* src, siz
 #define dram_load_u8(hle, dst, address, count)   load_u8((dst), (hle)->dram, (address) & 0xffffff, (count))
 #define dram_load_u16(hle, dst, address, count)  load_u16((dst), (hle)->dram, (address) & 0xffffff, (count))
 #define dram_load_u32(hle, dst, address, count)  load_u32((dst), (hle)->dram, (address) & 0xffffff, (count))
-#define dram_store_u8(hle, src, address, count)  store_u8((hle)->dram,  (address) & 0xffffff, (src), (count))
-#define dram_store_u16(hle, src, address, count) store_u16((hle)->dram, (address) & 0xffffff, (src), (count))
-#define dram_store_u32(hle, src, address, count) store_u32((hle)->dram, (address) & 0xffffff, (src), (count))
+#define dram_store_u8(hle, src, address, count) \
+    (store_u8((hle)->dram,  (address) & 0xffffff, (src), (count)), \
+     dram_written((hle), (address), (count)))
+#define dram_store_u16(hle, src, address, count) \
+    (store_u16((hle)->dram, (address) & 0xffffff, (src), (count)), \
+     dram_written((hle), (address), (count) * sizeof(uint16_t)))
+#define dram_store_u32(hle, src, address, count) \
+    (store_u32((hle)->dram, (address) & 0xffffff, (src), (count)), \
+     dram_written((hle), (address), (count) * sizeof(uint32_t)))
+
+/* report DRAM bytes [address, address+count[ to the core as written,
+ * needed by every write which doesn't go through dram_store_* */
+static INLINE void dram_written(struct hle_t* hle, uint32_t address, size_t count)
+{
+    uint32_t page, last;
+
+    if (hle->staging != NULL)
+    {
+        hle_stage_dram_write(hle->staging, address, count);
+        return;
+    }
+
+    if (hle->dram_written == NULL || count == 0)
+        return;
+
+    address &= 0xffffff;
+    last = (uint32_t)((address + count - 1) >> 12);
+    for (page = address >> 12; page <= last; ++page)
+        hle->dram_written[page & 0x7ff] = 1;
+}
 
 #endif
 
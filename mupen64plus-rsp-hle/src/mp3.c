@@ -250,6 +250,7 @@ void mp3_task(struct hle_t* hle, unsigned int index, uint32_t address)
        }
        /* --------------- Inner Loop End -------------------- */
        memcpy(hle->dram + writePtr, hle->mp3_buffer + 0xe70, 0x180);
+       dram_written(hle, writePtr, 0x180);
        writePtr += 0x180;
        readPtr  += 0x180;
     }
@@ -351,6 +351,8 @@ static void save_base_vol(struct hle_t* hle, const int32_t *base_vol, uint32_t a
 {
     unsigned k;
 
+    dram_written(hle, address, 16);
+
     for (k = 0; k < 4; ++k) {
         *dram_u16(hle, address) = (uint16_t)(base_vol[k] >> 16);
         address += 2;
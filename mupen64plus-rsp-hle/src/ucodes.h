@@ -22,9 +22,11 @@
 #ifndef UCODES_H
 #define UCODES_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 struct hle_t;
+struct hle_task_io_t;
 
 
 /* cic_x105 ucode */
@@ -142,5 +144,8 @@ void jpeg_decode_PS0(struct hle_t* hle);
 void jpeg_decode_PS(struct hle_t* hle);
 void jpeg_decode_OB(struct hle_t* hle);
 
+bool jpeg_decode_std_io(struct hle_t* hle, struct hle_task_io_t* io);
+bool jpeg_decode_OB_io(struct hle_t* hle, struct hle_task_io_t* io);
+
 #endif
 
@@ -38,7 +38,7 @@ DebugBlock::Impl::~Impl()
    //remove(name.c_str());
 }
 
-bool DebugBlock::compile(uint64_t hash, const std::string &source)
+bool DebugBlock::compile(uint64_t hash, const std::vector<uint32_t> &, const std::string &source)
 {
    impl = unique_ptr<Impl>(new Impl);
    bool ret = impl->compile(hash, source);
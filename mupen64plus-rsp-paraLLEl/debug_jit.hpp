@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace JIT
 {
@@ -15,8 +16,13 @@ namespace JIT
          DebugBlock(const std::unordered_map<std::string, uint64_t> &symbol_table);
          ~DebugBlock();
 
-         bool compile(uint64_t hash, const std::string &source);
+         bool compile(uint64_t hash, const std::vector<uint32_t> &key, const std::string &source);
          Func get_func() const { return block; }
+         size_t get_size() const { return 0; }
+
+         // Every block owns its own shared object, nothing to release here.
+         static size_t code_memory_usage() { return 0; }
+         static void set_cache_directory(const std::string &) {}
 
       private:
          struct Impl;
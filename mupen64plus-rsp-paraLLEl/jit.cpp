@@ -1,4 +1,5 @@
 #include "jit.hpp"
+#include "jit_codegen.hpp"
 
 #include <clang/Basic/DiagnosticOptions.h>
 #include <clang/CodeGen/CodeGenAction.h>
@@ -9,26 +10,15 @@
 #include <clang/Frontend/CompilerInvocation.h>
 #include <clang/Frontend/TextDiagnosticPrinter.h>
 #include <llvm/ADT/SmallString.h>
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
-#include <llvm/ExecutionEngine/MCJIT.h>
-#include <llvm/ExecutionEngine/ObjectCache.h>
-#include <llvm/ExecutionEngine/SectionMemoryManager.h>
-#include <llvm/ExecutionEngine/RuntimeDyld.h>
-#include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
-#include <llvm/IRReader/IRReader.h>
-#include <llvm/Support/FileSystem.h>
-#include <llvm/Support/Host.h>
 #include <llvm/Support/ManagedStatic.h>
-#include <llvm/Support/Path.h>
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/raw_ostream.h>
 
 #include <stdio.h>
-
-#include <sys/mman.h>
+#include <string.h>
 
 using namespace clang;
 using namespace std;
@@ -44,8 +34,11 @@ struct Block::Impl
 
    Func block = nullptr;
    size_t block_size = 0;
-   bool compile(const std::string &source);
+   bool compile(uint64_t hash, const std::vector<uint32_t> &key, const std::string &source);
    const unordered_map<string, uint64_t> &symbol_table;
+
+   // Pages of this block only, destroying it releases the code.
+   CodeRegion code;
 };
 
 Block::Block(const unordered_map<string, uint64_t> &symbol_table)
@@ -58,29 +51,6 @@ Block::~Block()
 {
 }
 
-struct ShaderJITResolver : public llvm::RuntimeDyld::SymbolResolver
-{
-   ShaderJITResolver(const unordered_map<string, uint64_t> &symbol_table)
-      : symbol_table(symbol_table)
-   {}
-
-   llvm::RuntimeDyld::SymbolInfo findSymbol(const std::string &name) override
-   {
-      auto itr = symbol_table.find(name);
-      if (itr != end(symbol_table))
-         return llvm::RuntimeDyld::SymbolInfo(itr->second, llvm::JITSymbolFlags::None);
-      else
-         return llvm::RuntimeDyld::SymbolInfo(nullptr);
-   }
-
-   llvm::RuntimeDyld::SymbolInfo findSymbolInLogicalDylib(const std::string &name) override
-   {
-      return llvm::RuntimeDyld::SymbolInfo(nullptr);
-   }
-
-   const unordered_map<string, uint64_t> &symbol_table;
-};
-
 struct LLVMHolder
 {
    LLVMHolder()
@@ -124,41 +94,21 @@ struct LLVMEngine
       act = llvm::make_unique<EmitLLVMOnlyAction>();
    }
 
-   Func compile(const std::unordered_map<std::string, uint64_t> &symbol_table)
+   // Runs clang on the source remapped to __block.c.
+   std::unique_ptr<llvm::Module> compile_source(const std::string &source)
    {
+      StringRef code_data(source);
+      auto buffer = llvm::MemoryBuffer::getMemBufferCopy(code_data);
+      invocation->getPreprocessorOpts().clearRemappedFiles();
+      invocation->getPreprocessorOpts().addRemappedFile("__block.c", buffer.release());
+
       if (!clang->ExecuteAction(*act))
       {
          fprintf(stderr, "ExecuteAction failed.");
          return nullptr;
       }
 
-      auto module = act->takeModule();
-      auto *tmp_module = module.get();
-
-      if (!EE)
-      {
-         auto resolver = llvm::make_unique<ShaderJITResolver>(symbol_table);
-         auto memory_manager = llvm::make_unique<llvm::SectionMemoryManager>();
-         EE = std::unique_ptr<llvm::ExecutionEngine>(llvm::EngineBuilder(std::move(module))
-               .setMCJITMemoryManager(move(memory_manager))
-               .setSymbolResolver(move(resolver))
-               .create());
-         EE->DisableLazyCompilation(true);
-      }
-      else
-         EE->addModule(std::move(module));
-
-      if (!EE)
-      {
-         llvm::errs() << "Failed to make execution engine.\n";
-         return nullptr;
-      }
-
-      EE->finalizeObject();
-      auto entry_point = EE->getFunctionAddress("block_entry");
-      auto block = reinterpret_cast<Func>(entry_point);
-      EE->removeModule(tmp_module);
-      return block;
+      return act->takeModule();
    }
 
    std::unique_ptr<LLVMHolder> llvm = llvm::make_unique<LLVMHolder>();
@@ -166,17 +116,41 @@ struct LLVMEngine
    std::string string_buffer;
    llvm::raw_string_ostream ss{string_buffer};
 
+   // Shared by all blocks, see jit_codegen.hpp.
+   CodeGenerator codegen;
+
    std::unique_ptr<CompilerInvocation> CI;
    std::unique_ptr<CompilerInstance> clang;
    std::unique_ptr<EmitLLVMOnlyAction> act;
-   std::unique_ptr<llvm::ExecutionEngine> EE;
    CompilerInvocation *invocation = nullptr;
 };
 
-bool Block::compile(uint64_t, const std::string &source)
+static LLVMEngine &get_llvm_engine()
+{
+   static LLVMEngine llvm;
+   return llvm;
+}
+
+size_t Block::code_memory_usage()
+{
+   return CodeGenerator::code_memory_usage();
+}
+
+// Applied on the next compile, so that setting options doesn't bring up
+// LLVM and clang before the RSP JIT is used at all.
+static std::string cache_directory;
+static bool cache_directory_changed = false;
+
+void Block::set_cache_directory(const std::string &path)
+{
+   cache_directory = path;
+   cache_directory_changed = true;
+}
+
+bool Block::compile(uint64_t hash, const std::vector<uint32_t> &key, const std::string &source)
 {
    impl = std::unique_ptr<Impl>(new Impl(symbol_table));
-   bool ret = impl->compile(source);
+   bool ret = impl->compile(hash, key, source);
    if (ret)
    {
       block = impl->block;
@@ -185,16 +159,27 @@ bool Block::compile(uint64_t, const std::string &source)
    return ret;
 }
 
-bool Block::Impl::compile(const std::string &source)
+bool Block::Impl::compile(uint64_t hash, const std::vector<uint32_t> &key, const std::string &source)
 {
-   static LLVMEngine llvm;
+   auto &llvm = get_llvm_engine();
 
-   StringRef code_data(source);
-   auto buffer = llvm::MemoryBuffer::getMemBufferCopy(code_data);
-   llvm.invocation->getPreprocessorOpts().clearRemappedFiles();
-   llvm.invocation->getPreprocessorOpts().addRemappedFile("__block.c", buffer.release());
+   if (cache_directory_changed)
+   {
+      llvm.codegen.set_cache_directory(cache_directory);
+      cache_directory_changed = false;
+   }
+
+   // Known microcode skips clang and codegen.
+   block = llvm.codegen.load_cached(hash, key, symbol_table, code);
+   if (!block)
+   {
+      auto module = llvm.compile_source(source);
+      if (!module)
+         return false;
+      block = llvm.codegen.compile(hash, key, *module, symbol_table, code);
+   }
 
-   block = llvm.compile(symbol_table);
+   block_size = code.size();
    return block != nullptr;
 }
 
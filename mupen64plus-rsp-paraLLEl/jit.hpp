@@ -2,8 +2,10 @@
 #define JIT_HPP__
 
 #include <memory>
+#include <stdint.h>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 namespace JIT
 {
@@ -13,8 +15,20 @@ namespace JIT
       public:
          Block(const std::unordered_map<std::string, uint64_t> &symbol_table);
          ~Block();
-         bool compile(uint64_t hash, const std::string &source);
+         // key holds the pc, word count and IMEM words the block was
+         // generated from, hash is the hash of the same.
+         bool compile(uint64_t hash, const std::vector<uint32_t> &key, const std::string &source);
          Func get_func() const { return block; }
+         size_t get_size() const { return block_size; }
+
+         // Code memory of all live blocks, in whole pages. Each block
+         // unmaps its own pages when destroyed.
+         static size_t code_memory_usage();
+
+         // Persists compiled blocks in a directory, keyed by the hash
+         // and key passed to compile(). An empty path disables the cache.
+         // Takes effect on the next compile().
+         static void set_cache_directory(const std::string &path);
 
       private:
          struct Impl;
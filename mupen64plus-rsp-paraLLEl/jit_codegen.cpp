@@ -0,0 +1,614 @@
+#include "jit_codegen.hpp"
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/RTDyldMemoryManager.h>
+#include <llvm/ExecutionEngine/RuntimeDyld.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Memory.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace JIT
+{
+
+// Code memory of all live regions, whole pages.
+static size_t code_memory_size = 0;
+
+static size_t round_to_pages(size_t size)
+{
+   static const size_t page_size = sysconf(_SC_PAGESIZE);
+   return (size + page_size - 1) & ~(page_size - 1);
+}
+
+CodeRegion::~CodeRegion()
+{
+   release();
+}
+
+bool CodeRegion::map(const size_t (&sizes)[KINDS])
+{
+   size_t total = 0;
+   for (auto size : sizes)
+      total += round_to_pages(size);
+
+   if (total == 0)
+      return true;
+
+   void *pages = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (pages == MAP_FAILED)
+      return false;
+
+   // One mapping, split so that each kind gets pages of its own.
+   auto *base = static_cast<uint8_t *>(pages);
+   for (unsigned kind = 0; kind < KINDS; kind++)
+   {
+      size_t size = round_to_pages(sizes[kind]);
+      if (size)
+      {
+         areas.push_back({ base, size, 0, Kind(kind) });
+         base += size;
+      }
+   }
+
+   mapped_size += total;
+   code_memory_size += total;
+   return true;
+}
+
+uint8_t *CodeRegion::allocate(Kind kind, size_t size, unsigned alignment)
+{
+   if (alignment == 0)
+      alignment = 1;
+
+   for (auto &area : areas)
+   {
+      if (area.kind != kind)
+         continue;
+
+      uintptr_t start = reinterpret_cast<uintptr_t>(area.base);
+      uintptr_t addr = (start + area.used + alignment - 1) & ~uintptr_t(alignment - 1);
+      if (addr + size <= start + area.size)
+      {
+         area.used = addr + size - start;
+         return reinterpret_cast<uint8_t *>(addr);
+      }
+   }
+
+   // Didn't fit what was reserved, give the section pages of its own.
+   size_t sizes[KINDS] = {};
+   sizes[kind] = size + alignment;
+   if (!map(sizes))
+      return nullptr;
+   return allocate(kind, size, alignment);
+}
+
+void CodeRegion::protect()
+{
+   for (auto &area : areas)
+   {
+      if (area.kind == CODE)
+      {
+         mprotect(area.base, area.size, PROT_READ | PROT_EXEC);
+         llvm::sys::Memory::InvalidateInstructionCache(area.base, area.used);
+      }
+      else if (area.kind == READ_ONLY)
+         mprotect(area.base, area.size, PROT_READ);
+   }
+}
+
+void CodeRegion::release()
+{
+   for (auto &area : areas)
+      munmap(area.base, area.size);
+   areas.clear();
+   code_memory_size -= mapped_size;
+   mapped_size = 0;
+}
+
+// Shared by all blocks, sections go to the region of the block being
+// loaded. RuntimeDyld reserves what an object needs up front, so a block
+// usually ends up with one mapping.
+class CodeMemoryManager : public llvm::RTDyldMemoryManager
+{
+public:
+   CodeRegion *region = nullptr;
+
+   bool needsToReserveAllocationSpace() override
+   {
+      return true;
+   }
+
+   void reserveAllocationSpace(uintptr_t code_size, uint32_t code_align,
+                               uintptr_t ro_size, uint32_t ro_align,
+                               uintptr_t rw_size, uint32_t rw_align) override
+   {
+      size_t sizes[CodeRegion::KINDS] = {
+         code_size ? code_size + code_align : 0,
+         ro_size ? ro_size + ro_align : 0,
+         rw_size ? rw_size + rw_align : 0,
+      };
+      region->map(sizes);
+   }
+
+   uint8_t *allocateCodeSection(uintptr_t size, unsigned alignment, unsigned section_id,
+                                llvm::StringRef section_name) override
+   {
+      return region->allocate(CodeRegion::CODE, size, alignment);
+   }
+
+   uint8_t *allocateDataSection(uintptr_t size, unsigned alignment, unsigned section_id,
+                                llvm::StringRef section_name, bool read_only) override
+   {
+      return region->allocate(read_only ? CodeRegion::READ_ONLY : CodeRegion::READ_WRITE, size, alignment);
+   }
+
+   bool finalizeMemory(std::string *) override
+   {
+      region->protect();
+      return false;
+   }
+};
+
+#if LLVM_VERSION_MAJOR >= 8
+using SymbolResolverBase = llvm::LegacyJITSymbolResolver;
+using ResolvedSymbol = llvm::JITSymbol;
+#elif LLVM_VERSION_MAJOR >= 4
+using SymbolResolverBase = llvm::JITSymbolResolver;
+using ResolvedSymbol = llvm::JITSymbol;
+#else
+using SymbolResolverBase = llvm::RuntimeDyld::SymbolResolver;
+using ResolvedSymbol = llvm::RuntimeDyld::SymbolInfo;
+#endif
+
+struct ShaderJITResolver : public SymbolResolverBase
+{
+   ShaderJITResolver(const SymbolTable &symbol_table, char global_prefix)
+      : symbol_table(symbol_table), global_prefix(global_prefix)
+   {}
+
+   ResolvedSymbol findSymbol(const std::string &name) override
+   {
+      bool prefixed = global_prefix && !name.empty() && name[0] == global_prefix;
+      auto itr = symbol_table.find(prefixed ? name.substr(1) : name);
+      if (itr != end(symbol_table))
+         return ResolvedSymbol(itr->second, llvm::JITSymbolFlags::None);
+      else
+         return ResolvedSymbol(nullptr);
+   }
+
+   ResolvedSymbol findSymbolInLogicalDylib(const std::string &name) override
+   {
+      return ResolvedSymbol(nullptr);
+   }
+
+   const SymbolTable &symbol_table;
+   char global_prefix;
+};
+
+static bool add_object_passes(llvm::TargetMachine &target_machine, llvm::legacy::PassManager &passes,
+                              llvm::raw_svector_ostream &stream)
+{
+#if LLVM_VERSION_MAJOR >= 10
+   return target_machine.addPassesToEmitFile(passes, stream, nullptr, llvm::CGFT_ObjectFile);
+#elif LLVM_VERSION_MAJOR >= 7
+   return target_machine.addPassesToEmitFile(passes, stream, nullptr, llvm::TargetMachine::CGFT_ObjectFile);
+#else
+   return target_machine.addPassesToEmitFile(passes, stream, llvm::TargetMachine::CGFT_ObjectFile);
+#endif
+}
+
+// Bump when the generated code changes in a way the IMEM key does not catch.
+static const uint32_t OBJECT_CACHE_VERSION = 2;
+static const char OBJECT_CACHE_MAGIC[8] = { 'R', 'S', 'P', 'J', 'I', 'T', 'O', 'C' };
+// Going over this compacts the file down to half of it, least recently
+// used objects first.
+static const size_t OBJECT_CACHE_MAX_FILE_SIZE = 64 * 1024 * 1024;
+
+// Object files from previous runs in a single file, so the clang
+// frontend and codegen can be skipped for known microcode.
+// Layout: magic, version, LLVM version, host CPU name, then records of
+// { uint64_t hash, uint32_t key words, uint32_t size, key, object data }.
+// The key holds the pc, length and IMEM words of the block, so a hash
+// collision can't load the code of another block.
+class PersistentObjectCache
+{
+public:
+   ~PersistentObjectCache()
+   {
+      if (file)
+         fclose(file);
+   }
+
+   void set_directory(const std::string &dir)
+   {
+      // Options are applied more than once, keep what is already loaded.
+      if (file && !dir.empty() && path == dir + "/parallel-rsp-jit.cache")
+         return;
+
+      if (file)
+         fclose(file);
+      file = nullptr;
+      objects.clear();
+      objects_size = 0;
+      file_size = 0;
+
+      if (dir.empty())
+         return;
+
+      if (llvm::sys::fs::create_directories(dir))
+      {
+         fprintf(stderr, "Failed to create RSP JIT cache directory %s.\n", dir.c_str());
+         return;
+      }
+      path = dir + "/parallel-rsp-jit.cache";
+
+      // Rewrite whatever survived if the file was stale, truncated,
+      // held replaced records or went over the size limit.
+      if (load() && file_size <= OBJECT_CACHE_MAX_FILE_SIZE)
+         file = fopen(path.c_str(), "ab");
+      else
+         compact(OBJECT_CACHE_MAX_FILE_SIZE / 2);
+
+      if (!file)
+      {
+         fprintf(stderr, "Failed to open RSP JIT cache %s.\n", path.c_str());
+         objects.clear();
+         objects_size = 0;
+      }
+   }
+
+   bool enabled() const { return file != nullptr; }
+
+   // Returns the object of a block, nullptr if there is none.
+   const std::vector<char> *find(uint64_t hash, const std::vector<uint32_t> &key)
+   {
+      auto itr = objects.find(hash);
+      if (!file || itr == end(objects) || itr->second.key != key)
+         return nullptr;
+
+      itr->second.stamp = next_stamp++;
+      return &itr->second.data;
+   }
+
+   void store(uint64_t hash, const std::vector<uint32_t> &key, const char *data, size_t size)
+   {
+      if (!file)
+         return;
+
+      // Replaces a block with a colliding hash, the file is compacted
+      // once it went over the limit.
+      auto itr = objects.find(hash);
+      if (itr != end(objects))
+      {
+         objects_size -= record_size(itr->second);
+         objects.erase(itr);
+      }
+
+      auto &object = objects[hash];
+      object.key = key;
+      object.data.assign(data, data + size);
+      object.stamp = next_stamp++;
+      objects_size += record_size(object);
+
+      if (file_size + record_size(object) > OBJECT_CACHE_MAX_FILE_SIZE)
+         compact(OBJECT_CACHE_MAX_FILE_SIZE / 2);
+      else
+      {
+         write_record(hash, object);
+         fflush(file);
+      }
+   }
+
+private:
+   struct Object
+   {
+      std::vector<uint32_t> key;
+      std::vector<char> data;
+      // Last use, older records in the file have lower stamps.
+      uint64_t stamp = 0;
+   };
+
+   FILE *file = nullptr;
+   std::string path;
+   unordered_map<uint64_t, Object> objects;
+   size_t objects_size = 0;
+   size_t file_size = 0;
+   uint64_t next_stamp = 0;
+
+   static std::string host_cpu()
+   {
+      return llvm::sys::getProcessTriple() + "/" + llvm::sys::getHostCPUName().str();
+   }
+
+   static size_t record_size(const Object &object)
+   {
+      return sizeof(uint64_t) + 2 * sizeof(uint32_t) +
+             object.key.size() * sizeof(uint32_t) + object.data.size();
+   }
+
+   size_t write_header(FILE *out)
+   {
+      uint32_t llvm_version = (LLVM_VERSION_MAJOR << 16) | (LLVM_VERSION_MINOR << 8) | LLVM_VERSION_PATCH;
+      auto cpu = host_cpu();
+      uint32_t cpu_size = cpu.size();
+
+      fwrite(OBJECT_CACHE_MAGIC, sizeof(OBJECT_CACHE_MAGIC), 1, out);
+      fwrite(&OBJECT_CACHE_VERSION, sizeof(OBJECT_CACHE_VERSION), 1, out);
+      fwrite(&llvm_version, sizeof(llvm_version), 1, out);
+      fwrite(&cpu_size, sizeof(cpu_size), 1, out);
+      fwrite(cpu.data(), cpu_size, 1, out);
+      return sizeof(OBJECT_CACHE_MAGIC) + 3 * sizeof(uint32_t) + cpu_size;
+   }
+
+   void write_record(uint64_t hash, const Object &object, FILE *out = nullptr)
+   {
+      if (!out)
+         out = file;
+
+      uint32_t key_words = object.key.size();
+      uint32_t size = object.data.size();
+      fwrite(&hash, sizeof(hash), 1, out);
+      fwrite(&key_words, sizeof(key_words), 1, out);
+      fwrite(&size, sizeof(size), 1, out);
+      fwrite(object.key.data(), sizeof(uint32_t), key_words, out);
+      fwrite(object.data.data(), size, 1, out);
+      file_size += record_size(object);
+   }
+
+   // Drops the least recently used objects down to target bytes and
+   // rewrites the file with the others, oldest first.
+   void compact(size_t target)
+   {
+      std::vector<std::pair<uint64_t, uint64_t>> order;
+      order.reserve(objects.size());
+      for (auto &object : objects)
+         order.push_back({ object.second.stamp, object.first });
+      sort(begin(order), end(order));
+
+      size_t first = 0;
+      while (first < order.size() && objects_size > target)
+      {
+         auto itr = objects.find(order[first++].second);
+         objects_size -= record_size(itr->second);
+         objects.erase(itr);
+      }
+
+      if (file)
+         fclose(file);
+      file = nullptr;
+
+      auto tmp_path = path + ".tmp";
+      FILE *out = fopen(tmp_path.c_str(), "wb");
+      if (!out)
+         return;
+
+      file_size = write_header(out);
+      for (size_t i = first; i < order.size(); i++)
+         write_record(order[i].second, objects[order[i].second], out);
+
+      bool written = !ferror(out);
+      if (fclose(out) != 0 || !written || rename(tmp_path.c_str(), path.c_str()) != 0)
+      {
+         remove(tmp_path.c_str());
+         return;
+      }
+
+      file = fopen(path.c_str(), "ab");
+   }
+
+   // Returns false if the file needs to be rewritten.
+   bool load()
+   {
+      FILE *in = fopen(path.c_str(), "rb");
+      if (!in)
+         return false;
+
+      char magic[sizeof(OBJECT_CACHE_MAGIC)];
+      uint32_t version, llvm_version, cpu_size;
+      uint32_t expected_llvm_version = (LLVM_VERSION_MAJOR << 16) | (LLVM_VERSION_MINOR << 8) | LLVM_VERSION_PATCH;
+      auto cpu = host_cpu();
+
+      if (fread(magic, sizeof(magic), 1, in) != 1 ||
+          memcmp(magic, OBJECT_CACHE_MAGIC, sizeof(magic)) ||
+          fread(&version, sizeof(version), 1, in) != 1 ||
+          version != OBJECT_CACHE_VERSION ||
+          fread(&llvm_version, sizeof(llvm_version), 1, in) != 1 ||
+          llvm_version != expected_llvm_version ||
+          fread(&cpu_size, sizeof(cpu_size), 1, in) != 1 ||
+          cpu_size != cpu.size())
+      {
+         fclose(in);
+         return false;
+      }
+
+      std::string file_cpu(cpu_size, '\0');
+      if (fread(&file_cpu[0], cpu_size, 1, in) != 1 || file_cpu != cpu)
+      {
+         fclose(in);
+         return false;
+      }
+
+      file_size = sizeof(OBJECT_CACHE_MAGIC) + 3 * sizeof(uint32_t) + cpu_size;
+
+      bool valid = true;
+      for (;;)
+      {
+         uint64_t hash;
+         uint32_t key_words, size;
+         if (fread(&hash, sizeof(hash), 1, in) != 1)
+            break;
+
+         Object object;
+         if (fread(&key_words, sizeof(key_words), 1, in) == 1 &&
+             fread(&size, sizeof(size), 1, in) == 1 &&
+             key_words <= 2 + 0x1000 / 4)
+         {
+            object.key.resize(key_words);
+            object.data.resize(size);
+            if (fread(object.key.data(), sizeof(uint32_t), key_words, in) == key_words &&
+                (size == 0 || fread(object.data.data(), size, 1, in) == 1))
+            {
+               auto itr = objects.find(hash);
+               if (itr != end(objects))
+               {
+                  // Replaced later in the file, drop the older one.
+                  objects_size -= record_size(itr->second);
+                  valid = false;
+               }
+
+               object.stamp = next_stamp++;
+               file_size += record_size(object);
+               objects_size += record_size(object);
+               objects[hash] = move(object);
+               continue;
+            }
+         }
+
+         valid = false;
+         break;
+      }
+
+      fclose(in);
+      return valid;
+   }
+};
+
+struct CodeGenerator::Impl
+{
+   Impl()
+   {
+      llvm::InitializeNativeTarget();
+      llvm::InitializeNativeTargetAsmPrinter();
+      llvm::InitializeNativeTargetAsmParser();
+
+      // What MCJIT would pick for the host.
+      target_machine.reset(llvm::EngineBuilder().selectTarget());
+      if (target_machine)
+         global_prefix = target_machine->createDataLayout().getGlobalPrefix();
+   }
+
+   Func load(const char *data, size_t size, const SymbolTable &symbol_table, CodeRegion &region);
+
+   std::unique_ptr<llvm::TargetMachine> target_machine;
+   char global_prefix = '\0';
+   CodeMemoryManager memory_manager;
+   PersistentObjectCache cache;
+};
+
+// Links an object file into region. RuntimeDyld is only needed until the
+// code is in place, the region owns it from there on.
+Func CodeGenerator::Impl::load(const char *data, size_t size, const SymbolTable &symbol_table,
+                               CodeRegion &region)
+{
+   auto object = llvm::object::ObjectFile::createObjectFile(
+         llvm::MemoryBufferRef(llvm::StringRef(data, size), "rsp-block"));
+   if (!object)
+   {
+#if LLVM_VERSION_MAJOR >= 4
+      llvm::consumeError(object.takeError());
+#endif
+      fprintf(stderr, "Invalid RSP JIT object.\n");
+      return nullptr;
+   }
+
+   ShaderJITResolver resolver(symbol_table, global_prefix);
+   llvm::RuntimeDyld dyld(memory_manager, resolver);
+
+   memory_manager.region = &region;
+   dyld.loadObject(**object);
+   if (!dyld.hasError())
+      dyld.resolveRelocations();
+   memory_manager.region = nullptr;
+
+   std::string entry_name = "block_entry";
+   if (global_prefix)
+      entry_name.insert(entry_name.begin(), global_prefix);
+
+   uint64_t entry_point = dyld.hasError() ? 0 : dyld.getSymbol(entry_name).getAddress();
+   if (!entry_point)
+   {
+      fprintf(stderr, "Failed to load RSP JIT block: %s\n", dyld.getErrorString().str().c_str());
+      region.release();
+      return nullptr;
+   }
+
+   // EH frames are not registered, nothing unwinds through blocks.
+   region.protect();
+   return reinterpret_cast<Func>(entry_point);
+}
+
+CodeGenerator::CodeGenerator()
+   : impl(new Impl)
+{
+}
+
+CodeGenerator::~CodeGenerator()
+{
+}
+
+void CodeGenerator::set_cache_directory(const std::string &path)
+{
+   impl->cache.set_directory(path);
+}
+
+Func CodeGenerator::load_cached(uint64_t hash, const std::vector<uint32_t> &key,
+                                const SymbolTable &symbol_table, CodeRegion &region)
+{
+   auto *object = impl->cache.find(hash, key);
+   if (!object || !impl->target_machine)
+      return nullptr;
+
+   return impl->load(object->data(), object->size(), symbol_table, region);
+}
+
+Func CodeGenerator::compile(uint64_t hash, const std::vector<uint32_t> &key, llvm::Module &module,
+                            const SymbolTable &symbol_table, CodeRegion &region)
+{
+   if (!impl->target_machine)
+   {
+      fprintf(stderr, "No LLVM target for the RSP JIT.\n");
+      return nullptr;
+   }
+
+   auto &target_machine = *impl->target_machine;
+   module.setTargetTriple(target_machine.getTargetTriple().str());
+   module.setDataLayout(target_machine.createDataLayout());
+
+   llvm::SmallVector<char, 0> object;
+   llvm::raw_svector_ostream stream(object);
+   llvm::legacy::PassManager passes;
+   if (add_object_passes(target_machine, passes, stream))
+   {
+      fprintf(stderr, "LLVM target can't emit RSP JIT objects.\n");
+      return nullptr;
+   }
+   passes.run(module);
+
+   impl->cache.store(hash, key, object.data(), object.size());
+   return impl->load(object.data(), object.size(), symbol_table, region);
+}
+
+size_t CodeGenerator::code_memory_usage()
+{
+   return code_memory_size;
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef JIT_CODEGEN_HPP__
+#define JIT_CODEGEN_HPP__
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm
+{
+class Module;
+}
+
+namespace JIT
+{
+   using Func = void (*)(void *, void *);
+   using SymbolTable = std::unordered_map<std::string, uint64_t>;
+
+   // Pages holding the code and data of one block. They are unmapped when
+   // the region is destroyed, which is what evicting a block releases.
+   class CodeRegion
+   {
+      public:
+         enum Kind { CODE, READ_ONLY, READ_WRITE, KINDS };
+
+         CodeRegion() = default;
+         ~CodeRegion();
+         CodeRegion(const CodeRegion &) = delete;
+         void operator=(const CodeRegion &) = delete;
+
+         // Mapped bytes, whole pages.
+         size_t size() const { return mapped_size; }
+
+         // Maps writable pages for sizes[kind] bytes of each kind.
+         bool map(const size_t (&sizes)[KINDS]);
+         // Carves a section out of the pages of its kind, mapping more
+         // if they are full.
+         uint8_t *allocate(Kind kind, size_t size, unsigned alignment);
+         // Makes code executable and read-only data read-only.
+         void protect();
+         void release();
+
+      private:
+         struct Area
+         {
+            uint8_t *base;
+            size_t size;
+            size_t used;
+            Kind kind;
+         };
+         std::vector<Area> areas;
+         size_t mapped_size = 0;
+   };
+
+   // Turns LLVM modules into code for all blocks with one target machine
+   // and one memory manager, which loads each block into its own
+   // CodeRegion. Compiled objects can be kept in a persistent cache.
+   class CodeGenerator
+   {
+      public:
+         CodeGenerator();
+         ~CodeGenerator();
+
+         // An empty path disables the persistent cache.
+         void set_cache_directory(const std::string &path);
+
+         // Loads the block compiled for hash and key from the persistent
+         // cache, nullptr if it isn't there.
+         Func load_cached(uint64_t hash, const std::vector<uint32_t> &key,
+                          const SymbolTable &symbol_table, CodeRegion &region);
+
+         // Compiles module, which has to define block_entry, and adds the
+         // object to the persistent cache.
+         Func compile(uint64_t hash, const std::vector<uint32_t> &key, llvm::Module &module,
+                      const SymbolTable &symbol_table, CodeRegion &region);
+
+         // Code memory of all live regions.
+         static size_t code_memory_usage();
+
+      private:
+         struct Impl;
+         std::unique_ptr<Impl> impl;
+   };
+}
+
+#endif
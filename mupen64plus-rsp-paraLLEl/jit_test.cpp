@@ -0,0 +1,236 @@
+// jit_test
+// Runs the code generator of the RSP JIT (jit_codegen.cpp) on blocks
+// written in LLVM IR, which needs neither clang nor the RSP: blocks are
+// loaded, called and evicted, and code memory has to follow in whole
+// pages. Blocks written to the persistent cache are loaded back by a new
+// code generator, as after a restart, and have to run the same.
+//
+// usage: jit_test
+// Prints each failed check and exits with a non-zero status if any failed.
+
+#include "jit_codegen.hpp"
+
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SourceMgr.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+using namespace JIT;
+using namespace std;
+
+static int failures;
+
+#define CHECK(cond) \
+   do { \
+      if (!(cond)) { \
+         printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+         ++failures; \
+      } \
+   } while (0)
+
+extern "C" uint32_t RSP_mix(uint32_t value, uint32_t scale)
+{
+   return value * scale + 7;
+}
+
+static const SymbolTable symbol_table = {
+   { "RSP_mix", reinterpret_cast<uint64_t>(RSP_mix) },
+};
+
+// Calls into the symbol table and reads a constant table, so blocks get
+// code, read-only data and relocations against both.
+static const char block_ir[] =
+   "@table = private unnamed_addr constant [4 x i32] [i32 1, i32 10, i32 100, i32 1000]\n"
+   "declare i32 @RSP_mix(i32, i32)\n"
+   "define void @block_entry(i8* %state, i8* %dmem) {\n"
+   "entry:\n"
+   "  %regs = bitcast i8* %state to i32*\n"
+   "  %value = load i32, i32* %regs\n"
+   "  %index = and i32 %value, 3\n"
+   "  %slot = getelementptr [4 x i32], [4 x i32]* @table, i32 0, i32 %index\n"
+   "  %scale = load i32, i32* %slot\n"
+   "  %mixed = call i32 @RSP_mix(i32 %value, i32 %scale)\n"
+   "  %result = add i32 %mixed, BLOCK_ID\n"
+   "  store i32 %result, i32* %regs\n"
+   "  ret void\n"
+   "}\n";
+
+static uint32_t expected_result(uint32_t value, unsigned id)
+{
+   static const uint32_t table[4] = { 1, 10, 100, 1000 };
+   return RSP_mix(value, table[value & 3]) + id;
+}
+
+static Func compile_block(CodeGenerator &codegen, unsigned id, CodeRegion &region)
+{
+   string ir = block_ir;
+   ir.replace(ir.find("BLOCK_ID"), 8, to_string(id));
+
+   llvm::LLVMContext context;
+   llvm::SMDiagnostic error;
+   auto module = llvm::parseIR(llvm::MemoryBufferRef(ir, "block"), error, context);
+   if (!module)
+   {
+      printf("invalid IR for block %u: %s\n", id, error.getMessage().str().c_str());
+      return nullptr;
+   }
+
+   vector<uint32_t> key = { id };
+   return codegen.compile(id, key, *module, symbol_table, region);
+}
+
+static bool run_block(Func func, unsigned id, uint32_t value)
+{
+   uint32_t state = value;
+   func(&state, nullptr);
+   return state == expected_result(value, id);
+}
+
+static void test_evict()
+{
+   static const unsigned BLOCKS = 64;
+   const size_t page_size = sysconf(_SC_PAGESIZE);
+   CodeGenerator codegen;
+   unique_ptr<CodeRegion> regions[BLOCKS];
+   Func funcs[BLOCKS];
+   size_t total = 0;
+
+   CHECK(CodeGenerator::code_memory_usage() == 0);
+
+   for (unsigned i = 0; i < BLOCKS; i++)
+   {
+      regions[i].reset(new CodeRegion);
+      funcs[i] = compile_block(codegen, i, *regions[i]);
+      CHECK(funcs[i] != nullptr);
+      CHECK(regions[i]->size() >= page_size);
+      CHECK(regions[i]->size() % page_size == 0);
+      total += regions[i]->size();
+   }
+
+   // usage is what the blocks mapped, not what their sections hold
+   CHECK(CodeGenerator::code_memory_usage() == total);
+
+   for (unsigned i = 0; i < BLOCKS; i++)
+      CHECK(funcs[i] && run_block(funcs[i], i, 5 + i));
+
+   // evicting some blocks leaves the others runnable
+   for (unsigned i = 0; i < BLOCKS; i += 2)
+   {
+      total -= regions[i]->size();
+      regions[i].reset();
+      CHECK(CodeGenerator::code_memory_usage() == total);
+   }
+
+   for (unsigned i = 1; i < BLOCKS; i += 2)
+      CHECK(funcs[i] && run_block(funcs[i], i, 0x1234 + i));
+
+   for (unsigned i = 1; i < BLOCKS; i += 2)
+      regions[i].reset();
+   CHECK(CodeGenerator::code_memory_usage() == 0);
+
+   // compiling many more blocks than ever live at once stays bounded
+   for (unsigned i = 0; i < 4 * BLOCKS; i++)
+   {
+      CodeRegion region;
+      Func func = compile_block(codegen, 1000 + i, region);
+      CHECK(func && run_block(func, 1000 + i, i));
+      CHECK(CodeGenerator::code_memory_usage() == region.size());
+   }
+   CHECK(CodeGenerator::code_memory_usage() == 0);
+}
+
+static void test_cache_round_trip()
+{
+   static const unsigned BLOCKS = 16;
+   char dir[] = "/tmp/jit_test-XXXXXX";
+   if (!mkdtemp(dir))
+   {
+      printf("couldn't create a cache directory\n");
+      ++failures;
+      return;
+   }
+   string path = string(dir) + "/parallel-rsp-jit.cache";
+
+   {
+      CodeGenerator codegen;
+      codegen.set_cache_directory(dir);
+      for (unsigned i = 0; i < BLOCKS; i++)
+      {
+         CodeRegion region;
+         Func func = compile_block(codegen, i, region);
+         CHECK(func && run_block(func, i, 3 * i));
+      }
+   }
+
+   FILE *file = fopen(path.c_str(), "rb");
+   CHECK(file != nullptr);
+   if (file)
+      fclose(file);
+
+   {
+      CodeGenerator codegen;
+      codegen.set_cache_directory(dir);
+      for (unsigned i = 0; i < BLOCKS; i++)
+      {
+         CodeRegion region;
+         vector<uint32_t> key = { i };
+         Func func = codegen.load_cached(i, key, symbol_table, region);
+         CHECK(func && run_block(func, i, 3 * i));
+         CHECK(region.size() > 0);
+      }
+
+      // same hash, other IMEM words
+      CodeRegion region;
+      vector<uint32_t> other_key = { 1, 2 };
+      CHECK(codegen.load_cached(1, other_key, symbol_table, region) == nullptr);
+      CHECK(codegen.load_cached(BLOCKS, { BLOCKS }, symbol_table, region) == nullptr);
+      CHECK(region.size() == 0);
+
+      // disabled, nothing comes from the file
+      codegen.set_cache_directory("");
+      vector<uint32_t> key = { 0 };
+      CHECK(codegen.load_cached(0, key, symbol_table, region) == nullptr);
+   }
+
+   // a torn last record is dropped, the ones before it still load
+   file = fopen(path.c_str(), "ab");
+   if (file)
+   {
+      uint64_t hash = BLOCKS;
+      fwrite(&hash, sizeof(hash), 1, file);
+      fclose(file);
+   }
+
+   {
+      CodeGenerator codegen;
+      codegen.set_cache_directory(dir);
+      CodeRegion region;
+      vector<uint32_t> key = { BLOCKS - 1 };
+      Func func = codegen.load_cached(BLOCKS - 1, key, symbol_table, region);
+      CHECK(func && run_block(func, BLOCKS - 1, 77));
+   }
+
+   remove(path.c_str());
+   rmdir(dir);
+}
+
+int main()
+{
+   test_evict();
+   test_cache_round_trip();
+
+   if (failures)
+   {
+      printf("%d checks failed\n", failures);
+      return 1;
+   }
+
+   printf("all checks passed\n");
+   return 0;
+}
@@ -1,9 +1,43 @@
+// Offline RSP trace replay.
+//
+// Runs the tasks recorded by the cxd4 trace dumper (HAVE_RSP_DUMP=1 with
+// USE_CXD4_NEW=0, RSP_DUMP=<file>) through the cxd4 interpreter, the HLE
+// plugin and this JIT, and reports wall time per task type, executed
+// instructions, a vector opcode histogram and every divergence from the
+// recorded output.
+//
+// usage: main [-b cxd4,hle,parallel] [-q] trace.rsp
+//        main dmem.bin imem.bin
+//
+// The recorded end state comes from cxd4 and is the reference. DMEM and the
+// register file are checked for the LLE backends only, HLE does not model
+// them and is checked on RDRAM alone. Traces recorded before RDRAM pages
+// were dumped replay with an empty RDRAM and will diverge.
+
 #include "rsp.hpp"
+#include "replay.h"
+#include <algorithm>
 #include <vector>
+#include <chrono>
+#include <stdexcept>
 #include <stdio.h>
 
+#ifdef PARALLEL_INTEGRATION
+#include "Rsp_#1.1.h"
+#include "m64p_plugin.h"
+namespace RSP
+{
+   extern RSP_INFO rsp;
+}
+#endif
+
 using namespace std;
 
+#define RDRAM_SIZE (8 * 1024 * 1024)
+// cxd4 does not clamp DMA writes to the end of RDRAM.
+#define RDRAM_ALLOC_SIZE (16 * 1024 * 1024)
+#define MAX_REPORTED_ERRORS 8
+
 static inline uint32_t flip_endian(uint32_t v)
 {
    return
@@ -33,270 +67,492 @@ static vector<uint32_t> read_binary(const char *path, bool flip)
    return v;
 }
 
-static bool read_tag_validate(FILE *file, const char *tag)
+static const char *vu_opcode_names[64] = {
+   "VMULF", "VMULU", "VRNDP", "VMULQ", "VMUDL", "VMUDM", "VMUDN", "VMUDH",
+   "VMACF", "VMACU", "VRNDN", "VMACQ", "VMADL", "VMADM", "VMADN", "VMADH",
+   "VADD",  "VSUB",  "VSUT",  "VABS",  "VADDC", "VSUBC", "VADDB", "VSUBB",
+   "VACCB", "VSUCB", "VSAD",  "VSAC",  "VSUM",  "VSAW",  "V30",   "V31",
+   "VLT",   "VEQ",   "VNE",   "VGE",   "VCL",   "VCH",   "VCR",   "VMRG",
+   "VAND",  "VNAND", "VOR",   "VNOR",  "VXOR",  "VNXOR", "V46",   "V47",
+   "VRCP",  "VRCPL", "VRCPH", "VMOV",  "VRSQ",  "VRSQL", "VRSQH", "VNOP",
+   "VEXTT", "VEXTQ", "VEXTN", "V59",   "VINST", "VINSQ", "VINSN", "VNULL",
+};
+
+enum TaskType
 {
-   char tmp[9] = {};
-   if (fread(tmp, 1, 8, file) != 8)
-      throw runtime_error("Failed to read tag.");
+   TASK_GFX,
+   TASK_AUDIO,
+   TASK_JPEG,
+   TASK_OTHER,
+   TASK_TYPES
+};
 
-   if (strcmp(tmp, "EOF     ") == 0)
-      return false;
+static const char *task_type_names[TASK_TYPES] = { "gfx", "audio", "jpeg", "other" };
 
-   if (strcmp(tmp, tag))
-      throw runtime_error("Unexpected tag.");
+enum Backend
+{
+   BACKEND_CXD4,
+   BACKEND_HLE,
+   BACKEND_PARALLEL,
+   BACKENDS
+};
 
-   return true;
-}
+static const char *backend_names[BACKENDS] = { "cxd4", "hle", "parallel" };
 
-static bool read_block(FILE *file, const char *tag, void *buffer, size_t size)
+struct Task
 {
-   if (!read_tag_validate(file, tag))
-      return false;
+   replay_state begin = {};
+   replay_state end = {};
+   vector<uint8_t> expected_rdram;
+};
 
-   uint32_t block_size;
-   if (fread(&block_size, sizeof(block_size), 1, file) != 1)
-      throw runtime_error("EOF");
+struct BackendStats
+{
+   uint64_t tasks[TASK_TYPES] = {};
+   uint64_t nsec[TASK_TYPES] = {};
+   uint64_t skipped = 0;
+   uint64_t divergent = 0;
+};
 
-   if (size != block_size)
-      throw runtime_error("Unexpected size");
+class TraceReader
+{
+   public:
+      TraceReader(const char *path)
+      {
+         file = fopen(path, "rb");
+         if (!file)
+            throw runtime_error("Failed to load trace.");
 
-   if (fread(buffer, size, 1, file) != 1)
-      throw runtime_error("EOF");
+         if (!read_tag() || tag != "RSPDUMP1")
+            throw runtime_error("Not an RSP trace.");
+      }
 
-   return true;
-}
+      ~TraceReader()
+      {
+         fclose(file);
+      }
+
+      // RDRAM is accumulated over the trace, pages are only recorded when
+      // they change.
+      bool next(Task &task, vector<uint8_t> &rdram)
+      {
+         if (!read_tag() || tag == "EOF     ")
+            return false;
+         if (tag != "BEGIN   ")
+            throw runtime_error("Expected BEGIN.");
+
+         vector<pair<uint32_t, vector<uint8_t>>> dma_writes;
 
-static bool read_poke(FILE *file, RSP::CPU &cpu)
+         while (read_tag() && tag != "END     ")
+         {
+            if (tag == "BEGINDMA" || tag == "ENDDMA  ")
+               continue;
+
+            if (tag == "POKE    " || tag == "RDRAM   " || tag == "DMAWRITE")
+            {
+               uint32_t base = read_u32();
+               vector<uint8_t> data(read_u32());
+               read_data(data.data(), data.size());
+
+               if (tag == "RDRAM   ")
+               {
+                  if (base + data.size() > RDRAM_SIZE)
+                     throw runtime_error("RDRAM page out of range.");
+                  memcpy(rdram.data() + base, data.data(), data.size());
+               }
+               else if (tag == "DMAWRITE")
+                  dma_writes.emplace_back(base, move(data));
+               continue;
+            }
+
+            uint32_t size = read_u32();
+            void *dst = block_target(task, size);
+            read_data(dst, size);
+         }
+
+         if (tag != "END     ")
+            throw runtime_error("Unexpected EOF.");
+
+         task.begin.rdram = rdram.data();
+         task.expected_rdram = rdram;
+         for (auto &write : dma_writes)
+            for (size_t i = 0; i < write.second.size(); i++)
+               task.expected_rdram[(write.first + i) & (RDRAM_SIZE - 1)] = write.second[i];
+
+         return true;
+      }
+
+   private:
+      FILE *file;
+      string tag;
+
+      bool read_tag()
+      {
+         char tmp[9] = {};
+         if (fread(tmp, 1, 8, file) != 8)
+            return false;
+         tag = tmp;
+         return true;
+      }
+
+      uint32_t read_u32()
+      {
+         uint32_t value;
+         read_data(&value, sizeof(value));
+         return value;
+      }
+
+      void read_data(void *data, size_t size)
+      {
+         if (size && fread(data, size, 1, file) != 1)
+            throw runtime_error("Unexpected EOF.");
+      }
+
+      void *block_target(Task &task, uint32_t size)
+      {
+         struct Block
+         {
+            const char *tag;
+            void *begin, *end;
+            size_t size;
+         };
+         const Block blocks[] = {
+            { "DMEM    ", task.begin.dmem, task.end.dmem, sizeof(task.begin.dmem) },
+            { "IMEM    ", task.begin.imem, task.end.imem, sizeof(task.begin.imem) },
+            { "SR32    ", task.begin.sr, task.end.sr, sizeof(task.begin.sr) },
+            { "VR32    ", task.begin.vr, task.end.vr, sizeof(task.begin.vr) },
+            { "VLO     ", task.begin.vlo, task.end.vlo, sizeof(task.begin.vlo) },
+            { "VMD     ", task.begin.vmd, task.end.vmd, sizeof(task.begin.vmd) },
+            { "VHI     ", task.begin.vhi, task.end.vhi, sizeof(task.begin.vhi) },
+            { "PC      ", &task.begin.pc, nullptr, sizeof(task.begin.pc) },
+            { "VCO     ", &task.begin.vco, &task.end.vco, sizeof(task.begin.vco) },
+            { "VCC     ", &task.begin.vcc, &task.end.vcc, sizeof(task.begin.vcc) },
+            { "VCE     ", &task.begin.vce, &task.end.vce, sizeof(task.begin.vce) },
+         };
+
+         // End state tags are "XXXX END", "VLO  END" etc.
+         bool end = tag.compare(5, 3, "END") == 0;
+         for (auto &block : blocks)
+         {
+            if (tag.compare(0, 4, block.tag, 4) != 0 || (end && !block.end))
+               continue;
+            if (size != block.size)
+               throw runtime_error("Unexpected block size for " + tag);
+            return end ? block.end : block.begin;
+         }
+
+         throw runtime_error("Unexpected tag " + tag);
+      }
+};
+
+static TaskType classify_task(const replay_state &state)
 {
-   char tmp[9] = {};
-   if (fread(tmp, 1, 8, file) != 8)
-      throw runtime_error("Failed to read tag.");
+   // OSTask header at the end of DMEM, see rsp-hle ucodes.
+   uint32_t type = state.dmem[0xfc0 >> 2];
+   uint32_t ucode_boot_size = state.dmem[0xfcc >> 2];
 
-   if (strcmp(tmp, "ENDDMA  ") == 0)
-      return false;
+   if (ucode_boot_size > 0x1000)
+      return TASK_OTHER;
 
-   if (strcmp(tmp, "POKE    "))
-      throw runtime_error("Unexpected tag.");
+   switch (type)
+   {
+      case 1:
+         return TASK_GFX;
+      case 2:
+         return TASK_AUDIO;
+      case 4:
+         return TASK_JPEG;
+      default:
+         return TASK_OTHER;
+   }
+}
 
-   uint32_t offset;
-   uint32_t len;
+static uint64_t run_parallel(RSP::CPU &cpu, replay_state &state)
+{
+   auto &s = cpu.get_state();
+   uint32_t cr[16] = {};
+   uint32_t irq = 0;
 
-   if (fread(&offset, sizeof(offset), 1, file) != 1)
-      throw runtime_error("Wrong EOF");
-   if (fread(&len, sizeof(len), 1, file) != 1)
-      throw runtime_error("Wrong EOF");
+   for (unsigned i = 0; i < 16; i++)
+      s.cp0.cr[i] = &cr[i];
+   s.cp0.irq = &irq;
+
+   cpu.set_dmem(state.dmem);
+   cpu.set_imem(state.imem);
+   cpu.set_rdram(reinterpret_cast<uint32_t *>(state.rdram));
+
+   memcpy(s.sr, state.sr, sizeof(s.sr));
+   memcpy(s.cp2.regs, state.vr, sizeof(s.cp2.regs));
+   memcpy(s.cp2.acc.e + RSP::RSP_ACC_LO, state.vlo, sizeof(state.vlo));
+   memcpy(s.cp2.acc.e + RSP::RSP_ACC_MD, state.vmd, sizeof(state.vmd));
+   memcpy(s.cp2.acc.e + RSP::RSP_ACC_HI, state.vhi, sizeof(state.vhi));
+   rsp_set_flags(s.cp2.flags[RSP::RSP_VCO].e, state.vco);
+   rsp_set_flags(s.cp2.flags[RSP::RSP_VCC].e, state.vcc);
+   rsp_set_flags(s.cp2.flags[RSP::RSP_VCE].e, state.vce);
+   s.pc = state.pc;
+
+   // Same loop as parallelRSPDoRspCycles, JIT time is accounted separately.
+   uint64_t compile_us = cpu.get_block_cache_stats().compile_time_us;
+   cpu.invalidate_imem();
+   while (!(cr[RSP::CP0_REGISTER_SP_STATUS] & SP_STATUS_HALT))
+   {
+      auto mode = cpu.run();
+#ifndef PARALLEL_INTEGRATION
+      if (mode == RSP::MODE_DMA_READ)
+         throw runtime_error("paraLLEl must be built with PARALLEL_INTEGRATION for replays.");
+#endif
+      if (mode == RSP::MODE_CHECK_FLAGS && (irq & 1))
+         break;
+   }
+
+   memcpy(state.sr, s.sr, sizeof(s.sr));
+   memcpy(state.vr, s.cp2.regs, sizeof(state.vr));
+   memcpy(state.vlo, s.cp2.acc.e + RSP::RSP_ACC_LO, sizeof(state.vlo));
+   memcpy(state.vmd, s.cp2.acc.e + RSP::RSP_ACC_MD, sizeof(state.vmd));
+   memcpy(state.vhi, s.cp2.acc.e + RSP::RSP_ACC_HI, sizeof(state.vhi));
+   state.vco = rsp_get_flags(s.cp2.flags[RSP::RSP_VCO].e);
+   state.vcc = rsp_get_flags(s.cp2.flags[RSP::RSP_VCC].e);
+   state.vce = rsp_get_flags(s.cp2.flags[RSP::RSP_VCE].e) & 0xff;
+   state.pc = s.pc;
+
+   return (cpu.get_block_cache_stats().compile_time_us - compile_us) * 1000;
+}
 
-   if (offset >= 0x1000)
+template<typename T>
+static unsigned compare(const char *what, const T *expected, const T *got, size_t count,
+      unsigned stride, unsigned errors, bool report)
+{
+   unsigned mismatches = 0;
+   for (size_t i = 0; i < count; i++)
    {
-      if (fread(reinterpret_cast<uint8_t *>(cpu.get_state().imem) + offset - 0x1000, len, 1, file) != 1)
-         throw runtime_error("Wrong EOF");
+      if (expected[i] == got[i])
+         continue;
+      if (report && errors + mismatches < MAX_REPORTED_ERRORS)
+         fprintf(stderr, "    %s[0x%06zx] expected 0x%0*llx, got 0x%0*llx\n",
+               what, i * stride, int(sizeof(T) * 2), (unsigned long long)expected[i],
+               int(sizeof(T) * 2), (unsigned long long)got[i]);
+      mismatches++;
    }
-   else
+   return mismatches;
+}
+
+static unsigned validate(Backend backend, const Task &task, const replay_state &state, bool report)
+{
+   unsigned errors = 0;
+
+   if (backend != BACKEND_HLE)
    {
-      if (fread(reinterpret_cast<uint8_t *>(cpu.get_state().dmem) + offset, len, 1, file) != 1)
-         throw runtime_error("Wrong EOF");
+      errors += compare("DMEM", task.end.dmem, state.dmem, 0x1000 >> 2, 4, errors, report);
+      errors += compare("IMEM", task.end.imem, state.imem, 0x1000 >> 2, 4, errors, report);
+      errors += compare("SR", task.end.sr, state.sr, 32, 1, errors, report);
+      errors += compare("VR", task.end.vr, state.vr, 32 * 8, 1, errors, report);
+      errors += compare("VLO", task.end.vlo, state.vlo, 8, 1, errors, report);
+      errors += compare("VMD", task.end.vmd, state.vmd, 8, 1, errors, report);
+      errors += compare("VHI", task.end.vhi, state.vhi, 8, 1, errors, report);
+      errors += compare("VCO", &task.end.vco, &state.vco, 1, 1, errors, report);
+      errors += compare("VCC", &task.end.vcc, &state.vcc, 1, 1, errors, report);
+      errors += compare("VCE", &task.end.vce, &state.vce, 1, 1, errors, report);
    }
 
-   return true;
+   errors += compare("RDRAM", reinterpret_cast<const uint32_t *>(task.expected_rdram.data()),
+         reinterpret_cast<const uint32_t *>(state.rdram), RDRAM_SIZE >> 2, 4, errors, report);
+
+   return errors;
 }
 
-static void validate_trace(RSP::CPU &cpu, const char *path)
+#ifdef PARALLEL_INTEGRATION
+static void process_rdp_list()
 {
-   auto &state = cpu.get_state();
-   uint32_t dmem[1024];
-   uint32_t imem[1024];
-   cpu.set_dmem(dmem);
-   cpu.set_imem(imem);
+}
+#endif
 
-   FILE *file = fopen(path, "rb");
-   if (!file)
-      throw runtime_error("Failed to load trace.");
+static int replay_trace(const char *path, bool enabled[BACKENDS], bool quiet)
+{
+   RSP::CPU cpu;
+   BackendStats stats[BACKENDS];
+   uint64_t instructions[TASK_TYPES] = {};
+   uint64_t jit_nsec = 0;
+   vector<uint8_t> rdram(RDRAM_SIZE);
+   vector<uint8_t> scratch(RDRAM_ALLOC_SIZE);
+   unsigned index = 0;
+   int ret = 0;
+
+#ifdef PARALLEL_INTEGRATION
+   RSP::rsp.ProcessRdpList = process_rdp_list;
+#endif
 
    try
    {
-      read_tag_validate(file, "RSPDUMP1");
+      TraceReader reader(path);
+      Task task;
 
-      unsigned index = 0;
-
-      while (read_tag_validate(file, "BEGIN   "))
+      while (reader.next(task, rdram))
       {
-         read_block(file, "DMEM    ", state.dmem, 0x1000);
-         read_block(file, "IMEM    ", state.imem, 0x1000);
-         read_block(file, "SR32    ", state.sr, sizeof(state.sr));
-         read_block(file, "VR32    ", state.cp2.regs, sizeof(state.cp2.regs));
-         read_block(file, "VLO     ", state.cp2.acc.e + RSP::RSP_ACC_LO, sizeof(uint16_t) * 8);
-         read_block(file, "VMD     ", state.cp2.acc.e + RSP::RSP_ACC_MD, sizeof(uint16_t) * 8);
-         read_block(file, "VHI     ", state.cp2.acc.e + RSP::RSP_ACC_HI, sizeof(uint16_t) * 8);
-         read_block(file, "PC      ", &state.pc, sizeof(state.pc));
-
-         int16_t VCO, VCC, VCE;
-         read_block(file, "VCO     ", &VCO, sizeof(VCO));
-         read_block(file, "VCC     ", &VCC, sizeof(VCC));
-         read_block(file, "VCE     ", &VCE, sizeof(VCE));
-
-         rsp_set_flags(state.cp2.flags[RSP::RSP_VCO].e, VCO);
-         rsp_set_flags(state.cp2.flags[RSP::RSP_VCC].e, VCC);
-         rsp_set_flags(state.cp2.flags[RSP::RSP_VCE].e, VCE);
-
-         RSP::ReturnMode mode = RSP::MODE_CONTINUE;
-         do
-         {
-            *state.cp0.cr[RSP::CP0_REGISTER_SP_STATUS] = 0;
-            cpu.invalidate_imem();
+         TaskType type = classify_task(task.begin);
 
-            // Run till break.
-            mode = cpu.run();
-            if (mode == RSP::MODE_DMA_READ)
-            {
-               if (!read_tag_validate(file, "BEGINDMA"))
-                  throw runtime_error("Expected BEGINDMA.");
-               while (read_poke(file, cpu));
-            }
-         } while (mode != RSP::MODE_BREAK);
-
-         uint32_t dmem[0x1000 >> 2];
-         uint32_t imem[0x1000 >> 2];
-         uint32_t sr[32];
-         uint16_t vr[32 * 8];
-         uint16_t vlo[8];
-         uint16_t vmd[8];
-         uint16_t vhi[8];
-
-         read_block(file, "DMEM END", dmem, sizeof(dmem));
-         read_block(file, "IMEM END", imem, sizeof(imem));
-         read_block(file, "SR32 END", sr, sizeof(sr));
-         read_block(file, "VR32 END", vr, sizeof(vr));
-         read_block(file, "VLO  END", vlo, sizeof(vlo));
-         read_block(file, "VMD  END", vmd, sizeof(vmd));
-         read_block(file, "VHI  END", vhi, sizeof(vhi));
-         read_block(file, "VCO  END", &VCO, sizeof(VCO));
-         read_block(file, "VCC  END", &VCC, sizeof(VCC));
-         read_block(file, "VCE  END", &VCE, sizeof(VCE));
-
-         unsigned errors = 0;
-
-         fprintf(stderr, "==== Trace #%u ====\n", index);
-
-         // Validate DMEM
-         for (unsigned i = 0; i < (0x1000 >> 2); i++)
-         {
-            if (state.dmem[i] != dmem[i])
-            {
-               fprintf(stderr, "DMEM32[0x%03x] fault. Expected 0x%08x, got 0x%08x!\n",
-                     i, dmem[i], state.dmem[i]);
-               errors++;
-            }
-         }
+         if (!quiet)
+            fprintf(stderr, "task %5u %-5s", index, task_type_names[type]);
 
-         // Validate IMEM (in case of DMA)
-         for (unsigned i = 0; i < (0x1000 >> 2); i++)
+         for (unsigned b = 0; b < BACKENDS; b++)
          {
-            if (state.imem[i] != imem[i])
-            {
-               fprintf(stderr, "IMEM32[0x%03x] fault. Expected 0x%08x, got 0x%08x!\n",
-                     i, dmem[i], state.dmem[i]);
-               errors++;
-            }
-         }
+            if (!enabled[b])
+               continue;
 
-         // Validate SR
-         for (unsigned i = 0; i < 32; i++)
-         {
-            if (sr[i] != state.sr[i])
-            {
-               fprintf(stderr, "SR[%02u] fault. Expected 0x%08x, got 0x%08x!\n",
-                     i, sr[i], state.sr[i]);
-               errors++;
-            }
-         }
+            replay_state state = task.begin;
+            memcpy(scratch.data(), rdram.data(), RDRAM_SIZE);
+            state.rdram = scratch.data();
 
-         // Validate VR
-         for (unsigned i = 0; i < 16 * 8; i++)
-         {
-            if (vr[i] != state.cp2.regs[i >> 3].e[i & 7])
-            {
-               fprintf(stderr, "VR[%02u][%u] fault. Expected 0x%04x, got 0x%04x!\n",
-                     i >> 3, i & 7, vr[i], state.cp2.regs[i >> 3].e[i & 7]);
-               errors++;
-            }
-         }
+            uint64_t instructions_before = rsp_profile_instructions;
+            uint64_t excluded = 0;
+            bool emulated = true;
 
-         // Validate VLO
-         for (unsigned i = 0; i < 8; i++)
-         {
-            if (vlo[i] != state.cp2.acc.e[RSP::RSP_ACC_LO + i])
-            {
-               fprintf(stderr, "VLO[%u] fault. Expected 0x%04x, got 0x%04x!\n",
-                     i, vlo[i], state.cp2.acc.e[RSP::RSP_ACC_LO + i]);
-               errors++;
-            }
-         }
-
-         // Validate VMD
-         for (unsigned i = 0; i < 8; i++)
-         {
-            if (vmd[i] != state.cp2.acc.e[RSP::RSP_ACC_MD + i])
+            auto start = chrono::steady_clock::now();
+            switch (b)
             {
-               fprintf(stderr, "VMD[%u] fault. Expected 0x%04x, got 0x%04x!\n",
-                     i, vmd[i], state.cp2.acc.e[RSP::RSP_ACC_MD + i]);
-               errors++;
+               case BACKEND_CXD4:
+                  replay_cxd4_run(&state);
+                  break;
+               case BACKEND_HLE:
+                  emulated = replay_hle_run(&state) != 0;
+                  break;
+               case BACKEND_PARALLEL:
+                  excluded = run_parallel(cpu, state);
+                  jit_nsec += excluded;
+                  break;
             }
-         }
+            uint64_t nsec = chrono::duration_cast<chrono::nanoseconds>(
+                  chrono::steady_clock::now() - start).count();
+            nsec = nsec > excluded ? nsec - excluded : 0;
 
-         // Validate VHI
-         for (unsigned i = 0; i < 8; i++)
-         {
-            if (vhi[i] != state.cp2.acc.e[RSP::RSP_ACC_HI + i])
+            if (!emulated)
             {
-               fprintf(stderr, "VHI[%u] fault. Expected 0x%04x, got 0x%04x!\n",
-                     i, vhi[i], state.cp2.acc.e[RSP::RSP_ACC_HI + i]);
-               errors++;
+               stats[b].skipped++;
+               if (!quiet)
+                  fprintf(stderr, "  %s: forwarded", backend_names[b]);
+               continue;
             }
-         }
 
-         // Validate flags
-         if (VCO != rsp_get_flags(state.cp2.flags[RSP::RSP_VCO].e))
-         {
-            fprintf(stderr, "VCO fault. Expected 0x%04x, got 0x%04x!\n",
-                  VCO, rsp_get_flags(state.cp2.flags[RSP::RSP_VCO].e));
-            errors++;
-         }
+            stats[b].tasks[type]++;
+            stats[b].nsec[type] += nsec;
+            if (b == BACKEND_CXD4)
+               instructions[type] += rsp_profile_instructions - instructions_before;
 
-         if (VCC != rsp_get_flags(state.cp2.flags[RSP::RSP_VCC].e))
-         {
-            fprintf(stderr, "VCC fault. Expected 0x%04x, got 0x%04x!\n",
-                  VCC, rsp_get_flags(state.cp2.flags[RSP::RSP_VCC].e));
-            errors++;
-         }
+            if (!quiet)
+               fprintf(stderr, "  %s: %9.1f us", backend_names[b], nsec / 1e3);
 
-         if (VCE != rsp_get_flags(state.cp2.flags[RSP::RSP_VCE].e))
-         {
-            fprintf(stderr, "VCE fault. Expected 0x%04x, got 0x%04x!\n",
-                  VCE, rsp_get_flags(state.cp2.flags[RSP::RSP_VCE].e));
-            errors++;
+            unsigned errors = validate(Backend(b), task, state, false);
+            if (errors)
+            {
+               stats[b].divergent++;
+               fprintf(stderr, "\n    %s diverged on task %u, %u mismatches:\n",
+                     backend_names[b], index, errors);
+               if (b == BACKEND_HLE && replay_hle_warning())
+                  fprintf(stderr, "    HLE: %s\n", replay_hle_warning());
+               validate(Backend(b), task, state, true);
+               ret = 1;
+            }
          }
 
-         read_tag_validate(file, "END     ");
-
-         if (errors == 0)
-            fprintf(stderr, "SUCCESS! :D\n");
-         else
-            fprintf(stderr, "%u ERRORS! :{\n", errors);
-         fprintf(stderr, "======================\n\n");
-
+         if (!quiet)
+            fprintf(stderr, "\n");
          index++;
       }
    }
    catch (const std::exception &e)
    {
       fprintf(stderr, "Exception: %s\n", e.what());
+      return 1;
+   }
+
+   printf("\n%u tasks\n\n", index);
+   printf("backend   type     tasks     total ms     avg us\n");
+   for (unsigned b = 0; b < BACKENDS; b++)
+   {
+      if (!enabled[b])
+         continue;
+
+      for (unsigned t = 0; t < TASK_TYPES; t++)
+      {
+         if (!stats[b].tasks[t])
+            continue;
+         printf("%-9s %-6s %7llu %12.3f %10.1f\n", backend_names[b], task_type_names[t],
+               (unsigned long long)stats[b].tasks[t], stats[b].nsec[t] / 1e6,
+               stats[b].nsec[t] / 1e3 / stats[b].tasks[t]);
+      }
    }
 
-   fclose(file);
+   printf("\n");
+   for (unsigned b = 0; b < BACKENDS; b++)
+      if (enabled[b])
+         printf("%-9s %llu divergent, %llu forwarded\n", backend_names[b],
+               (unsigned long long)stats[b].divergent, (unsigned long long)stats[b].skipped);
+
+   if (enabled[BACKEND_PARALLEL])
+      printf("\nparallel JIT compile time %.3f ms, not included above\n", jit_nsec / 1e6);
+
+   if (enabled[BACKEND_CXD4])
+   {
+      uint64_t total = 0, vector_total = 0;
+      for (unsigned t = 0; t < TASK_TYPES; t++)
+      {
+         if (instructions[t])
+            printf("\n%-6s %14llu instructions", task_type_names[t], (unsigned long long)instructions[t]);
+         total += instructions[t];
+      }
+      for (unsigned op = 0; op < 64; op++)
+         vector_total += rsp_profile_vu[op];
+
+      printf("\ntotal  %14llu instructions, %llu vector (%.1f%%)\n\n",
+            (unsigned long long)total, (unsigned long long)vector_total,
+            total ? 100.0 * vector_total / total : 0.0);
+
+      vector<unsigned> order;
+      for (unsigned op = 0; op < 64; op++)
+         if (rsp_profile_vu[op])
+            order.push_back(op);
+      sort(begin(order), end(order), [](unsigned a, unsigned b) {
+         return rsp_profile_vu[a] > rsp_profile_vu[b];
+      });
+
+      printf("opcode          count  %% vector\n");
+      for (auto op : order)
+         printf("%-6s %14llu  %7.2f\n", vu_opcode_names[op],
+               (unsigned long long)rsp_profile_vu[op], 100.0 * rsp_profile_vu[op] / vector_total);
+   }
+
+   return ret;
 }
 
 int main(int argc, char *argv[])
 {
+   bool enabled[BACKENDS] = { true, true, true };
+   bool quiet = false;
+   vector<const char *> paths;
+
+   for (int i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-q") == 0)
+         quiet = true;
+      else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+      {
+         string list = argv[++i];
+         for (unsigned b = 0; b < BACKENDS; b++)
+            enabled[b] = list.find(backend_names[b]) != string::npos;
+      }
+      else
+         paths.push_back(argv[i]);
+   }
+
+   if (paths.size() == 1)
+      return replay_trace(paths[0], enabled, quiet);
+
+   if (paths.size() != 2)
+   {
+      fprintf(stderr, "usage: %s [-b cxd4,hle,parallel] [-q] trace.rsp\n"
+            "       %s dmem.bin imem.bin\n", argv[0], argv[0]);
+      return 1;
+   }
+
    RSP::CPU cpu;
    auto &state = cpu.get_state();
 
@@ -304,27 +560,18 @@ int main(int argc, char *argv[])
    for (unsigned i = 0; i < 16; i++)
       state.cp0.cr[i] = &cr[i];
 
-   if (argc == 3)
-   {
-      auto dmem = read_binary(argv[1], true);
-      auto imem = read_binary(argv[2], true);
-      if (imem.empty())
-         return 1;
+   auto dmem = read_binary(paths[0], true);
+   auto imem = read_binary(paths[1], true);
+   if (imem.empty())
+      return 1;
 
-      dmem.resize(0x1000);
-      imem.resize(0x1000);
-      cpu.set_dmem(dmem.data());
-      cpu.set_imem(imem.data());
+   dmem.resize(0x1000);
+   imem.resize(0x1000);
+   cpu.set_dmem(dmem.data());
+   cpu.set_imem(imem.data());
 
-      for (unsigned i = 0; i < 1; i++)
-      {
-         cpu.invalidate_imem();
-         cr[RSP::CP0_REGISTER_SP_STATUS] = 0;
-         cpu.run();
-      }
-   }
-   else if (argc == 2)
-      validate_trace(cpu, argv[1]);
-   else
-      return 1;
+   cpu.invalidate_imem();
+   cr[RSP::CP0_REGISTER_SP_STATUS] = 0;
+   cpu.run();
+   return 0;
 }
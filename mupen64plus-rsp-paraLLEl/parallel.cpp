@@ -33,6 +33,11 @@ void log_rsp_mem_parallel(void)
 }
 #endif
 
+void parallel_rsp_set_jit_cache_directory(const char *path)
+{
+   RSP::Block::set_cache_directory(path ? path : "");
+}
+
 EXPORT unsigned int CALL parallelRSPDoRspCycles(unsigned int cycles)
 {
    if (*RSP::rsp.SP_STATUS_REG & (SP_STATUS_HALT | SP_STATUS_BROKE))
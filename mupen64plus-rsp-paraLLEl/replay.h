@@ -0,0 +1,40 @@
+#ifndef REPLAY_H__
+#define REPLAY_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// RSP state as recorded by the cxd4 trace dumper (mupen64plus-rsp-cxd4/rsp_dump.cpp).
+struct replay_state
+{
+   uint8_t *rdram;
+   uint32_t dmem[0x1000 >> 2];
+   uint32_t imem[0x1000 >> 2];
+   uint32_t sr[32];
+   uint16_t vr[32 * 8];
+   uint16_t vlo[8];
+   uint16_t vmd[8];
+   uint16_t vhi[8];
+   uint32_t pc;
+   uint16_t vco, vcc, vce;
+};
+
+// cxd4 interpreter, built with HAVE_RSP_PROFILE.
+void replay_cxd4_run(struct replay_state *state);
+extern unsigned long long rsp_profile_instructions;
+extern unsigned long long rsp_profile_vu[64];
+
+// HLE. Returns 0 if the task was forwarded to another plugin
+// (display lists, CFB) and nothing was emulated.
+int replay_hle_run(struct replay_state *state);
+// First warning of the last run, NULL if there was none.
+const char *replay_hle_warning(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
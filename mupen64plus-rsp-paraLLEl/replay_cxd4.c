@@ -0,0 +1,83 @@
+/* cxd4 backend of the trace replay tool, see main.cpp.
+ * The interpreter keeps its state in file scope variables, so it is
+ * built into this file instead of being linked separately. */
+
+#include "../mupen64plus-rsp-cxd4/rsp.c"
+
+#include "replay.h"
+
+/* cxd4 only touches its configuration in PluginStartup/RomOpen. */
+m64p_error ConfigSetDefaultFloat(m64p_handle h, const char *name, float value, const char *help)
+{
+   return M64ERR_SUCCESS;
+}
+
+m64p_error ConfigSetDefaultBool(m64p_handle h, const char *name, int value, const char *help)
+{
+   return M64ERR_SUCCESS;
+}
+
+int ConfigGetParamBool(m64p_handle h, const char *name)
+{
+   return 0;
+}
+
+static void check_interrupts(void)
+{
+}
+
+void replay_cxd4_run(struct replay_state *state)
+{
+   static unsigned int mi_intr, sp_regs[10], dpc_regs[8];
+   RSP_INFO info;
+
+   memset(&info, 0, sizeof(info));
+   memset(sp_regs, 0, sizeof(sp_regs));
+   memset(dpc_regs, 0, sizeof(dpc_regs));
+
+   info.RDRAM            = state->rdram;
+   info.DMEM             = (unsigned char*)state->dmem;
+   info.IMEM             = (unsigned char*)state->imem;
+   info.MI_INTR_REG      = &mi_intr;
+   info.SP_MEM_ADDR_REG  = &sp_regs[0];
+   info.SP_DRAM_ADDR_REG = &sp_regs[1];
+   info.SP_RD_LEN_REG    = &sp_regs[2];
+   info.SP_WR_LEN_REG    = &sp_regs[3];
+   info.SP_STATUS_REG    = &sp_regs[4];
+   info.SP_DMA_FULL_REG  = &sp_regs[5];
+   info.SP_DMA_BUSY_REG  = &sp_regs[6];
+   info.SP_PC_REG        = &sp_regs[7];
+   info.SP_SEMAPHORE_REG = &sp_regs[8];
+   info.DPC_START_REG    = &dpc_regs[0];
+   info.DPC_END_REG      = &dpc_regs[1];
+   info.DPC_CURRENT_REG  = &dpc_regs[2];
+   info.DPC_STATUS_REG   = &dpc_regs[3];
+   info.DPC_CLOCK_REG    = &dpc_regs[4];
+   info.DPC_BUFBUSY_REG  = &dpc_regs[5];
+   info.DPC_PIPEBUSY_REG = &dpc_regs[6];
+   info.DPC_TMEM_REG     = &dpc_regs[7];
+   info.CheckInterrupts  = check_interrupts;
+   cxd4InitiateRSP(info, NULL);
+
+   memcpy(SR, state->sr, sizeof(SR));
+   memcpy(VR, state->vr, sizeof(VR));
+   memcpy(VACC[LO], state->vlo, sizeof(VACC[LO]));
+   memcpy(VACC[MD], state->vmd, sizeof(VACC[MD]));
+   memcpy(VACC[HI], state->vhi, sizeof(VACC[HI]));
+   set_VCO(state->vco);
+   set_VCC(state->vcc);
+   set_VCE((unsigned char)state->vce);
+
+   *RSP.SP_PC_REG = 0x04001000 | state->pc;
+   cxd4DoRspCycles(0);
+
+   memcpy(state->sr, SR, sizeof(SR));
+   memcpy(state->vr, VR, sizeof(VR));
+   memcpy(state->vlo, VACC[LO], sizeof(VACC[LO]));
+   memcpy(state->vmd, VACC[MD], sizeof(VACC[MD]));
+   memcpy(state->vhi, VACC[HI], sizeof(VACC[HI]));
+   state->vco = get_VCO();
+   state->vcc = get_VCC();
+   state->vce = get_VCE();
+   state->pc  = *RSP.SP_PC_REG & 0xFFC;
+}
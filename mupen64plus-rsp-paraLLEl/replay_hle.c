@@ -0,0 +1,73 @@
+/* HLE backend of the trace replay tool, see main.cpp. */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common.h"
+#include "hle.h"
+#include "m64p_plugin.h"
+#include "replay.h"
+
+/* Read by the HLE core (and cxd4) for forwarding tasks to other plugins. */
+RSP_INFO rsp_info;
+
+static char hle_warning[256];
+static int hle_forwarded;
+
+static void forward_task(void)
+{
+   hle_forwarded = 1;
+}
+
+void HleVerboseMessage(void* UNUSED(user_defined), const char *UNUSED(message), ...)
+{
+}
+
+void HleWarnMessage(void* UNUSED(user_defined), const char *message, ...)
+{
+   va_list args;
+
+   /* Only the first one, later ones tend to be fallout. */
+   if (hle_warning[0])
+      return;
+
+   va_start(args, message);
+   vsnprintf(hle_warning, sizeof(hle_warning), message, args);
+   va_end(args);
+}
+
+const char *replay_hle_warning(void)
+{
+   return hle_warning[0] ? hle_warning : NULL;
+}
+
+int replay_hle_run(struct replay_state *state)
+{
+   static struct hle_t hle;
+   static unsigned int mi_intr, sp_regs[10], dpc_regs[8];
+
+   memset(sp_regs, 0, sizeof(sp_regs));
+   memset(dpc_regs, 0, sizeof(dpc_regs));
+
+   hle_init(&hle, state->rdram,
+         (unsigned char*)state->dmem, (unsigned char*)state->imem,
+         &mi_intr,
+         &sp_regs[0], &sp_regs[1], &sp_regs[2], &sp_regs[3], &sp_regs[4],
+         &sp_regs[5], &sp_regs[6], &sp_regs[7], &sp_regs[8],
+         &dpc_regs[0], &dpc_regs[1], &dpc_regs[2], &dpc_regs[3],
+         &dpc_regs[4], &dpc_regs[5], &dpc_regs[6], &dpc_regs[7],
+         NULL);
+
+   rsp_info.ProcessDlistList = forward_task;
+   rsp_info.ProcessAlistList = forward_task;
+   rsp_info.ShowCFB          = forward_task;
+
+   sp_regs[7] = 0x04001000 | state->pc; /* SP_PC */
+   hle_forwarded = 0;
+   hle_warning[0] = '\0';
+
+   hle_execute(&hle);
+
+   return !hle_forwarded;
+}
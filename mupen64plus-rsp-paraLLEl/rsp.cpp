@@ -1,5 +1,6 @@
 #include "rsp.hpp"
 #include <utility>
+#include <chrono>
 
 using namespace std;
 
@@ -35,6 +36,187 @@ void RSP_DEBUG(RSP::CPUState *rsp, const char *tag, unsigned pc, unsigned value)
 
 namespace RSP
 {
+// Budgets for the JIT block cache. Going over either evicts the least
+// recently used blocks, which releases their code. Code size counts the
+// pages mapped for each block, usually one for code and one for data.
+static const size_t MAX_CACHED_BLOCKS = 4096;
+static const size_t MAX_CODE_SIZE = 64 * 1024 * 1024;
+
+BlockCache::BlockCache()
+{
+   table.resize(1024, NONE);
+}
+
+size_t BlockCache::slot_hash(unsigned pc, uint64_t hash)
+{
+   uint64_t h = hash ^ (uint64_t(pc) * 0x9e3779b97f4a7c15ull);
+   return size_t(h ^ (h >> 32));
+}
+
+void BlockCache::lru_unlink(unsigned index)
+{
+   auto &e = entries[index];
+   if (e.prev != NONE)
+      entries[e.prev].next = e.next;
+   else
+      lru_head = e.next;
+
+   if (e.next != NONE)
+      entries[e.next].prev = e.prev;
+   else
+      lru_tail = e.prev;
+
+   e.prev = NONE;
+   e.next = NONE;
+}
+
+void BlockCache::lru_push_front(unsigned index)
+{
+   auto &e = entries[index];
+   e.prev = NONE;
+   e.next = lru_head;
+   if (lru_head != NONE)
+      entries[lru_head].prev = index;
+   else
+      lru_tail = index;
+   lru_head = index;
+}
+
+Block *BlockCache::find(unsigned pc, uint64_t hash)
+{
+   size_t mask = table.size() - 1;
+   for (size_t slot = slot_hash(pc, hash) & mask; table[slot] != NONE; slot = (slot + 1) & mask)
+   {
+      unsigned index = table[slot];
+      auto &e = entries[index];
+      if (e.hash == hash && e.pc == pc)
+      {
+         if (lru_head != index)
+         {
+            lru_unlink(index);
+            lru_push_front(index);
+         }
+         return e.block.get();
+      }
+   }
+   return nullptr;
+}
+
+void BlockCache::grow()
+{
+   size_t new_size = table.size() * 2;
+   table.assign(new_size, NONE);
+   size_t mask = new_size - 1;
+
+   for (unsigned index = lru_head; index != NONE; index = entries[index].next)
+   {
+      size_t slot = slot_hash(entries[index].pc, entries[index].hash) & mask;
+      while (table[slot] != NONE)
+         slot = (slot + 1) & mask;
+      table[slot] = index;
+   }
+}
+
+void BlockCache::insert(unsigned pc, uint64_t hash, unique_ptr<Block> block)
+{
+   // Keep load factor below 1/2.
+   if ((count + 1) * 2 > table.size())
+      grow();
+
+   unsigned index;
+   if (!free_entries.empty())
+   {
+      index = free_entries.back();
+      free_entries.pop_back();
+   }
+   else
+   {
+      index = unsigned(entries.size());
+      entries.emplace_back();
+   }
+
+   auto &e = entries[index];
+   e.pc = pc;
+   e.hash = hash;
+   e.block = move(block);
+   lru_push_front(index);
+
+   size_t mask = table.size() - 1;
+   size_t slot = slot_hash(pc, hash) & mask;
+   while (table[slot] != NONE)
+      slot = (slot + 1) & mask;
+   table[slot] = index;
+   count++;
+}
+
+void BlockCache::remove(unsigned index)
+{
+   auto &e = entries[index];
+   size_t mask = table.size() - 1;
+   size_t slot = slot_hash(e.pc, e.hash) & mask;
+   while (table[slot] != index)
+      slot = (slot + 1) & mask;
+
+   // Backward shift deletion, no tombstones.
+   size_t next = (slot + 1) & mask;
+   while (table[next] != NONE)
+   {
+      auto &moved = entries[table[next]];
+      size_t home = slot_hash(moved.pc, moved.hash) & mask;
+      if (((next - home) & mask) >= ((next - slot) & mask))
+      {
+         table[slot] = table[next];
+         slot = next;
+      }
+      next = (next + 1) & mask;
+   }
+   table[slot] = NONE;
+
+   lru_unlink(index);
+   e.block.reset();
+   free_entries.push_back(index);
+   count--;
+}
+
+size_t BlockCache::trim(size_t max_blocks, size_t max_code_size, Func *live_blocks)
+{
+   size_t evicted = 0;
+   unsigned index = lru_tail;
+   size_t budget = count;
+
+   // Blocks which are still installed get moved to the front rather than
+   // evicted. Visit every entry at most once.
+   while ((count > max_blocks || Block::code_memory_usage() > max_code_size) &&
+          index != NONE && budget--)
+   {
+      unsigned prev = entries[index].prev;
+      auto &e = entries[index];
+      if (live_blocks[e.pc] == e.block->get_func())
+      {
+         lru_unlink(index);
+         lru_push_front(index);
+      }
+      else
+      {
+         remove(index);
+         evicted++;
+      }
+      index = prev;
+   }
+
+   return evicted;
+}
+
+void BlockCache::clear()
+{
+   entries.clear();
+   free_entries.clear();
+   table.assign(table.size(), NONE);
+   lru_head = NONE;
+   lru_tail = NONE;
+   count = 0;
+}
+
 CPU::CPU()
 {
    init_symbol_table();
@@ -188,6 +370,23 @@ void CPU::invalidate_code()
    state.dirty_blocks = 0;
 }
 
+void CPU::trim_block_cache()
+{
+   if (block_cache.size() > MAX_CACHED_BLOCKS || Block::code_memory_usage() > MAX_CODE_SIZE)
+      block_cache_stats.evictions += block_cache.trim(MAX_CACHED_BLOCKS, MAX_CODE_SIZE, blocks);
+
+   // Only installed blocks are left, start over.
+   if (Block::code_memory_usage() > MAX_CODE_SIZE)
+   {
+      memset(blocks, 0, sizeof(blocks));
+      block_cache.clear();
+      block_cache_stats.flushes++;
+   }
+
+   block_cache_stats.blocks = block_cache.size();
+   block_cache_stats.code_size = Block::code_memory_usage();
+}
+
 // Need super-fast hash here.
 uint64_t CPU::hash_imem(unsigned pc, unsigned count) const
 {
@@ -1238,12 +1437,25 @@ DECL_COP2(RESERVED);
    full_code += body;
    full_code += "}\n";
 
+   auto start = chrono::steady_clock::now();
+   // What hash_imem covered, checked by the persistent cache.
+   vector<uint32_t> key;
+   key.reserve(2 + count);
+   key.push_back(pc);
+   key.push_back(count);
+   key.insert(key.end(), state.imem + pc, state.imem + pc + count);
+
    unique_ptr<Block> block(new Block(symbol_table));
-   if (!block->compile(hash, full_code))
+   bool compiled = block->compile(hash, key, full_code);
+   auto end = chrono::steady_clock::now();
+   block_cache_stats.compile_time_us +=
+      chrono::duration_cast<chrono::microseconds>(end - start).count();
+
+   if (!compiled)
       return nullptr;
 
    auto ret = block->get_func();
-   cached_blocks[pc][hash] = move(block);
+   block_cache.insert(pc, hash, move(block));
    return ret;
 }
 
@@ -1352,11 +1564,15 @@ void CPU::enter(uint32_t pc)
       end = analyze_static_end(word_pc, end);
 
       uint64_t hash = hash_imem(word_pc, end - word_pc);
-      auto itr = cached_blocks[word_pc].find(hash);
-      if (itr != cached_blocks[word_pc].end())
-         block = itr->second->get_func();
+      auto cached = block_cache.find(word_pc, hash);
+      if (cached)
+      {
+         block_cache_stats.hits++;
+         block = cached->get_func();
+      }
       else
       {
+         block_cache_stats.misses++;
          //static unsigned count;
          //fprintf(stderr, "JIT region #%u\n", ++count);
          block = jit_region(hash, word_pc, end - word_pc);
@@ -1370,6 +1586,8 @@ ReturnMode CPU::run()
    for (;;)
    {
       invalidate_code();
+      // No generated code is on the stack here, so blocks can be freed.
+      trim_block_cache();
       call_stack_ptr = 0;
       auto ret = static_cast<ReturnMode>(sigsetjmp(env, 0));
 
@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "state.hpp"
 #include "jit.hpp"
@@ -23,6 +24,62 @@ namespace RSP
 #endif
    using Func = JIT::Func;
 
+   struct BlockCacheStats
+   {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+      uint64_t flushes = 0;
+      uint64_t compile_time_us = 0;
+      size_t blocks = 0;
+      size_t code_size = 0;
+   };
+
+   // Compiled blocks keyed by (pc, IMEM hash), shared by all of IMEM.
+   // Open addressing with linear probing, entries are kept in LRU order.
+   // Nothing is freed outside of trim() and clear(), which must not be
+   // called while generated code is on the stack.
+   class BlockCache
+   {
+      public:
+         BlockCache();
+
+         Block *find(unsigned pc, uint64_t hash);
+         void insert(unsigned pc, uint64_t hash, std::unique_ptr<Block> block);
+
+         // Evicts least recently used blocks down to max_blocks and
+         // max_code_size, sparing the ones still installed in the direct
+         // lookup table.
+         size_t trim(size_t max_blocks, size_t max_code_size, Func *live_blocks);
+         void clear();
+
+         size_t size() const { return count; }
+
+      private:
+         enum { NONE = ~0u };
+
+         struct Entry
+         {
+            uint64_t hash = 0;
+            unsigned pc = 0;
+            unsigned prev = NONE, next = NONE;
+            std::unique_ptr<Block> block;
+         };
+
+         std::vector<Entry> entries;
+         std::vector<unsigned> free_entries;
+         // Index into entries, NONE if the slot is empty.
+         std::vector<unsigned> table;
+         unsigned lru_head = NONE, lru_tail = NONE;
+         size_t count = 0;
+
+         static size_t slot_hash(unsigned pc, uint64_t hash);
+         void grow();
+         void remove(unsigned index);
+         void lru_unlink(unsigned index);
+         void lru_push_front(unsigned index);
+   };
+
    enum ReturnMode
    {
       MODE_ENTER = 0,
@@ -65,6 +122,11 @@ namespace RSP
 
          ReturnMode run();
 
+         const BlockCacheStats &get_block_cache_stats() const
+         {
+            return block_cache_stats;
+         }
+
          void enter(uint32_t pc);
          void call(uint32_t target, uint32_t ret);
          int ret(uint32_t pc);
@@ -73,9 +135,11 @@ namespace RSP
       private:
          CPUState state;
          Func blocks[IMEM_WORDS] = {};
-         std::unordered_map<uint64_t, std::unique_ptr<Block>> cached_blocks[IMEM_WORDS];
+         BlockCache block_cache;
+         BlockCacheStats block_cache_stats;
 
          void invalidate_code();
+         void trim_block_cache();
          uint64_t hash_imem(unsigned pc, unsigned count) const;
          Func jit_region(uint64_t hash, unsigned pc, unsigned count);
 
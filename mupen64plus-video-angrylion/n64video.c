@@ -7,11 +7,31 @@
 #include "tctables.h"
 #include "vi.h"
 #include "rdp.h"
+#include "plugin_thread.h"
+
+#include <features/features_cpu.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_KERNELS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SIMD_KERNELS_NEON
+#endif
+
+/* RDP dumps snapshot DRAM per list, so they keep the serial path. */
+#if defined(PLUGIN_THREADS) && !defined(HAVE_RDP_DUMP)
+#define RDP_ASYNC
+#endif
 
 #if 0
 #define EXTRALOGGING
 #endif
 
+#if 0
+#define CHECK_SIMD_KERNELS
+#endif
+
 #ifdef EXTRALOGGING
 static int LOG_ENABLE = 1;
 #else
@@ -159,32 +179,38 @@ static uint16_t primitive_delta_z;
 
 static uint32_t fill_color;
 
-static int16_t *combiner_rgbsub_a_r[2];
-static int16_t *combiner_rgbsub_a_g[2];
-static int16_t *combiner_rgbsub_a_b[2];
-static int16_t *combiner_rgbsub_b_r[2];
-static int16_t *combiner_rgbsub_b_g[2];
-static int16_t *combiner_rgbsub_b_b[2];
-static int16_t *combiner_rgbmul_r[2];
-static int16_t *combiner_rgbmul_g[2];
-static int16_t *combiner_rgbmul_b[2];
-static int16_t *combiner_rgbadd_r[2];
-static int16_t *combiner_rgbadd_g[2];
-static int16_t *combiner_rgbadd_b[2];
-
-static int16_t *combiner_alphasub_a[2];
-static int16_t *combiner_alphasub_b[2];
-static int16_t *combiner_alphamul[2];
-static int16_t *combiner_alphaadd[2];
-
-static int16_t *blender1a_r[2];
-static int16_t *blender1a_g[2];
-static int16_t *blender1a_b[2];
-static int16_t *blender1b_a[2];
-static int16_t *blender2a_r[2];
-static int16_t *blender2a_g[2];
-static int16_t *blender2a_b[2];
-static int16_t *blender2b_a[2];
+static PLUGIN_TLS int16_t *combiner_rgbsub_a_r[2];
+static PLUGIN_TLS int16_t *combiner_rgbsub_a_g[2];
+static PLUGIN_TLS int16_t *combiner_rgbsub_a_b[2];
+static PLUGIN_TLS int16_t *combiner_rgbsub_b_r[2];
+static PLUGIN_TLS int16_t *combiner_rgbsub_b_g[2];
+static PLUGIN_TLS int16_t *combiner_rgbsub_b_b[2];
+static PLUGIN_TLS int16_t *combiner_rgbmul_r[2];
+static PLUGIN_TLS int16_t *combiner_rgbmul_g[2];
+static PLUGIN_TLS int16_t *combiner_rgbmul_b[2];
+static PLUGIN_TLS int16_t *combiner_rgbadd_r[2];
+static PLUGIN_TLS int16_t *combiner_rgbadd_g[2];
+static PLUGIN_TLS int16_t *combiner_rgbadd_b[2];
+
+static PLUGIN_TLS int16_t *combiner_alphasub_a[2];
+static PLUGIN_TLS int16_t *combiner_alphasub_b[2];
+static PLUGIN_TLS int16_t *combiner_alphamul[2];
+static PLUGIN_TLS int16_t *combiner_alphaadd[2];
+
+static PLUGIN_TLS int16_t *blender1a_r[2];
+static PLUGIN_TLS int16_t *blender1a_g[2];
+static PLUGIN_TLS int16_t *blender1a_b[2];
+static PLUGIN_TLS int16_t *blender1b_a[2];
+static PLUGIN_TLS int16_t *blender2a_r[2];
+static PLUGIN_TLS int16_t *blender2a_g[2];
+static PLUGIN_TLS int16_t *blender2a_b[2];
+static PLUGIN_TLS int16_t *blender2b_a[2];
+
+static int combiner_inputs_set;
+static int blender_inputs_set;
+
+static void update_combiner_inputs(void);
+static void update_blender_inputs(void);
 
 #define COLOR_RED(val)       (val.col[0])
 #define COLOR_GREEN(val)     (val.col[1])
@@ -247,6 +273,7 @@ void (*fbwrite_ptr)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t,
     if ((in) <= idxlim16) {                      \
         rdram_16[(in) ^ WORD_ADDR_XOR] = (rval); \
         hidden_bits[(in)] = (hval);              \
+        rdram_written[(in) >> 11] = 1;           \
     }                                            \
 }
 #define PAIRWRITE32(in, rval, hval0, hval1) {    \
@@ -255,6 +282,7 @@ void (*fbwrite_ptr)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t,
         rdram[(in)] = (rval);                    \
         hidden_bits[(in) << 1] = (hval0);        \
         hidden_bits[((in) << 1) + 1] = (hval1);  \
+        rdram_written[(in) >> 10] = 1;           \
     }                                            \
 }
 #define PAIRWRITE8(in, rval, hval) {             \
@@ -263,6 +291,7 @@ void (*fbwrite_ptr)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t,
         rdram_8[(in) ^ BYTE_ADDR_XOR] = (rval);  \
         if ((in) & 1)                            \
             hidden_bits[(in) >> 1] = (hval);     \
+        rdram_written[(in) >> 12] = 1;           \
     }                                            \
 }
 
@@ -270,12 +299,20 @@ uint32_t internal_vi_v_current_line = 0;
 uint32_t old_vi_origin = 0;
 uint32_t oldhstart = 0;
 uint32_t oldsomething = 0;
-int blshifta = 0, blshiftb = 0, pastblshifta = 0, pastblshiftb = 0;
-int32_t pastrawdzmem = 0;
+static PLUGIN_TLS int blshifta = 0, blshiftb = 0, pastblshifta = 0, pastblshiftb = 0;
+static PLUGIN_TLS int32_t pastrawdzmem = 0;
 int32_t iseed = 1;
 
 static SPAN span[1024];
-uint8_t cvgbuf[1024];
+static PLUGIN_TLS uint8_t cvgbuf[1024];
+
+/*
+ * Scanline band owned by the current rendering thread: spans start + span_band,
+ * start + span_band + span_bands, ...  The RDP thread draws every span unless
+ * a primitive is being split across the worker pool.
+ */
+static PLUGIN_TLS int span_band = 0;
+static PLUGIN_TLS int span_bands = 1;
 
 static int32_t spans_d_rgba[4];
 static int32_t spans_d_stwz[4];
@@ -308,22 +345,22 @@ typedef struct
 #define ZMODE_TRANSPARENT        2
 #define ZMODE_DECAL                3
 
-COLOR combined_color;
-COLOR texel0_color;
-COLOR texel1_color;
-COLOR nexttexel_color;
-COLOR shade_color;
+static PLUGIN_TLS COLOR combined_color;
+static PLUGIN_TLS COLOR texel0_color;
+static PLUGIN_TLS COLOR texel1_color;
+static PLUGIN_TLS COLOR nexttexel_color;
+static PLUGIN_TLS COLOR shade_color;
 static int16_t noise = 0;
 static int16_t one_color = 0x100;
 static int16_t zero_color = 0x00;
 
 static int16_t blenderone    = 0xff;
 
-COLOR pixel_color;
-COLOR inv_pixel_color;
-COLOR blended_pixel_color;
-COLOR memory_color;
-COLOR pre_memory_color;
+static PLUGIN_TLS COLOR pixel_color;
+static PLUGIN_TLS COLOR inv_pixel_color;
+static PLUGIN_TLS COLOR blended_pixel_color;
+static PLUGIN_TLS COLOR memory_color;
+static PLUGIN_TLS COLOR pre_memory_color;
 
 int oldscyl = 0;
 
@@ -343,7 +380,7 @@ typedef struct{
     int onelessthanmid;
 }SPANSIGS;
 
-static int16_t lod_frac = 0;
+static PLUGIN_TLS int16_t lod_frac = 0;
 struct {uint32_t shift; uint32_t add;} z_dec_table[8] = {
      6, 0x00000,
      5, 0x20000,
@@ -1105,32 +1142,10 @@ void rdp_init(void)
     render_spans_1cycle_ptr = render_spans_1cycle_func[2];
     render_spans_2cycle_ptr = render_spans_2cycle_func[1];
 
-    combiner_rgbsub_a_r[0] = combiner_rgbsub_a_r[1] = &one_color;
-    combiner_rgbsub_a_g[0] = combiner_rgbsub_a_g[1] = &one_color;
-    combiner_rgbsub_a_b[0] = combiner_rgbsub_a_b[1] = &one_color;
-    combiner_rgbsub_b_r[0] = combiner_rgbsub_b_r[1] = &one_color;
-    combiner_rgbsub_b_g[0] = combiner_rgbsub_b_g[1] = &one_color;
-    combiner_rgbsub_b_b[0] = combiner_rgbsub_b_b[1] = &one_color;
-    combiner_rgbmul_r[0] = combiner_rgbmul_r[1] = &one_color;
-    combiner_rgbmul_g[0] = combiner_rgbmul_g[1] = &one_color;
-    combiner_rgbmul_b[0] = combiner_rgbmul_b[1] = &one_color;
-    combiner_rgbadd_r[0] = combiner_rgbadd_r[1] = &one_color;
-    combiner_rgbadd_g[0] = combiner_rgbadd_g[1] = &one_color;
-    combiner_rgbadd_b[0] = combiner_rgbadd_b[1] = &one_color;
-
-    combiner_alphasub_a[0] = combiner_alphasub_a[1] = &one_color;
-    combiner_alphasub_b[0] = combiner_alphasub_b[1] = &one_color;
-    combiner_alphamul[0] = combiner_alphamul[1] = &one_color;
-    combiner_alphaadd[0] = combiner_alphaadd[1] = &one_color;
-
-    SET_BLENDER_INPUT(0, 0, &blender1a_r[0], &blender1a_g[0], &blender1a_b[0],
-                      &blender1b_a[0], 0, 0);
-    SET_BLENDER_INPUT(0, 1, &blender2a_r[0], &blender2a_g[0], &blender2a_b[0],
-                      &blender2b_a[0], 0, 0);
-    SET_BLENDER_INPUT(1, 0, &blender1a_r[1], &blender1a_g[1], &blender1a_b[1],
-                      &blender1b_a[1], 0, 0);
-    SET_BLENDER_INPUT(1, 1, &blender2a_r[1], &blender2a_g[1], &blender2a_b[1],
-                      &blender2b_a[1], 0, 0);
+    combiner_inputs_set = 0;
+    blender_inputs_set  = 0;
+    update_combiner_inputs();
+    update_blender_inputs();
     other_modes.f.stalederivs = 1;
     memset(__TMEM, 0, 0x1000);
 
@@ -1490,6 +1505,93 @@ static INLINE void SET_MUL_ALPHA_INPUT(int16_t **input, int code)
     }
 }
 
+/*
+ * The input tables point at per-thread pixel state, so every rendering
+ * thread builds its own copy from the shared combine and other_modes words.
+ */
+static void update_combiner_inputs(void)
+{
+    if (!combiner_inputs_set)
+    {
+        combiner_rgbsub_a_r[0] = combiner_rgbsub_a_r[1] = &one_color;
+        combiner_rgbsub_a_g[0] = combiner_rgbsub_a_g[1] = &one_color;
+        combiner_rgbsub_a_b[0] = combiner_rgbsub_a_b[1] = &one_color;
+        combiner_rgbsub_b_r[0] = combiner_rgbsub_b_r[1] = &one_color;
+        combiner_rgbsub_b_g[0] = combiner_rgbsub_b_g[1] = &one_color;
+        combiner_rgbsub_b_b[0] = combiner_rgbsub_b_b[1] = &one_color;
+        combiner_rgbmul_r[0] = combiner_rgbmul_r[1] = &one_color;
+        combiner_rgbmul_g[0] = combiner_rgbmul_g[1] = &one_color;
+        combiner_rgbmul_b[0] = combiner_rgbmul_b[1] = &one_color;
+        combiner_rgbadd_r[0] = combiner_rgbadd_r[1] = &one_color;
+        combiner_rgbadd_g[0] = combiner_rgbadd_g[1] = &one_color;
+        combiner_rgbadd_b[0] = combiner_rgbadd_b[1] = &one_color;
+
+        combiner_alphasub_a[0] = combiner_alphasub_a[1] = &one_color;
+        combiner_alphasub_b[0] = combiner_alphasub_b[1] = &one_color;
+        combiner_alphamul[0] = combiner_alphamul[1] = &one_color;
+        combiner_alphaadd[0] = combiner_alphaadd[1] = &one_color;
+    }
+    else
+    {
+        SET_SUBA_RGB_INPUT(
+            &combiner_rgbsub_a_r[0], &combiner_rgbsub_a_g[0],
+            &combiner_rgbsub_a_b[0], combine.sub_a_rgb0);
+        SET_SUBB_RGB_INPUT(
+            &combiner_rgbsub_b_r[0], &combiner_rgbsub_b_g[0],
+            &combiner_rgbsub_b_b[0], combine.sub_b_rgb0);
+        SET_MUL_RGB_INPUT(
+            &combiner_rgbmul_r[0], &combiner_rgbmul_g[0], &combiner_rgbmul_b[0],
+            combine.mul_rgb0);
+        SET_ADD_RGB_INPUT(
+            &combiner_rgbadd_r[0], &combiner_rgbadd_g[0], &combiner_rgbadd_b[0],
+            combine.add_rgb0);
+        SET_SUB_ALPHA_INPUT(&combiner_alphasub_a[0], combine.sub_a_a0);
+        SET_SUB_ALPHA_INPUT(&combiner_alphasub_b[0], combine.sub_b_a0);
+        SET_MUL_ALPHA_INPUT(&combiner_alphamul[0], combine.mul_a0);
+        SET_SUB_ALPHA_INPUT(&combiner_alphaadd[0], combine.add_a0);
+
+        SET_SUBA_RGB_INPUT(
+            &combiner_rgbsub_a_r[1], &combiner_rgbsub_a_g[1],
+            &combiner_rgbsub_a_b[1], combine.sub_a_rgb1);
+        SET_SUBB_RGB_INPUT(
+            &combiner_rgbsub_b_r[1], &combiner_rgbsub_b_g[1],
+            &combiner_rgbsub_b_b[1], combine.sub_b_rgb1);
+        SET_MUL_RGB_INPUT(
+            &combiner_rgbmul_r[1], &combiner_rgbmul_g[1], &combiner_rgbmul_b[1],
+            combine.mul_rgb1);
+        SET_ADD_RGB_INPUT(
+            &combiner_rgbadd_r[1], &combiner_rgbadd_g[1], &combiner_rgbadd_b[1],
+            combine.add_rgb1);
+        SET_SUB_ALPHA_INPUT(&combiner_alphasub_a[1], combine.sub_a_a1);
+        SET_SUB_ALPHA_INPUT(&combiner_alphasub_b[1], combine.sub_b_a1);
+        SET_MUL_ALPHA_INPUT(&combiner_alphamul[1], combine.mul_a1);
+        SET_SUB_ALPHA_INPUT(&combiner_alphaadd[1], combine.add_a1);
+    }
+}
+
+static void update_blender_inputs(void)
+{
+    OTHER_MODES mode;
+
+    if (blender_inputs_set)
+        mode = other_modes;
+    else
+        memset(&mode, 0, sizeof(mode));
+
+    SET_BLENDER_INPUT(
+        0, 0, &blender1a_r[0], &blender1a_g[0], &blender1a_b[0],
+        &blender1b_a[0], mode.blend_m1a_0, mode.blend_m1b_0);
+    SET_BLENDER_INPUT(
+        0, 1, &blender2a_r[0], &blender2a_g[0], &blender2a_b[0],
+        &blender2b_a[0], mode.blend_m2a_0, mode.blend_m2b_0);
+    SET_BLENDER_INPUT(
+        1, 0, &blender1a_r[1], &blender1a_g[1], &blender1a_b[1],
+        &blender1b_a[1], mode.blend_m1a_1, mode.blend_m1b_1);
+    SET_BLENDER_INPUT(
+        1, 1, &blender2a_r[1], &blender2a_g[1], &blender2a_b[1],
+        &blender2b_a[1], mode.blend_m2a_1, mode.blend_m2b_1);
+}
+
 static STRICTINLINE int alpha_compare(int32_t comb_alpha)
 {
     int32_t threshold;
@@ -1538,9 +1640,268 @@ static STRICTINLINE int32_t CLIP(int32_t value,int32_t min,int32_t max)
     return value;
 }
 
+/*
+ * Four-lane kernels for the color combiner equation and the texture
+ * filter.  The lanes are the R, G, B and A channels of one pixel: every
+ * pixel depends on the one before it (texel prefetch, LOD, blender shifter
+ * history, COMBINED feedback, the irand() sequence), so adjacent pixels
+ * cannot be batched without changing results.  All products are 16x16 bit
+ * and are paired up with their neighbouring term, which is exactly what
+ * pmaddwd / vmlal do.
+ *
+ * With CHECK_SIMD_KERNELS every call is repeated with the scalar code, the
+ * scalar result is kept, and mismatches are reported per span.
+ */
+#ifdef CHECK_SIMD_KERNELS
+static PLUGIN_TLS unsigned simd_mismatches;
+
+static void simd_check_report(int start, int end)
+{
+    if (simd_mismatches == 0)
+        return;
+    fprintf(stderr, "SIMD kernels: %u mismatches in spans %d-%d (cycle type %d)\n",
+        simd_mismatches, start, end, other_modes.cycle_type);
+    simd_mismatches = 0;
+}
+#endif
+
+static STRICTINLINE void combiner_equations_scalar(int32_t *out, int cycle)
+{
+    out[0] = color_combiner_equation(
+        *combiner_rgbsub_a_r[cycle], *combiner_rgbsub_b_r[cycle],
+        *combiner_rgbmul_r[cycle], *combiner_rgbadd_r[cycle]);
+    out[1] = color_combiner_equation(
+        *combiner_rgbsub_a_g[cycle], *combiner_rgbsub_b_g[cycle],
+        *combiner_rgbmul_g[cycle], *combiner_rgbadd_g[cycle]);
+    out[2] = color_combiner_equation(
+        *combiner_rgbsub_a_b[cycle], *combiner_rgbsub_b_b[cycle],
+        *combiner_rgbmul_b[cycle], *combiner_rgbadd_b[cycle]);
+    out[3] = alpha_combiner_equation(
+        *combiner_alphasub_a[cycle], *combiner_alphasub_b[cycle],
+        *combiner_alphamul[cycle], *combiner_alphaadd[cycle]);
+}
+
+#if defined(SIMD_KERNELS_SSE2)
+/* special_9bit_exttable for inputs in [0, 0x1FF] */
+static STRICTINLINE __m128i ext_9bit_epi16(__m128i v)
+{
+    const __m128i top = _mm_set1_epi16(0x180);
+    const __m128i neg = _mm_cmpeq_epi16(_mm_and_si128(v, top), top);
+
+    return _mm_or_si128(
+        _mm_and_si128(v, _mm_set1_epi16(0x1FF)),
+        _mm_and_si128(neg, _mm_set1_epi16(~0x1FF)));
+}
+
+static STRICTINLINE void combiner_equations_simd(int32_t *out, int cycle)
+{
+    __m128i sub, muladd, diff, c, d, sum;
+
+    sub = _mm_setr_epi16(
+        *combiner_rgbsub_a_r[cycle], *combiner_rgbsub_a_g[cycle],
+        *combiner_rgbsub_a_b[cycle], *combiner_alphasub_a[cycle],
+        *combiner_rgbsub_b_r[cycle], *combiner_rgbsub_b_g[cycle],
+        *combiner_rgbsub_b_b[cycle], *combiner_alphasub_b[cycle]);
+    muladd = _mm_setr_epi16(
+        *combiner_rgbmul_r[cycle], *combiner_rgbmul_g[cycle],
+        *combiner_rgbmul_b[cycle], *combiner_alphamul[cycle],
+        *combiner_rgbadd_r[cycle], *combiner_rgbadd_g[cycle],
+        *combiner_rgbadd_b[cycle], *combiner_alphaadd[cycle]);
+
+    sub  = ext_9bit_epi16(sub);
+    diff = _mm_sub_epi16(sub, _mm_srli_si128(sub, 8));
+    d    = _mm_srli_si128(ext_9bit_epi16(muladd), 8);
+    c    = _mm_or_si128(muladd, _mm_sub_epi16(_mm_setzero_si128(),
+               _mm_and_si128(muladd, _mm_set1_epi16(0x100)))); /* SIGNF(c, 9) */
+
+    /* (a - b) * c + d * 256 */
+    sum = _mm_madd_epi16(
+        _mm_unpacklo_epi16(diff, d), _mm_unpacklo_epi16(c, _mm_set1_epi16(0x100)));
+    sum = _mm_and_si128(
+        _mm_add_epi32(sum, _mm_set1_epi32(0x80)), _mm_set1_epi32(0x1FFFF));
+    _mm_storeu_si128((__m128i *)out, sum);
+    out[3] >>= 8;
+}
+#elif defined(SIMD_KERNELS_NEON)
+static STRICTINLINE int16x4_t ext_9bit_s16(int16x4_t v)
+{
+    const int16x4_t top = vdup_n_s16(0x180);
+    const uint16x4_t neg = vceq_s16(vand_s16(v, top), top);
+
+    return vorr_s16(
+        vand_s16(v, vdup_n_s16(0x1FF)),
+        vand_s16(vreinterpret_s16_u16(neg), vdup_n_s16(~0x1FF)));
+}
+
+static STRICTINLINE void combiner_equations_simd(int32_t *out, int cycle)
+{
+    int16_t in[16];
+    int16x4_t a, b, c, d;
+    int32x4_t sum;
+
+    in[ 0] = *combiner_rgbsub_a_r[cycle];
+    in[ 1] = *combiner_rgbsub_a_g[cycle];
+    in[ 2] = *combiner_rgbsub_a_b[cycle];
+    in[ 3] = *combiner_alphasub_a[cycle];
+    in[ 4] = *combiner_rgbsub_b_r[cycle];
+    in[ 5] = *combiner_rgbsub_b_g[cycle];
+    in[ 6] = *combiner_rgbsub_b_b[cycle];
+    in[ 7] = *combiner_alphasub_b[cycle];
+    in[ 8] = *combiner_rgbmul_r[cycle];
+    in[ 9] = *combiner_rgbmul_g[cycle];
+    in[10] = *combiner_rgbmul_b[cycle];
+    in[11] = *combiner_alphamul[cycle];
+    in[12] = *combiner_rgbadd_r[cycle];
+    in[13] = *combiner_rgbadd_g[cycle];
+    in[14] = *combiner_rgbadd_b[cycle];
+    in[15] = *combiner_alphaadd[cycle];
+
+    a = ext_9bit_s16(vld1_s16(&in[0]));
+    b = ext_9bit_s16(vld1_s16(&in[4]));
+    c = vld1_s16(&in[8]);
+    c = vorr_s16(c, vneg_s16(vand_s16(c, vdup_n_s16(0x100)))); /* SIGNF(c, 9) */
+    d = ext_9bit_s16(vld1_s16(&in[12]));
+
+    /* (a - b) * c + d * 256 */
+    sum = vmull_s16(vsub_s16(a, b), c);
+    sum = vaddq_s32(sum, vshlq_n_s32(vmovl_s16(d), 8));
+    sum = vandq_s32(vaddq_s32(sum, vdupq_n_s32(0x80)), vdupq_n_s32(0x1FFFF));
+    vst1q_s32(out, sum);
+    out[3] >>= 8;
+}
+#endif
+
+/*
+ * out[0..2] = color_combiner_equation for R, G and B,
+ * out[3]    = alpha_combiner_equation.
+ */
+static STRICTINLINE void combiner_equations(int32_t *out, int cycle)
+{
+#if defined(SIMD_KERNELS_SSE2) || defined(SIMD_KERNELS_NEON)
+    combiner_equations_simd(out, cycle);
+#ifdef CHECK_SIMD_KERNELS
+    {
+        int32_t ref[4];
+
+        combiner_equations_scalar(ref, cycle);
+        if (memcmp(ref, out, sizeof(ref)) != 0)
+        {
+            ++simd_mismatches;
+            memcpy(out, ref, sizeof(ref));
+        }
+    }
+#endif
+#else
+    combiner_equations_scalar(out, cycle);
+#endif
+}
+
+/*
+ * Texture filter step for all four channels:
+ *   TEX = base + ((f1 * (x1 - x0) + f2 * (x2 - x0) + bias) >> shift)
+ * where bias is round, plus ((~x0 + x3) << 6) when x3 is given (mid-texel).
+ */
+static STRICTINLINE void texel_lerp_scalar(
+    COLOR *TEX, const COLOR *base, const COLOR *x0, const COLOR *x1,
+    const COLOR *x2, const COLOR *x3, int32_t f1, int32_t f2, int32_t round,
+    int shift)
+{
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        int32_t bias = round;
+
+        if (x3)
+            bias += (~x0->col[i] + x3->col[i]) << 6;
+        TEX->col[i] = base->col[i] +
+            (((f1 * (x1->col[i] - x0->col[i])) + (f2 * (x2->col[i] - x0->col[i])) + bias) >> shift);
+    }
+}
+
+#if defined(SIMD_KERNELS_SSE2)
+static STRICTINLINE __m128i load_color_epi32(const COLOR *color)
+{
+    const __m128i v = _mm_loadl_epi64((const __m128i *)color);
+    return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+static STRICTINLINE void texel_lerp_simd(
+    COLOR *TEX, const COLOR *base, const COLOR *x0, const COLOR *x1,
+    const COLOR *x2, const COLOR *x3, int32_t f1, int32_t f2, int32_t round,
+    int shift)
+{
+    const __m128i f  = _mm_set1_epi32((f2 << 16) | (f1 & 0xFFFF));
+    const __m128i v0 = _mm_loadl_epi64((const __m128i *)x0);
+    __m128i sum, bias;
+
+    /* f1 * x1 + f2 * x2 - (f1 * x0 + f2 * x0) */
+    sum = _mm_madd_epi16(_mm_unpacklo_epi16(
+        _mm_loadl_epi64((const __m128i *)x1), _mm_loadl_epi64((const __m128i *)x2)), f);
+    sum = _mm_sub_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi16(v0, v0), f));
+
+    bias = _mm_set1_epi32(round);
+    if (x3)
+        bias = _mm_add_epi32(bias, _mm_slli_epi32(_mm_sub_epi32(_mm_sub_epi32(
+            load_color_epi32(x3), load_color_epi32(x0)), _mm_set1_epi32(1)), 6));
+
+    sum = _mm_sra_epi32(_mm_add_epi32(sum, bias), _mm_cvtsi32_si128(shift));
+    sum = _mm_add_epi32(sum, load_color_epi32(base));
+
+    /* truncate to 16 bits like the scalar stores do */
+    sum = _mm_srai_epi32(_mm_slli_epi32(sum, 16), 16);
+    _mm_storel_epi64((__m128i *)TEX, _mm_packs_epi32(sum, sum));
+}
+#elif defined(SIMD_KERNELS_NEON)
+static STRICTINLINE void texel_lerp_simd(
+    COLOR *TEX, const COLOR *base, const COLOR *x0, const COLOR *x1,
+    const COLOR *x2, const COLOR *x3, int32_t f1, int32_t f2, int32_t round,
+    int shift)
+{
+    const int32x4_t v0 = vmovl_s16(vld1_s16(x0->col));
+    int32x4_t sum, bias;
+
+    sum = vmulq_n_s32(vsubq_s32(vmovl_s16(vld1_s16(x1->col)), v0), f1);
+    sum = vmlaq_n_s32(sum, vsubq_s32(vmovl_s16(vld1_s16(x2->col)), v0), f2);
+
+    bias = vdupq_n_s32(round);
+    if (x3)
+        bias = vaddq_s32(bias, vshlq_n_s32(vsubq_s32(vsubq_s32(
+            vmovl_s16(vld1_s16(x3->col)), v0), vdupq_n_s32(1)), 6));
+
+    sum = vshlq_s32(vaddq_s32(sum, bias), vdupq_n_s32(-shift));
+    sum = vaddq_s32(sum, vmovl_s16(vld1_s16(base->col)));
+    vst1_s16(TEX->col, vmovn_s32(sum));
+}
+#endif
+
+static STRICTINLINE void texel_lerp(
+    COLOR *TEX, const COLOR *base, const COLOR *x0, const COLOR *x1,
+    const COLOR *x2, const COLOR *x3, int32_t f1, int32_t f2, int32_t round,
+    int shift)
+{
+#if defined(SIMD_KERNELS_SSE2) || defined(SIMD_KERNELS_NEON)
+    texel_lerp_simd(TEX, base, x0, x1, x2, x3, f1, f2, round, shift);
+#ifdef CHECK_SIMD_KERNELS
+    {
+        COLOR ref;
+
+        texel_lerp_scalar(&ref, base, x0, x1, x2, x3, f1, f2, round, shift);
+        if (memcmp(&ref, TEX, sizeof(ref)) != 0)
+        {
+            ++simd_mismatches;
+            *TEX = ref;
+        }
+    }
+#endif
+#else
+    texel_lerp_scalar(TEX, base, x0, x1, x2, x3, f1, f2, round, shift);
+#endif
+}
+
 static void combiner_1cycle(int adseed, uint32_t* curpixel_cvg)
 {
-    int32_t temp_combined_color[3];
+    int32_t temp_combined_color[4];
     int32_t redkey, greenkey, bluekey, temp;
     COLOR chromabypass;
     int32_t keyalpha;
@@ -1552,10 +1913,8 @@ static void combiner_1cycle(int adseed, uint32_t* curpixel_cvg)
        COLOR_BLUE(chromabypass)  = *combiner_rgbsub_a_b[1];
     }
     
-    temp_combined_color[0] = color_combiner_equation(*combiner_rgbsub_a_r[1],*combiner_rgbsub_b_r[1],*combiner_rgbmul_r[1],*combiner_rgbadd_r[1]);
-    temp_combined_color[1] = color_combiner_equation(*combiner_rgbsub_a_g[1],*combiner_rgbsub_b_g[1],*combiner_rgbmul_g[1],*combiner_rgbadd_g[1]);
-    temp_combined_color[2] = color_combiner_equation(*combiner_rgbsub_a_b[1],*combiner_rgbsub_b_b[1],*combiner_rgbmul_b[1],*combiner_rgbadd_b[1]);
-    COLOR_ALPHA(combined_color) = alpha_combiner_equation(*combiner_alphasub_a[1],*combiner_alphasub_b[1],*combiner_alphamul[1],*combiner_alphaadd[1]);
+    combiner_equations(temp_combined_color, 1);
+    COLOR_ALPHA(combined_color) = temp_combined_color[3];
 
     COLOR_ALPHA(pixel_color) = special_9bit_clamptable[COLOR_ALPHA(combined_color)];
     if (COLOR_ALPHA(pixel_color) == 0xff)
@@ -1636,7 +1995,7 @@ static void combiner_1cycle(int adseed, uint32_t* curpixel_cvg)
 
 static void combiner_2cycle(int adseed, uint32_t* curpixel_cvg, int32_t* acalpha)
 {
-    int32_t temp_combined_color[3];
+    int32_t temp_combined_color[4];
     int32_t redkey, greenkey, bluekey, temp;
     COLOR chromabypass;
     int32_t keyalpha;
@@ -1648,10 +2007,8 @@ static void combiner_2cycle(int adseed, uint32_t* curpixel_cvg, int32_t* acalpha
        COLOR_BLUE(chromabypass)  = *combiner_rgbsub_a_b[1];
     }
 
-    temp_combined_color[0] = color_combiner_equation(*combiner_rgbsub_a_r[0],*combiner_rgbsub_b_r[0],*combiner_rgbmul_r[0],*combiner_rgbadd_r[0]);
-    temp_combined_color[1] = color_combiner_equation(*combiner_rgbsub_a_g[0],*combiner_rgbsub_b_g[0],*combiner_rgbmul_g[0],*combiner_rgbadd_g[0]);
-    temp_combined_color[2] = color_combiner_equation(*combiner_rgbsub_a_b[0],*combiner_rgbsub_b_b[0],*combiner_rgbmul_b[0],*combiner_rgbadd_b[0]);
-    COLOR_ALPHA(combined_color) = alpha_combiner_equation(*combiner_alphasub_a[0],*combiner_alphasub_b[0],*combiner_alphamul[0],*combiner_alphaadd[0]);
+    combiner_equations(temp_combined_color, 0);
+    COLOR_ALPHA(combined_color) = temp_combined_color[3];
 
     if (other_modes.alpha_compare_en)
     {
@@ -1716,10 +2073,8 @@ static void combiner_2cycle(int adseed, uint32_t* curpixel_cvg, int32_t* acalpha
     COLOR_ASSIGN(texel0_color, texel1_color);
     COLOR_ASSIGN(texel1_color, nexttexel_color);
 
-    temp_combined_color[0]   = color_combiner_equation(*combiner_rgbsub_a_r[1],*combiner_rgbsub_b_r[1],*combiner_rgbmul_r[1],*combiner_rgbadd_r[1]);
-    temp_combined_color[1] = color_combiner_equation(*combiner_rgbsub_a_g[1],*combiner_rgbsub_b_g[1],*combiner_rgbmul_g[1],*combiner_rgbadd_g[1]);
-    temp_combined_color[2]  = color_combiner_equation(*combiner_rgbsub_a_b[1],*combiner_rgbsub_b_b[1],*combiner_rgbmul_b[1],*combiner_rgbadd_b[1]);
-    COLOR_ALPHA(combined_color) = alpha_combiner_equation(*combiner_alphasub_a[1],*combiner_alphasub_b[1],*combiner_alphamul[1],*combiner_alphaadd[1]);
+    combiner_equations(temp_combined_color, 1);
+    COLOR_ALPHA(combined_color) = temp_combined_color[3];
 
     if (!other_modes.key_en)
     {
@@ -3791,12 +4146,12 @@ void angrylion_set_filtering(unsigned filter_type)
 
 static void texture_pipeline_cycle(COLOR* TEX, COLOR* prev, int32_t SSS, int32_t SST, uint32_t tilenum, uint32_t cycle)                                            
 {
-    int32_t maxs, maxt, invt0r, invt0g, invt0b, invt0a;
+    int32_t maxs, maxt;
     int32_t sfrac, tfrac, invsf, invtf;
     int upper = 0;
     int bilerp = cycle ? other_modes.bi_lerp1 : other_modes.bi_lerp0;
     int convert = other_modes.convert_one && cycle;
-    COLOR t0, t1, t2, t3;
+    COLOR t0, t1, t2, t3, convbase;
     int sss1, sst1, sss2, sst2;
 
     sss1 = SSS;
@@ -3846,73 +4201,44 @@ static void texture_pipeline_cycle(COLOR* TEX, COLOR* prev, int32_t SSS, int32_t
             else
                 fetch_texel_entlut_quadro(&t0, &t1, &t2, &t3, sss1, sss2, sst1, sst2, tilenum);
 
+            if (convert)
+            {
+                COLOR_RED(convbase)   = COLOR_BLUE_PTR(prev);
+                COLOR_GREEN(convbase) = COLOR_BLUE_PTR(prev);
+                COLOR_BLUE(convbase)  = COLOR_BLUE_PTR(prev);
+                COLOR_ALPHA(convbase) = COLOR_BLUE_PTR(prev);
+            }
+
             if (!other_modes.mid_texel || sfrac != 0x10 || tfrac != 0x10)
             {
                 if (!convert)
                 {
-
                     if (UPPER)
                     {
-                        
                         invsf = 0x20 - sfrac;
                         invtf = 0x20 - tfrac;
-                        COLOR_RED_PTR(TEX) = COLOR_RED(t3) + ((((invsf * (COLOR_RED(t2) - COLOR_RED(t3))) + (invtf * (COLOR_RED(t1) - COLOR_RED(t3)))) + 0x10) >> 5);    
-                        COLOR_GREEN_PTR(TEX) = COLOR_GREEN(t3) + ((((invsf * (COLOR_GREEN(t2) - COLOR_GREEN(t3))) + (invtf * (COLOR_GREEN(t1) - COLOR_GREEN(t3)))) + 0x10) >> 5);                                                                        
-                        COLOR_BLUE_PTR(TEX) = COLOR_BLUE(t3) + ((((invsf * (COLOR_BLUE(t2) - COLOR_BLUE(t3))) + (invtf * (COLOR_BLUE(t1) - COLOR_BLUE(t3)))) + 0x10) >> 5);                                                                
-                        COLOR_ALPHA_PTR(TEX) = COLOR_ALPHA(t3) + ((((invsf * (COLOR_ALPHA(t2) - COLOR_ALPHA(t3))) + (invtf * (COLOR_ALPHA(t1) - COLOR_ALPHA(t3)))) + 0x10) >> 5);
+                        texel_lerp(TEX, &t3, &t3, &t2, &t1, NULL, invsf, invtf, 0x10, 5);
                     }
                     else
-                    {
-                       COLOR_RED_PTR(TEX) = COLOR_RED(t0) + ((((sfrac * (COLOR_RED(t1) - COLOR_RED(t0))) + (tfrac * (COLOR_RED(t2) - COLOR_RED(t0)))) + 0x10) >> 5);                                            
-                       COLOR_GREEN_PTR(TEX) = COLOR_GREEN(t0) + ((((sfrac * (COLOR_GREEN(t1) - COLOR_GREEN(t0))) + (tfrac * (COLOR_GREEN(t2) - COLOR_GREEN(t0)))) + 0x10) >> 5);                                            
-                       COLOR_BLUE_PTR(TEX) = COLOR_BLUE(t0) + ((((sfrac * (COLOR_BLUE(t1) - COLOR_BLUE(t0))) + (tfrac * (COLOR_BLUE(t2) - COLOR_BLUE(t0)))) + 0x10) >> 5);                                    
-                       COLOR_ALPHA_PTR(TEX) = COLOR_ALPHA(t0) + ((((sfrac * (COLOR_ALPHA(t1) - COLOR_ALPHA(t0))) + (tfrac * (COLOR_ALPHA(t2) - COLOR_ALPHA(t0)))) + 0x10) >> 5);
-                    }
+                        texel_lerp(TEX, &t0, &t0, &t1, &t2, NULL, sfrac, tfrac, 0x10, 5);
                 }
                 else
                 {
-
                     if (UPPER)
-                    {
-                       COLOR_RED_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_RED(t2) - COLOR_RED(t3))) + (COLOR_GREEN_PTR(prev) * (COLOR_RED(t1) - COLOR_RED(t3)))) + 0x80) >> 8);    
-                       COLOR_GREEN_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_GREEN(t2) - COLOR_GREEN(t3))) + (COLOR_GREEN_PTR(prev) * (COLOR_GREEN(t1) - COLOR_GREEN(t3)))) + 0x80) >> 8);                                                                        
-                       COLOR_BLUE_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_BLUE(t2) - COLOR_BLUE(t3))) + (COLOR_GREEN_PTR(prev) * (COLOR_BLUE(t1) - COLOR_BLUE(t3)))) + 0x80) >> 8);                                                                
-                       COLOR_ALPHA_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_ALPHA(t2) - COLOR_ALPHA(t3))) + (COLOR_GREEN_PTR(prev) * (COLOR_ALPHA(t1) - COLOR_ALPHA(t3)))) + 0x80) >> 8);
-                    }
+                        texel_lerp(TEX, &convbase, &t3, &t2, &t1, NULL,
+                            COLOR_RED_PTR(prev), COLOR_GREEN_PTR(prev), 0x80, 8);
                     else
-                    {
-                        COLOR_RED_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_RED(t1) - COLOR_RED(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_RED(t2) - COLOR_RED(t0)))) + 0x80) >> 8);                                            
-                        COLOR_GREEN_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_GREEN(t1) - COLOR_GREEN(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_GREEN(t2) - COLOR_GREEN(t0)))) + 0x80) >> 8);                                            
-                        COLOR_BLUE_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_BLUE(t1) - COLOR_BLUE(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_BLUE(t2) - COLOR_BLUE(t0)))) + 0x80) >> 8);                                    
-                        COLOR_ALPHA_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_ALPHA(t1) - COLOR_ALPHA(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_ALPHA(t2) - COLOR_ALPHA(t0)))) + 0x80) >> 8);
-                    }    
+                        texel_lerp(TEX, &convbase, &t0, &t1, &t2, NULL,
+                            COLOR_RED_PTR(prev), COLOR_GREEN_PTR(prev), 0x80, 8);
                 }
-                
             }
             else
             {
-               invt0r  = ~COLOR_RED(t0);
-               invt0g  = ~COLOR_GREEN(t0);
-               invt0b  = ~COLOR_BLUE(t0);
-               invt0a  = ~COLOR_ALPHA(t0);
-
                 if (!convert)
-                {
-                    sfrac <<= 2;
-                    tfrac <<= 2;
-
-                    COLOR_RED_PTR(TEX) = COLOR_RED(t0) + ((((sfrac * (COLOR_RED(t1) - COLOR_RED(t0))) + (tfrac * (COLOR_RED(t2) - COLOR_RED(t0)))) + ((invt0r + COLOR_RED(t3)) << 6) + 0xc0) >> 8);                                            
-                    COLOR_GREEN_PTR(TEX) = COLOR_GREEN(t0) + ((((sfrac * (COLOR_GREEN(t1) - COLOR_GREEN(t0))) + (tfrac * (COLOR_GREEN(t2) - COLOR_GREEN(t0)))) + ((invt0g + COLOR_GREEN(t3)) << 6) + 0xc0) >> 8);                                            
-                    COLOR_BLUE_PTR(TEX) = COLOR_BLUE(t0) + ((((sfrac * (COLOR_BLUE(t1) - COLOR_BLUE(t0))) + (tfrac * (COLOR_BLUE(t2) - COLOR_BLUE(t0)))) + ((invt0b + COLOR_BLUE(t3)) << 6) + 0xc0) >> 8);                                    
-                    COLOR_ALPHA_PTR(TEX) = COLOR_ALPHA(t0) + ((((sfrac * (COLOR_ALPHA(t1) - COLOR_ALPHA(t0))) + (tfrac * (COLOR_ALPHA(t2) - COLOR_ALPHA(t0)))) + ((invt0a + COLOR_ALPHA(t3)) << 6) + 0xc0) >> 8);
-                }
+                    texel_lerp(TEX, &t0, &t0, &t1, &t2, &t3, sfrac << 2, tfrac << 2, 0xc0, 8);
                 else
-                {
-            COLOR_RED_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_RED(t1) - COLOR_RED(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_RED(t2) - COLOR_RED(t0)))) + ((invt0r + COLOR_RED(t3)) << 6) + 0xc0) >> 8);                                            
-            COLOR_GREEN_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_GREEN(t1) - COLOR_GREEN(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_GREEN(t2) - COLOR_GREEN(t0)))) + ((invt0g + COLOR_GREEN(t3)) << 6) + 0xc0) >> 8);                                            
-            COLOR_BLUE_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_BLUE(t1) - COLOR_BLUE(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_BLUE(t2) - COLOR_BLUE(t0)))) + ((invt0b + COLOR_BLUE(t3)) << 6) + 0xc0) >> 8);                                    
-            COLOR_ALPHA_PTR(TEX) = COLOR_BLUE_PTR(prev) + ((((COLOR_RED_PTR(prev) * (COLOR_ALPHA(t1) - COLOR_ALPHA(t0))) + (COLOR_GREEN_PTR(prev) * (COLOR_ALPHA(t2) - COLOR_ALPHA(t0)))) + ((invt0a + COLOR_ALPHA(t3)) << 6) + 0xc0) >> 8);
-                }
+                    texel_lerp(TEX, &convbase, &t0, &t1, &t2, &t3,
+                        COLOR_RED_PTR(prev), COLOR_GREEN_PTR(prev), 0xc0, 8);
             }
             
         }
@@ -5090,11 +5416,11 @@ static void render_spans_1cycle_complete(int start, int end, int tilenum, int fl
     else
     {
         dzpix = primitive_delta_z;
-        dzinc = spans_cdz = spans_d_stwz_dy[3] = 0;
+        dzinc = 0;
     }
     dzpixenc = dz_compress(dzpix);
 
-    for (i = start; i <= end; i++)
+    for (i = start + span_band; i <= end; i += span_bands)
     {
        SPAN *span_ptr = &span[i];
         if (!span_ptr || span_ptr->validline == 0)
@@ -5277,11 +5603,11 @@ static void render_spans_1cycle_notexel1(int start, int end, int tilenum, int fl
     else
     {
         dzpix = primitive_delta_z;
-        dzinc = spans_cdz = spans_d_stwz_dy[3] = 0;
+        dzinc = 0;
     }
     dzpixenc = dz_compress(dzpix);
                     
-    for (i = start; i <= end; i++)
+    for (i = start + span_band; i <= end; i += span_bands)
     {
        SPAN *span_ptr = &span[i];
         if (!span_ptr || span_ptr->validline == 0)
@@ -5452,11 +5778,11 @@ static void render_spans_1cycle_notex(int start, int end, int tilenum, int flip)
     else
     {
         dzpix = primitive_delta_z;
-        dzinc = spans_cdz = spans_d_stwz_dy[3] = 0;
+        dzinc = 0;
     }
     dzpixenc = dz_compress(dzpix);
                     
-    for (i = start; i <= end; i++)
+    for (i = start + span_band; i <= end; i += span_bands)
     {
        SPAN *span_ptr = &span[i];
         if (!span_ptr || span_ptr->validline == 0)
@@ -5900,11 +6226,11 @@ static void render_spans_2cycle_complete(int start, int end, int tilenum, int fl
     else
     {
         dzpix = primitive_delta_z;
-        dzinc = spans_cdz = spans_d_stwz_dy[3] = 0;
+        dzinc = 0;
     }
     dzpixenc = dz_compress(dzpix);
                 
-    for (i = start; i <= end; i++)
+    for (i = start + span_band; i <= end; i += span_bands)
     {
         if (span[i].validline == 0)
             continue;
@@ -6088,11 +6414,11 @@ static void render_spans_2cycle_notexelnext(int start, int end, int tilenum, int
     else
     {
         dzpix = primitive_delta_z;
-        dzinc = spans_cdz = spans_d_stwz_dy[3] = 0;
+        dzinc = 0;
     }
     dzpixenc = dz_compress(dzpix);
                 
-    for (i = start; i <= end; i++)
+    for (i = start + span_band; i <= end; i += span_bands)
     {
         if (span[i].validline == 0)
             continue;
@@ -6270,11 +6596,11 @@ static void render_spans_2cycle_notexel1(int start, int end, int tilenum, int fl
     else
     {
         dzpix = primitive_delta_z;
-        dzinc = spans_cdz = spans_d_stwz_dy[3] = 0;
+        dzinc = 0;
     }
     dzpixenc = dz_compress(dzpix);
 
-    for (i = start; i <= end; i++)
+    for (i = start + span_band; i <= end; i += span_bands)
     {
         if (span[i].validline == 0)
             continue;
@@ -6447,11 +6773,11 @@ static void render_spans_2cycle_notex(int start, int end, int tilenum, int flip)
     else
     {
         dzpix = primitive_delta_z;
-        dzinc = spans_cdz = spans_d_stwz_dy[3] = 0;
+        dzinc = 0;
     }
     dzpixenc = dz_compress(dzpix);
                 
-    for (i = start; i <= end; i++)
+    for (i = start + span_band; i <= end; i += span_bands)
     {
         if (span[i].validline == 0)
             continue;
@@ -7006,6 +7332,360 @@ static void deduce_derivatives(void)
     other_modes.f.dolod = other_modes.tex_lod_en || lodfracused;
 }
 
+#ifdef PLUGIN_THREADS
+/*
+ * Scanline-parallel rendering.
+ *
+ * A primitive is split into interleaved scanline bands only when the result
+ * cannot depend on the order its spans are drawn in:
+ *
+ *  - no state carried from one pixel into the next (the COMBINED input of
+ *    the first combiner cycle, the pipelined memory color and blender
+ *    shifters of 2-cycle mode),
+ *  - no use of the irand() sequence (noise, random dither, dithered alpha
+ *    compare),
+ *  - every span stays inside its own framebuffer row, and the color and
+ *    depth images do not overlap.
+ *
+ * Everything else, copy and fill rectangles and short primitives run on the
+ * RDP thread exactly as before.  The per-pixel state left behind by the
+ * thread that drew the last span is copied back, so later primitives see
+ * what a serial run would have left.
+ */
+#define MAX_RENDER_THREADS  16
+#define MIN_PARALLEL_SPANS  16
+
+typedef struct {
+    COLOR combined_color;
+    COLOR texel0_color;
+    COLOR texel1_color;
+    COLOR nexttexel_color;
+    COLOR shade_color;
+    COLOR pixel_color;
+    COLOR inv_pixel_color;
+    COLOR blended_pixel_color;
+    COLOR memory_color;
+    COLOR pre_memory_color;
+    int16_t lod_frac;
+    int blshifta, blshiftb;
+    int pastblshifta, pastblshiftb;
+    int32_t pastrawdzmem;
+} PIXEL_STATE;
+
+typedef struct {
+    void (*render)(int, int, int, int);
+    int start, end;
+    int tilenum, flip;
+    PIXEL_STATE state;
+} RENDER_JOB;
+
+static unsigned render_threads_wanted = 1;
+static unsigned render_threads = 1;
+static plugin_thread_t *render_thread[MAX_RENDER_THREADS];
+static plugin_mutex_t *render_mutex;
+static plugin_cond_t *render_start_cond;
+static plugin_cond_t *render_done_cond;
+static unsigned render_job_seq;
+static unsigned render_jobs_pending;
+static int render_quit;
+static RENDER_JOB render_job;
+static PIXEL_STATE render_thread_state[MAX_RENDER_THREADS];
+
+static void pixel_state_save(PIXEL_STATE *state)
+{
+    state->combined_color      = combined_color;
+    state->texel0_color        = texel0_color;
+    state->texel1_color        = texel1_color;
+    state->nexttexel_color     = nexttexel_color;
+    state->shade_color         = shade_color;
+    state->pixel_color         = pixel_color;
+    state->inv_pixel_color     = inv_pixel_color;
+    state->blended_pixel_color = blended_pixel_color;
+    state->memory_color        = memory_color;
+    state->pre_memory_color    = pre_memory_color;
+    state->lod_frac            = lod_frac;
+    state->blshifta            = blshifta;
+    state->blshiftb            = blshiftb;
+    state->pastblshifta        = pastblshifta;
+    state->pastblshiftb        = pastblshiftb;
+    state->pastrawdzmem        = pastrawdzmem;
+}
+
+static void pixel_state_load(const PIXEL_STATE *state)
+{
+    combined_color      = state->combined_color;
+    texel0_color        = state->texel0_color;
+    texel1_color        = state->texel1_color;
+    nexttexel_color     = state->nexttexel_color;
+    shade_color         = state->shade_color;
+    pixel_color         = state->pixel_color;
+    inv_pixel_color     = state->inv_pixel_color;
+    blended_pixel_color = state->blended_pixel_color;
+    memory_color        = state->memory_color;
+    pre_memory_color    = state->pre_memory_color;
+    lod_frac            = state->lod_frac;
+    blshifta            = state->blshifta;
+    blshiftb            = state->blshiftb;
+    pastblshifta        = state->pastblshifta;
+    pastblshiftb        = state->pastblshiftb;
+    pastrawdzmem        = state->pastrawdzmem;
+}
+
+static void render_thread_loop(void *data)
+{
+    const int band = (int)(size_t)data;
+    unsigned seq = 0;
+
+    span_band  = band;
+
+    plugin_mutex_lock(render_mutex);
+    for (;;)
+    {
+        while (render_job_seq == seq && !render_quit)
+            plugin_cond_wait(render_start_cond, render_mutex);
+        if (render_quit)
+            break;
+        seq = render_job_seq;
+        plugin_mutex_unlock(render_mutex);
+
+        span_bands = render_threads;
+        pixel_state_load(&render_job.state);
+        update_combiner_inputs();
+        update_blender_inputs();
+        render_job.render(
+            render_job.start, render_job.end, render_job.tilenum, render_job.flip);
+        pixel_state_save(&render_thread_state[band]);
+#ifdef CHECK_SIMD_KERNELS
+        simd_check_report(render_job.start, render_job.end);
+#endif
+
+        plugin_mutex_lock(render_mutex);
+        if (--render_jobs_pending == 0)
+            plugin_cond_signal(render_done_cond);
+    }
+    plugin_mutex_unlock(render_mutex);
+}
+
+static void render_threads_stop(void)
+{
+    unsigned i;
+
+    if (render_mutex)
+    {
+        plugin_mutex_lock(render_mutex);
+        render_quit = 1;
+        plugin_cond_broadcast(render_start_cond);
+        plugin_mutex_unlock(render_mutex);
+    }
+
+    for (i = 1; i < MAX_RENDER_THREADS; i++)
+    {
+        plugin_thread_join(render_thread[i]);
+        render_thread[i] = NULL;
+    }
+
+    plugin_cond_free(render_done_cond);
+    plugin_cond_free(render_start_cond);
+    plugin_mutex_free(render_mutex);
+    render_done_cond  = NULL;
+    render_start_cond = NULL;
+    render_mutex      = NULL;
+    render_threads    = 1;
+}
+
+static void render_threads_start(unsigned count)
+{
+    unsigned i;
+
+    render_threads_stop();
+    if (count < 2)
+        return;
+
+    render_mutex      = plugin_mutex_new();
+    render_start_cond = plugin_cond_new();
+    render_done_cond  = plugin_cond_new();
+    if (!render_mutex || !render_start_cond || !render_done_cond)
+    {
+        render_threads_stop();
+        return;
+    }
+
+    render_quit    = 0;
+    render_job_seq = 0;
+    for (i = 1; i < count; i++)
+    {
+        render_thread[i] = plugin_thread_create(render_thread_loop, (void*)(size_t)i);
+        if (!render_thread[i])
+        {
+            render_threads_stop();
+            return;
+        }
+    }
+    render_threads = count;
+}
+
+static int combiner_reads_combined(int cycle)
+{
+    const int16_t *r = &COLOR_RED(combined_color);
+    const int16_t *a = &COLOR_ALPHA(combined_color);
+
+    return combiner_rgbsub_a_r[cycle] == r || combiner_rgbsub_b_r[cycle] == r ||
+           combiner_rgbmul_r[cycle] == r || combiner_rgbadd_r[cycle] == r ||
+           combiner_rgbmul_r[cycle] == a ||
+           combiner_alphasub_a[cycle] == a || combiner_alphasub_b[cycle] == a ||
+           combiner_alphamul[cycle] == a || combiner_alphaadd[cycle] == a;
+}
+
+static int blender_reads_memory(int cycle)
+{
+    return blender1a_r[cycle] == &COLOR_RED(memory_color) ||
+           blender2a_r[cycle] == &COLOR_RED(memory_color) ||
+           blender1b_a[cycle] == &COLOR_ALPHA(memory_color) ||
+           blender2b_a[cycle] == &COLOR_ALPHA(memory_color);
+}
+
+static int render_spans_parallel_safe(int start, int end)
+{
+    uint32_t fb_lo, fb_hi, zb_lo, zb_hi;
+    int i;
+
+    if (render_threads < 2 || end - start + 1 < MIN_PARALLEL_SPANS)
+        return 0;
+
+    switch (other_modes.cycle_type)
+    {
+       case CYCLE_TYPE_1:
+          if (combiner_reads_combined(1))
+             return 0;
+          break;
+       case CYCLE_TYPE_2:
+          if (combiner_reads_combined(0) || blender_reads_memory(0))
+             return 0;
+          break;
+       default:
+          return 0;
+    }
+
+    if (get_dither_noise_type == 0 || other_modes.rgb_dither_sel == 2)
+        return 0;
+    if (other_modes.alpha_compare_en && other_modes.dither_alpha_en)
+        return 0;
+
+    for (i = start; i <= end; i++)
+    {
+        if (span[i].validline == 0)
+            continue;
+        if (span[i].lx < 0 || span[i].lx >= fb_width ||
+            span[i].rx < 0 || span[i].rx >= fb_width)
+            return 0;
+    }
+
+    /* a few bytes of slack cover the address alignment done per pixel size */
+    fb_lo = (fb_address & RDRAM_MASK) + PIXELS_TO_BYTES(start * fb_width, fb_size);
+    fb_hi = (fb_address & RDRAM_MASK) + PIXELS_TO_BYTES((end + 1) * fb_width, fb_size) + 4;
+    if (fb_hi > RDRAM_MASK + 1)
+        return 0;
+
+    if (other_modes.z_compare_en || other_modes.z_update_en)
+    {
+        zb_lo = (zb_address & RDRAM_MASK) + 2 * start * fb_width;
+        zb_hi = (zb_address & RDRAM_MASK) + 2 * (end + 1) * fb_width + 4;
+        if (zb_hi > RDRAM_MASK + 1)
+            return 0;
+        if (zb_lo < fb_hi + 4 && fb_lo < zb_hi + 4)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void render_spans_parallel(
+    void (*render)(int, int, int, int), int start, int end, int tilenum, int flip)
+{
+    int last = end;
+
+    while (last >= start && span[last].validline == 0)
+        --last;
+    if (last < start)
+        return;
+
+    pixel_state_save(&render_job.state);
+    render_job.render  = render;
+    render_job.start   = start;
+    render_job.end     = end;
+    render_job.tilenum = tilenum;
+    render_job.flip    = flip;
+
+    plugin_mutex_lock(render_mutex);
+    render_jobs_pending = render_threads - 1;
+    ++render_job_seq;
+    plugin_cond_broadcast(render_start_cond);
+    plugin_mutex_unlock(render_mutex);
+
+    span_band  = 0;
+    span_bands = render_threads;
+    render(start, end, tilenum, flip);
+    span_bands = 1;
+
+    plugin_mutex_lock(render_mutex);
+    while (render_jobs_pending != 0)
+        plugin_cond_wait(render_done_cond, render_mutex);
+    plugin_mutex_unlock(render_mutex);
+
+    if ((last - start) % render_threads != 0)
+        pixel_state_load(&render_thread_state[(last - start) % render_threads]);
+}
+
+void angrylion_set_threads(unsigned count)
+{
+    if (count == 0)
+        count = cpu_features_get_core_amount();
+    if (count < 1)
+        count = 1;
+    if (count > MAX_RENDER_THREADS)
+        count = MAX_RENDER_THREADS;
+    render_threads_wanted = count;
+}
+#else
+void angrylion_set_threads(unsigned count)
+{
+}
+#endif
+
+static void render_spans_cycle(
+    void (*render)(int, int, int, int), int start, int end, int tilenum, int flip)
+{
+#ifdef PLUGIN_THREADS
+    if (render_threads != render_threads_wanted)
+        render_threads_start(render_threads_wanted);
+
+    if (render_spans_parallel_safe(start, end))
+        render_spans_parallel(render, start, end, tilenum, flip);
+    else
+#endif
+        render(start, end, tilenum, flip);
+#ifdef CHECK_SIMD_KERNELS
+    simd_check_report(start, end);
+#endif
+}
+
+#ifdef TRACE_DP_COMMANDS
+static uint64_t span_pixel_count;
+
+static void count_span_pixels(int start, int end, int flip)
+{
+    int i;
+
+    for (i = start; i <= end; i++)
+    {
+        const int length = flip ? span[i].lx - span[i].rx : span[i].rx - span[i].lx;
+
+        if (span[i].validline && length >= 0)
+            span_pixel_count += length + 1;
+    }
+}
+#endif
+
 static void render_spans(
     int yhlimit, int yllimit, int tilenum, int flip)
 {
@@ -7014,6 +7694,9 @@ static void render_spans(
         deduce_derivatives();
         other_modes.f.stalederivs = 0;
     }
+#ifdef TRACE_DP_COMMANDS
+    count_span_pixels(yhlimit, yllimit, flip);
+#endif
 
     fbread1_ptr = fbread_func[fb_size];
     fbread2_ptr = fbread2_func[fb_size];
@@ -7026,10 +7709,14 @@ static void render_spans(
     switch (other_modes.cycle_type)
     {
        case CYCLE_TYPE_1:
-          render_spans_1cycle_ptr(yhlimit, yllimit, tilenum, flip);
+          if (other_modes.z_source_sel)
+             spans_cdz = spans_d_stwz_dy[3] = 0;
+          render_spans_cycle(render_spans_1cycle_ptr, yhlimit, yllimit, tilenum, flip);
           break;
        case CYCLE_TYPE_2:
-          render_spans_2cycle_ptr(yhlimit, yllimit, tilenum, flip);
+          if (other_modes.z_source_sel)
+             spans_cdz = spans_d_stwz_dy[3] = 0;
+          render_spans_cycle(render_spans_2cycle_ptr, yhlimit, yllimit, tilenum, flip);
           break;
        case CYCLE_TYPE_COPY:
           render_spans_copy(yhlimit, yllimit, tilenum, flip);
@@ -7461,8 +8148,18 @@ int32_t irand(void)
     return ((iseed >> 16) & 0x7fff);
 }
 
+#ifdef RDP_ASYNC
+static void rdp_async_stop(void);
+#endif
+
 void rdp_close(void)
 {
+#ifdef RDP_ASYNC
+    rdp_async_stop();
+#endif
+#ifdef PLUGIN_THREADS
+    render_threads_stop();
+#endif
 }
 
 static STRICTINLINE int finalize_spanalpha(
@@ -8000,62 +8697,100 @@ static void count_DP_commands(void)
     for (i = 0; i < 64; i++)
         cmd_count[i] = 0; /* reset for fresh data */
 }
-#endif
 
-void process_RDP_list(void)
+/* used by tools/rdp-bench */
+const char *rdp_trace_command_name(int command)
 {
-    int length;
-    unsigned int offset;
-    const uint32_t DP_CURRENT = *GET_GFX_INFO(DPC_CURRENT_REG) & 0x00FFFFF8;
-    const uint32_t DP_END     = *GET_GFX_INFO(DPC_END_REG)     & 0x00FFFFF8;
+    return DP_command_names[command & 63];
+}
 
-    *GET_GFX_INFO(DPC_STATUS_REG) &= ~DP_STATUS_FREEZE;
+uint64_t rdp_trace_pixels(void)
+{
+    return span_pixel_count;
+}
+#endif
 
-    length = DP_END - DP_CURRENT;
-    if (length <= 0)
-        return;
-    length = (unsigned)(length) / sizeof(int64_t);
-    if ((cmd_ptr + length) & ~(0x0003FFFF / sizeof(int64_t)))
-    {
-        DisplayError("ProcessRDPList\nOut of command cache memory.");
-        return;
-    }
+#ifdef RDP_ASYNC
+/*
+ * Asynchronous command processing.
+ *
+ * In async mode process_RDP_list only copies the DP FIFO into a ring and
+ * returns; a dedicated RDP thread drains the ring and runs the commands.
+ * The emulation thread waits for that thread to go idle (rdp_wait_idle)
+ * only where it has to see the RDP's results:
+ *
+ *  - a command list containing SYNC_FULL, so the DP interrupt is still
+ *    raised from the emulation thread once the list has completed,
+ *  - CPU accesses to a recent color image (FBRead/FBWrite), which the core
+ *    only reports for the ranges returned by rdp_get_framebuffer_info,
+ *  - VI scanout in rdp_update, savestates and shutdown.
+ *
+ * CPU writes to textures or display lists that are still queued are not
+ * fenced, which is why this mode is optional.  Each ring entry is a header
+ * word holding the length, followed by the list itself.
+ */
+#define RDP_RING_SIZE       0x10000 /* 64-bit words, power of two */
+#define RDP_RING_MASK       (RDP_RING_SIZE - 1)
+#define RDP_ASYNC_FB_COUNT  6
 
-#ifdef HAVE_RDP_DUMP
-    /* Flush out changes in DRAM if anything has changed. */
-    if (!rdp_dump_active)
-    {
-       rdp_dump_flush_dram(DRAM, 8 * 1024 * 1024);
-       rdp_dump_begin_command_list();
-       rdp_dump_active = 1;
-    }
+typedef struct {
+    uint32_t addr;
+    uint32_t size;
+    uint32_t width;
+    uint32_t height;
+} RDP_FB_INFO;
+
+static DP_FIFO rdp_ring[RDP_RING_SIZE];
+static unsigned rdp_ring_read;
+static unsigned rdp_ring_write;
+static int rdp_async_wanted;
+static int rdp_async_running;
+static int rdp_async_quit;
+static unsigned rdp_async_interrupts;
+static plugin_thread_t *rdp_async_thread;
+static plugin_mutex_t *rdp_async_mutex;
+static plugin_cond_t *rdp_async_work_cond;
+static plugin_cond_t *rdp_async_idle_cond;
+static PIXEL_STATE rdp_async_state;
+static RDP_FB_INFO rdp_async_fb[RDP_ASYNC_FB_COUNT];
 #endif
 
-    --length; /* filling in cmd data in backwards order for performance */
+static int fetch_RDP_list(
+    DP_FIFO *fifo, unsigned pos, unsigned mask, uint32_t DP_CURRENT, uint32_t DP_END)
+{
+    int length;
+    unsigned int offset;
+
+    /* filling in cmd data in backwards order for performance */
+    length = (DP_END - DP_CURRENT) / sizeof(int64_t) - 1;
     offset = (DP_END - sizeof(int64_t)) / sizeof(int64_t);
     if (*GET_GFX_INFO(DPC_STATUS_REG) & DP_STATUS_XBUS_DMA)
         do
         {
             offset &= 0xFFF / sizeof(int64_t);
-            BUFFERFIFO(cmd_ptr + length, SP_DMEM, offset);
+            BUFFERFIFO_TO(fifo, (pos + length) & mask, SP_DMEM, offset);
             offset -= 0x001 * sizeof(int8_t);
         } while (--length >= 0);
     else
         if (DP_END > plim || DP_CURRENT > plim)
         {
             DisplayError("DRAM access violation overrides");
-            return;
+            return 0;
         }
         else
         {
             do
             {
                 offset &= 0xFFFFFF / sizeof(int64_t);
-                BUFFERFIFO(cmd_ptr + length, DRAM, offset);
+                BUFFERFIFO_TO(fifo, (pos + length) & mask, DRAM, offset);
                 offset -= 0x000001 * sizeof(int8_t);
             } while (--length >= 0);
         }
-    cmd_ptr += (DP_END - DP_CURRENT) / sizeof(int64_t); /* += length */
+    return 1;
+}
+
+static void run_RDP_commands(void)
+{
     if (rdp_pipeline_crashed != 0)
         goto exit_a;
 
@@ -8069,7 +8804,7 @@ void process_RDP_list(void)
         ++cmd_count[command];
 #endif
         if (cmd_ptr - cmd_cur - cmd_length < 0)
-            goto exit_b;
+            return; /* wait for the rest of the command */
 
 #ifdef HAVE_RDP_DUMP
         rdp_dump_emit_command(command,
@@ -8082,7 +8817,296 @@ void process_RDP_list(void)
 exit_a:
     cmd_ptr = 0;
     cmd_cur = 0;
-exit_b:
+}
+
+#ifdef RDP_ASYNC
+static void rdp_async_loop(void *data)
+{
+    unsigned read, write;
+
+    pixel_state_load(&rdp_async_state);
+    update_combiner_inputs();
+    update_blender_inputs();
+
+    plugin_mutex_lock(rdp_async_mutex);
+    for (;;)
+    {
+        while (rdp_ring_read == rdp_ring_write && !rdp_async_quit)
+            plugin_cond_wait(rdp_async_work_cond, rdp_async_mutex);
+        if (rdp_ring_read == rdp_ring_write)
+            break; /* quit, once everything queued has run */
+        read  = rdp_ring_read;
+        write = rdp_ring_write;
+        plugin_mutex_unlock(rdp_async_mutex);
+
+        while (read != write)
+        {
+            const unsigned length = rdp_ring[read & RDP_RING_MASK].UW32[0];
+            unsigned i;
+
+            if ((cmd_ptr + length) & ~(0x0003FFFF / sizeof(int64_t)))
+                DisplayError("ProcessRDPList\nOut of command cache memory.");
+            else
+            {
+                for (i = 0; i < length; i++)
+                    cmd_data[cmd_ptr + i] = rdp_ring[(read + 1 + i) & RDP_RING_MASK];
+                cmd_ptr += length;
+                run_RDP_commands();
+            }
+            read += length + 1;
+        }
+
+        plugin_mutex_lock(rdp_async_mutex);
+        rdp_ring_read = read;
+        plugin_cond_broadcast(rdp_async_idle_cond);
+    }
+    plugin_mutex_unlock(rdp_async_mutex);
+
+    pixel_state_save(&rdp_async_state);
+}
+
+static void rdp_async_stop(void)
+{
+    if (!rdp_async_running)
+        return;
+
+    plugin_mutex_lock(rdp_async_mutex);
+    rdp_async_quit = 1;
+    plugin_cond_signal(rdp_async_work_cond);
+    plugin_mutex_unlock(rdp_async_mutex);
+    plugin_thread_join(rdp_async_thread);
+
+    plugin_cond_free(rdp_async_idle_cond);
+    plugin_cond_free(rdp_async_work_cond);
+    plugin_mutex_free(rdp_async_mutex);
+    rdp_async_thread    = NULL;
+    rdp_async_idle_cond = NULL;
+    rdp_async_work_cond = NULL;
+    rdp_async_mutex     = NULL;
+    rdp_async_running   = 0;
+
+    /* carry on from where the RDP thread left off */
+    pixel_state_load(&rdp_async_state);
+    update_combiner_inputs();
+    update_blender_inputs();
+}
+
+static void rdp_async_start(void)
+{
+    rdp_async_mutex     = plugin_mutex_new();
+    rdp_async_work_cond = plugin_cond_new();
+    rdp_async_idle_cond = plugin_cond_new();
+    if (rdp_async_mutex && rdp_async_work_cond && rdp_async_idle_cond)
+    {
+        rdp_ring_read        = 0;
+        rdp_ring_write       = 0;
+        rdp_async_quit       = 0;
+        rdp_async_interrupts = 0;
+        memset(rdp_async_fb, 0, sizeof(rdp_async_fb));
+        pixel_state_save(&rdp_async_state);
+
+        rdp_async_running = 1;
+        rdp_async_thread  = plugin_thread_create(rdp_async_loop, NULL);
+        if (rdp_async_thread)
+            return;
+        rdp_async_running = 0;
+    }
+
+    plugin_cond_free(rdp_async_idle_cond);
+    plugin_cond_free(rdp_async_work_cond);
+    plugin_mutex_free(rdp_async_mutex);
+    rdp_async_idle_cond = NULL;
+    rdp_async_work_cond = NULL;
+    rdp_async_mutex     = NULL;
+    rdp_async_wanted    = 0;
+}
+
+/* Queues a list; returns 0 if it could not be read, like the serial path. */
+static int rdp_async_submit(
+    uint32_t DP_CURRENT, uint32_t DP_END, unsigned length, int *sync)
+{
+    const unsigned write = rdp_ring_write; /* only ever moved by us */
+    unsigned i;
+
+    plugin_mutex_lock(rdp_async_mutex);
+    while (RDP_RING_SIZE - (write - rdp_ring_read) < length + 1)
+        plugin_cond_wait(rdp_async_idle_cond, rdp_async_mutex);
+    plugin_mutex_unlock(rdp_async_mutex);
+
+    if (!fetch_RDP_list(rdp_ring, write + 1, RDP_RING_MASK, DP_CURRENT, DP_END))
+        return 0;
+    rdp_ring[write & RDP_RING_MASK].UW32[0] = length;
+
+    /*
+     * A list can start in the middle of a command, so this may also match
+     * a parameter word.  That only costs an early wait.
+     */
+    *sync = 0;
+    for (i = 1; i <= length; i++)
+        if (((rdp_ring[(write + i) & RDP_RING_MASK].UW32[0] >> 24) & 0x3F) == 0x29)
+        {
+            *sync = 1;
+            break;
+        }
+
+    plugin_mutex_lock(rdp_async_mutex);
+    rdp_ring_write = write + length + 1;
+    plugin_cond_signal(rdp_async_work_cond);
+    plugin_mutex_unlock(rdp_async_mutex);
+    return 1;
+}
+
+/* Called by the RDP thread whenever the color image or scissor changes. */
+static void rdp_async_note_color_image(void)
+{
+    RDP_FB_INFO info;
+    int i;
+
+    info.addr   = fb_address & 0x00FFFFFF;
+    info.size   = (1 << fb_size) >> 1; /* bytes per pixel, 0 for 4-bit */
+    info.width  = fb_width;
+    info.height = __clip.yl >> 2;
+
+    plugin_mutex_lock(rdp_async_mutex);
+    for (i = 0; i < RDP_ASYNC_FB_COUNT - 1; i++)
+        if (rdp_async_fb[i].addr == info.addr)
+            break;
+    if (rdp_async_fb[i].addr == info.addr && rdp_async_fb[i].height > info.height)
+        info.height = rdp_async_fb[i].height;
+    memmove(&rdp_async_fb[1], &rdp_async_fb[0], i * sizeof(rdp_async_fb[0]));
+    rdp_async_fb[0] = info;
+    plugin_mutex_unlock(rdp_async_mutex);
+}
+
+void rdp_wait_idle(void)
+{
+    unsigned interrupts;
+
+    if (!rdp_async_running)
+        return;
+
+    plugin_mutex_lock(rdp_async_mutex);
+    while (rdp_ring_read != rdp_ring_write)
+        plugin_cond_wait(rdp_async_idle_cond, rdp_async_mutex);
+    interrupts           = rdp_async_interrupts;
+    rdp_async_interrupts = 0;
+    plugin_mutex_unlock(rdp_async_mutex);
+
+    if (interrupts != 0)
+    {
+        *gfx_info.MI_INTR_REG |= DP_INTERRUPT;
+        gfx_info.CheckInterrupts();
+    }
+}
+
+void rdp_get_framebuffer_info(uint32_t *info, unsigned count)
+{
+    unsigned i;
+
+    memset(info, 0, count * 4 * sizeof(uint32_t));
+    if (!rdp_async_running)
+        return;
+
+    plugin_mutex_lock(rdp_async_mutex);
+    for (i = 0; i < count && i < RDP_ASYNC_FB_COUNT; i++)
+    {
+        info[4*i + 0] = rdp_async_fb[i].addr;
+        info[4*i + 1] = rdp_async_fb[i].size;
+        info[4*i + 2] = rdp_async_fb[i].width;
+        info[4*i + 3] = rdp_async_fb[i].height;
+    }
+    plugin_mutex_unlock(rdp_async_mutex);
+}
+
+void angrylion_set_async(unsigned enable)
+{
+    rdp_async_wanted = (enable != 0);
+}
+#else
+void rdp_wait_idle(void)
+{
+}
+
+void rdp_get_framebuffer_info(uint32_t *info, unsigned count)
+{
+    memset(info, 0, count * 4 * sizeof(uint32_t));
+}
+
+void angrylion_set_async(unsigned enable)
+{
+}
+#endif
+
+void process_RDP_list(void)
+{
+    int length;
+    const uint32_t DP_CURRENT = *GET_GFX_INFO(DPC_CURRENT_REG) & 0x00FFFFF8;
+    const uint32_t DP_END     = *GET_GFX_INFO(DPC_END_REG)     & 0x00FFFFF8;
+
+#ifdef RDP_ASYNC
+    if (rdp_async_running != rdp_async_wanted)
+    {
+        if (rdp_async_running)
+        {
+            rdp_wait_idle();
+            rdp_async_stop();
+        }
+        else
+            rdp_async_start();
+    }
+#endif
+
+    *GET_GFX_INFO(DPC_STATUS_REG) &= ~DP_STATUS_FREEZE;
+
+    length = DP_END - DP_CURRENT;
+    if (length <= 0)
+        return;
+    length = (unsigned)(length) / sizeof(int64_t);
+
+#ifdef RDP_ASYNC
+    if (rdp_async_running)
+    {
+        int sync;
+
+        /* never fits the command cache, and would never fit the ring */
+        if (length & ~(0x0003FFFF / sizeof(int64_t)))
+        {
+            DisplayError("ProcessRDPList\nOut of command cache memory.");
+            return;
+        }
+        if (!rdp_async_submit(DP_CURRENT, DP_END, length, &sync))
+            return;
+
+        *GET_GFX_INFO(DPC_START_REG)
+      = *GET_GFX_INFO(DPC_CURRENT_REG)
+      = *GET_GFX_INFO(DPC_END_REG);
+        if (sync)
+            rdp_wait_idle();
+        return;
+    }
+#endif
+
+    if ((cmd_ptr + length) & ~(0x0003FFFF / sizeof(int64_t)))
+    {
+        DisplayError("ProcessRDPList\nOut of command cache memory.");
+        return;
+    }
+
+#ifdef HAVE_RDP_DUMP
+    /* Flush out changes in DRAM if anything has changed. */
+    if (!rdp_dump_active)
+    {
+       rdp_dump_flush_dram(DRAM, 8 * 1024 * 1024);
+       rdp_dump_begin_command_list();
+       rdp_dump_active = 1;
+    }
+#endif
+
+    if (!fetch_RDP_list(cmd_data, cmd_ptr, ~0u, DP_CURRENT, DP_END))
+        return;
+    cmd_ptr += length;
+    run_RDP_commands();
+
     *GET_GFX_INFO(DPC_START_REG)
   = *GET_GFX_INFO(DPC_CURRENT_REG)
   = *GET_GFX_INFO(DPC_END_REG);
@@ -8937,8 +9961,15 @@ static void sync_full(uint32_t w1, uint32_t w2)
    fprintf(stderr, "Sync full\n");
    fprintf(stderr, "===================\n");
 #endif
-    *gfx_info.MI_INTR_REG |= DP_INTERRUPT;
-    gfx_info.CheckInterrupts();
+#ifdef RDP_ASYNC
+    if (rdp_async_running)
+        ++rdp_async_interrupts; /* raised by rdp_wait_idle */
+    else
+#endif
+    {
+        *gfx_info.MI_INTR_REG |= DP_INTERRUPT;
+        gfx_info.CheckInterrupts();
+    }
 
 #ifdef HAVE_RDP_DUMP
     if (rdp_dump_active)
@@ -8986,6 +10017,10 @@ static void set_scissor(uint32_t w1, uint32_t w2)
     sckeepodd   = (w2 & 0x01000000) >> (24 -  0);
     __clip.xl   = (w2 & 0x00FFF000) >> (12 -  0);
     __clip.yl   = (w2 & 0x00000FFF) >> ( 0 -  0);
+#ifdef RDP_ASYNC
+    if (rdp_async_running)
+        rdp_async_note_color_image();
+#endif
 }
 
 static void set_prim_depth(uint32_t w1, uint32_t w2)
@@ -9040,18 +10075,8 @@ static void set_other_modes(uint32_t w1, uint32_t w2)
     other_modes.dither_alpha_en  = !!(cmd_fifo.UW32[1] & 0x00000002); /*  1 */
     other_modes.alpha_compare_en = !!(cmd_fifo.UW32[1] & 0x00000001); /*  0 */
 
-    SET_BLENDER_INPUT(
-        0, 0, &blender1a_r[0], &blender1a_g[0], &blender1a_b[0],
-        &blender1b_a[0], other_modes.blend_m1a_0, other_modes.blend_m1b_0);
-    SET_BLENDER_INPUT(
-        0, 1, &blender2a_r[0], &blender2a_g[0], &blender2a_b[0],
-        &blender2b_a[0], other_modes.blend_m2a_0, other_modes.blend_m2b_0);
-    SET_BLENDER_INPUT(
-        1, 0, &blender1a_r[1], &blender1a_g[1], &blender1a_b[1],
-        &blender1b_a[1], other_modes.blend_m1a_1, other_modes.blend_m1b_1);
-    SET_BLENDER_INPUT(
-        1, 1, &blender2a_r[1], &blender2a_g[1], &blender2a_b[1],
-        &blender2b_a[1], other_modes.blend_m2a_1, other_modes.blend_m2b_1);
+    blender_inputs_set = 1;
+    update_blender_inputs();
 
     other_modes.f.stalederivs = 1;
 }
@@ -9347,39 +10372,8 @@ static void set_combine(uint32_t w1, uint32_t w2)
     combine.sub_b_a1   = (w2 & 0x00000038) >>  3;
     combine.add_a1     = (w2 & 0x00000007) >>  0;
 
-    SET_SUBA_RGB_INPUT(
-        &combiner_rgbsub_a_r[0], &combiner_rgbsub_a_g[0],
-        &combiner_rgbsub_a_b[0], combine.sub_a_rgb0);
-    SET_SUBB_RGB_INPUT(
-        &combiner_rgbsub_b_r[0], &combiner_rgbsub_b_g[0],
-        &combiner_rgbsub_b_b[0], combine.sub_b_rgb0);
-    SET_MUL_RGB_INPUT(
-        &combiner_rgbmul_r[0], &combiner_rgbmul_g[0], &combiner_rgbmul_b[0],
-        combine.mul_rgb0);
-    SET_ADD_RGB_INPUT(
-        &combiner_rgbadd_r[0], &combiner_rgbadd_g[0], &combiner_rgbadd_b[0],
-        combine.add_rgb0);
-    SET_SUB_ALPHA_INPUT(&combiner_alphasub_a[0], combine.sub_a_a0);
-    SET_SUB_ALPHA_INPUT(&combiner_alphasub_b[0], combine.sub_b_a0);
-    SET_MUL_ALPHA_INPUT(&combiner_alphamul[0], combine.mul_a0);
-    SET_SUB_ALPHA_INPUT(&combiner_alphaadd[0], combine.add_a0);
-
-    SET_SUBA_RGB_INPUT(
-        &combiner_rgbsub_a_r[1], &combiner_rgbsub_a_g[1],
-        &combiner_rgbsub_a_b[1], combine.sub_a_rgb1);
-    SET_SUBB_RGB_INPUT(
-        &combiner_rgbsub_b_r[1], &combiner_rgbsub_b_g[1],
-        &combiner_rgbsub_b_b[1], combine.sub_b_rgb1);
-    SET_MUL_RGB_INPUT(
-        &combiner_rgbmul_r[1], &combiner_rgbmul_g[1], &combiner_rgbmul_b[1],
-        combine.mul_rgb1);
-    SET_ADD_RGB_INPUT(
-        &combiner_rgbadd_r[1], &combiner_rgbadd_g[1], &combiner_rgbadd_b[1],
-        combine.add_rgb1);
-    SET_SUB_ALPHA_INPUT(&combiner_alphasub_a[1], combine.sub_a_a1);
-    SET_SUB_ALPHA_INPUT(&combiner_alphasub_b[1], combine.sub_b_a1);
-    SET_MUL_ALPHA_INPUT(&combiner_alphamul[1], combine.mul_a1);
-    SET_SUB_ALPHA_INPUT(&combiner_alphaadd[1], combine.add_a1);
+    combiner_inputs_set = 1;
+    update_combiner_inputs();
 
     other_modes.f.stalederivs = 1;
 }
@@ -9408,6 +10402,10 @@ static void set_color_image(uint32_t w1, uint32_t w2)
     fb_address = (w2 & 0x03FFFFFF) >> ( 0 -  0);
     ++fb_width;
  /* fb_address &= 0x00FFFFFF; */
+#ifdef RDP_ASYNC
+    if (rdp_async_running)
+        rdp_async_note_color_image();
+#endif
 }
 
 
@@ -159,14 +159,24 @@ void angrylionViWidthChanged (void)
 
 void angrylionFBWrite(unsigned int addr, unsigned int size)
 {
+    rdp_wait_idle();
 }
 
 void angrylionFBRead(unsigned int addr)
 {
+    rdp_wait_idle();
+}
+
+void angrylionSetRdramWriteMap(unsigned char *map)
+{
+    rdp_wait_idle();
+    rdram_written = map;
 }
 
 void angrylionFBGetFrameBufferInfo(void *pinfo)
 {
+    /* only reports color images while the RDP runs asynchronously */
+    rdp_get_framebuffer_info((uint32_t*)pinfo, 6); /* FB_INFOS_COUNT */
 }
 
 m64p_error angrylionPluginGetVersion(m64p_plugin_type *PluginType, int *PluginVersion, int *APIVersion, const char **PluginNamePtr, int *Capabilities)
@@ -90,6 +90,8 @@ onetime onetimewarnings;
 
 uint8_t* rdram_8;
 uint16_t* rdram_16;
+static uint8_t rdram_written_unused[0x800];
+uint8_t* rdram_written = rdram_written_unused;
 uint32_t plim;
 uint32_t idxlim16;
 uint32_t idxlim32;
@@ -102,12 +104,46 @@ int32_t oldvstart = 1337;
 
 int overlay = 0;
 
+extern uint32_t *blitter_buf;
 extern uint32_t *blitter_buf_lock;
+extern unsigned int screen_width, screen_height;
+extern uint32_t screen_pitch;
 
 static uint32_t tvfadeoutstate[625];
 static uint32_t brightness = 0;
 static uint32_t prevwasblank = 0;
 
+/*
+ * Scanout goes either to the core's blitter_buf or straight into a buffer
+ * handed out by the frontend (GET_CURRENT_SOFTWARE_FRAMEBUFFER), which
+ * saves video_cb a full frame copy.  For blitter_buf we remember which
+ * lines are already blank and which border strips were cleared, so that
+ * only what changed since it was last drawn into is cleared again.  A
+ * frontend buffer may be another one, or may have been written to by the
+ * frontend, on every request, so nothing is assumed about its contents.
+ */
+enum
+{
+    VI_LINE_UNKNOWN = 0, /* not known to hold the previous frame */
+    VI_LINE_BLANK,       /* the whole line is black */
+    VI_LINE_IMAGE
+};
+
+struct vi_target
+{
+    uint32_t *buf;
+    size_t pitch;     /* in pixels */
+    int lines;
+    int h_start;      /* border geometry last cleared, -1 if none */
+    int h_end;
+    int vactivelines;
+    uint8_t line_state[PRESCALE_HEIGHT];
+};
+
+static struct vi_target vi_blitter;
+static struct vi_target vi_frontend;
+static struct vi_target *vi_last;
+
 STRICTINLINE static void video_filter16(
     int* r, int* g, int* b, uint32_t fboffset, uint32_t num, uint32_t hres,
     uint32_t centercvg);
@@ -197,8 +233,83 @@ void lookup_cvmask_derivatives(uint32_t mask, uint8_t* offx, uint8_t* offy, uint
     *offy = temp.yoff;
 }
 
+static void vi_target_reset(
+    struct vi_target *t, uint32_t *buf, size_t pitch, int lines)
+{
+    t->buf     = buf;
+    t->pitch   = pitch;
+    t->lines   = lines;
+    t->h_start = -1;
+    memset(t->line_state, VI_LINE_UNKNOWN, sizeof(t->line_state));
+}
+
+static struct vi_target *vi_blitter_get(void)
+{
+    struct vi_target *t = &vi_blitter;
+    register int i;
+
+    if (t->buf != blitter_buf)
+        vi_target_reset(t, blitter_buf, PRESCALE_WIDTH, PRESCALE_HEIGHT);
+    else if (t != vi_last) /* holds some older frame, not the last one */
+    {
+        for (i = 0; i < t->lines; i++)
+            if (t->line_state[i] == VI_LINE_IMAGE)
+                t->line_state[i] = VI_LINE_UNKNOWN;
+    }
+    return t;
+}
+
+/*
+ * Interlaced output weaves the new field into the previous frame, so it
+ * always goes to blitter_buf, the only buffer known to still hold it.
+ */
+static struct vi_target *vi_select_target(int weave)
+{
+    struct retro_framebuffer fb = {0};
+
+    fb.width        = screen_width;
+    fb.height       = screen_height;
+    fb.access_flags = RETRO_MEMORY_ACCESS_WRITE | RETRO_MEMORY_ACCESS_READ;
+
+    if (!weave
+          && (vi_origin & 0x00FFFFFF)
+          && screen_width == PRESCALE_WIDTH
+          && screen_height <= PRESCALE_HEIGHT
+          && environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &fb)
+          && fb.data
+          && fb.format == RETRO_PIXEL_FORMAT_XRGB8888
+          && fb.pitch >= PRESCALE_WIDTH * sizeof(uint32_t)
+          && !(fb.pitch & 3))
+    {
+       vi_target_reset(&vi_frontend, (uint32_t*)fb.data, fb.pitch >> 2, screen_height);
+       return &vi_frontend;
+    }
+    return vi_blitter_get();
+}
+
+/* Clears [x, x + width) on lines [first, last). */
+static void vi_clear(struct vi_target *t, int first, int last, int x, int width)
+{
+    register int i;
+
+    for (i = first; i < last; i++)
+        memset(&t->buf[i*t->pitch + x], 0, sizeof(uint32_t)*width);
+}
+
+/* Blanks the picture area of a line whose fade-out has run out. */
+static void vi_blank_line(
+    struct vi_target *t, int line, int h_start, int hres, int vactivelines)
+{
+    if (t->line_state[line] == VI_LINE_BLANK)
+        return;
+    memset(&t->buf[line*t->pitch + h_start], 0, sizeof(uint32_t)*hres);
+    if (line < vactivelines) /* the borders are clear as well */
+        t->line_state[line] = VI_LINE_BLANK;
+}
+
 void rdp_update(void)
 {
+    struct vi_target *target;
     uint32_t prescale_ptr;
     uint32_t pix;
     uint8_t cur_cvg;
@@ -213,9 +324,8 @@ void rdp_update(void)
     int serration_pulses;
     int validinterlace;
     int lowerfield;
+    int out_lines;
     register int i, j;
-    extern uint32_t *blitter_buf_lock;
-    struct retro_framebuffer fb = {0};
     const int x_add = *GET_GFX_INFO(VI_X_SCALE_REG) & 0x00000FFF;
     const int v_sync = *GET_GFX_INFO(VI_V_SYNC_REG) & 0x000003FF;
     const int ispal  = (v_sync > 550);
@@ -228,15 +338,12 @@ void rdp_update(void)
     const int vitype = *GET_GFX_INFO(VI_STATUS_REG) & 0x00000003;
     const int pixel_size = sizeof(int32_t);
 
-#if 0
-    fb.width        = PRESCALE_WIDTH;
-    fb.height       = PRESCALE_HEIGHT;
-    fb.access_flags = RETRO_MEMORY_ACCESS_WRITE;
+    rdp_wait_idle(); /* scanout reads the framebuffer */
 
-    if (environ_cb(RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER, &fb)
-          && fb.format == RETRO_PIXEL_FORMAT_XRGB8888)
-       blitter_buf_lock = (uint32_t*)fb.data;
-#endif
+    /* On an early return the last frame is shown again, if that one
+     * went to the frontend's memory, it has to repeat it itself. */
+    if (vi_last && vi_last->buf != blitter_buf)
+       blitter_buf_lock = NULL;
 
 /*
  * initial value (angrylion)
@@ -252,7 +359,6 @@ void rdp_update(void)
     if (validinterlace)
        internal_vi_v_current_line ^= 1;
 
-    line_count = pitchindwords << serration_pulses;
     line_shifter = serration_pulses ^ 1;
 
     hres = delta_x;
@@ -292,17 +398,38 @@ void rdp_update(void)
         return;
     }
     vactivelines >>= line_shifter;
+
+    /* Nothing below the presented lines is drawn */
+    out_lines = (screen_height < PRESCALE_HEIGHT) ? screen_height : PRESCALE_HEIGHT;
+    out_lines >>= line_shifter;
+    if (vactivelines > out_lines)
+        vactivelines = out_lines;
+    if (vres > ((out_lines - lowerfield) >> serration_pulses) - v_start)
+        vres = ((out_lines - lowerfield) >> serration_pulses) - v_start;
+
     validh = (hres >= 0 && h_start >= 0 && h_start < PRESCALE_WIDTH);
     pix = 0;
     cur_cvg = 0;
     if (hres <= 0 || vres <= 0 || (!(vitype & 2) && prevwasblank)) /* early return. */
         return;
 
+    target = vi_select_target(serration_pulses);
+    vi_last = target;
+    blitter_buf_lock = target->buf;
+    pitchindwords = target->pitch;
+    screen_pitch = target->pitch * pixel_size;
+    line_count = pitchindwords << serration_pulses;
+
     if (vitype >> 1 == 0)
     {
         memset(tvfadeoutstate, 0, pixel_size*PRESCALE_HEIGHT);
-        for (i = 0; i < PRESCALE_HEIGHT; i++)
+        for (i = 0; i < target->lines; i++)
+        {
+            if (target->line_state[i] == VI_LINE_BLANK)
+                continue;
             memset(&blitter_buf_lock[i * pitchindwords], 0, pixel_size*PRESCALE_WIDTH);
+            target->line_state[i] = VI_LINE_BLANK;
+        }
         prevwasblank = 1;
         goto no_frame_buffer;
     }
@@ -320,32 +447,48 @@ void rdp_update(void)
 #endif
 
     prevwasblank = 0;
-    if (h_start > 0 && h_start < PRESCALE_WIDTH)
-        for (i = 0; i < vactivelines; i++)
-            memset(&blitter_buf_lock[i*pitchindwords], 0, pixel_size*h_start);
+    if (target->h_start < 0 || target->vactivelines != vactivelines)
+    {
+        if (h_start > 0 && h_start < PRESCALE_WIDTH)
+            vi_clear(target, 0, vactivelines, 0, h_start);
+
+        if (h_end >= 0 && h_end < PRESCALE_WIDTH)
+            vi_clear(target, 0, vactivelines, h_end, hrightblank);
+    }
+    else /* only where the picture has moved away from */
+    {
+        if (h_start > target->h_start)
+            vi_clear(target, 0, vactivelines, target->h_start, h_start - target->h_start);
 
-    if (h_end >= 0 && h_end < PRESCALE_WIDTH)
-        for (i = 0; i < vactivelines; i++)
-            memset(&blitter_buf_lock[i*pitchindwords + h_end], 0, pixel_size*hrightblank);
+        if (h_end < target->h_end)
+            vi_clear(target, 0, vactivelines, h_end, target->h_end - h_end);
+    }
+    target->h_start      = h_start;
+    target->h_end        = h_end;
+    target->vactivelines = vactivelines;
 
     for (i = 0; i < (v_start << two_lines) + lowerfield; i++)
     {
         tvfadeoutstate[i] >>= 1;
         if (~tvfadeoutstate[i] & validh)
-            memset(&blitter_buf_lock[i*pitchindwords + h_start], 0, pixel_size*hres);
+            vi_blank_line(target, i, h_start, hres, vactivelines);
     }
 
     if (serration_pulses == 0)
         for (j = 0; j < vres; j++)
+        {
+            target->line_state[i] = VI_LINE_IMAGE;
             tvfadeoutstate[i++] = 2;
+        }
     else
         for (j = 0; j < vres; j++)
         {
+            target->line_state[i] = VI_LINE_IMAGE;
             tvfadeoutstate[i] = 2;
             ++i;
             tvfadeoutstate[i] >>= 1;
             if (~tvfadeoutstate[i] & validh)
-                memset(&blitter_buf_lock[i*pitchindwords + h_start], 0, pixel_size*hres);
+                vi_blank_line(target, i, h_start, hres, vactivelines);
             ++i;
         }
 
@@ -353,10 +496,19 @@ void rdp_update(void)
     {
         tvfadeoutstate[i] >>= 1;
         if (~tvfadeoutstate[i] & validh)
-            memset(&blitter_buf_lock[i*pitchindwords + h_start], 0, pixel_size*hres);
+            vi_blank_line(target, i, h_start, hres, vactivelines);
         ++i;
     }
 
+    /* Lines left over from some older frame are not shown */
+    for (i = 0; i < out_lines; i++)
+    {
+        if (target->line_state[i] != VI_LINE_UNKNOWN)
+            continue;
+        memset(&blitter_buf_lock[i*pitchindwords], 0, pixel_size*PRESCALE_WIDTH);
+        target->line_state[i] = VI_LINE_BLANK;
+    }
+
     prescale_ptr =
         (v_start * line_count) + h_start + (lowerfield ? pitchindwords : 0);
     do_frame_buffer[overlay](
@@ -372,16 +524,25 @@ no_frame_buffer:
         cur_line = 240 - 1;
         while (cur_line >= 0)
         {
-            memcpy(
-                &blitter_buf_lock[2*PRESCALE_WIDTH*cur_line + PRESCALE_WIDTH],
-                &blitter_buf_lock[1*PRESCALE_WIDTH*cur_line],
-                4 * PRESCALE_WIDTH
-            );
-            memcpy(
-                &blitter_buf_lock[2*PRESCALE_WIDTH*cur_line + 0],
-                &blitter_buf_lock[1*PRESCALE_WIDTH*cur_line],
-                4 * PRESCALE_WIDTH
-            );
+            uint8_t state = target->line_state[cur_line];
+
+            if (state != VI_LINE_BLANK
+                  || target->line_state[2*cur_line + 0] != VI_LINE_BLANK
+                  || target->line_state[2*cur_line + 1] != VI_LINE_BLANK)
+            {
+                memcpy(
+                    &blitter_buf_lock[2*pitchindwords*cur_line + pitchindwords],
+                    &blitter_buf_lock[1*pitchindwords*cur_line],
+                    4 * PRESCALE_WIDTH
+                );
+                memcpy(
+                    &blitter_buf_lock[2*pitchindwords*cur_line + 0],
+                    &blitter_buf_lock[1*pitchindwords*cur_line],
+                    4 * PRESCALE_WIDTH
+                );
+            }
+            target->line_state[2*cur_line + 1] = state;
+            target->line_state[2*cur_line + 0] = state;
             --cur_line;
         }
     }
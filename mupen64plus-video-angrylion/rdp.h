@@ -37,19 +37,21 @@ INLINE extern __m128i mm_mullo_epi32_seh(__m128i dest, __m128i src);
 }
 
 #if defined(_AMD64_) || defined(_IA64_) || defined(__x86_64__)
-#define BUFFERFIFO(word, base, offset) { \
-    *(int64_t *)&cmd_data[word] = *(int64_t *)((base) + 8*(offset)); \
+#define BUFFERFIFO_TO(fifo, word, base, offset) { \
+    *(int64_t *)&(fifo)[word] = *(int64_t *)((base) + 8*(offset)); \
 }
 #else
 /*
  * compatibility fallback to prevent unspecified behavior from the ANSI C
  * specifications (reading unions per 32 bits when 64 bits were just written)
  */
-#define BUFFERFIFO(word, base, offset) { \
-    cmd_data[word].W32[0] = *(int32_t *)((base) + 8*(offset) + 0); \
-    cmd_data[word].W32[1] = *(int32_t *)((base) + 8*(offset) + 4); \
+#define BUFFERFIFO_TO(fifo, word, base, offset) { \
+    (fifo)[word].W32[0] = *(int32_t *)((base) + 8*(offset) + 0); \
+    (fifo)[word].W32[1] = *(int32_t *)((base) + 8*(offset) + 4); \
 }
 #endif
+#define BUFFERFIFO(word, base, offset) \
+    BUFFERFIFO_TO(cmd_data, word, base, offset)
 
 #ifdef USE_SSE_SUPPORT
 typedef __m128i     v8;
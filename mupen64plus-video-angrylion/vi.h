@@ -37,6 +37,8 @@ extern int32_t pitchindwords;
 
 extern uint8_t* rdram_8;
 extern uint16_t* rdram_16;
+/* one byte per 4KB RDRAM page, set when the RDP writes it */
+extern uint8_t* rdram_written;
 extern uint32_t plim;
 extern uint32_t idxlim16;
 extern uint32_t idxlim32;
@@ -60,4 +62,9 @@ extern void rdp_init(void);
 extern void rdp_close(void);
 extern void rdp_update(void);
 
+/* Waits for queued RDP work in asynchronous mode, no-op otherwise. */
+extern void rdp_wait_idle(void);
+/* Fills count {addr, size, width, height} records (FrameBufferInfo layout). */
+extern void rdp_get_framebuffer_info(uint32_t *info, unsigned count);
+
 #endif
@@ -128,9 +128,9 @@
 #define RREADIDX16(rdst, in) {(in) &= (RDRAM_MASK >> 1); (rdst) = ((in) <= idxlim16) ? (rdram_16[(in) ^ WORD_ADDR_XOR]) : 0;}
 #define RREADIDX32(rdst, in) {(in) &= (RDRAM_MASK >> 2); (rdst) = ((in) <= idxlim32) ? (rdram[(in)]) : 0;}
 
-#define RWRITEADDR8(in, val)	{(in) &= RDRAM_MASK; if ((in) <= plim) rdram_8[(in) ^ BYTE_ADDR_XOR] = (val);}
-#define RWRITEIDX16(in, val)	{(in) &= (RDRAM_MASK >> 1); if ((in) <= idxlim16) rdram_16[(in) ^ WORD_ADDR_XOR] = (val);}
-#define RWRITEIDX32(in, val)	{(in) &= (RDRAM_MASK >> 2); if ((in) <= idxlim32) rdram[(in)] = (val);}
+#define RWRITEADDR8(in, val)	{(in) &= RDRAM_MASK; if ((in) <= plim) {rdram_8[(in) ^ BYTE_ADDR_XOR] = (val); rdram_written[(in) >> 12] = 1;}}
+#define RWRITEIDX16(in, val)	{(in) &= (RDRAM_MASK >> 1); if ((in) <= idxlim16) {rdram_16[(in) ^ WORD_ADDR_XOR] = (val); rdram_written[(in) >> 11] = 1;}}
+#define RWRITEIDX32(in, val)	{(in) &= (RDRAM_MASK >> 2); if ((in) <= idxlim32) {rdram[(in)] = (val); rdram_written[(in) >> 10] = 1;}}
 
 #define PAIRREAD16(rdst, hdst, in) {             \
    (in) &= (RDRAM_MASK >> 1);			             \
@@ -1,5 +1,7 @@
 #include <stdint.h>
 
+#include "../../libretro/texture_hash.h"
+
 #define CRC32_POLYNOMIAL     0x04C11DB7
 
 unsigned int CRCTable[ 256 ];
@@ -33,14 +35,7 @@ void CRC_BuildTable()
 
 uint32_t CRC_Calculate( uint32_t crc, const void * buffer, uint32_t count )
 {
-	uint8_t *p;
-	uint32_t orig = crc;
-
-	p = (uint8_t*) buffer;
-	while (count--)
-		crc = (crc >> 8) ^ CRCTable[(crc & 0xFF) ^ *p++];
-
-	return crc ^ orig;
+	return texture_hash_crc32(crc, buffer, count) ^ crc;
 }
 
 uint32_t CRC_CalculatePalette(uint32_t crc, const void * buffer, uint32_t count )
@@ -2,7 +2,7 @@
 
 void CRC_BuildTable();
 
-// CRC32
+// CRC32, exact value is relied on (e.g. microcode detection)
 uint32_t CRC_Calculate( uint32_t crc, const void *buffer, uint32_t count );
 uint32_t CRC_CalculatePalette( uint32_t crc, const void *buffer, uint32_t count );
 // Fast checksum calculation from Glide64
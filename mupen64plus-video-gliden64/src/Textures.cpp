@@ -16,6 +16,7 @@
 #include "FrameBuffer.h"
 #include "Config.h"
 #include "GLideNHQ/Ext_TxFilter.h"
+#include "../../libretro/texture_hash.h"
 
 using namespace std;
 
@@ -462,6 +463,111 @@ void TextureCache::_initDummyTexture(CachedTexture * _pDummy)
 	_pDummy->tMem = 0;
 }
 
+CachedTexture * TextureMap::find(uint32_t _key) const
+{
+	const size_t mask = m_slots.size() - 1;
+	for (size_t i = _home(_key); m_slots[i].texture != NULL; i = (i + 1) & mask) {
+		if (m_slots[i].key == _key)
+			return m_slots[i].texture;
+	}
+	return NULL;
+}
+
+void TextureMap::_grow()
+{
+	std::vector<Slot> slots(m_slots.size() * 2);
+	m_slots.swap(slots);
+	const size_t mask = m_slots.size() - 1;
+	for (std::vector<Slot>::const_iterator iter = slots.cbegin(); iter != slots.cend(); ++iter) {
+		if (iter->texture == NULL)
+			continue;
+		size_t i = _home(iter->key);
+		while (m_slots[i].texture != NULL)
+			i = (i + 1) & mask;
+		m_slots[i] = *iter;
+	}
+}
+
+void TextureMap::insert(uint32_t _key, CachedTexture * _pTexture)
+{
+	if ((m_count + 1) * 2 > m_slots.size())
+		_grow();
+
+	const size_t mask = m_slots.size() - 1;
+	size_t i = _home(_key);
+	while (m_slots[i].texture != NULL) {
+		if (m_slots[i].key == _key) {
+			m_slots[i].texture = _pTexture;
+			return;
+		}
+		i = (i + 1) & mask;
+	}
+	m_slots[i].key = _key;
+	m_slots[i].texture = _pTexture;
+	++m_count;
+}
+
+void TextureMap::erase(uint32_t _key)
+{
+	const size_t mask = m_slots.size() - 1;
+	size_t i = _home(_key);
+	while (m_slots[i].texture != NULL && m_slots[i].key != _key)
+		i = (i + 1) & mask;
+	if (m_slots[i].texture == NULL)
+		return;
+
+	// Shift following entries back so probing never needs tombstones
+	for (size_t j = (i + 1) & mask; m_slots[j].texture != NULL; j = (j + 1) & mask) {
+		const size_t home = _home(m_slots[j].key);
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			m_slots[i] = m_slots[j];
+			i = j;
+		}
+	}
+	m_slots[i] = Slot();
+	--m_count;
+}
+
+void TextureMap::clear()
+{
+	std::fill(m_slots.begin(), m_slots.end(), Slot());
+	m_count = 0;
+}
+
+void TextureCache::_lruUnlink(CachedTexture * _pTexture)
+{
+	if (_pTexture->lruPrev != NULL)
+		_pTexture->lruPrev->lruNext = _pTexture->lruNext;
+	else
+		m_pLruHead = _pTexture->lruNext;
+	if (_pTexture->lruNext != NULL)
+		_pTexture->lruNext->lruPrev = _pTexture->lruPrev;
+	else
+		m_pLruTail = _pTexture->lruPrev;
+	_pTexture->lruPrev = _pTexture->lruNext = NULL;
+}
+
+void TextureCache::_lruPushFront(CachedTexture * _pTexture)
+{
+	_pTexture->lruPrev = NULL;
+	_pTexture->lruNext = m_pLruHead;
+	if (m_pLruHead != NULL)
+		m_pLruHead->lruPrev = _pTexture;
+	else
+		m_pLruTail = _pTexture;
+	m_pLruHead = _pTexture;
+}
+
+CachedTexture * TextureCache::_findTexture(uint32_t _crc32)
+{
+	CachedTexture * pTexture = m_textures.find(_crc32);
+	if (pTexture != NULL && pTexture != m_pLruHead) {
+		_lruUnlink(pTexture);
+		_lruPushFront(pTexture);
+	}
+	return pTexture;
+}
+
 void TextureCache::init()
 {
 	m_maxBytes = config.texture.maxBytes;
@@ -507,13 +613,12 @@ void TextureCache::destroy()
 {
 	current[0] = current[1] = NULL;
 
-	for (Textures::const_iterator cur = m_textures.cbegin(); cur != m_textures.cend(); ++cur)
-		glDeleteTextures( 1, &cur->glName );
-	m_textures.clear();
-	m_lruTextureLocations.clear();
+	_clear();
 
-	for (FBTextures::const_iterator cur = m_fbTextures.cbegin(); cur != m_fbTextures.cend(); ++cur)
-		glDeleteTextures( 1, &cur->second.glName );
+	m_fbTextures.forEach([](CachedTexture * _pTexture) {
+		glDeleteTextures( 1, &_pTexture->glName );
+		delete _pTexture;
+	});
 	m_fbTextures.clear();
 
 	m_cachedBytes = 0;
@@ -524,15 +629,19 @@ void TextureCache::_checkCacheSize()
 	if (m_cachedBytes <= m_maxBytes)
 		return;
 
-	Textures::iterator iter = m_textures.end();
-	do {
-		--iter;
-		CachedTexture& tex = *iter;
-		m_cachedBytes -= tex.textureBytes;
-		glDeleteTextures(1, &tex.glName);
-		m_lruTextureLocations.erase(tex.crc);
-	} while (m_cachedBytes > m_maxBytes && iter != m_textures.cbegin());
-	m_textures.erase(iter, m_textures.end());
+	while (m_cachedBytes > m_maxBytes && m_pLruTail != NULL) {
+		CachedTexture * pTexture = m_pLruTail;
+		_lruUnlink(pTexture);
+		m_textures.erase(pTexture->crc);
+		m_cachedBytes -= pTexture->textureBytes;
+		glDeleteTextures(1, &pTexture->glName);
+		if (current[0] == pTexture)
+			current[0] = NULL;
+		if (current[1] == pTexture)
+			current[1] = NULL;
+		delete pTexture;
+		++m_stats.evictions;
+	}
 }
 
 CachedTexture * TextureCache::_addTexture(uint32_t _crc32)
@@ -542,20 +651,20 @@ CachedTexture * TextureCache::_addTexture(uint32_t _crc32)
 	_checkCacheSize();
 	GLuint glName;
 	glGenTextures(1, &glName);
-	m_textures.emplace_front(glName);
-	Textures::iterator new_iter = m_textures.begin();
-	new_iter->crc = _crc32;
-	m_lruTextureLocations.insert(std::pair<uint32_t, Textures::iterator>(_crc32, new_iter));
-	return &(*new_iter);
+	CachedTexture * pTexture = new CachedTexture(glName);
+	pTexture->crc = _crc32;
+	m_textures.insert(_crc32, pTexture);
+	_lruPushFront(pTexture);
+	return pTexture;
 }
 
 void TextureCache::removeFrameBufferTexture(CachedTexture * _pTexture)
 {
-	FBTextures::const_iterator iter = m_fbTextures.find(_pTexture->glName);
-	assert(iter != m_fbTextures.cend());
-	m_cachedBytes -= iter->second.textureBytes;
-	glDeleteTextures( 1, &iter->second.glName );
-	m_fbTextures.erase(iter);
+	assert(m_fbTextures.find(_pTexture->glName) == _pTexture);
+	m_fbTextures.erase(_pTexture->glName);
+	m_cachedBytes -= _pTexture->textureBytes;
+	glDeleteTextures( 1, &_pTexture->glName );
+	delete _pTexture;
 }
 
 CachedTexture * TextureCache::addFrameBufferTexture()
@@ -563,8 +672,9 @@ CachedTexture * TextureCache::addFrameBufferTexture()
 	_checkCacheSize();
 	GLuint glName;
 	glGenTextures(1, &glName);
-	m_fbTextures.emplace(glName, glName);
-	return &m_fbTextures.at(glName);
+	CachedTexture * pTexture = new CachedTexture(glName);
+	m_fbTextures.insert(glName, pTexture);
+	return pTexture;
 }
 
 struct TileSizes
@@ -1144,21 +1254,21 @@ uint32_t _calculateCRC(uint32_t t, const TextureParams & _params)
 
 	const uint64_t *src = (uint64_t*)&TMEM[gSP.textureTile[t]->tmem];
 	uint32_t crc = 0xFFFFFFFF;
-	crc = CRC_Calculate(crc, src, _params.height*lineBytes);
+	crc = texture_hash(crc, src, _params.height*lineBytes);
 
 	if (gSP.textureTile[t]->size == G_IM_SIZ_32b) {
 		src = (uint64_t*)&TMEM[gSP.textureTile[t]->tmem + 256];
-		crc = CRC_Calculate(crc, src, _params.height*lineBytes);
+		crc = texture_hash(crc, src, _params.height*lineBytes);
 	}
 
 	if (gDP.otherMode.textureLUT != G_TT_NONE || gSP.textureTile[t]->format == G_IM_FMT_CI) {
 		if (gSP.textureTile[t]->size == G_IM_SIZ_4b)
-			crc = CRC_Calculate( crc, &gDP.paletteCRC16[gSP.textureTile[t]->palette], 4 );
+			crc = texture_hash( crc, &gDP.paletteCRC16[gSP.textureTile[t]->palette], 4 );
 		else if (gSP.textureTile[t]->size == G_IM_SIZ_8b)
-			crc = CRC_Calculate( crc, &gDP.paletteCRC256, 4 );
+			crc = texture_hash( crc, &gDP.paletteCRC256, 4 );
 	}
 
-	crc = CRC_Calculate(crc, &_params, sizeof(_params));
+	crc = texture_hash(crc, &_params, sizeof(_params));
 
 	return crc;
 }
@@ -1259,23 +1369,21 @@ void TextureCache::_updateBackground()
 	uint32_t numBytes = gSP.bgImage.width * gSP.bgImage.height << gSP.bgImage.size >> 1;
 	uint32_t crc;
 
-	crc = CRC_Calculate( 0xFFFFFFFF, &RDRAM[gSP.bgImage.address], numBytes );
+	crc = texture_hash( 0xFFFFFFFF, &RDRAM[gSP.bgImage.address], numBytes );
 
 	if (gDP.otherMode.textureLUT != G_TT_NONE || gSP.bgImage.format == G_IM_FMT_CI) {
 		if (gSP.bgImage.size == G_IM_SIZ_4b)
-			crc = CRC_Calculate( crc, &gDP.paletteCRC16[gSP.bgImage.palette], 4 );
+			crc = texture_hash( crc, &gDP.paletteCRC16[gSP.bgImage.palette], 4 );
 		else if (gSP.bgImage.size == G_IM_SIZ_8b)
-			crc = CRC_Calculate( crc, &gDP.paletteCRC256, 4 );
+			crc = texture_hash( crc, &gDP.paletteCRC256, 4 );
 	}
 
 	uint32_t params[4] = {gSP.bgImage.width, gSP.bgImage.height, gSP.bgImage.format, gSP.bgImage.size};
-	crc = CRC_Calculate(crc, params, sizeof(uint32_t)*4);
+	crc = texture_hash(crc, params, sizeof(uint32_t)*4);
 
-	Texture_Locations::iterator locations_iter = m_lruTextureLocations.find(crc);
-	if (locations_iter != m_lruTextureLocations.end()) {
-		Textures::iterator iter = locations_iter->second;
-		CachedTexture & current = *iter;
-		m_textures.splice(m_textures.begin(), m_textures, iter);
+	CachedTexture * pCached = _findTexture(crc);
+	if (pCached != NULL) {
+		CachedTexture & current = *pCached;
 
 		assert(current.width == gSP.bgImage.width);
 		assert(current.height == gSP.bgImage.height);
@@ -1283,11 +1391,11 @@ void TextureCache::_updateBackground()
 		assert(current.size == gSP.bgImage.size);
 
 		activateTexture(0, &current);
-		m_hits++;
+		m_stats.hits++;
 		return;
 	}
 
-	m_misses++;
+	m_stats.misses++;
 
 	glActiveTexture( GL_TEXTURE0 );
 	CachedTexture * pCurrent = _addTexture(crc);
@@ -1332,6 +1440,7 @@ void TextureCache::_updateBackground()
 	activateTexture(0, pCurrent);
 
 	m_cachedBytes += pCurrent->textureBytes;
+	m_stats.uploadBytes += pCurrent->textureBytes;
 	current[0] = pCurrent;
 }
 
@@ -1339,12 +1448,15 @@ void TextureCache::_clear()
 {
 	current[0] = current[1] = NULL;
 
-	for (Textures::const_iterator cur = m_textures.cbegin(); cur != m_textures.cend(); ++cur) {
-		m_cachedBytes -= cur->textureBytes;
-		glDeleteTextures(1, &cur->glName);
+	while (m_pLruHead != NULL) {
+		CachedTexture * pTexture = m_pLruHead;
+		m_pLruHead = pTexture->lruNext;
+		m_cachedBytes -= pTexture->textureBytes;
+		glDeleteTextures(1, &pTexture->glName);
+		delete pTexture;
 	}
+	m_pLruTail = NULL;
 	m_textures.clear();
-	m_lruTextureLocations.clear();
 }
 
 void TextureCache::update(uint32_t _t)
@@ -1431,11 +1543,9 @@ void TextureCache::update(uint32_t _t)
 		return;
 	}
 
-	Texture_Locations::iterator locations_iter = m_lruTextureLocations.find(crc);
-	if (locations_iter != m_lruTextureLocations.end()) {
-		Textures::iterator iter = locations_iter->second;
-		CachedTexture & current = *iter;
-		m_textures.splice(m_textures.begin(), m_textures, iter);
+	CachedTexture * pCached = _findTexture(crc);
+	if (pCached != NULL) {
+		CachedTexture & current = *pCached;
 
 		assert(current.width == sizes.width);
 		assert(current.height == sizes.height);
@@ -1451,11 +1561,11 @@ void TextureCache::update(uint32_t _t)
 		assert(current.size == gSP.textureTile[_t]->size);
 
 		activateTexture(_t, &current);
-		m_hits++;
+		m_stats.hits++;
 		return;
 	}
 
-	m_misses++;
+	m_stats.misses++;
 
 	glActiveTexture( GL_TEXTURE0 + _t );
 
@@ -1505,6 +1615,7 @@ void TextureCache::update(uint32_t _t)
 	activateTexture( _t, pCurrent );
 
 	m_cachedBytes += pCurrent->textureBytes;
+	m_stats.uploadBytes += pCurrent->textureBytes;
 	current[_t] = pCurrent;
 }
 
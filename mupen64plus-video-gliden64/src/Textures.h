@@ -2,8 +2,9 @@
 #define TEXTURES_H
 
 #include <stdint.h>
+#include <string.h>
 
-#include <map>
+#include <vector>
 
 #include "CRC.h"
 #include "convert.h"
@@ -15,7 +16,7 @@ typedef uint32_t (*GetTexelFunc)( uint64_t *src, uint16_t x, uint16_t i, uint8_t
 
 struct CachedTexture
 {
-	CachedTexture(GLuint _glName) : glName(_glName), max_level(0), frameBufferTexture(fbNone) {}
+	CachedTexture(GLuint _glName) : glName(_glName), max_level(0), frameBufferTexture(fbNone), lruPrev(NULL), lruNext(NULL) {}
 
 	GLuint	glName;
 	uint32_t		crc;
@@ -45,6 +46,53 @@ struct CachedTexture
 		fbOneSample = 1,
 		fbMultiSample = 2
 	} frameBufferTexture;
+
+	// Intrusive LRU links, owned by TextureCache
+	CachedTexture * lruPrev;
+	CachedTexture * lruNext;
+};
+
+struct TextureCacheStats
+{
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint64_t uploadBytes;
+};
+
+// Open addressing hash map from a 32-bit key to a texture.
+// Linear probing with backward shift deletion.
+class TextureMap
+{
+public:
+	TextureMap() : m_slots(256), m_count(0) {}
+
+	CachedTexture * find(uint32_t _key) const;
+	void insert(uint32_t _key, CachedTexture * _pTexture);
+	void erase(uint32_t _key);
+	void clear();
+
+	template <typename F>
+	void forEach(F _func) const
+	{
+		for (std::vector<Slot>::const_iterator iter = m_slots.cbegin(); iter != m_slots.cend(); ++iter)
+			if (iter->texture != NULL)
+				_func(iter->texture);
+	}
+
+private:
+	struct Slot
+	{
+		Slot() : key(0), texture(NULL) {}
+		uint32_t key;
+		CachedTexture * texture;
+	};
+
+	size_t _home(uint32_t _key) const { return (_key * 0x9E3779B1U) & (m_slots.size() - 1); }
+	void _grow();
+
+	std::vector<Slot> m_slots;
+	size_t m_count;
 };
 
 
@@ -61,20 +109,25 @@ struct TextureCache
 	void activateDummy(uint32_t _t);
 	void activateMSDummy(uint32_t _t);
 	void update(uint32_t _t);
+	const TextureCacheStats & getStats() const {return m_stats;}
 
 	static TextureCache & get();
 
 private:
-	TextureCache() : m_pDummy(NULL), m_hits(0), m_misses(0), m_maxBytes(0), m_cachedBytes(0), m_curUnpackAlignment(4), m_toggleDumpTex(false)
+	TextureCache() : m_pLruHead(NULL), m_pLruTail(NULL), m_pDummy(NULL), m_maxBytes(0), m_cachedBytes(0), m_curUnpackAlignment(4), m_toggleDumpTex(false)
 	{
 		current[0] = NULL;
 		current[1] = NULL;
+		memset(&m_stats, 0, sizeof(m_stats));
 		CRC_BuildTable();
 	}
 	TextureCache(const TextureCache &);
 
 	void _checkCacheSize();
 	CachedTexture * _addTexture(uint32_t _crc32);
+	CachedTexture * _findTexture(uint32_t _crc32);
+	void _lruUnlink(CachedTexture * _pTexture);
+	void _lruPushFront(CachedTexture * _pTexture);
 	void _load(uint32_t _tile, CachedTexture *_pTexture);
 	bool _loadHiresTexture(uint32_t _tile, CachedTexture *_pTexture, uint64_t & _ricecrc);
 	void _loadBackground(CachedTexture *pTexture);
@@ -84,15 +137,13 @@ private:
 	void _initDummyTexture(CachedTexture * _pDummy);
 	void _getTextureDestData(CachedTexture& tmptex, uint32_t* pDest, GLuint glInternalFormat, GetTexelFunc GetTexel, uint16_t* pLine);
 
-	typedef std::list<CachedTexture> Textures;
-	typedef std::map<uint32_t, Textures::iterator> Texture_Locations;
-	typedef std::map<uint32_t, CachedTexture> FBTextures;
-	Textures m_textures;
-	Texture_Locations m_lruTextureLocations;
-	FBTextures m_fbTextures;
+	TextureMap m_textures;              // keyed by crc
+	CachedTexture * m_pLruHead;         // most recently used
+	CachedTexture * m_pLruTail;
+	TextureMap m_fbTextures;            // keyed by glName
 	CachedTexture * m_pDummy;
 	CachedTexture * m_pMSDummy;
-	uint32_t m_hits, m_misses;
+	TextureCacheStats m_stats;
 	uint32_t m_maxBytes;
 	uint32_t m_cachedBytes;
 	GLint m_curUnpackAlignment;
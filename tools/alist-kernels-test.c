@@ -0,0 +1,260 @@
+/* alist-kernels-test
+ * Checks that the SIMD audio list kernels of mupen64plus-rsp-hle
+ * (alist_kernels.c) give bit-exact results with the scalar ones, on
+ * random inputs: every kernel runs on the same random buffers (including
+ * overlapping and unaligned ones and saturating values) through both
+ * implementations, and the outputs are compared.
+ *
+ * usage: alist-kernels-test [seed [iterations]]
+ * Prints each mismatch and exits with a non-zero status if any occurred.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* the kernels are static, build them here along with the scalar ones */
+#define CHECK_ALIST_KERNELS
+#include "alist_kernels.c"
+
+void HleVerboseMessage(void* user_defined, const char *message, ...) { (void)user_defined; (void)message; }
+void HleWarnMessage(void* user_defined, const char *message, ...) { (void)user_defined; (void)message; }
+
+#if defined(ALIST_KERNELS_SSE2) || defined(ALIST_KERNELS_NEON)
+
+static int failures;
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+	/* xorshift32 */
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+/* mostly random, with a fair share of the values saturation depends on */
+static int16_t random_s16(void)
+{
+	static const int16_t edges[] = { 0, 1, -1, 0x7fff, -0x8000, 0x4000, -0x4000 };
+	uint32_t r = rng();
+
+	if ((r & 7) == 0)
+		return edges[(r >> 3) % (sizeof(edges) / sizeof(edges[0]))];
+
+	return (int16_t)(r >> 16);
+}
+
+static void random_fill(int16_t* buffer, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; ++i)
+		buffer[i] = random_s16();
+}
+
+static void report(const char* kernel, unsigned iteration)
+{
+	printf("%s: %s mismatch at iteration %u\n", kernel, simd_kernels.name, iteration);
+	++failures;
+}
+
+#define BUFFER_SIZE 0x1000
+
+static void test_mix(unsigned iteration)
+{
+	static int16_t expected[BUFFER_SIZE], result[BUFFER_SIZE];
+	size_t count = rng() % 0x800;
+	size_t dst = rng() % (BUFFER_SIZE - count);
+	size_t src = rng() % (BUFFER_SIZE - count);
+	int16_t gain = random_s16();
+
+	/* also close overlaps, which the SIMD kernel has to spot */
+	if ((rng() & 3) == 0)
+	{
+		src = dst + (rng() % 17) - 8;
+		if (src > BUFFER_SIZE - count)
+			src = dst;
+	}
+
+	random_fill(expected, BUFFER_SIZE);
+	memcpy(result, expected, sizeof(result));
+
+	scalar_kernels.mix(expected + dst, expected + src, count, gain);
+	simd_kernels.mix(result + dst, result + src, count, gain);
+
+	if (memcmp(expected, result, sizeof(result)) != 0)
+		report("mix", iteration);
+}
+
+/* picks n + 1 blocks of 8 samples: dst[0..n-1], then in */
+static void random_blocks(size_t* offsets, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i <= n; ++i)
+	{
+		/* a small buffer now and then, so that blocks overlap */
+		size_t range = (rng() & 3) ? BUFFER_SIZE - 8 : 24;
+		offsets[i] = rng() % range;
+	}
+}
+
+static void test_envmix8(unsigned iteration)
+{
+	static int16_t expected[BUFFER_SIZE], result[BUFFER_SIZE];
+	int16_t l_vol[8], r_vol[8];
+	int16_t* expected_dst[4];
+	int16_t* result_dst[4];
+	size_t offsets[5];
+	size_t n = 1 + rng() % 4;
+	int16_t dry = random_s16(), wet = random_s16();
+	size_t i;
+
+	random_blocks(offsets, n);
+	random_fill(l_vol, 8);
+	random_fill(r_vol, 8);
+	random_fill(expected, BUFFER_SIZE);
+	memcpy(result, expected, sizeof(result));
+
+	for (i = 0; i < n; ++i)
+	{
+		expected_dst[i] = expected + offsets[i];
+		result_dst[i] = result + offsets[i];
+	}
+
+	scalar_kernels.envmix8(expected_dst, n, expected + offsets[n], l_vol, r_vol, dry, wet);
+	simd_kernels.envmix8(result_dst, n, result + offsets[n], l_vol, r_vol, dry, wet);
+
+	if (memcmp(expected, result, sizeof(result)) != 0)
+		report("envmix8", iteration);
+}
+
+static void test_envmix_nead8(unsigned iteration)
+{
+	static int16_t expected[BUFFER_SIZE], result[BUFFER_SIZE];
+	uint16_t env_values[3];
+	int16_t xors[4];
+	int16_t* expected_dst[4];
+	int16_t* result_dst[4];
+	size_t offsets[5];
+	size_t i;
+
+	random_blocks(offsets, 4);
+	for (i = 0; i < 3; ++i)
+		env_values[i] = (uint16_t)random_s16();
+	for (i = 0; i < 4; ++i)
+		xors[i] = (rng() & 1) ? -1 : random_s16();
+	random_fill(expected, BUFFER_SIZE);
+	memcpy(result, expected, sizeof(result));
+
+	for (i = 0; i < 4; ++i)
+	{
+		expected_dst[i] = expected + offsets[i];
+		result_dst[i] = result + offsets[i];
+	}
+
+	scalar_kernels.envmix_nead8(expected_dst, expected + offsets[4], env_values, xors);
+	simd_kernels.envmix_nead8(result_dst, result + offsets[4], env_values, xors);
+
+	if (memcmp(expected, result, sizeof(result)) != 0)
+		report("envmix_nead8", iteration);
+}
+
+static void test_filter8(unsigned iteration)
+{
+	int16_t src[8], c1[8], c2[8], c3[8];
+	int16_t expected[8], result[8];
+	int16_t l1 = random_s16(), l2 = random_s16();
+	uint16_t scale;
+	unsigned shift;
+
+	/* the adpcm residuals and polef uses, then anything */
+	switch (rng() % 3)
+	{
+	case 0: scale = 1 << 11; shift = 11; break;
+	case 1: scale = (uint16_t)random_s16(); shift = 14; break;
+	default: scale = (uint16_t)random_s16(); shift = rng() % 17; break;
+	}
+
+	random_fill(src, 8);
+	random_fill(c1, 8);
+	random_fill(c2, 8);
+	random_fill(c3, 8);
+
+	scalar_kernels.filter8(expected, src, scale, c1, c2, c3, l1, l2, shift);
+	simd_kernels.filter8(result, src, scale, c1, c2, c3, l1, l2, shift);
+
+	if (memcmp(expected, result, sizeof(result)) != 0)
+		report("filter8", iteration);
+}
+
+/* the alist buffer is addressed with 16-bit positions, and the taps may
+ * read 3 samples past the last one */
+#define SAMPLES_SIZE (0x10000 + 8)
+
+static void test_resample(unsigned iteration)
+{
+	static int16_t expected[SAMPLES_SIZE], result[SAMPLES_SIZE];
+	uint16_t opos = (uint16_t)rng();
+	uint16_t expected_ipos = (uint16_t)rng(), result_ipos;
+	uint32_t expected_accu = rng() & 0xffff, result_accu;
+	uint32_t pitch = rng() % 0x40000;
+	unsigned count = rng() % 0x200;
+
+	/* output right behind or within the taps now and then */
+	if ((rng() & 3) == 0)
+		opos = expected_ipos + (rng() % 9) - 4;
+
+	result_ipos = expected_ipos;
+	result_accu = expected_accu;
+	random_fill(expected, SAMPLES_SIZE);
+	memcpy(result, expected, sizeof(result));
+
+	scalar_kernels.resample(expected, opos, &expected_ipos, &expected_accu, pitch, count);
+	simd_kernels.resample(result, opos, &result_ipos, &result_accu, pitch, count);
+
+	if (memcmp(expected, result, sizeof(result)) != 0
+	 || expected_ipos != result_ipos || expected_accu != result_accu)
+		report("resample", iteration);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned seed = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 0) : 0x12345678;
+	unsigned iterations = (argc > 2) ? (unsigned)strtoul(argv[2], NULL, 0) : 20000;
+	unsigned i;
+
+	rng_state = seed ? seed : 1;
+
+	for (i = 0; i < iterations; ++i)
+	{
+		test_mix(i);
+		test_envmix8(i);
+		test_envmix_nead8(i);
+		test_filter8(i);
+		test_resample(i);
+	}
+
+	if (failures)
+	{
+		printf("%d mismatches (seed 0x%x)\n", failures, seed);
+		return 1;
+	}
+
+	printf("%s kernels match the scalar ones, %u iterations\n", simd_kernels.name, iterations);
+	return 0;
+}
+
+#else
+
+int main(void)
+{
+	printf("no SIMD alist kernels on this target, nothing to check\n");
+	return 0;
+}
+
+#endif
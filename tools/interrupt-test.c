@@ -0,0 +1,188 @@
+/* interrupt-test
+ * Exercises the interrupt queue of mupen64plus-core/src/r4300/interupt.c
+ * on its own: events are scheduled, looked up and removed by type, saved
+ * and reloaded as a savestate would, including events that are already
+ * behind Count when the queue is reloaded.
+ *
+ * usage: interrupt-test
+ * Prints each failed check and exits with a non-zero status if any failed.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "r4300/interupt.h"
+#include "r4300/r4300.h"
+#include "r4300/cp0_private.h"
+#include "main/main.h"
+#include "ai/ai_controller.h"
+#include "pi/pi_controller.h"
+#include "rdp/rdp_core.h"
+#include "rsp/rsp_core.h"
+#include "si/si_controller.h"
+#include "vi/vi_controller.h"
+
+/* normally provided by the rest of the core, interupt.c only needs them
+ * to link as long as no event handler runs */
+precomp_instr *PC;
+unsigned int count_per_op;
+unsigned int delay_slot;
+unsigned int dyna_interp;
+unsigned int r4300emu;
+uint32_t g_cp0_regs[CP0_REGS_COUNT];
+uint32_t next_interupt;
+uint32_t last_addr;
+uint32_t skip_jump;
+int stop, rompause;
+int reset_hard_job;
+int g_gs_vi_counter;
+struct ai_controller g_ai;
+struct pi_controller g_pi;
+struct si_controller g_si;
+struct vi_controller g_vi;
+struct r4300_core g_r4300;
+struct rdp_core g_dp;
+struct rsp_core g_sp;
+
+void DebugMessage(int level, const char *message, ...) { (void)level; (void)message; }
+int retro_return(int just_flipping) { (void)just_flipping; return 0; }
+void dyna_stop(void) { }
+void free_blocks(void) { }
+void init_blocks(void) { }
+void generic_jump_to(uint32_t address) { (void)address; }
+void r4300_reset_soft(void) { }
+void reset_hard(void) { }
+void exception_general(void) { }
+void ai_end_of_dma_event(struct ai_controller* ai) { (void)ai; }
+void pi_end_of_dma_event(struct pi_controller* pi) { (void)pi; }
+void si_end_of_dma_event(struct si_controller* si) { (void)si; }
+void vi_vertical_interrupt_event(struct vi_controller* vi) { (void)vi; }
+void rdp_interrupt_event(struct rdp_core* dp) { (void)dp; }
+void rsp_interrupt_event(struct rsp_core* sp) { (void)sp; }
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+static void test_lookup(void)
+{
+	g_cp0_regs[CP0_COUNT_REG] = 0;
+	init_interupt();
+
+	add_interupt_event(AI_INT, 300);
+	add_interupt_event(SI_INT, 100);
+	add_interupt_event(PI_INT, 200);
+	add_interupt_event(DP_INT, 400);
+
+	CHECK(get_event(VI_INT) == 5000);
+	CHECK(get_event(AI_INT) == 300);
+	CHECK(get_event(SI_INT) == 100);
+	CHECK(get_event(PI_INT) == 200);
+	CHECK(get_event(DP_INT) == 400);
+	CHECK(get_event(SP_INT) == 0);
+	CHECK(get_next_event_type() == SI_INT);
+	CHECK(next_interupt == 100);
+
+	/* removals reshuffle the heap, lookups must follow */
+	remove_event(SI_INT);
+	CHECK(get_event(SI_INT) == 0);
+	CHECK(get_next_event_type() == PI_INT);
+	remove_event(DP_INT);
+	CHECK(get_event(AI_INT) == 300);
+	CHECK(get_event(PI_INT) == 200);
+	CHECK(get_event(VI_INT) == 5000);
+	remove_event(PI_INT);
+	remove_event(AI_INT);
+	CHECK(get_next_event_type() == VI_INT);
+	CHECK(get_event(VI_INT) == 5000);
+
+	/* a type may only be queued once */
+	add_interupt_event_count(VI_INT, 7000);
+	CHECK(get_event(VI_INT) == 5000);
+}
+
+static void test_reload_overdue(void)
+{
+	char buf[1024];
+	int len;
+
+	g_cp0_regs[CP0_COUNT_REG] = 0x1000;
+	init_interupt();
+	remove_event(VI_INT);
+
+	add_interupt_event_count(AI_INT, 0x1100);
+	add_interupt_event_count(VI_INT, 0x1200);
+	add_interupt_event_count(PI_INT, 0x9000);
+
+	len = save_eventqueue_infos(buf);
+	CHECK(len == 4 * 8 + 4);
+
+	/* Count moved on before the state is loaded again (e.g. a state saved
+	 * with events pending past the current instruction) */
+	g_cp0_regs[CP0_COUNT_REG] = 0x2000;
+	load_eventqueue_infos(buf);
+
+	/* overdue events fire first, in their original order, and not a full
+	 * Count lap later behind SPECIAL_INT */
+	CHECK(get_next_event_type() == AI_INT);
+	CHECK(next_interupt == 0x1100);
+	CHECK(get_event(VI_INT) == 0x1200);
+	CHECK(get_event(PI_INT) == 0x9000);
+	CHECK(get_event(SPECIAL_INT) == 0);
+
+	remove_event(AI_INT);
+	CHECK(get_next_event_type() == VI_INT);
+	remove_event(VI_INT);
+	CHECK(get_next_event_type() == PI_INT);
+	remove_event(PI_INT);
+	CHECK(get_next_event_type() == SPECIAL_INT);
+}
+
+static void test_save_overflow(void)
+{
+	char buf[1024];
+	int i;
+
+	g_cp0_regs[CP0_COUNT_REG] = 0;
+	init_interupt();
+
+	/* unknown types share one index slot, lookups fall back to a scan */
+	for (i = 0; i < EVENTQUEUE_MAX_SAVED_EVENTS - 2; ++i)
+		add_interupt_event(0x10000 + i, 1000 + i);
+
+	CHECK(get_event(0x10000) == 1000);
+	CHECK(get_event(0x10000 + 50) == 1050);
+	remove_event(0x10000 + 50);
+	CHECK(get_event(0x10000 + 50) == 0);
+	CHECK(get_event(0x10000 + 51) == 1051);
+	add_interupt_event(0x10000 + 50, 1050);
+
+	CHECK(save_eventqueue_infos(buf) > 0);
+
+	add_interupt_event(AI_INT, 10);
+	CHECK(save_eventqueue_infos(buf) < 0);
+}
+
+int main(void)
+{
+	test_lookup();
+	test_reload_overdue();
+	test_save_overflow();
+
+	if (failures)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,283 @@
+/* rdp-bench
+ * Replays an RDP dump (RDP_DUMP=<file> with a HAVE_RDP_DUMP=1 build, see
+ * mupen64plus-video-paraLLEl/rdp_dump.c) through the angrylion renderer,
+ * without a frontend or a GL context.
+ *
+ * Every command list in the dump ends at a SYNC_FULL and is reported as a
+ * frame, with the time spent, the pixels drawn and a checksum of the color
+ * image it rendered to.  A per-command summary follows at the end.
+ *
+ * usage: rdp-bench [-t threads] [-q] dump.rdp
+ *     -t  angrylion rendering threads, 0 for one per core (default 1)
+ *     -q  only print the summary
+ */
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z64.h"
+#include "vi.h"
+#include "rdp.h"
+
+#include <libretro.h>
+
+#define DRAM_SIZE (8 * 1024 * 1024)
+
+enum rdp_dump_cmd
+{
+	RDP_DUMP_CMD_INVALID = 0,
+	RDP_DUMP_CMD_UPDATE_DRAM = 1,
+	RDP_DUMP_CMD_BEGIN_COMMAND_LIST = 2,
+	RDP_DUMP_CMD_END_COMMAND_LIST = 3,
+	RDP_DUMP_CMD_RDP_COMMAND = 4,
+	RDP_DUMP_CMD_EOF = 5
+};
+
+/* from n64video.c, built with TRACE_DP_COMMANDS */
+const char *rdp_trace_command_name(int command);
+uint64_t rdp_trace_pixels(void);
+void angrylion_set_threads(unsigned count);
+
+/* normally provided by the core and n64video_main.c */
+GFX_INFO gfx_info;
+RECT __src, __dst;
+int32_t pitchindwords;
+uint32_t *blitter_buf;
+uint32_t *blitter_buf_lock;
+unsigned int screen_width, screen_height;
+uint32_t screen_pitch;
+retro_log_printf_t log_cb;
+retro_environment_t environ_cb;
+
+static uint8_t *dram;
+static uint8_t dmem[0x1000];
+static uint8_t imem[0x1000];
+static uint32_t mi_intr, dpc_start, dpc_end, dpc_current, dpc_status;
+static uint32_t dpc_clock, dpc_bufbusy, dpc_pipebusy, dpc_tmem, vi_reg;
+
+static struct
+{
+	uint64_t count;
+	uint64_t nsec;
+} stats[64];
+
+/* color image, tracked from the command stream */
+static uint32_t fb_addr, fb_width, fb_size, fb_height;
+
+static void check_interrupts(void)
+{
+}
+
+static uint64_t now_nsec(void)
+{
+#if defined(_WIN32)
+	LARGE_INTEGER freq, count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/* FNV-1a over the bytes of the color image */
+static uint64_t fb_checksum(void)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	uint32_t bytes = (fb_width * fb_height << fb_size) >> 1;
+	uint32_t i;
+
+	for (i = 0; i < bytes; i++)
+	{
+		hash ^= dram[(fb_addr + i) & (DRAM_SIZE - 1)];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static int read_u32(FILE *file, uint32_t *value)
+{
+	return fread(value, sizeof(*value), 1, file) == 1;
+}
+
+static void run_command(const uint32_t *words, uint32_t count)
+{
+	const uint32_t command = (words[0] >> 24) & 63;
+	uint64_t start;
+
+	if (command == 0x3f) /* Set_Color_Image */
+	{
+		fb_size  = (words[0] >> 19) & 3;
+		fb_width = (words[0] & 0x3ff) + 1;
+		fb_addr  = words[1] & 0xffffff;
+	}
+	else if (command == 0x2d) /* Set_Scissor */
+		fb_height = (words[1] & 0xfff) >> 2;
+
+	/* feed the command through the XBUS path, as the RSP would */
+	memcpy(dmem, words, count * sizeof(*words));
+	dpc_current = 0;
+	dpc_end = count * sizeof(*words);
+	dpc_status = DP_STATUS_XBUS_DMA;
+
+	start = now_nsec();
+	process_RDP_list();
+	stats[command].nsec += now_nsec() - start;
+	stats[command].count++;
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	int quiet = 0, i;
+	FILE *file;
+	char magic[8];
+	uint32_t dram_size, cmd;
+	uint32_t words[64];
+	unsigned frame = 0;
+	uint64_t frame_start = 0, frame_pixels = 0, frame_commands = 0;
+	uint64_t total_nsec = 0, total_commands = 0;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			angrylion_set_threads(atoi(argv[++i]));
+		else if (!strcmp(argv[i], "-q"))
+			quiet = 1;
+		else
+			path = argv[i];
+	}
+
+	if (!path)
+	{
+		fprintf(stderr, "usage: %s [-t threads] [-q] dump.rdp\n", argv[0]);
+		return 1;
+	}
+
+	file = fopen(path, "rb");
+	if (!file)
+	{
+		fprintf(stderr, "cannot open %s\n", path);
+		return 1;
+	}
+
+	if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, "RDPDUMP1", 8)
+	 || !read_u32(file, &dram_size))
+	{
+		fprintf(stderr, "%s is not an RDP dump\n", path);
+		return 1;
+	}
+
+	dram = (uint8_t*)calloc(1, DRAM_SIZE);
+	if (!dram)
+		return 1;
+
+	gfx_info.RDRAM            = dram;
+	gfx_info.DMEM             = dmem;
+	gfx_info.IMEM             = imem;
+	gfx_info.MI_INTR_REG      = &mi_intr;
+	gfx_info.DPC_START_REG    = &dpc_start;
+	gfx_info.DPC_END_REG      = &dpc_end;
+	gfx_info.DPC_CURRENT_REG  = &dpc_current;
+	gfx_info.DPC_STATUS_REG   = &dpc_status;
+	gfx_info.DPC_CLOCK_REG    = &dpc_clock;
+	gfx_info.DPC_BUFBUSY_REG  = &dpc_bufbusy;
+	gfx_info.DPC_PIPEBUSY_REG = &dpc_pipebusy;
+	gfx_info.DPC_TMEM_REG     = &dpc_tmem;
+	gfx_info.VI_STATUS_REG    = gfx_info.VI_ORIGIN_REG = gfx_info.VI_WIDTH_REG =
+	gfx_info.VI_INTR_REG      = gfx_info.VI_V_CURRENT_LINE_REG =
+	gfx_info.VI_TIMING_REG    = gfx_info.VI_V_SYNC_REG = gfx_info.VI_H_SYNC_REG =
+	gfx_info.VI_LEAP_REG      = gfx_info.VI_H_START_REG = gfx_info.VI_V_START_REG =
+	gfx_info.VI_V_BURST_REG   = gfx_info.VI_X_SCALE_REG = gfx_info.VI_Y_SCALE_REG = &vi_reg;
+	gfx_info.CheckInterrupts  = check_interrupts;
+
+	rdp_init();
+
+	while (read_u32(file, &cmd) && cmd != RDP_DUMP_CMD_EOF)
+	{
+		uint32_t offset, size, command, count;
+
+		switch (cmd)
+		{
+			case RDP_DUMP_CMD_UPDATE_DRAM:
+				if (!read_u32(file, &offset) || !read_u32(file, &size)
+				 || offset > DRAM_SIZE || size > DRAM_SIZE - offset
+				 || fread(dram + offset, 1, size, file) != size)
+					goto truncated;
+				break;
+
+			case RDP_DUMP_CMD_BEGIN_COMMAND_LIST:
+				frame_start = now_nsec();
+				frame_pixels = rdp_trace_pixels();
+				frame_commands = total_commands;
+				break;
+
+			case RDP_DUMP_CMD_END_COMMAND_LIST:
+			{
+				const uint64_t nsec = now_nsec() - frame_start;
+				const uint64_t pixels = rdp_trace_pixels() - frame_pixels;
+
+				total_nsec += nsec;
+				if (!quiet)
+					printf("frame %5u: %6llu commands %9llu pixels %9.3f ms  "
+							"fb %06x %ux%u %2ubpp  checksum %016llx\n",
+							frame, (unsigned long long)(total_commands - frame_commands),
+							(unsigned long long)pixels, nsec / 1e6,
+							fb_addr, fb_width, fb_height, 4u << fb_size,
+							(unsigned long long)fb_checksum());
+				frame++;
+				break;
+			}
+
+			case RDP_DUMP_CMD_RDP_COMMAND:
+				if (!read_u32(file, &command) || !read_u32(file, &count)
+				 || count < 2 || count > 64
+				 || fread(words, sizeof(*words), count, file) != count)
+					goto truncated;
+				run_command(words, count);
+				total_commands++;
+				break;
+
+			default:
+				fprintf(stderr, "unknown dump command %u\n", cmd);
+				goto truncated;
+		}
+	}
+
+	fclose(file);
+	rdp_close();
+
+	printf("\n%u frames, %llu commands, %llu pixels in %.3f ms (%.2f Mpixels/s)\n\n",
+			frame, (unsigned long long)total_commands,
+			(unsigned long long)rdp_trace_pixels(), total_nsec / 1e6,
+			total_nsec ? rdp_trace_pixels() * 1e3 / total_nsec : 0.0);
+
+	printf("command              count     total ms   avg ns\n");
+	for (i = 0; i < 64; i++)
+	{
+		if (!stats[i].count)
+			continue;
+		printf("%s %9llu %12.3f %8llu\n", rdp_trace_command_name(i),
+				(unsigned long long)stats[i].count, stats[i].nsec / 1e6,
+				(unsigned long long)(stats[i].nsec / stats[i].count));
+	}
+
+	free(dram);
+	return 0;
+
+truncated:
+	fprintf(stderr, "%s: truncated or corrupt dump\n", path);
+	fclose(file);
+	free(dram);
+	return 1;
+}
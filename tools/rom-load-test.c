@@ -0,0 +1,190 @@
+/* rom-load-test
+ * Loads a synthetic ROM through mupen64plus-core/src/main/rom.c, once with
+ * open_rom from memory and once with open_rom_file from a .z64, a .v64 and
+ * a .n64 file. Mapped pages are swapped lazily by touch_rom: ranges are
+ * touched in random order and each one has to read back what the copied
+ * image holds, as does the whole ROM once every page was touched.
+ *
+ * usage: rom-load-test
+ * Prints each failed check and exits with a non-zero status if any failed.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "main/main.h"
+#include "main/rom.h"
+#include "main/util.h"
+#include "r4300/r4300.h"
+
+/* normally provided by the rest of the core */
+unsigned int count_per_op;
+unsigned int frame_dupe;
+int g_MemHasBeenBSwapped;
+int g_delay_si;
+
+void DebugMessage(int level, const char *message, ...) { (void)level; (void)message; }
+
+/* not a multiple of the page size, the last page is a partial one */
+#define ROM_SIZE (0x100000 + 0x804)
+#define ROM_PAGES ((ROM_SIZE + (1 << ROM_PAGE_SHIFT) - 1) >> ROM_PAGE_SHIFT)
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+static uint32_t rng = 0x12345678;
+
+static uint32_t next_random(void)
+{
+	rng = rng * 1103515245 + 12345;
+	return rng >> 8;
+}
+
+static unsigned char rom[ROM_SIZE];
+static unsigned char image[ROM_SIZE];
+static unsigned char expected[ROM_SIZE];
+static char expected_md5[33];
+
+/* the ROM as the emulator sees it: open_rom, then the swap done in main.c */
+static void load_reference(void)
+{
+	size_t i;
+
+	rom[0] = 0x80;
+	rom[1] = 0x37;
+	rom[2] = 0x12;
+	rom[3] = 0x40;
+	for (i = 4; i < ROM_SIZE; ++i)
+		rom[i] = (unsigned char)next_random();
+
+	CHECK(open_rom(rom, ROM_SIZE) == M64ERR_SUCCESS);
+	swap_buffer(g_rom, 4, ROM_SIZE / 4);
+	memcpy(expected, g_rom, ROM_SIZE);
+	strcpy(expected_md5, ROM_SETTINGS.MD5);
+	close_rom();
+}
+
+static int write_image(char *path, const char *name, size_t swap)
+{
+	FILE *file;
+	size_t i, j;
+	int fd;
+
+	/* .v64 swaps the bytes of each halfword, .n64 those of each word */
+	for (i = 0; i < ROM_SIZE; i += swap)
+		for (j = 0; j < swap; ++j)
+			image[i + j] = rom[i + swap - 1 - j];
+
+	sprintf(path, "/tmp/rom-load-test-%s-XXXXXX", name);
+	fd = mkstemp(path);
+	if (fd < 0)
+		return 0;
+	close(fd);
+
+	file = fopen(path, "wb");
+	if (file == NULL)
+		return 0;
+	if (fwrite(image, 1, ROM_SIZE, file) != ROM_SIZE)
+	{
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+	return 1;
+}
+
+static void test_image(const char *name, size_t swap)
+{
+	size_t order[ROM_PAGES];
+	char path[64];
+	size_t i;
+
+	if (!write_image(path, name, swap))
+	{
+		printf("%s: couldn't write %s\n", name, path);
+		++failures;
+		return;
+	}
+
+	CHECK(open_rom_file(path) == M64ERR_SUCCESS);
+	if (g_rom == NULL)
+	{
+		remove(path);
+		return;
+	}
+
+	CHECK(g_rom_size == ROM_SIZE);
+	CHECK(g_MemHasBeenBSwapped == 1);
+	CHECK(strcmp(ROM_SETTINGS.MD5, expected_md5) == 0);
+	/* header and boot code are there without touching them */
+	CHECK(memcmp(g_rom, expected, 0x1000) == 0);
+
+	/* touch pages in random order, some ranges straddling two pages */
+	for (i = 0; i < ROM_PAGES; ++i)
+		order[i] = i;
+	for (i = ROM_PAGES - 1; i > 0; --i)
+	{
+		size_t j = next_random() % (i + 1);
+		size_t page = order[i];
+		order[i] = order[j];
+		order[j] = page;
+	}
+
+	for (i = 0; i < ROM_PAGES; ++i)
+	{
+		uint32_t offset = (uint32_t)(order[i] << ROM_PAGE_SHIFT) + (next_random() & 0xffc);
+		size_t length = 4 + (next_random() & 0x1ffc);
+
+		if (offset >= ROM_SIZE)
+			offset = ROM_SIZE - 4;
+
+		touch_rom(offset, length);
+
+		if (length > ROM_SIZE - offset)
+			length = ROM_SIZE - offset;
+		CHECK(memcmp(g_rom + offset, expected + offset, length) == 0);
+
+		/* the first bytes of the page may not be covered by the range */
+		touch_rom((uint32_t)(order[i] << ROM_PAGE_SHIFT), 1);
+	}
+
+	CHECK(g_rom_pages_loaded == NULL);
+	CHECK(memcmp(g_rom, expected, ROM_SIZE) == 0);
+
+	/* out of range touches are ignored */
+	touch_rom(ROM_SIZE, 4);
+	touch_rom(0xfffffffc, 4);
+
+	CHECK(close_rom() == M64ERR_SUCCESS);
+	CHECK(g_rom == NULL);
+	remove(path);
+}
+
+int main(void)
+{
+	load_reference();
+
+	test_image("z64", 1);
+	test_image("v64", 2);
+	test_image("n64", 4);
+
+	if (failures)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+
+	printf("all checks passed\n");
+	return 0;
+}
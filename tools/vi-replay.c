@@ -0,0 +1,296 @@
+/* vi-replay
+ * Runs angrylion's VI scanout (rdp_update in n64video_vi.c) over a fixed
+ * sequence of VI settings on random RDRAM contents: a 240p picture which
+ * narrows and shrinks, a blank frame, interlaced 480i and back to 240p.
+ *
+ * The sequence is scanned out once into blitter_buf only, which gives the
+ * reference frames, then again with a frontend which hands out its own
+ * buffers (GET_CURRENT_SOFTWARE_FRAMEBUFFER), 1 to 3 of them in turn, each
+ * filled with garbage before it is handed out.  Every presented frame has
+ * to match the reference one, except for lines still fading out in the
+ * reference, which may be black already.
+ *
+ * usage: vi-replay [-v]
+ *     -v  print the number of faded lines of every frame
+ * Prints each mismatch and exits with a non-zero status if any occurred.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "z64.h"
+#include "vi.h"
+#include "rdp.h"
+
+#include <libretro.h>
+
+#define DRAM_SIZE (8 * 1024 * 1024)
+#define OUT_WIDTH 640
+#define OUT_HEIGHT 480
+#define FRONTEND_PITCH 704 /* wider than the picture, in pixels */
+#define FRONTEND_BUFFERS 3
+#define GARBAGE 0xabababab
+
+/* normally provided by the core and n64video_main.c */
+GFX_INFO gfx_info;
+RECT __src, __dst;
+int32_t pitchindwords;
+uint32_t *blitter_buf;
+uint32_t *blitter_buf_lock;
+unsigned int screen_width = OUT_WIDTH, screen_height = OUT_HEIGHT;
+uint32_t screen_pitch;
+retro_log_printf_t log_cb;
+retro_environment_t environ_cb;
+
+static uint8_t *dram;
+static uint8_t dmem[0x1000];
+static uint8_t imem[0x1000];
+static uint32_t mi_intr, dpc_start, dpc_end, dpc_current, dpc_status;
+static uint32_t dpc_clock, dpc_bufbusy, dpc_pipebusy, dpc_tmem;
+static uint32_t reg_vi_status, reg_vi_origin, reg_vi_width, reg_vi_intr, reg_vi_current_line;
+static uint32_t reg_vi_timing, reg_vi_v_sync, reg_vi_h_sync, reg_vi_leap, reg_vi_h_start;
+static uint32_t reg_vi_v_start, reg_vi_v_burst, reg_vi_x_scale, reg_vi_y_scale;
+
+static uint32_t *frontend_buf[FRONTEND_BUFFERS];
+static unsigned frontend_count, frontend_next;
+static uint32_t rng_state;
+
+struct vi_frame
+{
+	uint32_t status;
+	uint32_t width;
+	uint32_t h_start, v_start;
+	uint32_t x_scale, y_scale;
+};
+
+#define VI_240P   0x311e /* 16-bit, AA and resampling, gamma dither */
+#define VI_BLANK  0x3110
+#define VI_480I   0x315e /* with serration pulses */
+
+static const struct vi_frame script[] =
+{
+	/* leaves the same VI state behind whatever ran before */
+	{ VI_BLANK, 320, (108 << 16) | 748,       (37 << 16) | 511,        0x200, 0x400 },
+	{ VI_240P, 320, (108 << 16) | 748,        (37 << 16) | 511,        0x200, 0x400 },
+	{ VI_240P, 320, (108 << 16) | 748,        (37 << 16) | 511,        0x200, 0x400 },
+	{ VI_240P, 320, (108 << 16) | 748,        (37 << 16) | 511,        0x200, 0x400 },
+	/* narrower, then also shorter */
+	{ VI_240P, 320, (148 << 16) | 708,        (37 << 16) | 511,        0x200, 0x400 },
+	{ VI_240P, 320, (148 << 16) | 708,        (37 << 16) | 511,        0x200, 0x400 },
+	{ VI_240P, 320, (148 << 16) | 708,        (67 << 16) | 481,        0x200, 0x400 },
+	{ VI_240P, 320, (148 << 16) | 708,        (67 << 16) | 481,        0x200, 0x400 },
+	{ VI_BLANK, 320, (148 << 16) | 708,       (67 << 16) | 481,        0x200, 0x400 },
+	{ VI_240P, 320, (148 << 16) | 708,        (67 << 16) | 481,        0x200, 0x400 },
+	{ VI_240P, 320, (108 << 16) | 748,        (37 << 16) | 511,        0x200, 0x400 },
+	/* the fields alternate their start line */
+	{ VI_480I, 640, (108 << 16) | 748,        (37 << 16) | 511,        0x400, 0x800 },
+	{ VI_480I, 640, (108 << 16) | 748,        (38 << 16) | 512,        0x400, 0x800 },
+	{ VI_480I, 640, (108 << 16) | 748,        (37 << 16) | 511,        0x400, 0x800 },
+	{ VI_480I, 640, (108 << 16) | 748,        (38 << 16) | 512,        0x400, 0x800 },
+	{ VI_480I, 640, (148 << 16) | 708,        (37 << 16) | 511,        0x400, 0x800 },
+	{ VI_480I, 640, (148 << 16) | 708,        (38 << 16) | 512,        0x400, 0x800 },
+	{ VI_240P, 320, (108 << 16) | 748,        (37 << 16) | 511,        0x200, 0x400 },
+	{ VI_240P, 320, (108 << 16) | 748,        (37 << 16) | 511,        0x200, 0x400 },
+	{ VI_240P, 320, (128 << 16) | 728,        (47 << 16) | 501,        0x200, 0x400 },
+	{ VI_240P, 320, (108 << 16) | 748,        (37 << 16) | 511,        0x200, 0x400 },
+};
+
+#define FRAMES (sizeof(script) / sizeof(script[0]))
+
+static void check_interrupts(void)
+{
+}
+
+static uint32_t rng(void)
+{
+	/* xorshift32 */
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+static bool environment(unsigned cmd, void *data)
+{
+	struct retro_framebuffer *fb = (struct retro_framebuffer*)data;
+	uint32_t *buf;
+	size_t i;
+
+	if (cmd != RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER || !frontend_count)
+		return false;
+
+	/* nothing of what the VI drew into it last time is left */
+	buf = frontend_buf[frontend_next];
+	frontend_next = (frontend_next + 1) % frontend_count;
+	for (i = 0; i < FRONTEND_PITCH * OUT_HEIGHT; i++)
+		buf[i] = GARBAGE;
+
+	fb->data   = buf;
+	fb->pitch  = FRONTEND_PITCH * sizeof(uint32_t);
+	fb->format = RETRO_PIXEL_FORMAT_XRGB8888;
+	return true;
+}
+
+static void set_frame(const struct vi_frame *frame)
+{
+	uint32_t *words = (uint32_t*)dram;
+	size_t i;
+
+	for (i = 0; i < DRAM_SIZE / 4; i++)
+		words[i] = rng();
+
+	reg_vi_status     = frame->status;
+	reg_vi_origin     = 0x100000;
+	reg_vi_width      = frame->width;
+	reg_vi_v_sync     = 525;
+	reg_vi_h_start    = frame->h_start;
+	reg_vi_v_start    = frame->v_start;
+	reg_vi_x_scale    = frame->x_scale;
+	reg_vi_y_scale    = frame->y_scale;
+}
+
+/* Scans out the whole script, copying every presented frame to out. */
+static void replay(uint32_t *out)
+{
+	const uint32_t *shown = NULL;
+	size_t shown_pitch = 0;
+	unsigned f, y;
+
+	rng_state = 0x12345678;
+	frontend_next = 0;
+	memset(blitter_buf, 0, PRESCALE_WIDTH * PRESCALE_HEIGHT * sizeof(uint32_t));
+
+	for (f = 0; f < FRAMES; f++)
+	{
+		set_frame(&script[f]);
+
+		blitter_buf_lock = blitter_buf;
+		rdp_update();
+
+		/* NULL: the last frame is shown again */
+		if (blitter_buf_lock)
+		{
+			shown = blitter_buf_lock;
+			shown_pitch = screen_pitch / sizeof(uint32_t);
+		}
+
+		for (y = 0; y < OUT_HEIGHT; y++)
+			memcpy(&out[(f * OUT_HEIGHT + y) * OUT_WIDTH],
+					&shown[y * shown_pitch], OUT_WIDTH * sizeof(uint32_t));
+	}
+}
+
+static int line_is_black(const uint32_t *line)
+{
+	unsigned x;
+
+	for (x = 0; x < OUT_WIDTH; x++)
+		if (line[x])
+			return 0;
+	return 1;
+}
+
+static int compare(const uint32_t *expected, const uint32_t *result, int verbose)
+{
+	int failures = 0;
+	unsigned f, y;
+
+	for (f = 0; f < FRAMES; f++)
+	{
+		unsigned faded = 0;
+
+		for (y = 0; y < OUT_HEIGHT; y++)
+		{
+			size_t offset = (f * OUT_HEIGHT + y) * OUT_WIDTH;
+
+			if (!memcmp(&expected[offset], &result[offset], OUT_WIDTH * sizeof(uint32_t)))
+				continue;
+
+			if (line_is_black(&result[offset]))
+			{
+				++faded;
+				continue;
+			}
+
+			printf("%u buffers: frame %u differs from line %u\n", frontend_count, f, y);
+			++failures;
+			break;
+		}
+
+		if (verbose)
+			printf("%u buffers: frame %u, %u lines faded early\n", frontend_count, f, faded);
+	}
+
+	return failures;
+}
+
+int main(int argc, char **argv)
+{
+	int verbose = (argc > 1 && !strcmp(argv[1], "-v"));
+	size_t frame_size = OUT_WIDTH * OUT_HEIGHT * sizeof(uint32_t);
+	uint32_t *expected, *result;
+	int failures = 0;
+	unsigned i;
+
+	dram     = (uint8_t*)calloc(1, DRAM_SIZE);
+	expected = (uint32_t*)malloc(FRAMES * frame_size);
+	result   = (uint32_t*)malloc(FRAMES * frame_size);
+	blitter_buf = (uint32_t*)calloc(PRESCALE_WIDTH * PRESCALE_HEIGHT, sizeof(uint32_t));
+	for (i = 0; i < FRONTEND_BUFFERS; i++)
+		frontend_buf[i] = (uint32_t*)malloc(FRONTEND_PITCH * OUT_HEIGHT * sizeof(uint32_t));
+	if (!dram || !expected || !result || !blitter_buf || !frontend_buf[FRONTEND_BUFFERS - 1])
+		return 1;
+
+	gfx_info.RDRAM                 = dram;
+	gfx_info.DMEM                  = dmem;
+	gfx_info.IMEM                  = imem;
+	gfx_info.MI_INTR_REG           = &mi_intr;
+	gfx_info.DPC_START_REG         = &dpc_start;
+	gfx_info.DPC_END_REG           = &dpc_end;
+	gfx_info.DPC_CURRENT_REG       = &dpc_current;
+	gfx_info.DPC_STATUS_REG        = &dpc_status;
+	gfx_info.DPC_CLOCK_REG         = &dpc_clock;
+	gfx_info.DPC_BUFBUSY_REG       = &dpc_bufbusy;
+	gfx_info.DPC_PIPEBUSY_REG      = &dpc_pipebusy;
+	gfx_info.DPC_TMEM_REG          = &dpc_tmem;
+	gfx_info.VI_STATUS_REG         = &reg_vi_status;
+	gfx_info.VI_ORIGIN_REG         = &reg_vi_origin;
+	gfx_info.VI_WIDTH_REG          = &reg_vi_width;
+	gfx_info.VI_INTR_REG           = &reg_vi_intr;
+	gfx_info.VI_V_CURRENT_LINE_REG = &reg_vi_current_line;
+	gfx_info.VI_TIMING_REG         = &reg_vi_timing;
+	gfx_info.VI_V_SYNC_REG         = &reg_vi_v_sync;
+	gfx_info.VI_H_SYNC_REG         = &reg_vi_h_sync;
+	gfx_info.VI_LEAP_REG           = &reg_vi_leap;
+	gfx_info.VI_H_START_REG        = &reg_vi_h_start;
+	gfx_info.VI_V_START_REG        = &reg_vi_v_start;
+	gfx_info.VI_V_BURST_REG        = &reg_vi_v_burst;
+	gfx_info.VI_X_SCALE_REG        = &reg_vi_x_scale;
+	gfx_info.VI_Y_SCALE_REG        = &reg_vi_y_scale;
+	gfx_info.CheckInterrupts       = check_interrupts;
+	environ_cb = environment;
+
+	rdp_init();
+
+	frontend_count = 0;
+	replay(expected);
+
+	for (frontend_count = 1; frontend_count <= FRONTEND_BUFFERS; frontend_count++)
+	{
+		replay(result);
+		failures += compare(expected, result, verbose);
+	}
+
+	rdp_close();
+
+	if (failures)
+	{
+		printf("%d frames differ\n", failures);
+		return 1;
+	}
+
+	printf("%u frames match with 1 to %u frontend buffers\n", (unsigned)FRAMES, FRONTEND_BUFFERS);
+	return 0;
+}